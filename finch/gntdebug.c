@@ -97,10 +97,23 @@ static struct
 	gboolean paused;
 } debug;
 
+/* The log writer drops everything while the window is closed or paused, so
+ * tell libpurple not to bother formatting it. */
+static void
+finch_debug_update_level(void)
+{
+	if (debug.window != NULL && !debug.paused) {
+		purple_debug_set_level(PURPLE_DEBUG_ALL);
+	} else {
+		purple_debug_set_level(PURPLE_DEBUG_FATAL);
+	}
+}
+
 static void
 reset_debug_win(GntWidget *w, gpointer null)
 {
 	debug.window = debug.tview = debug.search = NULL;
+	finch_debug_update_level();
 }
 
 static void
@@ -119,54 +132,33 @@ static void
 toggle_pause(GntWidget *w, gpointer n)
 {
 	debug.paused = !debug.paused;
+	finch_debug_update_level();
 }
 
-static GLogWriterOutput
-finch_debug_g_log_handler(GLogLevelFlags log_level, const GLogField *fields,
-                          gsize n_fields, G_GNUC_UNUSED gpointer user_data)
+static void
+finch_debug_append(const PurpleDebugRecord *record, const gchar *search_str)
 {
-	const gchar *domain = NULL;
-	const gchar *msg = NULL;
-	const gchar *search_str = NULL;
-	gint pos = 0;
+	const gchar *domain = record->category;
 	GntTextFormatFlags flag = 0;
 	GDateTime *local_date_time = NULL;
 	gchar *local_time = NULL;
-	gsize i;
 
-	if (debug.window == NULL || debug.paused) {
-		return G_LOG_WRITER_UNHANDLED;
-	}
-
-	for (i = 0; i < n_fields; i++) {
-		if (purple_strequal(fields[i].key, "GLIB_DOMAIN")) {
-			domain = fields[i].value;
-		} else if (purple_strequal(fields[i].key, "MESSAGE")) {
-			msg = fields[i].value;
-		}
-	}
-
-	if (msg == NULL) {
-		return G_LOG_WRITER_UNHANDLED;
-	}
-	if (domain == NULL) {
+	if (*domain == '\0') {
 		domain = "g_log";
 	}
 
 	/* Filter out log line if we have a search term, and it doesn't match
 	 * the domain or message. */
-	search_str = gnt_entry_get_text(GNT_ENTRY(debug.search));
 	if (search_str != NULL && *search_str != '\0') {
 		if (g_strrstr(domain, search_str) == NULL &&
-		    g_strrstr(msg, search_str) == NULL)
+		    g_strrstr(record->message, search_str) == NULL)
 		{
-			return G_LOG_WRITER_UNHANDLED;
+			return;
 		}
 	}
 
-	pos = gnt_text_view_get_lines_below(GNT_TEXT_VIEW(debug.tview));
-
-	local_date_time = g_date_time_new_now_local();
+	local_date_time = g_date_time_new_from_unix_local(
+			purple_debug_record_get_real_time(record) / G_USEC_PER_SEC);
 	local_time = g_date_time_format(local_date_time, "%H:%M:%S ");
 	g_date_time_unref(local_date_time);
 
@@ -180,24 +172,94 @@ finch_debug_g_log_handler(GLogLevelFlags log_level, const GLogField *fields,
 	                                     GNT_TEXT_FLAG_BOLD);
 
 	flag = GNT_TEXT_FLAG_NORMAL;
-	switch (log_level & G_LOG_LEVEL_MASK) {
-		case G_LOG_LEVEL_WARNING:
+	switch (record->level) {
+		case PURPLE_DEBUG_WARNING:
 			flag |= GNT_TEXT_FLAG_UNDERLINE;
 			/* fallthrough */
-		case G_LOG_LEVEL_ERROR:
+		case PURPLE_DEBUG_FATAL:
 			flag |= GNT_TEXT_FLAG_BOLD;
 			break;
 		default:
 			break;
 	}
 
-	gnt_text_view_append_text_with_flags(GNT_TEXT_VIEW(debug.tview), msg,
-	                                     flag);
+	gnt_text_view_append_text_with_flags(GNT_TEXT_VIEW(debug.tview),
+	                                     record->message, flag);
 	gnt_text_view_append_text_with_flags(GNT_TEXT_VIEW(debug.tview), "\n",
 	                                     GNT_TEXT_FLAG_NORMAL);
+}
+
+/* Called on the main loop with everything that was logged since the last
+ * time, so the view is only scrolled once per batch. */
+static void
+finch_debug_sink_cb(GPtrArray *records, G_GNUC_UNUSED gpointer data)
+{
+	const gchar *search_str = NULL;
+	gint pos = 0;
+	guint i;
+
+	if (debug.window == NULL || debug.paused) {
+		return;
+	}
+
+	search_str = gnt_entry_get_text(GNT_ENTRY(debug.search));
+	pos = gnt_text_view_get_lines_below(GNT_TEXT_VIEW(debug.tview));
+
+	for (i = 0; i < records->len; i++) {
+		finch_debug_append(g_ptr_array_index(records, i), search_str);
+	}
+
 	if (pos <= 1) {
 		gnt_text_view_scroll(GNT_TEXT_VIEW(debug.tview), 0);
 	}
+}
+
+/* libpurple sends its own messages straight to the sink, so this only sees
+ * messages from GLib and other libraries, which are forwarded to the same
+ * queue. */
+static GLogWriterOutput
+finch_debug_g_log_handler(GLogLevelFlags log_level, const GLogField *fields,
+                          gsize n_fields, G_GNUC_UNUSED gpointer user_data)
+{
+	PurpleDebugLevel level = PURPLE_DEBUG_MISC;
+	const gchar *domain = NULL;
+	const gchar *msg = NULL;
+	gsize i;
+
+	if (debug.window == NULL || debug.paused) {
+		return G_LOG_WRITER_UNHANDLED;
+	}
+
+	for (i = 0; i < n_fields; i++) {
+		if (purple_strequal(fields[i].key, "GLIB_DOMAIN")) {
+			domain = fields[i].value;
+		} else if (purple_strequal(fields[i].key, "MESSAGE")) {
+			msg = fields[i].value;
+		}
+	}
+
+	if (msg == NULL) {
+		return G_LOG_WRITER_UNHANDLED;
+	}
+
+	switch (log_level & G_LOG_LEVEL_MASK) {
+		case G_LOG_LEVEL_ERROR:
+			level = PURPLE_DEBUG_FATAL;
+			break;
+		case G_LOG_LEVEL_CRITICAL:
+			level = PURPLE_DEBUG_ERROR;
+			break;
+		case G_LOG_LEVEL_WARNING:
+			level = PURPLE_DEBUG_WARNING;
+			break;
+		case G_LOG_LEVEL_MESSAGE:
+			level = PURPLE_DEBUG_INFO;
+			break;
+		default:
+			break;
+	}
+
+	purple_debug(level, domain, "%s", msg);
 
 	return G_LOG_WRITER_HANDLED;
 }
@@ -260,6 +322,7 @@ void finch_debug_window_show()
 
 	debug.paused = FALSE;
 	if (debug.window) {
+		finch_debug_update_level();
 		gnt_window_present(debug.window);
 		return;
 	}
@@ -319,12 +382,16 @@ void finch_debug_window_show()
 	gnt_text_view_attach_pager_widget(GNT_TEXT_VIEW(debug.tview), debug.window);
 
 	gnt_widget_show(debug.window);
+
+	finch_debug_update_level();
 }
 
 void
 finch_debug_init_handler(void)
 {
+	purple_debug_set_sink(finch_debug_sink_cb, NULL, NULL);
 	g_log_set_writer_func(finch_debug_g_log_handler, NULL, NULL);
+	finch_debug_update_level();
 }
 
 void
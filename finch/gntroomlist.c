@@ -279,6 +279,29 @@ fl_destroy(G_GNUC_UNUSED gpointer data, GObject *list)
 	}
 }
 
+static void
+fl_items_changed(GListModel *model, guint position, G_GNUC_UNUSED guint removed,
+                 guint added, G_GNUC_UNUSED gpointer data)
+{
+	guint i;
+
+	if (froomlist.roomlist != PURPLE_ROOMLIST(model))
+		return;
+
+	for (i = position; i < position + added; i++) {
+		PurpleRoomlistRoom *room = g_list_model_get_item(model, i);
+
+		gnt_tree_remove(GNT_TREE(froomlist.tree), room);
+		gnt_tree_add_row_after(GNT_TREE(froomlist.tree), room,
+				gnt_tree_create_row(GNT_TREE(froomlist.tree),
+					purple_roomlist_room_get_name(room), ""),
+			NULL, NULL);
+		gnt_tree_set_expanded(GNT_TREE(froomlist.tree), room, TRUE);
+
+		g_object_unref(room);
+	}
+}
+
 static void
 fl_create(PurpleRoomlist *list)
 {
@@ -286,6 +309,8 @@ fl_create(PurpleRoomlist *list)
 	g_object_weak_ref(G_OBJECT(list), (GWeakNotify)fl_destroy, NULL);
 	setup_roomlist(NULL);
 	g_set_object(&froomlist.roomlist, list);
+	g_signal_connect(list, "items-changed", G_CALLBACK(fl_items_changed),
+	                 NULL);
 }
 
 static void
@@ -293,26 +318,10 @@ fl_set_fields(PurpleRoomlist *list, GList *fields)
 {
 }
 
-static void
-fl_add_room(PurpleRoomlist *roomlist, PurpleRoomlistRoom *room)
-{
-	gchar *category = NULL;
-	if (froomlist.roomlist != roomlist)
-		return;
-
-	gnt_tree_remove(GNT_TREE(froomlist.tree), room);
-	gnt_tree_add_row_after(GNT_TREE(froomlist.tree), room,
-			gnt_tree_create_row(GNT_TREE(froomlist.tree),
-				purple_roomlist_room_get_name(room), ""),
-		NULL, NULL);
-	gnt_tree_set_expanded(GNT_TREE(froomlist.tree), room, category == NULL);
-}
-
 static PurpleRoomlistUiOps ui_ops = {
 	.show_with_account = fl_show_with_account,
 	.create = fl_create,
 	.set_fields = fl_set_fields,
-	.add_room = fl_add_room,
 };
 
 PurpleRoomlistUiOps *finch_roomlist_get_ui_ops(void)
@@ -16,6 +16,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
  */
 
+#include <string.h>
+
 #include <glib/gi18n-lib.h>
 
 #include <purple.h>
@@ -24,6 +26,28 @@
 
 #include <finch.h>
 
+/* The number of history messages loaded, or matches shown, per main loop
+ * iteration. */
+#define LASTLOG_BATCH_SIZE 200
+
+typedef struct {
+	GntWidget *window;
+	GntTextView *view;
+	GRegex *regex;
+
+	/* The history query without its paging terms. */
+	char *query;
+	/* The oldest message searched so far, where the next page ends. */
+	char *before;
+	char *before_id;
+	gboolean loaded;
+
+	/* The matches, oldest first, and the next one to show. */
+	GList *matches;
+	GList *next;
+	guint source;
+} LastlogSearch;
+
 static PurpleCmdId cmd;
 
 static gboolean
@@ -51,38 +75,297 @@ window_kpress_cb(GntWidget *wid, const char *key, GntTextView *view)
 	return FALSE;
 }
 
+static void
+lastlog_search_free(LastlogSearch *search)
+{
+	g_clear_handle_id(&search->source, g_source_remove);
+	g_list_free_full(search->matches, g_object_unref);
+	g_regex_unref(search->regex);
+	g_free(search->query);
+	g_free(search->before);
+	g_free(search->before_id);
+	g_free(search);
+}
+
+/* Appends one line for a message whose text matched, with every match in
+ * bold. */
+static void
+lastlog_append_match(LastlogSearch *search, PurpleMessage *message,
+                     const char *text, GMatchInfo *info)
+{
+	GDateTime *timestamp = purple_message_get_timestamp(message);
+	char *prefix;
+	int last = 0;
+
+	if (timestamp != NULL) {
+		char *time = g_date_time_format(timestamp, "%H:%M:%S");
+		prefix = g_strdup_printf("(%s) %s: ", time,
+		                         purple_message_get_author_alias(message));
+		g_free(time);
+	} else {
+		prefix = g_strdup_printf("%s: ",
+		                         purple_message_get_author_alias(message));
+	}
+	gnt_text_view_append_text_with_flags(search->view, prefix,
+	                                     GNT_TEXT_FLAG_NORMAL);
+	g_free(prefix);
+
+	do {
+		char *part;
+		int start = 0, end = 0;
+
+		g_match_info_fetch_pos(info, 0, &start, &end);
+		if (start > last) {
+			part = g_strndup(text + last, start - last);
+			gnt_text_view_append_text_with_flags(search->view, part,
+			                                     GNT_TEXT_FLAG_NORMAL);
+			g_free(part);
+		}
+		if (end > start) {
+			part = g_strndup(text + start, end - start);
+			gnt_text_view_append_text_with_flags(search->view, part,
+			                                     GNT_TEXT_FLAG_BOLD);
+			g_free(part);
+		}
+		last = MAX(last, end);
+	} while (g_match_info_next(info, NULL));
+
+	gnt_text_view_append_text_with_flags(search->view, text + last,
+	                                     GNT_TEXT_FLAG_NORMAL);
+	gnt_text_view_append_text_with_flags(search->view, "\n",
+	                                     GNT_TEXT_FLAG_NORMAL);
+}
+
+/* Loads the page of history right before the oldest message searched so
+ * far and keeps its matches. Returns FALSE if the history couldn't be
+ * searched. */
+static gboolean
+lastlog_search_page(LastlogSearch *search)
+{
+	PurpleHistoryManager *manager = purple_history_manager_get_default();
+	PurpleMessage *oldest;
+	GError *error = NULL;
+	GString *query;
+	GList *results, *iter;
+
+	query = g_string_new(search->query);
+	if (search->before != NULL) {
+		g_string_append_printf(query, " before:%s", search->before);
+	}
+	if (search->before_id != NULL) {
+		char *quoted = purple_history_query_quote(search->before_id);
+		g_string_append_printf(query, " before-id:%s", quoted);
+		g_free(quoted);
+	}
+	g_string_append_printf(query, " limit:%d", LASTLOG_BATCH_SIZE);
+
+	results = purple_history_manager_query(manager, query->str, &error);
+	g_string_free(query, TRUE);
+
+	if (error != NULL) {
+		char *message = g_strdup_printf(_("Unable to search the history: %s"),
+		                                error->message);
+		gnt_text_view_append_text_with_flags(search->view, message,
+		                                     GNT_TEXT_FLAG_DIM);
+		g_free(message);
+		g_error_free(error);
+		g_list_free_full(results, g_object_unref);
+		return FALSE;
+	}
+
+	/* The page is oldest first and comes before every match so far, so
+	 * prepending it newest first keeps the matches in order. */
+	for (iter = g_list_last(results); iter != NULL; iter = iter->prev) {
+		PurpleMessage *message = iter->data;
+		char *text;
+
+		text = purple_markup_strip_html(purple_message_get_contents(message));
+		if (text != NULL && g_regex_match(search->regex, text, 0, NULL)) {
+			search->matches = g_list_prepend(search->matches,
+			                                 g_object_ref(message));
+		}
+		g_free(text);
+	}
+
+	if (g_list_length(results) < LASTLOG_BATCH_SIZE) {
+		search->loaded = TRUE;
+		search->next = search->matches;
+	} else {
+		/* Messages without an id can only be paged strictly by time, which
+		 * may skip ones logged in the same instant. */
+		oldest = results->data;
+		g_free(search->before);
+		search->before = g_date_time_format_iso8601(
+			purple_message_get_timestamp(oldest));
+		g_free(search->before_id);
+		search->before_id = g_strdup(purple_message_get_id(oldest));
+	}
+
+	g_list_free_full(results, g_object_unref);
+
+	return TRUE;
+}
+
+/* Searches the history a page at a time and then shows the matches a batch
+ * at a time, so that a long history neither blocks the UI nor has to be
+ * held in memory or rendered in one go. */
+static gboolean
+lastlog_search_cb(gpointer data)
+{
+	LastlogSearch *search = data;
+	int i;
+
+	if (!search->loaded) {
+		if (lastlog_search_page(search)) {
+			return G_SOURCE_CONTINUE;
+		}
+
+		search->source = 0;
+		return G_SOURCE_REMOVE;
+	}
+
+	for (i = 0; search->next != NULL && i < LASTLOG_BATCH_SIZE; i++) {
+		PurpleMessage *message = search->next->data;
+		GMatchInfo *info = NULL;
+		char *text;
+
+		search->next = search->next->next;
+
+		text = purple_markup_strip_html(purple_message_get_contents(message));
+		if (text != NULL && g_regex_match(search->regex, text, 0, &info)) {
+			lastlog_append_match(search, message, text, info);
+		}
+
+		g_match_info_free(info);
+		g_free(text);
+	}
+
+	if (search->next != NULL) {
+		return G_SOURCE_CONTINUE;
+	}
+
+	if (search->matches == NULL) {
+		gnt_text_view_append_text_with_flags(search->view,
+		                                     _("No matches found."),
+		                                     GNT_TEXT_FLAG_DIM);
+	}
+
+	g_list_free_full(search->matches, g_object_unref);
+	search->matches = NULL;
+	search->source = 0;
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Parses "[-i] [-r] pattern", where -i makes the search case-insensitive and
+ * -r treats the pattern as a regular expression. */
+static GRegex *
+lastlog_parse_pattern(const char *args, char **keyword, GError **error)
+{
+	GRegexCompileFlags flags = G_REGEX_OPTIMIZE;
+	gboolean regex = FALSE;
+	GRegex *compiled;
+	char *escaped;
+
+	while (TRUE) {
+		if (g_str_has_prefix(args, "-i ")) {
+			flags |= G_REGEX_CASELESS;
+		} else if (g_str_has_prefix(args, "-r ")) {
+			regex = TRUE;
+		} else {
+			break;
+		}
+
+		args += 3;
+		while (*args == ' ') {
+			args++;
+		}
+	}
+
+	if (*args == '\0') {
+		g_set_error_literal(error, G_REGEX_ERROR, G_REGEX_ERROR_COMPILE,
+		                    _("No search pattern was given."));
+		return NULL;
+	}
+
+	if (regex) {
+		*keyword = NULL;
+		return g_regex_new(args, flags, 0, error);
+	}
+
+	/* A case-sensitive substring can also narrow the history query, as
+	 * the adapter's keyword match is a superset of ours. That doesn't hold
+	 * if the pattern has markup characters, as the adapter matches the
+	 * stored markup and we match the stripped text. */
+	if ((flags & G_REGEX_CASELESS) == 0 && strpbrk(args, "<>&") == NULL) {
+		*keyword = g_strdup(args);
+	} else {
+		*keyword = NULL;
+	}
+	escaped = g_regex_escape_string(args, -1);
+	compiled = g_regex_new(escaped, flags, 0, error);
+	g_free(escaped);
+
+	return compiled;
+}
+
 static PurpleCmdRet
 lastlog_cb(PurpleConversation *conv, const char *cmd, char **args, char **error, gpointer null)
 {
-	FinchConv *ggconv = FINCH_CONV(conv);
-	char **strings = g_strsplit(gnt_text_view_get_text(GNT_TEXT_VIEW(ggconv->tv)),
-	                            "\n", 0);
-	GntWidget *win, *tv;
-	int i, j;
-
-	win = gnt_window_new();
-	gnt_box_set_title(GNT_BOX(win), _("Lastlog"));
-
-	tv = gnt_text_view_new();
-	gnt_box_add_widget(GNT_BOX(win), tv);
-
-	gnt_widget_show(win);
-
-	for (i = 0; strings[i]; i++) {
-		if (strstr(strings[i], args[0]) != NULL) {
-			char **finds = g_strsplit(strings[i], args[0], 0);
-			for (j = 0; finds[j]; j++) {
-				if (j)
-					gnt_text_view_append_text_with_flags(GNT_TEXT_VIEW(tv), args[0], GNT_TEXT_FLAG_BOLD);
-				gnt_text_view_append_text_with_flags(GNT_TEXT_VIEW(tv), finds[j], GNT_TEXT_FLAG_NORMAL);
-			}
-			g_strfreev(finds);
-			gnt_text_view_append_text_with_flags(GNT_TEXT_VIEW(tv), "\n", GNT_TEXT_FLAG_NORMAL);
-		}
+	PurpleAccount *account = purple_conversation_get_account(conv);
+	LastlogSearch *search;
+	GError *err = NULL;
+	GRegex *regex;
+	GString *query;
+	char *keyword = NULL;
+	char *quoted;
+
+	regex = lastlog_parse_pattern(args[0], &keyword, &err);
+	if (regex == NULL) {
+		*error = g_strdup(err->message);
+		g_error_free(err);
+		return PURPLE_CMD_RET_FAILED;
 	}
 
-	g_signal_connect(G_OBJECT(win), "key_pressed", G_CALLBACK(window_kpress_cb), tv);
-	g_strfreev(strings);
+	/* Quote everything, names and the keyword may have spaces or look like
+	 * other terms. */
+	query = g_string_new(NULL);
+	quoted = purple_history_query_quote(purple_conversation_get_name(conv));
+	g_string_append_printf(query, "in:%s", quoted);
+	g_free(quoted);
+	quoted = purple_history_query_quote(purple_account_get_username(account));
+	g_string_append_printf(query, " account:%s", quoted);
+	g_free(quoted);
+	quoted = purple_history_query_quote(
+		purple_account_get_protocol_name(account));
+	g_string_append_printf(query, " protocol:%s", quoted);
+	g_free(quoted);
+	if (keyword != NULL) {
+		quoted = purple_history_query_quote(keyword);
+		g_string_append_printf(query, " %s", quoted);
+		g_free(quoted);
+		g_free(keyword);
+	}
+
+	search = g_new0(LastlogSearch, 1);
+	search->regex = regex;
+	search->query = g_string_free(query, FALSE);
+
+	search->window = gnt_window_new();
+	gnt_box_set_title(GNT_BOX(search->window), _("Lastlog"));
+
+	search->view = GNT_TEXT_VIEW(gnt_text_view_new());
+	gnt_box_add_widget(GNT_BOX(search->window), GNT_WIDGET(search->view));
+
+	gnt_widget_show(search->window);
+
+	g_signal_connect(G_OBJECT(search->window), "key_pressed",
+	                 G_CALLBACK(window_kpress_cb), search->view);
+	g_signal_connect_swapped(G_OBJECT(search->window), "destroy",
+	                         G_CALLBACK(lastlog_search_free), search);
+
+	search->source = g_idle_add(lastlog_search_cb, search);
+
 	return PURPLE_CMD_RET_OK;
 }
 
@@ -112,7 +395,8 @@ gnt_last_log_load(GPluginPlugin *plugin, GError **error) {
 	cmd = purple_cmd_register("lastlog", "s", PURPLE_CMD_P_DEFAULT,
 			PURPLE_CMD_FLAG_CHAT | PURPLE_CMD_FLAG_IM, NULL,
 			/* Translators: The "backlog" here refers to the the conversation buffer/history. */
-			lastlog_cb, _("lastlog: Searches for a substring in the backlog."), NULL);
+			lastlog_cb, _("lastlog [-i] [-r] &lt;pattern&gt;: Searches for a substring in the backlog. "
+			             "-i ignores case and -r treats the pattern as a regular expression."), NULL);
 	return TRUE;
 }
 
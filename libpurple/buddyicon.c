@@ -95,12 +95,76 @@ static GHashTable *icon_file_cache = NULL;
  */
 static GHashTable *pointer_icon_cache = NULL;
 
+/*
+ * This hash table contains the icons that have been handed to a worker
+ * thread to be written to the cache directory, but haven't landed there yet.
+ * Reads of these files are served from memory, and deleting one of them is
+ * put off until its write has finished.
+ *
+ * Key is the filename as in icon_file_cache.
+ * Value is the PurpleBuddyIconWrite for the file, which is owned by its task.
+ */
+static GHashTable *pending_writes = NULL;
+
+/*
+ * This hash table contains reference counts for the cache files that are
+ * used by account icons and custom buddy icons.  Nothing will fetch those
+ * again for us, so they are never evicted to stay within the cache budget.
+ *
+ * Key is the filename as in icon_file_cache.
+ * Value is a GINT_TO_POINTER count of the number of times this icon is used.
+ */
+static GHashTable *icon_pin_cache = NULL;
+
 static char       *cache_dir     = NULL;
 
 /* "Should icons be cached to disk?" */
 static gboolean    icon_caching  = TRUE;
 
+/* The number of bytes the cache directory may use before the least recently
+ * used buddy icons are evicted, or 0 for no limit. */
+static gsize       cache_budget  = PURPLE_BUDDY_ICONS_DEFAULT_CACHE_BUDGET;
+static guint       evict_timeout = 0;
+static gboolean    evicting      = FALSE;
+
+/* How long to wait after the cache directory changed before checking it
+ * against the budget, in seconds. */
+#define PURPLE_BUDDY_ICONS_EVICT_DELAY 30
+
+typedef struct {
+	gchar *filename;
+	gchar *dirname;
+	gchar *path;
+	GBytes *contents;
+
+	/* Delete the file once it has been written. */
+	gboolean uncache;
+
+	/* Held while the file is being written, so that a flush at shutdown
+	 * waits for the worker instead of writing the same file alongside it. */
+	GMutex lock;
+	gboolean written;
+} PurpleBuddyIconWrite;
+
+typedef struct {
+	gchar *dirname;
+	gsize budget;
+
+	/* Filenames that are in use and must not be evicted. */
+	GHashTable *keep;
+} PurpleBuddyIconEviction;
+
+typedef struct {
+	gchar *filename;
+	time_t mtime;
+	goffset size;
+} PurpleBuddyIconCacheEntry;
+
 static void delete_buddy_icon_settings(PurpleBlistNode *node, const char *setting_name);
+static void purple_buddy_icon_data_uncache_file(const char *filename);
+static void purple_buddy_icons_schedule_eviction(void);
+static PurpleImage *set_account_icon_contents(PurpleAccount *account, GBytes *contents);
+static PurpleImage *set_custom_icon_contents(PurpleBlistNode *node, GBytes *contents);
 
 /*
  * Begin functions for dealing with the on-disk icon cache
@@ -140,50 +204,260 @@ unref_filename(const char *filename)
 	}
 }
 
+static void
+pin_filename(const char *filename)
+{
+	int pins;
+
+	g_return_if_fail(filename != NULL);
+
+	pins = GPOINTER_TO_INT(g_hash_table_lookup(icon_pin_cache, filename));
+
+	g_hash_table_insert(icon_pin_cache, g_strdup(filename),
+	                    GINT_TO_POINTER(pins + 1));
+}
+
+static void
+unpin_filename(const char *filename)
+{
+	int pins;
+
+	if (filename == NULL)
+		return;
+
+	pins = GPOINTER_TO_INT(g_hash_table_lookup(icon_pin_cache, filename));
+
+	if (pins <= 1)
+	{
+		g_hash_table_remove(icon_pin_cache, filename);
+	}
+	else
+	{
+		g_hash_table_insert(icon_pin_cache, g_strdup(filename),
+		                    GINT_TO_POINTER(pins - 1));
+	}
+}
+
 static const gchar *
 image_get_filename(PurpleImage *img)
 {
 	return g_object_get_data(G_OBJECT(img), "purple-buddyicon-filename");
 }
 
+static gboolean
+icon_file_exists(const char *dirname, const char *filename)
+{
+	gchar *path;
+	gboolean exists;
+
+	if (g_hash_table_contains(pending_writes, filename))
+		return TRUE;
+
+	path = g_build_filename(dirname, filename, NULL);
+	exists = g_file_test(path, G_FILE_TEST_EXISTS);
+	g_free(path);
+
+	return exists;
+}
+
+/* Maps @path into memory rather than copying it.  Cache files are only ever
+ * replaced by renaming over them or unlinked, so the mapping stays valid for
+ * as long as the image holds on to it. */
+static GBytes *
+read_icon_file(const char *path)
+{
+	GMappedFile *file;
+	GBytes *contents;
+	GError *err = NULL;
+
+	file = g_mapped_file_new(path, FALSE, &err);
+	if (file == NULL)
+	{
+		purple_debug_error("buddyicon", "Error reading %s: %s\n",
+		                   path, err->message);
+		g_error_free(err);
+
+		return NULL;
+	}
+
+	contents = g_mapped_file_get_bytes(file);
+	g_mapped_file_unref(file);
+
+	if (g_bytes_get_size(contents) == 0)
+	{
+		purple_debug_error("buddyicon", "Error reading %s: empty file\n",
+		                   path);
+		g_bytes_unref(contents);
+
+		return NULL;
+	}
+
+	return contents;
+}
+
+static GBytes *
+read_cached_icon_file(const char *filename)
+{
+	PurpleBuddyIconWrite *job;
+	GBytes *contents;
+	gchar *path;
+
+	job = g_hash_table_lookup(pending_writes, filename);
+	if (job != NULL)
+		return g_bytes_ref(job->contents);
+
+	path = g_build_filename(purple_buddy_icons_get_cache_dir(), filename,
+	                        NULL);
+	contents = read_icon_file(path);
+
+	/* The modification time is what eviction goes by, so bump it. */
+	if (contents != NULL)
+		g_utime(path, NULL);
+
+	g_free(path);
+
+	return contents;
+}
+
+static gboolean
+write_icon_file_locked(PurpleBuddyIconWrite *job, GError **error)
+{
+	gconstpointer data;
+	gsize len;
+
+	/* The filename is the hash of the contents, so if the file is already
+	 * there it is this icon and only needs to be marked as recently used. */
+	if (g_file_test(job->path, G_FILE_TEST_EXISTS))
+	{
+		g_utime(job->path, NULL);
+		return TRUE;
+	}
+
+	if (g_mkdir_with_parents(job->dirname, S_IRUSR | S_IWUSR | S_IXUSR) < 0)
+	{
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(errno),
+		            "unable to create directory %s: %s", job->dirname,
+		            g_strerror(errno));
+		return FALSE;
+	}
+
+	data = g_bytes_get_data(job->contents, &len);
+
+	return g_file_set_contents(job->path, data, len, error);
+}
+
+/* Writes the file unless that has been done already, by either the worker or
+ * a flush. */
+static gboolean
+write_icon_file(PurpleBuddyIconWrite *job, GError **error)
+{
+	gboolean ret = TRUE;
+
+	g_mutex_lock(&job->lock);
+	if (!job->written)
+	{
+		ret = write_icon_file_locked(job, error);
+		job->written = TRUE;
+	}
+	g_mutex_unlock(&job->lock);
+
+	return ret;
+}
+
+static void
+purple_buddy_icon_write_free(gpointer data)
+{
+	PurpleBuddyIconWrite *job = data;
+
+	g_free(job->filename);
+	g_free(job->dirname);
+	g_free(job->path);
+	g_bytes_unref(job->contents);
+	g_mutex_clear(&job->lock);
+	g_free(job);
+}
+
+static void
+purple_buddy_icon_write_thread(GTask *task, gpointer source_object,
+                               gpointer task_data, GCancellable *cancellable)
+{
+	GError *error = NULL;
+
+	if (!write_icon_file(task_data, &error))
+		g_task_return_error(task, error);
+	else
+		g_task_return_boolean(task, TRUE);
+}
+
+static void
+purple_buddy_icon_write_cb(GObject *source, GAsyncResult *result,
+                           gpointer data)
+{
+	PurpleBuddyIconWrite *job = g_task_get_task_data(G_TASK(result));
+	GError *error = NULL;
+
+	if (!g_task_propagate_boolean(G_TASK(result), &error))
+	{
+		purple_debug_error("buddyicon", "failed to save icon %s: %s",
+		                   job->path, error->message);
+		g_error_free(error);
+	}
+
+	/* The subsystem was shut down and flushed this write itself. */
+	if (pending_writes == NULL)
+		return;
+
+	g_hash_table_remove(pending_writes, job->filename);
+
+	if (job->uncache)
+		purple_buddy_icon_data_uncache_file(job->filename);
+
+	purple_buddy_icons_schedule_eviction();
+}
+
 static void
 purple_buddy_icon_data_cache(PurpleImage *img)
 {
-	const gchar *dirname, *filename;
-	gchar *path;
+	PurpleBuddyIconWrite *job;
+	const gchar *filename;
+	GTask *task;
 
 	g_return_if_fail(PURPLE_IS_IMAGE(img));
 
 	if (!purple_buddy_icons_is_caching())
 		return;
 
-	dirname = purple_buddy_icons_get_cache_dir();
 	filename = image_get_filename(img);
 	g_return_if_fail(filename != NULL);
 
-	if (!g_file_test(dirname, G_FILE_TEST_IS_DIR))
+	job = g_hash_table_lookup(pending_writes, filename);
+	if (job != NULL)
 	{
-		purple_debug_info("buddyicon", "creating icon cache directory");
-
-		if (g_mkdir(dirname, S_IRUSR | S_IWUSR | S_IXUSR) < 0)
-		{
-			purple_debug_error("buddyicon",
-				"unable to create directory %s: %s",
-				dirname, g_strerror(errno));
-			return;
-		}
+		/* It's being written already and it's wanted again. */
+		job->uncache = FALSE;
+		return;
 	}
 
-	path = g_build_filename(dirname, filename, NULL);
-	if (!purple_image_save(img, path))
-		purple_debug_error("buddyicon", "failed to save icon %s", path);
+	job = g_new0(PurpleBuddyIconWrite, 1);
+	job->filename = g_strdup(filename);
+	job->dirname = g_strdup(purple_buddy_icons_get_cache_dir());
+	job->path = g_build_filename(job->dirname, filename, NULL);
+	job->contents = purple_image_get_contents(img);
+	g_mutex_init(&job->lock);
 
-	g_free(path);
+	g_hash_table_insert(pending_writes, job->filename, job);
+
+	task = g_task_new(NULL, NULL, purple_buddy_icon_write_cb, NULL);
+	g_task_set_source_tag(task, purple_buddy_icon_data_cache);
+	g_task_set_task_data(task, job, purple_buddy_icon_write_free);
+	g_task_run_in_thread(task, purple_buddy_icon_write_thread);
+	g_object_unref(task);
 }
 
 static void
 purple_buddy_icon_data_uncache_file(const char *filename)
 {
+	PurpleBuddyIconWrite *job;
 	const char *dirname;
 	char *path;
 
@@ -194,6 +468,14 @@ purple_buddy_icon_data_uncache_file(const char *filename)
 	if (GPOINTER_TO_INT(g_hash_table_lookup(icon_file_cache, filename)))
 		return;
 
+	/* Deleting it now would race with the write, so let that finish. */
+	job = g_hash_table_lookup(pending_writes, filename);
+	if (job != NULL)
+	{
+		job->uncache = TRUE;
+		return;
+	}
+
 	dirname = purple_buddy_icons_get_cache_dir();
 	path = g_build_filename(dirname, filename, NULL);
 
@@ -213,6 +495,256 @@ purple_buddy_icon_data_uncache_file(const char *filename)
 	g_free(path);
 }
 
+static void
+purple_buddy_icons_flush_writes(void)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	g_hash_table_iter_init(&iter, pending_writes);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+	{
+		PurpleBuddyIconWrite *job = value;
+		GError *error = NULL;
+
+		/* The job itself belongs to its task, which is still running. If
+		 * the worker has the file open this waits for it, and if it's done
+		 * already there is nothing left to write. */
+		g_hash_table_iter_remove(&iter);
+
+		if (!write_icon_file(job, &error))
+		{
+			purple_debug_error("buddyicon", "failed to save icon %s: %s",
+			                   job->path, error->message);
+			g_error_free(error);
+		}
+		else if (job->uncache)
+		{
+			purple_buddy_icon_data_uncache_file(job->filename);
+		}
+	}
+}
+
+static void
+purple_buddy_icon_eviction_free(gpointer data)
+{
+	PurpleBuddyIconEviction *eviction = data;
+
+	g_free(eviction->dirname);
+	g_hash_table_destroy(eviction->keep);
+	g_free(eviction);
+}
+
+static void
+purple_buddy_icon_cache_entry_clear(gpointer data)
+{
+	PurpleBuddyIconCacheEntry *entry = data;
+
+	g_free(entry->filename);
+}
+
+static gint
+purple_buddy_icon_cache_entry_compare(gconstpointer a, gconstpointer b)
+{
+	const PurpleBuddyIconCacheEntry *entry_a = a;
+	const PurpleBuddyIconCacheEntry *entry_b = b;
+
+	if (entry_a->mtime < entry_b->mtime)
+		return -1;
+
+	return (entry_a->mtime > entry_b->mtime) ? 1 : 0;
+}
+
+static void
+purple_buddy_icons_evict_thread(GTask *task, gpointer source_object,
+                                gpointer task_data, GCancellable *cancellable)
+{
+	PurpleBuddyIconEviction *eviction = task_data;
+	GArray *entries;
+	GPtrArray *evicted;
+	GDir *dir;
+	GError *error = NULL;
+	const gchar *name;
+	goffset total = 0;
+	guint i;
+
+	dir = g_dir_open(eviction->dirname, 0, &error);
+	if (dir == NULL)
+	{
+		g_task_return_error(task, error);
+		return;
+	}
+
+	entries = g_array_new(FALSE, FALSE, sizeof(PurpleBuddyIconCacheEntry));
+	g_array_set_clear_func(entries, purple_buddy_icon_cache_entry_clear);
+
+	while ((name = g_dir_read_name(dir)) != NULL)
+	{
+		PurpleBuddyIconCacheEntry entry;
+		const gchar *ext;
+		GStatBuf st;
+		gchar *path;
+
+		/* Skip anything that isn't ours, like the temporary files that
+		 * g_file_set_contents() writes before renaming them. */
+		ext = strchr(name, '.');
+		if (name[0] == '.' || (ext != NULL && strchr(ext + 1, '.') != NULL))
+			continue;
+
+		path = g_build_filename(eviction->dirname, name, NULL);
+		if (g_stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+		{
+			g_free(path);
+			continue;
+		}
+		g_free(path);
+
+		total += st.st_size;
+
+		if (g_hash_table_contains(eviction->keep, name))
+			continue;
+
+		entry.filename = g_strdup(name);
+		entry.mtime = st.st_mtime;
+		entry.size = st.st_size;
+		g_array_append_val(entries, entry);
+	}
+	g_dir_close(dir);
+
+	evicted = g_ptr_array_new_with_free_func(g_free);
+
+	if ((gsize)total > eviction->budget)
+	{
+		g_array_sort(entries, purple_buddy_icon_cache_entry_compare);
+
+		for (i = 0; i < entries->len && (gsize)total > eviction->budget; i++)
+		{
+			PurpleBuddyIconCacheEntry *entry;
+			gchar *path;
+
+			entry = &g_array_index(entries, PurpleBuddyIconCacheEntry, i);
+			path = g_build_filename(eviction->dirname, entry->filename, NULL);
+			if (g_unlink(path) == 0)
+			{
+				total -= entry->size;
+				g_ptr_array_add(evicted, g_strdup(entry->filename));
+			}
+			g_free(path);
+		}
+	}
+
+	g_array_free(entries, TRUE);
+
+	g_task_return_pointer(task, evicted,
+	                      (GDestroyNotify)g_ptr_array_unref);
+}
+
+static void
+purple_buddy_icons_evict_cb(GObject *source, GAsyncResult *result,
+                            gpointer data)
+{
+	GPtrArray *evicted;
+	GError *error = NULL;
+	guint i;
+
+	evicting = FALSE;
+
+	evicted = g_task_propagate_pointer(G_TASK(result), &error);
+	if (evicted == NULL)
+	{
+		if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+		{
+			purple_debug_warning("buddyicon", "unable to check icon cache: %s",
+			                     error->message);
+		}
+		g_error_free(error);
+		return;
+	}
+
+	if (evicted->len > 0)
+	{
+		purple_debug_info("buddyicon", "evicted %u icons from the cache",
+		                  evicted->len);
+	}
+
+	/* Icons that were loaded while the scan was running might have lost
+	 * their file, so write those back. */
+	for (i = 0; icon_data_cache != NULL && i < evicted->len; i++)
+	{
+		PurpleImage *img;
+
+		img = g_hash_table_lookup(icon_data_cache,
+		                          g_ptr_array_index(evicted, i));
+		if (img != NULL)
+			purple_buddy_icon_data_cache(img);
+	}
+
+	g_ptr_array_unref(evicted);
+}
+
+static void
+purple_buddy_icons_evict(void)
+{
+	PurpleBuddyIconEviction *eviction;
+	GHashTable *in_use[] = { icon_pin_cache, icon_data_cache, pending_writes };
+	GTask *task;
+	guint i;
+
+	if (cache_budget == 0 || !purple_buddy_icons_is_caching())
+		return;
+
+	if (evicting)
+	{
+		purple_buddy_icons_schedule_eviction();
+		return;
+	}
+
+	eviction = g_new0(PurpleBuddyIconEviction, 1);
+	eviction->dirname = g_strdup(purple_buddy_icons_get_cache_dir());
+	eviction->budget = cache_budget;
+	eviction->keep = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+	                                       NULL);
+
+	for (i = 0; i < G_N_ELEMENTS(in_use); i++)
+	{
+		GHashTableIter iter;
+		gpointer key;
+
+		g_hash_table_iter_init(&iter, in_use[i]);
+		while (g_hash_table_iter_next(&iter, &key, NULL))
+			g_hash_table_add(eviction->keep, g_strdup(key));
+	}
+
+	evicting = TRUE;
+
+	task = g_task_new(NULL, NULL, purple_buddy_icons_evict_cb, NULL);
+	g_task_set_source_tag(task, purple_buddy_icons_evict);
+	g_task_set_task_data(task, eviction, purple_buddy_icon_eviction_free);
+	g_task_run_in_thread(task, purple_buddy_icons_evict_thread);
+	g_object_unref(task);
+}
+
+static gboolean
+purple_buddy_icons_evict_timeout_cb(gpointer data)
+{
+	evict_timeout = 0;
+
+	purple_buddy_icons_evict();
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+purple_buddy_icons_schedule_eviction(void)
+{
+	if (cache_budget == 0 || evict_timeout != 0)
+		return;
+
+	evict_timeout = g_timeout_add_seconds(PURPLE_BUDDY_ICONS_EVICT_DELAY,
+	                                      purple_buddy_icons_evict_timeout_cb,
+	                                      NULL);
+}
+
 /*
  * End functions for dealing with the on-disk icon cache
  */
@@ -245,15 +777,15 @@ image_deleting_cb(gpointer _filename)
 }
 
 static PurpleImage *
-purple_buddy_icon_data_new(guchar *icon_data, size_t icon_len)
+purple_buddy_icon_data_new(GBytes *contents)
 {
 	PurpleImage *newimg, *oldimg;
 	const gchar *filename;
 
-	g_return_val_if_fail(icon_data != NULL, NULL);
-	g_return_val_if_fail(icon_len > 0, NULL);
+	g_return_val_if_fail(contents != NULL, NULL);
+	g_return_val_if_fail(g_bytes_get_size(contents) > 0, NULL);
 
-	newimg = purple_image_new_take_data(icon_data, icon_len);
+	newimg = purple_image_new_from_bytes(contents);
 	filename = purple_image_generate_filename(newimg);
 
 	/* TODO: Why is this function called for buddies without icons? If this is
@@ -270,6 +802,11 @@ purple_buddy_icon_data_new(guchar *icon_data, size_t icon_len)
 
 		/* This will take ownership of file and free it as needed */
 		g_hash_table_insert(icon_data_cache, g_strdup(filename), newimg);
+
+		g_object_set_data_full(G_OBJECT(newimg), "purple-buddyicon-path",
+			g_build_filename(purple_buddy_icons_get_cache_dir(), filename,
+			                 NULL),
+			g_free);
 	}
 
 	g_object_set_data_full(G_OBJECT(newimg), "purple-buddyicon-filename",
@@ -453,24 +990,17 @@ purple_buddy_icon_update(PurpleBuddyIcon *icon)
 	purple_buddy_icon_unref(icon);
 }
 
-void
-purple_buddy_icon_set_data(PurpleBuddyIcon *icon, guchar *data,
-                           size_t len, const char *checksum)
+static void
+purple_buddy_icon_set_contents(PurpleBuddyIcon *icon, GBytes *contents,
+                               const char *checksum)
 {
 	PurpleImage *old_img;
 
-	g_return_if_fail(icon != NULL);
-
 	old_img = icon->img;
 	icon->img = NULL;
 
-	if (data != NULL)
-	{
-		if (len > 0)
-			icon->img = purple_buddy_icon_data_new(data, len);
-		else
-			g_free(data);
-	}
+	if (contents != NULL)
+		icon->img = purple_buddy_icon_data_new(contents);
 
 	g_free(icon->checksum);
 	icon->checksum = g_strdup(checksum);
@@ -481,6 +1011,37 @@ purple_buddy_icon_set_data(PurpleBuddyIcon *icon, guchar *data,
 		g_object_unref(old_img);
 }
 
+/* Wraps data whose ownership was passed to us, freeing it if it's empty. */
+static GBytes *
+icon_data_to_bytes(guchar *icon_data, size_t icon_len)
+{
+	if (icon_data == NULL)
+		return NULL;
+
+	if (icon_len == 0)
+	{
+		g_free(icon_data);
+		return NULL;
+	}
+
+	return g_bytes_new_take(icon_data, icon_len);
+}
+
+void
+purple_buddy_icon_set_data(PurpleBuddyIcon *icon, guchar *data,
+                           size_t len, const char *checksum)
+{
+	GBytes *contents;
+
+	g_return_if_fail(icon != NULL);
+
+	contents = icon_data_to_bytes(data, len);
+	purple_buddy_icon_set_contents(icon, contents, checksum);
+
+	if (contents != NULL)
+		g_bytes_unref(contents);
+}
+
 gboolean
 purple_buddy_icon_save_to_filename(PurpleBuddyIcon *icon,
                                    const gchar *filename, GError **error)
@@ -606,6 +1167,14 @@ purple_buddy_icons_set_for_user(PurpleAccount *account, const char *username,
 	}
 }
 
+PurpleImage *
+purple_buddy_icon_get_image(PurpleBuddyIcon *icon)
+{
+	g_return_val_if_fail(icon != NULL, NULL);
+
+	return icon->img;
+}
+
 const gchar *
 purple_buddy_icon_get_full_path(PurpleBuddyIcon *icon)
 {
@@ -616,7 +1185,9 @@ purple_buddy_icon_get_full_path(PurpleBuddyIcon *icon)
 	if (icon->img == NULL)
 		return NULL;
 
-	path = purple_image_get_path(icon->img);
+	path = g_object_get_data(G_OBJECT(icon->img), "purple-buddyicon-path");
+	if (path == NULL)
+		path = purple_image_get_path(icon->img);
 	if (!g_file_test(path, G_FILE_TEST_EXISTS))
 	{
 		return NULL;
@@ -631,23 +1202,6 @@ purple_buddy_icons_get_checksum_for_user(PurpleBuddy *buddy)
 	                                    "icon_checksum");
 }
 
-static gboolean
-read_icon_file(const char *path, guchar **data, size_t *len)
-{
-	GError *err = NULL;
-
-	if (!g_file_get_contents(path, (gchar **)data, len, &err))
-	{
-		purple_debug_error("buddyicon", "Error reading %s: %s\n",
-		                   path, err->message);
-		g_error_free(err);
-
-		return FALSE;
-	}
-
-	return TRUE;
-}
-
 PurpleBuddyIcon *
 purple_buddy_icons_find(PurpleAccount *account, const char *username)
 {
@@ -664,11 +1218,8 @@ purple_buddy_icons_find(PurpleAccount *account, const char *username)
 		/* The icon is not currently cached in memory--try reading from disk */
 		PurpleBuddy *b = purple_blist_find_buddy(account, username);
 		const char *protocol_icon_file;
-		const char *dirname;
 		gboolean caching;
-		gchar *path;
-		guchar *data;
-		size_t len;
+		GBytes *contents;
 
 		if (!b)
 			return NULL;
@@ -678,29 +1229,29 @@ purple_buddy_icons_find(PurpleAccount *account, const char *username)
 		if (protocol_icon_file == NULL)
 			return NULL;
 
-		dirname = purple_buddy_icons_get_cache_dir();
-
 		caching = purple_buddy_icons_is_caching();
 		/* By disabling caching temporarily, we avoid a loop
 		 * and don't have to add special code through several
 		 * functions. */
 		purple_buddy_icons_set_caching(FALSE);
 
-		path = g_build_filename(dirname, protocol_icon_file, NULL);
-		if (read_icon_file(path, &data, &len)) {
+		contents = read_cached_icon_file(protocol_icon_file);
+		if (contents != NULL) {
 			const char *checksum;
 
 			icon = purple_buddy_icon_create(account, username);
 			icon->img = NULL;
 			checksum = purple_blist_node_get_string((PurpleBlistNode *)b,
 			                                        "icon_checksum");
-			purple_buddy_icon_set_data(icon, data, len, checksum);
+			purple_buddy_icon_set_contents(icon, contents, checksum);
+			g_bytes_unref(contents);
 		} else {
+			/* The file may have been evicted from the cache.  Dropping
+			 * the checksum makes the protocol fetch the icon again. */
+			unref_filename(protocol_icon_file);
 			delete_buddy_icon_settings((PurpleBlistNode *)b, "buddy_icon");
 		}
 
-		g_free(path);
-
 		purple_buddy_icons_set_caching(caching);
 	}
 
@@ -712,10 +1263,7 @@ purple_buddy_icons_find_account_icon(PurpleAccount *account)
 {
 	PurpleImage *img;
 	const char *account_icon_file;
-	const char *dirname;
-	char *path;
-	guchar *data;
-	size_t len;
+	GBytes *contents;
 
 	g_return_val_if_fail(account != NULL, NULL);
 
@@ -730,30 +1278,143 @@ purple_buddy_icons_find_account_icon(PurpleAccount *account)
 	if (account_icon_file == NULL)
 		return NULL;
 
-	dirname = purple_buddy_icons_get_cache_dir();
-	path = g_build_filename(dirname, account_icon_file, NULL);
-
-	if (read_icon_file(path, &data, &len)) {
-		g_free(path);
-		img = purple_buddy_icons_set_account_icon(account, data, len);
+	contents = read_cached_icon_file(account_icon_file);
+	if (contents != NULL) {
+		img = set_account_icon_contents(account, contents);
+		g_bytes_unref(contents);
 		g_object_ref(img);
 		return img;
 	}
-	g_free(path);
 
 	return NULL;
 }
 
+static void
+find_account_icon_cb(GObject *source, GAsyncResult *result, gpointer data)
+{
+	GTask *task = data;
+	PurpleAccount *account = g_task_get_source_object(task);
+	const gchar *filename = g_task_get_task_data(task);
+	PurpleImage *loaded, *img;
+	GError *error = NULL;
+
+	loaded = purple_image_new_from_file_finish(result, &error);
+	if (loaded == NULL) {
+		g_task_return_error(task, error);
+		g_object_unref(task);
+		return;
+	}
+
+	/* The icon may have been loaded or replaced while we were reading, in
+	 * which case the cached one wins. */
+	img = g_hash_table_lookup(pointer_icon_cache, account);
+	if (img == NULL && purple_strequal(filename,
+	        purple_account_get_string(account, "buddy_icon", NULL)))
+	{
+		GBytes *contents = purple_image_get_contents(loaded);
+
+		/* The modification time is what eviction goes by, so bump it. */
+		g_utime(purple_image_get_path(loaded), NULL);
+
+		img = set_account_icon_contents(account, contents);
+		g_bytes_unref(contents);
+	}
+
+	if (img != NULL)
+		g_task_return_pointer(task, g_object_ref(img), g_object_unref);
+	else
+		g_task_return_pointer(task, NULL, NULL);
+
+	g_object_unref(loaded);
+	g_object_unref(task);
+}
+
+void
+purple_buddy_icons_find_account_icon_async(PurpleAccount *account,
+                                           GCancellable *cancellable,
+                                           GAsyncReadyCallback callback,
+                                           gpointer data)
+{
+	GTask *task;
+	PurpleImage *img;
+	PurpleBuddyIconWrite *job;
+	const char *account_icon_file;
+	gchar *path;
+
+	g_return_if_fail(PURPLE_IS_ACCOUNT(account));
+
+	task = g_task_new(account, cancellable, callback, data);
+	g_task_set_source_tag(task, purple_buddy_icons_find_account_icon_async);
+
+	img = g_hash_table_lookup(pointer_icon_cache, account);
+	if (img) {
+		g_task_return_pointer(task, g_object_ref(img), g_object_unref);
+		g_object_unref(task);
+		return;
+	}
+
+	account_icon_file = purple_account_get_string(account, "buddy_icon", NULL);
+	if (account_icon_file == NULL) {
+		g_task_return_pointer(task, NULL, NULL);
+		g_object_unref(task);
+		return;
+	}
+
+	/* An icon that hasn't hit the disk yet is already in memory. */
+	job = g_hash_table_lookup(pending_writes, account_icon_file);
+	if (job != NULL) {
+		img = set_account_icon_contents(account, job->contents);
+		g_task_return_pointer(task, g_object_ref(img), g_object_unref);
+		g_object_unref(task);
+		return;
+	}
+
+	g_task_set_task_data(task, g_strdup(account_icon_file), g_free);
+
+	path = g_build_filename(purple_buddy_icons_get_cache_dir(),
+	                        account_icon_file, NULL);
+	purple_image_new_from_file_async(path, cancellable, find_account_icon_cb,
+	                                 task);
+	g_free(path);
+}
+
+PurpleImage *
+purple_buddy_icons_find_account_icon_finish(PurpleAccount *account,
+                                            GAsyncResult *result,
+                                            GError **error)
+{
+	g_return_val_if_fail(g_task_is_valid(result, account), NULL);
+	g_return_val_if_fail(g_async_result_is_tagged(result,
+	                     purple_buddy_icons_find_account_icon_async), NULL);
+
+	return g_task_propagate_pointer(G_TASK(result), error);
+}
+
 PurpleImage *
 purple_buddy_icons_set_account_icon(PurpleAccount *account,
                                     guchar *icon_data, size_t icon_len)
+{
+	PurpleImage *img;
+	GBytes *contents;
+
+	contents = icon_data_to_bytes(icon_data, icon_len);
+	img = set_account_icon_contents(account, contents);
+
+	if (contents != NULL)
+		g_bytes_unref(contents);
+
+	return img;
+}
+
+static PurpleImage *
+set_account_icon_contents(PurpleAccount *account, GBytes *contents)
 {
 	PurpleImage *old_img;
 	PurpleImage *img = NULL;
 	char *old_icon;
 
-	if (icon_data != NULL && icon_len > 0) {
-		img = purple_buddy_icon_data_new(icon_data, icon_len);
+	if (contents != NULL) {
+		img = purple_buddy_icon_data_new(contents);
 	}
 
 	old_icon = g_strdup(purple_account_get_string(account, "buddy_icon", NULL));
@@ -764,6 +1425,7 @@ purple_buddy_icons_set_account_icon(PurpleAccount *account,
 		purple_account_set_string(account, "buddy_icon", filename);
 		purple_account_set_int(account, "buddy_icon_timestamp", time(NULL));
 		ref_filename(filename);
+		pin_filename(filename);
 	}
 	else
 	{
@@ -771,6 +1433,7 @@ purple_buddy_icons_set_account_icon(PurpleAccount *account,
 		purple_account_set_int(account, "buddy_icon_timestamp", 0);
 	}
 	unref_filename(old_icon);
+	unpin_filename(old_icon);
 
 	old_img = g_hash_table_lookup(pointer_icon_cache, account);
 
@@ -837,11 +1500,9 @@ purple_buddy_icons_node_has_custom_icon(PurpleBlistNode *node)
 PurpleImage *
 purple_buddy_icons_node_find_custom_icon(PurpleBlistNode *node)
 {
-	char *path;
-	size_t len;
-	guchar *data;
+	GBytes *contents;
 	PurpleImage *img;
-	const char *custom_icon_file, *dirname;
+	const char *custom_icon_file;
 
 	g_return_val_if_fail(node != NULL, NULL);
 
@@ -857,16 +1518,13 @@ purple_buddy_icons_node_find_custom_icon(PurpleBlistNode *node)
 	if (custom_icon_file == NULL)
 		return NULL;
 
-	dirname = purple_buddy_icons_get_cache_dir();
-	path = g_build_filename(dirname, custom_icon_file, NULL);
-
-	if (read_icon_file(path, &data, &len)) {
-		g_free(path);
-		img = purple_buddy_icons_node_set_custom_icon(node, data, len);
+	contents = read_cached_icon_file(custom_icon_file);
+	if (contents != NULL) {
+		img = set_custom_icon_contents(node, contents);
+		g_bytes_unref(contents);
 		g_object_ref(img);
 		return img;
 	}
-	g_free(path);
 
 	return NULL;
 }
@@ -874,14 +1532,29 @@ purple_buddy_icons_node_find_custom_icon(PurpleBlistNode *node)
 PurpleImage *
 purple_buddy_icons_node_set_custom_icon(PurpleBlistNode *node,
                                         guchar *icon_data, size_t icon_len)
+{
+	PurpleImage *img;
+	GBytes *contents;
+
+	g_return_val_if_fail(node != NULL, NULL);
+
+	contents = icon_data_to_bytes(icon_data, icon_len);
+	img = set_custom_icon_contents(node, contents);
+
+	if (contents != NULL)
+		g_bytes_unref(contents);
+
+	return img;
+}
+
+static PurpleImage *
+set_custom_icon_contents(PurpleBlistNode *node, GBytes *contents)
 {
 	char *old_icon;
 	PurpleConversationManager *manager = NULL;
 	PurpleImage *old_img;
 	PurpleImage *img = NULL;
 
-	g_return_val_if_fail(node != NULL, NULL);
-
 	if (!PURPLE_IS_META_CONTACT(node) &&
 	    !PURPLE_IS_CHAT(node) &&
 	    !PURPLE_IS_GROUP(node)) {
@@ -890,8 +1563,8 @@ purple_buddy_icons_node_set_custom_icon(PurpleBlistNode *node,
 
 	old_img = g_hash_table_lookup(pointer_icon_cache, node);
 
-	if (icon_data != NULL && icon_len > 0) {
-		img = purple_buddy_icon_data_new(icon_data, icon_len);
+	if (contents != NULL) {
+		img = purple_buddy_icon_data_new(contents);
 	}
 
 	old_icon = g_strdup(purple_blist_node_get_string(node,
@@ -902,10 +1575,12 @@ purple_buddy_icons_node_set_custom_icon(PurpleBlistNode *node,
 		purple_blist_node_set_string(node, "custom_buddy_icon",
 		                             filename);
 		ref_filename(filename);
+		pin_filename(filename);
 	} else {
 		purple_blist_node_remove_setting(node, "custom_buddy_icon");
 	}
 	unref_filename(old_icon);
+	unpin_filename(old_icon);
 
 	if (img)
 		g_hash_table_insert(pointer_icon_cache, node, img);
@@ -971,8 +1646,8 @@ PurpleImage *
 purple_buddy_icons_node_set_custom_icon_from_file(PurpleBlistNode *node,
                                                   const gchar *filename)
 {
-	size_t len = 0;
-	guchar *data = NULL;
+	PurpleImage *img;
+	GBytes *contents = NULL;
 
 	g_return_val_if_fail(node != NULL, NULL);
 
@@ -983,12 +1658,18 @@ purple_buddy_icons_node_set_custom_icon_from_file(PurpleBlistNode *node,
 	}
 
 	if (filename != NULL) {
-		if (!read_icon_file(filename, &data, &len)) {
+		contents = read_icon_file(filename);
+		if (contents == NULL) {
 			return NULL;
 		}
 	}
 
-	return purple_buddy_icons_node_set_custom_icon(node, data, len);
+	img = set_custom_icon_contents(node, contents);
+
+	if (contents != NULL)
+		g_bytes_unref(contents);
+
+	return img;
 }
 
 static void
@@ -1012,14 +1693,12 @@ _purple_buddy_icons_account_loaded_cb_helper(PurpleAccount *account,
 
 	filename = purple_account_get_string(account, "buddy_icon", NULL);
 	if(filename != NULL) {
-		gchar *path = g_build_filename(dirname, filename, NULL);
-
-		if(!g_file_test(path, G_FILE_TEST_EXISTS)) {
+		if(!icon_file_exists(dirname, filename)) {
 			purple_account_set_string(account, "buddy_icon", NULL);
 		} else {
 			ref_filename(filename);
+			pin_filename(filename);
 		}
-		g_free(path);
 	}
 }
 
@@ -1049,8 +1728,7 @@ _purple_buddy_icons_blist_loaded_cb(void)
 			filename = purple_blist_node_get_string(node, "buddy_icon");
 			if (filename != NULL)
 			{
-				char *path = g_build_filename(dirname, filename, NULL);
-				if (!g_file_test(path, G_FILE_TEST_EXISTS))
+				if (!icon_file_exists(dirname, filename))
 				{
 					purple_blist_node_remove_setting(node,
 					                                 "buddy_icon");
@@ -1059,7 +1737,6 @@ _purple_buddy_icons_blist_loaded_cb(void)
 				}
 				else
 					ref_filename(filename);
-				g_free(path);
 			}
 		}
 		else if (PURPLE_IS_META_CONTACT(node) ||
@@ -1071,19 +1748,23 @@ _purple_buddy_icons_blist_loaded_cb(void)
 			filename = purple_blist_node_get_string(node, "custom_buddy_icon");
 			if (filename != NULL)
 			{
-				char *path = g_build_filename(dirname, filename, NULL);
-				if (!g_file_test(path, G_FILE_TEST_EXISTS))
+				if (!icon_file_exists(dirname, filename))
 				{
 					purple_blist_node_remove_setting(node,
 					                                 "custom_buddy_icon");
 				}
 				else
+				{
 					ref_filename(filename);
-				g_free(path);
+					pin_filename(filename);
+				}
 			}
 		}
 		node = purple_blist_node_next(node, TRUE);
 	}
+
+	/* Now that everything in use is known, trim the cache. */
+	purple_buddy_icons_schedule_eviction();
 }
 
 void
@@ -1113,6 +1794,23 @@ purple_buddy_icons_get_cache_dir(void)
 	return cache_dir;
 }
 
+void
+purple_buddy_icons_set_cache_budget(gsize budget)
+{
+	cache_budget = budget;
+
+	if (budget == 0)
+		g_clear_handle_id(&evict_timeout, g_source_remove);
+	else if (icon_data_cache != NULL)
+		purple_buddy_icons_schedule_eviction();
+}
+
+gsize
+purple_buddy_icons_get_cache_budget(void)
+{
+	return cache_budget;
+}
+
 void *
 purple_buddy_icons_get_handle()
 {
@@ -1133,6 +1831,9 @@ purple_buddy_icons_init()
 	icon_file_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
 	                                        g_free, NULL);
 	pointer_icon_cache = g_hash_table_new(g_direct_hash, g_direct_equal);
+	pending_writes = g_hash_table_new(g_str_hash, g_str_equal);
+	icon_pin_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+	                                       g_free, NULL);
 
 	if (!cache_dir)
 		cache_dir = g_build_filename(purple_cache_dir(), "icons", NULL);
@@ -1143,10 +1844,17 @@ purple_buddy_icons_uninit()
 {
 	purple_signals_disconnect_by_handle(purple_buddy_icons_get_handle());
 
+	g_clear_handle_id(&evict_timeout, g_source_remove);
+
+	/* Don't lose icons that are still on their way to the disk. */
+	purple_buddy_icons_flush_writes();
+	g_clear_pointer(&pending_writes, g_hash_table_destroy);
+
 	g_hash_table_destroy(account_cache);
 	g_hash_table_destroy(icon_data_cache);
 	g_hash_table_destroy(icon_file_cache);
 	g_hash_table_destroy(pointer_icon_cache);
+	g_clear_pointer(&icon_pin_cache, g_hash_table_destroy);
 	g_free(cache_dir);
 
 	cache_dir = NULL;
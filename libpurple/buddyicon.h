@@ -43,6 +43,16 @@ typedef struct _PurpleBuddyIcon PurpleBuddyIcon;
 
 #define PURPLE_TYPE_BUDDY_ICON_SPEC  (purple_buddy_icon_spec_get_type())
 
+/**
+ * PURPLE_BUDDY_ICONS_DEFAULT_CACHE_BUDGET:
+ *
+ * The number of bytes the buddy icon cache directory may use by default.  See
+ * purple_buddy_icons_set_cache_budget().
+ *
+ * Since: 3.0.0
+ */
+#define PURPLE_BUDDY_ICONS_DEFAULT_CACHE_BUDGET (64 * 1024 * 1024)
+
 typedef struct _PurpleBuddyIconSpec PurpleBuddyIconSpec;
 
 #include "account.h"
@@ -246,6 +256,20 @@ GInputStream *purple_buddy_icon_get_stream(PurpleBuddyIcon *icon);
  */
 const char *purple_buddy_icon_get_extension(const PurpleBuddyIcon *icon);
 
+/**
+ * purple_buddy_icon_get_image:
+ * @icon: The buddy icon.
+ *
+ * Returns the image that holds the buddy icon's data.  Images are shared
+ * between every icon with the same contents.
+ *
+ * Returns: (transfer none) (nullable): The #PurpleImage, or %NULL if the
+ *          image data has disappeared.
+ *
+ * Since: 3.0.0
+ */
+PurpleImage *purple_buddy_icon_get_image(PurpleBuddyIcon *icon);
+
 /**
  * purple_buddy_icon_get_full_path:
  * @icon: The buddy icon
@@ -325,6 +349,43 @@ purple_buddy_icons_find(PurpleAccount *account, const char *username);
 PurpleImage *
 purple_buddy_icons_find_account_icon(PurpleAccount *account);
 
+/**
+ * purple_buddy_icons_find_account_icon_async:
+ * @account: The account.
+ * @cancellable: (nullable): A #GCancellable or %NULL.
+ * @callback: (scope async): The callback to call when the icon is available.
+ * @data: User data to pass to @callback.
+ *
+ * Like purple_buddy_icons_find_account_icon(), but reads the icon from the
+ * cache without blocking.  If the icon is already in memory @callback is
+ * still called from the main loop.
+ *
+ * Since: 3.0.0
+ */
+void
+purple_buddy_icons_find_account_icon_async(PurpleAccount *account,
+                                           GCancellable *cancellable,
+                                           GAsyncReadyCallback callback,
+                                           gpointer data);
+
+/**
+ * purple_buddy_icons_find_account_icon_finish:
+ * @account: The account.
+ * @result: The #GAsyncResult passed to the callback.
+ * @error: (optional) (out): An optional return address for a #GError.
+ *
+ * Finishes a lookup started with purple_buddy_icons_find_account_icon_async().
+ *
+ * Returns: (transfer full) (nullable): The account's buddy icon image, or
+ *          %NULL if it has none or it couldn't be read.
+ *
+ * Since: 3.0.0
+ */
+PurpleImage *
+purple_buddy_icons_find_account_icon_finish(PurpleAccount *account,
+                                            GAsyncResult *result,
+                                            GError **error);
+
 /**
  * purple_buddy_icons_set_account_icon:
  * @account:   The account for which to set a custom icon.
@@ -459,6 +520,35 @@ void purple_buddy_icons_set_cache_dir(const char *cache_dir);
  */
 const char *purple_buddy_icons_get_cache_dir(void);
 
+/**
+ * purple_buddy_icons_set_cache_budget:
+ * @budget: The number of bytes the cache directory may use, or 0 for no limit.
+ *
+ * Sets how much disk space the buddy icon cache may use.  When the cache
+ * directory grows past @budget, the least recently used buddy icons that
+ * aren't currently loaded are deleted.  They will be fetched from the server
+ * again when they're needed.  Account icons and custom buddy icons are never
+ * deleted to stay within the budget.
+ *
+ * The default is #PURPLE_BUDDY_ICONS_DEFAULT_CACHE_BUDGET.
+ *
+ * Since: 3.0.0
+ */
+void purple_buddy_icons_set_cache_budget(gsize budget);
+
+/**
+ * purple_buddy_icons_get_cache_budget:
+ *
+ * Gets how much disk space the buddy icon cache may use.  See
+ * purple_buddy_icons_set_cache_budget().
+ *
+ * Returns: The number of bytes the cache directory may use, or 0 if there is
+ *          no limit.
+ *
+ * Since: 3.0.0
+ */
+gsize purple_buddy_icons_get_cache_budget(void);
+
 /**
  * purple_buddy_icons_get_handle:
  *
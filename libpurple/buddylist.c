@@ -29,6 +29,7 @@
 #include "notify.h"
 #include "prefs.h"
 #include "purpleaccountmanager.h"
+#include "purplecontactmanager.h"
 #include "purpleprivate.h"
 #include "purpleprotocol.h"
 #include "purpleprotocolchat.h"
@@ -991,6 +992,7 @@ void purple_blist_add_buddy(PurpleBuddy *buddy, PurpleMetaContact *contact, Purp
 	PurpleAccount *account;
 	struct _purple_hbuddy *hb, *hb2;
 	GHashTable *account_buddies;
+	gboolean moving;
 
 	g_return_if_fail(PURPLE_IS_BUDDY_LIST(purplebuddylist));
 	g_return_if_fail(PURPLE_IS_BUDDY(buddy));
@@ -1028,6 +1030,9 @@ void purple_blist_add_buddy(PurpleBuddy *buddy, PurpleMetaContact *contact, Purp
 
 	cnode = PURPLE_BLIST_NODE(c);
 
+	/* A buddy that is already in the list is only being moved. */
+	moving = (bnode->parent != NULL);
+
 	if (bnode->parent) {
 		contact_counter = PURPLE_COUNTING_NODE(bnode->parent);
 		group_counter = PURPLE_COUNTING_NODE(bnode->parent->parent);
@@ -1144,6 +1149,11 @@ void purple_blist_add_buddy(PurpleBuddy *buddy, PurpleMetaContact *contact, Purp
 		}
 	}
 
+	if (!moving) {
+		purple_contact_manager_add_buddy(purple_contact_manager_get_default(),
+		                                 buddy);
+	}
+
 	/* Signal that the buddy has been added */
 	purple_signal_emit(purple_blist_get_handle(), "blist-node-added",
 			PURPLE_BLIST_NODE(buddy));
@@ -1514,6 +1524,9 @@ void purple_blist_remove_buddy(PurpleBuddy *buddy)
 		klass->remove_node(purplebuddylist, node);
 	}
 
+	purple_contact_manager_remove_buddy(purple_contact_manager_get_default(),
+	                                    buddy);
+
 	/* Signal that the buddy has been removed before freeing the memory for it */
 	purple_signal_emit(purple_blist_get_handle(), "blist-node-removed",
 			PURPLE_BLIST_NODE(buddy));
@@ -182,6 +182,7 @@ purple_core_init(PurpleUiInfo *ui_info) {
 	purple_whiteboard_manager_startup();
 	purple_blist_init();
 	purple_history_manager_startup();
+	purple_avatar_fetcher_startup();
 	purple_network_init();
 	purple_proxy_init();
 	purple_stun_init();
@@ -231,6 +232,7 @@ purple_core_quit(void)
 
 	/* Save .xml files, remove signals, etc. */
 	purple_idle_uninit();
+	purple_avatar_fetcher_shutdown();
 	purple_whiteboard_manager_shutdown();
 	purple_conversation_manager_shutdown();
 	purple_conversations_uninit();
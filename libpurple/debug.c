@@ -20,9 +20,14 @@
  * along with this program; if not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <stdio.h>
+#include <string.h>
+
 #include "debug.h"
 #include "prefs.h"
 
+#define PURPLE_DEBUG_RING_DEFAULT_SIZE (256 * 1024)
+
 /*
  * These determine whether verbose or unsafe debugging are desired.  I
  * don't want to make these purple preferences because their values should
@@ -31,15 +36,328 @@
 static gboolean debug_verbose = FALSE;
 static gboolean debug_unsafe = FALSE;
 
+/*
+ * The level gating.  These are read on every call to purple_debug() from
+ * whatever thread is logging, so the scalars are accessed atomically and the
+ * per-category overrides are only consulted when at least one is set.
+ */
+static gint debug_level = PURPLE_DEBUG_ALL;
+static gint debug_have_category_levels = 0;
+static GHashTable *debug_category_levels = NULL;
+static GRWLock debug_category_lock;
+
+/*
+ * The ring buffer of recent records.  Each record is a PurpleDebugRingHeader
+ * followed by the category and message bytes, without terminators.  Records
+ * are written contiguously, wrapping at the end of the buffer, and the oldest
+ * records are dropped to make room for new ones.
+ */
+typedef struct {
+	gint64 timestamp;
+	guint32 message_len;
+	guint16 category_len;
+	guint8 level;
+	guint8 padding;
+} PurpleDebugRingHeader;
+
+static GMutex debug_ring_lock;
+static guint8 *debug_ring = NULL;
+static gsize debug_ring_size = 0;
+static gsize debug_ring_head = 0;
+static gsize debug_ring_used = 0;
+static gint debug_ring_level = PURPLE_DEBUG_WARNING;
+
+/*
+ * The debug sink.  Every thread that logs gets a shard, which is a single
+ * producer, single consumer queue of records.  The owning thread only ever
+ * writes tail and the main loop only ever writes head, so neither side needs
+ * a lock.  debug_shards_lock only protects the list of shards, which changes
+ * when a thread logs for the first time or its shard is reaped after it
+ * exited.
+ */
+#define PURPLE_DEBUG_SHARD_SIZE (4096)
+
+typedef struct {
+	PurpleDebugRecord *records[PURPLE_DEBUG_SHARD_SIZE];
+	guint head;
+	guint tail;
+	guint dropped;
+	gint orphaned;
+	guint thread_id;
+} PurpleDebugShard;
+
+static void purple_debug_shard_orphan(gpointer data);
+static void purple_debug_sink_flush_to_stderr(void);
+
+static GPrivate debug_shard_key = G_PRIVATE_INIT(purple_debug_shard_orphan);
+static GMutex debug_shards_lock;
+static GList *debug_shards = NULL;
+static guint debug_next_thread_id = 0;
+
+static PurpleDebugSinkFunc debug_sink_func = NULL;
+static gpointer debug_sink_data = NULL;
+static GDestroyNotify debug_sink_destroy = NULL;
+static gint debug_have_sink = 0;
+static gint debug_sink_pending = 0;
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static gboolean
+purple_debug_log_wanted(PurpleDebugLevel level, const gchar *category) {
+	gint threshold = g_atomic_int_get(&debug_level);
+
+	if(category != NULL && g_atomic_int_get(&debug_have_category_levels)) {
+		gpointer value = NULL;
+
+		g_rw_lock_reader_lock(&debug_category_lock);
+		if(debug_category_levels != NULL &&
+		   g_hash_table_lookup_extended(debug_category_levels, category,
+		                                NULL, &value))
+		{
+			threshold = GPOINTER_TO_INT(value);
+		}
+		g_rw_lock_reader_unlock(&debug_category_lock);
+	}
+
+	return (gint)level >= threshold;
+}
+
+static gboolean
+purple_debug_ring_wanted(PurpleDebugLevel level) {
+	/* debug_ring_size is only changed with the lock held, but a stale read
+	 * here only means we format one record too many or too few. */
+	return debug_ring_size > 0 &&
+	       (gint)level >= g_atomic_int_get(&debug_ring_level);
+}
+
+/* Copies len bytes into the ring at offset, wrapping at the end. */
+static void
+purple_debug_ring_write(gsize offset, gconstpointer data, gsize len) {
+	gsize first = MIN(len, debug_ring_size - offset);
+
+	memcpy(debug_ring + offset, data, first);
+	memcpy(debug_ring, (const guint8 *)data + first, len - first);
+}
+
+/* Copies len bytes out of the ring at offset, wrapping at the end. */
+static void
+purple_debug_ring_read(gsize offset, gpointer data, gsize len) {
+	gsize first = MIN(len, debug_ring_size - offset);
+
+	memcpy(data, debug_ring + offset, first);
+	memcpy((guint8 *)data + first, debug_ring, len - first);
+}
+
+static void
+purple_debug_ring_push(PurpleDebugLevel level, const gchar *category,
+                       const gchar *message)
+{
+	PurpleDebugRingHeader header;
+	gsize category_len = 0, message_len = 0, needed = 0, tail = 0;
+
+	if(category == NULL) {
+		category = "";
+	}
+
+	category_len = MIN(strlen(category), G_MAXUINT16);
+	message_len = strlen(message);
+
+	header.timestamp = g_get_real_time();
+	header.level = level;
+	header.padding = 0;
+	header.category_len = category_len;
+
+	g_mutex_lock(&debug_ring_lock);
+
+	if(debug_ring_size <= sizeof(header) + category_len) {
+		g_mutex_unlock(&debug_ring_lock);
+
+		return;
+	}
+
+	/* Truncate anything that would not fit in the ring on its own. */
+	message_len = MIN(message_len,
+	                  debug_ring_size - sizeof(header) - category_len);
+	header.message_len = message_len;
+	needed = sizeof(header) + category_len + message_len;
+
+	/* Drop the oldest records until the new one fits. */
+	while(debug_ring_size - debug_ring_used < needed) {
+		PurpleDebugRingHeader oldest;
+		gsize oldest_len = 0;
+
+		purple_debug_ring_read(debug_ring_head, &oldest, sizeof(oldest));
+		oldest_len = sizeof(oldest) + oldest.category_len +
+		             oldest.message_len;
+
+		debug_ring_head = (debug_ring_head + oldest_len) % debug_ring_size;
+		debug_ring_used -= oldest_len;
+	}
+
+	tail = (debug_ring_head + debug_ring_used) % debug_ring_size;
+	purple_debug_ring_write(tail, &header, sizeof(header));
+	tail = (tail + sizeof(header)) % debug_ring_size;
+	purple_debug_ring_write(tail, category, category_len);
+	tail = (tail + category_len) % debug_ring_size;
+	purple_debug_ring_write(tail, message, message_len);
+
+	debug_ring_used += needed;
+
+	g_mutex_unlock(&debug_ring_lock);
+}
+
+static PurpleDebugRecord *
+purple_debug_record_new(gint64 timestamp, guint thread_id,
+                        PurpleDebugLevel level, const gchar *category,
+                        const gchar *message)
+{
+	PurpleDebugRecord *record = NULL;
+	gsize category_len = 0, message_len = 0;
+	gchar *strings = NULL;
+
+	if(category == NULL) {
+		category = "";
+	}
+
+	category_len = strlen(category) + 1;
+	message_len = strlen(message) + 1;
+
+	/* The strings live in the same allocation so a single g_free() releases
+	 * everything. */
+	record = g_malloc(sizeof(PurpleDebugRecord) + category_len + message_len);
+	strings = (gchar *)(record + 1);
+	memcpy(strings, category, category_len);
+	memcpy(strings + category_len, message, message_len);
+
+	record->timestamp = timestamp;
+	record->thread_id = thread_id;
+	record->level = level;
+	record->category = strings;
+	record->message = strings + category_len;
+
+	return record;
+}
+
+static void
+purple_debug_shard_orphan(gpointer data) {
+	PurpleDebugShard *shard = data;
+
+	/* The thread is exiting, the main loop frees the shard once it has been
+	 * drained. */
+	g_atomic_int_set(&shard->orphaned, 1);
+}
+
+static PurpleDebugShard *
+purple_debug_shard_get(void) {
+	PurpleDebugShard *shard = g_private_get(&debug_shard_key);
+
+	if(shard == NULL) {
+		shard = g_new0(PurpleDebugShard, 1);
+
+		g_mutex_lock(&debug_shards_lock);
+		shard->thread_id = ++debug_next_thread_id;
+		debug_shards = g_list_prepend(debug_shards, shard);
+		g_mutex_unlock(&debug_shards_lock);
+
+		g_private_set(&debug_shard_key, shard);
+	}
+
+	return shard;
+}
+
+static gboolean
+purple_debug_sink_dispatch_cb(G_GNUC_UNUSED gpointer data) {
+	purple_debug_sink_flush();
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+purple_debug_sink_push(PurpleDebugLevel level, const gchar *category,
+                       const gchar *message)
+{
+	PurpleDebugShard *shard = purple_debug_shard_get();
+	guint head = 0, tail = shard->tail;
+
+	head = (guint)g_atomic_int_get(&shard->head);
+	if(tail - head >= PURPLE_DEBUG_SHARD_SIZE) {
+		g_atomic_int_inc(&shard->dropped);
+
+		return;
+	}
+
+	shard->records[tail % PURPLE_DEBUG_SHARD_SIZE] =
+		purple_debug_record_new(g_get_monotonic_time(), shard->thread_id,
+		                        level, category, message);
+
+	/* Publish the record before asking the main loop to come get it. */
+	g_atomic_int_set(&shard->tail, tail + 1);
+
+	if(g_atomic_int_compare_and_exchange(&debug_sink_pending, 0, 1)) {
+		g_idle_add(purple_debug_sink_dispatch_cb, NULL);
+	}
+}
+
+static void
+purple_debug_shard_drain(PurpleDebugShard *shard, GPtrArray *records) {
+	guint head = shard->head;
+	guint tail = (guint)g_atomic_int_get(&shard->tail);
+	guint dropped = 0;
+
+	while(head != tail) {
+		g_ptr_array_add(records,
+		                shard->records[head % PURPLE_DEBUG_SHARD_SIZE]);
+		head++;
+	}
+
+	g_atomic_int_set(&shard->head, head);
+
+	dropped = g_atomic_int_and(&shard->dropped, 0);
+	if(dropped > 0) {
+		gchar *message = g_strdup_printf("%u debug messages were dropped",
+		                                 dropped);
+
+		g_ptr_array_add(records,
+		                purple_debug_record_new(g_get_monotonic_time(),
+		                                        shard->thread_id,
+		                                        PURPLE_DEBUG_WARNING,
+		                                        "debug", message));
+
+		g_free(message);
+	}
+}
+
+static gint
+purple_debug_record_compare(gconstpointer a, gconstpointer b) {
+	const PurpleDebugRecord *record_a = *(PurpleDebugRecord * const *)a;
+	const PurpleDebugRecord *record_b = *(PurpleDebugRecord * const *)b;
+
+	if(record_a->timestamp != record_b->timestamp) {
+		return (record_a->timestamp < record_b->timestamp) ? -1 : 1;
+	}
+
+	return (gint)record_a->thread_id - (gint)record_b->thread_id;
+}
+
 static void
 purple_debug_vargs(PurpleDebugLevel level, const gchar *category,
                    const gchar *format, va_list args)
 {
 	GLogLevelFlags log_level = G_LOG_LEVEL_DEBUG;
 	gchar *msg = NULL;
+	gboolean log_wanted = FALSE, ring_wanted = FALSE, sink_wanted = FALSE;
 
 	g_return_if_fail(format != NULL);
 
+	/* Bail out before we allocate or format anything if nobody is going to
+	 * see this message. */
+	log_wanted = purple_debug_log_wanted(level, category);
+	ring_wanted = purple_debug_ring_wanted(level);
+	if(!log_wanted && !ring_wanted) {
+		return;
+	}
+
 	/* GLib's debug levels are not quite the same as ours, so we need to
 	 * re-assign them. */
 	switch(level) {
@@ -66,7 +384,40 @@ purple_debug_vargs(PurpleDebugLevel level, const gchar *category,
 	msg = g_strdup(format);
 	g_strchomp(msg);
 
-	g_logv(category, log_level, msg, args);
+	/* Fatal messages can't wait for the main loop, since g_log is what
+	 * aborts. Deliver everything queued before them first, so they still
+	 * come last; the sink can only be called from the main loop though. */
+	if(level == PURPLE_DEBUG_FATAL) {
+		if(log_wanted && g_atomic_int_get(&debug_have_sink)) {
+			if(g_main_context_is_owner(NULL)) {
+				purple_debug_sink_flush();
+			} else {
+				purple_debug_sink_flush_to_stderr();
+			}
+		}
+	} else {
+		sink_wanted = log_wanted && g_atomic_int_get(&debug_have_sink);
+	}
+
+	if(ring_wanted || sink_wanted) {
+		gchar *text = g_strdup_vprintf(msg, args);
+
+		if(ring_wanted) {
+			purple_debug_ring_push(level, category, text);
+		}
+
+		/* The message is already formatted, so don't do it again. */
+		if(sink_wanted) {
+			purple_debug_sink_push(level, category, text);
+		} else if(log_wanted) {
+			g_log(category, log_level, "%s", text);
+		}
+
+		g_free(text);
+	} else {
+		g_logv(category, log_level, msg, args);
+	}
+
 	g_free(msg);
 }
 
@@ -159,6 +510,246 @@ purple_debug_set_unsafe(gboolean unsafe) {
 	debug_unsafe = unsafe;
 }
 
+gboolean
+purple_debug_is_enabled(PurpleDebugLevel level, const gchar *category) {
+	return purple_debug_log_wanted(level, category) ||
+	       purple_debug_ring_wanted(level);
+}
+
+void
+purple_debug_set_level(PurpleDebugLevel level) {
+	g_atomic_int_set(&debug_level, level);
+}
+
+PurpleDebugLevel
+purple_debug_get_level(void) {
+	return g_atomic_int_get(&debug_level);
+}
+
+void
+purple_debug_set_category_level(const gchar *category, PurpleDebugLevel level)
+{
+	g_return_if_fail(category != NULL);
+
+	g_rw_lock_writer_lock(&debug_category_lock);
+	if(debug_category_levels == NULL) {
+		debug_category_levels = g_hash_table_new_full(g_str_hash,
+		                                              g_str_equal, g_free,
+		                                              NULL);
+	}
+	g_hash_table_insert(debug_category_levels, g_strdup(category),
+	                    GINT_TO_POINTER(level));
+	g_atomic_int_set(&debug_have_category_levels, 1);
+	g_rw_lock_writer_unlock(&debug_category_lock);
+}
+
+void
+purple_debug_clear_category_levels(void) {
+	g_rw_lock_writer_lock(&debug_category_lock);
+	g_atomic_int_set(&debug_have_category_levels, 0);
+	g_clear_pointer(&debug_category_levels, g_hash_table_destroy);
+	g_rw_lock_writer_unlock(&debug_category_lock);
+}
+
+void
+purple_debug_set_ring_size(gsize size) {
+	g_mutex_lock(&debug_ring_lock);
+	if(size != debug_ring_size) {
+		g_free(debug_ring);
+		debug_ring = (size > 0) ? g_malloc(size) : NULL;
+		debug_ring_size = size;
+	}
+	debug_ring_head = 0;
+	debug_ring_used = 0;
+	g_mutex_unlock(&debug_ring_lock);
+}
+
+gsize
+purple_debug_get_ring_size(void) {
+	return debug_ring_size;
+}
+
+void
+purple_debug_set_ring_level(PurpleDebugLevel level) {
+	g_atomic_int_set(&debug_ring_level, level);
+}
+
+PurpleDebugLevel
+purple_debug_get_ring_level(void) {
+	return g_atomic_int_get(&debug_ring_level);
+}
+
+void
+purple_debug_ring_foreach(PurpleDebugRingFunc func, gpointer data) {
+	guint8 *copy = NULL;
+	gsize used = 0, offset = 0;
+
+	g_return_if_fail(func != NULL);
+
+	/* Take a linear snapshot so that func can log without deadlocking and
+	 * other threads aren't blocked while we walk the records. */
+	g_mutex_lock(&debug_ring_lock);
+	used = debug_ring_used;
+	if(used > 0) {
+		copy = g_malloc(used);
+		purple_debug_ring_read(debug_ring_head, copy, used);
+	}
+	g_mutex_unlock(&debug_ring_lock);
+
+	while(offset < used) {
+		PurpleDebugRingHeader header;
+		gchar *category = NULL, *message = NULL;
+
+		memcpy(&header, copy + offset, sizeof(header));
+		offset += sizeof(header);
+
+		category = g_strndup((const gchar *)copy + offset,
+		                     header.category_len);
+		offset += header.category_len;
+		message = g_strndup((const gchar *)copy + offset, header.message_len);
+		offset += header.message_len;
+
+		func(header.timestamp, header.level, category, message, data);
+
+		g_free(category);
+		g_free(message);
+	}
+
+	g_free(copy);
+}
+
+static void
+purple_debug_ring_dump_cb(gint64 timestamp, PurpleDebugLevel level,
+                          const gchar *category, const gchar *message,
+                          gpointer data)
+{
+	static const gchar *level_names[] = {
+		"all", "misc", "info", "warning", "error", "fatal",
+	};
+	GString *str = data;
+	GDateTime *date_time = NULL;
+	gchar *time_str = NULL;
+
+	date_time = g_date_time_new_from_unix_local(timestamp / G_USEC_PER_SEC);
+	time_str = g_date_time_format(date_time, "%H:%M:%S");
+	g_date_time_unref(date_time);
+
+	g_string_append_printf(str, "(%s.%03d) %s %s: %s\n", time_str,
+	                       (gint)((timestamp % G_USEC_PER_SEC) / 1000),
+	                       level < G_N_ELEMENTS(level_names) ?
+	                       level_names[level] : "unknown",
+	                       *category != '\0' ? category : "default",
+	                       message);
+
+	g_free(time_str);
+}
+
+gchar *
+purple_debug_ring_dump(void) {
+	GString *str = g_string_new(NULL);
+
+	purple_debug_ring_foreach(purple_debug_ring_dump_cb, str);
+
+	return g_string_free(str, FALSE);
+}
+
+void
+purple_debug_set_sink(PurpleDebugSinkFunc func, gpointer data,
+                      GDestroyNotify destroy)
+{
+	GDestroyNotify old_destroy = NULL;
+	gpointer old_data = NULL;
+
+	/* Hand anything that is still queued to the old sink. */
+	purple_debug_sink_flush();
+
+	old_destroy = debug_sink_destroy;
+	old_data = debug_sink_data;
+
+	debug_sink_func = func;
+	debug_sink_data = data;
+	debug_sink_destroy = destroy;
+	g_atomic_int_set(&debug_have_sink, func != NULL);
+
+	if(old_destroy != NULL) {
+		old_destroy(old_data);
+	}
+}
+
+/* Takes everything that is queued in every thread's shard, oldest first. The
+ * shards lock keeps two callers from draining at once. */
+static GPtrArray *
+purple_debug_sink_collect(void) {
+	GPtrArray *records = NULL;
+	GList *l = NULL;
+
+	records = g_ptr_array_new_with_free_func(g_free);
+
+	g_mutex_lock(&debug_shards_lock);
+	l = debug_shards;
+	while(l != NULL) {
+		PurpleDebugShard *shard = l->data;
+		GList *next = l->next;
+
+		/* Check this before draining, a thread that was already gone can not
+		 * add anything after we're done with it. */
+		if(g_atomic_int_get(&shard->orphaned)) {
+			purple_debug_shard_drain(shard, records);
+			debug_shards = g_list_delete_link(debug_shards, l);
+			g_free(shard);
+		} else {
+			purple_debug_shard_drain(shard, records);
+		}
+
+		l = next;
+	}
+	g_mutex_unlock(&debug_shards_lock);
+
+	g_ptr_array_sort(records, purple_debug_record_compare);
+
+	return records;
+}
+
+/* Used instead of the sink when a thread other than the main one is about to
+ * abort, since the sink may only be called from the main loop. */
+static void
+purple_debug_sink_flush_to_stderr(void) {
+	GPtrArray *records = purple_debug_sink_collect();
+
+	for(guint i = 0; i < records->len; i++) {
+		PurpleDebugRecord *record = g_ptr_array_index(records, i);
+
+		fprintf(stderr, "%s: %s\n", record->category, record->message);
+	}
+	fflush(stderr);
+
+	g_ptr_array_free(records, TRUE);
+}
+
+void
+purple_debug_sink_flush(void) {
+	GPtrArray *records = NULL;
+
+	/* Clear this first, so anything queued while we drain schedules another
+	 * dispatch. */
+	g_atomic_int_set(&debug_sink_pending, 0);
+
+	records = purple_debug_sink_collect();
+
+	if(records->len > 0 && debug_sink_func != NULL) {
+		debug_sink_func(records, debug_sink_data);
+	}
+
+	g_ptr_array_free(records, TRUE);
+}
+
+gint64
+purple_debug_record_get_real_time(const PurpleDebugRecord *record) {
+	g_return_val_if_fail(record != NULL, 0);
+
+	return record->timestamp + (g_get_real_time() - g_get_monotonic_time());
+}
+
 void
 purple_debug_init(void) {
 	/* Read environment variables once per init */
@@ -170,5 +761,9 @@ purple_debug_init(void) {
 		purple_debug_set_verbose(TRUE);
 	}
 
+	if(purple_debug_get_ring_size() == 0) {
+		purple_debug_set_ring_size(PURPLE_DEBUG_RING_DEFAULT_SIZE);
+	}
+
 	purple_prefs_add_none("/purple/debug");
 }
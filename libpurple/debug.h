@@ -57,6 +57,80 @@ typedef enum {
 
 #include "purpledebugui.h"
 
+/**
+ * PurpleDebugRingFunc:
+ * @timestamp: The wall clock time the record was made, in microseconds since
+ *             the epoch.
+ * @level: The level of the record.
+ * @category: The category of the record, or an empty string if it had none.
+ * @message: The formatted message.
+ * @data: User data passed to purple_debug_ring_foreach().
+ *
+ * A function called for each record in the debug ring buffer.
+ *
+ * Since: 3.0.0
+ */
+typedef void (*PurpleDebugRingFunc)(gint64 timestamp, PurpleDebugLevel level, const gchar *category, const gchar *message, gpointer data);
+
+/**
+ * PurpleDebugRecord:
+ * @timestamp: The monotonic time the record was made, in microseconds, as
+ *             returned by g_get_monotonic_time().
+ * @thread_id: A small number identifying the thread that made the record.
+ *             Threads are numbered in the order that they first log,
+ *             starting at 1.
+ * @level: The level of the record.
+ * @category: The category of the record, or an empty string if it had none.
+ * @message: The formatted message.
+ *
+ * A debug message that was queued for the debug sink.
+ *
+ * Since: 3.0.0
+ */
+typedef struct {
+	gint64 timestamp;
+	guint thread_id;
+	PurpleDebugLevel level;
+	const gchar *category;
+	const gchar *message;
+} PurpleDebugRecord;
+
+/**
+ * PurpleDebugSinkFunc:
+ * @records: (element-type PurpleDebugRecord) (transfer none): The records,
+ *           oldest first.
+ * @data: User data passed to purple_debug_set_sink().
+ *
+ * A function that receives batches of debug records on the main loop.  The
+ * records are freed when it returns.
+ *
+ * Since: 3.0.0
+ */
+typedef void (*PurpleDebugSinkFunc)(GPtrArray *records, gpointer data);
+
+/**
+ * purple_debug_lazy:
+ * @level: The debug level.
+ * @category: The category (or %NULL).
+ * @...: The format string followed by the parameters to insert into it.
+ *
+ * Outputs debug information like purple_debug(), but checks
+ * purple_debug_is_enabled() first so that the parameters are not even
+ * evaluated when nobody would see the message.
+ *
+ * Use this in hot paths where building the parameters is expensive, but be
+ * aware that any side effects in the parameters will not happen when the
+ * message is filtered.
+ *
+ * Since: 3.0.0
+ */
+#define purple_debug_lazy(level, category, ...) \
+	G_STMT_START { \
+		if(purple_debug_is_enabled((level), (category))) { \
+			purple_debug((level), (category), __VA_ARGS__); \
+		} \
+	} G_STMT_END
+
 /**
  * purple_debug:
  * @level: The debug level.
@@ -185,6 +259,183 @@ void purple_debug_set_unsafe(gboolean unsafe);
  */
 gboolean purple_debug_is_unsafe(void);
 
+/**
+ * purple_debug_is_enabled:
+ * @level: The debug level.
+ * @category: The category (or %NULL).
+ *
+ * Checks whether a message at @level in @category would be logged or
+ * recorded in the ring buffer.  This is cheap and can be used to skip
+ * building debug output that would be thrown away.
+ *
+ * Returns: %TRUE if the message would go anywhere, %FALSE otherwise.
+ *
+ * Since: 3.0.0
+ */
+gboolean purple_debug_is_enabled(PurpleDebugLevel level, const gchar *category);
+
+/**
+ * purple_debug_set_level:
+ * @level: The minimum level to log.
+ *
+ * Sets the minimum level of messages that are passed on to the log writer.
+ * Messages below this level are dropped before they are formatted.  The
+ * default is #PURPLE_DEBUG_ALL which logs everything.
+ *
+ * Since: 3.0.0
+ */
+void purple_debug_set_level(PurpleDebugLevel level);
+
+/**
+ * purple_debug_get_level:
+ *
+ * Gets the minimum level of messages that are passed on to the log writer.
+ *
+ * Returns: The minimum level.
+ *
+ * Since: 3.0.0
+ */
+PurpleDebugLevel purple_debug_get_level(void);
+
+/**
+ * purple_debug_set_category_level:
+ * @category: The category.
+ * @level: The minimum level to log for @category.
+ *
+ * Overrides the level set with purple_debug_set_level() for @category.  This
+ * can be used to raise the level for a noisy category or to lower it for one
+ * that is being investigated.
+ *
+ * Since: 3.0.0
+ */
+void purple_debug_set_category_level(const gchar *category, PurpleDebugLevel level);
+
+/**
+ * purple_debug_clear_category_levels:
+ *
+ * Removes all of the overrides set with purple_debug_set_category_level().
+ *
+ * Since: 3.0.0
+ */
+void purple_debug_clear_category_levels(void);
+
+/**
+ * purple_debug_set_ring_size:
+ * @size: The size of the ring buffer in bytes, or 0 to disable it.
+ *
+ * Sets the size of the in-memory ring buffer of recent debug records.  Any
+ * records that are already in the buffer are discarded.
+ *
+ * The ring buffer keeps recent messages available, via
+ * purple_debug_ring_dump(), even when nothing is being logged.
+ *
+ * Since: 3.0.0
+ */
+void purple_debug_set_ring_size(gsize size);
+
+/**
+ * purple_debug_get_ring_size:
+ *
+ * Gets the size of the in-memory ring buffer of recent debug records.
+ *
+ * Returns: The size in bytes, or 0 if the ring buffer is disabled.
+ *
+ * Since: 3.0.0
+ */
+gsize purple_debug_get_ring_size(void);
+
+/**
+ * purple_debug_set_ring_level:
+ * @level: The minimum level to record.
+ *
+ * Sets the minimum level of messages that are recorded in the ring buffer.
+ * This is independent of purple_debug_set_level() and defaults to
+ * #PURPLE_DEBUG_WARNING.
+ *
+ * Since: 3.0.0
+ */
+void purple_debug_set_ring_level(PurpleDebugLevel level);
+
+/**
+ * purple_debug_get_ring_level:
+ *
+ * Gets the minimum level of messages that are recorded in the ring buffer.
+ *
+ * Returns: The minimum level.
+ *
+ * Since: 3.0.0
+ */
+PurpleDebugLevel purple_debug_get_ring_level(void);
+
+/**
+ * purple_debug_ring_foreach:
+ * @func: (scope call): The function to call.
+ * @data: User data to pass to @func.
+ *
+ * Calls @func for each record in the ring buffer, oldest first.  The records
+ * are copied out before @func is called, so it is safe to log from @func.
+ *
+ * Since: 3.0.0
+ */
+void purple_debug_ring_foreach(PurpleDebugRingFunc func, gpointer data);
+
+/**
+ * purple_debug_ring_dump:
+ *
+ * Formats every record in the ring buffer, oldest first, one per line.
+ *
+ * Returns: (transfer full): The formatted records.
+ *
+ * Since: 3.0.0
+ */
+gchar *purple_debug_ring_dump(void);
+
+/**
+ * purple_debug_set_sink:
+ * @func: (nullable) (scope notified): The function to deliver records to, or
+ *        %NULL to go back to the GLib log writer.
+ * @data: User data to pass to @func.
+ * @destroy: (nullable): A #GDestroyNotify for @data.
+ *
+ * Sends debug messages to @func instead of the GLib log writer.
+ *
+ * Each thread that logs gets its own fixed size queue, which it appends to
+ * without taking any locks.  The queues are drained together on the default
+ * main context, and @func is called with every record that was queued since
+ * the last time, in timestamp order.  If a thread logs faster than the main
+ * loop can keep up, its excess records are dropped and a warning saying how
+ * many were lost is delivered in their place.
+ *
+ * This must be called from the thread that runs the default main context.
+ * Records that are still queued are delivered to the old sink first.
+ *
+ * Since: 3.0.0
+ */
+void purple_debug_set_sink(PurpleDebugSinkFunc func, gpointer data, GDestroyNotify destroy);
+
+/**
+ * purple_debug_sink_flush:
+ *
+ * Delivers every queued record to the debug sink right away, instead of
+ * waiting for the main loop.  This must be called from the thread that runs
+ * the default main context.
+ *
+ * Since: 3.0.0
+ */
+void purple_debug_sink_flush(void);
+
+/**
+ * purple_debug_record_get_real_time:
+ * @record: The #PurpleDebugRecord.
+ *
+ * Converts the monotonic timestamp of @record to wall clock time.
+ *
+ * Returns: The time @record was made, in microseconds since the epoch.
+ *
+ * Since: 3.0.0
+ */
+gint64 purple_debug_record_get_real_time(const PurpleDebugRecord *record);
+
 /******************************************************************************
  * Debug Subsystem
  *****************************************************************************/
@@ -19,15 +19,30 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
  */
 
+#include <glib/gstdio.h>
+
 #include "debug.h"
 #include "image.h"
 #include "util.h"
 
+/* Files at least this big are mapped into memory instead of being copied.
+ * Below it the cost of setting up the mapping outweighs the copy.
+ */
+#define PURPLE_IMAGE_MMAP_THRESHOLD (64 * 1024)
+
+/* The size of the chunks we pull from a stream when its length is unknown. */
+#define PURPLE_IMAGE_READ_CHUNK_SIZE (16 * 1024)
+
 typedef struct {
 	gchar *path;
 
 	GBytes *contents;
 
+	/* The contents are construct only, so these are sniffed once when they
+	 * are set.  sniffed tracks whether that happened, as an unknown format
+	 * leaves both of them NULL.
+	 */
+	gboolean sniffed;
 	const gchar *extension;
 	const gchar *mime;
 	gchar *gen_filename;
@@ -58,6 +73,46 @@ _purple_image_set_path(PurpleImage *image, const gchar *path) {
 	priv->path = g_strdup(path);
 }
 
+static void
+_purple_image_sniff(PurpleImagePrivate *priv) {
+	const guint8 *data = NULL;
+	gsize len = 0;
+
+	priv->sniffed = TRUE;
+	priv->extension = NULL;
+	priv->mime = NULL;
+
+	if(priv->contents == NULL) {
+		return;
+	}
+
+	data = g_bytes_get_data(priv->contents, &len);
+	if(len < 4) {
+		return;
+	}
+
+	if(memcmp(data, "GIF8", 4) == 0) {
+		priv->extension = "gif";
+		priv->mime = "image/gif";
+	} else if(memcmp(data, "\xff\xd8\xff", 3) == 0) {
+		/* 4th may be e0 through ef */
+		priv->extension = "jpg";
+		priv->mime = "image/jpeg";
+	} else if(memcmp(data, "\x89PNG", 4) == 0) {
+		priv->extension = "png";
+		priv->mime = "image/png";
+	} else if(memcmp(data, "MM", 2) == 0 || memcmp(data, "II", 2) == 0) {
+		priv->extension = "tif";
+		priv->mime = "image/tiff";
+	} else if(memcmp(data, "BM", 2) == 0) {
+		priv->extension = "bmp";
+		priv->mime = "image/bmp";
+	} else if(memcmp(data, "\x00\x00\x01\x00", 4) == 0) {
+		priv->extension = "ico";
+		priv->mime = "image/vnd.microsoft.icon";
+	}
+}
+
 static void
 _purple_image_set_contents(PurpleImage *image, GBytes *bytes) {
 	PurpleImagePrivate *priv = purple_image_get_instance_private(image);
@@ -66,6 +121,82 @@ _purple_image_set_contents(PurpleImage *image, GBytes *bytes) {
 		g_bytes_unref(priv->contents);
 
 	priv->contents = (bytes) ? g_bytes_ref(bytes) : NULL;
+
+	_purple_image_sniff(priv);
+}
+
+/* Reads the file at @path, mapping it into memory if it is large enough that
+ * copying it would be wasteful.  This may be called from a worker thread.
+ */
+static GBytes *
+purple_image_read_file(const gchar *path, GCancellable *cancellable,
+                       GError **error)
+{
+	GStatBuf st;
+	gchar *contents = NULL;
+	gsize length = 0;
+
+	if(g_cancellable_set_error_if_cancelled(cancellable, error)) {
+		return NULL;
+	}
+
+	if(g_stat(path, &st) == 0 && S_ISREG(st.st_mode) &&
+	   st.st_size >= PURPLE_IMAGE_MMAP_THRESHOLD)
+	{
+		GMappedFile *file = NULL;
+		GBytes *bytes = NULL;
+
+		file = g_mapped_file_new(path, FALSE, error);
+		if(file == NULL) {
+			return NULL;
+		}
+
+		bytes = g_mapped_file_get_bytes(file);
+		g_mapped_file_unref(file);
+
+		return bytes;
+	}
+
+	if(!g_file_get_contents(path, &contents, &length, error)) {
+		return NULL;
+	}
+
+	return g_bytes_new_take(contents, length);
+}
+
+static void
+purple_image_new_from_file_thread(GTask *task, gpointer source_object,
+                                  gpointer task_data,
+                                  GCancellable *cancellable)
+{
+	PurpleImage *image = NULL;
+	GBytes *bytes = NULL;
+	GError *error = NULL;
+	const gchar *path = task_data;
+
+	bytes = purple_image_read_file(path, cancellable, &error);
+	if(bytes == NULL) {
+		g_task_return_error(task, error);
+
+		return;
+	}
+
+	/* Don't bother building the image if nobody is going to want it. */
+	if(g_task_return_error_if_cancelled(task)) {
+		g_bytes_unref(bytes);
+
+		return;
+	}
+
+	image = g_object_new(
+		PURPLE_TYPE_IMAGE,
+		"contents", bytes,
+		"path", path,
+		NULL
+	);
+	g_bytes_unref(bytes);
+
+	g_task_return_pointer(task, image, g_object_unref);
 }
 
 /******************************************************************************
@@ -184,15 +315,14 @@ PurpleImage *
 purple_image_new_from_file(const gchar *path, GError **error) {
 	PurpleImage *image = NULL;
 	GBytes *bytes = NULL;
-	gchar *contents = NULL;
-	gsize length = 0;
 
-	if(!g_file_get_contents(path, &contents, &length, error)) {
+	g_return_val_if_fail(path != NULL, NULL);
+
+	bytes = purple_image_read_file(path, NULL, error);
+	if(bytes == NULL) {
 		return NULL;
 	}
 
-	bytes = g_bytes_new_take(contents, length);
-
 	image = g_object_new(
 		PURPLE_TYPE_IMAGE,
 		"contents", bytes,
@@ -205,6 +335,98 @@ purple_image_new_from_file(const gchar *path, GError **error) {
 	return image;
 }
 
+void
+purple_image_new_from_file_async(const gchar *path, GCancellable *cancellable,
+                                 GAsyncReadyCallback callback, gpointer data)
+{
+	GTask *task = NULL;
+
+	g_return_if_fail(path != NULL);
+
+	task = g_task_new(NULL, cancellable, callback, data);
+	g_task_set_source_tag(task, purple_image_new_from_file_async);
+	g_task_set_task_data(task, g_strdup(path), g_free);
+
+	g_task_run_in_thread(task, purple_image_new_from_file_thread);
+
+	g_object_unref(task);
+}
+
+PurpleImage *
+purple_image_new_from_file_finish(GAsyncResult *result, GError **error) {
+	g_return_val_if_fail(g_task_is_valid(result, NULL), NULL);
+	g_return_val_if_fail(g_async_result_is_tagged(result,
+	                     purple_image_new_from_file_async), NULL);
+
+	return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+PurpleImage *
+purple_image_new_from_stream(GInputStream *stream, GCancellable *cancellable,
+                             GError **error)
+{
+	PurpleImage *image = NULL;
+	GByteArray *array = NULL;
+	GBytes *bytes = NULL;
+	gsize chunk = PURPLE_IMAGE_READ_CHUNK_SIZE;
+
+	g_return_val_if_fail(G_IS_INPUT_STREAM(stream), NULL);
+
+	/* A stream doesn't tell us which file backs it, so it can't be mapped,
+	 * but we can at least ask how big it is.
+	 */
+	if(G_IS_FILE_INPUT_STREAM(stream)) {
+		GFileInfo *info = NULL;
+
+		info = g_file_input_stream_query_info(G_FILE_INPUT_STREAM(stream),
+		                                      G_FILE_ATTRIBUTE_STANDARD_SIZE,
+		                                      cancellable, NULL);
+		if(info != NULL) {
+			goffset size = g_file_info_get_size(info);
+
+			/* Size the first read to the whole file so we don't have to
+			 * grow the buffer as we go.
+			 */
+			if(size > 0 && (guint64)size < G_MAXSIZE) {
+				chunk = (gsize)size;
+			}
+
+			g_object_unref(info);
+		}
+	}
+
+	array = g_byte_array_sized_new(chunk);
+
+	while(TRUE) {
+		gssize read = 0;
+		guint offset = array->len;
+
+		g_byte_array_set_size(array, offset + chunk);
+
+		read = g_input_stream_read(stream, array->data + offset, chunk,
+		                           cancellable, error);
+		if(read < 0) {
+			g_byte_array_unref(array);
+
+			return NULL;
+		}
+
+		g_byte_array_set_size(array, offset + read);
+
+		if(read == 0) {
+			break;
+		}
+
+		chunk = PURPLE_IMAGE_READ_CHUNK_SIZE;
+	}
+
+	bytes = g_byte_array_free_to_bytes(array);
+	image = purple_image_new_from_bytes(bytes);
+	g_bytes_unref(bytes);
+
+	return image;
+}
+
 PurpleImage *
 purple_image_new_from_data(const guint8 *data, gsize length) {
 	PurpleImage *image;
@@ -315,67 +537,31 @@ purple_image_get_data(PurpleImage *image) {
 const gchar *
 purple_image_get_extension(PurpleImage *image) {
 	PurpleImagePrivate *priv = NULL;
-	gconstpointer data;
 
 	g_return_val_if_fail(PURPLE_IS_IMAGE(image), NULL);
 
 	priv = purple_image_get_instance_private(image);
 
-	if (priv->extension)
-		return priv->extension;
-
-	if (purple_image_get_data_size(image) < 4)
-		return NULL;
-
-	data = purple_image_get_data(image);
-	g_assert(data != NULL);
-
-	if (memcmp(data, "GIF8", 4) == 0)
-		return priv->extension = "gif";
-	if (memcmp(data, "\xff\xd8\xff", 3) == 0) /* 4th may be e0 through ef */
-		return priv->extension = "jpg";
-	if (memcmp(data, "\x89PNG", 4) == 0)
-		return priv->extension = "png";
-	if (memcmp(data, "MM", 2) == 0)
-		return priv->extension = "tif";
-	if (memcmp(data, "II", 2) == 0)
-		return priv->extension = "tif";
-	if (memcmp(data, "BM", 2) == 0)
-		return priv->extension = "bmp";
-	if (memcmp(data, "\x00\x00\x01\x00", 4) == 0)
-		return priv->extension = "ico";
+	if(!priv->sniffed) {
+		_purple_image_sniff(priv);
+	}
 
-	return NULL;
+	return priv->extension;
 }
 
 const gchar *
 purple_image_get_mimetype(PurpleImage *image) {
 	PurpleImagePrivate *priv = NULL;
-	const gchar *ext = purple_image_get_extension(image);
 
 	g_return_val_if_fail(PURPLE_IS_IMAGE(image), NULL);
 
 	priv = purple_image_get_instance_private(image);
 
-	if (priv->mime)
-		return priv->mime;
-
-	g_return_val_if_fail(ext != NULL, NULL);
-
-	if (g_strcmp0(ext, "gif") == 0)
-		return priv->mime = "image/gif";
-	if (g_strcmp0(ext, "jpg") == 0)
-		return priv->mime = "image/jpeg";
-	if (g_strcmp0(ext, "png") == 0)
-		return priv->mime = "image/png";
-	if (g_strcmp0(ext, "tif") == 0)
-		return priv->mime = "image/tiff";
-	if (g_strcmp0(ext, "bmp") == 0)
-		return priv->mime = "image/bmp";
-	if (g_strcmp0(ext, "ico") == 0)
-		return priv->mime = "image/vnd.microsoft.icon";
+	if(!priv->sniffed) {
+		_purple_image_sniff(priv);
+	}
 
-	return NULL;
+	return priv->mime;
 }
 
 const gchar *
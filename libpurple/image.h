@@ -27,6 +27,7 @@
 #define PURPLE_IMAGE_H
 
 #include <glib-object.h>
+#include <gio/gio.h>
 
 #define PURPLE_TYPE_IMAGE  purple_image_get_type()
 
@@ -80,6 +81,51 @@ PurpleImage *purple_image_new_from_bytes(GBytes *bytes);
  */
 PurpleImage *purple_image_new_from_file(const gchar *path, GError **error);
 
+/**
+ * purple_image_new_from_file_async:
+ * @path: The path to the image file.
+ * @cancellable: (nullable): A #GCancellable or %NULL.
+ * @callback: (scope async): The callback to call when the image is loaded.
+ * @data: User data to pass to @callback.
+ *
+ * Asynchronously loads the image file at @path without blocking the calling
+ * thread.  Large files are mapped into memory rather than read.
+ *
+ * Call purple_image_new_from_file_finish() from @callback to get the result.
+ *
+ * Since: 3.0.0
+ */
+void purple_image_new_from_file_async(const gchar *path, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer data);
+
+/**
+ * purple_image_new_from_file_finish:
+ * @result: The #GAsyncResult passed to the callback.
+ * @error: (optional) (out): An optional return address for a #GError.
+ *
+ * Finishes a load started with purple_image_new_from_file_async().
+ *
+ * Returns: (transfer full): The new #PurpleImage or %NULL on error.
+ *
+ * Since: 3.0.0
+ */
+PurpleImage *purple_image_new_from_file_finish(GAsyncResult *result, GError **error);
+
+/**
+ * purple_image_new_from_stream:
+ * @stream: The #GInputStream to read the image from.
+ * @cancellable: (nullable): A #GCancellable or %NULL.
+ * @error: (optional) (out): An optional return address for a #GError.
+ *
+ * Reads @stream until the end and creates a new #PurpleImage with what was
+ * read.  If @stream is a #GFileInputStream the whole file is read in one go.
+ * The stream is not closed.
+ *
+ * Returns: (transfer full): The new #PurpleImage or %NULL on error.
+ *
+ * Since: 3.0.0
+ */
+PurpleImage *purple_image_new_from_stream(GInputStream *stream, GCancellable *cancellable, GError **error);
+
 /**
  * purple_image_new_from_data:
  * @data: the pointer to the image data buffer.
@@ -165,9 +211,11 @@ gconstpointer purple_image_get_data(PurpleImage *image);
  * purple_image_get_extension:
  * @image: the image.
  *
- * Guesses the @image format based on its contents.
+ * Guesses the @image format based on its contents.  The format is only
+ * sniffed once, so this is cheap to call repeatedly.
  *
- * Returns: (transfer none): the file extension suitable for @image format.
+ * Returns: (transfer none): the file extension suitable for @image format, or
+ *          %NULL if the format is unknown.
  */
 const gchar *purple_image_get_extension(PurpleImage *image);
 
@@ -175,9 +223,11 @@ const gchar *purple_image_get_extension(PurpleImage *image);
  * purple_image_get_mimetype:
  * @image: the image.
  *
- * Guesses the @image mime-type based on its contents.
+ * Guesses the @image mime-type based on its contents.  Like
+ * purple_image_get_extension(), the result is cached on @image.
  *
- * Returns: (transfer none): the mime-type suitable for @image format.
+ * Returns: (transfer none): the mime-type suitable for @image format, or
+ *          %NULL if the format is unknown.
  */
 const gchar *purple_image_get_mimetype(PurpleImage *image);
 
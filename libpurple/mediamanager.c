@@ -63,9 +63,10 @@ typedef struct
 
 	GstDeviceMonitor *device_monitor;
 
-	/* Application data streams */
-	GList *appdata_info; /* holds PurpleMediaAppDataInfo */
-	GMutex appdata_mutex;
+	/* Application data streams, indexed by media and session id. The lock
+	 * only guards the index; each stream has its own mutex. */
+	GHashTable *appdata_sessions; /* holds PurpleMediaAppDataSession */
+	GRWLock appdata_lock;
 	guint appdata_cb_token; /* last used read/write callback token */
 } PurpleMediaManagerPrivate;
 
@@ -83,6 +84,8 @@ struct _PurpleMediaManager
 };
 
 typedef struct {
+	gatomicrefcount ref_count;
+	GMutex mutex;
 	PurpleMedia *media;
 	GWeakRef media_ref;
 	gchar *session_id;
@@ -104,8 +107,22 @@ typedef struct {
 	GCond readable_cond;
 } PurpleMediaAppDataInfo;
 
+/* All the application data streams of one session of a media, usually just
+ * one per participant. */
+typedef struct {
+	PurpleMedia *media;
+	gchar *session_id;
+	GList *infos; /* holds PurpleMediaAppDataInfo */
+} PurpleMediaAppDataSession;
+
 static void purple_media_manager_finalize (GObject *object);
-static void free_appdata_info_locked (PurpleMediaAppDataInfo *info);
+static void close_appdata_info_locked (PurpleMediaAppDataInfo *info);
+static void app_data_info_unref (PurpleMediaAppDataInfo *info);
+static guint app_data_session_hash (gconstpointer key);
+static gboolean app_data_session_equal (gconstpointer a, gconstpointer b);
+static void app_data_session_free (PurpleMediaAppDataSession *session);
+static void remove_app_data_infos (PurpleMediaManager *manager,
+	PurpleMedia *media);
 static void purple_media_manager_init_device_monitor(PurpleMediaManager *manager);
 static void purple_media_manager_register_static_elements(PurpleMediaManager *manager);
 
@@ -168,8 +185,10 @@ purple_media_manager_init (PurpleMediaManager *media)
 	media->priv->medias = NULL;
 	media->priv->private_medias = NULL;
 	media->priv->next_output_window_id = 1;
-	media->priv->appdata_info = NULL;
-	g_mutex_init (&media->priv->appdata_mutex);
+	media->priv->appdata_sessions = g_hash_table_new_full (
+		app_data_session_hash, app_data_session_equal,
+		(GDestroyNotify) app_data_session_free, NULL);
+	g_rw_lock_init (&media->priv->appdata_lock);
 	if (gst_init_check(NULL, NULL, &error)) {
 		purple_media_manager_register_static_elements(media);
 		purple_media_manager_init_device_monitor(media);
@@ -201,11 +220,8 @@ purple_media_manager_finalize (GObject *media)
 	g_list_free_full(priv->private_medias, g_object_unref);
 	g_list_free_full(priv->elements, g_object_unref);
 	g_clear_pointer(&priv->video_caps, gst_caps_unref);
-	if (priv->appdata_info) {
-		g_list_free_full(priv->appdata_info,
-		                 (GDestroyNotify)free_appdata_info_locked);
-	}
-	g_mutex_clear (&priv->appdata_mutex);
+	g_hash_table_destroy (priv->appdata_sessions);
+	g_rw_lock_clear (&priv->appdata_lock);
 	if (priv->device_monitor) {
 		gst_device_monitor_stop(priv->device_monitor);
 		g_object_unref(priv->device_monitor);
@@ -375,21 +391,7 @@ purple_media_manager_remove_media(PurpleMediaManager *manager, PurpleMedia *medi
 	if (list) {
 		*medias = g_list_delete_link(*medias, list);
 
-		g_mutex_lock (&manager->priv->appdata_mutex);
-		list = manager->priv->appdata_info;
-		while (list) {
-			PurpleMediaAppDataInfo *info = list->data;
-			GList *next = list->next;
-
-			if (info->media == media) {
-				manager->priv->appdata_info = g_list_delete_link (
-					manager->priv->appdata_info, list);
-				free_appdata_info_locked (info);
-			}
-
-			list = next;
-		}
-		g_mutex_unlock (&manager->priv->appdata_mutex);
+		remove_app_data_infos (manager, media);
 	}
 }
 
@@ -441,14 +443,130 @@ purple_media_manager_get_private_media_by_account(PurpleMediaManager *manager,
 	return get_media_by_account (manager, account, TRUE);
 }
 
+static PurpleMediaAppDataInfo *
+app_data_info_ref (PurpleMediaAppDataInfo *info)
+{
+	g_atomic_ref_count_inc (&info->ref_count);
+
+	return info;
+}
+
+static void
+app_data_info_unref (PurpleMediaAppDataInfo *info)
+{
+	if (!g_atomic_ref_count_dec (&info->ref_count)) {
+		return;
+	}
+
+	g_weak_ref_clear (&info->media_ref);
+	g_free (info->session_id);
+	g_free (info->participant);
+	g_cond_clear (&info->readable_cond);
+	g_mutex_clear (&info->mutex);
+
+	g_slice_free (PurpleMediaAppDataInfo, info);
+}
+
+/*
+ * Unlock an info struct returned by get_app_data_info_and_lock() or
+ * ensure_app_data_info_and_lock() and drop the reference it came with.
+ */
+static void
+app_data_info_unlock (PurpleMediaAppDataInfo *info)
+{
+	g_mutex_unlock (&info->mutex);
+	app_data_info_unref (info);
+}
+
+static guint
+next_app_data_cb_token (PurpleMediaManager *manager)
+{
+	guint token;
+
+	/* Tokens are handed out from the streaming threads, and 0 means that no
+	 * callback is scheduled. */
+	do {
+		token = (guint) g_atomic_int_add (&manager->priv->appdata_cb_token,
+			1) + 1;
+	} while (token == 0);
+
+	return token;
+}
+
+static guint
+app_data_session_hash (gconstpointer key)
+{
+	const PurpleMediaAppDataSession *session = key;
+
+	return g_direct_hash (session->media) ^
+		(session->session_id ? g_str_hash (session->session_id) : 0);
+}
+
+static gboolean
+app_data_session_equal (gconstpointer a, gconstpointer b)
+{
+	const PurpleMediaAppDataSession *session_a = a;
+	const PurpleMediaAppDataSession *session_b = b;
+
+	return session_a->media == session_b->media &&
+		purple_strequal (session_a->session_id, session_b->session_id);
+}
+
+static void
+app_data_session_free (PurpleMediaAppDataSession *session)
+{
+	GList *l;
+
+	for (l = session->infos; l; l = l->next) {
+		PurpleMediaAppDataInfo *info = l->data;
+
+		g_mutex_lock (&info->mutex);
+		close_appdata_info_locked (info);
+		g_mutex_unlock (&info->mutex);
+		app_data_info_unref (info);
+	}
+
+	g_list_free (session->infos);
+	g_free (session->session_id);
+	g_slice_free (PurpleMediaAppDataSession, session);
+}
+
+static void
+remove_app_data_infos (PurpleMediaManager *manager, PurpleMedia *media)
+{
+	GHashTableIter iter;
+	PurpleMediaAppDataSession *session;
+	GList *sessions = NULL;
+
+	/* Pull the sessions out of the index first, so that nothing can find
+	 * them anymore, and close them without holding the index lock. */
+	g_rw_lock_writer_lock (&manager->priv->appdata_lock);
+	g_hash_table_iter_init (&iter, manager->priv->appdata_sessions);
+	while (g_hash_table_iter_next (&iter, (gpointer *)&session, NULL)) {
+		if (session->media == media) {
+			g_hash_table_iter_steal (&iter);
+			sessions = g_list_prepend (sessions, session);
+		}
+	}
+	g_rw_lock_writer_unlock (&manager->priv->appdata_lock);
+
+	g_list_free_full (sessions, (GDestroyNotify) app_data_session_free);
+}
+
 static void
-free_appdata_info_locked (PurpleMediaAppDataInfo *info)
+close_appdata_info_locked (PurpleMediaAppDataInfo *info)
 {
 	GstAppSrcCallbacks null_src_cb = { NULL, NULL, NULL, { NULL } };
 	GstAppSinkCallbacks null_sink_cb = { NULL, NULL, NULL , { NULL } };
 
+	if (info->media == NULL) {
+		/* Already closed. */
+		return;
+	}
+
 	if (info->notify) {
 		info->notify(info->user_data);
+		info->notify = NULL;
 	}
 
 	info->media = NULL;
@@ -456,19 +574,17 @@ free_appdata_info_locked (PurpleMediaAppDataInfo *info)
 		/* Will call appsrc_destroyed. */
 		gst_app_src_set_callbacks (info->appsrc, &null_src_cb,
 				NULL, NULL);
+		info->appsrc = NULL;
 	}
 	if (info->appsink) {
 		/* Will call appsink_destroyed. */
 		gst_app_sink_set_callbacks (info->appsink, &null_sink_cb,
 				NULL, NULL);
+		info->appsink = NULL;
 	}
 
-	/* Make sure no other thread is using the structure */
-	g_free (info->session_id);
-	g_free (info->participant);
-
-	/* This lets the potential read or write callbacks waiting for appdata_mutex
-	 * know the info structure has been destroyed. */
+	/* This lets the potential read or write callbacks waiting for the info
+	 * mutex know the info structure has been closed. */
 	info->readable_cb_token = 0;
 	info->writable_cb_token = 0;
 
@@ -483,63 +599,114 @@ free_appdata_info_locked (PurpleMediaAppDataInfo *info)
 	}
 
 	g_clear_pointer(&info->current_sample, gst_sample_unref);
+	info->num_samples = 0;
 
-	/* Unblock any reading thread before destroying the GCond */
+	/* Unblock any reading thread, it will notice the info was closed. */
 	g_cond_broadcast (&info->readable_cond);
-
-	g_cond_clear (&info->readable_cond);
-
-	g_slice_free (PurpleMediaAppDataInfo, info);
 }
 
 /*
- * Get an app data info struct associated with a session and lock the mutex
- * We don't want to return an info struct and unlock then it gets destroyed
- * so we need to return it with the lock still taken
+ * Get an app data info struct associated with a session, reffed and with its
+ * mutex locked. The index lock is only held for the lookup, so streams of
+ * different sessions never wait on each other. Release the struct with
+ * app_data_info_unlock().
  */
 static PurpleMediaAppDataInfo *
 get_app_data_info_and_lock (PurpleMediaManager *manager,
 	PurpleMedia *media, const gchar *session_id, const gchar *participant)
 {
-	GList *i;
+	PurpleMediaAppDataSession key = { media, (gchar *)session_id, NULL };
+	PurpleMediaAppDataSession *session;
+	PurpleMediaAppDataInfo *info = NULL;
 
-	g_mutex_lock (&manager->priv->appdata_mutex);
-	for (i = manager->priv->appdata_info; i; i = i->next) {
-		PurpleMediaAppDataInfo *info = i->data;
+	g_rw_lock_reader_lock (&manager->priv->appdata_lock);
+	session = g_hash_table_lookup (manager->priv->appdata_sessions, &key);
+	if (session) {
+		GList *i;
 
-		if (info->media == media &&
-			purple_strequal (info->session_id, session_id) &&
-			(participant == NULL ||
-				purple_strequal (info->participant, participant))) {
-			return info;
+		for (i = session->infos; i; i = i->next) {
+			PurpleMediaAppDataInfo *candidate = i->data;
+
+			if (participant == NULL ||
+				purple_strequal (candidate->participant, participant)) {
+				info = app_data_info_ref (candidate);
+				break;
+			}
 		}
 	}
+	g_rw_lock_reader_unlock (&manager->priv->appdata_lock);
 
-	return NULL;
+	if (info == NULL) {
+		return NULL;
+	}
+
+	g_mutex_lock (&info->mutex);
+	if (info->media == NULL) {
+		/* Closed between the lookup and taking its lock. */
+		app_data_info_unlock (info);
+		return NULL;
+	}
+
+	return info;
 }
 
 /*
- * Get an app data info struct associated with a session and lock the mutex
+ * Get an app data info struct associated with a session and lock it,
  * if it doesn't exist, we create it.
  */
 static PurpleMediaAppDataInfo *
 ensure_app_data_info_and_lock (PurpleMediaManager *manager, PurpleMedia *media,
 	const gchar *session_id, const gchar *participant)
 {
-	PurpleMediaAppDataInfo * info = get_app_data_info_and_lock (manager, media,
-		session_id, participant);
+	PurpleMediaAppDataSession key = { media, (gchar *)session_id, NULL };
+	PurpleMediaAppDataSession *session;
+	PurpleMediaAppDataInfo *info;
+	GList *i;
+
+	info = get_app_data_info_and_lock (manager, media, session_id,
+		participant);
+	if (info != NULL) {
+		return info;
+	}
+
+	g_rw_lock_writer_lock (&manager->priv->appdata_lock);
+
+	/* Someone else may have added it while we weren't holding the lock. */
+	session = g_hash_table_lookup (manager->priv->appdata_sessions, &key);
+	if (session == NULL) {
+		session = g_slice_new0 (PurpleMediaAppDataSession);
+		session->media = media;
+		session->session_id = g_strdup (session_id);
+		g_hash_table_add (manager->priv->appdata_sessions, session);
+	}
+
+	for (i = session->infos; i; i = i->next) {
+		PurpleMediaAppDataInfo *candidate = i->data;
+
+		if (participant == NULL ||
+			purple_strequal (candidate->participant, participant)) {
+			info = candidate;
+			break;
+		}
+	}
 
 	if (info == NULL) {
 		info = g_slice_new0 (PurpleMediaAppDataInfo);
+		g_atomic_ref_count_init (&info->ref_count);
+		g_mutex_init (&info->mutex);
 		info->media = media;
 		g_weak_ref_init (&info->media_ref, media);
 		info->session_id = g_strdup (session_id);
 		info->participant = g_strdup (participant);
 		g_cond_init (&info->readable_cond);
-		manager->priv->appdata_info = g_list_prepend (
-			manager->priv->appdata_info, info);
+		session->infos = g_list_prepend (session->infos, info);
 	}
 
+	app_data_info_ref (info);
+	g_rw_lock_writer_unlock (&manager->priv->appdata_lock);
+
+	g_mutex_lock (&info->mutex);
+
 	return info;
 }
 
@@ -615,7 +782,7 @@ purple_media_manager_get_video_caps(PurpleMediaManager *manager)
 
 /*
  * Calls the appdata writable callback from the main thread.
- * This needs to grab the appdata lock and make sure it didn't get destroyed
+ * This needs to grab the info lock and make sure it didn't get closed
  * before calling the callback.
  */
 static gboolean
@@ -631,24 +798,13 @@ appsrc_writable (gpointer user_data)
 	gchar *participant;
 	gboolean writable;
 	gpointer cb_data;
-	guint *cb_token_ptr = &info->writable_cb_token;
-	guint cb_token = *cb_token_ptr;
-
-
-	g_mutex_lock (&manager->priv->appdata_mutex);
-	if (cb_token == 0 || cb_token != *cb_token_ptr) {
-		/* In case info was freed while we were waiting for the mutex to unlock
-		 * we still have a pointer to the cb_token which should still be
-		 * accessible since it's in the Glib slice allocator. It gets set to 0
-		 * just after the timeout is canceled which happens also before the
-		 * AppDataInfo is freed, so even if that memory slice gets reused, the
-		 * cb_token would be different from its previous value (unless
-		 * extremely unlucky). So checking if the value for the cb_token changed
-		 * should be enough to prevent any kind of race condition in which the
-		 * media/AppDataInfo gets destroyed in one thread while the timeout was
-		 * triggered and is waiting on the mutex to get unlocked in this thread
-		 */
-		g_mutex_unlock (&manager->priv->appdata_mutex);
+
+	g_mutex_lock (&info->mutex);
+	if (info->writable_cb_token == 0) {
+		/* The info was closed, or the callbacks changed, while we were
+		 * waiting for its mutex. The source holds a reference, so the
+		 * struct itself is still there to tell us. */
+		g_mutex_unlock (&info->mutex);
 		return FALSE;
 	}
 	writable_cb = info->callbacks.writable;
@@ -659,7 +815,8 @@ appsrc_writable (gpointer user_data)
 	cb_data = info->user_data;
 
 	info->writable_cb_token = 0;
-	g_mutex_unlock (&manager->priv->appdata_mutex);
+	info->writable_timer_id = 0;
+	g_mutex_unlock (&info->mutex);
 
 
 	if (writable_cb && media) {
@@ -667,7 +824,7 @@ appsrc_writable (gpointer user_data)
 			cb_data);
 	}
 
-	g_object_unref (media);
+	g_clear_object (&media);
 	g_free (session_id);
 	g_free (participant);
 
@@ -690,7 +847,8 @@ call_appsrc_writable_locked (PurpleMediaAppDataInfo *info)
 	PurpleMediaManager *manager = purple_media_manager_get ();
 
 	/* We already have a writable callback scheduled, don't create another one */
-	if (info->writable_cb_token || info->callbacks.writable == NULL) {
+	if (info->writable_cb_token || info->callbacks.writable == NULL ||
+		info->media == NULL) {
 		return;
 	}
 
@@ -699,17 +857,18 @@ call_appsrc_writable_locked (PurpleMediaAppDataInfo *info)
 	 * from where call_appsrc_writable_locked() was called. Consequently, the
 	 * callback may run even before g_timeout_add() returns the timer ID
 	 * to us. */
-	info->writable_cb_token = ++manager->priv->appdata_cb_token;
-	info->writable_timer_id = g_timeout_add (0, appsrc_writable, info);
+	info->writable_cb_token = next_app_data_cb_token (manager);
+	info->writable_timer_id = g_timeout_add_full (G_PRIORITY_DEFAULT, 0,
+		appsrc_writable, app_data_info_ref (info),
+		(GDestroyNotify) app_data_info_unref);
 }
 
 static void
 appsrc_need_data (GstAppSrc *appsrc, guint length, gpointer user_data)
 {
 	PurpleMediaAppDataInfo *info = user_data;
-	PurpleMediaManager *manager = purple_media_manager_get ();
 
-	g_mutex_lock (&manager->priv->appdata_mutex);
+	g_mutex_lock (&info->mutex);
 	if (!info->writable) {
 		info->writable = TRUE;
 		/* Only signal writable if we also established a connection */
@@ -717,21 +876,20 @@ appsrc_need_data (GstAppSrc *appsrc, guint length, gpointer user_data)
 			call_appsrc_writable_locked (info);
 		}
 	}
-	g_mutex_unlock (&manager->priv->appdata_mutex);
+	g_mutex_unlock (&info->mutex);
 }
 
 static void
 appsrc_enough_data (GstAppSrc *appsrc, gpointer user_data)
 {
 	PurpleMediaAppDataInfo *info = user_data;
-	PurpleMediaManager *manager = purple_media_manager_get ();
 
-	g_mutex_lock (&manager->priv->appdata_mutex);
+	g_mutex_lock (&info->mutex);
 	if (info->writable) {
 		info->writable = FALSE;
 		call_appsrc_writable_locked (info);
 	}
-	g_mutex_unlock (&manager->priv->appdata_mutex);
+	g_mutex_unlock (&info->mutex);
 }
 
 static gboolean
@@ -743,22 +901,19 @@ appsrc_seek_data (GstAppSrc *appsrc, guint64 offset, gpointer user_data)
 static void
 appsrc_destroyed (PurpleMediaAppDataInfo *info)
 {
-	PurpleMediaManager *manager;
-
-	if (!info->media) {
-		/* PurpleMediaAppDataInfo is being freed. Return at once. */
-		return;
+	if (info->media) {
+		g_mutex_lock (&info->mutex);
+		info->appsrc = NULL;
+		if (info->writable) {
+			info->writable = FALSE;
+			call_appsrc_writable_locked (info);
+		}
+		g_mutex_unlock (&info->mutex);
 	}
 
-	manager = purple_media_manager_get ();
-
-	g_mutex_lock (&manager->priv->appdata_mutex);
-	info->appsrc = NULL;
-	if (info->writable) {
-		info->writable = FALSE;
-		call_appsrc_writable_locked (info);
-	}
-	g_mutex_unlock (&manager->priv->appdata_mutex);
+	/* Otherwise the info is being closed and already holds its own lock.
+	 * Either way, drop the reference the appsrc callbacks held. */
+	app_data_info_unref (info);
 }
 
 static void
@@ -766,16 +921,14 @@ media_established_cb (PurpleMedia *media,const gchar *session_id,
 	const gchar *participant, PurpleMediaCandidate *local_candidate,
 	PurpleMediaCandidate *remote_candidate, PurpleMediaAppDataInfo *info)
 {
-	PurpleMediaManager *manager = purple_media_manager_get ();
-
-	g_mutex_lock (&manager->priv->appdata_mutex);
+	g_mutex_lock (&info->mutex);
 	info->connected = TRUE;
 	/* We established the connection, if we were writable, then we need to
 	 * signal it now */
 	if (info->writable) {
 		call_appsrc_writable_locked (info);
 	}
-	g_mutex_unlock (&manager->priv->appdata_mutex);
+	g_mutex_unlock (&info->mutex);
 }
 
 static GstElement *
@@ -798,13 +951,15 @@ create_send_appsrc(PurpleMediaElementInfo *element_info, PurpleMedia *media,
 
 		gst_app_src_set_caps (info->appsrc, caps);
 		gst_app_src_set_callbacks (info->appsrc,
-			&callbacks, info, (GDestroyNotify) appsrc_destroyed);
-		g_signal_connect (media, "candidate-pair-established",
-			(GCallback) media_established_cb, info);
+			&callbacks, app_data_info_ref (info),
+			(GDestroyNotify) appsrc_destroyed);
+		g_signal_connect_data (media, "candidate-pair-established",
+			(GCallback) media_established_cb, app_data_info_ref (info),
+			(GClosureNotify) app_data_info_unref, 0);
 		gst_caps_unref (caps);
 	}
 
-	g_mutex_unlock (&manager->priv->appdata_mutex);
+	app_data_info_unlock (info);
 	return appsrc;
 }
 
@@ -830,14 +985,15 @@ appsink_readable (gpointer user_data)
 	gchar *session_id;
 	gchar *participant;
 	gpointer cb_data;
-	guint *cb_token_ptr = &info->readable_cb_token;
-	guint cb_token = *cb_token_ptr;
+	guint cb_token;
 	gboolean run_again = FALSE;
 
-	g_mutex_lock (&manager->priv->appdata_mutex);
-	if (cb_token == 0 || cb_token != *cb_token_ptr) {
+	g_mutex_lock (&info->mutex);
+	cb_token = info->readable_cb_token;
+	if (cb_token == 0) {
 		/* Avoided a race condition (see writable callback) */
-		g_mutex_unlock (&manager->priv->appdata_mutex);
+		info->readable_timer_id = 0;
+		g_mutex_unlock (&info->mutex);
 		return FALSE;
 	}
 
@@ -848,17 +1004,19 @@ appsink_readable (gpointer user_data)
 		session_id = g_strdup (info->session_id);
 		participant = g_strdup (info->participant);
 		cb_data = info->user_data;
-		g_mutex_unlock (&manager->priv->appdata_mutex);
+		g_mutex_unlock (&info->mutex);
 
-		readable_cb(manager, media, session_id, participant, cb_data);
+		if (media) {
+			readable_cb(manager, media, session_id, participant, cb_data);
+		}
 
-		g_mutex_lock (&manager->priv->appdata_mutex);
-		g_object_unref (media);
+		g_mutex_lock (&info->mutex);
+		g_clear_object (&media);
 		g_free (session_id);
 		g_free (participant);
-		if (cb_token != *cb_token_ptr) {
+		if (cb_token != info->readable_cb_token) {
 			/* We got cancelled */
-			g_mutex_unlock (&manager->priv->appdata_mutex);
+			g_mutex_unlock (&info->mutex);
 			return FALSE;
 		}
 	}
@@ -869,9 +1027,10 @@ appsink_readable (gpointer user_data)
 		run_again = TRUE;
 	} else {
 		info->readable_cb_token = 0;
+		info->readable_timer_id = 0;
 	}
 
-	g_mutex_unlock (&manager->priv->appdata_mutex);
+	g_mutex_unlock (&info->mutex);
 	return run_again;
 }
 
@@ -884,24 +1043,26 @@ call_appsink_readable_locked (PurpleMediaAppDataInfo *info)
 	g_cond_broadcast (&info->readable_cond);
 
 	/* We already have a writable callback scheduled, don't create another one */
-	if (info->readable_cb_token || info->callbacks.readable == NULL) {
+	if (info->readable_cb_token || info->callbacks.readable == NULL ||
+		info->media == NULL) {
 		return;
 	}
 
-	info->readable_cb_token = ++manager->priv->appdata_cb_token;
-	info->readable_timer_id = g_timeout_add (0, appsink_readable, info);
+	info->readable_cb_token = next_app_data_cb_token (manager);
+	info->readable_timer_id = g_timeout_add_full (G_PRIORITY_DEFAULT, 0,
+		appsink_readable, app_data_info_ref (info),
+		(GDestroyNotify) app_data_info_unref);
 }
 
 static GstFlowReturn
 appsink_new_sample (GstAppSink *appsink, gpointer user_data)
 {
-	PurpleMediaManager *manager = purple_media_manager_get ();
 	PurpleMediaAppDataInfo *info = user_data;
 
-	g_mutex_lock (&manager->priv->appdata_mutex);
+	g_mutex_lock (&info->mutex);
 	info->num_samples++;
 	call_appsink_readable_locked (info);
-	g_mutex_unlock (&manager->priv->appdata_mutex);
+	g_mutex_unlock (&info->mutex);
 
 	return GST_FLOW_OK;
 }
@@ -909,19 +1070,14 @@ appsink_new_sample (GstAppSink *appsink, gpointer user_data)
 static void
 appsink_destroyed (PurpleMediaAppDataInfo *info)
 {
-	PurpleMediaManager *manager;
-
-	if (!info->media) {
-		/* PurpleMediaAppDataInfo is being freed. Return at once. */
-		return;
+	if (info->media) {
+		g_mutex_lock (&info->mutex);
+		info->appsink = NULL;
+		info->num_samples = 0;
+		g_mutex_unlock (&info->mutex);
 	}
 
-	manager = purple_media_manager_get ();
-
-	g_mutex_lock (&manager->priv->appdata_mutex);
-	info->appsink = NULL;
-	info->num_samples = 0;
-	g_mutex_unlock (&manager->priv->appdata_mutex);
+	app_data_info_unref (info);
 }
 
 static GstElement *
@@ -944,12 +1100,13 @@ create_recv_appsink(PurpleMediaElementInfo *element_info, PurpleMedia *media,
 
 		gst_app_sink_set_caps (info->appsink, caps);
 		gst_app_sink_set_callbacks (info->appsink,
-			&callbacks, info, (GDestroyNotify) appsink_destroyed);
+			&callbacks, app_data_info_ref (info),
+			(GDestroyNotify) appsink_destroyed);
 		gst_caps_unref (caps);
 
 	}
 
-	g_mutex_unlock (&manager->priv->appdata_mutex);
+	app_data_info_unlock (info);
 	return appsink;
 }
 
@@ -1561,11 +1718,13 @@ purple_media_manager_set_application_data_callbacks(PurpleMediaManager *manager,
 	if (info->readable_cb_token) {
 		g_source_remove (info->readable_timer_id);
 		info->readable_cb_token = 0;
+		info->readable_timer_id = 0;
 	}
 
 	if (info->writable_cb_token) {
 		g_source_remove (info->writable_timer_id);
 		info->writable_cb_token = 0;
+		info->writable_timer_id = 0;
 	}
 
 	if (callbacks) {
@@ -1582,7 +1741,7 @@ purple_media_manager_set_application_data_callbacks(PurpleMediaManager *manager,
 		call_appsink_readable_locked (info);
 	}
 
-	g_mutex_unlock (&manager->priv->appdata_mutex);
+	app_data_info_unlock (info);
 }
 
 gint
@@ -1590,35 +1749,65 @@ purple_media_manager_send_application_data (
 	PurpleMediaManager *manager, PurpleMedia *media, const gchar *session_id,
 	const gchar *participant, gpointer buffer, guint size, gboolean blocking)
 {
-	PurpleMediaAppDataInfo * info = get_app_data_info_and_lock (manager,
-		media, session_id, participant);
+	return purple_media_manager_send_application_data_bytes (manager, media,
+		session_id, participant, g_bytes_new (buffer, size), blocking);
+}
 
-	if (info && info->appsrc && info->connected) {
-		GstBuffer *gstbuffer = gst_buffer_new_wrapped (g_memdup2(buffer, size),
-			size);
-		GstAppSrc *appsrc = gst_object_ref (info->appsrc);
-
-		g_mutex_unlock (&manager->priv->appdata_mutex);
-		if (gst_app_src_push_buffer (appsrc, gstbuffer) == GST_FLOW_OK) {
-			if (blocking) {
-				GstPad *srcpad;
-
-				srcpad = gst_element_get_static_pad (GST_ELEMENT (appsrc),
-					"src");
-				if (srcpad) {
-					gst_pad_peer_query (srcpad, gst_query_new_drain ());
-					gst_object_unref (srcpad);
-				}
-			}
-			gst_object_unref (appsrc);
-			return size;
-		} else {
-			gst_object_unref (appsrc);
-			return -1;
+gint
+purple_media_manager_send_application_data_bytes (
+	PurpleMediaManager *manager, PurpleMedia *media, const gchar *session_id,
+	const gchar *participant, GBytes *bytes, gboolean blocking)
+{
+	PurpleMediaAppDataInfo *info;
+	GstBuffer *gstbuffer;
+	GstAppSrc *appsrc;
+	gconstpointer data;
+	gsize size;
+
+	g_return_val_if_fail (bytes != NULL, -1);
+
+	info = get_app_data_info_and_lock (manager, media, session_id,
+		participant);
+	if (info == NULL) {
+		g_bytes_unref (bytes);
+		return -1;
+	}
+
+	if (info->appsrc == NULL || !info->connected) {
+		app_data_info_unlock (info);
+		g_bytes_unref (bytes);
+		return -1;
+	}
+
+	appsrc = gst_object_ref (info->appsrc);
+	app_data_info_unlock (info);
+
+	/* The buffer keeps the bytes alive until the pipeline is done with it. */
+	data = g_bytes_get_data (bytes, &size);
+	gstbuffer = gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY,
+		(gpointer) data, size, 0, size, bytes,
+		(GDestroyNotify) g_bytes_unref);
+
+	if (gst_app_src_push_buffer (appsrc, gstbuffer) != GST_FLOW_OK) {
+		gst_object_unref (appsrc);
+		return -1;
+	}
+
+	if (blocking) {
+		GstPad *srcpad;
+
+		srcpad = gst_element_get_static_pad (GST_ELEMENT (appsrc), "src");
+		if (srcpad) {
+			GstQuery *query = gst_query_new_drain ();
+
+			gst_pad_peer_query (srcpad, query);
+			gst_query_unref (query);
+			gst_object_unref (srcpad);
 		}
 	}
-	g_mutex_unlock (&manager->priv->appdata_mutex);
-	return -1;
+
+	gst_object_unref (appsrc);
+	return (gint) size;
 }
 
 gint
@@ -1631,77 +1820,72 @@ purple_media_manager_receive_application_data (
 		media, session_id, participant);
 	guint bytes_read = 0;
 
-	if (info) {
-		/* If we are in a blocking read, we need to loop until max_size data
-		 * is read into the buffer, if we're not, then we need to read as much
-		 * data as possible
-		 */
-		do {
-			if (!info->current_sample && info->appsink && info->num_samples > 0) {
-				info->current_sample = gst_app_sink_pull_sample (info->appsink);
-				info->sample_offset = 0;
-				if (info->current_sample) {
-					info->num_samples--;
-				}
-			}
+	if (info == NULL) {
+		return -1;
+	}
 
+	/* If we are in a blocking read, we need to loop until max_size data
+	 * is read into the buffer, if we're not, then we need to read as much
+	 * data as possible
+	 */
+	do {
+		if (!info->current_sample && info->appsink && info->num_samples > 0) {
+			info->current_sample = gst_app_sink_pull_sample (info->appsink);
+			info->sample_offset = 0;
 			if (info->current_sample) {
-				GstBuffer *gstbuffer = gst_sample_get_buffer (
-					info->current_sample);
-
-				if (gstbuffer) {
-					GstMapInfo mapinfo;
-					guint bytes_to_copy;
-
-					gst_buffer_map (gstbuffer, &mapinfo, GST_MAP_READ);
-					/* We must copy only the data remaining in the buffer without
-					 * overflowing the buffer */
-					bytes_to_copy = MIN(max_size - bytes_read,
-					                    mapinfo.size - info->sample_offset);
-					memcpy ((guint8 *)buffer + bytes_read,
-						mapinfo.data + info->sample_offset,	bytes_to_copy);
-
-					gst_buffer_unmap (gstbuffer, &mapinfo);
-					info->sample_offset += bytes_to_copy;
-					bytes_read += bytes_to_copy;
-					if (info->sample_offset == mapinfo.size) {
-						gst_sample_unref (info->current_sample);
-						info->current_sample = NULL;
-						info->sample_offset = 0;
-					}
-				} else {
-					/* In case there's no buffer in the sample (should never
-					 * happen), we need to at least unref it */
+				info->num_samples--;
+			}
+		}
+
+		if (info->current_sample) {
+			GstBuffer *gstbuffer = gst_sample_get_buffer (
+				info->current_sample);
+
+			if (gstbuffer) {
+				GstMapInfo mapinfo;
+				guint bytes_to_copy;
+
+				gst_buffer_map (gstbuffer, &mapinfo, GST_MAP_READ);
+				/* We must copy only the data remaining in the buffer without
+				 * overflowing the buffer */
+				bytes_to_copy = MIN(max_size - bytes_read,
+				                    mapinfo.size - info->sample_offset);
+				memcpy ((guint8 *)buffer + bytes_read,
+					mapinfo.data + info->sample_offset,	bytes_to_copy);
+
+				gst_buffer_unmap (gstbuffer, &mapinfo);
+				info->sample_offset += bytes_to_copy;
+				bytes_read += bytes_to_copy;
+				if (info->sample_offset == mapinfo.size) {
 					gst_sample_unref (info->current_sample);
 					info->current_sample = NULL;
 					info->sample_offset = 0;
 				}
+			} else {
+				/* In case there's no buffer in the sample (should never
+				 * happen), we need to at least unref it */
+				gst_sample_unref (info->current_sample);
+				info->current_sample = NULL;
+				info->sample_offset = 0;
 			}
+		}
 
-			/* If blocking, wait until there's an available sample */
-			while (bytes_read < max_size && blocking &&
-				info->current_sample == NULL && info->num_samples == 0) {
-				g_cond_wait (&info->readable_cond, &manager->priv->appdata_mutex);
+		/* If blocking, wait until there's an available sample */
+		while (bytes_read < max_size && blocking &&
+			info->current_sample == NULL && info->num_samples == 0) {
+			g_cond_wait (&info->readable_cond, &info->mutex);
 
-				/* We've been signaled, we need to unlock and regrab the info
-				 * struct to make sure nothing changed */
-				g_mutex_unlock (&manager->priv->appdata_mutex);
-				info = get_app_data_info_and_lock (manager,
-					media, session_id, participant);
-				if (info == NULL || info->appsink == NULL) {
-					/* The session was destroyed while we were waiting, we
-					 * should return here */
-					g_mutex_unlock (&manager->priv->appdata_mutex);
-					return bytes_read;
-				}
+			/* We hold a reference, so the info is still there, but the
+			 * session may have been destroyed while we were waiting. */
+			if (info->media == NULL || info->appsink == NULL) {
+				app_data_info_unlock (info);
+				return bytes_read;
 			}
-		} while (bytes_read < max_size && (blocking || info->num_samples > 0));
+		}
+	} while (bytes_read < max_size && (blocking || info->num_samples > 0));
 
-		g_mutex_unlock (&manager->priv->appdata_mutex);
-		return bytes_read;
-	}
-	g_mutex_unlock (&manager->priv->appdata_mutex);
-	return -1;
+	app_data_info_unlock (info);
+	return bytes_read;
 }
 
 static void
@@ -330,6 +330,27 @@ gint purple_media_manager_send_application_data (
 	PurpleMediaManager *manager, PurpleMedia *media, const gchar *session_id,
 	const gchar *participant, gpointer buffer, guint size, gboolean blocking);
 
+/**
+ * purple_media_manager_send_application_data_bytes:
+ * @manager: The manager to send data with.
+ * @media: The media instance to which the session belongs.
+ * @session_id: The session to send data to.
+ * @participant: The participant to send data to.
+ * @bytes: (transfer full): The data to send.
+ * @blocking: Whether to block until the data was send or not.
+ *
+ * Sends @bytes to a #PURPLE_MEDIA_APPLICATION session without copying them,
+ * otherwise this behaves like purple_media_manager_send_application_data().
+ * The manager takes ownership of @bytes, even if sending fails.
+ *
+ * Returns: Number of bytes sent or -1 in case of error.
+ *
+ * Since: 3.0.0
+ */
+gint purple_media_manager_send_application_data_bytes (
+	PurpleMediaManager *manager, PurpleMedia *media, const gchar *session_id,
+	const gchar *participant, GBytes *bytes, gboolean blocking);
+
 /**
  * purple_media_manager_receive_application_data:
  * @manager: The manager to receive data with.
@@ -56,7 +56,7 @@ struct pref_cb {
 };
 
 /* TODO: This should use PurpleValues? */
-struct purple_pref {
+struct _PurplePref {
 	PurplePrefType type;
 	char *name;
 	union {
@@ -72,48 +72,102 @@ struct purple_pref {
 		GList *stringlist;
 	} value;
 	GSList *callbacks;
-	struct purple_pref *parent;
-	struct purple_pref *sibling;
-	struct purple_pref *first_child;
+	PurplePref *parent;
+	PurplePref *sibling;
+	PurplePref *first_child;
+
+	/* The children keyed by their name, so lookups walk the tree one path
+	 * component at a time. The sibling list above keeps them in order. */
+	GHashTable *children;
+	/* The full name, for callbacks fired through a pref handle. */
+	char *path;
+	/* Whether the pref is waiting for its callbacks in a batch. */
+	gboolean pending;
 };
 
 
-static struct purple_pref prefs = {
+static PurplePref prefs = {
 	PURPLE_PREF_NONE,
 	NULL,
 	{ NULL },
 	NULL,
 	NULL,
 	NULL,
-	NULL
+	NULL,
+	NULL,
+	NULL,
+	FALSE
 };
 
-static GHashTable *prefs_hash = NULL;
 static guint       save_timer = 0;
 static gboolean    prefs_loaded = FALSE;
 
+/* Prefs changed since the outermost purple_prefs_begin_batch(), in the order
+ * they were first changed. */
+static guint       batch_depth = 0;
+static GPtrArray  *batch_changed = NULL;
+
 /*********************************************************************
  * Private utility functions                                         *
  *********************************************************************/
 
-static struct
-purple_pref *find_pref(const char *name)
+static PurplePref *
+find_child(PurplePref *parent, const char *segment, gsize len)
 {
+	char buf[64];
+	char *key = buf;
+	PurplePref *child;
+
+	if (parent->children == NULL)
+		return NULL;
+
+	/* Path components are short, so avoid allocating for the lookup. */
+	if (len < sizeof(buf)) {
+		memcpy(buf, segment, len);
+		buf[len] = '\0';
+	} else {
+		key = g_strndup(segment, len);
+	}
+
+	child = g_hash_table_lookup(parent->children, key);
+
+	if (key != buf)
+		g_free(key);
+
+	return child;
+}
+
+/* When we're initializing, the debug system is initialized before the prefs
+ * system, but debug calls will end up calling prefs functions. The tree is
+ * empty until then, so lookups just fail. */
+static PurplePref *
+find_pref(const char *name)
+{
+	PurplePref *pref = &prefs;
+	const char *segment;
+
 	g_return_val_if_fail(name != NULL && name[0] == '/', NULL);
 
 	if (name[1] == '\0')
 		return &prefs;
-	else
-	{
-		/* When we're initializing, the debug system is
-		 * initialized before the prefs system, but debug
-		 * calls will end up calling prefs functions, so we
-		 * need to deal cleanly here. */
-		if (prefs_hash)
-			return g_hash_table_lookup(prefs_hash, name);
-		else
+
+	segment = name + 1;
+	while (pref != NULL) {
+		const char *end = strchr(segment, '/');
+		gsize len = (end != NULL) ? (gsize)(end - segment) : strlen(segment);
+
+		if (len == 0)
 			return NULL;
+
+		pref = find_child(pref, segment, len);
+
+		if (end == NULL)
+			break;
+
+		segment = end + 1;
 	}
+
+	return pref;
 }
 
 
@@ -126,10 +180,10 @@ purple_pref *find_pref(const char *name)
  * tree structure.  Yay recursion!
  */
 static void
-pref_to_xmlnode(PurpleXmlNode *parent, struct purple_pref *pref)
+pref_to_xmlnode(PurpleXmlNode *parent, PurplePref *pref)
 {
 	PurpleXmlNode *node, *childnode;
-	struct purple_pref *child;
+	PurplePref *child;
 	char buf[21];
 	GList *cur;
 
@@ -186,7 +240,7 @@ static PurpleXmlNode *
 prefs_to_xmlnode(void)
 {
 	PurpleXmlNode *node;
-	struct purple_pref *pref, *child;
+	PurplePref *pref, *child;
 
 	pref = &prefs;
 
@@ -296,7 +350,7 @@ prefs_start_element_handler (GMarkupParseContext *context,
 	}
 
 	if(purple_strequal(element_name, "item")) {
-		struct purple_pref *pref;
+		PurplePref *pref;
 
 		pref_name_full = g_string_new("");
 
@@ -510,10 +564,10 @@ get_path_basename(const char *name)
 }
 
 static char *
-pref_full_name(struct purple_pref *pref)
+pref_full_name(PurplePref *pref)
 {
 	GString *name;
-	struct purple_pref *parent;
+	PurplePref *parent;
 
 	if(!pref)
 		return NULL;
@@ -531,11 +585,11 @@ pref_full_name(struct purple_pref *pref)
 	return g_string_free(name, FALSE);
 }
 
-static struct purple_pref *
+static PurplePref *
 find_pref_parent(const char *name)
 {
 	char *parent_name = get_path_dirname(name);
-	struct purple_pref *ret = &prefs;
+	PurplePref *ret = &prefs;
 
 	if(!purple_strequal(parent_name, "/")) {
 		ret = find_pref(parent_name);
@@ -546,7 +600,7 @@ find_pref_parent(const char *name)
 }
 
 static void
-free_pref_value(struct purple_pref *pref)
+free_pref_value(PurplePref *pref)
 {
 	switch(pref->type) {
 		case PURPLE_PREF_BOOLEAN:
@@ -569,12 +623,12 @@ free_pref_value(struct purple_pref *pref)
 	}
 }
 
-static struct purple_pref *
+static PurplePref *
 add_pref(PurplePrefType type, const char *name)
 {
-	struct purple_pref *parent;
-	struct purple_pref *me;
-	struct purple_pref *sibling;
+	PurplePref *parent;
+	PurplePref *me;
+	PurplePref *sibling;
 	char *my_name;
 
 	parent = find_pref_parent(name);
@@ -583,16 +637,16 @@ add_pref(PurplePrefType type, const char *name)
 
 	my_name = get_path_basename(name);
 
-	for(sibling = parent->first_child; sibling; sibling = sibling->sibling) {
-		if(purple_strequal(sibling->name, my_name)) {
-			g_free(my_name);
-			return NULL;
-		}
+	if(parent->children != NULL &&
+	   g_hash_table_contains(parent->children, my_name)) {
+		g_free(my_name);
+		return NULL;
 	}
 
-	me = g_new0(struct purple_pref, 1);
+	me = g_new0(PurplePref, 1);
 	me->type = type;
 	me->name = my_name;
+	me->path = g_strdup(name);
 
 	me->parent = parent;
 	if(parent->first_child) {
@@ -604,7 +658,10 @@ add_pref(PurplePrefType type, const char *name)
 		parent->first_child = me;
 	}
 
-	g_hash_table_insert(prefs_hash, g_strdup(name), (gpointer)me);
+	if(parent->children == NULL) {
+		parent->children = g_hash_table_new(g_str_hash, g_str_equal);
+	}
+	g_hash_table_insert(parent->children, me->name, me);
 
 	return me;
 }
@@ -618,7 +675,7 @@ purple_prefs_add_none(const char *name)
 void
 purple_prefs_add_bool(const char *name, gboolean value)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 
 	pref = add_pref(PURPLE_PREF_BOOLEAN, name);
 
@@ -631,7 +688,7 @@ purple_prefs_add_bool(const char *name, gboolean value)
 void
 purple_prefs_add_int(const char *name, int value)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 
 	pref = add_pref(PURPLE_PREF_INT, name);
 
@@ -644,7 +701,7 @@ purple_prefs_add_int(const char *name, int value)
 void
 purple_prefs_add_string(const char *name, const char *value)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 
 	if(value != NULL && !g_utf8_validate(value, -1, NULL)) {
 		purple_debug_error("prefs", "purple_prefs_add_string: Cannot store invalid UTF8 for string pref %s\n", name);
@@ -662,7 +719,7 @@ purple_prefs_add_string(const char *name, const char *value)
 void
 purple_prefs_add_string_list(const char *name, GList *value)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 	GList *tmp;
 
 	pref = add_pref(PURPLE_PREF_STRING_LIST, name);
@@ -683,7 +740,7 @@ purple_prefs_add_string_list(const char *name, GList *value)
 void
 purple_prefs_add_path(const char *name, const char *value)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 
 	pref = add_pref(PURPLE_PREF_PATH, name);
 
@@ -696,7 +753,7 @@ purple_prefs_add_path(const char *name, const char *value)
 void
 purple_prefs_add_path_list(const char *name, GList *value)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 
 	pref = add_pref(PURPLE_PREF_PATH_LIST, name);
 
@@ -708,30 +765,38 @@ purple_prefs_add_path_list(const char *name, GList *value)
 }
 
 static void
-free_pref(struct purple_pref *pref)
+free_pref(PurplePref *pref)
 {
-	char *name;
-
-	name = pref_full_name(pref);
-
 	if (prefs_loaded) {
-		purple_debug_info("prefs", "removing pref %s\n", name);
+		purple_debug_info("prefs", "removing pref %s\n", pref->path);
+	}
+
+	/* Children are always freed before their parent. */
+	if (pref->parent != NULL && pref->parent->children != NULL) {
+		g_hash_table_remove(pref->parent->children, pref->name);
 	}
+	g_clear_pointer(&pref->children, g_hash_table_destroy);
+
+	if (pref->pending) {
+		guint index;
 
-	g_hash_table_remove(prefs_hash, name);
-	g_free(name);
+		if (g_ptr_array_find(batch_changed, pref, &index)) {
+			g_ptr_array_index(batch_changed, index) = NULL;
+		}
+	}
 
 	free_pref_value(pref);
 
 	g_slist_free_full(pref->callbacks, g_free);
+	g_free(pref->path);
 	g_free(pref->name);
 	g_free(pref);
 }
 
 static void
-remove_pref(struct purple_pref *pref)
+remove_pref(PurplePref *pref)
 {
-	struct purple_pref *child;
+	PurplePref *child;
 
 	if (!pref) {
 		return;
@@ -740,7 +805,7 @@ remove_pref(struct purple_pref *pref)
 	child = pref->first_child;
 	pref->first_child = NULL;
 	while (child) {
-		struct purple_pref *next;
+		PurplePref *next;
 		if (child->first_child) {
 			next = child->first_child;
 			child->first_child = NULL;
@@ -781,7 +846,7 @@ remove_pref(struct purple_pref *pref)
 void
 purple_prefs_remove(const char *name)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 
 	pref = find_pref(name);
 
@@ -798,10 +863,21 @@ purple_prefs_destroy()
 }
 
 static void
-do_callbacks(const char* name, struct purple_pref *pref)
+do_callbacks(const char* name, PurplePref *pref)
 {
 	GSList *cbs;
-	struct purple_pref *cb_pref;
+	PurplePref *cb_pref;
+
+	/* Inside a batch, only remember that the pref changed. Its callbacks run
+	 * once, with the final value, when the batch ends. */
+	if(batch_depth > 0) {
+		if(!pref->pending) {
+			pref->pending = TRUE;
+			g_ptr_array_add(batch_changed, pref);
+		}
+		return;
+	}
+
 	for(cb_pref = pref; cb_pref; cb_pref = cb_pref->parent) {
 		for(cbs = cb_pref->callbacks; cbs; cbs = cbs->next) {
 			PurplePrefCallbackData *cb = cbs->data;
@@ -813,7 +889,7 @@ do_callbacks(const char* name, struct purple_pref *pref)
 void
 purple_prefs_trigger_callback(const char *name)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 
 	pref = find_pref(name);
 
@@ -826,11 +902,154 @@ purple_prefs_trigger_callback(const char *name)
 	do_callbacks(name, pref);
 }
 
+void
+purple_prefs_begin_batch(void)
+{
+	if(batch_changed == NULL) {
+		batch_changed = g_ptr_array_new();
+	}
+
+	batch_depth++;
+}
+
+void
+purple_prefs_end_batch(void)
+{
+	g_return_if_fail(batch_depth > 0);
+
+	if(--batch_depth > 0) {
+		return;
+	}
+
+	/* Callbacks may change, add or remove prefs, or run batches of their
+	 * own, so walk the array by index and let free_pref() blank out
+	 * anything that goes away. */
+	for(guint i = 0; i < batch_changed->len; i++) {
+		PurplePref *pref = g_ptr_array_index(batch_changed, i);
+
+		if(pref == NULL) {
+			continue;
+		}
+
+		g_ptr_array_index(batch_changed, i) = NULL;
+		pref->pending = FALSE;
+
+		do_callbacks(purple_pref_get_name(pref), pref);
+	}
+
+	if(batch_depth == 0) {
+		g_ptr_array_set_size(batch_changed, 0);
+	}
+}
+
+PurplePref *
+purple_prefs_lookup(const char *name)
+{
+	g_return_val_if_fail(name != NULL, NULL);
+
+	return find_pref(name);
+}
+
+PurplePrefType
+purple_pref_get_pref_type(PurplePref *pref)
+{
+	g_return_val_if_fail(pref != NULL, PURPLE_PREF_NONE);
+
+	return pref->type;
+}
+
+const char *
+purple_pref_get_name(PurplePref *pref)
+{
+	g_return_val_if_fail(pref != NULL, NULL);
+
+	return (pref == &prefs) ? "/" : pref->path;
+}
+
+gboolean
+purple_pref_get_bool(PurplePref *pref)
+{
+	g_return_val_if_fail(pref != NULL, FALSE);
+	g_return_val_if_fail(pref->type == PURPLE_PREF_BOOLEAN, FALSE);
+
+	return pref->value.boolean;
+}
+
+int
+purple_pref_get_int(PurplePref *pref)
+{
+	g_return_val_if_fail(pref != NULL, 0);
+	g_return_val_if_fail(pref->type == PURPLE_PREF_INT, 0);
+
+	return pref->value.integer;
+}
+
+const char *
+purple_pref_get_string(PurplePref *pref)
+{
+	g_return_val_if_fail(pref != NULL, NULL);
+	g_return_val_if_fail(pref->type == PURPLE_PREF_STRING ||
+	                     pref->type == PURPLE_PREF_PATH, NULL);
+
+	return pref->value.string;
+}
+
+void
+purple_pref_set_bool(PurplePref *pref, gboolean value)
+{
+	g_return_if_fail(pref != NULL);
+	g_return_if_fail(pref->type == PURPLE_PREF_BOOLEAN);
+
+	if(pref->value.boolean != value) {
+		pref->value.boolean = value;
+		do_callbacks(pref->path, pref);
+	}
+}
+
+void
+purple_pref_set_int(PurplePref *pref, int value)
+{
+	g_return_if_fail(pref != NULL);
+	g_return_if_fail(pref->type == PURPLE_PREF_INT);
+
+	if(pref->value.integer != value) {
+		pref->value.integer = value;
+		do_callbacks(pref->path, pref);
+	}
+}
+
+static void
+set_string_value(PurplePref *pref, const char *value)
+{
+	if (!purple_strequal(pref->value.string, value)) {
+		g_free(pref->value.string);
+		pref->value.string = g_strdup(value);
+		do_callbacks(pref->path, pref);
+	}
+}
+
+void
+purple_pref_set_string(PurplePref *pref, const char *value)
+{
+	g_return_if_fail(pref != NULL);
+	g_return_if_fail(pref->type == PURPLE_PREF_STRING ||
+	                 pref->type == PURPLE_PREF_PATH);
+
+	if(value != NULL && pref->type == PURPLE_PREF_STRING &&
+	   !g_utf8_validate(value, -1, NULL))
+	{
+		purple_debug_error("prefs", "purple_pref_set_string: Cannot store invalid UTF8 for string pref %s\n", pref->path);
+		return;
+	}
+
+	set_string_value(pref, value);
+}
+
 /* this function is deprecated, so it doesn't get the new UI ops */
 void
 purple_prefs_set_bool(const char *name, gboolean value)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 
 	pref = find_pref(name);
 
@@ -841,10 +1060,7 @@ purple_prefs_set_bool(const char *name, gboolean value)
 			return;
 		}
 
-		if(pref->value.boolean != value) {
-			pref->value.boolean = value;
-			do_callbacks(name, pref);
-		}
+		purple_pref_set_bool(pref, value);
 	} else {
 		purple_prefs_add_bool(name, value);
 	}
@@ -853,7 +1069,7 @@ purple_prefs_set_bool(const char *name, gboolean value)
 void
 purple_prefs_set_int(const char *name, int value)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 
 	pref = find_pref(name);
 
@@ -864,10 +1080,7 @@ purple_prefs_set_int(const char *name, int value)
 			return;
 		}
 
-		if(pref->value.integer != value) {
-			pref->value.integer = value;
-			do_callbacks(name, pref);
-		}
+		purple_pref_set_int(pref, value);
 	} else {
 		purple_prefs_add_int(name, value);
 	}
@@ -876,7 +1089,7 @@ purple_prefs_set_int(const char *name, int value)
 void
 purple_prefs_set_string(const char *name, const char *value)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 
 	if(value != NULL && !g_utf8_validate(value, -1, NULL)) {
 		purple_debug_error("prefs", "purple_prefs_set_string: Cannot store invalid UTF8 for string pref %s\n", name);
@@ -892,11 +1105,7 @@ purple_prefs_set_string(const char *name, const char *value)
 			return;
 		}
 
-		if (!purple_strequal(pref->value.string, value)) {
-			g_free(pref->value.string);
-			pref->value.string = g_strdup(value);
-			do_callbacks(name, pref);
-		}
+		set_string_value(pref, value);
 	} else {
 		purple_prefs_add_string(name, value);
 	}
@@ -905,7 +1114,7 @@ purple_prefs_set_string(const char *name, const char *value)
 void
 purple_prefs_set_string_list(const char *name, GList *value)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 
 	pref = find_pref(name);
 
@@ -942,7 +1151,7 @@ purple_prefs_set_string_list(const char *name, GList *value)
 void
 purple_prefs_set_path(const char *name, const char *value)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 
 	pref = find_pref(name);
 
@@ -953,11 +1162,7 @@ purple_prefs_set_path(const char *name, const char *value)
 			return;
 		}
 
-		if (!purple_strequal(pref->value.string, value)) {
-			g_free(pref->value.string);
-			pref->value.string = g_strdup(value);
-			do_callbacks(name, pref);
-		}
+		set_string_value(pref, value);
 	} else {
 		purple_prefs_add_path(name, value);
 	}
@@ -966,7 +1171,7 @@ purple_prefs_set_path(const char *name, const char *value)
 void
 purple_prefs_set_path_list(const char *name, GList *value)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 
 	pref = find_pref(name);
 
@@ -992,7 +1197,7 @@ purple_prefs_set_path_list(const char *name, GList *value)
 gboolean
 purple_prefs_exists(const char *name)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 
 	pref = find_pref(name);
 
@@ -1005,7 +1210,7 @@ purple_prefs_exists(const char *name)
 PurplePrefType
 purple_prefs_get_pref_type(const char *name)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 
 	pref = find_pref(name);
 
@@ -1018,7 +1223,7 @@ purple_prefs_get_pref_type(const char *name)
 gboolean
 purple_prefs_get_bool(const char *name)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 
 	pref = find_pref(name);
 
@@ -1038,7 +1243,7 @@ purple_prefs_get_bool(const char *name)
 int
 purple_prefs_get_int(const char *name)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 
 	pref = find_pref(name);
 
@@ -1058,7 +1263,7 @@ purple_prefs_get_int(const char *name)
 const char *
 purple_prefs_get_string(const char *name)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 
 	pref = find_pref(name);
 
@@ -1078,7 +1283,7 @@ purple_prefs_get_string(const char *name)
 GList *
 purple_prefs_get_string_list(const char *name)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 
 	pref = find_pref(name);
 
@@ -1098,7 +1303,7 @@ purple_prefs_get_string_list(const char *name)
 const char *
 purple_prefs_get_path(const char *name)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 
 	pref = find_pref(name);
 
@@ -1118,7 +1323,7 @@ purple_prefs_get_path(const char *name)
 GList *
 purple_prefs_get_path_list(const char *name)
 {
-	struct purple_pref *pref;
+	PurplePref *pref;
 
 	pref = find_pref(name);
 
@@ -1136,15 +1341,15 @@ purple_prefs_get_path_list(const char *name)
 }
 
 static void
-purple_prefs_rename_node(struct purple_pref *oldpref, struct purple_pref *newpref)
+purple_prefs_rename_node(PurplePref *oldpref, PurplePref *newpref)
 {
-	struct purple_pref *child, *next;
+	PurplePref *child, *next;
 	char *oldname, *newname;
 
 	/* if we're a parent, rename the kids first */
 	for(child = oldpref->first_child; child != NULL; child = next)
 	{
-		struct purple_pref *newchild;
+		PurplePref *newchild;
 		next = child->sibling;
 		for(newchild = newpref->first_child; newchild != NULL; newchild = newchild->sibling)
 		{
@@ -1206,7 +1411,7 @@ purple_prefs_rename_node(struct purple_pref *oldpref, struct purple_pref *newpre
 void
 purple_prefs_rename(const char *oldname, const char *newname)
 {
-	struct purple_pref *oldpref, *newpref;
+	PurplePref *oldpref, *newpref;
 
 	oldpref = find_pref(oldname);
 
@@ -1228,7 +1433,7 @@ purple_prefs_rename(const char *oldname, const char *newname)
 void
 purple_prefs_rename_boolean_toggle(const char *oldname, const char *newname)
 {
-		struct purple_pref *oldpref, *newpref;
+		PurplePref *oldpref, *newpref;
 
 		oldpref = find_pref(oldname);
 
@@ -1272,7 +1477,7 @@ purple_prefs_rename_boolean_toggle(const char *oldname, const char *newname)
 guint
 purple_prefs_connect_callback(void *handle, const char *name, PurplePrefCallback func, gpointer data)
 {
-	struct purple_pref *pref = NULL;
+	PurplePref *pref = NULL;
 	PurplePrefCallbackData *cb;
 	static guint cb_id = 0;
 	g_return_val_if_fail(name != NULL, 0);
@@ -1304,10 +1509,10 @@ purple_prefs_trigger_callback_object(PurplePrefCallbackData *cb)
 }
 
 static gboolean
-disco_callback_helper(struct purple_pref *pref, guint callback_id)
+disco_callback_helper(PurplePref *pref, guint callback_id)
 {
 	GSList *cbs;
-	struct purple_pref *child;
+	PurplePref *child;
 
 	if(!pref)
 		return FALSE;
@@ -1337,10 +1542,10 @@ purple_prefs_disconnect_callback(guint callback_id)
 }
 
 static void
-disco_callback_helper_handle(struct purple_pref *pref, void *handle)
+disco_callback_helper_handle(PurplePref *pref, void *handle)
 {
 	GSList *cbs;
-	struct purple_pref *child;
+	PurplePref *child;
 
 	if(!pref)
 		return;
@@ -1373,7 +1578,7 @@ GList *
 purple_prefs_get_children_names(const char *name)
 {
 	GList * list = NULL;
-	struct purple_pref *pref, *child;
+	PurplePref *pref, *child;
 	char sep[2] = "\0\0";;
 
 	pref = find_pref(name);
@@ -1439,8 +1644,6 @@ purple_prefs_init(void)
 {
 	void *handle = purple_prefs_get_handle();
 
-	prefs_hash = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
-
 	purple_prefs_connect_callback(handle, "/", prefs_save_cb, NULL);
 
 	purple_prefs_add_none("/purple");
@@ -1506,6 +1709,7 @@ purple_prefs_uninit()
 
 	prefs_loaded = FALSE;
 	purple_prefs_destroy();
-	g_hash_table_destroy(prefs_hash);
-	prefs_hash = NULL;
+	g_clear_pointer(&prefs.children, g_hash_table_destroy);
+	g_clear_pointer(&batch_changed, g_ptr_array_unref);
+	batch_depth = 0;
 }
@@ -81,6 +81,18 @@ typedef void (*PurplePrefCallback) (const char *name, PurplePrefType type,
  */
 typedef struct _PurplePrefCallbackData PurplePrefCallbackData;
 
+/**
+ * PurplePref:
+ *
+ * An opaque handle to a single preference, as returned by
+ * purple_prefs_lookup(). Reading a pref through its handle skips looking up
+ * its name, so code that reads a pref often should look it up once and keep
+ * the handle. A handle stays valid until the pref is removed.
+ *
+ * Since: 3.0.0
+ */
+typedef struct _PurplePref PurplePref;
+
 G_BEGIN_DECLS
 
 /**************************************************************************/
@@ -415,6 +427,140 @@ void purple_prefs_trigger_callback(const char *name);
  */
 void purple_prefs_trigger_callback_object(PurplePrefCallbackData *data);
 
+/**
+ * purple_prefs_begin_batch:
+ *
+ * Starts a batch of changes. Until the matching purple_prefs_end_batch(),
+ * changed prefs only have their callbacks held back, so a pref that is set
+ * several times notifies its callbacks once, with its final value. Batches
+ * may be nested; callbacks run when the outermost one ends.
+ *
+ * Since: 3.0.0
+ */
+void purple_prefs_begin_batch(void);
+
+/**
+ * purple_prefs_end_batch:
+ *
+ * Ends a batch started with purple_prefs_begin_batch(). If it was the
+ * outermost batch, the callbacks of every pref that changed during it are
+ * called, in the order the prefs were first changed.
+ *
+ * Since: 3.0.0
+ */
+void purple_prefs_end_batch(void);
+
+/**************************************************************************/
+/*  Pref handles                                                          */
+/**************************************************************************/
+
+/**
+ * purple_prefs_lookup:
+ * @name: The name of the pref.
+ *
+ * Looks up a pref once so it can be read and written without going through
+ * its name again.
+ *
+ * Returns: (transfer none) (nullable): The pref, or %NULL if it doesn't
+ *          exist.
+ *
+ * Since: 3.0.0
+ */
+PurplePref *purple_prefs_lookup(const char *name);
+
+/**
+ * purple_pref_get_name:
+ * @pref: The pref.
+ *
+ * Gets the full name of @pref.
+ *
+ * Returns: The name of @pref.
+ *
+ * Since: 3.0.0
+ */
+const char *purple_pref_get_name(PurplePref *pref);
+
+/**
+ * purple_pref_get_pref_type:
+ * @pref: The pref.
+ *
+ * Gets the type of @pref.
+ *
+ * Returns: The type of @pref.
+ *
+ * Since: 3.0.0
+ */
+PurplePrefType purple_pref_get_pref_type(PurplePref *pref);
+
+/**
+ * purple_pref_get_bool:
+ * @pref: A boolean pref.
+ *
+ * Gets the value of a boolean pref.
+ *
+ * Returns: The value of @pref.
+ *
+ * Since: 3.0.0
+ */
+gboolean purple_pref_get_bool(PurplePref *pref);
+
+/**
+ * purple_pref_get_int:
+ * @pref: An integer pref.
+ *
+ * Gets the value of an integer pref.
+ *
+ * Returns: The value of @pref.
+ *
+ * Since: 3.0.0
+ */
+int purple_pref_get_int(PurplePref *pref);
+
+/**
+ * purple_pref_get_string:
+ * @pref: A string or path pref.
+ *
+ * Gets the value of a string or path pref.
+ *
+ * Returns: The value of @pref.
+ *
+ * Since: 3.0.0
+ */
+const char *purple_pref_get_string(PurplePref *pref);
+
+/**
+ * purple_pref_set_bool:
+ * @pref: A boolean pref.
+ * @value: The new value.
+ *
+ * Sets the value of a boolean pref.
+ *
+ * Since: 3.0.0
+ */
+void purple_pref_set_bool(PurplePref *pref, gboolean value);
+
+/**
+ * purple_pref_set_int:
+ * @pref: An integer pref.
+ * @value: The new value.
+ *
+ * Sets the value of an integer pref.
+ *
+ * Since: 3.0.0
+ */
+void purple_pref_set_int(PurplePref *pref, int value);
+
+/**
+ * purple_pref_set_string:
+ * @pref: A string or path pref.
+ * @value: (nullable): The new value.
+ *
+ * Sets the value of a string or path pref.
+ *
+ * Since: 3.0.0
+ */
+void purple_pref_set_string(PurplePref *pref, const char *value);
+
 /**
  * purple_prefs_load:
  *
@@ -0,0 +1,417 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <time.h>
+
+#include <glib/gi18n-lib.h>
+
+#include "purpledemoload.h"
+
+#include "purpledemoxfer.h"
+
+/* The load generator works in fixed ticks rather than on the wall clock, so
+ * the same seed always produces the same sequence of events no matter how
+ * busy the machine is.  Rates are given per second and spread over the ticks
+ * of that second.
+ */
+#define PURPLE_DEMO_LOAD_TICKS_PER_SECOND (10)
+#define PURPLE_DEMO_LOAD_KEY "demo-load"
+
+/* The id of the first chat we join, so they don't collide with anything else
+ * the demo protocol might do.
+ */
+#define PURPLE_DEMO_LOAD_CHAT_ID_BASE (1000)
+
+static const gchar *words[] = {
+	"lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing",
+	"elit", "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore",
+	"et", "dolore", "magna", "aliqua", "pidgin", "purple", "finch",
+};
+
+static const gchar *statuses[] = { "available", "away", "offline" };
+
+typedef struct {
+	PurpleConnection *connection;
+
+	GRand *rand;
+	GPtrArray *contacts;
+
+	gint presence_rate;
+	gint presence_acc;
+	gint im_rate;
+	gint im_acc;
+	gint chat_rate;
+	gint chat_acc;
+	gint n_chats;
+
+	gint message_min;
+	gint message_max;
+
+	gint xfer_interval;
+	guint64 ticks;
+	guint64 xfers;
+
+	guint source;
+} PurpleDemoLoad;
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static void
+purple_demo_load_free(PurpleDemoLoad *load) {
+	g_clear_handle_id(&load->source, g_source_remove);
+	g_rand_free(load->rand);
+	g_ptr_array_free(load->contacts, TRUE);
+	g_free(load);
+}
+
+/* Returns how many events should happen this tick for @rate events per
+ * second, carrying the remainder over in @acc.
+ */
+static gint
+purple_demo_load_events(gint rate, gint *acc) {
+	gint events = 0;
+
+	*acc += rate;
+	events = *acc / PURPLE_DEMO_LOAD_TICKS_PER_SECOND;
+	*acc %= PURPLE_DEMO_LOAD_TICKS_PER_SECOND;
+
+	return events;
+}
+
+static const gchar *
+purple_demo_load_random_contact(PurpleDemoLoad *load) {
+	guint index = g_rand_int_range(load->rand, 0, load->contacts->len);
+
+	return g_ptr_array_index(load->contacts, index);
+}
+
+/* Builds a message whose length is skewed towards the minimum, with the
+ * occasional one near the maximum, which is roughly what real traffic looks
+ * like.
+ */
+static gchar *
+purple_demo_load_random_message(PurpleDemoLoad *load) {
+	GString *message = NULL;
+	gdouble skew = g_rand_double(load->rand);
+	gsize size = 0;
+
+	size = load->message_min +
+	       (gsize)((load->message_max - load->message_min) * skew * skew * skew);
+
+	message = g_string_sized_new(size + 16);
+	while(message->len < size) {
+		guint index = g_rand_int_range(load->rand, 0, G_N_ELEMENTS(words));
+
+		if(message->len > 0) {
+			g_string_append_c(message, ' ');
+		}
+		g_string_append(message, words[index]);
+	}
+	g_string_truncate(message, size);
+
+	return g_string_free(message, FALSE);
+}
+
+static void
+purple_demo_load_add_contacts(PurpleDemoLoad *load, gint n_groups) {
+	PurpleAccount *account = NULL;
+	PurpleGroup **groups = NULL;
+
+	account = purple_connection_get_account(load->connection);
+
+	groups = g_new0(PurpleGroup *, n_groups);
+	for(gint i = 0; i < n_groups; i++) {
+		gchar *name = g_strdup_printf("Load %d", i);
+
+		groups[i] = purple_blist_find_group(name);
+		if(groups[i] == NULL) {
+			groups[i] = purple_group_new(name);
+			purple_blist_add_group(groups[i], NULL);
+		}
+
+		g_free(name);
+	}
+
+	for(guint i = 0; i < load->contacts->len; i++) {
+		const gchar *name = g_ptr_array_index(load->contacts, i);
+
+		if(purple_blist_find_buddy(account, name) == NULL) {
+			PurpleBuddy *buddy = purple_buddy_new(account, name, NULL);
+
+			purple_blist_add_buddy(buddy, NULL, groups[i % n_groups], NULL);
+		}
+
+		purple_protocol_got_user_status(account, name, "available", NULL);
+	}
+
+	g_free(groups);
+}
+
+static void
+purple_demo_load_join_chats(PurpleDemoLoad *load, gint n_users) {
+	guint *indices = NULL;
+
+	/* Each chat gets a random selection of distinct contacts, picked by
+	 * shuffling the front of the index list.
+	 */
+	n_users = MIN((guint)n_users, load->contacts->len);
+	indices = g_new(guint, load->contacts->len);
+	for(guint i = 0; i < load->contacts->len; i++) {
+		indices[i] = i;
+	}
+
+	for(gint i = 0; i < load->n_chats; i++) {
+		PurpleConversation *conversation = NULL;
+		GList *users = NULL, *flags = NULL;
+		gchar *name = g_strdup_printf("load-room-%d", i);
+
+		conversation = purple_serv_got_joined_chat(load->connection,
+		                                           PURPLE_DEMO_LOAD_CHAT_ID_BASE + i,
+		                                           name);
+		g_free(name);
+
+		if(!PURPLE_IS_CHAT_CONVERSATION(conversation)) {
+			continue;
+		}
+
+		for(gint j = 0; j < n_users; j++) {
+			guint k = g_rand_int_range(load->rand, j, load->contacts->len);
+			guint tmp = indices[j];
+
+			indices[j] = indices[k];
+			indices[k] = tmp;
+
+			users = g_list_prepend(users,
+			                       g_ptr_array_index(load->contacts,
+			                                         indices[j]));
+			flags = g_list_prepend(flags,
+			                       GINT_TO_POINTER(PURPLE_CHAT_USER_NONE));
+		}
+
+		if(users != NULL) {
+			purple_chat_conversation_add_users(
+				PURPLE_CHAT_CONVERSATION(conversation), users, NULL, flags,
+				FALSE);
+		}
+
+		g_list_free(users);
+		g_list_free(flags);
+	}
+
+	g_free(indices);
+}
+
+static void
+purple_demo_load_offer_xfer(PurpleDemoLoad *load) {
+	PurpleAccount *account = NULL;
+	PurpleXfer *xfer = NULL;
+	gchar *filename = NULL;
+	goffset size = 0;
+
+	account = purple_connection_get_account(load->connection);
+
+	/* Anywhere from 64 KiB to 16 MiB. */
+	size = g_rand_int_range(load->rand, 64, 16 * 1024) * 1024;
+	filename = g_strdup_printf("load-%" G_GUINT64_FORMAT ".bin", load->xfers++);
+
+	xfer = purple_demo_xfer_new(account, purple_demo_load_random_contact(load),
+	                            filename, size);
+	purple_xfer_request(xfer);
+
+	g_free(filename);
+}
+
+/******************************************************************************
+ * Callbacks
+ *****************************************************************************/
+static gboolean
+purple_demo_load_tick_cb(gpointer data) {
+	PurpleDemoLoad *load = data;
+	PurpleAccount *account = purple_connection_get_account(load->connection);
+	time_t now = time(NULL);
+	gint events = 0;
+
+	load->ticks++;
+
+	events = purple_demo_load_events(load->presence_rate, &load->presence_acc);
+	for(gint i = 0; i < events; i++) {
+		const gchar *who = purple_demo_load_random_contact(load);
+		guint index = g_rand_int_range(load->rand, 0, G_N_ELEMENTS(statuses));
+
+		purple_protocol_got_user_status(account, who, statuses[index], NULL);
+	}
+
+	events = purple_demo_load_events(load->im_rate, &load->im_acc);
+	for(gint i = 0; i < events; i++) {
+		const gchar *who = purple_demo_load_random_contact(load);
+		gchar *message = purple_demo_load_random_message(load);
+
+		purple_serv_got_im(load->connection, who, message,
+		                   PURPLE_MESSAGE_RECV, now);
+
+		g_free(message);
+	}
+
+	if(load->n_chats > 0) {
+		events = purple_demo_load_events(load->chat_rate, &load->chat_acc);
+		for(gint i = 0; i < events; i++) {
+			const gchar *who = purple_demo_load_random_contact(load);
+			gchar *message = purple_demo_load_random_message(load);
+			gint id = g_rand_int_range(load->rand, 0, load->n_chats);
+
+			purple_serv_got_chat_in(load->connection,
+			                        PURPLE_DEMO_LOAD_CHAT_ID_BASE + id, who,
+			                        PURPLE_MESSAGE_RECV, message, now);
+
+			g_free(message);
+		}
+	}
+
+	if(load->xfer_interval > 0 &&
+	   load->ticks % (load->xfer_interval * PURPLE_DEMO_LOAD_TICKS_PER_SECOND) == 0)
+	{
+		purple_demo_load_offer_xfer(load);
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+/******************************************************************************
+ * Local Exports
+ *****************************************************************************/
+GList *
+purple_demo_load_get_account_options(void) {
+	PurpleAccountOption *option = NULL;
+	GList *options = NULL;
+
+	option = purple_account_option_bool_new(_("Generate synthetic load"),
+	                                        "load-generator", FALSE);
+	options = g_list_append(options, option);
+
+	option = purple_account_option_int_new(_("Load seed"), "load-seed", 1);
+	options = g_list_append(options, option);
+
+	option = purple_account_option_int_new(_("Load contacts"),
+	                                       "load-contacts", 1000);
+	options = g_list_append(options, option);
+
+	option = purple_account_option_int_new(_("Load groups"), "load-groups",
+	                                       10);
+	options = g_list_append(options, option);
+
+	option = purple_account_option_int_new(_("Presence changes per second"),
+	                                       "load-presence-rate", 50);
+	options = g_list_append(options, option);
+
+	option = purple_account_option_int_new(_("IMs per second"),
+	                                       "load-im-rate", 10);
+	options = g_list_append(options, option);
+
+	option = purple_account_option_int_new(_("Load chats"), "load-chats", 2);
+	options = g_list_append(options, option);
+
+	option = purple_account_option_int_new(_("Users per chat"),
+	                                       "load-chat-users", 100);
+	options = g_list_append(options, option);
+
+	option = purple_account_option_int_new(_("Chat messages per second"),
+	                                       "load-chat-rate", 10);
+	options = g_list_append(options, option);
+
+	option = purple_account_option_int_new(_("Minimum message size"),
+	                                       "load-message-min", 16);
+	options = g_list_append(options, option);
+
+	option = purple_account_option_int_new(_("Maximum message size"),
+	                                       "load-message-max", 4096);
+	options = g_list_append(options, option);
+
+	option = purple_account_option_int_new(_("Seconds between file offers "
+	                                         "(0 to disable)"),
+	                                       "load-xfer-interval", 0);
+	options = g_list_append(options, option);
+
+	return options;
+}
+
+gboolean
+purple_demo_load_is_enabled(PurpleAccount *account) {
+	return purple_account_get_bool(account, "load-generator", FALSE);
+}
+
+void
+purple_demo_load_start(PurpleConnection *connection) {
+	PurpleAccount *account = NULL;
+	PurpleDemoLoad *load = NULL;
+	gint n_contacts = 0, n_groups = 0;
+
+	g_return_if_fail(PURPLE_IS_CONNECTION(connection));
+
+	account = purple_connection_get_account(connection);
+
+	load = g_new0(PurpleDemoLoad, 1);
+	load->connection = connection;
+	load->rand = g_rand_new_with_seed(purple_account_get_int(account,
+	                                                         "load-seed", 1));
+
+	n_contacts = MAX(1, purple_account_get_int(account, "load-contacts",
+	                                           1000));
+	n_groups = MAX(1, purple_account_get_int(account, "load-groups", 10));
+
+	load->presence_rate = MAX(0, purple_account_get_int(account,
+	                                                    "load-presence-rate",
+	                                                    50));
+	load->im_rate = MAX(0, purple_account_get_int(account, "load-im-rate",
+	                                              10));
+	load->n_chats = MAX(0, purple_account_get_int(account, "load-chats", 2));
+	load->chat_rate = MAX(0, purple_account_get_int(account, "load-chat-rate",
+	                                                10));
+	load->message_min = MAX(1, purple_account_get_int(account,
+	                                                  "load-message-min", 16));
+	load->message_max = MAX(load->message_min,
+	                        purple_account_get_int(account, "load-message-max",
+	                                               4096));
+	load->xfer_interval = MAX(0, purple_account_get_int(account,
+	                                                    "load-xfer-interval",
+	                                                    0));
+
+	load->contacts = g_ptr_array_new_full(n_contacts, g_free);
+	for(gint i = 0; i < n_contacts; i++) {
+		g_ptr_array_add(load->contacts, g_strdup_printf("load-%05d", i));
+	}
+
+	purple_demo_load_add_contacts(load, n_groups);
+	purple_demo_load_join_chats(load,
+	                            MAX(0, purple_account_get_int(account,
+	                                                          "load-chat-users",
+	                                                          100)));
+
+	load->source = g_timeout_add(1000 / PURPLE_DEMO_LOAD_TICKS_PER_SECOND,
+	                             purple_demo_load_tick_cb, load);
+
+	g_object_set_data_full(G_OBJECT(connection), PURPLE_DEMO_LOAD_KEY, load,
+	                       (GDestroyNotify)purple_demo_load_free);
+}
+
+void
+purple_demo_load_stop(PurpleConnection *connection) {
+	g_return_if_fail(PURPLE_IS_CONNECTION(connection));
+
+	g_object_set_data(G_OBJECT(connection), PURPLE_DEMO_LOAD_KEY, NULL);
+}
@@ -0,0 +1,38 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PURPLE_DEMO_LOAD_H
+#define PURPLE_DEMO_LOAD_H
+
+#include <glib.h>
+
+#include <purple.h>
+
+G_BEGIN_DECLS
+
+G_GNUC_INTERNAL GList *purple_demo_load_get_account_options(void);
+
+G_GNUC_INTERNAL gboolean purple_demo_load_is_enabled(PurpleAccount *account);
+
+G_GNUC_INTERNAL void purple_demo_load_start(PurpleConnection *connection);
+
+G_GNUC_INTERNAL void purple_demo_load_stop(PurpleConnection *connection);
+
+G_END_DECLS
+
+#endif /* PURPLE_DEMO_LOAD_H */
@@ -26,6 +26,7 @@
 
 #include "purpledemoplugin.h"
 #include "purpledemoprotocol.h"
+#include "purpledemoxfer.h"
 
 /******************************************************************************
  * Globals
@@ -71,6 +72,7 @@ purple_demo_plugin_load(GPluginPlugin *plugin, GError **error) {
 	}
 
 	purple_demo_protocol_register(GPLUGIN_NATIVE_PLUGIN(plugin));
+	purple_demo_xfer_register(GPLUGIN_NATIVE_PLUGIN(plugin));
 
 	manager = purple_protocol_manager_get_default();
 
@@ -27,6 +27,7 @@
 #include "purpledemoprotocolmedia.h"
 
 #include "purpledemocontacts.h"
+#include "purpledemoload.h"
 
 struct _PurpleDemoProtocol {
 	PurpleProtocol parent;
@@ -43,6 +44,21 @@ purple_demo_protocol_login(PurpleAccount *account) {
 	purple_connection_set_state(connection, PURPLE_CONNECTION_CONNECTED);
 
 	purple_demo_contacts_load(account);
+
+	if(purple_demo_load_is_enabled(account)) {
+		purple_demo_load_start(connection);
+	}
+}
+
+static void
+purple_demo_protocol_close(PurpleConnection *connection) {
+	purple_demo_load_stop(connection);
+}
+
+static GList *
+purple_demo_protocol_get_account_options(G_GNUC_UNUSED PurpleProtocol *protocol)
+{
+	return purple_demo_load_get_account_options();
 }
 
 static GList *
@@ -103,6 +119,8 @@ purple_demo_protocol_class_init(PurpleDemoProtocolClass *klass) {
 	PurpleProtocolClass *protocol_class = PURPLE_PROTOCOL_CLASS(klass);
 
 	protocol_class->login = purple_demo_protocol_login;
+	protocol_class->close = purple_demo_protocol_close;
+	protocol_class->get_account_options = purple_demo_protocol_get_account_options;
 	protocol_class->status_types = purple_demo_protocol_status_types;
 }
 
@@ -0,0 +1,153 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "purpledemoxfer.h"
+
+/* How often we hand the next chunk of the fake file to libpurple, and how big
+ * that chunk is.
+ */
+#define PURPLE_DEMO_XFER_INTERVAL (20)
+#define PURPLE_DEMO_XFER_CHUNK_SIZE (64 * 1024)
+
+struct _PurpleDemoXfer {
+	PurpleXfer parent;
+
+	guint source;
+	guchar *chunk;
+};
+
+G_DEFINE_DYNAMIC_TYPE(PurpleDemoXfer, purple_demo_xfer, PURPLE_TYPE_XFER)
+
+/******************************************************************************
+ * Callbacks
+ *****************************************************************************/
+static gboolean
+purple_demo_xfer_tick_cb(gpointer data) {
+	PurpleDemoXfer *demo = data;
+	PurpleXfer *xfer = PURPLE_XFER(data);
+	goffset remaining = purple_xfer_get_bytes_remaining(xfer);
+	gsize size = MIN(remaining, PURPLE_DEMO_XFER_CHUNK_SIZE);
+
+	if(size > 0 && !purple_xfer_write_file(xfer, demo->chunk, size)) {
+		/* purple_xfer_write_file cancelled the transfer for us. */
+		demo->source = 0;
+
+		return G_SOURCE_REMOVE;
+	}
+
+	if(purple_xfer_get_bytes_remaining(xfer) > 0) {
+		return G_SOURCE_CONTINUE;
+	}
+
+	demo->source = 0;
+
+	purple_xfer_set_completed(xfer, TRUE);
+	purple_xfer_end(xfer);
+
+	return G_SOURCE_REMOVE;
+}
+
+/******************************************************************************
+ * PurpleXfer Implementation
+ *****************************************************************************/
+static void
+purple_demo_xfer_init_xfer(PurpleXfer *xfer) {
+	/* There's no peer, so just start "receiving" straight away. */
+	purple_xfer_start(xfer, -1, NULL, 0);
+}
+
+static void
+purple_demo_xfer_start(PurpleXfer *xfer) {
+	PurpleDemoXfer *demo = PURPLE_DEMO_XFER(xfer);
+
+	demo->source = g_timeout_add(PURPLE_DEMO_XFER_INTERVAL,
+	                             purple_demo_xfer_tick_cb, demo);
+}
+
+static void
+purple_demo_xfer_stop(PurpleXfer *xfer) {
+	PurpleDemoXfer *demo = PURPLE_DEMO_XFER(xfer);
+
+	g_clear_handle_id(&demo->source, g_source_remove);
+}
+
+/******************************************************************************
+ * GObject Implementation
+ *****************************************************************************/
+static void
+purple_demo_xfer_init(PurpleDemoXfer *demo) {
+	/* The contents don't matter, they just need to be the same every run. */
+	demo->chunk = g_malloc(PURPLE_DEMO_XFER_CHUNK_SIZE);
+	for(gsize i = 0; i < PURPLE_DEMO_XFER_CHUNK_SIZE; i++) {
+		demo->chunk[i] = (guchar)i;
+	}
+}
+
+static void
+purple_demo_xfer_finalize(GObject *obj) {
+	PurpleDemoXfer *demo = PURPLE_DEMO_XFER(obj);
+
+	g_clear_handle_id(&demo->source, g_source_remove);
+	g_free(demo->chunk);
+
+	G_OBJECT_CLASS(purple_demo_xfer_parent_class)->finalize(obj);
+}
+
+static void
+purple_demo_xfer_class_finalize(PurpleDemoXferClass *klass) {
+}
+
+static void
+purple_demo_xfer_class_init(PurpleDemoXferClass *klass) {
+	GObjectClass *obj_class = G_OBJECT_CLASS(klass);
+	PurpleXferClass *xfer_class = PURPLE_XFER_CLASS(klass);
+
+	obj_class->finalize = purple_demo_xfer_finalize;
+
+	xfer_class->init = purple_demo_xfer_init_xfer;
+	xfer_class->start = purple_demo_xfer_start;
+	xfer_class->end = purple_demo_xfer_stop;
+	xfer_class->cancel_recv = purple_demo_xfer_stop;
+}
+
+/******************************************************************************
+ * Local Exports
+ *****************************************************************************/
+void
+purple_demo_xfer_register(GPluginNativePlugin *plugin) {
+	purple_demo_xfer_register_type(G_TYPE_MODULE(plugin));
+}
+
+PurpleXfer *
+purple_demo_xfer_new(PurpleAccount *account, const gchar *who,
+                     const gchar *filename, goffset size)
+{
+	PurpleXfer *xfer = NULL;
+
+	xfer = g_object_new(
+		PURPLE_DEMO_TYPE_XFER,
+		"account", account,
+		"type", PURPLE_XFER_TYPE_RECEIVE,
+		"remote-user", who,
+		NULL);
+
+	purple_xfer_set_filename(xfer, filename);
+	purple_xfer_set_size(xfer, size);
+
+	return xfer;
+}
@@ -24,6 +24,7 @@
 #include <json-glib/json-glib.h>
 #include <libsoup/soup.h>
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "libpurple/glibcompat.h"
@@ -58,6 +59,7 @@ struct _FbApi {
 	GObject parent;
 
 	FbMqtt *mqtt;
+	FbUtilInflater *inflater;
 	SoupSession *cons;
 	PurpleConnection *gc;
 	gboolean retrying;
@@ -175,6 +177,7 @@ fb_api_dispose(GObject *obj)
 	}
 
 	g_clear_object(&api->mqtt);
+	g_clear_pointer(&api->inflater, fb_util_inflater_free);
 
 	g_clear_object(&api->cons);
 	if(api->msgs != NULL) {
@@ -408,7 +411,7 @@ fb_api_class_init(FbApiClass *klass)
 	/**
 	 * FbApi::presences:
 	 * @api: The #FbApi.
-	 * @press: The #GSList of #FbApiPresence's.
+	 * @press: The #GArray of #FbApiPresence's.
 	 *
 	 * Emitted upon incoming presences from the stream.
 	 */
@@ -505,6 +508,7 @@ static void
 fb_api_init(FbApi *api)
 {
 	api->msgs = g_queue_new();
+	api->inflater = fb_util_inflater_new();
 }
 
 GQuark
@@ -1409,20 +1413,18 @@ static GSList *
 fb_api_cb_publish_ms_event(FbApi *api, JsonNode *root, GSList *events, FbApiEventType type, GError **error);
 
 static void
-fb_api_cb_publish_mst(FbThrift *thft, GError **error)
+fb_api_cb_publish_mst(FbThriftCursor *curs, GError **error)
 {
-	if (fb_thrift_read_isstop(thft)) {
-		FB_API_TCHK(fb_thrift_read_stop(thft));
-	} else {
-		FbThriftType type;
-		gint16 id;
+	FbThriftType type = FB_THRIFT_TYPE_UNKNOWN;
+	gint16 id = 0;
 
-		FB_API_TCHK(fb_thrift_read_field(thft, &type, &id, 0));
-		FB_API_TCHK(type == FB_THRIFT_TYPE_STRING);
-		// FB_API_TCHK(id == 2);
-		FB_API_TCHK(fb_thrift_read_str(thft, NULL));
-		FB_API_TCHK(fb_thrift_read_stop(thft));
+	/* Skip over the identifier string (for Facebook employees) along
+	 * with anything else preceding the JSON, without decoding it */
+	while (fb_thrift_cursor_read_field(curs, &type, &id, id)) {
+		FB_API_TCHK(fb_thrift_cursor_skip(curs, type));
 	}
+
+	FB_API_TCHK(type == FB_THRIFT_TYPE_STOP);
 }
 
 static void
@@ -1430,7 +1432,7 @@ fb_api_cb_publish_ms(FbApi *api, GByteArray *pload)
 {
 	const gchar *data;
 	FbJsonValues *values;
-	FbThrift *thft;
+	FbThriftCursor curs;
 	gchar *stoken;
 	GError *err = NULL;
 	GList *elms, *l;
@@ -1452,11 +1454,9 @@ fb_api_cb_publish_ms(FbApi *api, GByteArray *pload)
 		{"deltaParticipantLeftGroupThread", FB_API_EVENT_TYPE_THREAD_USER_REMOVED, 0},
 	};
 
-	/* Read identifier string (for Facebook employees) */
-	thft = fb_thrift_new(pload, 0);
-	fb_api_cb_publish_mst(thft, &err);
-	size = fb_thrift_get_pos(thft);
-	g_object_unref(thft);
+	fb_thrift_cursor_init(&curs, pload->data, pload->len);
+	fb_api_cb_publish_mst(&curs, &err);
+	size = curs.pos;
 
 	FB_API_ERROR_EMIT(api, err,
 		return;
@@ -1725,117 +1725,102 @@ fb_api_cb_publish_ms_event(FbApi *api, JsonNode *root, GSList *events, FbApiEven
 }
 
 static void
-fb_api_cb_publish_pt(FbThrift *thft, GSList **presences, GError **error)
+fb_api_cb_publish_ptp(FbThriftCursor *curs, FbApiPresence *presence,
+                      GError **error)
 {
-	FbApiPresence *api_presence;
-	FbThriftType type;
-	gint16 id;
-	gint32 i32;
+	FbThriftType type = FB_THRIFT_TYPE_UNKNOWN;
+	gint16 id = 0;
 	gint64 i64;
+
+	while (fb_thrift_cursor_read_field(curs, &type, &id, id)) {
+		switch (id) {
+		case 1:
+			/* Read the user identifier field */
+			FB_API_TCHK(type == FB_THRIFT_TYPE_I64);
+			FB_API_TCHK(fb_thrift_cursor_read_i64(curs, &i64));
+			presence->uid = i64;
+			break;
+
+		case 2:
+			/* Read the active field */
+			FB_API_TCHK(type == FB_THRIFT_TYPE_I32);
+			FB_API_TCHK(fb_thrift_cursor_read_i64(curs, &i64));
+			presence->active = i64 != 0;
+			break;
+
+		default:
+			/* The last active timestamp, the active client bits,
+			 * the VoIP compatibility bits and anything newer */
+			FB_API_TCHK(fb_thrift_cursor_skip(curs, type));
+			break;
+		}
+	}
+
+	FB_API_TCHK(type == FB_THRIFT_TYPE_STOP);
+}
+
+static void
+fb_api_cb_publish_pt(FbThriftCursor *curs, GArray *presences,
+                     GError **error)
+{
+	FbApiPresence *api_presence;
+	FbThriftType type = FB_THRIFT_TYPE_STOP;
+	gint16 id = 0;
+	GError *err = NULL;
 	guint i;
-	guint size = 0;
-
-	/* Read identifier string (for Facebook employees) */
-	FB_API_TCHK(fb_thrift_read_str(thft, NULL));
-
-	/* Read the full list boolean field */
-	FB_API_TCHK(fb_thrift_read_field(thft, &type, &id, 0));
-	FB_API_TCHK(type == FB_THRIFT_TYPE_BOOL);
-	FB_API_TCHK(id == 1);
-	FB_API_TCHK(fb_thrift_read_bool(thft, NULL));
-
-	/* Read the list field */
-	FB_API_TCHK(fb_thrift_read_field(thft, &type, &id, id));
-	FB_API_TCHK(type == FB_THRIFT_TYPE_LIST);
-	FB_API_TCHK(id == 2);
-
-	/* Read the list */
-	FB_API_TCHK(fb_thrift_read_list(thft, &type, &size));
-	FB_API_TCHK(type == FB_THRIFT_TYPE_STRUCT);
-
-	for (i = 0; i < size; i++) {
-		/* Read the user identifier field */
-		FB_API_TCHK(fb_thrift_read_field(thft, &type, &id, 0));
-		FB_API_TCHK(type == FB_THRIFT_TYPE_I64);
-		FB_API_TCHK(id == 1);
-		FB_API_TCHK(fb_thrift_read_i64(thft, &i64));
-
-		/* Read the active field */
-		FB_API_TCHK(fb_thrift_read_field(thft, &type, &id, id));
-		FB_API_TCHK(type == FB_THRIFT_TYPE_I32);
-		FB_API_TCHK(id == 2);
-		FB_API_TCHK(fb_thrift_read_i32(thft, &i32));
-
-		api_presence = g_new0(FbApiPresence, 1);
-		api_presence->uid = i64;
-		api_presence->active = i32 != 0;
-		*presences = g_slist_prepend(*presences, api_presence);
-
-		fb_util_debug_info("Presence: %" FB_ID_FORMAT " (%d) id: %d",
-		                   i64, i32 != 0, id);
-
-		while (id <= 6) {
-			if (fb_thrift_read_isstop(thft)) {
-				break;
-			}
+	guint size;
 
-			FB_API_TCHK(fb_thrift_read_field(thft, &type, &id, id));
+	/* Skip the identifier string (for Facebook employees) */
+	FB_API_TCHK(fb_thrift_cursor_read_str(curs, NULL, NULL));
 
-			switch (id) {
-			case 3:
-				/* Read the last active timestamp field */
-				FB_API_TCHK(type == FB_THRIFT_TYPE_I64);
-				FB_API_TCHK(fb_thrift_read_i64(thft, NULL));
-				break;
+	while (fb_thrift_cursor_read_field(curs, &type, &id, id)) {
+		if ((id != 2) || (type != FB_THRIFT_TYPE_LIST)) {
+			/* The full list boolean field, or anything newer */
+			FB_API_TCHK(fb_thrift_cursor_skip(curs, type));
+			continue;
+		}
 
-			case 4:
-				/* Read the active client bits field */
-				FB_API_TCHK(type == FB_THRIFT_TYPE_I16);
-				FB_API_TCHK(fb_thrift_read_i16(thft, NULL));
-				break;
+		/* Read the list, decoding it directly into the array */
+		FB_API_TCHK(fb_thrift_cursor_read_list(curs, &type, &size));
+		FB_API_TCHK(type == FB_THRIFT_TYPE_STRUCT);
 
-			case 5:
-				/* Read the VoIP compatibility bits field */
-				FB_API_TCHK(type == FB_THRIFT_TYPE_I64);
-				FB_API_TCHK(fb_thrift_read_i64(thft, NULL));
-				break;
+		/* Every presence is at least a field stop, so the size can
+		 * be bounded by the remaining data before it is trusted */
+		FB_API_TCHK(size <= (curs->size - curs->pos));
+		i = presences->len;
+		size += i;
+		g_array_set_size(presences, size);
 
-			case 6:
-				/* Unknown new field */
-				FB_API_TCHK(type == FB_THRIFT_TYPE_I64);
-				FB_API_TCHK(fb_thrift_read_i64(thft, NULL));
-				break;
+		for (; i < size; i++) {
+			api_presence = &g_array_index(presences, FbApiPresence, i);
+			fb_api_cb_publish_ptp(curs, api_presence, &err);
 
-			default:
-				/* Try to read unknown fields as varint */
-				FB_API_TCHK(type == FB_THRIFT_TYPE_I16 ||
-				            type == FB_THRIFT_TYPE_I32 ||
-				            type == FB_THRIFT_TYPE_I64);
-				FB_API_TCHK(fb_thrift_read_i64(thft, NULL));
-				break;
+			if (G_UNLIKELY(err != NULL)) {
+				g_propagate_error(error, err);
+				return;
 			}
-		}
 
-		/* Read the field stop */
-		FB_API_TCHK(fb_thrift_read_stop(thft));
+			fb_util_debug_info("Presence: %" FB_ID_FORMAT " (%d)",
+			                   api_presence->uid,
+			                   api_presence->active);
+		}
 	}
 
-	/* Read the field stop */
-	if (fb_thrift_read_isstop(thft)) {
-		FB_API_TCHK(fb_thrift_read_stop(thft));
-	}
+	/* The trailing field stop is optional */
+	FB_API_TCHK((type == FB_THRIFT_TYPE_STOP) ||
+	            (curs->pos >= curs->size));
 }
 
 static void
 fb_api_cb_publish_p(FbApi *api, GByteArray *pload)
 {
-	FbThrift *thft;
+	FbThriftCursor curs;
+	GArray *presences;
 	GError *err = NULL;
-	GSList *presences = NULL;
 
-	thft = fb_thrift_new(pload, 0);
-	fb_api_cb_publish_pt(thft, &presences, &err);
-	g_object_unref(thft);
+	presences = g_array_new(FALSE, TRUE, sizeof (FbApiPresence));
+	fb_thrift_cursor_init(&curs, pload->data, pload->len);
+	fb_api_cb_publish_pt(&curs, presences, &err);
 
 	if (G_LIKELY(err == NULL)) {
 		g_signal_emit_by_name(api, "presences", presences);
@@ -1843,7 +1828,31 @@ fb_api_cb_publish_p(FbApi *api, GByteArray *pload)
 		fb_api_error_emit(api, err);
 	}
 
-	g_slist_free_full(presences, (GDestroyNotify)fb_api_presence_free);
+	g_array_free(presences, TRUE);
+}
+
+typedef struct
+{
+	const gchar *topic;
+	void (*func) (FbApi *api, GByteArray *pload);
+} FbApiPublishParser;
+
+/* Sorted case-insensitively by topic for bsearch() */
+static const FbApiPublishParser fb_api_publish_parsers[] = {
+	{"/mark_thread_response", fb_api_cb_publish_mark},
+	{"/mercury", fb_api_cb_publish_mercury},
+	{"/orca_typing_notifications", fb_api_cb_publish_typing},
+	{"/send_message_response", fb_api_cb_publish_ms_r},
+	{"/t_ms", fb_api_cb_publish_ms},
+	{"/t_p", fb_api_cb_publish_p}
+};
+
+static gint
+fb_api_publish_parser_cmp(gconstpointer key, gconstpointer elem)
+{
+	const FbApiPublishParser *parser = elem;
+
+	return g_ascii_strcasecmp(key, parser->topic);
 }
 
 static void
@@ -1851,45 +1860,37 @@ fb_api_cb_mqtt_publish(FbMqtt *mqtt, const gchar *topic, GByteArray *pload,
                        gpointer data)
 {
 	FbApi *api = data;
-	gboolean comp;
+	const FbApiPublishParser *parser;
 	GByteArray *bytes;
 	GError *err = NULL;
-	guint i;
+	gboolean debug;
 
-	static const struct {
-		const gchar *topic;
-		void (*func) (FbApi *api, GByteArray *pload);
-	} parsers[] = {
-		{"/mark_thread_response", fb_api_cb_publish_mark},
-		{"/mercury", fb_api_cb_publish_mercury},
-		{"/orca_typing_notifications", fb_api_cb_publish_typing},
-		{"/send_message_response", fb_api_cb_publish_ms_r},
-		{"/t_ms", fb_api_cb_publish_ms},
-		{"/t_p", fb_api_cb_publish_p}
-	};
+	parser = bsearch(topic, fb_api_publish_parsers,
+	                 G_N_ELEMENTS(fb_api_publish_parsers),
+	                 sizeof *fb_api_publish_parsers,
+	                 fb_api_publish_parser_cmp);
+	debug = fb_util_debug_is_enabled(FB_UTIL_DEBUG_INFO);
 
-	comp = fb_util_zlib_test(pload);
+	/* Nobody would look at the payload, so don't bother inflating it */
+	if ((parser == NULL) && !debug) {
+		return;
+	}
 
-	if (G_LIKELY(comp)) {
-		bytes = fb_util_zlib_inflate(pload, &err);
+	if (G_LIKELY(fb_util_zlib_test(pload))) {
+		bytes = fb_util_inflater_inflate(api->inflater, pload, &err);
 		FB_API_ERROR_EMIT(api, err, return);
 	} else {
 		bytes = (GByteArray *) pload;
 	}
 
-	fb_util_debug_hexdump(FB_UTIL_DEBUG_INFO, bytes,
-	                      "Reading message (topic: %s)",
-			      topic);
-
-	for (i = 0; i < G_N_ELEMENTS(parsers); i++) {
-		if (g_ascii_strcasecmp(topic, parsers[i].topic) == 0) {
-			parsers[i].func(api, bytes);
-			break;
-		}
+	if (debug) {
+		fb_util_debug_hexdump(FB_UTIL_DEBUG_INFO, bytes,
+		                      "Reading message (topic: %s)",
+		                      topic);
 	}
 
-	if (G_LIKELY(comp)) {
-		g_byte_array_free(bytes, TRUE);
+	if (parser != NULL) {
+		parser->func(api, bytes);
 	}
 }
 
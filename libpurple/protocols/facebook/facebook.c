@@ -160,35 +160,66 @@ fb_cb_sync_contacts(gpointer data)
 	return FALSE;
 }
 
+/* Owned by the image, so that the fetch still fails when the image is
+ * dropped before it was downloaded, like when we disconnect. */
+typedef struct
+{
+	PurpleAvatarFetch *fetch;
+} FbIconFetch;
+
+static void
+fb_cb_icon_free(gpointer data)
+{
+	FbIconFetch *ifetch = data;
+
+	if (ifetch->fetch != NULL) {
+		purple_avatar_fetch_failed(ifetch->fetch);
+	}
+
+	g_free(ifetch);
+}
+
 static void
 fb_cb_icon(FbDataImage *img, GError *error)
 {
-	const gchar *csum;
-	const gchar *name;
-	const gchar *str;
-	FbHttpParams *params;
 	gsize size;
 	guint8 *image;
-	PurpleAccount *acct;
-	PurpleBuddy *bdy;
+	FbIconFetch *ifetch;
+	PurpleAvatarFetch *fetch;
 
-	bdy = fb_data_image_get_data(img);
-	acct = purple_buddy_get_account(bdy);
-	name = purple_buddy_get_name(bdy);
+	ifetch = fb_data_image_get_data(img);
+	fetch = g_steal_pointer(&ifetch->fetch);
 
 	if (G_UNLIKELY(error != NULL)) {
 		fb_util_debug_warning("Failed to retrieve icon for %s: %s",
-		                      name, error->message);
+		                      purple_avatar_fetch_get_username(fetch),
+		                      error->message);
+		purple_avatar_fetch_failed(fetch);
 		return;
 	}
 
-	str = fb_data_image_get_url(img);
-	params = fb_http_params_new_parse(str, TRUE);
-	csum = fb_http_params_get_str(params, "oh", NULL);
-
 	image = fb_data_image_dup_image(img, &size);
-	purple_buddy_icons_set_for_user(acct, name, image, size, csum);
-	fb_http_params_free(params);
+	purple_avatar_fetch_complete(fetch, image, size);
+}
+
+static void
+fb_cb_icon_fetch(PurpleAvatarFetch *fetch, gpointer data)
+{
+	const gchar *url = data;
+	FbData *fata;
+	FbIconFetch *ifetch;
+	PurpleAccount *acct;
+	PurpleConnection *gc;
+
+	acct = purple_avatar_fetch_get_account(fetch);
+	gc = purple_account_get_connection(acct);
+	fata = purple_connection_get_protocol_data(gc);
+
+	ifetch = g_new0(FbIconFetch, 1);
+	ifetch->fetch = fetch;
+
+	fb_data_image_add(fata, url, fb_cb_icon, ifetch, fb_cb_icon_free);
+	fb_data_image_queue(fata);
 }
 
 static void
@@ -275,13 +306,13 @@ fb_cb_api_contacts(FbApi *api, GSList *users, gboolean complete, gpointer data)
 		csum = purple_buddy_icons_get_checksum_for_user(bdy);
 
 		if (!purple_strequal(csum, user->csum)) {
-			fb_data_image_add(fata, user->icon, fb_cb_icon,
-			                  bdy, NULL);
+			purple_avatar_fetcher_submit(
+				purple_avatar_fetcher_get_default(), acct, uid,
+				user->csum, PURPLE_AVATAR_FETCH_FLAGS_CONTENT_CHECKSUM,
+				fb_cb_icon_fetch, g_strdup(user->icon), g_free);
 		}
 	}
 
-	fb_data_image_queue(fata);
-
 	if (!complete) {
 		return;
 	}
@@ -595,12 +626,12 @@ fb_cb_api_messages(FbApi *api, GSList *msgs, gpointer data)
 }
 
 static void
-fb_cb_api_presences(FbApi *api, GSList *presences, gpointer data)
+fb_cb_api_presences(FbApi *api, GArray *presences, gpointer data)
 {
 	const gchar *statid;
 	FbData *fata = data;
 	gchar uid[FB_ID_STRMAX];
-	GSList *l;
+	guint i;
 	PurpleAccount *acct;
 	PurpleConnection *gc;
 	PurpleStatusPrimitive pstat;
@@ -608,8 +639,10 @@ fb_cb_api_presences(FbApi *api, GSList *presences, gpointer data)
 	gc = fb_data_get_connection(fata);
 	acct = purple_connection_get_account(gc);
 
-	for (l = presences; l != NULL; l = l->next) {
-		FbApiPresence *api_presence = l->data;
+	for (i = 0; i < presences->len; i++) {
+		FbApiPresence *api_presence;
+
+		api_presence = &g_array_index(presences, FbApiPresence, i);
 
 		if (api_presence->active) {
 			pstat = PURPLE_STATUS_AVAILABLE;
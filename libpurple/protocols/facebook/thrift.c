@@ -673,3 +673,340 @@ fb_thrift_ct2t(guint8 type)
 	g_return_val_if_fail(type < G_N_ELEMENTS(types), 0);
 	return types[type];
 }
+
+/* Nesting limit of containers and structures for skipping */
+#define FB_THRIFT_CURSOR_DEPTH_MAX  32
+
+static inline FbThriftType
+fb_thrift_cursor_ct2t(guint8 type)
+{
+	if (G_UNLIKELY(type > 12)) {
+		return FB_THRIFT_TYPE_UNKNOWN;
+	}
+
+	return fb_thrift_ct2t(type);
+}
+
+void
+fb_thrift_cursor_init(FbThriftCursor *curs, gconstpointer data, gsize size)
+{
+	g_return_if_fail(curs != NULL);
+
+	curs->data = data;
+	curs->size = size;
+	curs->pos = 0;
+	curs->lastbool = 0;
+}
+
+gboolean
+fb_thrift_cursor_read_byte(FbThriftCursor *curs, guint8 *value)
+{
+	if (G_UNLIKELY(curs->pos >= curs->size)) {
+		return FALSE;
+	}
+
+	if (value != NULL) {
+		*value = curs->data[curs->pos];
+	}
+
+	curs->pos++;
+	return TRUE;
+}
+
+gboolean
+fb_thrift_cursor_read_bool(FbThriftCursor *curs, gboolean *value)
+{
+	guint8 byte;
+
+	if ((curs->lastbool & 0x03) != 0x01) {
+		if (!fb_thrift_cursor_read_byte(curs, &byte)) {
+			return FALSE;
+		}
+
+		if (value != NULL) {
+			*value = (byte & 0x0F) == 0x01;
+		}
+
+		curs->lastbool = 0;
+		return TRUE;
+	}
+
+	if (value != NULL) {
+		*value = ((curs->lastbool & 0x04) >> 2) != 0;
+	}
+
+	curs->lastbool = 0;
+	return TRUE;
+}
+
+gboolean
+fb_thrift_cursor_read_vi64(FbThriftCursor *curs, guint64 *value)
+{
+	guint i = 0;
+	guint8 byte;
+	guint64 u64 = 0;
+
+	do {
+		if (G_UNLIKELY((curs->pos >= curs->size) || (i >= 64))) {
+			return FALSE;
+		}
+
+		byte = curs->data[curs->pos++];
+		u64 |= ((guint64) (byte & 0x7F)) << i;
+		i += 7;
+	} while ((byte & 0x80) == 0x80);
+
+	if (value != NULL) {
+		*value = u64;
+	}
+
+	return TRUE;
+}
+
+gboolean
+fb_thrift_cursor_read_i64(FbThriftCursor *curs, gint64 *value)
+{
+	guint64 u64;
+
+	if (!fb_thrift_cursor_read_vi64(curs, &u64)) {
+		return FALSE;
+	}
+
+	if (value != NULL) {
+		/* Convert from zigzag to integer */
+		*value = (u64 >> 0x01) ^ -(u64 & 0x01);
+	}
+
+	return TRUE;
+}
+
+gboolean
+fb_thrift_cursor_read_str(FbThriftCursor *curs, const guint8 **value,
+                          gsize *size)
+{
+	guint64 u64;
+
+	if (!fb_thrift_cursor_read_vi64(curs, &u64)) {
+		return FALSE;
+	}
+
+	if (G_UNLIKELY(u64 > (curs->size - curs->pos))) {
+		return FALSE;
+	}
+
+	if (value != NULL) {
+		*value = curs->data + curs->pos;
+	}
+
+	if (size != NULL) {
+		*size = u64;
+	}
+
+	curs->pos += u64;
+	return TRUE;
+}
+
+gboolean
+fb_thrift_cursor_read_field(FbThriftCursor *curs, FbThriftType *type,
+                            gint16 *id, gint16 lastid)
+{
+	gint16 i16;
+	gint64 i64;
+	guint8 byte;
+
+	g_return_val_if_fail(type != NULL, FALSE);
+	g_return_val_if_fail(id != NULL, FALSE);
+
+	if (!fb_thrift_cursor_read_byte(curs, &byte)) {
+		return FALSE;
+	}
+
+	if (byte == FB_THRIFT_TYPE_STOP) {
+		*type = FB_THRIFT_TYPE_STOP;
+		return FALSE;
+	}
+
+	*type = fb_thrift_cursor_ct2t(byte & 0x0F);
+	i16 = (byte & 0xF0) >> 4;
+
+	if (*type == FB_THRIFT_TYPE_UNKNOWN) {
+		return FALSE;
+	}
+
+	if (i16 == 0) {
+		if (!fb_thrift_cursor_read_i64(curs, &i64)) {
+			return FALSE;
+		}
+
+		*id = i64;
+	} else {
+		*id = lastid + i16;
+	}
+
+	if (*type == FB_THRIFT_TYPE_BOOL) {
+		curs->lastbool = 0x01;
+
+		if ((byte & 0x0F) == 0x01) {
+			curs->lastbool |= 0x01 << 2;
+		}
+	}
+
+	return TRUE;
+}
+
+gboolean
+fb_thrift_cursor_read_stop(FbThriftCursor *curs)
+{
+	guint8 byte;
+
+	return fb_thrift_cursor_read_byte(curs, &byte) &&
+	       (byte == FB_THRIFT_TYPE_STOP);
+}
+
+gboolean
+fb_thrift_cursor_read_isstop(FbThriftCursor *curs)
+{
+	return (curs->pos < curs->size) &&
+	       (curs->data[curs->pos] == FB_THRIFT_TYPE_STOP);
+}
+
+gboolean
+fb_thrift_cursor_read_list(FbThriftCursor *curs, FbThriftType *type,
+                           guint *size)
+{
+	guint8 byte;
+	guint64 u64;
+
+	g_return_val_if_fail(type != NULL, FALSE);
+	g_return_val_if_fail(size != NULL, FALSE);
+
+	if (!fb_thrift_cursor_read_byte(curs, &byte)) {
+		return FALSE;
+	}
+
+	*type = fb_thrift_cursor_ct2t(byte & 0x0F);
+	*size = (byte & 0xF0) >> 4;
+
+	if (*size == 0x0F) {
+		if (!fb_thrift_cursor_read_vi64(curs, &u64) ||
+		    (u64 > G_MAXUINT32))
+		{
+			return FALSE;
+		}
+
+		*size = u64;
+	}
+
+	return *type != FB_THRIFT_TYPE_UNKNOWN;
+}
+
+static gboolean
+fb_thrift_cursor_skip_depth(FbThriftCursor *curs, FbThriftType type,
+                            guint depth)
+{
+	FbThriftType ktype;
+	FbThriftType vtype;
+	gint16 id = 0;
+	gint64 i64;
+	guint8 byte;
+	guint i;
+	guint size;
+
+	if (G_UNLIKELY(depth >= FB_THRIFT_CURSOR_DEPTH_MAX)) {
+		return FALSE;
+	}
+
+	switch (type) {
+	case FB_THRIFT_TYPE_BOOL:
+		return fb_thrift_cursor_read_bool(curs, NULL);
+
+	case FB_THRIFT_TYPE_BYTE:
+		return fb_thrift_cursor_read_byte(curs, NULL);
+
+	case FB_THRIFT_TYPE_DOUBLE:
+		if (G_UNLIKELY((curs->size - curs->pos) < 8)) {
+			return FALSE;
+		}
+
+		curs->pos += 8;
+		return TRUE;
+
+	case FB_THRIFT_TYPE_I16:
+	case FB_THRIFT_TYPE_I32:
+	case FB_THRIFT_TYPE_I64:
+		return fb_thrift_cursor_read_vi64(curs, NULL);
+
+	case FB_THRIFT_TYPE_STRING:
+		return fb_thrift_cursor_read_str(curs, NULL, NULL);
+
+	case FB_THRIFT_TYPE_STRUCT:
+		while (fb_thrift_cursor_read_field(curs, &type, &id, id)) {
+			if (!fb_thrift_cursor_skip_depth(curs, type,
+			                                 depth + 1))
+			{
+				return FALSE;
+			}
+		}
+
+		/* A failed field read is only valid upon a field stop */
+		return type == FB_THRIFT_TYPE_STOP;
+
+	case FB_THRIFT_TYPE_LIST:
+	case FB_THRIFT_TYPE_SET:
+		if (!fb_thrift_cursor_read_list(curs, &type, &size)) {
+			return FALSE;
+		}
+
+		for (i = 0; i < size; i++) {
+			if (!fb_thrift_cursor_skip_depth(curs, type,
+			                                 depth + 1))
+			{
+				return FALSE;
+			}
+		}
+
+		return TRUE;
+
+	case FB_THRIFT_TYPE_MAP:
+		/* Mirrors fb_thrift_read_map() */
+		if (!fb_thrift_cursor_read_i64(curs, &i64) ||
+		    (i64 < 0) || (i64 > G_MAXINT32))
+		{
+			return FALSE;
+		}
+
+		if (i64 == 0) {
+			return TRUE;
+		}
+
+		if (!fb_thrift_cursor_read_byte(curs, &byte)) {
+			return FALSE;
+		}
+
+		ktype = fb_thrift_cursor_ct2t((byte & 0xF0) >> 4);
+		vtype = fb_thrift_cursor_ct2t(byte & 0x0F);
+
+		for (size = i64, i = 0; i < size; i++) {
+			if (!fb_thrift_cursor_skip_depth(curs, ktype,
+			                                 depth + 1) ||
+			    !fb_thrift_cursor_skip_depth(curs, vtype,
+			                                 depth + 1))
+			{
+				return FALSE;
+			}
+		}
+
+		return TRUE;
+
+	default:
+		return FALSE;
+	}
+}
+
+gboolean
+fb_thrift_cursor_skip(FbThriftCursor *curs, FbThriftType type)
+{
+	g_return_val_if_fail(curs != NULL, FALSE);
+
+	return fb_thrift_cursor_skip_depth(curs, type, 0);
+}
@@ -550,4 +550,170 @@ fb_thrift_t2ct(FbThriftType type);
 FbThriftType
 fb_thrift_ct2t(guint8 type);
 
+/**
+ * FbThriftCursor:
+ * @data: The borrowed data.
+ * @size: The size of @data.
+ * @pos: The cursor position.
+ * @lastbool: The last boolean field state.
+ *
+ * Represents a lightweight reader for compact Thrift data. Unlike
+ * #FbThrift, this is meant to be allocated on the stack, and it never
+ * copies or allocates; strings are returned as slices of @data, which
+ * must outlive the cursor.
+ */
+typedef struct
+{
+	const guint8 *data;
+	gsize size;
+	gsize pos;
+	guint lastbool;
+} FbThriftCursor;
+
+/**
+ * fb_thrift_cursor_init:
+ * @curs: The #FbThriftCursor.
+ * @data: The data to read.
+ * @size: The size of @data.
+ *
+ * Initializes an #FbThriftCursor to read from the start of @data.
+ */
+void
+fb_thrift_cursor_init(FbThriftCursor *curs, gconstpointer data, gsize size);
+
+/**
+ * fb_thrift_cursor_read_byte:
+ * @curs: The #FbThriftCursor.
+ * @value: The return location for the value or #NULL.
+ *
+ * Reads an 8-bit integer value from the #FbThriftCursor.
+ *
+ * Returns: #TRUE if the value was read, otherwise #FALSE.
+ */
+gboolean
+fb_thrift_cursor_read_byte(FbThriftCursor *curs, guint8 *value);
+
+/**
+ * fb_thrift_cursor_read_bool:
+ * @curs: The #FbThriftCursor.
+ * @value: The return location for the value or #NULL.
+ *
+ * Reads a boolean value from the #FbThriftCursor. When following a
+ * field header, the value is taken from the header itself.
+ *
+ * Returns: #TRUE if the value was read, otherwise #FALSE.
+ */
+gboolean
+fb_thrift_cursor_read_bool(FbThriftCursor *curs, gboolean *value);
+
+/**
+ * fb_thrift_cursor_read_vi64:
+ * @curs: The #FbThriftCursor.
+ * @value: The return location for the value or #NULL.
+ *
+ * Reads a raw variable-length integer from the #FbThriftCursor,
+ * without converting it from the zig-zag format.
+ *
+ * Returns: #TRUE if the value was read, otherwise #FALSE.
+ */
+gboolean
+fb_thrift_cursor_read_vi64(FbThriftCursor *curs, guint64 *value);
+
+/**
+ * fb_thrift_cursor_read_i64:
+ * @curs: The #FbThriftCursor.
+ * @value: The return location for the value or #NULL.
+ *
+ * Reads a signed integer value from the #FbThriftCursor. This will
+ * convert the integer from the zig-zag format, and is suitable for
+ * all of the 16, 32 and 64-bit integer types.
+ *
+ * Returns: #TRUE if the value was read, otherwise #FALSE.
+ */
+gboolean
+fb_thrift_cursor_read_i64(FbThriftCursor *curs, gint64 *value);
+
+/**
+ * fb_thrift_cursor_read_str:
+ * @curs: The #FbThriftCursor.
+ * @value: The return location for the borrowed data or #NULL.
+ * @size: The return location for the size or #NULL.
+ *
+ * Reads a string value from the #FbThriftCursor. The data returned to
+ * @value points into the buffer of the cursor, and it is not
+ * nul-terminated.
+ *
+ * Returns: #TRUE if the value was read, otherwise #FALSE.
+ */
+gboolean
+fb_thrift_cursor_read_str(FbThriftCursor *curs, const guint8 **value,
+                          gsize *size);
+
+/**
+ * fb_thrift_cursor_read_field:
+ * @curs: The #FbThriftCursor.
+ * @type: The return location for the #FbThriftType.
+ * @id: The return location for the identifier.
+ * @lastid: The identifier of the previous field.
+ *
+ * Reads a field header from the #FbThriftCursor. Like
+ * #fb_thrift_read_field(), this returns #FALSE with @type set to
+ * #FB_THRIFT_TYPE_STOP upon a field stop.
+ *
+ * Returns: #TRUE if the field header was read, otherwise #FALSE.
+ */
+gboolean
+fb_thrift_cursor_read_field(FbThriftCursor *curs, FbThriftType *type,
+                            gint16 *id, gint16 lastid);
+
+/**
+ * fb_thrift_cursor_read_stop:
+ * @curs: The #FbThriftCursor.
+ *
+ * Reads a field stop from the #FbThriftCursor.
+ *
+ * Returns: #TRUE if the field stop was read, otherwise #FALSE.
+ */
+gboolean
+fb_thrift_cursor_read_stop(FbThriftCursor *curs);
+
+/**
+ * fb_thrift_cursor_read_isstop:
+ * @curs: The #FbThriftCursor.
+ *
+ * Determines if the next byte of the #FbThriftCursor is a field stop.
+ *
+ * Returns: #TRUE if the next byte is a field stop, otherwise #FALSE.
+ */
+gboolean
+fb_thrift_cursor_read_isstop(FbThriftCursor *curs);
+
+/**
+ * fb_thrift_cursor_read_list:
+ * @curs: The #FbThriftCursor.
+ * @type: The return location for the #FbThriftType.
+ * @size: The return location for the size.
+ *
+ * Reads a list or set header from the #FbThriftCursor.
+ *
+ * Returns: #TRUE if the list header was read, otherwise #FALSE.
+ */
+gboolean
+fb_thrift_cursor_read_list(FbThriftCursor *curs, FbThriftType *type,
+                           guint *size);
+
+/**
+ * fb_thrift_cursor_skip:
+ * @curs: The #FbThriftCursor.
+ * @type: The #FbThriftType of the value.
+ *
+ * Advances the #FbThriftCursor past a value of @type without decoding
+ * it. Containers and structures are skipped in their entirety, which
+ * makes this suitable for ignoring unknown fields.
+ *
+ * Returns: #TRUE if the value was skipped, otherwise #FALSE.
+ */
+gboolean
+fb_thrift_cursor_skip(FbThriftCursor *curs, FbThriftType type);
+
 #endif /* PURPLE_FACEBOOK_THRIFT_H */
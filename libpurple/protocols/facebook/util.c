@@ -30,6 +30,26 @@
 
 #include "util.h"
 
+/* The smallest output buffer a zlib conversion starts with. */
+#define FB_UTIL_ZLIB_CHUNK 1024
+
+/* Inflated payloads are rarely more than this many times the size of the
+ * compressed ones, and the inflater learns the real ratio as it goes.
+ */
+#define FB_UTIL_INFLATER_RATIO 4
+
+/* An inflater drops its output buffer when a message grows it past this,
+ * rather than holding on to the memory for the life of the connection.
+ */
+#define FB_UTIL_INFLATER_MAX_KEEP (256 * 1024)
+
+struct _FbUtilInflater
+{
+	GZlibDecompressor *conv;
+	GByteArray *bytes;
+	guint ratio;
+};
+
 GQuark
 fb_util_error_quark(void)
 {
@@ -102,14 +122,11 @@ fb_util_debug(PurpleDebugLevel level, const gchar *format, ...)
 	va_end(ap);
 }
 
-void
-fb_util_vdebug(PurpleDebugLevel level, const gchar *format, va_list ap)
+gboolean
+fb_util_debug_is_enabled(PurpleDebugLevel level)
 {
 	gboolean unsafe;
 	gboolean verbose;
-	gchar *str;
-
-	g_return_if_fail(format != NULL);
 
 	unsafe = (level & FB_UTIL_DEBUG_FLAG_UNSAFE) != 0;
 	verbose = (level & FB_UTIL_DEBUG_FLAG_VERBOSE) != 0;
@@ -117,6 +134,21 @@ fb_util_vdebug(PurpleDebugLevel level, const gchar *format, va_list ap)
 	if ((unsafe && !purple_debug_is_unsafe()) ||
 	    (verbose && !purple_debug_is_verbose()))
 	{
+		return FALSE;
+	}
+
+	return purple_debug_is_enabled(level & ~FB_UTIL_DEBUG_FLAG_ALL,
+	                               "facebook");
+}
+
+void
+fb_util_vdebug(PurpleDebugLevel level, const gchar *format, va_list ap)
+{
+	gchar *str;
+
+	g_return_if_fail(format != NULL);
+
+	if (!fb_util_debug_is_enabled(level)) {
 		return;
 	}
 
@@ -183,40 +215,50 @@ fb_util_debug_hexdump(PurpleDebugLevel level, const GByteArray *bytes,
                       const gchar *format, ...)
 {
 	gchar c;
+	gchar *p;
 	guint i;
 	guint j;
-	GString *gstr;
+	gchar line[96];
 	va_list ap;
 
 	static const gchar *indent = "  ";
+	static const gchar hex[] = "0123456789abcdef";
 
 	g_return_if_fail(bytes != NULL);
 
+	/* Payloads are dumped on every read and write, so don't even start
+	 * unless someone is going to see it.
+	 */
+	if (!fb_util_debug_is_enabled(level)) {
+		return;
+	}
+
 	if (format != NULL) {
 		va_start(ap, format);
 		fb_util_vdebug(level, format, ap);
 		va_end(ap);
 	}
 
-	gstr = g_string_sized_new(80);
-
 	for (i = 0; i < bytes->len; i += 16) {
-		g_string_append_printf(gstr, "%s%08x  ", indent, i);
+		p = line + g_snprintf(line, sizeof line, "%s%08x  ", indent, i);
 
 		for (j = 0; j < 16; j++) {
 			if ((i + j) < bytes->len) {
-				g_string_append_printf(gstr, "%02x ",
-				                       bytes->data[i + j]);
+				*p++ = hex[bytes->data[i + j] >> 4];
+				*p++ = hex[bytes->data[i + j] & 0x0F];
+				*p++ = ' ';
 			} else {
-				g_string_append(gstr, "   ");
+				memset(p, ' ', 3);
+				p += 3;
 			}
 
 			if (j == 7) {
-				g_string_append_c(gstr, ' ');
+				*p++ = ' ';
 			}
 		}
 
-		g_string_append(gstr, " |");
+		*p++ = ' ';
+		*p++ = '|';
 
 		for (j = 0; (j < 16) && ((i + j) < bytes->len); j++) {
 			c = bytes->data[i + j];
@@ -225,17 +267,16 @@ fb_util_debug_hexdump(PurpleDebugLevel level, const GByteArray *bytes,
 				c = '.';
 			}
 
-			g_string_append_c(gstr, c);
+			*p++ = c;
 		}
 
-		g_string_append_c(gstr, '|');
-		fb_util_debug(level, "%s", gstr->str);
-		g_string_erase(gstr, 0, -1);
+		*p++ = '|';
+		*p = '\0';
+
+		fb_util_debug(level, "%s", line);
 	}
 
-	g_string_append_printf(gstr, "%s%08x", indent, i);
-	fb_util_debug(level, "%s", gstr->str);
-	g_string_free(gstr, TRUE);
+	fb_util_debug(level, "%s%08x", indent, i);
 }
 
 gchar *
@@ -544,42 +585,60 @@ fb_util_zlib_test(const GByteArray *bytes)
 	       ((b0 & 0x0F) == 8 /* Z_DEFLATED */); /* Check the method */
 }
 
-static GByteArray *
-fb_util_zlib_conv(GConverter *conv, const GByteArray *bytes, GError **error)
+/* Converts @bytes into @ret, which is sized to @hint up front and grown as
+ * needed, so the output is written in place instead of going through an
+ * intermediate buffer.
+ */
+static gboolean
+fb_util_zlib_conv(GConverter *conv, const GByteArray *bytes, GByteArray *ret,
+                  gsize hint, GError **error)
 {
-	GByteArray *ret;
 	GConverterResult res;
+	GError *err = NULL;
 	gsize cize = 0;
+	gsize oize = 0;
 	gsize rize;
 	gsize wize;
-	guint8 data[1024];
 
-	ret = g_byte_array_new();
+	g_byte_array_set_size(ret, MAX(hint, FB_UTIL_ZLIB_CHUNK));
 
 	while (TRUE) {
+		if (oize == ret->len) {
+			g_byte_array_set_size(ret, ret->len * 2);
+		}
+
 		rize = 0;
 		wize = 0;
 
 		res = g_converter_convert(conv,
 		                          bytes->data + cize,
 		                          bytes->len - cize,
-		                          data, sizeof data,
+		                          ret->data + oize,
+		                          ret->len - oize,
 		                          G_CONVERTER_INPUT_AT_END,
-		                          &rize, &wize, error);
+		                          &rize, &wize, &err);
 
 		switch (res) {
 		case G_CONVERTER_CONVERTED:
-			g_byte_array_append(ret, data, wize);
 			cize += rize;
+			oize += wize;
 			break;
 
 		case G_CONVERTER_ERROR:
-			g_byte_array_free(ret, TRUE);
-			return NULL;
+			if (g_error_matches(err, G_IO_ERROR, G_IO_ERROR_NO_SPACE)) {
+				g_clear_error(&err);
+				g_byte_array_set_size(ret, ret->len * 2);
+				break;
+			}
+
+			g_propagate_error(error, err);
+			g_byte_array_set_size(ret, 0);
+			return FALSE;
 
 		case G_CONVERTER_FINISHED:
-			g_byte_array_append(ret, data, wize);
-			return ret;
+			oize += wize;
+			g_byte_array_set_size(ret, oize);
+			return TRUE;
 
 		default:
 			break;
@@ -594,7 +653,15 @@ fb_util_zlib_deflate(const GByteArray *bytes, GError **error)
 	GZlibCompressor *conv;
 
 	conv = g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB, -1);
-	ret = fb_util_zlib_conv(G_CONVERTER(conv), bytes, error);
+	ret = g_byte_array_new();
+
+	if (!fb_util_zlib_conv(G_CONVERTER(conv), bytes, ret, bytes->len,
+	                       error))
+	{
+		g_byte_array_free(ret, TRUE);
+		ret = NULL;
+	}
+
 	g_object_unref(conv);
 	return ret;
 }
@@ -606,7 +673,82 @@ fb_util_zlib_inflate(const GByteArray *bytes, GError **error)
 	GZlibDecompressor *conv;
 
 	conv = g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB);
-	ret = fb_util_zlib_conv(G_CONVERTER(conv), bytes, error);
+	ret = g_byte_array_new();
+
+	if (!fb_util_zlib_conv(G_CONVERTER(conv), bytes, ret,
+	                       bytes->len * FB_UTIL_INFLATER_RATIO, error))
+	{
+		g_byte_array_free(ret, TRUE);
+		ret = NULL;
+	}
+
 	g_object_unref(conv);
 	return ret;
 }
+
+FbUtilInflater *
+fb_util_inflater_new(void)
+{
+	FbUtilInflater *inflater;
+
+	inflater = g_new0(FbUtilInflater, 1);
+	inflater->conv = g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB);
+	inflater->bytes = g_byte_array_new();
+	inflater->ratio = FB_UTIL_INFLATER_RATIO;
+
+	return inflater;
+}
+
+void
+fb_util_inflater_free(FbUtilInflater *inflater)
+{
+	if (inflater == NULL) {
+		return;
+	}
+
+	g_object_unref(inflater->conv);
+	g_byte_array_free(inflater->bytes, TRUE);
+	g_free(inflater);
+}
+
+GByteArray *
+fb_util_inflater_inflate(FbUtilInflater *inflater, const GByteArray *bytes,
+                         GError **error)
+{
+	guint ratio;
+	gboolean ret;
+
+	g_return_val_if_fail(inflater != NULL, NULL);
+	g_return_val_if_fail(bytes != NULL, NULL);
+
+	/* The last message was unusually large; let its buffer go. */
+	if (inflater->bytes->len > FB_UTIL_INFLATER_MAX_KEEP) {
+		g_byte_array_free(inflater->bytes, TRUE);
+		inflater->bytes = g_byte_array_new();
+	}
+
+	ret = fb_util_zlib_conv(G_CONVERTER(inflater->conv), bytes,
+	                        inflater->bytes,
+	                        (gsize) bytes->len * inflater->ratio, error);
+	g_converter_reset(G_CONVERTER(inflater->conv));
+
+	if (!ret) {
+		return NULL;
+	}
+
+	/* Jump up to a larger ratio right away so the next message of this
+	 * kind fits in the first pass, but only decay slowly towards smaller
+	 * ones, so that one outlier doesn't oversize every buffer after it.
+	 */
+	if (bytes->len > 0) {
+		ratio = (inflater->bytes->len + bytes->len - 1) / bytes->len;
+
+		if (ratio < inflater->ratio) {
+			ratio = (inflater->ratio * 3 + ratio) / 4;
+		}
+
+		inflater->ratio = CLAMP(ratio, 1, 64);
+	}
+
+	return inflater->bytes;
+}
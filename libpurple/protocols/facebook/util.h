@@ -69,6 +69,14 @@ typedef enum
 	FB_UTIL_DEBUG_FLAG_ALL = 3 << 25
 } FbUtilDebugFlags;
 
+/**
+ * FbUtilInflater:
+ *
+ * A reusable zlib inflater, which keeps its decompressor and output
+ * buffer between messages.
+ */
+typedef struct _FbUtilInflater FbUtilInflater;
+
 /**
  * FbUtilError:
  * @FB_UTIL_ERROR_GENERAL: General failure.
@@ -185,6 +193,18 @@ void
 fb_util_debug_fatal(const gchar *format, ...)
                     G_GNUC_PRINTF(1, 2);
 
+/**
+ * fb_util_debug_is_enabled:
+ * @level: The #PurpleDebugLevel, with any #FbUtilDebugFlags.
+ *
+ * Checks if a message at @level would be logged. Use this to avoid
+ * building expensive debugging output that nobody will see.
+ *
+ * Returns: #TRUE if the message would be logged, otherwise #FALSE.
+ */
+gboolean
+fb_util_debug_is_enabled(PurpleDebugLevel level);
+
 /**
  * fb_util_debug_hexdump:
  * @level: The #PurpleDebugLevel.
@@ -332,4 +352,41 @@ fb_util_zlib_deflate(const GByteArray *bytes, GError **error);
 GByteArray *
 fb_util_zlib_inflate(const GByteArray *bytes, GError **error);
 
+/**
+ * fb_util_inflater_new:
+ *
+ * Creates a new #FbUtilInflater. The returned #FbUtilInflater should be
+ * freed with #fb_util_inflater_free() when no longer needed.
+ *
+ * Returns: The new #FbUtilInflater.
+ */
+FbUtilInflater *
+fb_util_inflater_new(void);
+
+/**
+ * fb_util_inflater_free:
+ * @inflater: The #FbUtilInflater.
+ *
+ * Frees all memory used by the #FbUtilInflater.
+ */
+void
+fb_util_inflater_free(FbUtilInflater *inflater);
+
+/**
+ * fb_util_inflater_inflate:
+ * @inflater: The #FbUtilInflater.
+ * @bytes: The #GByteArray.
+ * @error: The return location for the #GError or #NULL.
+ *
+ * Inflates a #GByteArray with zlib into the output buffer of the
+ * #FbUtilInflater. The buffer is sized from the compression ratios
+ * seen so far, so most messages are inflated without reallocating.
+ *
+ * Returns: (transfer none): The inflated #GByteArray, which is only
+ *          valid until the next call, or #NULL on error.
+ */
+GByteArray *
+fb_util_inflater_inflate(FbUtilInflater *inflater, const GByteArray *bytes,
+                         GError **error);
+
 #endif /* PURPLE_FACEBOOK_UTIL_H */
@@ -48,6 +48,7 @@ typedef struct
 	uin_t uin;
 	time_t timestamp;
 	PurpleConnection *gc;
+	PurpleAvatarFetch *fetch;
 } ggp_avatar_buddy_update_req;
 
 #define GGP_AVATAR_BUDDY_URL "http://avatars.gg.pl/%u/s,big"
@@ -104,26 +105,25 @@ ggp_avatar_buddy_update_received(G_GNUC_UNUSED SoupSession *session,
                                  SoupMessage *msg, gpointer _pending_update)
 {
 	ggp_avatar_buddy_update_req *pending_update = _pending_update;
+	PurpleAvatarFetch *fetch = pending_update->fetch;
 	PurpleBuddy *buddy;
 	PurpleAccount *account;
-	PurpleConnection *gc = pending_update->gc;
-	gchar timestamp_str[20];
 	const gchar *got_data;
 	size_t got_len;
 
-	PURPLE_ASSERT_CONNECTION_IS_VALID(gc);
-
 	if (!SOUP_STATUS_IS_SUCCESSFUL(soup_message_get_status(msg))) {
 		purple_debug_error("gg",
 		                   "ggp_avatar_buddy_update_received: bad response "
 		                   "while getting avatar for %u: %s",
 		                   pending_update->uin,
 		                   soup_message_get_reason_phrase(msg));
-		g_free(pending_update);
+		purple_avatar_fetch_failed(fetch);
 		return;
 	}
 
-	account = purple_connection_get_account(gc);
+	PURPLE_ASSERT_CONNECTION_IS_VALID(pending_update->gc);
+
+	account = purple_avatar_fetch_get_account(fetch);
 	buddy = purple_blist_find_buddy(account,
 	                                ggp_uin_to_str(pending_update->uin));
 
@@ -131,36 +131,51 @@ ggp_avatar_buddy_update_received(G_GNUC_UNUSED SoupSession *session,
 		purple_debug_warning(
 		        "gg", "ggp_avatar_buddy_update_received: buddy %u disappeared",
 		        pending_update->uin);
-		g_free(pending_update);
+		purple_avatar_fetch_failed(fetch);
 		return;
 	}
 
-	g_snprintf(timestamp_str, sizeof(timestamp_str), "%lu",
-	           pending_update->timestamp);
-	got_data = msg->response_body->data;
-	got_len = msg->response_body->length;
-	purple_buddy_icons_set_for_user(account, purple_buddy_get_name(buddy),
-	                                g_memdup2(got_data, got_len), got_len,
-	                                timestamp_str);
-
 	purple_debug_info("gg",
 	                  "ggp_avatar_buddy_update_received: got avatar for buddy "
 	                  "%u [ts=%lu]",
 	                  pending_update->uin, pending_update->timestamp);
-	g_free(pending_update);
+
+	/* This frees pending_update as well. */
+	got_data = msg->response_body->data;
+	got_len = msg->response_body->length;
+	purple_avatar_fetch_complete(fetch, g_memdup2(got_data, got_len),
+	                             got_len);
 }
 
-void
-ggp_avatar_buddy_update(PurpleConnection *gc, uin_t uin, time_t timestamp)
+static void
+ggp_avatar_buddy_update_fetch(PurpleAvatarFetch *fetch, gpointer _pending_update)
 {
-	GGPInfo *info = purple_connection_get_protocol_data(gc);
+	ggp_avatar_buddy_update_req *pending_update = _pending_update;
+	GGPInfo *info = purple_connection_get_protocol_data(pending_update->gc);
 	gchar *url;
 	SoupMessage *req;
+
+	pending_update->fetch = fetch;
+
+	url = g_strdup_printf(GGP_AVATAR_BUDDY_URL, pending_update->uin);
+	req = soup_message_new("GET", url);
+	g_free(url);
+	soup_message_headers_replace(soup_message_get_request_headers(req),
+	                             "User-Agent", GGP_AVATAR_USERAGENT);
+	// purple_http_request_set_max_len(req, GGP_AVATAR_SIZE_MAX);
+	soup_session_queue_message(
+	        info->http, req, ggp_avatar_buddy_update_received, pending_update);
+}
+
+void
+ggp_avatar_buddy_update(PurpleConnection *gc, uin_t uin, time_t timestamp)
+{
 	ggp_avatar_buddy_update_req *pending_update;
 	PurpleBuddy *buddy;
 	PurpleAccount *account = purple_connection_get_account(gc);
 	time_t old_timestamp;
 	const char *old_timestamp_str;
+	gchar timestamp_str[20];
 
 	if (purple_debug_is_verbose()) {
 		purple_debug_misc("gg", "ggp_avatar_buddy_update(%p, %u, %lu)", gc, uin,
@@ -208,19 +223,19 @@ ggp_avatar_buddy_update(PurpleConnection *gc, uin_t uin, time_t timestamp)
 	                  "ggp_avatar_buddy_update(%p): updating %u with ts=%lu...",
 	                  gc, uin, timestamp);
 
-	pending_update = g_new(ggp_avatar_buddy_update_req, 1);
+	pending_update = g_new0(ggp_avatar_buddy_update_req, 1);
 	pending_update->uin = uin;
 	pending_update->timestamp = timestamp;
 	pending_update->gc = gc;
 
-	url = g_strdup_printf(GGP_AVATAR_BUDDY_URL, pending_update->uin);
-	req = soup_message_new("GET", url);
-	g_free(url);
-	soup_message_headers_replace(soup_message_get_request_headers(req),
-	                             "User-Agent", GGP_AVATAR_USERAGENT);
-	// purple_http_request_set_max_len(req, GGP_AVATAR_SIZE_MAX);
-	soup_session_queue_message(
-	        info->http, req, ggp_avatar_buddy_update_received, pending_update);
+	/* The timestamp only identifies the avatar of this one buddy, so the
+	 * fetch can't be shared with anyone else's. */
+	g_snprintf(timestamp_str, sizeof(timestamp_str), "%lu", timestamp);
+	purple_avatar_fetcher_submit(purple_avatar_fetcher_get_default(), account,
+	                             purple_buddy_get_name(buddy), timestamp_str,
+	                             PURPLE_AVATAR_FETCH_FLAGS_NONE,
+	                             ggp_avatar_buddy_update_fetch, pending_update,
+	                             g_free);
 }
 
 /*******************************************************************************
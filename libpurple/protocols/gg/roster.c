@@ -37,29 +37,63 @@
 #include "purplew.h"
 
 #define GGP_ROSTER_SYNC_SETT "gg-synchronized"
+#define GGP_ROSTER_VERSION_SETT "gg-roster-version"
 #define GGP_ROSTER_DEBUG 0
 #define GGP_ROSTER_GROUPID_DEFAULT "00000000-0000-0000-0000-000000000000"
 #define GGP_ROSTER_GROUPID_BOTS "0b345af6-0001-0000-0000-000000000004"
 
 /* TODO: ignored contacts synchronization (?) */
 
+/* The roster is kept as a list of serialized entries instead of a single
+ * xml tree. Only entries, that were changed locally, are parsed and
+ * serialized again; the document sent to the server is built by joining
+ * them.
+ */
+
 typedef struct
 {
+	/* 0 for elements other than Contact */
+	uin_t uin;
+
+	gchar *xml;
+
+	/* roster version, at which this entry was last changed */
 	int version;
+} ggp_roster_contact;
 
-	PurpleXmlNode *xml;
+typedef struct
+{
+	/* NULL for elements other than Group */
+	gchar *id;
 
-	PurpleXmlNode *groups_node, *contacts_node;
+	gchar *xml;
+} ggp_roster_group;
+
+typedef struct
+{
+	int version;
+
+	gchar *root_name;
+	gchar *root_start;
+
+	/* top-level elements other than Groups and Contacts */
+	GString *extra;
+
+	/* (ggp_roster_group*) entries of Groups element, in order */
+	GPtrArray *groups;
+
+	/* (ggp_roster_contact*) entries of Contacts element, in order */
+	GPtrArray *contacts;
 
 	/**
 	 * Key: (uin_t) user identifier
-	 * Value: (PurpleXmlNode*) xml node for contact
+	 * Value: (ggp_roster_contact*) entry for contact
 	 */
 	GHashTable *contact_nodes;
 
 	/**
 	 * Key: (gchar*) group id
-	 * Value: (PurpleXmlNode*) xml node for group
+	 * Value: (ggp_roster_group*) entry for group
 	 */
 	GHashTable *group_nodes;
 
@@ -77,9 +111,48 @@ typedef struct
 
 	gchar *bots_group_id;
 
+	/* document sent with the last update, until it's accepted */
+	gchar *sent_xml;
+
 	gboolean needs_update;
 } ggp_roster_content;
 
+/* contact data, that is not kept after import */
+typedef struct
+{
+	ggp_roster_contact *contact;
+	gchar *alias;
+	GPtrArray *group_ids;
+} ggp_roster_contact_info;
+
+typedef struct
+{
+	ggp_roster_content *content;
+
+	/* (ggp_roster_contact_info*) */
+	GPtrArray *contacts_info;
+
+	guint depth;
+	enum
+	{
+		GGP_ROSTER_SECTION_NONE,
+		GGP_ROSTER_SECTION_GROUPS,
+		GGP_ROSTER_SECTION_CONTACTS,
+		GGP_ROSTER_SECTION_OTHER,
+	} section;
+	gboolean has_groups, has_contacts;
+
+	/* currently read entry */
+	GString *xml;
+	GString *text;
+	gboolean is_entry;
+	gboolean in_contact_groups;
+	gchar *id, *name, *alias;
+	gboolean removable, has_removable, has_contact_groups;
+	uin_t uin;
+	GPtrArray *group_ids;
+} ggp_roster_parser;
+
 typedef struct
 {
 	enum
@@ -101,7 +174,9 @@ typedef struct
 
 static inline ggp_roster_session_data *
 ggp_roster_get_rdata(PurpleConnection *gc);
+static ggp_roster_content * ggp_roster_content_new(void);
 static void ggp_roster_content_free(ggp_roster_content *content);
+static gchar * ggp_roster_content_to_str(ggp_roster_content *content);
 static void ggp_roster_change_free(gpointer change);
 static int ggp_roster_get_version(PurpleConnection *gc);
 static gboolean ggp_roster_timer_cb(gpointer _gc);
@@ -109,18 +184,30 @@ static gboolean ggp_roster_timer_cb(gpointer _gc);
 static void ggp_roster_dump(ggp_roster_content *content);
 #endif
 
+/* streaming reader */
+static ggp_roster_content * ggp_roster_parse(const gchar *data, int version,
+	GPtrArray *contacts_info, GError **error);
+
+/* local cache */
+static gchar * ggp_roster_cache_filename(PurpleConnection *gc);
+static ggp_roster_content * ggp_roster_cache_load(PurpleConnection *gc);
+static void ggp_roster_cache_save(PurpleConnection *gc, int version,
+	const gchar *data);
+
 /* synchronization control */
 static gboolean ggp_roster_is_synchronized(PurpleBuddy *buddy);
 static void ggp_roster_set_synchronized(PurpleConnection *gc,
 	PurpleBuddy *buddy, gboolean synchronized);
 
 /* buddy list import */
-static gboolean ggp_roster_reply_list_read_group(PurpleXmlNode *node,
-	ggp_roster_content *content);
-static gboolean ggp_roster_reply_list_read_buddy(PurpleConnection *gc,
-	PurpleXmlNode *node, ggp_roster_content *content, GHashTable *remove_buddies);
+static void ggp_roster_reply_list_read_group(ggp_roster_group *group,
+	const gchar *name, gboolean removable, ggp_roster_content *content);
+static void ggp_roster_reply_list_read_buddy(PurpleConnection *gc,
+	ggp_roster_contact_info *info, ggp_roster_content *content,
+	ggp_roster_content *prev_content, GHashTable *remove_buddies);
 static void ggp_roster_reply_list(PurpleConnection *gc, uint32_t version,
 	const char *reply);
+static void ggp_roster_reply_up_to_date(PurpleConnection *gc);
 
 /* buddy list export */
 static const gchar * ggp_roster_send_update_group_add(
@@ -144,24 +231,99 @@ ggp_roster_get_rdata(PurpleConnection *gc)
 	return &accdata->roster_data;
 }
 
+static void ggp_roster_contact_free(gpointer _contact)
+{
+	ggp_roster_contact *contact = _contact;
+
+	g_free(contact->xml);
+	g_free(contact);
+}
+
+static void ggp_roster_group_free(gpointer _group)
+{
+	ggp_roster_group *group = _group;
+
+	g_free(group->id);
+	g_free(group->xml);
+	g_free(group);
+}
+
+static void ggp_roster_contact_info_free(gpointer _info)
+{
+	ggp_roster_contact_info *info = _info;
+
+	g_free(info->alias);
+	g_ptr_array_free(info->group_ids, TRUE);
+	g_free(info);
+}
+
+static ggp_roster_content * ggp_roster_content_new(void)
+{
+	ggp_roster_content *content = g_new0(ggp_roster_content, 1);
+
+	content->extra = g_string_new(NULL);
+	content->groups = g_ptr_array_new_with_free_func(ggp_roster_group_free);
+	content->contacts =
+		g_ptr_array_new_with_free_func(ggp_roster_contact_free);
+	content->contact_nodes = g_hash_table_new(NULL, NULL);
+	content->group_nodes = g_hash_table_new_full(
+		g_str_hash, g_str_equal, g_free, NULL);
+	content->group_ids = g_hash_table_new_full(
+		g_str_hash, g_str_equal, g_free, g_free);
+	content->group_names = g_hash_table_new_full(
+		g_str_hash, g_str_equal, g_free, g_free);
+
+	return content;
+}
+
 static void ggp_roster_content_free(ggp_roster_content *content)
 {
 	if (content == NULL)
 		return;
-	if (content->xml)
-		purple_xmlnode_free(content->xml);
-	if (content->contact_nodes)
-		g_hash_table_destroy(content->contact_nodes);
-	if (content->group_nodes)
-		g_hash_table_destroy(content->group_nodes);
-	if (content->group_ids)
-		g_hash_table_destroy(content->group_ids);
-	if (content->group_names)
-		g_hash_table_destroy(content->group_names);
+	g_free(content->root_name);
+	g_free(content->root_start);
+	g_string_free(content->extra, TRUE);
+	g_hash_table_destroy(content->contact_nodes);
+	g_hash_table_destroy(content->group_nodes);
+	g_hash_table_destroy(content->group_ids);
+	g_hash_table_destroy(content->group_names);
+	g_ptr_array_free(content->groups, TRUE);
+	g_ptr_array_free(content->contacts, TRUE);
 	g_free(content->bots_group_id);
+	g_free(content->sent_xml);
 	g_free(content);
 }
 
+static gchar * ggp_roster_content_to_str(ggp_roster_content *content)
+{
+	GString *str;
+	guint i;
+
+	g_return_val_if_fail(content->root_name != NULL, NULL);
+
+	str = g_string_new(content->root_start);
+	g_string_append_len(str, content->extra->str, content->extra->len);
+
+	g_string_append(str, "<Groups>");
+	for (i = 0; i < content->groups->len; i++) {
+		ggp_roster_group *group = g_ptr_array_index(content->groups, i);
+		g_string_append(str, group->xml);
+	}
+	g_string_append(str, "</Groups>");
+
+	g_string_append(str, "<Contacts>");
+	for (i = 0; i < content->contacts->len; i++) {
+		ggp_roster_contact *contact =
+			g_ptr_array_index(content->contacts, i);
+		g_string_append(str, contact->xml);
+	}
+	g_string_append(str, "</Contacts>");
+
+	g_string_append_printf(str, "</%s>", content->root_name);
+
+	return g_string_free(str, FALSE);
+}
+
 static void ggp_roster_change_free(gpointer _change)
 {
 	ggp_roster_change *change = _change;
@@ -197,17 +359,383 @@ static gboolean ggp_roster_timer_cb(gpointer _gc)
 static void ggp_roster_dump(ggp_roster_content *content)
 {
 	char *str;
-	int len;
 
 	g_return_if_fail(content != NULL);
-	g_return_if_fail(content->xml != NULL);
 
-	str = purple_xmlnode_to_formatted_str(content->xml, &len);
+	str = ggp_roster_content_to_str(content);
 	purple_debug_misc("gg", "ggp_roster_dump: [%s]\n", str);
 	g_free(str);
 }
 #endif
 
+/*******************************************************************************
+ * Streaming reader.
+ ******************************************************************************/
+
+static void ggp_roster_parser_append_start(GString *str,
+	const gchar *element_name, const gchar **attribute_names,
+	const gchar **attribute_values)
+{
+	int i;
+
+	g_string_append_printf(str, "<%s", element_name);
+	for (i = 0; attribute_names[i] != NULL; i++) {
+		gchar *value = g_markup_escape_text(attribute_values[i], -1);
+		g_string_append_printf(str, " %s=\"%s\"", attribute_names[i],
+			value);
+		g_free(value);
+	}
+	g_string_append_c(str, '>');
+}
+
+static void ggp_roster_parser_reset_entry(ggp_roster_parser *parser)
+{
+	if (parser->xml)
+		g_string_free(parser->xml, TRUE);
+	parser->xml = NULL;
+	g_clear_pointer(&parser->id, g_free);
+	g_clear_pointer(&parser->name, g_free);
+	g_clear_pointer(&parser->alias, g_free);
+	g_clear_pointer(&parser->group_ids, g_ptr_array_unref);
+	parser->is_entry = FALSE;
+	parser->in_contact_groups = FALSE;
+	parser->removable = FALSE;
+	parser->has_removable = FALSE;
+	parser->has_contact_groups = FALSE;
+	parser->uin = 0;
+}
+
+static gboolean ggp_roster_parser_end_group(ggp_roster_parser *parser,
+	GError **error)
+{
+	ggp_roster_content *content = parser->content;
+	ggp_roster_group *group;
+
+	if (parser->is_entry && (parser->id == NULL || parser->name == NULL ||
+		!parser->has_removable))
+	{
+		g_set_error_literal(error, G_MARKUP_ERROR,
+			G_MARKUP_ERROR_INVALID_CONTENT, "incomplete group");
+		return FALSE;
+	}
+
+	group = g_new0(ggp_roster_group, 1);
+	group->xml = g_string_free(parser->xml, FALSE);
+	parser->xml = NULL;
+	g_ptr_array_add(content->groups, group);
+
+	if (!parser->is_entry)
+		return TRUE;
+
+	group->id = g_steal_pointer(&parser->id);
+	ggp_roster_reply_list_read_group(group, parser->name,
+		parser->removable, content);
+
+	return TRUE;
+}
+
+static gboolean ggp_roster_parser_end_contact(ggp_roster_parser *parser,
+	GError **error)
+{
+	ggp_roster_content *content = parser->content;
+	ggp_roster_contact *contact;
+	ggp_roster_contact_info *info;
+
+	if (parser->is_entry && (parser->alias == NULL || parser->uin == 0 ||
+		!parser->has_contact_groups))
+	{
+		g_set_error_literal(error, G_MARKUP_ERROR,
+			G_MARKUP_ERROR_INVALID_CONTENT, "incomplete contact");
+		return FALSE;
+	}
+
+	contact = g_new0(ggp_roster_contact, 1);
+	contact->xml = g_string_free(parser->xml, FALSE);
+	parser->xml = NULL;
+	g_ptr_array_add(content->contacts, contact);
+
+	if (!parser->is_entry)
+		return TRUE;
+
+	contact->uin = parser->uin;
+	contact->version = content->version;
+	g_hash_table_insert(content->contact_nodes,
+		GINT_TO_POINTER(contact->uin), contact);
+
+	if (parser->contacts_info == NULL)
+		return TRUE;
+
+	info = g_new0(ggp_roster_contact_info, 1);
+	info->contact = contact;
+	info->alias = g_steal_pointer(&parser->alias);
+	info->group_ids = g_steal_pointer(&parser->group_ids);
+	g_ptr_array_add(parser->contacts_info, info);
+
+	return TRUE;
+}
+
+static void ggp_roster_parser_start_element(GMarkupParseContext *context,
+	const gchar *element_name, const gchar **attribute_names,
+	const gchar **attribute_values, gpointer _parser, GError **error)
+{
+	ggp_roster_parser *parser = _parser;
+	ggp_roster_content *content = parser->content;
+	guint level = parser->depth++;
+
+	if (level == 0) {
+		GString *root_start = g_string_new(NULL);
+		ggp_roster_parser_append_start(root_start, element_name,
+			attribute_names, attribute_values);
+		content->root_name = g_strdup(element_name);
+		content->root_start = g_string_free(root_start, FALSE);
+		return;
+	}
+
+	if (level == 1) {
+		if (!parser->has_groups &&
+			strcmp(element_name, "Groups") == 0)
+		{
+			parser->section = GGP_ROSTER_SECTION_GROUPS;
+			parser->has_groups = TRUE;
+			return;
+		}
+		if (!parser->has_contacts &&
+			strcmp(element_name, "Contacts") == 0)
+		{
+			parser->section = GGP_ROSTER_SECTION_CONTACTS;
+			parser->has_contacts = TRUE;
+			return;
+		}
+		parser->section = GGP_ROSTER_SECTION_OTHER;
+		parser->xml = g_string_new(NULL);
+	} else if (level == 2 && parser->section != GGP_ROSTER_SECTION_OTHER) {
+		parser->xml = g_string_new(NULL);
+		if (parser->section == GGP_ROSTER_SECTION_GROUPS) {
+			parser->is_entry =
+				(strcmp(element_name, "Group") == 0);
+		} else {
+			parser->is_entry =
+				(strcmp(element_name, "Contact") == 0);
+			parser->group_ids = g_ptr_array_new_with_free_func(
+				g_free);
+		}
+	} else if (level == 3 && parser->is_entry &&
+		parser->section == GGP_ROSTER_SECTION_CONTACTS &&
+		strcmp(element_name, "Groups") == 0)
+	{
+		parser->in_contact_groups = TRUE;
+		parser->has_contact_groups = TRUE;
+	}
+
+	ggp_roster_parser_append_start(parser->xml, element_name,
+		attribute_names, attribute_values);
+	g_string_truncate(parser->text, 0);
+}
+
+static void ggp_roster_parser_end_element(GMarkupParseContext *context,
+	const gchar *element_name, gpointer _parser, GError **error)
+{
+	ggp_roster_parser *parser = _parser;
+	ggp_roster_content *content = parser->content;
+	guint level = --parser->depth;
+	const gchar *text = parser->text->str;
+
+	if (level == 0)
+		return;
+
+	if (level == 1 && parser->section != GGP_ROSTER_SECTION_OTHER) {
+		parser->section = GGP_ROSTER_SECTION_NONE;
+		return;
+	}
+
+	g_string_append_printf(parser->xml, "</%s>", element_name);
+
+	if (parser->section == GGP_ROSTER_SECTION_OTHER) {
+		if (level > 1)
+			return;
+		g_string_append_len(content->extra, parser->xml->str,
+			parser->xml->len);
+		g_string_free(parser->xml, TRUE);
+		parser->xml = NULL;
+		parser->section = GGP_ROSTER_SECTION_NONE;
+		return;
+	}
+
+	if (level == 2) {
+		if (parser->section == GGP_ROSTER_SECTION_GROUPS)
+			ggp_roster_parser_end_group(parser, error);
+		else
+			ggp_roster_parser_end_contact(parser, error);
+		ggp_roster_parser_reset_entry(parser);
+		return;
+	}
+
+	if (!parser->is_entry)
+		return;
+
+	if (parser->section == GGP_ROSTER_SECTION_GROUPS && level == 3) {
+		if (strcmp(element_name, "Id") == 0) {
+			g_free(parser->id);
+			parser->id = g_strdup(text);
+		} else if (strcmp(element_name, "Name") == 0) {
+			g_free(parser->name);
+			parser->name = g_strdup(text);
+		} else if (strcmp(element_name, "IsRemovable") == 0) {
+			parser->removable = (g_ascii_strcasecmp(text, "true") == 0 ||
+				strcmp(text, "1") == 0);
+			parser->has_removable = TRUE;
+		}
+	} else if (parser->section == GGP_ROSTER_SECTION_CONTACTS &&
+		level == 3)
+	{
+		if (strcmp(element_name, "ShowName") == 0) {
+			g_free(parser->alias);
+			parser->alias = g_strdup(text);
+		} else if (strcmp(element_name, "GGNumber") == 0) {
+			gchar *endptr;
+			guint64 uin = g_ascii_strtoull(text, &endptr, 10);
+			if (endptr[0] != '\0' || uin > G_MAXUINT32)
+				uin = 0;
+			parser->uin = uin;
+		} else if (strcmp(element_name, "Groups") == 0)
+			parser->in_contact_groups = FALSE;
+	} else if (parser->in_contact_groups && level == 4 &&
+		strcmp(element_name, "GroupId") == 0)
+	{
+		g_ptr_array_add(parser->group_ids, g_strdup(text));
+	}
+}
+
+static void ggp_roster_parser_text(GMarkupParseContext *context,
+	const gchar *text, gsize text_len, gpointer _parser, GError **error)
+{
+	ggp_roster_parser *parser = _parser;
+
+	if (parser->xml) {
+		gchar *escaped = g_markup_escape_text(text, text_len);
+		g_string_append(parser->xml, escaped);
+		g_free(escaped);
+	}
+	g_string_append_len(parser->text, text, text_len);
+}
+
+static const GMarkupParser ggp_roster_parser_funcs = {
+	.start_element = ggp_roster_parser_start_element,
+	.end_element = ggp_roster_parser_end_element,
+	.text = ggp_roster_parser_text,
+};
+
+/* contacts_info is filled with ggp_roster_contact_info entries, if not NULL */
+static ggp_roster_content * ggp_roster_parse(const gchar *data, int version,
+	GPtrArray *contacts_info, GError **error)
+{
+	GMarkupParseContext *context;
+	ggp_roster_parser parser;
+	gboolean succ;
+
+	memset(&parser, 0, sizeof(parser));
+	parser.content = ggp_roster_content_new();
+	parser.content->version = version;
+	parser.contacts_info = contacts_info;
+	parser.text = g_string_new(NULL);
+
+	context = g_markup_parse_context_new(&ggp_roster_parser_funcs,
+		G_MARKUP_TREAT_CDATA_AS_TEXT,
+		&parser, NULL);
+	succ = g_markup_parse_context_parse(context, data, -1, error) &&
+		g_markup_parse_context_end_parse(context, error);
+	g_markup_parse_context_free(context);
+
+	ggp_roster_parser_reset_entry(&parser);
+	g_string_free(parser.text, TRUE);
+
+	if (succ && (!parser.has_groups || !parser.has_contacts)) {
+		g_set_error_literal(error, G_MARKUP_ERROR,
+			G_MARKUP_ERROR_INVALID_CONTENT,
+			"missing Groups or Contacts element");
+		succ = FALSE;
+	}
+
+	if (!succ) {
+		if (contacts_info)
+			g_ptr_array_set_size(contacts_info, 0);
+		ggp_roster_content_free(parser.content);
+		return NULL;
+	}
+
+	return parser.content;
+}
+
+/*******************************************************************************
+ * Local cache.
+ ******************************************************************************/
+
+static gchar * ggp_roster_cache_filename(PurpleConnection *gc)
+{
+	PurpleAccount *account = purple_connection_get_account(gc);
+
+	return g_strdup_printf("gg-roster-%u.xml",
+		ggp_str_to_uin(purple_account_get_username(account)));
+}
+
+static ggp_roster_content * ggp_roster_cache_load(PurpleConnection *gc)
+{
+	PurpleAccount *account = purple_connection_get_account(gc);
+	ggp_roster_content *content;
+	gchar *filename, *path, *data;
+	int version;
+	GError *error = NULL;
+
+	version = purple_account_get_int(account, GGP_ROSTER_VERSION_SETT, 0);
+	if (version <= 0)
+		return NULL;
+
+	filename = ggp_roster_cache_filename(gc);
+	path = g_build_filename(purple_cache_dir(), filename, NULL);
+	g_free(filename);
+
+	if (!g_file_get_contents(path, &data, NULL, &error)) {
+		purple_debug_warning("gg", "ggp_roster_cache_load: "
+			"cannot read %s: %s\n", path, error->message);
+		g_error_free(error);
+		g_free(path);
+		return NULL;
+	}
+	g_free(path);
+
+	content = ggp_roster_parse(data, version, NULL, &error);
+	g_free(data);
+	if (content == NULL) {
+		purple_debug_warning("gg", "ggp_roster_cache_load: "
+			"invalid cache: %s\n", error->message);
+		g_error_free(error);
+		return NULL;
+	}
+
+	purple_debug_info("gg", "ggp_roster_cache_load: version=%d, "
+		"contacts=%u\n", version,
+		g_hash_table_size(content->contact_nodes));
+
+	return content;
+}
+
+/* data should be the document accepted by the server as the given version */
+static void ggp_roster_cache_save(PurpleConnection *gc, int version,
+	const gchar *data)
+{
+	PurpleAccount *account = purple_connection_get_account(gc);
+	gchar *filename;
+
+	g_return_if_fail(data != NULL);
+
+	filename = ggp_roster_cache_filename(gc);
+	if (!purple_util_write_data_to_cache_file(filename, data, -1))
+		version = 0;
+	g_free(filename);
+
+	purple_account_set_int(account, GGP_ROSTER_VERSION_SETT, version);
+}
+
 /*******************************************************************************
  * Setup.
  ******************************************************************************/
@@ -235,9 +763,12 @@ void ggp_roster_setup(PurpleConnection *gc)
 	rdata->timer = 0;
 	rdata->is_updating = FALSE;
 
-	if (ggp_roster_enabled())
-		rdata->timer = g_timeout_add_seconds(2,
-			ggp_roster_timer_cb, gc);
+	if (!ggp_roster_enabled())
+		return;
+
+	/* the server replies with the list only, if it's newer than ours */
+	rdata->content = ggp_roster_cache_load(gc);
+	rdata->timer = g_timeout_add_seconds(2, ggp_roster_timer_cb, gc);
 }
 
 void ggp_roster_cleanup(PurpleConnection *gc)
@@ -314,7 +845,7 @@ void ggp_roster_reply(PurpleConnection *gc,
 	if (reply->type == GG_USERLIST100_REPLY_LIST)
 		ggp_roster_reply_list(gc, reply->version, reply->reply);
 	else if (reply->type == 0x01) /* list up to date (TODO: push to libgadu) */
-		purple_debug_info("gg", "ggp_roster_reply: list up to date\n");
+		ggp_roster_reply_up_to_date(gc);
 	else if (reply->type == GG_USERLIST100_REPLY_ACK)
 		ggp_roster_reply_ack(gc, reply->version);
 	else if (reply->type == GG_USERLIST100_REPLY_REJECT)
@@ -440,22 +971,11 @@ ggp_roster_remove_buddy(PurpleProtocolServer *protocol_server,
  * Buddy list import.
  ******************************************************************************/
 
-static gboolean ggp_roster_reply_list_read_group(PurpleXmlNode *node,
-	ggp_roster_content *content)
+static void ggp_roster_reply_list_read_group(ggp_roster_group *group,
+	const gchar *name, gboolean removable, ggp_roster_content *content)
 {
-	char *name, *id;
-	gboolean removable;
-	gboolean succ = TRUE, is_bot, is_default;
-
-	succ &= ggp_xml_get_string(node, "Id", &id);
-	succ &= ggp_xml_get_string(node, "Name", &name);
-	succ &= ggp_xml_get_bool(node, "IsRemovable", &removable);
-
-	if (!succ) {
-		g_free(id);
-		g_free(name);
-		g_return_val_if_reached(FALSE);
-	}
+	const gchar *id = group->id;
+	gboolean is_bot, is_default;
 
 	is_bot = (strcmp(id, GGP_ROSTER_GROUPID_BOTS) == 0 ||
 		g_strcmp0(name, "Pomocnicy") == 0);
@@ -466,78 +986,51 @@ static gboolean ggp_roster_reply_list_read_group(PurpleXmlNode *node,
 	if (!content->bots_group_id && is_bot)
 		content->bots_group_id = g_strdup(id);
 
-	if (!removable || is_bot || is_default) {
-		g_free(id);
-		g_free(name);
-		return TRUE;
-	}
+	if (!removable || is_bot || is_default)
+		return;
 
-	g_hash_table_insert(content->group_nodes, g_strdup(id), node);
+	g_hash_table_insert(content->group_nodes, g_strdup(id), group);
 	g_hash_table_insert(content->group_ids, g_strdup(name), g_strdup(id));
-	g_hash_table_insert(content->group_names, id, name);
-
-	return TRUE;
+	g_hash_table_insert(content->group_names, g_strdup(id),
+		g_strdup(name));
 }
 
-static gboolean ggp_roster_reply_list_read_buddy(PurpleConnection *gc,
-	PurpleXmlNode *node, ggp_roster_content *content, GHashTable *remove_buddies)
+/* prev_content is the roster, that the buddy list was synchronized with;
+ * it's NULL, if it's not known or it had different groups
+ */
+static void ggp_roster_reply_list_read_buddy(PurpleConnection *gc,
+	ggp_roster_contact_info *info, ggp_roster_content *content,
+	ggp_roster_content *prev_content, GHashTable *remove_buddies)
 {
-	gchar *alias, *group_name = NULL;
-	uin_t uin;
-	gboolean succ = TRUE;
-	PurpleXmlNode *group_list, *group_elem;
+	ggp_roster_contact *contact = info->contact, *prev_contact = NULL;
+	uin_t uin = contact->uin;
+	const gchar *alias = info->alias, *group_name = NULL;
 	PurpleBuddy *buddy = NULL;
 	PurpleGroup *group = NULL;
 	PurpleGroup *currentGroup;
 	gboolean alias_changed;
 	PurpleAccount *account = purple_connection_get_account(gc);
-
-	succ &= ggp_xml_get_string(node, "ShowName", &alias);
-	succ &= ggp_xml_get_uint(node, "GGNumber", &uin);
-
-	group_list = purple_xmlnode_get_child(node, "Groups");
-	succ &= (group_list != NULL);
-
-	if (!succ) {
-		g_free(alias);
-		g_return_val_if_reached(FALSE);
-	}
-
-	g_hash_table_insert(content->contact_nodes, GINT_TO_POINTER(uin), node);
+	guint i;
 
 	/* check, if alias is set */
-	if (*alias == '\0' ||
-		strcmp(alias, ggp_uin_to_str(uin)) == 0)
-	{
-		g_free(alias);
+	if (*alias == '\0' || strcmp(alias, ggp_uin_to_str(uin)) == 0)
 		alias = NULL;
-	}
 
 	/* getting (eventually creating) group */
-	group_elem = purple_xmlnode_get_child(group_list, "GroupId");
-	while (group_elem != NULL) {
-		gchar *id;
-		gboolean isbot;
-
-		if (!ggp_xml_get_string(group_elem, NULL, &id))
-			continue;
-		isbot = (0 == g_strcmp0(id, content->bots_group_id));
-		group_name = g_hash_table_lookup(content->group_names, id);
-		g_free(id);
+	for (i = 0; i < info->group_ids->len; i++) {
+		const gchar *id = g_ptr_array_index(info->group_ids, i);
 
 		/* we don't want to import bots;
 		 * they are inserted to roster by default
 		 */
-		if (isbot) {
-			g_free(alias);
-			return TRUE;
-		}
+		if (0 == g_strcmp0(id, content->bots_group_id))
+			return;
 
+		group_name = g_hash_table_lookup(content->group_names, id);
 		if (group_name != NULL)
 			break;
-
-		group_elem = purple_xmlnode_get_next_twin(group_elem);
 	}
+
 	if (group_name) {
 		group = purple_blist_find_group(group_name);
 		if (!group) {
@@ -555,9 +1048,7 @@ static gboolean ggp_roster_reply_list_read_buddy(PurpleConnection *gc,
 		buddy = purple_buddy_new(account, ggp_uin_to_str(uin), alias);
 		purple_blist_add_buddy(buddy, NULL, group, NULL);
 		ggp_roster_set_synchronized(gc, buddy, TRUE);
-
-		g_free(alias);
-		return TRUE;
+		return;
 	}
 
 	/* buddy exists, but is not synchronized - local list has priority */
@@ -565,18 +1056,25 @@ static gboolean ggp_roster_reply_list_read_buddy(PurpleConnection *gc,
 		purple_debug_misc("gg", "ggp_roster_reply_list_read_buddy: "
 			"ignoring not synchronized %u (%s)\n",
 			uin, purple_buddy_get_name(buddy));
-		g_free(alias);
-		return TRUE;
+		return;
+	}
+
+	/* entry didn't change since last synchronization */
+	if (prev_content) {
+		prev_contact = g_hash_table_lookup(prev_content->contact_nodes,
+			GINT_TO_POINTER(uin));
+	}
+	if (prev_contact && strcmp(prev_contact->xml, contact->xml) == 0) {
+		contact->version = prev_contact->version;
+		return;
 	}
 
 	currentGroup = ggp_purplew_buddy_get_group_only(buddy);
 	alias_changed =
 		(0 != g_strcmp0(alias, purple_buddy_get_alias_only(buddy)));
 
-	if (currentGroup == group && !alias_changed) {
-		g_free(alias);
-		return TRUE;
-	}
+	if (currentGroup == group && !alias_changed)
+		return;
 
 	purple_debug_misc("gg", "ggp_roster_reply_list_read_buddy: "
 		"updating %u (%s) - alias=\"%s\"->\"%s\", group=%p->%p (%s)\n",
@@ -587,21 +1085,64 @@ static gboolean ggp_roster_reply_list_read_buddy(PurpleConnection *gc,
 		purple_buddy_set_local_alias(buddy, alias);
 	if (currentGroup != group)
 		purple_blist_add_buddy(buddy, NULL, group, NULL);
+}
+
+static gboolean ggp_roster_groups_equal(ggp_roster_content *a,
+	ggp_roster_content *b)
+{
+	guint i;
+
+	if (a->groups->len != b->groups->len)
+		return FALSE;
+
+	for (i = 0; i < a->groups->len; i++) {
+		ggp_roster_group *group_a = g_ptr_array_index(a->groups, i);
+		ggp_roster_group *group_b = g_ptr_array_index(b->groups, i);
+
+		if (strcmp(group_a->xml, group_b->xml) != 0)
+			return FALSE;
+	}
 
-	g_free(alias);
 	return TRUE;
 }
 
+static void ggp_roster_queue_not_synchronized(PurpleConnection *gc,
+	GList *update_buddies)
+{
+	ggp_roster_session_data *rdata = ggp_roster_get_rdata(gc);
+	GList *it;
+
+	it = g_list_first(update_buddies);
+	while (it) {
+		PurpleBuddy *buddy = it->data;
+		uin_t uin = ggp_str_to_uin(purple_buddy_get_name(buddy));
+		ggp_roster_change *change;
+
+		it = g_list_next(it);
+		g_assert(uin > 0);
+
+		purple_debug_misc("gg", "ggp_roster_queue_not_synchronized: "
+			"adding change of %u for roster\n", uin);
+		change = g_new0(ggp_roster_change, 1);
+		change->type = GGP_ROSTER_CHANGE_CONTACT_UPDATE;
+		change->data.uin = uin;
+		rdata->pending_updates =
+			g_list_append(rdata->pending_updates, change);
+	}
+}
+
 static void ggp_roster_reply_list(PurpleConnection *gc, uint32_t version,
 	const char *data)
 {
 	ggp_roster_session_data *rdata = ggp_roster_get_rdata(gc);
-	PurpleXmlNode *xml, *xml_it;
 	PurpleAccount *account;
 	GSList *local_buddies;
 	GHashTable *remove_buddies;
 	GList *update_buddies = NULL, *local_groups, *it, *table_values;
-	ggp_roster_content *content;
+	GPtrArray *contacts_info;
+	ggp_roster_content *content, *prev_content;
+	GError *error = NULL;
+	guint i, changed = 0;
 
 	g_return_if_fail(gc != NULL);
 	g_return_if_fail(data != NULL);
@@ -611,47 +1152,33 @@ static void ggp_roster_reply_list(PurpleConnection *gc, uint32_t version,
 	purple_debug_info("gg", "ggp_roster_reply_list: got list, version=%u\n",
 		version);
 
-	xml = purple_xmlnode_from_str(data, -1);
-	if (xml == NULL) {
+	contacts_info = g_ptr_array_new_with_free_func(
+		ggp_roster_contact_info_free);
+	content = ggp_roster_parse(data, version, contacts_info, &error);
+	if (content == NULL) {
 		purple_debug_warning("gg", "ggp_roster_reply_list: "
-			"invalid xml\n");
+			"invalid xml: %s\n", error->message);
+		g_error_free(error);
+		g_ptr_array_free(contacts_info, TRUE);
 		return;
 	}
 
-	ggp_roster_content_free(rdata->content);
+	prev_content = rdata->content;
 	rdata->content = NULL;
 	rdata->is_updating = TRUE;
-	content = g_new0(ggp_roster_content, 1);
-	content->version = version;
-	content->xml = xml;
-	content->contact_nodes = g_hash_table_new(NULL, NULL);
-	content->group_nodes = g_hash_table_new_full(
-		g_str_hash, g_str_equal, g_free, NULL);
-	content->group_ids = g_hash_table_new_full(
-		g_str_hash, g_str_equal, g_free, g_free);
-	content->group_names = g_hash_table_new_full(
-		g_str_hash, g_str_equal, g_free, g_free);
+
+	/* when groups changed, contacts may have moved without changing
+	 * their entries
+	 */
+	if (prev_content && !ggp_roster_groups_equal(prev_content, content)) {
+		ggp_roster_content_free(prev_content);
+		prev_content = NULL;
+	}
 
 #if GGP_ROSTER_DEBUG
 	ggp_roster_dump(content);
 #endif
 
-	/* reading groups */
-	content->groups_node = purple_xmlnode_get_child(xml, "Groups");
-	if (content->groups_node == NULL) {
-		ggp_roster_content_free(content);
-		g_return_if_reached();
-	}
-	xml_it = purple_xmlnode_get_child(content->groups_node, "Group");
-	while (xml_it != NULL) {
-		if (!ggp_roster_reply_list_read_group(xml_it, content)) {
-			ggp_roster_content_free(content);
-			g_return_if_reached();
-		}
-
-		xml_it = purple_xmlnode_get_next_twin(xml_it);
-	}
-
 	/* dumping current group list */
 	local_groups = ggp_purplew_account_get_groups(account, TRUE);
 
@@ -679,26 +1206,17 @@ static void ggp_roster_reply_list(PurpleConnection *gc, uint32_t version,
 	}
 
 	/* reading buddies */
-	content->contacts_node = purple_xmlnode_get_child(xml, "Contacts");
-	if (content->contacts_node == NULL) {
-		g_hash_table_destroy(remove_buddies);
-		g_list_free(update_buddies);
-		ggp_roster_content_free(content);
-		g_return_if_reached();
-	}
-	xml_it = purple_xmlnode_get_child(content->contacts_node, "Contact");
-	while (xml_it != NULL) {
-		if (!ggp_roster_reply_list_read_buddy(gc, xml_it, content,
-			remove_buddies))
-		{
-			g_hash_table_destroy(remove_buddies);
-			g_list_free(update_buddies);
-			ggp_roster_content_free(content);
-			g_return_if_reached();
-		}
-
-		xml_it = purple_xmlnode_get_next_twin(xml_it);
+	for (i = 0; i < contacts_info->len; i++) {
+		ggp_roster_contact_info *info =
+			g_ptr_array_index(contacts_info, i);
+
+		ggp_roster_reply_list_read_buddy(gc, info, content,
+			prev_content, remove_buddies);
+		if (info->contact->version == version)
+			changed++;
 	}
+	g_ptr_array_free(contacts_info, TRUE);
+	ggp_roster_content_free(prev_content);
 
 	/* removing buddies, which are not present in roster */
 	table_values = g_hash_table_get_values(remove_buddies);
@@ -732,29 +1250,43 @@ static void ggp_roster_reply_list(PurpleConnection *gc, uint32_t version,
 	g_list_free(local_groups);
 
 	/* adding not synchronized buddies */
-	it = g_list_first(update_buddies);
-	while (it) {
-		PurpleBuddy *buddy = it->data;
-		uin_t uin = ggp_str_to_uin(purple_buddy_get_name(buddy));
-		ggp_roster_change *change;
-
-		it = g_list_next(it);
-		g_assert(uin > 0);
-
-		purple_debug_misc("gg", "ggp_roster_reply_list: "
-			"adding change of %u for roster\n", uin);
-		change = g_new0(ggp_roster_change, 1);
-		change->type = GGP_ROSTER_CHANGE_CONTACT_UPDATE;
-		change->data.uin = uin;
-		rdata->pending_updates =
-			g_list_append(rdata->pending_updates, change);
-	}
+	ggp_roster_queue_not_synchronized(gc, update_buddies);
 	g_list_free(update_buddies);
 
+	ggp_roster_cache_save(gc, version, data);
+
 	rdata->content = content;
 	rdata->is_updating = FALSE;
 	purple_debug_info("gg", "ggp_roster_reply_list: "
-		"import done, version=%u\n", version);
+		"import done, version=%u, changed %u of %u contacts\n", version,
+		changed, g_hash_table_size(content->contact_nodes));
+}
+
+static void ggp_roster_reply_up_to_date(PurpleConnection *gc)
+{
+	PurpleAccount *account = purple_connection_get_account(gc);
+	GSList *local_buddies;
+	GList *update_buddies = NULL;
+
+	purple_debug_info("gg", "ggp_roster_reply: list up to date\n");
+
+	/* the list wasn't imported in this session, so buddies added while
+	 * offline have to be uploaded from here
+	 */
+	local_buddies = purple_blist_find_buddies(account, NULL);
+	while (local_buddies) {
+		PurpleBuddy *buddy = local_buddies->data;
+		local_buddies =
+			g_slist_delete_link(local_buddies, local_buddies);
+
+		if (!ggp_str_to_uin(purple_buddy_get_name(buddy)))
+			continue;
+		if (!ggp_roster_is_synchronized(buddy))
+			update_buddies = g_list_append(update_buddies, buddy);
+	}
+
+	ggp_roster_queue_not_synchronized(gc, update_buddies);
+	g_list_free(update_buddies);
 }
 
 /*******************************************************************************
@@ -766,8 +1298,7 @@ static const gchar * ggp_roster_send_update_group_add(
 {
 	gchar *id;
 	const char *id_existing, *group_name;
-	PurpleXmlNode *group_node;
-	gboolean succ = TRUE;
+	ggp_roster_group *group_entry;
 
 	if (group) {
 		group_name = purple_group_get_name(group);
@@ -783,18 +1314,17 @@ static const gchar * ggp_roster_send_update_group_add(
 
 	id = g_uuid_string_random();
 
-	group_node = purple_xmlnode_new_child(content->groups_node, "Group");
-	succ &= ggp_xml_set_string(group_node, "Id", id);
-	succ &= ggp_xml_set_string(group_node, "Name", group_name);
-	succ &= ggp_xml_set_string(group_node, "IsExpanded", "true");
-	succ &= ggp_xml_set_string(group_node, "IsRemovable", "true");
+	group_entry = g_new0(ggp_roster_group, 1);
+	group_entry->id = g_strdup(id);
+	group_entry->xml = g_markup_printf_escaped("<Group><Id>%s</Id>"
+		"<Name>%s</Name><IsExpanded>true</IsExpanded>"
+		"<IsRemovable>true</IsRemovable></Group>", id, group_name);
+	g_ptr_array_add(content->groups, group_entry);
 	content->needs_update = TRUE;
 
 	g_hash_table_insert(content->group_ids, g_strdup(group_name),
 		g_strdup(id));
-	g_hash_table_replace(content->group_nodes, id, group_node);
-
-	g_return_val_if_fail(succ, NULL);
+	g_hash_table_replace(content->group_nodes, id, group_entry);
 
 	return id;
 }
@@ -806,6 +1336,7 @@ static gboolean ggp_roster_send_update_contact_update(PurpleConnection *gc,
 	ggp_roster_content *content = ggp_roster_get_rdata(gc)->content;
 	uin_t uin = change->data.uin;
 	PurpleBuddy *buddy;
+	ggp_roster_contact *contact;
 	PurpleXmlNode *buddy_node, *contact_groups;
 	gboolean succ = TRUE;
 	const gchar *group_id;
@@ -817,16 +1348,19 @@ static gboolean ggp_roster_send_update_contact_update(PurpleConnection *gc,
 	buddy = purple_blist_find_buddy(account, ggp_uin_to_str(uin));
 	if (!buddy)
 		return TRUE;
-	buddy_node = g_hash_table_lookup(content->contact_nodes,
+	contact = g_hash_table_lookup(content->contact_nodes,
 		GINT_TO_POINTER(uin));
 
 	group_id = ggp_roster_send_update_group_add(content,
 		ggp_purplew_buddy_get_group_only(buddy));
 
-	if (buddy_node) { /* update existing */
+	if (contact) { /* update existing */
 		purple_debug_misc("gg", "ggp_roster_send_update_contact_update:"
 			" updating %u...\n", uin);
 
+		buddy_node = purple_xmlnode_from_str(contact->xml, -1);
+		g_return_val_if_fail(buddy_node != NULL, FALSE);
+
 		succ &= ggp_xml_set_string(buddy_node, "ShowName",
 			purple_buddy_get_alias(buddy));
 
@@ -835,6 +1369,10 @@ static gboolean ggp_roster_send_update_contact_update(PurpleConnection *gc,
 		ggp_xmlnode_remove_children(contact_groups);
 		succ &= ggp_xml_set_string(contact_groups, "GroupId", group_id);
 
+		g_free(contact->xml);
+		contact->xml = purple_xmlnode_to_str(buddy_node, NULL);
+		purple_xmlnode_free(buddy_node);
+
 		g_return_val_if_fail(succ, FALSE);
 
 		return TRUE;
@@ -844,7 +1382,7 @@ static gboolean ggp_roster_send_update_contact_update(PurpleConnection *gc,
 	guid = g_uuid_string_random();
 	purple_debug_misc("gg", "ggp_roster_send_update_contact_update: "
 		"adding %u...\n", uin);
-	buddy_node = purple_xmlnode_new_child(content->contacts_node, "Contact");
+	buddy_node = purple_xmlnode_new("Contact");
 	succ &= ggp_xml_set_string(buddy_node, "Guid", guid);
 	succ &= ggp_xml_set_uint(buddy_node, "GGNumber", uin);
 	succ &= ggp_xml_set_string(buddy_node, "ShowName",
@@ -864,8 +1402,13 @@ static gboolean ggp_roster_send_update_contact_update(PurpleConnection *gc,
 	 */
 	g_free(guid);
 
+	contact = g_new0(ggp_roster_contact, 1);
+	contact->uin = uin;
+	contact->xml = purple_xmlnode_to_str(buddy_node, NULL);
+	purple_xmlnode_free(buddy_node);
+	g_ptr_array_add(content->contacts, contact);
 	g_hash_table_insert(content->contact_nodes, GINT_TO_POINTER(uin),
-		buddy_node);
+		contact);
 
 	g_return_val_if_fail(succ, FALSE);
 
@@ -879,7 +1422,7 @@ static gboolean ggp_roster_send_update_contact_remove(PurpleConnection *gc,
 	ggp_roster_content *content = ggp_roster_get_rdata(gc)->content;
 	uin_t uin = change->data.uin;
 	PurpleBuddy *buddy;
-	PurpleXmlNode *buddy_node;
+	ggp_roster_contact *contact;
 
 	g_return_val_if_fail(change->type == GGP_ROSTER_CHANGE_CONTACT_REMOVE,
 		FALSE);
@@ -891,15 +1434,15 @@ static gboolean ggp_roster_send_update_contact_remove(PurpleConnection *gc,
 		return TRUE;
 	}
 
-	buddy_node = g_hash_table_lookup(content->contact_nodes,
+	contact = g_hash_table_lookup(content->contact_nodes,
 		GINT_TO_POINTER(uin));
-	if (!buddy_node) /* already removed */
+	if (!contact) /* already removed */
 		return TRUE;
 
 	purple_debug_info("gg", "ggp_roster_send_update_contact_remove: "
 		"removing %u\n", uin);
-	purple_xmlnode_free(buddy_node);
 	g_hash_table_remove(content->contact_nodes, GINT_TO_POINTER(uin));
+	g_ptr_array_remove(content->contacts, contact);
 
 	return TRUE;
 }
@@ -911,8 +1454,10 @@ static gboolean ggp_roster_send_update_group_rename(PurpleConnection *gc,
 	ggp_roster_content *content = ggp_roster_get_rdata(gc)->content;
 	const char *old_name = change->data.group_rename.old_name;
 	const char *new_name = change->data.group_rename.new_name;
+	ggp_roster_group *group_entry;
 	PurpleXmlNode *group_node;
 	const char *group_id;
+	gboolean succ;
 
 	g_return_val_if_fail(change->type == GGP_ROSTER_CHANGE_GROUP_RENAME,
 		FALSE);
@@ -947,20 +1492,25 @@ static gboolean ggp_roster_send_update_group_rename(PurpleConnection *gc,
 		return TRUE;
 	}
 
-	group_node = g_hash_table_lookup(content->group_nodes, group_id);
-	if (!group_node) {
+	group_entry = g_hash_table_lookup(content->group_nodes, group_id);
+	if (!group_entry) {
 		purple_debug_error("gg", "ggp_roster_send_update_group_rename: "
 			"node for %s not found, id=%s\n", old_name, group_id);
 		g_hash_table_remove(content->group_ids, old_name);
 		return TRUE;
 	}
 
-	g_hash_table_remove(content->group_ids, old_name);
+	group_node = purple_xmlnode_from_str(group_entry->xml, -1);
+	g_return_val_if_fail(group_node != NULL, FALSE);
+	succ = ggp_xml_set_string(group_node, "Name", new_name);
+	g_free(group_entry->xml);
+	group_entry->xml = purple_xmlnode_to_str(group_node, NULL);
+	purple_xmlnode_free(group_node);
+
 	g_hash_table_insert(content->group_ids, g_strdup(new_name),
-		g_strdup(group_id));
-	g_hash_table_insert(content->group_nodes, g_strdup(group_id),
-		group_node);
-	return ggp_xml_set_string(group_node, "Name", new_name);
+		g_strdup(group_entry->id));
+	g_hash_table_remove(content->group_ids, old_name);
+	return succ;
 }
 
 static void ggp_roster_send_update(PurpleConnection *gc)
@@ -968,9 +1518,8 @@ static void ggp_roster_send_update(PurpleConnection *gc)
 	GGPInfo *accdata = purple_connection_get_protocol_data(gc);
 	ggp_roster_session_data *rdata = ggp_roster_get_rdata(gc);
 	ggp_roster_content *content = rdata->content;
+	GHashTable *updated_uins;
 	GList *updates_it;
-	gchar *str;
-	int len;
 
 	/* an update is running now */
 	if (rdata->sent_updates)
@@ -990,6 +1539,10 @@ static void ggp_roster_send_update(PurpleConnection *gc)
 	rdata->sent_updates = rdata->pending_updates;
 	rdata->pending_updates = NULL;
 
+	/* contact may be queued many times, but it's enough to serialize
+	 * its entry once
+	 */
+	updated_uins = g_hash_table_new(NULL, NULL);
 	updates_it = g_list_first(rdata->sent_updates);
 	while (updates_it) {
 		ggp_roster_change *change = updates_it->data;
@@ -997,25 +1550,37 @@ static void ggp_roster_send_update(PurpleConnection *gc)
 		updates_it = g_list_next(updates_it);
 
 		if (change->type == GGP_ROSTER_CHANGE_CONTACT_UPDATE) {
+			if (!g_hash_table_add(updated_uins,
+				GINT_TO_POINTER(change->data.uin)))
+			{
+				continue;
+			}
 			succ = ggp_roster_send_update_contact_update(gc, change);
 		} else if (change->type == GGP_ROSTER_CHANGE_CONTACT_REMOVE) {
+			g_hash_table_remove(updated_uins,
+				GINT_TO_POINTER(change->data.uin));
 			succ = ggp_roster_send_update_contact_remove(gc, change);
 		} else if (change->type == GGP_ROSTER_CHANGE_GROUP_RENAME) {
 			succ = ggp_roster_send_update_group_rename(gc, change);
 		} else {
 			purple_debug_error("gg", "ggp_roster_send_update: not handled");
 		}
-		g_return_if_fail(succ);
+		if (!succ) {
+			g_hash_table_destroy(updated_uins);
+			g_return_if_reached();
+		}
 	}
+	g_hash_table_destroy(updated_uins);
 
 #if GGP_ROSTER_DEBUG
 	ggp_roster_dump(content);
 #endif
 
-	str = purple_xmlnode_to_str(content->xml, &len);
+	g_free(content->sent_xml);
+	content->sent_xml = ggp_roster_content_to_str(content);
 	gg_userlist100_request(accdata->session, GG_USERLIST100_PUT,
-		content->version, GG_USERLIST100_FORMAT_TYPE_GG100, str);
-	g_free(str);
+		content->version, GG_USERLIST100_FORMAT_TYPE_GG100,
+		content->sent_xml);
 }
 
 static void ggp_roster_reply_ack(PurpleConnection *gc, uint32_t version)
@@ -1032,6 +1597,7 @@ static void ggp_roster_reply_ack(PurpleConnection *gc, uint32_t version)
 	while (updates_it) {
 		ggp_roster_change *change = updates_it->data;
 		PurpleBuddy *buddy;
+		ggp_roster_contact *contact;
 		updates_it = g_list_next(updates_it);
 
 		if (change->type != GGP_ROSTER_CHANGE_CONTACT_UPDATE)
@@ -1041,6 +1607,11 @@ static void ggp_roster_reply_ack(PurpleConnection *gc, uint32_t version)
 			ggp_uin_to_str(change->data.uin));
 		if (buddy)
 			ggp_roster_set_synchronized(gc, buddy, TRUE);
+
+		contact = content ? g_hash_table_lookup(content->contact_nodes,
+			GINT_TO_POINTER(change->data.uin)) : NULL;
+		if (contact)
+			contact->version = version;
 	}
 
 	/* we need to remove "synchronized" flag for all contacts, that have
@@ -1072,9 +1643,14 @@ static void ggp_roster_reply_ack(PurpleConnection *gc, uint32_t version)
 		/* we have to wait for gg_event_userlist100_version
 		 * ggp_roster_request_update(gc);
 		 */
+		return;
+	}
+
+	content->version = version;
+	if (content->sent_xml) {
+		ggp_roster_cache_save(gc, version, content->sent_xml);
+		g_clear_pointer(&content->sent_xml, g_free);
 	}
-	else
-		content->version = version;
 }
 
 static void ggp_roster_reply_reject(PurpleConnection *gc, uint32_t version)
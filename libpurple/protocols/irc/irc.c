@@ -287,7 +287,9 @@ int irc_send_len(struct irc_conn *irc, const char *buf, int buflen)
 	if (tosend == NULL)
 		return 0;
 
-	if (purple_debug_is_verbose()) {
+	if (purple_debug_is_verbose() &&
+	    purple_debug_is_enabled(PURPLE_DEBUG_MISC, "irc"))
+	{
 		gchar *clean = g_utf8_make_valid(tosend, -1);
 		clean = g_strstrip(clean);
 		purple_debug_misc("irc", "<< %s\n", clean);
@@ -647,6 +649,7 @@ irc_login_cb(GObject *source, GAsyncResult *res, gpointer user_data)
 	GSocketConnection *conn;
 	GError *error = NULL;
 	struct irc_conn *irc;
+	gboolean logged_in;
 
 	conn = g_socket_client_connect_to_host_finish(G_SOCKET_CLIENT(source),
 			res, &error);
@@ -662,7 +665,12 @@ irc_login_cb(GObject *source, GAsyncResult *res, gpointer user_data)
 	irc->output = purple_queued_output_stream_new(
 			g_io_stream_get_output_stream(G_IO_STREAM(irc->conn)));
 
-	if (do_login(gc)) {
+	/* Send the whole registration burst in one write. */
+	purple_queued_output_stream_cork(irc->output);
+	logged_in = do_login(gc);
+	purple_queued_output_stream_uncork(irc->output);
+
+	if (logged_in) {
 		irc->input = g_data_input_stream_new(
 				g_io_stream_get_input_stream(
 						G_IO_STREAM(irc->conn)));
@@ -707,6 +715,7 @@ static void irc_close(PurpleConnection *gc)
 	g_free(irc->server);
 
 	g_free(irc->mode_chars);
+	g_free(irc->elist);
 	g_free(irc->reqnick);
 
 	if (irc->sasl_conn) {
@@ -1032,6 +1041,52 @@ irc_roomlist_get_list(PurpleProtocolRoomlist *protocol_roomlist,
 	return irc->roomlist;
 }
 
+static PurpleRoomlist *
+irc_roomlist_get_list_filtered(PurpleProtocolRoomlist *protocol_roomlist,
+                               PurpleConnection *gc, const gchar *filter,
+                               guint min_users)
+{
+	struct irc_conn *irc;
+	GPtrArray *conditions;
+	char *buf;
+
+	irc = purple_connection_get_protocol_data(gc);
+
+	if (irc->roomlist)
+		g_object_unref(irc->roomlist);
+
+	irc->roomlist = purple_roomlist_new(purple_connection_get_account(gc));
+
+	/* Only send the conditions the server told us it understands in
+	 * ELIST, anything else is filtered by libpurple as the rooms arrive. */
+	conditions = g_ptr_array_new_with_free_func(g_free);
+	if (irc->elist != NULL) {
+		if (min_users > 0 && strchr(irc->elist, 'U') != NULL)
+			g_ptr_array_add(conditions, g_strdup_printf(">%u", min_users - 1));
+		if (filter != NULL && *filter != '\0' && strchr(filter, ',') == NULL &&
+		    strchr(filter, ' ') == NULL && strchr(irc->elist, 'M') != NULL)
+		{
+			g_ptr_array_add(conditions, g_strdup(filter));
+		}
+	}
+	g_ptr_array_add(conditions, NULL);
+
+	if (conditions->len > 1) {
+		char *joined = g_strjoinv(",", (char **)conditions->pdata);
+
+		buf = irc_format(irc, "vc", "LIST", joined);
+		g_free(joined);
+	} else {
+		buf = irc_format(irc, "v", "LIST");
+	}
+	irc_send(irc, buf);
+	g_free(buf);
+
+	g_ptr_array_free(conditions, TRUE);
+
+	return irc->roomlist;
+}
+
 static void
 irc_roomlist_cancel(PurpleProtocolRoomlist *protocol_roomlist,
                     PurpleRoomlist *list)
@@ -1147,8 +1202,9 @@ irc_protocol_chat_iface_init(PurpleProtocolChatInterface *chat_iface)
 static void
 irc_protocol_roomlist_iface_init(PurpleProtocolRoomlistInterface *roomlist_iface)
 {
-	roomlist_iface->get_list = irc_roomlist_get_list;
-	roomlist_iface->cancel   = irc_roomlist_cancel;
+	roomlist_iface->get_list          = irc_roomlist_get_list;
+	roomlist_iface->get_list_filtered = irc_roomlist_get_list_filtered;
+	roomlist_iface->cancel            = irc_roomlist_cancel;
 }
 
 static void
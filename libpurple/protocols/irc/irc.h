@@ -93,6 +93,7 @@ struct irc_conn {
 	time_t recv_time;
 
 	char *mode_chars;
+	char *elist;
 	char *reqnick;
 	gboolean nickused;
 	sasl_conn_t *sasl_conn;
@@ -207,6 +207,11 @@ void irc_msg_features(struct irc_conn *irc, const char *name, const char *from,
 		if (!strncmp(features[i], "PREFIX=", 7)) {
 			if ((val = strchr(features[i] + 7, ')')) != NULL)
 				irc->mode_chars = g_strdup(val + 1);
+		} else if (!strncmp(features[i], "ELIST=", 6)) {
+			/* The extensions the server supports for LIST, we use
+			 * M (masks) and U (user counts) to filter room lists. */
+			g_free(irc->elist);
+			irc->elist = g_ascii_strup(features[i] + 6, -1);
 		}
 	}
 
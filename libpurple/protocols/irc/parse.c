@@ -686,7 +686,9 @@ void irc_parse_msg(struct irc_conn *irc, char *input)
 	 */
 	purple_signal_emit(_irc_protocol, "irc-receiving-text", gc, &input);
 
-	if (purple_debug_is_verbose()) {
+	if (purple_debug_is_verbose() &&
+	    purple_debug_is_enabled(PURPLE_DEBUG_MISC, "irc"))
+	{
 		char *clean = g_utf8_make_valid(input, -1);
 		clean = g_strstrip(clean);
 		purple_debug_misc("irc", ">> %s\n", clean);
@@ -807,6 +809,11 @@ void irc_parse_msg(struct irc_conn *irc, char *input)
 static void irc_parse_error_cb(struct irc_conn *irc, char *input)
 {
 	char *clean;
+
+	if (!purple_debug_is_enabled(PURPLE_DEBUG_WARNING, "irc")) {
+		return;
+	}
+
 	/* This really should be escaped somehow that you can tell what
 	 * the junk was -- but as it is, it can crash glib. */
 	clean = g_utf8_make_valid(input, -1);
@@ -0,0 +1,186 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "purpleircv3capabilities.h"
+
+/* The capabilities we know how to use, in the order we request them. */
+static const gchar *wanted[] = {
+	"batch",
+	"chathistory",
+	"draft/chathistory",
+	"echo-message",
+	"message-tags",
+	"server-time",
+};
+
+struct _PurpleIRCv3Capabilities {
+	/* name -> value, the value being an empty string if there isn't one. */
+	GHashTable *available;
+	GHashTable *enabled;
+};
+
+/******************************************************************************
+ * Internal API
+ *****************************************************************************/
+PurpleIRCv3Capabilities *
+purple_ircv3_capabilities_new(void) {
+	PurpleIRCv3Capabilities *caps = g_new0(PurpleIRCv3Capabilities, 1);
+
+	caps->available = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+	                                        g_free);
+	caps->enabled = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+	                                      NULL);
+
+	return caps;
+}
+
+void
+purple_ircv3_capabilities_free(PurpleIRCv3Capabilities *caps) {
+	if(caps == NULL) {
+		return;
+	}
+
+	g_hash_table_destroy(caps->available);
+	g_hash_table_destroy(caps->enabled);
+	g_free(caps);
+}
+
+void
+purple_ircv3_capabilities_add_available(PurpleIRCv3Capabilities *caps,
+                                        const gchar *list)
+{
+	gchar **names = NULL;
+
+	g_return_if_fail(caps != NULL);
+
+	if(list == NULL) {
+		return;
+	}
+
+	names = g_strsplit(list, " ", -1);
+	for(gint i = 0; names[i] != NULL; i++) {
+		gchar *name = names[i];
+		gchar *value = NULL;
+
+		if(*name == '\0') {
+			continue;
+		}
+
+		value = strchr(name, '=');
+		if(value != NULL) {
+			*value++ = '\0';
+		}
+
+		g_hash_table_insert(caps->available, g_strdup(name),
+		                    g_strdup(value != NULL ? value : ""));
+	}
+	g_strfreev(names);
+}
+
+const gchar *
+purple_ircv3_capabilities_get_value(PurpleIRCv3Capabilities *caps,
+                                    const gchar *name)
+{
+	g_return_val_if_fail(caps != NULL, NULL);
+
+	return g_hash_table_lookup(caps->available, name);
+}
+
+gchar *
+purple_ircv3_capabilities_build_request(PurpleIRCv3Capabilities *caps) {
+	GString *request = NULL;
+
+	g_return_val_if_fail(caps != NULL, NULL);
+
+	request = g_string_new(NULL);
+	for(gsize i = 0; i < G_N_ELEMENTS(wanted); i++) {
+		if(!g_hash_table_contains(caps->available, wanted[i])) {
+			continue;
+		}
+
+		if(request->len > 0) {
+			g_string_append_c(request, ' ');
+		}
+		g_string_append(request, wanted[i]);
+	}
+
+	if(request->len == 0) {
+		g_string_free(request, TRUE);
+
+		return NULL;
+	}
+
+	return g_string_free(request, FALSE);
+}
+
+void
+purple_ircv3_capabilities_acknowledge(PurpleIRCv3Capabilities *caps,
+                                      const gchar *list)
+{
+	gchar **names = NULL;
+
+	g_return_if_fail(caps != NULL);
+
+	if(list == NULL) {
+		return;
+	}
+
+	names = g_strsplit(list, " ", -1);
+	for(gint i = 0; names[i] != NULL; i++) {
+		const gchar *name = names[i];
+
+		if(*name == '\0') {
+			continue;
+		}
+
+		/* A leading '-' means the capability was disabled. */
+		if(*name == '-') {
+			g_hash_table_remove(caps->enabled, name + 1);
+		} else {
+			g_hash_table_add(caps->enabled, g_strdup(name));
+		}
+	}
+	g_strfreev(names);
+}
+
+gboolean
+purple_ircv3_capabilities_is_enabled(PurpleIRCv3Capabilities *caps,
+                                     const gchar *name)
+{
+	g_return_val_if_fail(caps != NULL, FALSE);
+
+	return g_hash_table_contains(caps->enabled, name);
+}
+
+const gchar *
+purple_ircv3_capabilities_get_chathistory(PurpleIRCv3Capabilities *caps) {
+	g_return_val_if_fail(caps != NULL, NULL);
+
+	/* Most servers still only have the draft. */
+	if(purple_ircv3_capabilities_is_enabled(caps, "chathistory")) {
+		return "chathistory";
+	}
+
+	if(purple_ircv3_capabilities_is_enabled(caps, "draft/chathistory")) {
+		return "draft/chathistory";
+	}
+
+	return NULL;
+}
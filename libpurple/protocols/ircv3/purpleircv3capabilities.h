@@ -0,0 +1,52 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PURPLE_IRCV3_CAPABILITIES_H
+#define PURPLE_IRCV3_CAPABILITIES_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * PurpleIRCv3Capabilities:
+ *
+ * Tracks what the server offers in `CAP LS` and what it agreed to in
+ * `CAP ACK`.
+ */
+typedef struct _PurpleIRCv3Capabilities PurpleIRCv3Capabilities;
+
+G_GNUC_INTERNAL PurpleIRCv3Capabilities *purple_ircv3_capabilities_new(void);
+
+G_GNUC_INTERNAL void purple_ircv3_capabilities_free(PurpleIRCv3Capabilities *caps);
+
+G_GNUC_INTERNAL void purple_ircv3_capabilities_add_available(PurpleIRCv3Capabilities *caps, const gchar *list);
+
+G_GNUC_INTERNAL const gchar *purple_ircv3_capabilities_get_value(PurpleIRCv3Capabilities *caps, const gchar *name);
+
+G_GNUC_INTERNAL gchar *purple_ircv3_capabilities_build_request(PurpleIRCv3Capabilities *caps);
+
+G_GNUC_INTERNAL void purple_ircv3_capabilities_acknowledge(PurpleIRCv3Capabilities *caps, const gchar *list);
+
+G_GNUC_INTERNAL gboolean purple_ircv3_capabilities_is_enabled(PurpleIRCv3Capabilities *caps, const gchar *name);
+
+G_GNUC_INTERNAL const gchar *purple_ircv3_capabilities_get_chathistory(PurpleIRCv3Capabilities *caps);
+
+G_END_DECLS
+
+#endif /* PURPLE_IRCV3_CAPABILITIES_H */
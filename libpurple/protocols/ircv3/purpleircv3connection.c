@@ -0,0 +1,623 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <glib/gi18n-lib.h>
+
+#include "purpleircv3connection.h"
+
+#include "purpleircv3constants.h"
+#include "purpleircv3messagehandlers.h"
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static void
+purple_ircv3_history_free(PurpleIRCv3History *history) {
+	g_free(history->oldest);
+	g_free(history);
+}
+
+static void
+purple_ircv3_connection_write_cb(GObject *source, GAsyncResult *result,
+                                 gpointer data)
+{
+	PurpleIRCv3Connection *connection = data;
+	GError *error = NULL;
+
+	purple_queued_output_stream_push_bytes_finish(
+		PURPLE_QUEUED_OUTPUT_STREAM(source), result, &error);
+
+	if(error == NULL) {
+		return;
+	}
+
+	/* The connection has already been freed if we were cancelled. */
+	if(g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		g_error_free(error);
+		return;
+	}
+
+	purple_queued_output_stream_clear_queue(connection->output);
+
+	g_prefix_error(&error, "%s", _("Lost connection with server: "));
+	purple_connection_take_error(connection->connection, error);
+}
+
+/* The connection has usually been freed by the time the QUIT is written, so
+ * there is nobody left to tell if it failed.
+ */
+static void
+purple_ircv3_connection_quit_cb(GObject *source, GAsyncResult *result,
+                                G_GNUC_UNUSED gpointer data)
+{
+	purple_queued_output_stream_push_bytes_finish(
+		PURPLE_QUEUED_OUTPUT_STREAM(source), result, NULL);
+}
+
+/* Returns TRUE if a complete line is already sitting in the input buffer so
+ * that it can be read without going back to the main loop.
+ */
+static gboolean
+purple_ircv3_connection_has_buffered_line(PurpleIRCv3Connection *connection) {
+	GBufferedInputStream *buffered = G_BUFFERED_INPUT_STREAM(connection->input);
+	gconstpointer buffer = NULL;
+	gsize count = 0;
+
+	buffer = g_buffered_input_stream_peek_buffer(buffered, &count);
+
+	return count > 0 && memchr(buffer, '\n', count) != NULL;
+}
+
+static void
+purple_ircv3_connection_read_cb(GObject *source, GAsyncResult *result,
+                                gpointer data)
+{
+	PurpleIRCv3Connection *connection = data;
+	GDataInputStream *input = G_DATA_INPUT_STREAM(source);
+	GError *error = NULL;
+	gchar *line = NULL;
+
+	line = g_data_input_stream_read_line_finish(input, result, NULL, &error);
+
+	while(line != NULL) {
+		if(!purple_ircv3_connection_handle_line(connection, line, &error)) {
+			purple_connection_take_error(connection->connection, error);
+
+			return;
+		}
+
+		/* A burst from the server usually leaves many lines in the buffer,
+		 * so handle those now instead of going through the main loop once
+		 * per line.
+		 */
+		if(!purple_ircv3_connection_has_buffered_line(connection)) {
+			break;
+		}
+
+		line = g_data_input_stream_read_line(input, NULL,
+		                                     connection->cancellable,
+		                                     &error);
+	}
+
+	if(error != NULL) {
+		if(g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_error_free(error);
+
+			return;
+		}
+
+		g_prefix_error(&error, "%s", _("Lost connection with server: "));
+		purple_connection_take_error(connection->connection, error);
+
+		return;
+	}
+
+	if(line == NULL) {
+		purple_connection_error(connection->connection,
+		                        PURPLE_CONNECTION_ERROR_NETWORK_ERROR,
+		                        _("Server closed the connection"));
+
+		return;
+	}
+
+	g_data_input_stream_read_line_async(input, G_PRIORITY_DEFAULT,
+	                                    connection->cancellable,
+	                                    purple_ircv3_connection_read_cb,
+	                                    connection);
+}
+
+static void
+purple_ircv3_connection_register(PurpleIRCv3Connection *connection) {
+	const gchar *password = NULL;
+
+	password = purple_connection_get_password(connection->connection);
+
+	/* Send the whole registration burst in a single write. */
+	purple_queued_output_stream_cork(connection->output);
+
+	purple_ircv3_connection_writef(connection, "%s LS 302",
+	                               PURPLE_IRCV3_MSG_CAP);
+
+	if(password != NULL && *password != '\0') {
+		purple_ircv3_connection_writef(connection, "PASS %s", password);
+	}
+
+	purple_ircv3_connection_writef(connection, "%s %s", PURPLE_IRCV3_MSG_NICK,
+	                               connection->nick);
+	purple_ircv3_connection_writef(connection, "USER %s 0 * :%s",
+	                               connection->nick, connection->nick);
+
+	purple_queued_output_stream_uncork(connection->output);
+}
+
+static void
+purple_ircv3_connection_connected_cb(GObject *source, GAsyncResult *result,
+                                     gpointer data)
+{
+	PurpleIRCv3Connection *connection = data;
+	GSocketConnection *socket = NULL;
+	GIOStream *stream = NULL;
+	GError *error = NULL;
+
+	socket = g_socket_client_connect_to_host_finish(G_SOCKET_CLIENT(source),
+	                                                result, &error);
+	if(socket == NULL) {
+		if(g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_error_free(error);
+
+			return;
+		}
+
+		g_prefix_error(&error, "%s", _("Unable to connect: "));
+		purple_connection_take_error(connection->connection, error);
+
+		return;
+	}
+
+	connection->socket = socket;
+	stream = G_IO_STREAM(socket);
+
+	connection->output = purple_queued_output_stream_new(
+		g_io_stream_get_output_stream(stream));
+
+	/* Lines end in "\r\n", but some servers only send "\n", so we split on
+	 * the latter and strip the former ourselves.
+	 */
+	connection->input = g_data_input_stream_new(
+		g_io_stream_get_input_stream(stream));
+	g_data_input_stream_set_newline_type(connection->input,
+	                                     G_DATA_STREAM_NEWLINE_TYPE_LF);
+
+	purple_ircv3_connection_register(connection);
+
+	g_data_input_stream_read_line_async(connection->input, G_PRIORITY_DEFAULT,
+	                                    connection->cancellable,
+	                                    purple_ircv3_connection_read_cb,
+	                                    connection);
+}
+
+/******************************************************************************
+ * Internal API
+ *****************************************************************************/
+void
+purple_ircv3_batch_free(PurpleIRCv3Batch *batch) {
+	if(batch == NULL) {
+		return;
+	}
+
+	g_free(batch->type);
+	g_free(batch->target);
+	g_ptr_array_free(batch->messages, TRUE);
+	g_free(batch);
+}
+
+PurpleIRCv3Connection *
+purple_ircv3_connection_new(PurpleConnection *gc, GError **error) {
+	PurpleIRCv3Connection *connection = NULL;
+	PurpleAccount *account = NULL;
+	const gchar *username = NULL;
+	gchar **parts = NULL;
+	gint depth = 0;
+
+	g_return_val_if_fail(PURPLE_IS_CONNECTION(gc), NULL);
+
+	account = purple_connection_get_account(gc);
+	username = purple_account_get_username(account);
+
+	if(username == NULL || strpbrk(username, " \t\v\r\n") != NULL) {
+		g_set_error_literal(error, PURPLE_CONNECTION_ERROR,
+		                    PURPLE_CONNECTION_ERROR_INVALID_SETTINGS,
+		                    _("IRC nick and server may not contain "
+		                      "whitespace"));
+
+		return NULL;
+	}
+
+	parts = g_strsplit(username, "@", 2);
+	if(parts[0] == NULL || *parts[0] == '\0' || parts[1] == NULL ||
+	   *parts[1] == '\0')
+	{
+		g_set_error_literal(error, PURPLE_CONNECTION_ERROR,
+		                    PURPLE_CONNECTION_ERROR_INVALID_SETTINGS,
+		                    _("Username must be in the form nick@server"));
+		g_strfreev(parts);
+
+		return NULL;
+	}
+
+	connection = g_new0(PurpleIRCv3Connection, 1);
+	connection->connection = gc;
+	connection->account = account;
+	connection->nick = g_strdup(parts[0]);
+	connection->server = g_strdup(parts[1]);
+	g_strfreev(parts);
+
+	connection->port = purple_account_get_int(account, "port", 0);
+	if(connection->port == 0) {
+		if(purple_account_get_bool(account, "use-tls", TRUE)) {
+			connection->port = PURPLE_IRCV3_DEFAULT_TLS_PORT;
+		} else {
+			connection->port = PURPLE_IRCV3_DEFAULT_PLAIN_PORT;
+		}
+	}
+
+	connection->cancellable = g_cancellable_new();
+	connection->capabilities = purple_ircv3_capabilities_new();
+
+	connection->batches = g_hash_table_new_full(g_str_hash, g_str_equal,
+	                                            g_free,
+	                                            (GDestroyNotify)purple_ircv3_batch_free);
+	connection->history = g_hash_table_new_full(g_str_hash, g_str_equal,
+	                                            g_free,
+	                                            (GDestroyNotify)purple_ircv3_history_free);
+	connection->names = g_hash_table_new_full(g_str_hash, g_str_equal,
+	                                          g_free,
+	                                          (GDestroyNotify)g_ptr_array_unref);
+
+	connection->history_page_size = PURPLE_IRCV3_DEFAULT_HISTORY_PAGE_SIZE;
+	depth = purple_account_get_int(account, "history-depth",
+	                               PURPLE_IRCV3_DEFAULT_HISTORY_DEPTH);
+	connection->history_depth = MAX(depth, 0);
+
+	connection->next_chat_id = 1;
+
+	purple_connection_set_display_name(gc, connection->nick);
+
+	return connection;
+}
+
+void
+purple_ircv3_connection_free(PurpleIRCv3Connection *connection) {
+	if(connection == NULL) {
+		return;
+	}
+
+	g_cancellable_cancel(connection->cancellable);
+	g_clear_object(&connection->cancellable);
+
+	if(connection->socket != NULL) {
+		purple_gio_graceful_close(G_IO_STREAM(connection->socket),
+		                          G_INPUT_STREAM(connection->input),
+		                          G_OUTPUT_STREAM(connection->output));
+	}
+
+	g_clear_object(&connection->input);
+	g_clear_object(&connection->output);
+	g_clear_object(&connection->socket);
+
+	g_clear_pointer(&connection->capabilities,
+	                purple_ircv3_capabilities_free);
+	g_clear_pointer(&connection->batches, g_hash_table_destroy);
+	g_clear_pointer(&connection->history, g_hash_table_destroy);
+	g_clear_pointer(&connection->names, g_hash_table_destroy);
+
+	g_free(connection->server);
+	g_free(connection->nick);
+
+	g_free(connection);
+}
+
+void
+purple_ircv3_connection_connect(PurpleIRCv3Connection *connection) {
+	GSocketClient *client = NULL;
+	GError *error = NULL;
+
+	g_return_if_fail(connection != NULL);
+
+	client = purple_gio_socket_client_new(connection->account, &error);
+	if(client == NULL) {
+		purple_connection_take_error(connection->connection, error);
+
+		return;
+	}
+
+	g_socket_client_set_tls(client,
+	                        purple_account_get_bool(connection->account,
+	                                                "use-tls", TRUE));
+
+	g_socket_client_connect_to_host_async(client, connection->server,
+	                                      connection->port,
+	                                      connection->cancellable,
+	                                      purple_ircv3_connection_connected_cb,
+	                                      connection);
+
+	g_object_unref(client);
+}
+
+void
+purple_ircv3_connection_close(PurpleIRCv3Connection *connection) {
+	GBytes *bytes = NULL;
+	gchar *quit = NULL;
+
+	g_return_if_fail(connection != NULL);
+
+	if(connection->output == NULL) {
+		return;
+	}
+
+	/* This is followed by purple_ircv3_connection_free(), which cancels
+	 * everything that uses our cancellable, so the QUIT doesn't get one.
+	 * The graceful close there waits for it to be written.
+	 */
+	quit = g_strdup_printf("%s :%s\r\n", PURPLE_IRCV3_MSG_QUIT, _("Leaving"));
+	bytes = g_bytes_new_take(quit, strlen(quit));
+	purple_queued_output_stream_push_bytes_async(connection->output, bytes,
+	                                             G_PRIORITY_DEFAULT, NULL,
+	                                             purple_ircv3_connection_quit_cb,
+	                                             NULL);
+	g_bytes_unref(bytes);
+}
+
+void
+purple_ircv3_connection_writef(PurpleIRCv3Connection *connection,
+                               const gchar *format, ...)
+{
+	GBytes *bytes = NULL;
+	GString *message = NULL;
+	va_list vargs;
+
+	g_return_if_fail(connection != NULL);
+	g_return_if_fail(format != NULL);
+
+	if(connection->output == NULL) {
+		return;
+	}
+
+	message = g_string_new(NULL);
+
+	va_start(vargs, format);
+	g_string_append_vprintf(message, format, vargs);
+	va_end(vargs);
+
+	g_string_append(message, "\r\n");
+
+	bytes = g_string_free_to_bytes(message);
+	purple_queued_output_stream_push_bytes_async(connection->output, bytes,
+	                                             G_PRIORITY_DEFAULT,
+	                                             connection->cancellable,
+	                                             purple_ircv3_connection_write_cb,
+	                                             connection);
+	g_bytes_unref(bytes);
+}
+
+void
+purple_ircv3_connection_send_privmsg(PurpleIRCv3Connection *connection,
+                                     const gchar *target,
+                                     const gchar *contents)
+{
+	gchar *plain = NULL;
+	gchar **lines = NULL;
+
+	g_return_if_fail(connection != NULL);
+	g_return_if_fail(target != NULL);
+	g_return_if_fail(contents != NULL);
+
+	if(connection->output == NULL) {
+		return;
+	}
+
+	purple_markup_html_to_xhtml(contents, NULL, &plain);
+	lines = g_strsplit(plain, "\n", -1);
+
+	/* Each line is a separate message on IRC, but they still all go out in a
+	 * single write.
+	 */
+	purple_queued_output_stream_cork(connection->output);
+
+	for(gint i = 0; lines[i] != NULL; i++) {
+		g_strchomp(lines[i]);
+
+		if(*lines[i] == '\0') {
+			continue;
+		}
+
+		purple_ircv3_connection_writef(connection, "%s %s :%s",
+		                               PURPLE_IRCV3_MSG_PRIVMSG, target,
+		                               lines[i]);
+	}
+
+	purple_queued_output_stream_uncork(connection->output);
+
+	g_strfreev(lines);
+	g_free(plain);
+}
+
+gboolean
+purple_ircv3_connection_handle_line(PurpleIRCv3Connection *connection,
+                                    gchar *line, GError **error)
+{
+	PurpleIRCv3Message *message = NULL;
+	PurpleIRCv3Batch *batch = NULL;
+	GError *local_error = NULL;
+	const gchar *ref = NULL;
+	gsize length = 0;
+	gboolean ret = TRUE;
+
+	g_return_val_if_fail(connection != NULL, FALSE);
+	g_return_val_if_fail(line != NULL, FALSE);
+
+	connection->lines_received++;
+
+	length = strlen(line);
+	if(length > 0 && line[length - 1] == '\r') {
+		line[length - 1] = '\0';
+	}
+
+	if(*line == '\0') {
+		g_free(line);
+
+		return TRUE;
+	}
+
+	message = purple_ircv3_message_parse(line, &local_error);
+	if(message == NULL) {
+		/* A single bad line from the server isn't worth disconnecting over. */
+		purple_debug_warning("ircv3", "failed to parse message: %s",
+		                     local_error != NULL ? local_error->message
+		                                         : "unknown error");
+		g_clear_error(&local_error);
+
+		return TRUE;
+	}
+
+	/* Messages belonging to an open batch are held until the batch ends so
+	 * they can be applied all at once.
+	 */
+	ref = purple_ircv3_message_get_tag(message, "batch");
+	if(ref != NULL) {
+		batch = g_hash_table_lookup(connection->batches, ref);
+		if(batch != NULL) {
+			g_ptr_array_add(batch->messages, message);
+
+			return TRUE;
+		}
+	}
+
+	ret = purple_ircv3_connection_dispatch(connection, message, error);
+
+	purple_ircv3_message_free(message);
+
+	return ret;
+}
+
+gboolean
+purple_ircv3_connection_dispatch(PurpleIRCv3Connection *connection,
+                                 PurpleIRCv3Message *message, GError **error)
+{
+	PurpleIRCv3MessageHandler handler = NULL;
+	const gchar *command = NULL;
+
+	g_return_val_if_fail(connection != NULL, FALSE);
+	g_return_val_if_fail(message != NULL, FALSE);
+
+	command = purple_ircv3_message_get_command(message);
+	handler = purple_ircv3_message_handlers_find(command);
+
+	if(handler == NULL) {
+		return TRUE;
+	}
+
+	return handler(connection, message, error);
+}
+
+gboolean
+purple_ircv3_connection_is_channel(PurpleIRCv3Connection *connection,
+                                   const gchar *target)
+{
+	g_return_val_if_fail(connection != NULL, FALSE);
+
+	if(target == NULL || *target == '\0') {
+		return FALSE;
+	}
+
+	return strchr("#&+!", *target) != NULL;
+}
+
+PurpleChatConversation *
+purple_ircv3_connection_find_chat(PurpleIRCv3Connection *connection,
+                                  const gchar *channel)
+{
+	PurpleConversationManager *manager = NULL;
+	PurpleConversation *conversation = NULL;
+
+	g_return_val_if_fail(connection != NULL, NULL);
+
+	manager = purple_conversation_manager_get_default();
+	conversation = purple_conversation_manager_find_chat(manager,
+	                                                     connection->account,
+	                                                     channel);
+
+	if(!PURPLE_IS_CHAT_CONVERSATION(conversation)) {
+		return NULL;
+	}
+
+	return PURPLE_CHAT_CONVERSATION(conversation);
+}
+
+void
+purple_ircv3_connection_request_history(PurpleIRCv3Connection *connection,
+                                        const gchar *channel)
+{
+	PurpleIRCv3History *history = NULL;
+	const gchar *cap = NULL;
+	guint limit = 0;
+
+	g_return_if_fail(connection != NULL);
+	g_return_if_fail(channel != NULL);
+
+	cap = purple_ircv3_capabilities_get_chathistory(connection->capabilities);
+	if(cap == NULL) {
+		return;
+	}
+
+	history = g_hash_table_lookup(connection->history, channel);
+	if(history == NULL) {
+		history = g_new0(PurpleIRCv3History, 1);
+		g_hash_table_insert(connection->history, g_strdup(channel), history);
+	}
+
+	if(history->pending || history->exhausted ||
+	   history->fetched >= connection->history_depth)
+	{
+		return;
+	}
+
+	limit = MIN(connection->history_page_size,
+	            connection->history_depth - history->fetched);
+
+	history->requested = limit;
+	history->pending = TRUE;
+
+	if(history->oldest == NULL) {
+		purple_ircv3_connection_writef(connection, "CHATHISTORY LATEST %s * %u",
+		                               channel, limit);
+	} else {
+		purple_ircv3_connection_writef(connection,
+		                               "CHATHISTORY BEFORE %s timestamp=%s %u",
+		                               channel, history->oldest, limit);
+	}
+}
+
+guint64
+purple_ircv3_connection_get_lines_received(PurpleIRCv3Connection *connection) {
+	g_return_val_if_fail(connection != NULL, 0);
+
+	return connection->lines_received;
+}
@@ -0,0 +1,121 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PURPLE_IRCV3_CONNECTION_H
+#define PURPLE_IRCV3_CONNECTION_H
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <purple.h>
+
+#include "purpleircv3capabilities.h"
+#include "purpleircv3message.h"
+
+G_BEGIN_DECLS
+
+typedef struct _PurpleIRCv3Connection PurpleIRCv3Connection;
+
+/**
+ * PurpleIRCv3MessageHandler:
+ * @connection: The connection the message arrived on.
+ * @message: The message.
+ * @error: Return address for a #GError.
+ *
+ * Handles a single message from the server.  Returning %FALSE with @error set
+ * disconnects.
+ */
+typedef gboolean (*PurpleIRCv3MessageHandler)(PurpleIRCv3Connection *connection, PurpleIRCv3Message *message, GError **error);
+
+/* Messages that arrived tagged with a batch that's still open. */
+typedef struct {
+	gchar *type;
+	gchar *target;
+	GPtrArray *messages;
+} PurpleIRCv3Batch;
+
+/* How far back we've fetched a channel's history. */
+typedef struct {
+	gchar *oldest;
+	guint fetched;
+	guint requested;
+	gboolean pending;
+	gboolean exhausted;
+} PurpleIRCv3History;
+
+struct _PurpleIRCv3Connection {
+	PurpleConnection *connection;
+	PurpleAccount *account;
+
+	gchar *server;
+	guint16 port;
+	gchar *nick;
+
+	GCancellable *cancellable;
+	GSocketConnection *socket;
+	GDataInputStream *input;
+	PurpleQueuedOutputStream *output;
+
+	PurpleIRCv3Capabilities *capabilities;
+	gboolean registered;
+
+	/* ref -> PurpleIRCv3Batch */
+	GHashTable *batches;
+
+	/* channel -> PurpleIRCv3History */
+	GHashTable *history;
+	guint history_page_size;
+	guint history_depth;
+
+	/* channel -> GPtrArray of nicks from RPL_NAMREPLY until RPL_ENDOFNAMES */
+	GHashTable *names;
+
+	gint next_chat_id;
+
+	guint64 lines_received;
+};
+
+G_GNUC_INTERNAL void purple_ircv3_batch_free(PurpleIRCv3Batch *batch);
+
+G_GNUC_INTERNAL PurpleIRCv3Connection *purple_ircv3_connection_new(PurpleConnection *connection, GError **error);
+
+G_GNUC_INTERNAL void purple_ircv3_connection_free(PurpleIRCv3Connection *connection);
+
+G_GNUC_INTERNAL void purple_ircv3_connection_connect(PurpleIRCv3Connection *connection);
+
+G_GNUC_INTERNAL void purple_ircv3_connection_close(PurpleIRCv3Connection *connection);
+
+G_GNUC_INTERNAL void purple_ircv3_connection_writef(PurpleIRCv3Connection *connection, const gchar *format, ...) G_GNUC_PRINTF(2, 3);
+
+G_GNUC_INTERNAL void purple_ircv3_connection_send_privmsg(PurpleIRCv3Connection *connection, const gchar *target, const gchar *contents);
+
+G_GNUC_INTERNAL gboolean purple_ircv3_connection_handle_line(PurpleIRCv3Connection *connection, gchar *line, GError **error);
+
+G_GNUC_INTERNAL gboolean purple_ircv3_connection_dispatch(PurpleIRCv3Connection *connection, PurpleIRCv3Message *message, GError **error);
+
+G_GNUC_INTERNAL gboolean purple_ircv3_connection_is_channel(PurpleIRCv3Connection *connection, const gchar *target);
+
+G_GNUC_INTERNAL PurpleChatConversation *purple_ircv3_connection_find_chat(PurpleIRCv3Connection *connection, const gchar *channel);
+
+G_GNUC_INTERNAL void purple_ircv3_connection_request_history(PurpleIRCv3Connection *connection, const gchar *channel);
+
+G_GNUC_INTERNAL guint64 purple_ircv3_connection_get_lines_received(PurpleIRCv3Connection *connection);
+
+G_END_DECLS
+
+#endif /* PURPLE_IRCV3_CONNECTION_H */
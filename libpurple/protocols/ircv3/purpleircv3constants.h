@@ -0,0 +1,59 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PURPLE_IRCV3_CONSTANTS_H
+#define PURPLE_IRCV3_CONSTANTS_H
+
+#include <glib.h>
+
+#define PURPLE_IRCV3_DOMAIN (g_quark_from_static_string("ircv3-plugin"))
+
+#define PURPLE_IRCV3_DEFAULT_TLS_PORT (6697)
+#define PURPLE_IRCV3_DEFAULT_PLAIN_PORT (6667)
+
+/* The number of messages we ask for per CHATHISTORY request, unless the
+ * server advertises a smaller limit, and how many of them we'll fetch for a
+ * channel in total.
+ */
+#define PURPLE_IRCV3_DEFAULT_HISTORY_PAGE_SIZE (100)
+#define PURPLE_IRCV3_DEFAULT_HISTORY_DEPTH (500)
+
+/* RFC 1459 allows at most 15 parameters, the last of which may contain
+ * spaces.
+ */
+#define PURPLE_IRCV3_MAX_PARAMS (15)
+
+#define PURPLE_IRCV3_MSG_BATCH "BATCH"
+#define PURPLE_IRCV3_MSG_CAP "CAP"
+#define PURPLE_IRCV3_MSG_JOIN "JOIN"
+#define PURPLE_IRCV3_MSG_NICK "NICK"
+#define PURPLE_IRCV3_MSG_NOTICE "NOTICE"
+#define PURPLE_IRCV3_MSG_PART "PART"
+#define PURPLE_IRCV3_MSG_PING "PING"
+#define PURPLE_IRCV3_MSG_PRIVMSG "PRIVMSG"
+#define PURPLE_IRCV3_MSG_QUIT "QUIT"
+#define PURPLE_IRCV3_MSG_TOPIC "TOPIC"
+
+#define PURPLE_IRCV3_RPL_WELCOME "001"
+#define PURPLE_IRCV3_RPL_ISUPPORT "005"
+#define PURPLE_IRCV3_RPL_TOPIC "332"
+#define PURPLE_IRCV3_RPL_NAMREPLY "353"
+#define PURPLE_IRCV3_RPL_ENDOFNAMES "366"
+#define PURPLE_IRCV3_ERR_NICKNAMEINUSE "433"
+
+#endif /* PURPLE_IRCV3_CONSTANTS_H */
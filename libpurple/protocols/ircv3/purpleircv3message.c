@@ -0,0 +1,346 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "purpleircv3message.h"
+
+#include "purpleircv3constants.h"
+
+typedef struct {
+	gchar *key;
+	gchar *value;
+	gboolean escaped;
+} PurpleIRCv3MessageTag;
+
+struct _PurpleIRCv3Message {
+	gchar *line;
+
+	gchar *nick;
+	gchar *user;
+	gchar *host;
+	gchar *command;
+
+	gchar *params[PURPLE_IRCV3_MAX_PARAMS];
+	guint n_params;
+
+	/* Allocated together with the message. */
+	guint n_tags;
+	PurpleIRCv3MessageTag tags[];
+};
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static inline gchar *
+purple_ircv3_message_skip_spaces(gchar *p) {
+	while(*p == ' ') {
+		p++;
+	}
+
+	return p;
+}
+
+/* Terminates the token starting at @p and returns the start of the next one,
+ * or the end of the string.
+ */
+static inline gchar *
+purple_ircv3_message_split(gchar *p) {
+	gchar *space = strchr(p, ' ');
+
+	if(space == NULL) {
+		return p + strlen(p);
+	}
+
+	*space = '\0';
+
+	return purple_ircv3_message_skip_spaces(space + 1);
+}
+
+static void
+purple_ircv3_message_parse_tags(PurpleIRCv3Message *message, gchar *tags) {
+	while(tags != NULL && *tags != '\0') {
+		PurpleIRCv3MessageTag *tag = &message->tags[message->n_tags];
+		gchar *next = strchr(tags, ';');
+		gchar *equals = NULL;
+
+		if(next != NULL) {
+			*next++ = '\0';
+		}
+
+		/* Empty tags, like the one in "a;;b", are ignored. */
+		if(*tags != '\0') {
+			tag->key = tags;
+			tag->value = "";
+			tag->escaped = FALSE;
+
+			equals = strchr(tags, '=');
+			if(equals != NULL) {
+				*equals = '\0';
+				tag->value = equals + 1;
+				tag->escaped = (strchr(tag->value, '\\') != NULL);
+			}
+
+			message->n_tags++;
+		}
+
+		tags = next;
+	}
+}
+
+static void
+purple_ircv3_message_parse_source(PurpleIRCv3Message *message, gchar *source) {
+	gchar *p = NULL;
+
+	message->nick = source;
+
+	p = strchr(source, '@');
+	if(p != NULL) {
+		*p = '\0';
+		message->host = p + 1;
+	}
+
+	p = strchr(source, '!');
+	if(p != NULL) {
+		*p = '\0';
+		message->user = p + 1;
+	}
+}
+
+/* Tag values escape ';', ' ', '\', CR and LF.  Unescaping never makes the
+ * value longer, so it can be done in place.
+ */
+static void
+purple_ircv3_message_unescape(gchar *value) {
+	gchar *in = value, *out = value;
+
+	while(*in != '\0') {
+		if(*in != '\\') {
+			*out++ = *in++;
+			continue;
+		}
+
+		in++;
+		switch(*in) {
+			case ':':
+				*out++ = ';';
+				break;
+			case 's':
+				*out++ = ' ';
+				break;
+			case 'r':
+				*out++ = '\r';
+				break;
+			case 'n':
+				*out++ = '\n';
+				break;
+			case '\0':
+				/* A trailing backslash is dropped. */
+				*out = '\0';
+				return;
+			default:
+				*out++ = *in;
+				break;
+		}
+		in++;
+	}
+
+	*out = '\0';
+}
+
+/******************************************************************************
+ * Internal API
+ *****************************************************************************/
+PurpleIRCv3Message *
+purple_ircv3_message_parse(gchar *line, GError **error) {
+	PurpleIRCv3Message *message = NULL;
+	gchar *p = line, *tags = NULL, *source = NULL;
+	guint n_tags = 0;
+	gsize len = 0;
+
+	g_return_val_if_fail(line != NULL, NULL);
+
+	/* Strip the line ending if the caller left it on. */
+	len = strlen(line);
+	while(len > 0 && (line[len - 1] == '\r' || line[len - 1] == '\n')) {
+		line[--len] = '\0';
+	}
+
+	if(*p == '@') {
+		tags = p + 1;
+		p = purple_ircv3_message_split(tags);
+
+		/* Each ';' may separate another tag. */
+		n_tags = 1;
+		for(gchar *c = tags; *c != '\0'; c++) {
+			if(*c == ';') {
+				n_tags++;
+			}
+		}
+	}
+
+	p = purple_ircv3_message_skip_spaces(p);
+	if(*p == ':') {
+		source = p + 1;
+		p = purple_ircv3_message_split(source);
+	}
+
+	if(*p == '\0') {
+		g_set_error(error, PURPLE_IRCV3_DOMAIN, 0,
+		            "message has no command: '%s'", line);
+		g_free(line);
+
+		return NULL;
+	}
+
+	message = g_malloc0(sizeof(PurpleIRCv3Message) +
+	                    n_tags * sizeof(PurpleIRCv3MessageTag));
+	message->line = line;
+
+	purple_ircv3_message_parse_tags(message, tags);
+	if(source != NULL) {
+		purple_ircv3_message_parse_source(message, source);
+	}
+
+	message->command = p;
+	p = purple_ircv3_message_split(p);
+
+	while(*p != '\0') {
+		/* The trailing parameter, or the last one we have room for, takes
+		 * the rest of the line.
+		 */
+		if(*p == ':') {
+			message->params[message->n_params++] = p + 1;
+			break;
+		}
+
+		if(message->n_params == PURPLE_IRCV3_MAX_PARAMS - 1) {
+			message->params[message->n_params++] = p;
+			break;
+		}
+
+		message->params[message->n_params++] = p;
+		p = purple_ircv3_message_split(p);
+	}
+
+	return message;
+}
+
+void
+purple_ircv3_message_free(PurpleIRCv3Message *message) {
+	if(message == NULL) {
+		return;
+	}
+
+	g_free(message->line);
+	g_free(message);
+}
+
+const gchar *
+purple_ircv3_message_get_command(PurpleIRCv3Message *message) {
+	g_return_val_if_fail(message != NULL, NULL);
+
+	return message->command;
+}
+
+const gchar *
+purple_ircv3_message_get_nick(PurpleIRCv3Message *message) {
+	g_return_val_if_fail(message != NULL, NULL);
+
+	return message->nick;
+}
+
+const gchar *
+purple_ircv3_message_get_user(PurpleIRCv3Message *message) {
+	g_return_val_if_fail(message != NULL, NULL);
+
+	return message->user;
+}
+
+const gchar *
+purple_ircv3_message_get_host(PurpleIRCv3Message *message) {
+	g_return_val_if_fail(message != NULL, NULL);
+
+	return message->host;
+}
+
+guint
+purple_ircv3_message_get_n_params(PurpleIRCv3Message *message) {
+	g_return_val_if_fail(message != NULL, 0);
+
+	return message->n_params;
+}
+
+const gchar *
+purple_ircv3_message_get_param(PurpleIRCv3Message *message, guint n) {
+	g_return_val_if_fail(message != NULL, NULL);
+
+	if(n >= message->n_params) {
+		return NULL;
+	}
+
+	return message->params[n];
+}
+
+guint
+purple_ircv3_message_get_n_tags(PurpleIRCv3Message *message) {
+	g_return_val_if_fail(message != NULL, 0);
+
+	return message->n_tags;
+}
+
+const gchar *
+purple_ircv3_message_get_tag(PurpleIRCv3Message *message, const gchar *key) {
+	g_return_val_if_fail(message != NULL, NULL);
+	g_return_val_if_fail(key != NULL, NULL);
+
+	/* Messages rarely have more than a handful of tags, so a linear search
+	 * beats building a table for every line.  If a key is repeated the last
+	 * one wins.
+	 */
+	for(guint i = message->n_tags; i > 0; i--) {
+		PurpleIRCv3MessageTag *tag = &message->tags[i - 1];
+
+		if(strcmp(tag->key, key) != 0) {
+			continue;
+		}
+
+		if(tag->escaped) {
+			purple_ircv3_message_unescape(tag->value);
+			tag->escaped = FALSE;
+		}
+
+		return tag->value;
+	}
+
+	return NULL;
+}
+
+GDateTime *
+purple_ircv3_message_get_server_time(PurpleIRCv3Message *message) {
+	const gchar *time = NULL;
+
+	g_return_val_if_fail(message != NULL, NULL);
+
+	time = purple_ircv3_message_get_tag(message, "time");
+	if(time == NULL || *time == '\0') {
+		return NULL;
+	}
+
+	return g_date_time_new_from_iso8601(time, NULL);
+}
@@ -0,0 +1,64 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PURPLE_IRCV3_MESSAGE_H
+#define PURPLE_IRCV3_MESSAGE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * PurpleIRCv3Message:
+ *
+ * A single parsed line from the server.
+ *
+ * Parsing happens in place: the message takes ownership of the line it was
+ * given and all of the strings it hands out point into it, so a message costs
+ * one allocation on top of the line no matter how many tags or parameters it
+ * has.  Tag values are unescaped the first time they are looked up.
+ */
+typedef struct _PurpleIRCv3Message PurpleIRCv3Message;
+
+G_GNUC_INTERNAL PurpleIRCv3Message *purple_ircv3_message_parse(gchar *line, GError **error);
+
+G_GNUC_INTERNAL void purple_ircv3_message_free(PurpleIRCv3Message *message);
+
+G_GNUC_INTERNAL const gchar *purple_ircv3_message_get_command(PurpleIRCv3Message *message);
+
+G_GNUC_INTERNAL const gchar *purple_ircv3_message_get_nick(PurpleIRCv3Message *message);
+
+G_GNUC_INTERNAL const gchar *purple_ircv3_message_get_user(PurpleIRCv3Message *message);
+
+G_GNUC_INTERNAL const gchar *purple_ircv3_message_get_host(PurpleIRCv3Message *message);
+
+G_GNUC_INTERNAL guint purple_ircv3_message_get_n_params(PurpleIRCv3Message *message);
+
+G_GNUC_INTERNAL const gchar *purple_ircv3_message_get_param(PurpleIRCv3Message *message, guint n);
+
+G_GNUC_INTERNAL guint purple_ircv3_message_get_n_tags(PurpleIRCv3Message *message);
+
+G_GNUC_INTERNAL const gchar *purple_ircv3_message_get_tag(PurpleIRCv3Message *message, const gchar *key);
+
+G_GNUC_INTERNAL GDateTime *purple_ircv3_message_get_server_time(PurpleIRCv3Message *message);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(PurpleIRCv3Message, purple_ircv3_message_free)
+
+G_END_DECLS
+
+#endif /* PURPLE_IRCV3_MESSAGE_H */
@@ -0,0 +1,957 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib/gi18n-lib.h>
+
+#include "purpleircv3messagehandlers.h"
+
+#include "purpleircv3constants.h"
+
+typedef struct {
+	const gchar *command;
+	PurpleIRCv3MessageHandler handler;
+} PurpleIRCv3MessageHandlerEntry;
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static gboolean
+purple_ircv3_message_handlers_is_own_nick(PurpleIRCv3Connection *connection,
+                                          const gchar *nick)
+{
+	return nick != NULL && g_ascii_strcasecmp(nick, connection->nick) == 0;
+}
+
+static const gchar *
+purple_ircv3_message_handlers_get_last_param(PurpleIRCv3Message *message) {
+	guint n_params = purple_ircv3_message_get_n_params(message);
+
+	if(n_params == 0) {
+		return NULL;
+	}
+
+	return purple_ircv3_message_get_param(message, n_params - 1);
+}
+
+static gint64
+purple_ircv3_message_handlers_get_timestamp(PurpleIRCv3Message *message) {
+	GDateTime *server_time = NULL;
+	gint64 timestamp = 0;
+
+	server_time = purple_ircv3_message_get_server_time(message);
+	if(server_time == NULL) {
+		return g_get_real_time() / G_USEC_PER_SEC;
+	}
+
+	timestamp = g_date_time_to_unix(server_time);
+	g_date_time_unref(server_time);
+
+	return timestamp;
+}
+
+/* Returns all of the chats on this connection.  Free the list with
+ * g_list_free().
+ */
+static GList *
+purple_ircv3_message_handlers_get_chats(PurpleIRCv3Connection *connection) {
+	PurpleConversationManager *manager = NULL;
+	GList *all = NULL, *l = NULL, *chats = NULL;
+
+	manager = purple_conversation_manager_get_default();
+	all = purple_conversation_manager_get_all(manager);
+
+	for(l = all; l != NULL; l = l->next) {
+		PurpleConversation *conversation = l->data;
+
+		if(!PURPLE_IS_CHAT_CONVERSATION(conversation)) {
+			continue;
+		}
+
+		if(purple_conversation_get_account(conversation) != connection->account) {
+			continue;
+		}
+
+		chats = g_list_prepend(chats, conversation);
+	}
+
+	g_list_free(all);
+
+	return chats;
+}
+
+static PurpleChatUserFlags
+purple_ircv3_message_handlers_parse_prefix(const gchar **nick) {
+	PurpleChatUserFlags flags = PURPLE_CHAT_USER_NONE;
+
+	for(;; (*nick)++) {
+		switch(**nick) {
+			case '~':
+				flags |= PURPLE_CHAT_USER_FOUNDER;
+				break;
+			case '&':
+			case '@':
+				flags |= PURPLE_CHAT_USER_OP;
+				break;
+			case '%':
+				flags |= PURPLE_CHAT_USER_HALFOP;
+				break;
+			case '+':
+				flags |= PURPLE_CHAT_USER_VOICE;
+				break;
+			default:
+				return flags;
+		}
+	}
+}
+
+/******************************************************************************
+ * Batches
+ *****************************************************************************/
+static void
+purple_ircv3_message_handlers_netsplit(PurpleIRCv3Connection *connection,
+                                       PurpleIRCv3Batch *batch)
+{
+	GList *chats = NULL, *l = NULL;
+	const gchar *reason = NULL;
+
+	chats = purple_ircv3_message_handlers_get_chats(connection);
+
+	/* Remove everyone that split from each chat in one go rather than
+	 * updating the user list once per QUIT.
+	 */
+	for(l = chats; l != NULL; l = l->next) {
+		PurpleChatConversation *chat = l->data;
+		GList *users = NULL;
+
+		for(guint i = 0; i < batch->messages->len; i++) {
+			PurpleIRCv3Message *message = g_ptr_array_index(batch->messages, i);
+			const gchar *nick = purple_ircv3_message_get_nick(message);
+
+			if(!purple_strequal(purple_ircv3_message_get_command(message),
+			                    PURPLE_IRCV3_MSG_QUIT))
+			{
+				continue;
+			}
+
+			if(reason == NULL) {
+				reason = purple_ircv3_message_get_param(message, 0);
+			}
+
+			if(nick != NULL && purple_chat_conversation_has_user(chat, nick)) {
+				users = g_list_prepend(users, (gpointer)nick);
+			}
+		}
+
+		if(users != NULL) {
+			users = g_list_reverse(users);
+			purple_chat_conversation_remove_users(chat, users, reason);
+			g_list_free(users);
+		}
+	}
+
+	g_list_free(chats);
+}
+
+static void
+purple_ircv3_message_handlers_netjoin(PurpleIRCv3Connection *connection,
+                                      PurpleIRCv3Batch *batch)
+{
+	GHashTable *joins = NULL;
+	GHashTableIter iter;
+	gpointer key, value;
+
+	/* channel -> GList of nicks, both of which point into the batch's
+	 * messages.
+	 */
+	joins = g_hash_table_new(g_str_hash, g_str_equal);
+
+	for(guint i = 0; i < batch->messages->len; i++) {
+		PurpleIRCv3Message *message = g_ptr_array_index(batch->messages, i);
+		const gchar *channel = NULL, *nick = NULL;
+		GList *users = NULL;
+
+		if(!purple_strequal(purple_ircv3_message_get_command(message),
+		                    PURPLE_IRCV3_MSG_JOIN))
+		{
+			continue;
+		}
+
+		channel = purple_ircv3_message_get_param(message, 0);
+		nick = purple_ircv3_message_get_nick(message);
+		if(channel == NULL || nick == NULL) {
+			continue;
+		}
+
+		users = g_hash_table_lookup(joins, channel);
+		users = g_list_prepend(users, (gpointer)nick);
+		g_hash_table_insert(joins, (gpointer)channel, users);
+	}
+
+	g_hash_table_iter_init(&iter, joins);
+	while(g_hash_table_iter_next(&iter, &key, &value)) {
+		PurpleChatConversation *chat = NULL;
+		GList *users = g_list_reverse(value), *flags = NULL;
+
+		chat = purple_ircv3_connection_find_chat(connection, key);
+		if(chat != NULL) {
+			for(GList *l = users; l != NULL; l = l->next) {
+				flags = g_list_prepend(flags,
+				                       GINT_TO_POINTER(PURPLE_CHAT_USER_NONE));
+			}
+
+			purple_chat_conversation_add_users(chat, users, NULL, flags,
+			                                   TRUE);
+			g_list_free(flags);
+		}
+
+		g_list_free(users);
+	}
+
+	g_hash_table_destroy(joins);
+}
+
+/* Writes a page of CHATHISTORY playback straight into the history manager
+ * and asks for the next page if there's more to fetch.
+ */
+static void
+purple_ircv3_message_handlers_chathistory(PurpleIRCv3Connection *connection,
+                                          PurpleIRCv3Batch *batch)
+{
+	PurpleHistoryManager *manager = NULL;
+	PurpleConversation *conversation = NULL;
+	PurpleIRCv3History *history = NULL;
+	const gchar *oldest = NULL;
+	guint count = 0;
+
+	if(batch->target == NULL) {
+		return;
+	}
+
+	manager = purple_history_manager_get_default();
+
+	if(purple_ircv3_connection_is_channel(connection, batch->target)) {
+		conversation = PURPLE_CONVERSATION(
+			purple_ircv3_connection_find_chat(connection, batch->target));
+	} else {
+		PurpleConversationManager *conversations = NULL;
+
+		conversations = purple_conversation_manager_get_default();
+		conversation = purple_conversation_manager_find_im(conversations,
+		                                                   connection->account,
+		                                                   batch->target);
+	}
+
+	for(guint i = 0; i < batch->messages->len; i++) {
+		PurpleIRCv3Message *message = g_ptr_array_index(batch->messages, i);
+		PurpleMessage *msg = NULL;
+		PurpleMessageFlags flags = PURPLE_MESSAGE_DELAYED;
+		const gchar *command = NULL, *nick = NULL, *text = NULL;
+		gchar *contents = NULL;
+		GError *error = NULL;
+
+		command = purple_ircv3_message_get_command(message);
+		if(purple_strequal(command, PURPLE_IRCV3_MSG_NOTICE)) {
+			flags |= PURPLE_MESSAGE_NOTIFY;
+		} else if(!purple_strequal(command, PURPLE_IRCV3_MSG_PRIVMSG)) {
+			continue;
+		}
+
+		/* Playback is oldest first, so the first timestamp we see is where
+		 * the next page has to start from.
+		 */
+		if(oldest == NULL) {
+			oldest = purple_ircv3_message_get_tag(message, "time");
+		}
+
+		count++;
+
+		nick = purple_ircv3_message_get_nick(message);
+		text = purple_ircv3_message_get_param(message, 1);
+		if(conversation == NULL || nick == NULL || text == NULL) {
+			continue;
+		}
+
+		contents = purple_ircv3_message_handlers_format_text(text);
+		if(contents == NULL) {
+			continue;
+		}
+
+		if(purple_ircv3_message_handlers_is_own_nick(connection, nick)) {
+			flags |= PURPLE_MESSAGE_SEND;
+		} else {
+			flags |= PURPLE_MESSAGE_RECV;
+		}
+
+		msg = purple_message_new_incoming(nick, contents, flags,
+		                                  purple_ircv3_message_handlers_get_timestamp(message));
+		g_free(contents);
+
+		if(!purple_history_manager_write(manager, conversation, msg, &error)) {
+			purple_debug_warning("ircv3", "failed to write history for %s: %s",
+			                     batch->target,
+			                     error != NULL ? error->message
+			                                   : "unknown error");
+			g_clear_error(&error);
+		}
+
+		g_object_unref(msg);
+	}
+
+	history = g_hash_table_lookup(connection->history, batch->target);
+	if(history == NULL) {
+		return;
+	}
+
+	history->pending = FALSE;
+	history->fetched += count;
+
+	if(oldest != NULL) {
+		g_free(history->oldest);
+		history->oldest = g_strdup(oldest);
+	}
+
+	/* A short page means the server has nothing older. */
+	if(count < history->requested || oldest == NULL) {
+		history->exhausted = TRUE;
+
+		return;
+	}
+
+	purple_ircv3_connection_request_history(connection, batch->target);
+}
+
+static gboolean
+purple_ircv3_message_handlers_process_batch(PurpleIRCv3Connection *connection,
+                                            PurpleIRCv3Batch *batch,
+                                            GError **error)
+{
+	if(purple_strequal(batch->type, "netsplit")) {
+		purple_ircv3_message_handlers_netsplit(connection, batch);
+	} else if(purple_strequal(batch->type, "netjoin")) {
+		purple_ircv3_message_handlers_netjoin(connection, batch);
+	} else if(purple_strequal(batch->type, "chathistory") ||
+	          purple_strequal(batch->type, "draft/chathistory"))
+	{
+		purple_ircv3_message_handlers_chathistory(connection, batch);
+	} else {
+		/* We don't know anything special about this batch, so just handle
+		 * its messages in order.
+		 */
+		for(guint i = 0; i < batch->messages->len; i++) {
+			PurpleIRCv3Message *message = NULL;
+
+			message = g_ptr_array_index(batch->messages, i);
+			if(!purple_ircv3_connection_dispatch(connection, message, error)) {
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+/******************************************************************************
+ * Handlers
+ *****************************************************************************/
+static gboolean
+purple_ircv3_message_handler_welcome(PurpleIRCv3Connection *connection,
+                                     PurpleIRCv3Message *message,
+                                     G_GNUC_UNUSED GError **error)
+{
+	const gchar *nick = purple_ircv3_message_get_param(message, 0);
+
+	if(nick != NULL && *nick != '\0') {
+		g_free(connection->nick);
+		connection->nick = g_strdup(nick);
+		purple_connection_set_display_name(connection->connection, nick);
+	}
+
+	connection->registered = TRUE;
+
+	purple_connection_set_state(connection->connection,
+	                            PURPLE_CONNECTION_CONNECTED);
+
+	return TRUE;
+}
+
+static gboolean
+purple_ircv3_message_handler_isupport(PurpleIRCv3Connection *connection,
+                                      PurpleIRCv3Message *message,
+                                      G_GNUC_UNUSED GError **error)
+{
+	guint n_params = purple_ircv3_message_get_n_params(message);
+
+	/* The first parameter is our nick and the last is "are supported by this
+	 * server".
+	 */
+	for(guint i = 1; i + 1 < n_params; i++) {
+		const gchar *token = purple_ircv3_message_get_param(message, i);
+
+		if(g_str_has_prefix(token, "CHATHISTORY=")) {
+			gint64 limit = g_ascii_strtoll(token + 12, NULL, 10);
+
+			if(limit > 0 && limit < (gint64)connection->history_page_size) {
+				connection->history_page_size = limit;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+static gboolean
+purple_ircv3_message_handler_topic(PurpleIRCv3Connection *connection,
+                                   PurpleIRCv3Message *message,
+                                   G_GNUC_UNUSED GError **error)
+{
+	PurpleChatConversation *chat = NULL;
+	const gchar *command = NULL, *channel = NULL, *topic = NULL;
+	const gchar *who = NULL;
+
+	command = purple_ircv3_message_get_command(message);
+	if(purple_strequal(command, PURPLE_IRCV3_RPL_TOPIC)) {
+		channel = purple_ircv3_message_get_param(message, 1);
+		topic = purple_ircv3_message_get_param(message, 2);
+	} else {
+		who = purple_ircv3_message_get_nick(message);
+		channel = purple_ircv3_message_get_param(message, 0);
+		topic = purple_ircv3_message_get_param(message, 1);
+	}
+
+	chat = purple_ircv3_connection_find_chat(connection, channel);
+	if(chat != NULL) {
+		purple_chat_conversation_set_topic(chat, who, topic);
+	}
+
+	return TRUE;
+}
+
+static gboolean
+purple_ircv3_message_handler_namreply(PurpleIRCv3Connection *connection,
+                                      PurpleIRCv3Message *message,
+                                      G_GNUC_UNUSED GError **error)
+{
+	GPtrArray *names = NULL;
+	const gchar *channel = NULL, *list = NULL;
+	gchar **nicks = NULL;
+
+	channel = purple_ircv3_message_get_param(message, 2);
+	list = purple_ircv3_message_get_param(message, 3);
+	if(channel == NULL || list == NULL) {
+		return TRUE;
+	}
+
+	/* Large channels send many of these, so hold on to the names until
+	 * RPL_ENDOFNAMES and add them all at once.
+	 */
+	names = g_hash_table_lookup(connection->names, channel);
+	if(names == NULL) {
+		names = g_ptr_array_new_with_free_func(g_free);
+		g_hash_table_insert(connection->names, g_strdup(channel), names);
+	}
+
+	nicks = g_strsplit(list, " ", -1);
+	for(gint i = 0; nicks[i] != NULL; i++) {
+		if(*nicks[i] != '\0') {
+			g_ptr_array_add(names, nicks[i]);
+		} else {
+			g_free(nicks[i]);
+		}
+	}
+	g_free(nicks);
+
+	return TRUE;
+}
+
+static gboolean
+purple_ircv3_message_handler_endofnames(PurpleIRCv3Connection *connection,
+                                        PurpleIRCv3Message *message,
+                                        G_GNUC_UNUSED GError **error)
+{
+	PurpleChatConversation *chat = NULL;
+	GPtrArray *names = NULL;
+	GList *users = NULL, *flags = NULL;
+	const gchar *channel = NULL;
+
+	channel = purple_ircv3_message_get_param(message, 1);
+	if(channel == NULL) {
+		return TRUE;
+	}
+
+	names = g_hash_table_lookup(connection->names, channel);
+	chat = purple_ircv3_connection_find_chat(connection, channel);
+
+	if(names == NULL || chat == NULL) {
+		g_hash_table_remove(connection->names, channel);
+
+		return TRUE;
+	}
+
+	for(guint i = names->len; i > 0; i--) {
+		const gchar *nick = g_ptr_array_index(names, i - 1);
+		PurpleChatUserFlags flag;
+
+		flag = purple_ircv3_message_handlers_parse_prefix(&nick);
+
+		users = g_list_prepend(users, (gpointer)nick);
+		flags = g_list_prepend(flags, GINT_TO_POINTER(flag));
+	}
+
+	if(users != NULL) {
+		purple_chat_conversation_add_users(chat, users, NULL, flags, FALSE);
+	}
+
+	g_list_free(users);
+	g_list_free(flags);
+
+	g_hash_table_remove(connection->names, channel);
+
+	return TRUE;
+}
+
+static gboolean
+purple_ircv3_message_handler_nicknameinuse(PurpleIRCv3Connection *connection,
+                                           G_GNUC_UNUSED PurpleIRCv3Message *message,
+                                           G_GNUC_UNUSED GError **error)
+{
+	gchar *nick = NULL;
+
+	/* Once we're registered this is a reply to a nick change and there's
+	 * nothing to fix up.
+	 */
+	if(connection->registered) {
+		return TRUE;
+	}
+
+	nick = g_strdup_printf("%s_", connection->nick);
+	g_free(connection->nick);
+	connection->nick = nick;
+
+	purple_ircv3_connection_writef(connection, "%s %s", PURPLE_IRCV3_MSG_NICK,
+	                               nick);
+
+	return TRUE;
+}
+
+static gboolean
+purple_ircv3_message_handler_batch(PurpleIRCv3Connection *connection,
+                                   PurpleIRCv3Message *message,
+                                   GError **error)
+{
+	const gchar *ref = NULL;
+
+	ref = purple_ircv3_message_get_param(message, 0);
+	if(ref == NULL || ref[0] == '\0' || ref[1] == '\0') {
+		return TRUE;
+	}
+
+	if(ref[0] == '+') {
+		PurpleIRCv3Batch *batch = g_new0(PurpleIRCv3Batch, 1);
+
+		batch->type = g_strdup(purple_ircv3_message_get_param(message, 1));
+		batch->target = g_strdup(purple_ircv3_message_get_param(message, 2));
+		batch->messages = g_ptr_array_new_with_free_func(
+			(GDestroyNotify)purple_ircv3_message_free);
+
+		g_hash_table_replace(connection->batches, g_strdup(ref + 1), batch);
+	} else if(ref[0] == '-') {
+		PurpleIRCv3Batch *batch = NULL;
+		gpointer key = NULL;
+		gboolean ret = TRUE;
+
+		if(!g_hash_table_steal_extended(connection->batches, ref + 1, &key,
+		                                (gpointer *)&batch))
+		{
+			return TRUE;
+		}
+
+		ret = purple_ircv3_message_handlers_process_batch(connection, batch,
+		                                                  error);
+
+		g_free(key);
+		purple_ircv3_batch_free(batch);
+
+		return ret;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+purple_ircv3_message_handler_cap(PurpleIRCv3Connection *connection,
+                                 PurpleIRCv3Message *message,
+                                 G_GNUC_UNUSED GError **error)
+{
+	const gchar *subcommand = NULL, *list = NULL;
+	gboolean more = FALSE;
+
+	subcommand = purple_ircv3_message_get_param(message, 1);
+	list = purple_ircv3_message_handlers_get_last_param(message);
+	if(subcommand == NULL || list == NULL) {
+		return TRUE;
+	}
+
+	if(purple_strequal(subcommand, "LS")) {
+		gchar *request = NULL;
+
+		/* Multiline replies have a "*" before the list on all but the last
+		 * line.
+		 */
+		more = purple_ircv3_message_get_n_params(message) > 3 &&
+		       purple_strequal(purple_ircv3_message_get_param(message, 2), "*");
+
+		purple_ircv3_capabilities_add_available(connection->capabilities,
+		                                        list);
+
+		if(more || connection->registered) {
+			return TRUE;
+		}
+
+		request = purple_ircv3_capabilities_build_request(connection->capabilities);
+		if(request != NULL) {
+			purple_ircv3_connection_writef(connection, "%s REQ :%s",
+			                               PURPLE_IRCV3_MSG_CAP, request);
+			g_free(request);
+		} else {
+			purple_ircv3_connection_writef(connection, "%s END",
+			                               PURPLE_IRCV3_MSG_CAP);
+		}
+	} else if(purple_strequal(subcommand, "ACK")) {
+		purple_ircv3_capabilities_acknowledge(connection->capabilities, list);
+
+		if(!connection->registered) {
+			purple_ircv3_connection_writef(connection, "%s END",
+			                               PURPLE_IRCV3_MSG_CAP);
+		}
+	} else if(purple_strequal(subcommand, "NAK")) {
+		if(!connection->registered) {
+			purple_ircv3_connection_writef(connection, "%s END",
+			                               PURPLE_IRCV3_MSG_CAP);
+		}
+	}
+
+	return TRUE;
+}
+
+static gboolean
+purple_ircv3_message_handler_error(G_GNUC_UNUSED PurpleIRCv3Connection *connection,
+                                   PurpleIRCv3Message *message,
+                                   GError **error)
+{
+	const gchar *reason = purple_ircv3_message_get_param(message, 0);
+
+	g_set_error(error, PURPLE_CONNECTION_ERROR,
+	            PURPLE_CONNECTION_ERROR_NETWORK_ERROR,
+	            _("Server closed the connection: %s"),
+	            reason != NULL ? reason : _("unknown reason"));
+
+	return FALSE;
+}
+
+static gboolean
+purple_ircv3_message_handler_join(PurpleIRCv3Connection *connection,
+                                  PurpleIRCv3Message *message,
+                                  G_GNUC_UNUSED GError **error)
+{
+	PurpleChatConversation *chat = NULL;
+	const gchar *nick = NULL, *channel = NULL;
+
+	nick = purple_ircv3_message_get_nick(message);
+	channel = purple_ircv3_message_get_param(message, 0);
+	if(nick == NULL || channel == NULL) {
+		return TRUE;
+	}
+
+	if(purple_ircv3_message_handlers_is_own_nick(connection, nick)) {
+		purple_serv_got_joined_chat(connection->connection,
+		                            connection->next_chat_id++, channel);
+
+		purple_ircv3_connection_request_history(connection, channel);
+
+		return TRUE;
+	}
+
+	chat = purple_ircv3_connection_find_chat(connection, channel);
+	if(chat != NULL) {
+		purple_chat_conversation_add_user(chat, nick, NULL,
+		                                  PURPLE_CHAT_USER_NONE, TRUE);
+	}
+
+	return TRUE;
+}
+
+static gboolean
+purple_ircv3_message_handler_nick(PurpleIRCv3Connection *connection,
+                                  PurpleIRCv3Message *message,
+                                  G_GNUC_UNUSED GError **error)
+{
+	GList *chats = NULL;
+	const gchar *old_nick = NULL, *new_nick = NULL;
+
+	old_nick = purple_ircv3_message_get_nick(message);
+	new_nick = purple_ircv3_message_get_param(message, 0);
+	if(old_nick == NULL || new_nick == NULL) {
+		return TRUE;
+	}
+
+	chats = purple_ircv3_message_handlers_get_chats(connection);
+	for(GList *l = chats; l != NULL; l = l->next) {
+		PurpleChatConversation *chat = l->data;
+
+		if(purple_chat_conversation_has_user(chat, old_nick)) {
+			purple_chat_conversation_rename_user(chat, old_nick, new_nick);
+		}
+	}
+	g_list_free(chats);
+
+	if(purple_ircv3_message_handlers_is_own_nick(connection, old_nick)) {
+		g_free(connection->nick);
+		connection->nick = g_strdup(new_nick);
+		purple_connection_set_display_name(connection->connection, new_nick);
+	}
+
+	return TRUE;
+}
+
+static gboolean
+purple_ircv3_message_handler_privmsg(PurpleIRCv3Connection *connection,
+                                     PurpleIRCv3Message *message,
+                                     G_GNUC_UNUSED GError **error)
+{
+	PurpleMessageFlags flags = 0;
+	const gchar *command = NULL, *nick = NULL, *target = NULL, *text = NULL;
+	gchar *contents = NULL;
+	gint64 timestamp = 0;
+	gboolean own = FALSE;
+
+	command = purple_ircv3_message_get_command(message);
+	nick = purple_ircv3_message_get_nick(message);
+	target = purple_ircv3_message_get_param(message, 0);
+	text = purple_ircv3_message_get_param(message, 1);
+	if(target == NULL || text == NULL) {
+		return TRUE;
+	}
+
+	/* Notices without a source come from the server itself. */
+	if(nick == NULL) {
+		nick = connection->server;
+	}
+
+	contents = purple_ircv3_message_handlers_format_text(text);
+	if(contents == NULL) {
+		return TRUE;
+	}
+
+	if(purple_strequal(command, PURPLE_IRCV3_MSG_NOTICE)) {
+		flags |= PURPLE_MESSAGE_NOTIFY;
+	}
+
+	timestamp = purple_ircv3_message_handlers_get_timestamp(message);
+
+	/* With echo-message enabled our own messages come back to us and are
+	 * displayed here, with the server's timestamp, instead of when we sent
+	 * them.
+	 */
+	own = purple_ircv3_message_handlers_is_own_nick(connection, nick);
+	flags |= own ? PURPLE_MESSAGE_SEND : PURPLE_MESSAGE_RECV;
+
+	if(purple_ircv3_connection_is_channel(connection, target)) {
+		PurpleChatConversation *chat = NULL;
+
+		chat = purple_ircv3_connection_find_chat(connection, target);
+		if(chat != NULL) {
+			purple_serv_got_chat_in(connection->connection,
+			                        purple_chat_conversation_get_id(chat),
+			                        nick, flags, contents, timestamp);
+		}
+	} else if(own) {
+		PurpleConversationManager *conversations = NULL;
+		PurpleConversation *im = NULL;
+		PurpleMessage *msg = NULL;
+		GDateTime *dt = NULL;
+
+		conversations = purple_conversation_manager_get_default();
+		im = purple_conversation_manager_find_im(conversations,
+		                                         connection->account, target);
+		if(im != NULL) {
+			g_object_ref(im);
+		} else {
+			im = purple_im_conversation_new(connection->account, target);
+		}
+
+		msg = purple_message_new_outgoing(nick, target, contents, flags);
+		dt = g_date_time_new_from_unix_local(timestamp);
+		purple_message_set_timestamp(msg, dt);
+		g_date_time_unref(dt);
+
+		purple_conversation_write_message(im, msg);
+		g_object_unref(msg);
+		g_object_unref(im);
+	} else {
+		purple_serv_got_im(connection->connection, nick, contents, flags,
+		                   timestamp);
+	}
+
+	g_free(contents);
+
+	return TRUE;
+}
+
+static gboolean
+purple_ircv3_message_handler_part(PurpleIRCv3Connection *connection,
+                                  PurpleIRCv3Message *message,
+                                  G_GNUC_UNUSED GError **error)
+{
+	PurpleChatConversation *chat = NULL;
+	const gchar *nick = NULL, *channel = NULL;
+
+	nick = purple_ircv3_message_get_nick(message);
+	channel = purple_ircv3_message_get_param(message, 0);
+
+	chat = purple_ircv3_connection_find_chat(connection, channel);
+	if(nick == NULL || chat == NULL) {
+		return TRUE;
+	}
+
+	if(purple_ircv3_message_handlers_is_own_nick(connection, nick)) {
+		purple_serv_got_chat_left(connection->connection,
+		                          purple_chat_conversation_get_id(chat));
+	} else {
+		purple_chat_conversation_remove_user(chat, nick,
+		                                     purple_ircv3_message_get_param(message, 1));
+	}
+
+	return TRUE;
+}
+
+static gboolean
+purple_ircv3_message_handler_ping(PurpleIRCv3Connection *connection,
+                                  PurpleIRCv3Message *message,
+                                  G_GNUC_UNUSED GError **error)
+{
+	const gchar *token = purple_ircv3_message_get_param(message, 0);
+
+	purple_ircv3_connection_writef(connection, "PONG :%s",
+	                               token != NULL ? token : "");
+
+	return TRUE;
+}
+
+static gboolean
+purple_ircv3_message_handler_quit(PurpleIRCv3Connection *connection,
+                                  PurpleIRCv3Message *message,
+                                  G_GNUC_UNUSED GError **error)
+{
+	GList *chats = NULL;
+	const gchar *nick = NULL, *reason = NULL;
+
+	nick = purple_ircv3_message_get_nick(message);
+	reason = purple_ircv3_message_get_param(message, 0);
+	if(nick == NULL) {
+		return TRUE;
+	}
+
+	chats = purple_ircv3_message_handlers_get_chats(connection);
+	for(GList *l = chats; l != NULL; l = l->next) {
+		PurpleChatConversation *chat = l->data;
+
+		if(purple_chat_conversation_has_user(chat, nick)) {
+			purple_chat_conversation_remove_user(chat, nick, reason);
+		}
+	}
+	g_list_free(chats);
+
+	return TRUE;
+}
+
+/* This must be kept sorted by command for bsearch. */
+static const PurpleIRCv3MessageHandlerEntry handlers[] = {
+	{ PURPLE_IRCV3_RPL_WELCOME, purple_ircv3_message_handler_welcome },
+	{ PURPLE_IRCV3_RPL_ISUPPORT, purple_ircv3_message_handler_isupport },
+	{ PURPLE_IRCV3_RPL_TOPIC, purple_ircv3_message_handler_topic },
+	{ PURPLE_IRCV3_RPL_NAMREPLY, purple_ircv3_message_handler_namreply },
+	{ PURPLE_IRCV3_RPL_ENDOFNAMES, purple_ircv3_message_handler_endofnames },
+	{ PURPLE_IRCV3_ERR_NICKNAMEINUSE, purple_ircv3_message_handler_nicknameinuse },
+	{ PURPLE_IRCV3_MSG_BATCH, purple_ircv3_message_handler_batch },
+	{ PURPLE_IRCV3_MSG_CAP, purple_ircv3_message_handler_cap },
+	{ "ERROR", purple_ircv3_message_handler_error },
+	{ PURPLE_IRCV3_MSG_JOIN, purple_ircv3_message_handler_join },
+	{ PURPLE_IRCV3_MSG_NICK, purple_ircv3_message_handler_nick },
+	{ PURPLE_IRCV3_MSG_NOTICE, purple_ircv3_message_handler_privmsg },
+	{ PURPLE_IRCV3_MSG_PART, purple_ircv3_message_handler_part },
+	{ PURPLE_IRCV3_MSG_PING, purple_ircv3_message_handler_ping },
+	{ PURPLE_IRCV3_MSG_PRIVMSG, purple_ircv3_message_handler_privmsg },
+	{ PURPLE_IRCV3_MSG_QUIT, purple_ircv3_message_handler_quit },
+	{ PURPLE_IRCV3_MSG_TOPIC, purple_ircv3_message_handler_topic },
+};
+
+static int
+purple_ircv3_message_handlers_compare(gconstpointer a, gconstpointer b) {
+	const gchar *command = a;
+	const PurpleIRCv3MessageHandlerEntry *entry = b;
+
+	return strcmp(command, entry->command);
+}
+
+/******************************************************************************
+ * Internal API
+ *****************************************************************************/
+PurpleIRCv3MessageHandler
+purple_ircv3_message_handlers_find(const gchar *command) {
+	const PurpleIRCv3MessageHandlerEntry *entry = NULL;
+
+	g_return_val_if_fail(command != NULL, NULL);
+
+	entry = bsearch(command, handlers, G_N_ELEMENTS(handlers),
+	                sizeof(PurpleIRCv3MessageHandlerEntry),
+	                purple_ircv3_message_handlers_compare);
+
+	return entry != NULL ? entry->handler : NULL;
+}
+
+gchar *
+purple_ircv3_message_handlers_format_text(const gchar *text) {
+	gchar *escaped = NULL, *ret = NULL;
+
+	g_return_val_if_fail(text != NULL, NULL);
+
+	if(*text != '\001') {
+		return g_markup_escape_text(text, -1);
+	}
+
+	/* The only CTCP we display is ACTION, which becomes /me. */
+	if(g_str_has_prefix(text, "\001ACTION ")) {
+		gchar *action = g_strdup(text + 8);
+		gsize length = strlen(action);
+
+		if(length > 0 && action[length - 1] == '\001') {
+			action[length - 1] = '\0';
+		}
+
+		escaped = g_markup_escape_text(action, -1);
+		ret = g_strdup_printf("/me %s", escaped);
+
+		g_free(escaped);
+		g_free(action);
+	}
+
+	return ret;
+}
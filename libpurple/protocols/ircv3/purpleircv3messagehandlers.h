@@ -0,0 +1,34 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PURPLE_IRCV3_MESSAGE_HANDLERS_H
+#define PURPLE_IRCV3_MESSAGE_HANDLERS_H
+
+#include <glib.h>
+
+#include "purpleircv3connection.h"
+
+G_BEGIN_DECLS
+
+G_GNUC_INTERNAL PurpleIRCv3MessageHandler purple_ircv3_message_handlers_find(const gchar *command);
+
+G_GNUC_INTERNAL gchar *purple_ircv3_message_handlers_format_text(const gchar *text);
+
+G_END_DECLS
+
+#endif /* PURPLE_IRCV3_MESSAGE_HANDLERS_H */
@@ -20,16 +20,115 @@
 
 #include "purpleircv3protocol.h"
 
+#include "purpleircv3connection.h"
+#include "purpleircv3constants.h"
+#include "purpleircv3protocolchat.h"
+#include "purpleircv3protocolim.h"
+
 typedef struct {
 	gboolean dummy;
 } PurpleIRCv3ProtocolPrivate;
 
+/******************************************************************************
+ * PurpleProtocol Implementation
+ *****************************************************************************/
+static void
+purple_ircv3_protocol_login(PurpleAccount *account) {
+	PurpleIRCv3Connection *connection = NULL;
+	PurpleConnection *conn = NULL;
+	GError *error = NULL;
+
+	conn = purple_account_get_connection(account);
+	purple_connection_set_flags(conn, PURPLE_CONNECTION_FLAG_NO_NEWLINES |
+	                                  PURPLE_CONNECTION_FLAG_NO_IMAGES);
+
+	connection = purple_ircv3_connection_new(conn, &error);
+	if(connection == NULL) {
+		purple_connection_take_error(conn, error);
+
+		return;
+	}
+
+	purple_connection_set_protocol_data(conn, connection);
+
+	purple_ircv3_connection_connect(connection);
+}
+
+static void
+purple_ircv3_protocol_close(PurpleConnection *conn) {
+	PurpleIRCv3Connection *connection = NULL;
+
+	connection = purple_connection_get_protocol_data(conn);
+	if(connection == NULL) {
+		return;
+	}
+
+	purple_ircv3_connection_close(connection);
+	purple_ircv3_connection_free(connection);
+
+	purple_connection_set_protocol_data(conn, NULL);
+}
+
+static GList *
+purple_ircv3_protocol_get_account_options(G_GNUC_UNUSED PurpleProtocol *protocol)
+{
+	PurpleAccountOption *option = NULL;
+	GList *options = NULL;
+
+	option = purple_account_option_int_new(_("Port"), "port",
+	                                       PURPLE_IRCV3_DEFAULT_TLS_PORT);
+	options = g_list_append(options, option);
+
+	option = purple_account_option_bool_new(_("Use TLS"), "use-tls", TRUE);
+	options = g_list_append(options, option);
+
+	option = purple_account_option_int_new(_("Messages of history to fetch"),
+	                                       "history-depth",
+	                                       PURPLE_IRCV3_DEFAULT_HISTORY_DEPTH);
+	options = g_list_append(options, option);
+
+	return options;
+}
+
+static GList *
+purple_ircv3_protocol_get_user_splits(G_GNUC_UNUSED PurpleProtocol *protocol) {
+	PurpleAccountUserSplit *split = NULL;
+
+	split = purple_account_user_split_new(_("Server"), "irc.libera.chat", '@');
+
+	return g_list_append(NULL, split);
+}
+
+static GList *
+purple_ircv3_protocol_status_types(G_GNUC_UNUSED PurpleAccount *account) {
+	PurpleStatusType *type = NULL;
+	GList *types = NULL;
+
+	type = purple_status_type_new(PURPLE_STATUS_AVAILABLE, NULL, NULL, TRUE);
+	types = g_list_append(types, type);
+
+	type = purple_status_type_new_with_attrs(
+		PURPLE_STATUS_AWAY, NULL, NULL, TRUE, TRUE, FALSE,
+		"message", _("Message"), purple_value_new(G_TYPE_STRING),
+		NULL);
+	types = g_list_append(types, type);
+
+	type = purple_status_type_new(PURPLE_STATUS_OFFLINE, NULL, NULL, TRUE);
+	types = g_list_append(types, type);
+
+	return types;
+}
+
 /******************************************************************************
  * GObject Implementation
  *****************************************************************************/
 G_DEFINE_DYNAMIC_TYPE_EXTENDED(
 	PurpleIRCv3Protocol, purple_ircv3_protocol, PURPLE_TYPE_PROTOCOL, 0,
-	G_ADD_PRIVATE_DYNAMIC(PurpleIRCv3Protocol))
+	G_ADD_PRIVATE_DYNAMIC(PurpleIRCv3Protocol)
+	G_IMPLEMENT_INTERFACE_DYNAMIC(PURPLE_TYPE_PROTOCOL_CHAT,
+	                              purple_ircv3_protocol_chat_init)
+	G_IMPLEMENT_INTERFACE_DYNAMIC(PURPLE_TYPE_PROTOCOL_IM,
+	                              purple_ircv3_protocol_im_init))
 
 static void
 purple_ircv3_protocol_init(PurpleIRCv3Protocol *protocol) {
@@ -41,6 +140,13 @@ purple_ircv3_protocol_class_finalize(PurpleIRCv3ProtocolClass *klass) {
 
 static void
 purple_ircv3_protocol_class_init(PurpleIRCv3ProtocolClass *klass) {
+	PurpleProtocolClass *protocol_class = PURPLE_PROTOCOL_CLASS(klass);
+
+	protocol_class->login = purple_ircv3_protocol_login;
+	protocol_class->close = purple_ircv3_protocol_close;
+	protocol_class->status_types = purple_ircv3_protocol_status_types;
+	protocol_class->get_account_options = purple_ircv3_protocol_get_account_options;
+	protocol_class->get_user_splits = purple_ircv3_protocol_get_user_splits;
 }
 
 /******************************************************************************
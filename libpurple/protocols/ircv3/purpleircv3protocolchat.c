@@ -0,0 +1,196 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+
+#include <glib/gi18n-lib.h>
+
+#include "purpleircv3protocolchat.h"
+
+#include "purpleircv3connection.h"
+#include "purpleircv3constants.h"
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static PurpleConversation *
+purple_ircv3_protocol_chat_find(PurpleConnection *conn, gint id) {
+	PurpleConversationManager *manager = NULL;
+
+	manager = purple_conversation_manager_get_default();
+
+	return purple_conversation_manager_find_chat_by_id(manager,
+	                                                   purple_connection_get_account(conn),
+	                                                   id);
+}
+
+/******************************************************************************
+ * PurpleProtocolChat Implementation
+ *****************************************************************************/
+static GList *
+purple_ircv3_protocol_chat_info(G_GNUC_UNUSED PurpleProtocolChat *protocol_chat,
+                                G_GNUC_UNUSED PurpleConnection *conn)
+{
+	PurpleProtocolChatEntry *entry = NULL;
+	GList *entries = NULL;
+
+	entry = g_new0(PurpleProtocolChatEntry, 1);
+	entry->label = _("_Channel:");
+	entry->identifier = "channel";
+	entry->required = TRUE;
+	entries = g_list_append(entries, entry);
+
+	entry = g_new0(PurpleProtocolChatEntry, 1);
+	entry->label = _("_Password:");
+	entry->identifier = "password";
+	entry->secret = TRUE;
+	entries = g_list_append(entries, entry);
+
+	return entries;
+}
+
+static GHashTable *
+purple_ircv3_protocol_chat_info_defaults(G_GNUC_UNUSED PurpleProtocolChat *protocol_chat,
+                                         G_GNUC_UNUSED PurpleConnection *conn,
+                                         const gchar *chat_name)
+{
+	GHashTable *defaults = NULL;
+
+	defaults = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+
+	if(chat_name != NULL) {
+		g_hash_table_insert(defaults, "channel", g_strdup(chat_name));
+	}
+
+	return defaults;
+}
+
+static void
+purple_ircv3_protocol_chat_join(G_GNUC_UNUSED PurpleProtocolChat *protocol_chat,
+                                PurpleConnection *conn, GHashTable *components)
+{
+	PurpleIRCv3Connection *connection = NULL;
+	const gchar *channel = NULL, *password = NULL;
+
+	connection = purple_connection_get_protocol_data(conn);
+	channel = g_hash_table_lookup(components, "channel");
+	password = g_hash_table_lookup(components, "password");
+
+	if(connection == NULL || channel == NULL || *channel == '\0') {
+		return;
+	}
+
+	if(password != NULL && *password != '\0') {
+		purple_ircv3_connection_writef(connection, "%s %s %s",
+		                               PURPLE_IRCV3_MSG_JOIN, channel,
+		                               password);
+	} else {
+		purple_ircv3_connection_writef(connection, "%s %s",
+		                               PURPLE_IRCV3_MSG_JOIN, channel);
+	}
+}
+
+static gchar *
+purple_ircv3_protocol_chat_get_name(G_GNUC_UNUSED PurpleProtocolChat *protocol_chat,
+                                    GHashTable *components)
+{
+	return g_strdup(g_hash_table_lookup(components, "channel"));
+}
+
+static void
+purple_ircv3_protocol_chat_leave(G_GNUC_UNUSED PurpleProtocolChat *protocol_chat,
+                                 PurpleConnection *conn, gint id)
+{
+	PurpleIRCv3Connection *connection = NULL;
+	PurpleConversation *conversation = NULL;
+
+	connection = purple_connection_get_protocol_data(conn);
+	conversation = purple_ircv3_protocol_chat_find(conn, id);
+	if(connection == NULL || conversation == NULL) {
+		return;
+	}
+
+	purple_ircv3_connection_writef(connection, "%s %s", PURPLE_IRCV3_MSG_PART,
+	                               purple_conversation_get_name(conversation));
+
+	purple_serv_got_chat_left(conn, id);
+}
+
+static gint
+purple_ircv3_protocol_chat_send(G_GNUC_UNUSED PurpleProtocolChat *protocol_chat,
+                                PurpleConnection *conn, gint id,
+                                PurpleMessage *msg)
+{
+	PurpleIRCv3Connection *connection = NULL;
+	PurpleConversation *conversation = NULL;
+
+	connection = purple_connection_get_protocol_data(conn);
+	conversation = purple_ircv3_protocol_chat_find(conn, id);
+	if(connection == NULL || conversation == NULL) {
+		return -EINVAL;
+	}
+
+	purple_ircv3_connection_send_privmsg(connection,
+	                                     purple_conversation_get_name(conversation),
+	                                     purple_message_get_contents(msg));
+
+	/* With echo-message the server sends the message back to us and we
+	 * display it then.
+	 */
+	if(!purple_ircv3_capabilities_is_enabled(connection->capabilities,
+	                                         "echo-message"))
+	{
+		purple_serv_got_chat_in(conn, id, connection->nick,
+		                        purple_message_get_flags(msg),
+		                        purple_message_get_contents(msg),
+		                        g_get_real_time() / G_USEC_PER_SEC);
+	}
+
+	return 0;
+}
+
+static void
+purple_ircv3_protocol_chat_set_topic(G_GNUC_UNUSED PurpleProtocolChat *protocol_chat,
+                                     PurpleConnection *conn, gint id,
+                                     const gchar *topic)
+{
+	PurpleIRCv3Connection *connection = NULL;
+	PurpleConversation *conversation = NULL;
+
+	connection = purple_connection_get_protocol_data(conn);
+	conversation = purple_ircv3_protocol_chat_find(conn, id);
+	if(connection == NULL || conversation == NULL) {
+		return;
+	}
+
+	purple_ircv3_connection_writef(connection, "%s %s :%s",
+	                               PURPLE_IRCV3_MSG_TOPIC,
+	                               purple_conversation_get_name(conversation),
+	                               topic != NULL ? topic : "");
+}
+
+void
+purple_ircv3_protocol_chat_init(PurpleProtocolChatInterface *iface) {
+	iface->info = purple_ircv3_protocol_chat_info;
+	iface->info_defaults = purple_ircv3_protocol_chat_info_defaults;
+	iface->join = purple_ircv3_protocol_chat_join;
+	iface->get_name = purple_ircv3_protocol_chat_get_name;
+	iface->leave = purple_ircv3_protocol_chat_leave;
+	iface->send = purple_ircv3_protocol_chat_send;
+	iface->set_topic = purple_ircv3_protocol_chat_set_topic;
+}
@@ -0,0 +1,60 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+
+#include <glib/gi18n-lib.h>
+
+#include "purpleircv3protocolim.h"
+
+#include "purpleircv3connection.h"
+
+/******************************************************************************
+ * PurpleProtocolIM Implementation
+ *****************************************************************************/
+static gint
+purple_ircv3_protocol_send_im(G_GNUC_UNUSED PurpleProtocolIM *im,
+                              PurpleConnection *conn, PurpleMessage *msg)
+{
+	PurpleIRCv3Connection *connection = NULL;
+
+	connection = purple_connection_get_protocol_data(conn);
+	if(connection == NULL) {
+		return -ENOTCONN;
+	}
+
+	purple_ircv3_connection_send_privmsg(connection,
+	                                     purple_message_get_recipient(msg),
+	                                     purple_message_get_contents(msg));
+
+	/* With echo-message the server sends the message back to us and we
+	 * display it then.
+	 */
+	if(purple_ircv3_capabilities_is_enabled(connection->capabilities,
+	                                        "echo-message"))
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+void
+purple_ircv3_protocol_im_init(PurpleProtocolIMInterface *iface) {
+	iface->send = purple_ircv3_protocol_send_im;
+}
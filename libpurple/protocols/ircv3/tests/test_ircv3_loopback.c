@@ -0,0 +1,599 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <purple.h>
+
+#include "tests/test_ui.h"
+
+#include "protocols/ircv3/purpleircv3connection.h"
+
+#define TEST_IRCV3_NICK "tester"
+#define TEST_IRCV3_HISTORY_TOTAL 120
+#define TEST_IRCV3_HISTORY_PAGE 50
+#define TEST_IRCV3_BENCHMARK_LINES 50000
+
+/******************************************************************************
+ * Stand-in server
+ *
+ * Just enough of an IRCv3 server to drive a connection over loopback: it
+ * negotiates capabilities, registers the client, answers joins with a names
+ * list and plays back a fixed channel history in pages.
+ *****************************************************************************/
+typedef struct {
+	GSocketService *service;
+	guint16 port;
+
+	GCancellable *cancellable;
+	GSocketConnection *conn;
+	GDataInputStream *input;
+	PurpleQueuedOutputStream *output;
+
+	/* Every line the client sent us. */
+	GPtrArray *received;
+
+	/* Timestamps of the channel history, oldest first. */
+	GPtrArray *history;
+	guint history_requests;
+} TestIRCv3Server;
+
+static void
+test_ircv3_server_send(TestIRCv3Server *server, const gchar *format, ...)
+	G_GNUC_PRINTF(2, 3);
+
+static void
+test_ircv3_server_send(TestIRCv3Server *server, const gchar *format, ...) {
+	GBytes *bytes = NULL;
+	GString *line = g_string_new(NULL);
+	va_list vargs;
+
+	va_start(vargs, format);
+	g_string_append_vprintf(line, format, vargs);
+	va_end(vargs);
+	g_string_append(line, "\r\n");
+
+	bytes = g_string_free_to_bytes(line);
+	purple_queued_output_stream_push_bytes_async(server->output, bytes,
+	                                             G_PRIORITY_DEFAULT,
+	                                             server->cancellable, NULL,
+	                                             NULL);
+	g_bytes_unref(bytes);
+}
+
+static void
+test_ircv3_server_history(TestIRCv3Server *server, gchar **argv) {
+	const gchar *channel = argv[2];
+	guint end = 0, start = 0, limit = 0;
+
+	/* Only one channel has any history. */
+	if(g_str_equal(channel, "#history")) {
+		end = server->history->len;
+	}
+
+	/* CHATHISTORY BEFORE <channel> timestamp=<time> <limit> */
+	if(g_str_equal(argv[1], "BEFORE")) {
+		g_assert_true(g_str_has_prefix(argv[3], "timestamp="));
+
+		for(guint i = 0; i < end; i++) {
+			if(g_str_equal(argv[3] + 10, g_ptr_array_index(server->history, i))) {
+				end = i;
+				break;
+			}
+		}
+	} else {
+		g_assert_cmpstr(argv[1], ==, "LATEST");
+	}
+
+	limit = g_ascii_strtoull(argv[4], NULL, 10);
+	g_assert_cmpuint(limit, >, 0);
+	g_assert_cmpuint(limit, <=, TEST_IRCV3_HISTORY_PAGE);
+	start = end > limit ? end - limit : 0;
+
+	server->history_requests++;
+
+	/* The client must hold on to all of this until the batch ends. */
+	purple_queued_output_stream_cork(server->output);
+	test_ircv3_server_send(server, ":stand.in BATCH +h%u chathistory %s",
+	                       server->history_requests, channel);
+	for(guint i = start; i < end; i++) {
+		test_ircv3_server_send(server,
+		                       "@batch=h%u;time=%s :alice!a@stand.in PRIVMSG "
+		                       "%s :history message %u",
+		                       server->history_requests,
+		                       (const gchar *)g_ptr_array_index(server->history, i),
+		                       channel, i);
+	}
+	test_ircv3_server_send(server, ":stand.in BATCH -h%u",
+	                       server->history_requests);
+	purple_queued_output_stream_uncork(server->output);
+}
+
+static void
+test_ircv3_server_handle_line(TestIRCv3Server *server, const gchar *line) {
+	gchar **argv = NULL;
+
+	g_ptr_array_add(server->received, g_strdup(line));
+
+	argv = g_strsplit(line, " ", -1);
+
+	if(g_str_equal(line, "CAP LS 302")) {
+		/* Split the list over two lines to exercise multiline replies. */
+		test_ircv3_server_send(server, ":stand.in CAP * LS * :sasl=PLAIN "
+		                       "batch draft/chathistory");
+		test_ircv3_server_send(server, ":stand.in CAP * LS :echo-message "
+		                       "message-tags server-time");
+	} else if(g_str_has_prefix(line, "CAP REQ :")) {
+		test_ircv3_server_send(server, ":stand.in CAP * ACK :%s", line + 9);
+	} else if(g_str_equal(line, "CAP END")) {
+		test_ircv3_server_send(server, ":stand.in 001 %s :Welcome",
+		                       TEST_IRCV3_NICK);
+		test_ircv3_server_send(server, ":stand.in 005 %s CHATHISTORY=%d "
+		                       ":are supported by this server",
+		                       TEST_IRCV3_NICK, TEST_IRCV3_HISTORY_PAGE);
+	} else if(g_str_equal(argv[0], "JOIN") && argv[1] != NULL) {
+		test_ircv3_server_send(server, ":%s!t@stand.in JOIN %s",
+		                       TEST_IRCV3_NICK, argv[1]);
+		test_ircv3_server_send(server, ":stand.in 353 %s = %s :@%s alice",
+		                       TEST_IRCV3_NICK, argv[1], TEST_IRCV3_NICK);
+		test_ircv3_server_send(server, ":stand.in 353 %s = %s :+bob carol",
+		                       TEST_IRCV3_NICK, argv[1]);
+		test_ircv3_server_send(server, ":stand.in 366 %s %s :End of /NAMES",
+		                       TEST_IRCV3_NICK, argv[1]);
+	} else if(g_str_equal(argv[0], "CHATHISTORY")) {
+		g_assert_cmpuint(g_strv_length(argv), ==, 5);
+		test_ircv3_server_history(server, argv);
+	}
+
+	g_strfreev(argv);
+}
+
+static void
+test_ircv3_server_read_cb(GObject *source, GAsyncResult *result,
+                          gpointer data)
+{
+	TestIRCv3Server *server = data;
+	gchar *line = NULL;
+
+	line = g_data_input_stream_read_line_finish(G_DATA_INPUT_STREAM(source),
+	                                            result, NULL, NULL);
+	if(line == NULL) {
+		return;
+	}
+
+	test_ircv3_server_handle_line(server, line);
+	g_free(line);
+
+	g_data_input_stream_read_line_async(server->input, G_PRIORITY_DEFAULT,
+	                                    server->cancellable,
+	                                    test_ircv3_server_read_cb, server);
+}
+
+static gboolean
+test_ircv3_server_incoming_cb(GSocketService *service,
+                              GSocketConnection *conn, GObject *source,
+                              gpointer data)
+{
+	TestIRCv3Server *server = data;
+	GIOStream *stream = G_IO_STREAM(conn);
+
+	g_assert_null(server->conn);
+
+	server->conn = g_object_ref(conn);
+	server->output = purple_queued_output_stream_new(
+		g_io_stream_get_output_stream(stream));
+	server->input = g_data_input_stream_new(
+		g_io_stream_get_input_stream(stream));
+	g_data_input_stream_set_newline_type(server->input,
+	                                     G_DATA_STREAM_NEWLINE_TYPE_CR_LF);
+
+	g_data_input_stream_read_line_async(server->input, G_PRIORITY_DEFAULT,
+	                                    server->cancellable,
+	                                    test_ircv3_server_read_cb, server);
+
+	return TRUE;
+}
+
+static TestIRCv3Server *
+test_ircv3_server_new(void) {
+	TestIRCv3Server *server = g_new0(TestIRCv3Server, 1);
+	GInetAddress *loopback = NULL;
+	GSocketAddress *address = NULL, *effective = NULL;
+	GDateTime *start = NULL;
+	GError *error = NULL;
+
+	server->service = g_socket_service_new();
+	server->cancellable = g_cancellable_new();
+	server->received = g_ptr_array_new_with_free_func(g_free);
+	server->history = g_ptr_array_new_with_free_func(g_free);
+
+	start = g_date_time_new_utc(2022, 1, 1, 0, 0, 0);
+	for(guint i = 0; i < TEST_IRCV3_HISTORY_TOTAL; i++) {
+		GDateTime *dt = g_date_time_add_seconds(start, i);
+
+		g_ptr_array_add(server->history, g_date_time_format_iso8601(dt));
+		g_date_time_unref(dt);
+	}
+	g_date_time_unref(start);
+
+	loopback = g_inet_address_new_loopback(G_SOCKET_FAMILY_IPV4);
+	address = g_inet_socket_address_new(loopback, 0);
+	g_socket_listener_add_address(G_SOCKET_LISTENER(server->service), address,
+	                              G_SOCKET_TYPE_STREAM,
+	                              G_SOCKET_PROTOCOL_TCP, NULL, &effective,
+	                              &error);
+	g_assert_no_error(error);
+
+	server->port = g_inet_socket_address_get_port(
+		G_INET_SOCKET_ADDRESS(effective));
+
+	g_object_unref(effective);
+	g_object_unref(address);
+	g_object_unref(loopback);
+
+	g_signal_connect(server->service, "incoming",
+	                 G_CALLBACK(test_ircv3_server_incoming_cb), server);
+	g_socket_service_start(server->service);
+
+	return server;
+}
+
+static void
+test_ircv3_server_free(TestIRCv3Server *server) {
+	g_cancellable_cancel(server->cancellable);
+
+	g_socket_service_stop(server->service);
+	g_socket_listener_close(G_SOCKET_LISTENER(server->service));
+
+	if(server->conn != NULL) {
+		g_io_stream_close(G_IO_STREAM(server->conn), NULL, NULL);
+	}
+
+	g_clear_object(&server->input);
+	g_clear_object(&server->output);
+	g_clear_object(&server->conn);
+	g_clear_object(&server->service);
+	g_clear_object(&server->cancellable);
+
+	g_ptr_array_free(server->received, TRUE);
+	g_ptr_array_free(server->history, TRUE);
+
+	g_free(server);
+}
+
+/******************************************************************************
+ * Client
+ *****************************************************************************/
+typedef struct {
+	PurpleProtocol parent;
+} TestIRCv3Protocol;
+
+typedef struct {
+	PurpleProtocolClass parent;
+} TestIRCv3ProtocolClass;
+
+static GType test_ircv3_protocol_get_type(void);
+
+G_DEFINE_TYPE(TestIRCv3Protocol, test_ircv3_protocol, PURPLE_TYPE_PROTOCOL)
+
+static void
+test_ircv3_protocol_init(TestIRCv3Protocol *protocol) {
+}
+
+static void
+test_ircv3_protocol_class_init(TestIRCv3ProtocolClass *klass) {
+}
+
+typedef struct {
+	TestIRCv3Server *server;
+
+	PurpleProtocol *protocol;
+	PurpleAccount *account;
+	PurpleConnection *gc;
+	PurpleIRCv3Connection *connection;
+
+	guint timeout;
+} TestIRCv3Client;
+
+static gboolean
+test_ircv3_timeout_cb(gpointer data) {
+	g_assert_not_reached();
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+test_ircv3_client_connect(TestIRCv3Client *client) {
+	GError *error = NULL;
+
+	client->server = test_ircv3_server_new();
+
+	client->protocol = g_object_new(test_ircv3_protocol_get_type(),
+	                                "id", "prpl-test-ircv3", NULL);
+	client->account = purple_account_new(TEST_IRCV3_NICK "@127.0.0.1",
+	                                     "prpl-test-ircv3");
+	purple_account_set_int(client->account, "port", client->server->port);
+	purple_account_set_bool(client->account, "use-tls", FALSE);
+
+	client->gc = g_object_new(PURPLE_TYPE_CONNECTION, "account",
+	                          client->account, "protocol", client->protocol,
+	                          NULL);
+	purple_account_set_connection(client->account, client->gc);
+
+	client->connection = purple_ircv3_connection_new(client->gc, &error);
+	g_assert_no_error(error);
+	g_assert_nonnull(client->connection);
+	purple_connection_set_protocol_data(client->gc, client->connection);
+
+	client->timeout = g_timeout_add_seconds(30, test_ircv3_timeout_cb, NULL);
+
+	purple_ircv3_connection_connect(client->connection);
+
+	/* Wait for RPL_ISUPPORT as well, since it sets the history page size. */
+	while(!client->connection->registered ||
+	      client->connection->history_page_size != TEST_IRCV3_HISTORY_PAGE)
+	{
+		g_main_context_iteration(NULL, TRUE);
+	}
+}
+
+static PurpleChatConversation *
+test_ircv3_client_join(TestIRCv3Client *client, const gchar *channel) {
+	PurpleChatConversation *chat = NULL;
+
+	purple_ircv3_connection_writef(client->connection, "JOIN %s", channel);
+
+	/* Wait for the whole names list, which is added in one go. */
+	for(;;) {
+		chat = purple_ircv3_connection_find_chat(client->connection, channel);
+		if(chat != NULL && purple_chat_conversation_has_user(chat, "carol")) {
+			break;
+		}
+
+		g_main_context_iteration(NULL, TRUE);
+	}
+
+	return chat;
+}
+
+static PurpleIRCv3History *
+test_ircv3_client_wait_for_history(TestIRCv3Client *client,
+                                   const gchar *channel)
+{
+	PurpleIRCv3History *history = NULL;
+
+	for(;;) {
+		history = g_hash_table_lookup(client->connection->history, channel);
+		if(history != NULL && history->exhausted) {
+			return history;
+		}
+
+		g_main_context_iteration(NULL, TRUE);
+	}
+}
+
+static void
+test_ircv3_client_disconnect(TestIRCv3Client *client) {
+	g_source_remove(client->timeout);
+
+	purple_connection_set_protocol_data(client->gc, NULL);
+	purple_ircv3_connection_free(client->connection);
+
+	purple_account_set_connection(client->account, NULL);
+	g_object_unref(client->gc);
+	g_object_unref(client->account);
+	g_object_unref(client->protocol);
+
+	test_ircv3_server_free(client->server);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_ircv3_loopback_registration(void) {
+	TestIRCv3Client client = { NULL };
+	GPtrArray *received = NULL;
+
+	test_ircv3_client_connect(&client);
+	received = client.server->received;
+
+	/* Registration goes out in a single burst, with capability negotiation
+	 * first so that it finishes before the server registers us.
+	 */
+	g_assert_cmpuint(received->len, ==, 5);
+	g_assert_cmpstr(g_ptr_array_index(received, 0), ==, "CAP LS 302");
+	g_assert_cmpstr(g_ptr_array_index(received, 1), ==,
+	                "NICK " TEST_IRCV3_NICK);
+	g_assert_true(g_str_has_prefix(g_ptr_array_index(received, 2),
+	                               "USER " TEST_IRCV3_NICK " "));
+	g_assert_cmpstr(g_ptr_array_index(received, 3), ==,
+	                "CAP REQ :batch draft/chathistory echo-message "
+	                "message-tags server-time");
+	g_assert_cmpstr(g_ptr_array_index(received, 4), ==, "CAP END");
+
+	g_assert_true(purple_ircv3_capabilities_is_enabled(
+		client.connection->capabilities, "batch"));
+	g_assert_true(purple_ircv3_capabilities_is_enabled(
+		client.connection->capabilities, "echo-message"));
+	g_assert_cmpstr(purple_ircv3_capabilities_get_value(
+		client.connection->capabilities, "sasl"), ==, "PLAIN");
+
+	test_ircv3_client_disconnect(&client);
+}
+
+static void
+test_ircv3_loopback_names(void) {
+	TestIRCv3Client client = { NULL };
+	PurpleChatConversation *chat = NULL;
+	PurpleChatUser *user = NULL;
+
+	test_ircv3_client_connect(&client);
+	chat = test_ircv3_client_join(&client, "#names");
+
+	g_assert_cmpuint(purple_chat_conversation_get_users_count(chat), ==, 4);
+
+	user = purple_chat_conversation_find_user(chat, "bob");
+	g_assert_nonnull(user);
+	g_assert_cmpint(purple_chat_user_get_flags(user), ==,
+	                PURPLE_CHAT_USER_VOICE);
+
+	test_ircv3_client_disconnect(&client);
+}
+
+static void
+test_ircv3_loopback_netsplit(void) {
+	TestIRCv3Client client = { NULL };
+	PurpleChatConversation *chat = NULL;
+	guint64 lines = 0;
+
+	test_ircv3_client_connect(&client);
+	chat = test_ircv3_client_join(&client, "#split");
+	test_ircv3_client_wait_for_history(&client, "#split");
+	lines = purple_ircv3_connection_get_lines_received(client.connection);
+
+	test_ircv3_server_send(client.server, ":stand.in BATCH +ns netsplit "
+	                       "a.stand.in b.stand.in");
+	test_ircv3_server_send(client.server, "@batch=ns :alice!a@stand.in QUIT "
+	                       ":a.stand.in b.stand.in");
+	test_ircv3_server_send(client.server, "@batch=ns :bob!b@stand.in QUIT "
+	                       ":a.stand.in b.stand.in");
+
+	/* Nothing happens until the batch ends... */
+	while(purple_ircv3_connection_get_lines_received(client.connection) <
+	      lines + 3)
+	{
+		g_main_context_iteration(NULL, TRUE);
+	}
+	g_assert_true(purple_chat_conversation_has_user(chat, "alice"));
+	g_assert_true(purple_chat_conversation_has_user(chat, "bob"));
+
+	/* ...and then everyone leaves at once. */
+	test_ircv3_server_send(client.server, ":stand.in BATCH -ns");
+	while(purple_chat_conversation_has_user(chat, "alice")) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+	g_assert_false(purple_chat_conversation_has_user(chat, "bob"));
+	g_assert_true(purple_chat_conversation_has_user(chat, "carol"));
+	g_assert_true(purple_chat_conversation_has_user(chat, TEST_IRCV3_NICK));
+
+	test_ircv3_client_disconnect(&client);
+}
+
+static void
+test_ircv3_loopback_chathistory(void) {
+	TestIRCv3Client client = { NULL };
+	PurpleHistoryManager *manager = NULL;
+	PurpleIRCv3History *history = NULL;
+	GList *messages = NULL;
+	GError *error = NULL;
+
+	test_ircv3_client_connect(&client);
+	test_ircv3_client_join(&client, "#history");
+	history = test_ircv3_client_wait_for_history(&client, "#history");
+
+	/* The server limits us to pages of 50, so 120 messages take 3 pages
+	 * with the last one coming up short.
+	 */
+	g_assert_cmpuint(client.connection->history_page_size, ==,
+	                 TEST_IRCV3_HISTORY_PAGE);
+	g_assert_cmpuint(client.server->history_requests, ==, 3);
+	g_assert_cmpuint(history->fetched, ==, TEST_IRCV3_HISTORY_TOTAL);
+	g_assert_cmpstr(history->oldest, ==,
+	                g_ptr_array_index(client.server->history, 0));
+
+	manager = purple_history_manager_get_default();
+	messages = purple_history_manager_query(manager, "in:#history", &error);
+	g_assert_no_error(error);
+	g_assert_cmpuint(g_list_length(messages), ==, TEST_IRCV3_HISTORY_TOTAL);
+	g_list_free_full(messages, g_object_unref);
+
+	test_ircv3_client_disconnect(&client);
+}
+
+/* Not a pass/fail test, this reports how fast we get through a large burst
+ * of tagged messages from the server.
+ */
+static void
+test_ircv3_loopback_throughput(void) {
+	TestIRCv3Client client = { NULL };
+	GString *burst = NULL;
+	GBytes *bytes = NULL;
+	guint64 start_lines = 0;
+	gint64 start = 0, elapsed = 0;
+
+	test_ircv3_client_connect(&client);
+
+	burst = g_string_new(NULL);
+	for(guint i = 0; i < TEST_IRCV3_BENCHMARK_LINES; i++) {
+		g_string_append_printf(burst,
+		                       "@time=2022-01-01T00:00:00.000Z;msgid=%u;"
+		                       "+example/tag=a\\sb :nick%u!user@host PRIVMSG "
+		                       "#elsewhere :message number %u\r\n",
+		                       i, i % 100, i);
+	}
+	bytes = g_string_free_to_bytes(burst);
+
+	start_lines = purple_ircv3_connection_get_lines_received(client.connection);
+	start = g_get_monotonic_time();
+
+	purple_queued_output_stream_push_bytes_async(client.server->output, bytes,
+	                                             G_PRIORITY_DEFAULT, NULL,
+	                                             NULL, NULL);
+	g_bytes_unref(bytes);
+
+	while(purple_ircv3_connection_get_lines_received(client.connection) -
+	      start_lines < TEST_IRCV3_BENCHMARK_LINES)
+	{
+		g_main_context_iteration(NULL, TRUE);
+	}
+	elapsed = g_get_monotonic_time() - start;
+
+	g_test_message("%u lines in %" G_GINT64_FORMAT " us (%.0f lines/s)",
+	               TEST_IRCV3_BENCHMARK_LINES, elapsed,
+	               TEST_IRCV3_BENCHMARK_LINES *
+	               (G_USEC_PER_SEC / (gdouble)MAX(elapsed, 1)));
+
+	test_ircv3_client_disconnect(&client);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+
+	g_test_add_func("/ircv3/loopback/registration",
+	                test_ircv3_loopback_registration);
+	g_test_add_func("/ircv3/loopback/names", test_ircv3_loopback_names);
+	g_test_add_func("/ircv3/loopback/netsplit",
+	                test_ircv3_loopback_netsplit);
+	g_test_add_func("/ircv3/loopback/chathistory",
+	                test_ircv3_loopback_chathistory);
+
+	if(g_test_perf()) {
+		g_test_add_func("/ircv3/loopback/throughput",
+		                test_ircv3_loopback_throughput);
+	}
+
+	return g_test_run();
+}
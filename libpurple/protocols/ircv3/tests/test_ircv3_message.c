@@ -0,0 +1,281 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include "protocols/ircv3/purpleircv3capabilities.h"
+#include "protocols/ircv3/purpleircv3message.h"
+
+static PurpleIRCv3Message *
+test_ircv3_message_parse(const gchar *line) {
+	PurpleIRCv3Message *message = NULL;
+	GError *error = NULL;
+
+	message = purple_ircv3_message_parse(g_strdup(line), &error);
+	g_assert_no_error(error);
+	g_assert_nonnull(message);
+
+	return message;
+}
+
+/******************************************************************************
+ * Message Tests
+ *****************************************************************************/
+static void
+test_ircv3_message_command_only(void) {
+	PurpleIRCv3Message *message = test_ircv3_message_parse("PING\r\n");
+
+	g_assert_cmpstr(purple_ircv3_message_get_command(message), ==, "PING");
+	g_assert_null(purple_ircv3_message_get_nick(message));
+	g_assert_cmpuint(purple_ircv3_message_get_n_params(message), ==, 0);
+	g_assert_cmpuint(purple_ircv3_message_get_n_tags(message), ==, 0);
+	g_assert_null(purple_ircv3_message_get_param(message, 0));
+
+	purple_ircv3_message_free(message);
+}
+
+static void
+test_ircv3_message_source(void) {
+	PurpleIRCv3Message *message = NULL;
+
+	message = test_ircv3_message_parse(":nick!user@host.example PRIVMSG "
+	                                   "#chan :hello there");
+
+	g_assert_cmpstr(purple_ircv3_message_get_nick(message), ==, "nick");
+	g_assert_cmpstr(purple_ircv3_message_get_user(message), ==, "user");
+	g_assert_cmpstr(purple_ircv3_message_get_host(message), ==,
+	                "host.example");
+	g_assert_cmpstr(purple_ircv3_message_get_command(message), ==,
+	                "PRIVMSG");
+	g_assert_cmpuint(purple_ircv3_message_get_n_params(message), ==, 2);
+	g_assert_cmpstr(purple_ircv3_message_get_param(message, 0), ==, "#chan");
+	g_assert_cmpstr(purple_ircv3_message_get_param(message, 1), ==,
+	                "hello there");
+
+	purple_ircv3_message_free(message);
+}
+
+static void
+test_ircv3_message_params(void) {
+	PurpleIRCv3Message *message = NULL;
+
+	message = test_ircv3_message_parse(":irc.example 005 nick  CHATHISTORY=50 "
+	                                   "NETWORK=Example :are supported");
+
+	g_assert_cmpstr(purple_ircv3_message_get_nick(message), ==,
+	                "irc.example");
+	g_assert_null(purple_ircv3_message_get_user(message));
+	g_assert_cmpuint(purple_ircv3_message_get_n_params(message), ==, 4);
+	g_assert_cmpstr(purple_ircv3_message_get_param(message, 1), ==,
+	                "CHATHISTORY=50");
+	g_assert_cmpstr(purple_ircv3_message_get_param(message, 3), ==,
+	                "are supported");
+
+	purple_ircv3_message_free(message);
+}
+
+static void
+test_ircv3_message_empty_trailing(void) {
+	PurpleIRCv3Message *message = NULL;
+
+	message = test_ircv3_message_parse("TOPIC #chan :");
+
+	g_assert_cmpuint(purple_ircv3_message_get_n_params(message), ==, 2);
+	g_assert_cmpstr(purple_ircv3_message_get_param(message, 1), ==, "");
+
+	purple_ircv3_message_free(message);
+}
+
+static void
+test_ircv3_message_max_params(void) {
+	PurpleIRCv3Message *message = NULL;
+
+	message = test_ircv3_message_parse("CMD 1 2 3 4 5 6 7 8 9 10 11 12 13 14 "
+	                                   "15 16 17");
+
+	g_assert_cmpuint(purple_ircv3_message_get_n_params(message), ==, 15);
+	g_assert_cmpstr(purple_ircv3_message_get_param(message, 13), ==, "14");
+	g_assert_cmpstr(purple_ircv3_message_get_param(message, 14), ==,
+	                "15 16 17");
+
+	purple_ircv3_message_free(message);
+}
+
+static void
+test_ircv3_message_tags(void) {
+	PurpleIRCv3Message *message = NULL;
+
+	message = test_ircv3_message_parse("@batch=ref;+example/flag;;"
+	                                   "msgid=abc :nick PRIVMSG #chan :hi");
+
+	g_assert_cmpuint(purple_ircv3_message_get_n_tags(message), ==, 3);
+	g_assert_cmpstr(purple_ircv3_message_get_tag(message, "batch"), ==, "ref");
+	g_assert_cmpstr(purple_ircv3_message_get_tag(message, "+example/flag"), ==,
+	                "");
+	g_assert_cmpstr(purple_ircv3_message_get_tag(message, "msgid"), ==, "abc");
+	g_assert_null(purple_ircv3_message_get_tag(message, "time"));
+	g_assert_cmpstr(purple_ircv3_message_get_command(message), ==, "PRIVMSG");
+
+	purple_ircv3_message_free(message);
+}
+
+static void
+test_ircv3_message_tags_escaped(void) {
+	PurpleIRCv3Message *message = NULL;
+
+	message = test_ircv3_message_parse("@a=one\\:two\\sthree\\\\\\r\\n;"
+	                                   "b=x\\yz;c=trailing\\ PING");
+
+	g_assert_cmpstr(purple_ircv3_message_get_tag(message, "a"), ==,
+	                "one;two three\\\r\n");
+	g_assert_cmpstr(purple_ircv3_message_get_tag(message, "b"), ==, "xyz");
+	g_assert_cmpstr(purple_ircv3_message_get_tag(message, "c"), ==,
+	                "trailing");
+
+	/* Looking a value up again must not unescape it twice. */
+	g_assert_cmpstr(purple_ircv3_message_get_tag(message, "a"), ==,
+	                "one;two three\\\r\n");
+
+	purple_ircv3_message_free(message);
+}
+
+static void
+test_ircv3_message_tags_duplicate(void) {
+	PurpleIRCv3Message *message = NULL;
+
+	message = test_ircv3_message_parse("@a=1;a=2 PING");
+
+	g_assert_cmpstr(purple_ircv3_message_get_tag(message, "a"), ==, "2");
+
+	purple_ircv3_message_free(message);
+}
+
+static void
+test_ircv3_message_server_time(void) {
+	PurpleIRCv3Message *message = NULL;
+	GDateTime *dt = NULL;
+
+	message = test_ircv3_message_parse("@time=2022-03-04T05:06:07.089Z PING");
+
+	dt = purple_ircv3_message_get_server_time(message);
+	g_assert_nonnull(dt);
+	g_assert_cmpint(g_date_time_get_year(dt), ==, 2022);
+	g_assert_cmpint(g_date_time_get_month(dt), ==, 3);
+	g_assert_cmpint(g_date_time_get_second(dt), ==, 7);
+	g_assert_cmpint(g_date_time_get_microsecond(dt), ==, 89000);
+	g_date_time_unref(dt);
+
+	purple_ircv3_message_free(message);
+}
+
+static void
+test_ircv3_message_no_command(void) {
+	PurpleIRCv3Message *message = NULL;
+	GError *error = NULL;
+
+	message = purple_ircv3_message_parse(g_strdup("@a=b :source"), &error);
+	g_assert_error(error, g_quark_from_static_string("ircv3-plugin"), 0);
+	g_assert_null(message);
+
+	g_clear_error(&error);
+}
+
+/******************************************************************************
+ * Capabilities Tests
+ *****************************************************************************/
+static void
+test_ircv3_capabilities_request(void) {
+	PurpleIRCv3Capabilities *caps = purple_ircv3_capabilities_new();
+	gchar *request = NULL;
+
+	g_assert_null(purple_ircv3_capabilities_build_request(caps));
+
+	purple_ircv3_capabilities_add_available(caps, "sasl=PLAIN,EXTERNAL "
+	                                        "server-time");
+	purple_ircv3_capabilities_add_available(caps, "echo-message  batch "
+	                                        "draft/chathistory");
+
+	g_assert_cmpstr(purple_ircv3_capabilities_get_value(caps, "sasl"), ==,
+	                "PLAIN,EXTERNAL");
+	g_assert_cmpstr(purple_ircv3_capabilities_get_value(caps, "batch"), ==,
+	                "");
+	g_assert_null(purple_ircv3_capabilities_get_value(caps, "chathistory"));
+
+	request = purple_ircv3_capabilities_build_request(caps);
+	g_assert_cmpstr(request, ==,
+	                "batch draft/chathistory echo-message server-time");
+	g_free(request);
+
+	purple_ircv3_capabilities_free(caps);
+}
+
+static void
+test_ircv3_capabilities_acknowledge(void) {
+	PurpleIRCv3Capabilities *caps = purple_ircv3_capabilities_new();
+
+	g_assert_null(purple_ircv3_capabilities_get_chathistory(caps));
+
+	purple_ircv3_capabilities_acknowledge(caps, "batch draft/chathistory "
+	                                      "echo-message");
+	g_assert_true(purple_ircv3_capabilities_is_enabled(caps, "batch"));
+	g_assert_true(purple_ircv3_capabilities_is_enabled(caps, "echo-message"));
+	g_assert_false(purple_ircv3_capabilities_is_enabled(caps, "server-time"));
+	g_assert_cmpstr(purple_ircv3_capabilities_get_chathistory(caps), ==,
+	                "draft/chathistory");
+
+	purple_ircv3_capabilities_acknowledge(caps, "-echo-message chathistory");
+	g_assert_false(purple_ircv3_capabilities_is_enabled(caps,
+	                                                    "echo-message"));
+	g_assert_cmpstr(purple_ircv3_capabilities_get_chathistory(caps), ==,
+	                "chathistory");
+
+	purple_ircv3_capabilities_free(caps);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar *argv[]) {
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/ircv3/message/command-only",
+	                test_ircv3_message_command_only);
+	g_test_add_func("/ircv3/message/source", test_ircv3_message_source);
+	g_test_add_func("/ircv3/message/params", test_ircv3_message_params);
+	g_test_add_func("/ircv3/message/empty-trailing",
+	                test_ircv3_message_empty_trailing);
+	g_test_add_func("/ircv3/message/max-params",
+	                test_ircv3_message_max_params);
+	g_test_add_func("/ircv3/message/tags", test_ircv3_message_tags);
+	g_test_add_func("/ircv3/message/tags/escaped",
+	                test_ircv3_message_tags_escaped);
+	g_test_add_func("/ircv3/message/tags/duplicate",
+	                test_ircv3_message_tags_duplicate);
+	g_test_add_func("/ircv3/message/server-time",
+	                test_ircv3_message_server_time);
+	g_test_add_func("/ircv3/message/no-command",
+	                test_ircv3_message_no_command);
+
+	g_test_add_func("/ircv3/capabilities/request",
+	                test_ircv3_capabilities_request);
+	g_test_add_func("/ircv3/capabilities/acknowledge",
+	                test_ircv3_capabilities_acknowledge);
+
+	return g_test_run();
+}
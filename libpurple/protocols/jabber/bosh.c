@@ -34,12 +34,36 @@ TODO: test, what happens, if the http server (BOSH server) doesn't support
 keep-alive (sends connection: close).
 */
 
-#define JABBER_BOSH_SEND_DELAY 250
-
 #define JABBER_BOSH_TIMEOUT 10
 
+/* The most requests we'll keep in flight, whatever the server allows. */
+#define JABBER_BOSH_MAX_REQUESTS 8
+
+/* Room left at the start of each request body for the <body> tag, which
+ * can only be written once we know the rid it's sent with. */
+#define JABBER_BOSH_HEADER_RESERVE 256
+
+/* Request bodies kept around for reuse, and the biggest one worth keeping. */
+#define JABBER_BOSH_BODY_POOL_SIZE 4
+#define JABBER_BOSH_BODY_POOL_MAX_ALLOC (64 * 1024)
+
 static gchar *jabber_bosh_useragent = NULL;
 
+static GQueue jabber_bosh_body_pool = G_QUEUE_INIT;
+G_LOCK_DEFINE_STATIC(jabber_bosh_body_pool);
+
+/* A request in flight.  They're kept in rid order so responses are handled
+ * in the order the server meant them to be, even if they come back out of
+ * order over separate HTTP connections. */
+typedef struct {
+	PurpleJabberBOSHConnection *conn;
+	guint64 rid;
+
+	/* The parsed response, once it's back but waiting on an earlier one. */
+	PurpleXmlNode *response;
+	gboolean done;
+} JabberBOSHRequest;
+
 struct _PurpleJabberBOSHConnection {
 	JabberStream *js;
 	SoupSession *payload_reqs;
@@ -51,17 +75,69 @@ struct _PurpleJabberBOSHConnection {
 	gchar *sid;
 	guint64 rid; /* Must be big enough to hold 2^53 - 1 */
 
-	GString *send_buff;
+	/* The "requests" attribute of the session creation response. */
+	guint max_requests;
+	guint in_flight;
+	GQueue requests;
+
+	/* The next request body, with stanzas written after the reserve. */
+	GString *body;
+	GString *header;
 	guint send_timer;
 };
 
 static SoupMessage *jabber_bosh_connection_http_request_new(
-        PurpleJabberBOSHConnection *conn, const GString *data);
+        PurpleJabberBOSHConnection *conn, GString *body, gsize offset);
 static void
 jabber_bosh_connection_session_create(PurpleJabberBOSHConnection *conn);
 static void
 jabber_bosh_connection_send_now(PurpleJabberBOSHConnection *conn);
 
+static GString *
+jabber_bosh_body_new(void)
+{
+	GString *body;
+
+	G_LOCK(jabber_bosh_body_pool);
+	body = g_queue_pop_head(&jabber_bosh_body_pool);
+	G_UNLOCK(jabber_bosh_body_pool);
+
+	if (body == NULL)
+		body = g_string_sized_new(1024);
+
+	/* Filler for the <body> tag, see jabber_bosh_connection_send_now(). */
+	g_string_set_size(body, JABBER_BOSH_HEADER_RESERVE);
+	memset(body->str, ' ', JABBER_BOSH_HEADER_RESERVE);
+
+	return body;
+}
+
+static void
+jabber_bosh_body_release(gpointer data)
+{
+	GString *body = data;
+
+	G_LOCK(jabber_bosh_body_pool);
+	if (body->allocated_len <= JABBER_BOSH_BODY_POOL_MAX_ALLOC &&
+	    jabber_bosh_body_pool.length < JABBER_BOSH_BODY_POOL_SIZE)
+	{
+		g_queue_push_head(&jabber_bosh_body_pool, body);
+		body = NULL;
+	}
+	G_UNLOCK(jabber_bosh_body_pool);
+
+	if (body != NULL)
+		g_string_free(body, TRUE);
+}
+
+static void
+jabber_bosh_request_free(JabberBOSHRequest *request)
+{
+	if (request->response != NULL)
+		purple_xmlnode_free(request->response);
+	g_free(request);
+}
+
 void
 jabber_bosh_init(void)
 {
@@ -87,6 +163,10 @@ void jabber_bosh_uninit(void)
 {
 	g_free(jabber_bosh_useragent);
 	jabber_bosh_useragent = NULL;
+
+	G_LOCK(jabber_bosh_body_pool);
+	g_queue_clear_full(&jabber_bosh_body_pool, (GDestroyNotify)g_string_free);
+	G_UNLOCK(jabber_bosh_body_pool);
 }
 
 PurpleJabberBOSHConnection*
@@ -121,11 +201,16 @@ jabber_bosh_connection_new(JabberStream *js, const gchar *url)
 	        "proxy-resolver", resolver,
 	        "timeout", JABBER_BOSH_TIMEOUT + 2,
 	        "user-agent", jabber_bosh_useragent,
+	        "max-conns-per-host", JABBER_BOSH_MAX_REQUESTS,
 	        NULL);
 	conn->url = g_strdup(url);
 	conn->js = js;
 	conn->is_ssl = g_str_equal(scheme, "https");
-	conn->send_buff = g_string_new(NULL);
+	conn->header = g_string_new(NULL);
+	/* Until the server tells us otherwise, one request may be held and one
+	 * more can carry stanzas. */
+	conn->max_requests = 2;
+	g_queue_init(&conn->requests);
 
 	/*
 	 * Random 64-bit integer masked off by 2^52 - 1.
@@ -163,8 +248,14 @@ jabber_bosh_connection_destroy(PurpleJabberBOSHConnection *conn)
 	soup_session_abort(conn->payload_reqs);
 
 	g_clear_object(&conn->payload_reqs);
-	g_string_free(conn->send_buff, TRUE);
-	conn->send_buff = NULL;
+	g_queue_clear_full(&conn->requests,
+	                   (GDestroyNotify)jabber_bosh_request_free);
+	if (conn->body != NULL) {
+		jabber_bosh_body_release(conn->body);
+		conn->body = NULL;
+	}
+	g_string_free(conn->header, TRUE);
+	conn->header = NULL;
 
 	g_free(conn->sid);
 	conn->sid = NULL;
@@ -221,22 +312,11 @@ jabber_bosh_connection_parse(PurpleJabberBOSHConnection *conn,
 }
 
 static void
-jabber_bosh_connection_recv(SoupSession *session, SoupMessage *msg,
-                            gpointer user_data)
+jabber_bosh_connection_process(PurpleJabberBOSHConnection *bosh_conn,
+                               PurpleXmlNode *node)
 {
-	PurpleJabberBOSHConnection *bosh_conn = user_data;
-	PurpleXmlNode *node, *child;
+	PurpleXmlNode *child = node->child;
 
-	if (purple_debug_is_verbose() && purple_debug_is_unsafe()) {
-		purple_debug_misc("jabber-bosh", "received: %s\n",
-		                  msg->response_body->data);
-	}
-
-	node = jabber_bosh_connection_parse(bosh_conn, msg);
-	if (node == NULL)
-		return;
-
-	child = node->child;
 	while (child != NULL) {
 		/* jabber_process_packet might free child */
 		PurpleXmlNode *next = child->next;
@@ -263,15 +343,85 @@ jabber_bosh_connection_recv(SoupSession *session, SoupMessage *msg,
 
 		child = next;
 	}
+}
+
+/* Sends whatever is waiting if a request slot is free, or an empty request
+ * if none is left for the server to hold on to. */
+static void
+jabber_bosh_connection_pump(PurpleJabberBOSHConnection *conn)
+{
+	gboolean have_data;
+
+	if (conn->sid == NULL || conn->is_terminating)
+		return;
+
+	if (conn->in_flight >= conn->max_requests)
+		return;
+
+	have_data = conn->body != NULL &&
+		conn->body->len > JABBER_BOSH_HEADER_RESERVE;
+
+	if (have_data || conn->js->reinit || conn->in_flight == 0)
+		jabber_bosh_connection_send_now(conn);
+}
+
+static void
+jabber_bosh_connection_recv(SoupSession *session, SoupMessage *msg,
+                            gpointer user_data)
+{
+	JabberBOSHRequest *request = user_data;
+	PurpleJabberBOSHConnection *bosh_conn = request->conn;
+	JabberBOSHRequest *head;
+	PurpleXmlNode *node;
+
+	bosh_conn->in_flight--;
+
+	if (purple_debug_is_verbose() && purple_debug_is_unsafe()) {
+		purple_debug_misc("jabber-bosh", "received (rid %" G_GUINT64_FORMAT
+		                  "): %s\n", request->rid, msg->response_body->data);
+	}
+
+	node = jabber_bosh_connection_parse(bosh_conn, msg);
+	if (node == NULL) {
+		g_queue_remove(&bosh_conn->requests, request);
+		jabber_bosh_request_free(request);
+
+		/* Unless the connection is going away, drop the bad response and
+		 * carry on, so it doesn't hold up the ones queued behind it. */
+		if (bosh_conn->is_terminating ||
+		    purple_connection_get_error_info(bosh_conn->js->gc) != NULL ||
+		    purple_account_is_disconnecting(
+		        purple_connection_get_account(bosh_conn->js->gc)))
+		{
+			return;
+		}
+	} else {
+		request->response = node;
+		request->done = TRUE;
+	}
 
-	jabber_bosh_connection_send(bosh_conn, NULL);
+	/* Handle everything that's ready, in rid order. */
+	while ((head = g_queue_peek_head(&bosh_conn->requests)) != NULL &&
+	       head->done)
+	{
+		g_queue_pop_head(&bosh_conn->requests);
+		jabber_bosh_connection_process(bosh_conn, head->response);
+		jabber_bosh_request_free(head);
+
+		if (bosh_conn->is_terminating)
+			return;
+	}
+
+	jabber_bosh_connection_pump(bosh_conn);
 }
 
 static void
 jabber_bosh_connection_send_now(PurpleJabberBOSHConnection *conn)
 {
+	JabberBOSHRequest *request;
 	SoupMessage *req;
-	GString *data;
+	GString *body;
+	gsize offset;
 
 	g_return_if_fail(conn != NULL);
 
@@ -283,10 +433,8 @@ jabber_bosh_connection_send_now(PurpleJabberBOSHConnection *conn)
 	if (conn->sid == NULL)
 		return;
 
-	data = g_string_new(NULL);
-
 	/* missing parameters: route, from, ack */
-	g_string_printf(data, "<body "
+	g_string_printf(conn->header, "<body "
 		"rid='%" G_GUINT64_FORMAT "' "
 		"sid='%s' "
 		"xmlns='" NS_BOSH "' "
@@ -294,32 +442,51 @@ jabber_bosh_connection_send_now(PurpleJabberBOSHConnection *conn)
 		++conn->rid, conn->sid);
 
 	if (conn->js->reinit && !conn->is_terminating) {
-		g_string_append(data, "xmpp:restart='true'/>");
+		/* A restart can't carry stanzas, those wait for the next request. */
+		body = jabber_bosh_body_new();
+		g_string_append(body, "xmpp:restart='true'/>");
 		conn->js->reinit = FALSE;
 	} else {
+		body = conn->body ? conn->body : jabber_bosh_body_new();
+		conn->body = NULL;
+
 		if (conn->is_terminating)
-			g_string_append(data, "type='terminate' ");
-		g_string_append_c(data, '>');
-		g_string_append_len(data, conn->send_buff->str,
-			conn->send_buff->len);
-		g_string_append(data, "</body>");
-		g_string_set_size(conn->send_buff, 0);
+			g_string_append(conn->header, "type='terminate' ");
+		g_string_append_c(conn->header, '>');
+		g_string_append(body, "</body>");
+	}
+
+	/* The stanzas were written straight into the body, so put the tag in
+	 * front of them in the room that was left for it. */
+	if (conn->header->len <= JABBER_BOSH_HEADER_RESERVE) {
+		offset = JABBER_BOSH_HEADER_RESERVE - conn->header->len;
+		memcpy(body->str + offset, conn->header->str, conn->header->len);
+	} else {
+		g_string_erase(body, 0, JABBER_BOSH_HEADER_RESERVE);
+		g_string_prepend_len(body, conn->header->str, conn->header->len);
+		offset = 0;
 	}
 
 	if (purple_debug_is_verbose() && purple_debug_is_unsafe())
-		purple_debug_misc("jabber-bosh", "sending: %s\n", data->str);
+		purple_debug_misc("jabber-bosh", "sending: %s\n", body->str + offset);
 
-	req = jabber_bosh_connection_http_request_new(conn, data);
-	g_string_free(data, FALSE);
+	req = jabber_bosh_connection_http_request_new(conn, body, offset);
 
 	if (conn->is_terminating) {
 		soup_session_send_async(conn->payload_reqs, req, NULL, NULL, NULL);
 		g_free(conn->sid);
 		conn->sid = NULL;
-	} else {
-		soup_session_queue_message(conn->payload_reqs, req,
-		                           jabber_bosh_connection_recv, conn);
+		return;
 	}
+
+	request = g_new0(JabberBOSHRequest, 1);
+	request->conn = conn;
+	request->rid = conn->rid;
+	g_queue_push_tail(&conn->requests, request);
+	conn->in_flight++;
+
+	soup_session_queue_message(conn->payload_reqs, req,
+	                           jabber_bosh_connection_recv, request);
 }
 
 static gboolean
@@ -328,7 +495,7 @@ jabber_bosh_connection_send_delayed(gpointer _conn)
 	PurpleJabberBOSHConnection *conn = _conn;
 
 	conn->send_timer = 0;
-	jabber_bosh_connection_send_now(conn);
+	jabber_bosh_connection_pump(conn);
 
 	return FALSE;
 }
@@ -339,12 +506,15 @@ jabber_bosh_connection_send(PurpleJabberBOSHConnection *conn,
 {
 	g_return_if_fail(conn != NULL);
 
-	if (data)
-		g_string_append(conn->send_buff, data);
+	if (data) {
+		if (conn->body == NULL)
+			conn->body = jabber_bosh_body_new();
+		g_string_append(conn->body, data);
+	}
 
+	/* Stanzas sent in the same main loop iteration share a request. */
 	if (conn->send_timer == 0) {
-		conn->send_timer = g_timeout_add(
-			JABBER_BOSH_SEND_DELAY,
+		conn->send_timer = g_idle_add(
 			jabber_bosh_connection_send_delayed, conn);
 	}
 }
@@ -354,7 +524,16 @@ jabber_bosh_connection_send_keepalive(PurpleJabberBOSHConnection *conn)
 {
 	g_return_if_fail(conn != NULL);
 
-	jabber_bosh_connection_send_now(conn);
+	if (conn->in_flight < conn->max_requests)
+		jabber_bosh_connection_send_now(conn);
+}
+
+guint
+jabber_bosh_connection_get_requests_in_flight(const PurpleJabberBOSHConnection *conn)
+{
+	g_return_val_if_fail(conn != NULL, 0);
+
+	return conn->in_flight;
 }
 
 static gboolean
@@ -384,9 +563,11 @@ jabber_bosh_connection_session_created(SoupSession *session, SoupMessage *msg,
 {
 	PurpleJabberBOSHConnection *bosh_conn = user_data;
 	PurpleXmlNode *node, *features;
-	const gchar *sid, *ver, *inactivity_str;
+	const gchar *sid, *ver, *inactivity_str, *requests_str;
 	int inactivity = 0;
 
+	bosh_conn->in_flight--;
+
 	if (purple_debug_is_verbose() && purple_debug_is_unsafe()) {
 		purple_debug_misc("jabber-bosh", "received (session creation): %s\n",
 		                  msg->response_body->data);
@@ -399,7 +580,7 @@ jabber_bosh_connection_session_created(SoupSession *session, SoupMessage *msg,
 	sid = purple_xmlnode_get_attrib(node, "sid");
 	ver = purple_xmlnode_get_attrib(node, "ver");
 	inactivity_str = purple_xmlnode_get_attrib(node, "inactivity");
-	/* requests = purple_xmlnode_get_attrib(node, "requests"); */
+	requests_str = purple_xmlnode_get_attrib(node, "requests");
 
 	if (!sid) {
 		purple_connection_error(bosh_conn->js->gc,
@@ -425,6 +606,17 @@ jabber_bosh_connection_session_created(SoupSession *session, SoupMessage *msg,
 
 	bosh_conn->sid = g_strdup(sid);
 
+	if (requests_str != NULL) {
+		int requests = atoi(requests_str);
+
+		if (requests < 1) {
+			purple_debug_warning("jabber-bosh", "Ignoring invalid "
+				"requests value: %s\n", requests_str);
+		} else {
+			bosh_conn->max_requests = MIN(requests, JABBER_BOSH_MAX_REQUESTS);
+		}
+	}
+
 	if (inactivity_str)
 		inactivity = atoi(inactivity_str);
 	if (inactivity < 0 || inactivity > 3600) {
@@ -453,7 +645,7 @@ jabber_bosh_connection_session_created(SoupSession *session, SoupMessage *msg,
 
 	purple_xmlnode_free(node);
 
-	jabber_bosh_connection_send(bosh_conn, NULL);
+	jabber_bosh_connection_pump(bosh_conn);
 }
 
 static void
@@ -465,7 +657,8 @@ jabber_bosh_connection_session_create(PurpleJabberBOSHConnection *conn)
 	purple_debug_misc("jabber-bosh", "Requesting Session Create for %p\n",
 		conn);
 
-	data = g_string_new(NULL);
+	data = jabber_bosh_body_new();
+	g_string_truncate(data, 0);
 
 	/* missing optional parameters: route, from, ack */
 	g_string_printf(data, "<body content='text/xml; charset=utf-8' "
@@ -481,16 +674,18 @@ jabber_bosh_connection_session_create(PurpleJabberBOSHConnection *conn)
 		"/>",
 		++conn->rid, conn->js->user->domain, JABBER_BOSH_TIMEOUT);
 
-	req = jabber_bosh_connection_http_request_new(conn, data);
-	g_string_free(data, FALSE);
+	req = jabber_bosh_connection_http_request_new(conn, data, 0);
+	conn->in_flight++;
 
 	soup_session_queue_message(conn->payload_reqs, req,
 	                           jabber_bosh_connection_session_created, conn);
 }
 
+/* Takes ownership of data, which goes back to the pool once the request
+ * is done with it. */
 static SoupMessage *
 jabber_bosh_connection_http_request_new(PurpleJabberBOSHConnection *conn,
-                                        const GString *data)
+                                        GString *data, gsize offset)
 {
 	SoupMessage *req;
 	GBytes *body = NULL;
@@ -498,7 +693,8 @@ jabber_bosh_connection_http_request_new(PurpleJabberBOSHConnection *conn,
 	jabber_stream_restart_inactivity_timer(conn->js);
 
 	req = soup_message_new("POST", conn->url);
-	body = g_bytes_new_take(data->str, data->len);
+	body = g_bytes_new_with_free_func(data->str + offset, data->len - offset,
+	                                  jabber_bosh_body_release, data);
 	soup_message_set_request_body_from_bytes(req, "text/xml; charset=utf-8",
 	                                         body);
 	g_bytes_unref(body);
@@ -52,4 +52,7 @@ jabber_bosh_connection_send(PurpleJabberBOSHConnection *conn,
 void
 jabber_bosh_connection_send_keepalive(PurpleJabberBOSHConnection *conn);
 
+guint
+jabber_bosh_connection_get_requests_in_flight(const PurpleJabberBOSHConnection *conn);
+
 #endif /* PURPLE_JABBER_BOSH_H */
@@ -28,6 +28,18 @@
 #include "ibb.h"
 
 #define JABBER_IBB_SESSION_DEFAULT_BLOCK_SIZE 4096
+#define JABBER_IBB_SESSION_DEFAULT_WINDOW 8
+
+/* An IQ we're waiting on, either a <data/> block or, for message stanza
+   sessions, a ping that confirms the blocks sent before it */
+typedef struct {
+	JabberIBBSession *sess;
+	gchar *iq_id;
+	guint16 seq;
+	/* number of blocks this confirms */
+	guint count;
+	gboolean ping;
+} JabberIBBBlock;
 
 static GHashTable *jabber_ibb_sessions = NULL;
 static GList *open_handlers = NULL;
@@ -45,6 +57,7 @@ jabber_ibb_session_create(JabberStream *js, const gchar *sid, const gchar *who,
 	}
 	sess->who = g_strdup(who);
 	sess->block_size = JABBER_IBB_SESSION_DEFAULT_BLOCK_SIZE;
+	sess->window = JABBER_IBB_SESSION_DEFAULT_WINDOW;
 	sess->state = JABBER_IBB_SESSION_NOT_OPENED;
 	sess->user_data = user_data;
 
@@ -60,6 +73,7 @@ jabber_ibb_session_create_from_xmlnode(JabberStream *js, const char *from,
 	JabberIBBSession *sess = NULL;
 	const gchar *sid = purple_xmlnode_get_attrib(open, "sid");
 	const gchar *block_size = purple_xmlnode_get_attrib(open, "block-size");
+	const gchar *stanza = purple_xmlnode_get_attrib(open, "stanza");
 
 	if (!open) {
 		return NULL;
@@ -74,6 +88,9 @@ jabber_ibb_session_create_from_xmlnode(JabberStream *js, const char *from,
 	sess = jabber_ibb_session_create(js, sid, from, user_data);
 	sess->id = g_strdup(id);
 	sess->block_size = atoi(block_size);
+	if (purple_strequal(stanza, "message")) {
+		sess->stanza = JABBER_IBB_STANZA_MESSAGE;
+	}
 	/* if we create a session from an incoming <open/> request, it means the
 	  session is immediately open... */
 	sess->state = JABBER_IBB_SESSION_OPENED;
@@ -91,15 +108,19 @@ jabber_ibb_session_destroy(JabberIBBSession *sess)
 		jabber_ibb_session_close(sess);
 	}
 
-	if (sess->last_iq_id) {
+	while (!g_queue_is_empty(&sess->outstanding)) {
+		JabberIBBBlock *block = g_queue_pop_head(&sess->outstanding);
+
 		purple_debug_info("jabber", "IBB: removing callback for <iq/> %s\n",
-			sess->last_iq_id);
+			block->iq_id);
 		jabber_iq_remove_callback_by_id(jabber_ibb_session_get_js(sess),
-			sess->last_iq_id);
-		g_free(sess->last_iq_id);
-		sess->last_iq_id = NULL;
+			block->iq_id);
+		g_free(block->iq_id);
+		g_free(block);
 	}
 
+	g_clear_handle_id(&sess->sent_idle, g_source_remove);
+
 	g_hash_table_remove(jabber_ibb_sessions, sess->sid);
 	g_free(sess->id);
 	g_free(sess->sid);
@@ -160,6 +181,42 @@ jabber_ibb_session_set_block_size(JabberIBBSession *sess, gsize size)
 	}
 }
 
+JabberIBBStanzaType
+jabber_ibb_session_get_stanza_type(const JabberIBBSession *sess)
+{
+	return sess->stanza;
+}
+
+void
+jabber_ibb_session_set_stanza_type(JabberIBBSession *sess,
+	JabberIBBStanzaType stanza)
+{
+	if (jabber_ibb_session_get_state(sess) == JABBER_IBB_SESSION_NOT_OPENED) {
+		sess->stanza = stanza;
+	} else {
+		purple_debug_error("jabber",
+			"Can't set stanza type on an open IBB session\n");
+	}
+}
+
+guint
+jabber_ibb_session_get_window(const JabberIBBSession *sess)
+{
+	return sess->window;
+}
+
+void
+jabber_ibb_session_set_window(JabberIBBSession *sess, guint window)
+{
+	sess->window = MAX(window, 1);
+}
+
+guint
+jabber_ibb_session_get_outstanding(const JabberIBBSession *sess)
+{
+	return sess->in_flight + sess->unsynced;
+}
+
 gsize
 jabber_ibb_session_get_max_data_size(const JabberIBBSession *sess)
 {
@@ -214,6 +271,16 @@ jabber_ibb_session_opened_cb(JabberStream *js, const char *from,
 {
 	JabberIBBSession *sess = (JabberIBBSession *) data;
 
+	if (type == JABBER_IQ_ERROR &&
+	    sess->stanza == JABBER_IBB_STANZA_MESSAGE) {
+		/* the peer may only support <iq/> stanzas, try again with those */
+		purple_debug_info("jabber",
+			"IBB: message stanzas refused, falling back to <iq/>\n");
+		sess->stanza = JABBER_IBB_STANZA_IQ;
+		jabber_ibb_session_open(sess);
+		return;
+	}
+
 	if (type == JABBER_IQ_ERROR) {
 		sess->state = JABBER_IBB_SESSION_ERROR;
 	} else {
@@ -242,6 +309,9 @@ jabber_ibb_session_open(JabberIBBSession *sess)
 		g_snprintf(block_size, sizeof(block_size), "%" G_GSIZE_FORMAT,
 			jabber_ibb_session_get_block_size(sess));
 		purple_xmlnode_set_attrib(open, "block-size", block_size);
+		if (sess->stanza == JABBER_IBB_STANZA_MESSAGE) {
+			purple_xmlnode_set_attrib(open, "stanza", "message");
+		}
 		purple_xmlnode_insert_child(set->node, open);
 
 		jabber_iq_set_callback(set, jabber_ibb_session_opened_cb, sess);
@@ -285,35 +355,139 @@ jabber_ibb_session_accept(JabberIBBSession *sess)
 	sess->state = JABBER_IBB_SESSION_OPENED;
 }
 
+static gboolean
+jabber_ibb_session_can_send(const JabberIBBSession *sess)
+{
+	return jabber_ibb_session_get_state(sess) == JABBER_IBB_SESSION_OPENED &&
+		sess->in_flight + sess->unsynced < sess->window;
+}
+
+static gboolean
+jabber_ibb_session_sent_cb(gpointer data)
+{
+	JabberIBBSession *sess = (JabberIBBSession *) data;
+
+	sess->sent_idle = 0;
+
+	if (jabber_ibb_session_can_send(sess) && sess->data_sent_cb) {
+		sess->data_sent_cb(sess);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
 static void
 jabber_ibb_session_send_acknowledge_cb(JabberStream *js, const char *from,
                                        JabberIqType type, const char *id,
                                        PurpleXmlNode *packet, gpointer data)
 {
-	JabberIBBSession *sess = (JabberIBBSession *) data;
-
-	if (sess) {
-		/* reset callback */
-		g_free(sess->last_iq_id);
-		sess->last_iq_id = NULL;
-
-		if (type == JABBER_IQ_ERROR) {
-			jabber_ibb_session_close(sess);
-			sess->state = JABBER_IBB_SESSION_ERROR;
+	JabberIBBBlock *block = (JabberIBBBlock *) data;
+	JabberIBBSession *sess = block->sess;
+	gboolean ping = block->ping;
+	guint16 seq = block->seq;
+
+	g_queue_remove(&sess->outstanding, block);
+	sess->in_flight -= block->count;
+	g_free(block->iq_id);
+	g_free(block);
+
+	if (jabber_ibb_session_get_state(sess) != JABBER_IBB_SESSION_OPENED) {
+		return;
+	}
 
-			if (sess->error_cb) {
-				sess->error_cb(sess);
-			}
+	/* an error, including a ping that timed out, says nothing about whether
+	   the blocks got there, so the session can't go on */
+	if (type == JABBER_IQ_ERROR) {
+		if (ping) {
+			purple_debug_error("jabber",
+				"IBB: sync before block %u failed\n", seq);
 		} else {
-			if (sess->data_sent_cb) {
-				sess->data_sent_cb(sess);
-			}
+			purple_debug_error("jabber", "IBB: block %u was rejected\n", seq);
+		}
+		jabber_ibb_session_close(sess);
+		sess->state = JABBER_IBB_SESSION_ERROR;
+
+		if (sess->error_cb) {
+			sess->error_cb(sess);
 		}
+	} else if (sess->sent_idle == 0 && sess->data_sent_cb) {
+		/* otherwise the idle callback will tell them */
+		sess->data_sent_cb(sess);
+	}
+}
+
+static void
+jabber_ibb_session_track(JabberIBBSession *sess, JabberIq *iq, guint count,
+                         gboolean ping)
+{
+	JabberIBBBlock *block = g_new0(JabberIBBBlock, 1);
+
+	block->sess = sess;
+	block->seq = sess->send_seq;
+	block->count = count;
+	block->ping = ping;
+	block->iq_id = g_strdup(purple_xmlnode_get_attrib(iq->node, "id"));
+
+	jabber_iq_set_callback(iq, jabber_ibb_session_send_acknowledge_cb, block);
+	g_queue_push_tail(&sess->outstanding, block);
+	sess->in_flight += count;
+}
+
+/* message stanzas aren't acknowledged, so every so often we ping the peer,
+   and when the answer comes back everything sent before it has arrived */
+static void
+jabber_ibb_session_sync(JabberIBBSession *sess)
+{
+	JabberIq *get = jabber_iq_new(jabber_ibb_session_get_js(sess),
+		JABBER_IQ_GET);
+	PurpleXmlNode *ping = purple_xmlnode_new_child(get->node, "ping");
+
+	purple_xmlnode_set_attrib(get->node, "to", jabber_ibb_session_get_who(sess));
+	purple_xmlnode_set_namespace(ping, NS_PING);
+
+	jabber_ibb_session_track(sess, get, sess->unsynced, TRUE);
+	sess->unsynced = 0;
+
+	jabber_iq_send(get);
+}
+
+void
+jabber_ibb_session_flush(JabberIBBSession *sess)
+{
+	if (jabber_ibb_session_get_state(sess) == JABBER_IBB_SESSION_OPENED &&
+	    sess->unsynced > 0) {
+		jabber_ibb_session_sync(sess);
+	}
+}
+
+static PurpleXmlNode *
+jabber_ibb_session_data_new(JabberIBBSession *sess, gconstpointer data,
+                            gsize size)
+{
+	PurpleXmlNode *data_element = purple_xmlnode_new("data");
+	gchar *base64;
+	gsize len;
+	gint state = 0, save = 0;
+	char seq[10];
+
+	g_snprintf(seq, sizeof(seq), "%u", jabber_ibb_session_get_send_seq(sess));
+
+	purple_xmlnode_set_namespace(data_element, NS_IBB);
+	purple_xmlnode_set_attrib(data_element, "sid", jabber_ibb_session_get_sid(sess));
+	purple_xmlnode_set_attrib(data_element, "seq", seq);
+
+	/* encode straight into the buffer the node will own */
+	base64 = g_malloc((size / 3 + 1) * 4 + 4);
+	len = g_base64_encode_step(data, size, FALSE, base64, &state, &save);
+	len += g_base64_encode_close(FALSE, base64 + len, &state, &save);
+
+	if (len > 0) {
+		purple_xmlnode_insert_data_take(data_element, base64, len);
 	} else {
-		/* the session has gone away, it was probably cancelled */
-		purple_debug_info("jabber",
-			"got response from send data, but IBB session is no longer active\n");
+		g_free(base64);
 	}
+
+	return data_element;
 }
 
 void
@@ -331,34 +505,45 @@ jabber_ibb_session_send_data(JabberIBBSession *sess, gconstpointer data,
 	} else if (size > jabber_ibb_session_get_max_data_size(sess)) {
 		purple_debug_error("jabber",
 			"trying to send a too large packet in the IBB session\n");
+	} else if (sess->stanza == JABBER_IBB_STANZA_MESSAGE) {
+		JabberStream *js = jabber_ibb_session_get_js(sess);
+		PurpleXmlNode *message = purple_xmlnode_new("message");
+		char id[JABBER_ID_SIZE];
+
+		purple_xmlnode_set_attrib(message, "to", jabber_ibb_session_get_who(sess));
+		purple_xmlnode_set_attrib(message, "id",
+			jabber_format_id(js->next_id++, id));
+		purple_xmlnode_insert_child(message,
+			jabber_ibb_session_data_new(sess, data, size));
+
+		jabber_send(js, message);
+
+		purple_xmlnode_free(message);
+
+		(sess->send_seq)++;
+		(sess->unsynced)++;
+
+		if (sess->unsynced >= MAX(sess->window / 2, 1)) {
+			jabber_ibb_session_sync(sess);
+		}
 	} else {
 		JabberIq *set = jabber_iq_new(jabber_ibb_session_get_js(sess),
 			JABBER_IQ_SET);
-		PurpleXmlNode *data_element = purple_xmlnode_new("data");
-		char *base64 = g_base64_encode(data, size);
-		char seq[10];
-		g_snprintf(seq, sizeof(seq), "%u", jabber_ibb_session_get_send_seq(sess));
 
 		purple_xmlnode_set_attrib(set->node, "to", jabber_ibb_session_get_who(sess));
-		purple_xmlnode_set_namespace(data_element, NS_IBB);
-		purple_xmlnode_set_attrib(data_element, "sid", jabber_ibb_session_get_sid(sess));
-		purple_xmlnode_set_attrib(data_element, "seq", seq);
-		purple_xmlnode_insert_data(data_element, base64, -1);
-
-		purple_xmlnode_insert_child(set->node, data_element);
+		purple_xmlnode_insert_child(set->node,
+			jabber_ibb_session_data_new(sess, data, size));
 
-		purple_debug_info("jabber",
-			"IBB: setting send <iq/> callback for session %p %s\n", sess,
-			sess->sid);
-		jabber_iq_set_callback(set, jabber_ibb_session_send_acknowledge_cb, sess);
-		sess->last_iq_id = g_strdup(purple_xmlnode_get_attrib(set->node, "id"));
-		purple_debug_info("jabber", "IBB: set sess->last_iq_id: %s\n",
-			sess->last_iq_id);
+		jabber_ibb_session_track(sess, set, 1, FALSE);
 		jabber_iq_send(set);
 
-		g_free(base64);
 		(sess->send_seq)++;
 	}
+
+	/* keep the window full, without recursing into the sender */
+	if (sess->sent_idle == 0 && jabber_ibb_session_can_send(sess)) {
+		sess->sent_idle = g_idle_add(jabber_ibb_session_sent_cb, sess);
+	}
 }
 
 static void
@@ -379,6 +564,67 @@ jabber_ibb_send_error_response(JabberStream *js, const char *to, const char *id)
 	jabber_iq_send(result);
 }
 
+/* returns FALSE if the block was rejected */
+static gboolean
+jabber_ibb_session_receive_data(JabberIBBSession *sess, PurpleXmlNode *child)
+{
+	const gchar *seq_attr = purple_xmlnode_get_attrib(child, "seq");
+	guint16 seq = (seq_attr ? atoi(seq_attr) : 0);
+
+	if (!seq_attr || seq != jabber_ibb_session_get_recv_seq(sess)) {
+		purple_debug_error("jabber",
+			"Received an out-of-order/invalid IBB packet\n");
+		sess->state = JABBER_IBB_SESSION_ERROR;
+
+		if (sess->error_cb) {
+			sess->error_cb(sess);
+		}
+		return FALSE;
+	}
+
+	/* sequence # is the expected... */
+	if (sess->data_received_cb) {
+		gchar *base64 = purple_xmlnode_get_data(child);
+		gsize size;
+		guchar *rawdata;
+
+		if (base64 == NULL) {
+			purple_debug_error("jabber",
+				"IBB: invalid BASE64 data received\n");
+			if (sess->error_cb)
+				sess->error_cb(sess);
+			return FALSE;
+		}
+
+		/* decodes into the same buffer, it only ever gets shorter */
+		rawdata = g_base64_decode_inplace(base64, &size);
+
+		purple_debug_info("jabber",
+			"got %" G_GSIZE_FORMAT " bytes of data on IBB stream\n", size);
+		/* we accept other clients to send up to block-size
+		 of _unencoded_ data, since there's been some confusions
+		 regarding the interpretation of this attribute
+		 (including previous versions of libpurple) */
+		if (size > jabber_ibb_session_get_block_size(sess)) {
+			purple_debug_error("jabber",
+				"IBB: received a too large packet\n");
+			if (sess->error_cb)
+				sess->error_cb(sess);
+			g_free(base64);
+			return FALSE;
+		}
+
+		purple_debug_info("jabber",
+			"calling IBB callback for received data\n");
+		sess->data_received_cb(sess, rawdata, size);
+		g_free(base64);
+	}
+
+	(sess->recv_seq)++;
+
+	return TRUE;
+}
+
 void
 jabber_ibb_parse(JabberStream *js, const char *who, JabberIqType type,
                  const char *id, PurpleXmlNode *child)
@@ -400,67 +646,14 @@ jabber_ibb_parse(JabberStream *js, const char *who, JabberIqType type,
 			purple_debug_error("jabber",
 				"Got IBB iq from wrong JID, ignoring\n");
 		} else if (data) {
-			const gchar *seq_attr = purple_xmlnode_get_attrib(child, "seq");
-			guint16 seq = (seq_attr ? atoi(seq_attr) : 0);
-
 			/* reject the data, and set the session in error if we get an
 			  out-of-order packet */
-			if (seq_attr && seq == jabber_ibb_session_get_recv_seq(sess)) {
-				/* sequence # is the expected... */
+			if (jabber_ibb_session_receive_data(sess, child)) {
 				JabberIq *result = jabber_iq_new(js, JABBER_IQ_RESULT);
 
 				jabber_iq_set_id(result, id);
 				purple_xmlnode_set_attrib(result->node, "to", who);
-
-				if (sess->data_received_cb) {
-					gchar *base64 = purple_xmlnode_get_data(child);
-					gsize size;
-					gpointer rawdata = g_base64_decode(base64, &size);
-
-					g_free(base64);
-
-					if (rawdata) {
-						purple_debug_info("jabber",
-							"got %" G_GSIZE_FORMAT " bytes of data on IBB stream\n",
-							size);
-						/* we accept other clients to send up to block-size
-						 of _unencoded_ data, since there's been some confusions
-						 regarding the interpretation of this attribute
-						 (including previous versions of libpurple) */
-						if (size > jabber_ibb_session_get_block_size(sess)) {
-							purple_debug_error("jabber",
-								"IBB: received a too large packet\n");
-							if (sess->error_cb)
-								sess->error_cb(sess);
-							g_free(rawdata);
-							return;
-						} else {
-							purple_debug_info("jabber",
-								"calling IBB callback for received data\n");
-							sess->data_received_cb(sess, rawdata, size);
-						}
-						g_free(rawdata);
-					} else {
-						purple_debug_error("jabber",
-							"IBB: invalid BASE64 data received\n");
-						if (sess->error_cb)
-							sess->error_cb(sess);
-						return;
-
-					}
-				}
-
-				(sess->recv_seq)++;
 				jabber_iq_send(result);
-
-			} else {
-				purple_debug_error("jabber",
-					"Received an out-of-order/invalid IBB packet\n");
-				sess->state = JABBER_IBB_SESSION_ERROR;
-
-				if (sess->error_cb) {
-					sess->error_cb(sess);
-				}
 			}
 		} else if (close) {
 			sess->state = JABBER_IBB_SESSION_CLOSED;
@@ -496,6 +689,26 @@ jabber_ibb_parse(JabberStream *js, const char *who, JabberIqType type,
 	}
 }
 
+void
+jabber_ibb_parse_message(JabberStream *js, const char *who,
+                         PurpleXmlNode *data)
+{
+	const gchar *sid = purple_xmlnode_get_attrib(data, "sid");
+	JabberIBBSession *sess =
+		sid ? g_hash_table_lookup(jabber_ibb_sessions, sid) : NULL;
+
+	if (!sess) {
+		purple_debug_info("jabber",
+			"Got IBB data message for an unknown session, ignoring\n");
+	} else if (!purple_strequal(who, jabber_ibb_session_get_who(sess))) {
+		purple_debug_error("jabber",
+			"Got IBB message from wrong JID, ignoring\n");
+	} else {
+		/* there's nothing to acknowledge with a message stanza */
+		jabber_ibb_session_receive_data(sess, data);
+	}
+}
+
 void
 jabber_ibb_register_open_handler(JabberIBBOpenHandler *cb)
 {
@@ -47,6 +47,12 @@ typedef enum {
 	JABBER_IBB_SESSION_ERROR
 } JabberIBBSessionState;
 
+/* Which stanza carries the <data/> blocks (the stanza attribute of <open/>) */
+typedef enum {
+	JABBER_IBB_STANZA_IQ,
+	JABBER_IBB_STANZA_MESSAGE
+} JabberIBBStanzaType;
+
 struct _JabberIBBSession {
 	JabberStream *js;
 	gchar *who;
@@ -55,6 +61,10 @@ struct _JabberIBBSession {
 	guint16 send_seq;
 	guint16 recv_seq;
 	gsize block_size;
+	JabberIBBStanzaType stanza;
+
+	/* number of blocks that may be sent before the peer confirms them */
+	guint window;
 
 	/* session state */
 	JabberIBBSessionState state;
@@ -70,8 +80,13 @@ struct _JabberIBBSession {
 	JabberIBBDataCallback *data_received_cb;
 	JabberIBBErrorCallback *error_cb;
 
-	/* store the last sent IQ (to permit cancel of callback) */
-	gchar *last_iq_id;
+	/* the IQs we're waiting on, oldest first (to permit cancel of callback) */
+	GQueue outstanding;
+	/* blocks sent but not confirmed by the peer yet */
+	guint in_flight;
+	/* message stanza blocks sent since the last ping */
+	guint unsynced;
+	guint sent_idle;
 };
 
 JabberIBBSession *jabber_ibb_session_create(JabberStream *js, const gchar *sid,
@@ -110,6 +125,20 @@ JabberIBBSessionState jabber_ibb_session_get_state(const JabberIBBSession *sess)
 gsize jabber_ibb_session_get_block_size(const JabberIBBSession *sess);
 void jabber_ibb_session_set_block_size(JabberIBBSession *sess, gsize size);
 
+JabberIBBStanzaType jabber_ibb_session_get_stanza_type(const JabberIBBSession *sess);
+/* can only be changed before the session is opened */
+void jabber_ibb_session_set_stanza_type(JabberIBBSession *sess,
+	JabberIBBStanzaType stanza);
+
+guint jabber_ibb_session_get_window(const JabberIBBSession *sess);
+void jabber_ibb_session_set_window(JabberIBBSession *sess, guint window);
+
+/* number of sent blocks the peer hasn't confirmed yet */
+guint jabber_ibb_session_get_outstanding(const JabberIBBSession *sess);
+/* asks the peer to confirm message stanza blocks sent since the last sync,
+   instead of waiting for half a window of them */
+void jabber_ibb_session_flush(JabberIBBSession *sess);
+
 /* get maximum size data block to send (in bytes)
  (before encoded to BASE64) */
 gsize jabber_ibb_session_get_max_data_size(const JabberIBBSession *sess);
@@ -119,6 +148,9 @@ gpointer jabber_ibb_session_get_user_data(JabberIBBSession *sess);
 /* handle incoming packet */
 void jabber_ibb_parse(JabberStream *js, const char *who, JabberIqType type,
                       const char *id, PurpleXmlNode *child);
+/* handle a <data/> block sent in a <message/> */
+void jabber_ibb_parse_message(JabberStream *js, const char *who,
+                              PurpleXmlNode *data);
 
 /* add a handler for open session */
 void jabber_ibb_register_open_handler(JabberIBBOpenHandler *cb);
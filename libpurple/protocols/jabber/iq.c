@@ -22,6 +22,8 @@
  */
 #include <glib/gi18n-lib.h>
 
+#include <string.h>
+
 #include <purple.h>
 
 #include "buddy.h"
@@ -36,21 +38,356 @@
 #include "data.h"
 #include "ibb.h"
 
+/* The number of one second ticks in a turn of the timeout wheel.  Deadlines
+ * further out than this just stay in their slot for more turns. */
+#define JABBER_IQ_WHEEL_SLOTS 64
+
 static GHashTable *iq_handlers = NULL;
 static GHashTable *signal_iq_handlers = NULL;
 
 struct _JabberIqCallbackData {
 	JabberIqCallback *callback;
 	gpointer data;
+	GDestroyNotify destroy;
 	JabberID *to;
+
+	/* The numeric part of ids from jabber_get_next_id(), otherwise the id
+	 * itself when someone else picked it. */
+	guint32 key;
+	char *name;
+
+	/* Interned namespace of the first child of the request. */
+	const char *xmlns;
+	gint64 sent;
+
+	/* Our place in the timeout wheel, slot is NULL if we don't time out. */
+	GList link;
+	GQueue *slot;
+	guint rounds;
+};
+
+struct _JabberIqTracker {
+	GQueue slots[JABBER_IQ_WHEEL_SLOTS];
+	guint cursor;
+	guint scheduled;
+	guint timer;
+
+	/* namespace -> number of callbacks waiting for a reply */
+	GHashTable *in_flight;
 };
 
 void jabber_iq_callbackdata_free(JabberIqCallbackData *jcd)
 {
+	if(jcd->destroy != NULL) {
+		jcd->destroy(jcd->data);
+	}
+
 	jabber_id_free(jcd->to);
+	g_free(jcd->name);
 	g_free(jcd);
 }
 
+/*
+ * Turns an id generated by jabber_get_next_id() back into the number it was
+ * made from.  Anything else, including non-canonical spellings of our ids,
+ * is rejected so that it can't alias one of our callbacks.
+ */
+static gboolean
+jabber_iq_id_to_key(const char *id, guint32 *key)
+{
+	guint64 value = 0;
+	const char *p;
+
+	if(!g_str_has_prefix(id, "purple")) {
+		return FALSE;
+	}
+
+	p = id + strlen("purple");
+	if(*p == '\0' || (*p == '0' && p[1] != '\0')) {
+		return FALSE;
+	}
+
+	for(; *p != '\0'; p++) {
+		gint digit = g_ascii_xdigit_value(*p);
+
+		if(digit < 0 || g_ascii_isupper(*p)) {
+			return FALSE;
+		}
+
+		value = (value << 4) | digit;
+		if(value > G_MAXUINT32) {
+			return FALSE;
+		}
+	}
+
+	*key = (guint32)value;
+
+	return TRUE;
+}
+
+static const char *
+jabber_iq_get_namespace(PurpleXmlNode *node)
+{
+	PurpleXmlNode *child;
+
+	for(child = node->child; child != NULL; child = child->next) {
+		if(child->type == PURPLE_XMLNODE_TYPE_TAG) {
+			const char *xmlns = purple_xmlnode_get_namespace(child);
+
+			return g_intern_string(xmlns != NULL ? xmlns : "");
+		}
+	}
+
+	return g_intern_static_string("");
+}
+
+static JabberIqCallbackData *
+jabber_iq_lookup_callback(JabberStream *js, const char *id)
+{
+	guint32 key = 0;
+
+	if(jabber_iq_id_to_key(id, &key)) {
+		return g_hash_table_lookup(js->iq_callbacks, GUINT_TO_POINTER(key));
+	}
+
+	if(js->iq_named_callbacks != NULL) {
+		return g_hash_table_lookup(js->iq_named_callbacks, id);
+	}
+
+	return NULL;
+}
+
+/* Removes jcd from the tables and the wheel without freeing it. */
+static void
+jabber_iq_steal_callback(JabberStream *js, JabberIqCallbackData *jcd)
+{
+	JabberIqTracker *tracker = js->iq_tracker;
+	guint count;
+
+	if(jcd->name != NULL) {
+		g_hash_table_steal(js->iq_named_callbacks, jcd->name);
+	} else {
+		g_hash_table_steal(js->iq_callbacks, GUINT_TO_POINTER(jcd->key));
+	}
+
+	if(jcd->slot != NULL) {
+		g_queue_unlink(jcd->slot, &jcd->link);
+		jcd->slot = NULL;
+		tracker->scheduled--;
+	}
+
+	count = GPOINTER_TO_UINT(g_hash_table_lookup(tracker->in_flight,
+	                                             jcd->xmlns));
+	if(count > 1) {
+		g_hash_table_insert(tracker->in_flight, (gpointer)jcd->xmlns,
+		                    GUINT_TO_POINTER(count - 1));
+	} else {
+		g_hash_table_remove(tracker->in_flight, jcd->xmlns);
+	}
+}
+
+static void
+jabber_iq_report(JabberStream *js, JabberIqCallbackData *jcd,
+                 const char *outcome)
+{
+	gint64 elapsed = g_get_monotonic_time() - jcd->sent;
+
+	purple_signal_emit(purple_connection_get_protocol(js->gc),
+	                   "jabber-iq-completed", js->gc, jcd->xmlns, outcome,
+	                   (guint)(elapsed / 1000),
+	                   jabber_iq_get_in_flight(js, jcd->xmlns));
+}
+
+/*
+ * Calls the callback with a remote-server-timeout error, which is what a
+ * server would have sent had it given up on the request on our behalf.
+ */
+static void
+jabber_iq_time_out(JabberStream *js, JabberIqCallbackData *jcd)
+{
+	PurpleXmlNode *packet, *error, *condition;
+	char buf[JABBER_ID_SIZE];
+	const char *id = jcd->name;
+	char *from = NULL;
+
+	if(id == NULL) {
+		id = jabber_format_id(jcd->key, buf);
+	}
+
+	if(jcd->to != NULL) {
+		from = jabber_id_get_full_jid(jcd->to);
+	}
+
+	purple_debug_warning("jabber", "IQ %s to %s timed out\n", id,
+	                     from ? from : "(server)");
+
+	packet = purple_xmlnode_new("iq");
+	purple_xmlnode_set_attrib(packet, "type", "error");
+	purple_xmlnode_set_attrib(packet, "id", id);
+	if(from != NULL) {
+		purple_xmlnode_set_attrib(packet, "from", from);
+	}
+
+	error = purple_xmlnode_new_child(packet, "error");
+	purple_xmlnode_set_attrib(error, "type", "wait");
+	condition = purple_xmlnode_new_child(error, "remote-server-timeout");
+	purple_xmlnode_set_namespace(condition, NS_XMPP_STANZAS);
+
+	jcd->callback(js, from, JABBER_IQ_ERROR, id, packet, jcd->data);
+
+	purple_xmlnode_free(packet);
+	g_free(from);
+}
+
+static gboolean
+jabber_iq_tick_cb(gpointer data)
+{
+	JabberStream *js = data;
+	JabberIqTracker *tracker = js->iq_tracker;
+	GQueue expiring = G_QUEUE_INIT;
+	GQueue *slot;
+	GList *link;
+
+	tracker->cursor = (tracker->cursor + 1) % JABBER_IQ_WHEEL_SLOTS;
+	slot = &tracker->slots[tracker->cursor];
+
+	/* Move the slot aside so that callbacks can send new IQs, which may land
+	 * in this very slot, and remove other callbacks while we work. */
+	expiring = *slot;
+	g_queue_init(slot);
+	for(link = expiring.head; link != NULL; link = link->next) {
+		JabberIqCallbackData *jcd = link->data;
+
+		jcd->slot = &expiring;
+	}
+
+	while((link = g_queue_pop_head_link(&expiring)) != NULL) {
+		JabberIqCallbackData *jcd = link->data;
+
+		if(jcd->rounds > 0) {
+			jcd->rounds--;
+			jcd->slot = slot;
+			g_queue_push_tail_link(slot, link);
+
+			continue;
+		}
+
+		jcd->slot = NULL;
+		tracker->scheduled--;
+
+		jabber_iq_steal_callback(js, jcd);
+		jabber_iq_report(js, jcd, "timeout");
+		jabber_iq_time_out(js, jcd);
+		jabber_iq_callbackdata_free(jcd);
+	}
+
+	if(tracker->scheduled == 0) {
+		tracker->timer = 0;
+
+		return G_SOURCE_REMOVE;
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+jabber_iq_add_callback(JabberStream *js, JabberIqCallbackData *jcd,
+                       const char *id, guint timeout)
+{
+	JabberIqTracker *tracker = js->iq_tracker;
+	guint count;
+
+	/* Never leave a replaced callback behind in the wheel. */
+	jabber_iq_remove_callback_by_id(js, id);
+
+	if(jabber_iq_id_to_key(id, &jcd->key)) {
+		g_hash_table_insert(js->iq_callbacks, GUINT_TO_POINTER(jcd->key),
+		                    jcd);
+	} else {
+		if(js->iq_named_callbacks == NULL) {
+			js->iq_named_callbacks = g_hash_table_new_full(g_str_hash,
+					g_str_equal, NULL,
+					(GDestroyNotify)jabber_iq_callbackdata_free);
+		}
+
+		jcd->name = g_strdup(id);
+		g_hash_table_insert(js->iq_named_callbacks, jcd->name, jcd);
+	}
+
+	count = GPOINTER_TO_UINT(g_hash_table_lookup(tracker->in_flight,
+	                                             jcd->xmlns));
+	g_hash_table_insert(tracker->in_flight, (gpointer)jcd->xmlns,
+	                    GUINT_TO_POINTER(count + 1));
+
+	if(timeout == 0) {
+		return;
+	}
+
+	jcd->link.data = jcd;
+	jcd->slot = &tracker->slots[(tracker->cursor + timeout) %
+	                            JABBER_IQ_WHEEL_SLOTS];
+	jcd->rounds = (timeout - 1) / JABBER_IQ_WHEEL_SLOTS;
+	g_queue_push_tail_link(jcd->slot, &jcd->link);
+	tracker->scheduled++;
+
+	if(tracker->timer == 0) {
+		tracker->timer = g_timeout_add_seconds(1, jabber_iq_tick_cb, js);
+	}
+}
+
+void
+jabber_iq_callbacks_init(JabberStream *js)
+{
+	JabberIqTracker *tracker = g_new0(JabberIqTracker, 1);
+
+	for(guint i = 0; i < JABBER_IQ_WHEEL_SLOTS; i++) {
+		g_queue_init(&tracker->slots[i]);
+	}
+
+	/* The keys are interned, so they are never freed. */
+	tracker->in_flight = g_hash_table_new(g_str_hash, g_str_equal);
+
+	js->iq_tracker = tracker;
+	js->iq_callbacks = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+			NULL, (GDestroyNotify)jabber_iq_callbackdata_free);
+}
+
+void
+jabber_iq_callbacks_destroy(JabberStream *js)
+{
+	JabberIqTracker *tracker = js->iq_tracker;
+
+	if(tracker != NULL) {
+		g_clear_handle_id(&tracker->timer, g_source_remove);
+		g_hash_table_destroy(tracker->in_flight);
+
+		/* The wheel's links are embedded in the callback data, which the
+		 * tables below free, so there is nothing else to clean up. */
+		g_free(tracker);
+		js->iq_tracker = NULL;
+	}
+
+	g_clear_pointer(&js->iq_callbacks, g_hash_table_destroy);
+	g_clear_pointer(&js->iq_named_callbacks, g_hash_table_destroy);
+}
+
+guint
+jabber_iq_get_in_flight(JabberStream *js, const char *xmlns)
+{
+	if(xmlns == NULL) {
+		guint count = g_hash_table_size(js->iq_callbacks);
+
+		if(js->iq_named_callbacks != NULL) {
+			count += g_hash_table_size(js->iq_named_callbacks);
+		}
+
+		return count;
+	}
+
+	return GPOINTER_TO_UINT(g_hash_table_lookup(js->iq_tracker->in_flight,
+	                                            xmlns));
+}
+
 JabberIq *jabber_iq_new(JabberStream *js, JabberIqType type)
 {
 	JabberIq *iq;
@@ -79,9 +416,10 @@ JabberIq *jabber_iq_new(JabberStream *js, JabberIqType type)
 	}
 
 	iq->js = js;
+	iq->timeout = JABBER_IQ_DEFAULT_TIMEOUT;
 
 	if(type == JABBER_IQ_GET || type == JABBER_IQ_SET) {
-		iq->id = jabber_get_next_id(js);
+		iq->id = jabber_format_id(js->next_id++, iq->id_buf);
 		purple_xmlnode_set_attrib(iq->node, "id", iq->id);
 	}
 
@@ -103,13 +441,33 @@ JabberIq *jabber_iq_new_query(JabberStream *js, JabberIqType type,
 void
 jabber_iq_set_callback(JabberIq *iq, JabberIqCallback *callback, gpointer data)
 {
+	jabber_iq_set_callback_full(iq, callback, data, NULL);
+}
+
+void
+jabber_iq_set_callback_full(JabberIq *iq, JabberIqCallback *callback,
+                            gpointer data, GDestroyNotify destroy)
+{
+	if(iq->callback_destroy != NULL) {
+		iq->callback_destroy(iq->callback_data);
+	}
+
 	iq->callback = callback;
 	iq->callback_data = data;
+	iq->callback_destroy = destroy;
+}
+
+void
+jabber_iq_set_timeout(JabberIq *iq, guint timeout)
+{
+	iq->timeout = timeout;
 }
 
 void jabber_iq_set_id(JabberIq *iq, const char *id)
 {
-	g_free(iq->id);
+	if(iq->id != iq->id_buf) {
+		g_free(iq->id);
+	}
 
 	if(id) {
 		purple_xmlnode_set_attrib(iq->node, "id", id);
@@ -131,9 +489,13 @@ void jabber_iq_send(JabberIq *iq)
 		jcd = g_new0(JabberIqCallbackData, 1);
 		jcd->callback = iq->callback;
 		jcd->data = iq->callback_data;
+		jcd->destroy = iq->callback_destroy;
+		iq->callback_destroy = NULL;
 		jcd->to = jabber_id_new(purple_xmlnode_get_attrib(iq->node, "to"));
+		jcd->xmlns = jabber_iq_get_namespace(iq->node);
+		jcd->sent = g_get_monotonic_time();
 
-		g_hash_table_insert(iq->js->iq_callbacks, g_strdup(iq->id), jcd);
+		jabber_iq_add_callback(iq->js, jcd, iq->id, iq->timeout);
 	}
 
 	jabber_iq_free(iq);
@@ -143,7 +505,14 @@ void jabber_iq_free(JabberIq *iq)
 {
 	g_return_if_fail(iq != NULL);
 
-	g_free(iq->id);
+	/* Only set if the callback was never registered. */
+	if(iq->callback_destroy != NULL) {
+		iq->callback_destroy(iq->callback_data);
+	}
+
+	if(iq->id != iq->id_buf) {
+		g_free(iq->id);
+	}
 	purple_xmlnode_free(iq->node);
 	g_free(iq);
 }
@@ -257,7 +626,12 @@ static void jabber_iq_version_parse(JabberStream *js, const char *from,
 
 void jabber_iq_remove_callback_by_id(JabberStream *js, const char *id)
 {
-	g_hash_table_remove(js->iq_callbacks, id);
+	JabberIqCallbackData *jcd = jabber_iq_lookup_callback(js, id);
+
+	if(jcd != NULL) {
+		jabber_iq_steal_callback(js, jcd);
+		jabber_iq_callbackdata_free(jcd);
+	}
 }
 
 /**
@@ -383,7 +757,7 @@ void jabber_iq_parse(JabberStream *js, PurpleXmlNode *packet)
 
 			purple_xmlnode_set_attrib(iq->node, "type", "error");
 			/* This id is clearly not useful, but we must put something there for a valid stanza */
-			iq->id = jabber_get_next_id(js);
+			iq->id = jabber_format_id(js->next_id++, iq->id_buf);
 			purple_xmlnode_set_attrib(iq->node, "id", iq->id);
 			error = purple_xmlnode_new_child(iq->node, "error");
 			purple_xmlnode_set_attrib(error, "type", "modify");
@@ -408,11 +782,14 @@ void jabber_iq_parse(JabberStream *js, PurpleXmlNode *packet)
 
 	/* First, lets see if a special callback got registered */
 	if(type == JABBER_IQ_RESULT || type == JABBER_IQ_ERROR) {
-		jcd = g_hash_table_lookup(js->iq_callbacks, id);
+		jcd = jabber_iq_lookup_callback(js, id);
 		if (jcd) {
 			if (does_reply_from_match_request_to(js, jcd->to, from_id)) {
+				jabber_iq_steal_callback(js, jcd);
+				jabber_iq_report(js, jcd,
+				                 type == JABBER_IQ_RESULT ? "result" : "error");
 				jcd->callback(js, from, type, id, packet, jcd->data);
-				jabber_iq_remove_callback_by_id(js, id);
+				jabber_iq_callbackdata_free(jcd);
 				jabber_id_free(from_id);
 				return;
 			} else {
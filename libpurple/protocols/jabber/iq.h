@@ -37,8 +37,21 @@ typedef enum {
 
 #include "jabber.h"
 
+/**
+ * The number of seconds to wait for the reply to an IQ with a callback
+ * before the callback is called with a remote-server-timeout error.
+ */
+#define JABBER_IQ_DEFAULT_TIMEOUT 120
+
+/**
+ * The size of a buffer for jabber_format_id(): "purple", up to eight hex
+ * digits and the terminator.
+ */
+#define JABBER_ID_SIZE (sizeof("purple") + 8)
+
 typedef struct _JabberIq JabberIq;
 typedef struct _JabberIqCallbackData  JabberIqCallbackData;
+typedef struct _JabberIqTracker JabberIqTracker;
 
 /**
  * A JabberIqHandler is called to process an incoming IQ stanza.
@@ -84,11 +97,15 @@ typedef void (JabberIqCallback)(JabberStream *js, const char *from,
 
 struct _JabberIq {
 	JabberIqType type;
+	/* Either id_buf, for the ids we generate, or allocated. */
 	char *id;
+	char id_buf[JABBER_ID_SIZE];
 	PurpleXmlNode *node;
 
 	JabberIqCallback *callback;
 	gpointer callback_data;
+	GDestroyNotify callback_destroy;
+	guint timeout;
 
 	JabberStream *js;
 };
@@ -102,8 +119,46 @@ void jabber_iq_parse(JabberStream *js, PurpleXmlNode *packet);
 void jabber_iq_callbackdata_free(JabberIqCallbackData *jcd);
 void jabber_iq_remove_callback_by_id(JabberStream *js, const char *id);
 void jabber_iq_set_callback(JabberIq *iq, JabberIqCallback *cb, gpointer data);
+
+/**
+ * Like jabber_iq_set_callback(), but @destroy is called on @data once the
+ * callback is no longer needed.  This happens after the callback was called,
+ * but also when it never will be, for example because we disconnected
+ * before the reply arrived.
+ *
+ * @param iq      The IQ.
+ * @param cb      The callback.
+ * @param data    The callback data.
+ * @param destroy The GDestroyNotify for @data, or NULL.
+ */
+void jabber_iq_set_callback_full(JabberIq *iq, JabberIqCallback *cb,
+                                 gpointer data, GDestroyNotify destroy);
 void jabber_iq_set_id(JabberIq *iq, const char *id);
 
+/**
+ * Sets how long to wait for a reply before the callback set with
+ * jabber_iq_set_callback() is called with a remote-server-timeout error.
+ * Defaults to JABBER_IQ_DEFAULT_TIMEOUT.
+ *
+ * @param iq      The IQ.
+ * @param timeout The timeout in seconds, or 0 to wait forever.
+ */
+void jabber_iq_set_timeout(JabberIq *iq, guint timeout);
+
+/**
+ * Gets the number of IQs that are waiting for a reply.
+ *
+ * @param js    The JabberStream object.
+ * @param xmlns The namespace of the request's child element, or NULL for all
+ *              of them.
+ *
+ * @return The number of callbacks waiting for a reply.
+ */
+guint jabber_iq_get_in_flight(JabberStream *js, const char *xmlns);
+
+void jabber_iq_callbacks_init(JabberStream *js);
+void jabber_iq_callbacks_destroy(JabberStream *js);
+
 void jabber_iq_send(JabberIq *iq);
 void jabber_iq_free(JabberIq *iq);
 
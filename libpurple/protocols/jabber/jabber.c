@@ -414,8 +414,11 @@ jabber_send_raw(PurpleProtocolServer *protocol_server, JabberStream *js,
 
 	g_return_if_fail(data != NULL);
 
-	/* because printing a tab to debug every minute gets old */
-	if (!purple_strequal(data, "\t")) {
+	/* because printing a tab to debug every minute gets old, and don't
+	 * bother scrubbing passwords from output nobody is going to see */
+	if (!purple_strequal(data, "\t") &&
+	    purple_debug_is_enabled(PURPLE_DEBUG_MISC, "jabber"))
+	{
 		const char *username;
 		char *text = NULL, *last_part = NULL, *tag_start = NULL;
 
@@ -633,7 +636,8 @@ jabber_recv_cb(GObject *stream, gpointer data)
 					PURPLE_CONNECTION_ERROR_NETWORK_ERROR,
 					error);
 			} else if (olen > 0) {
-				purple_debug_info("jabber", "RecvSASL (%u): %s\n", olen, out);
+				purple_debug_lazy(PURPLE_DEBUG_INFO, "jabber",
+				                  "RecvSASL (%u): %s\n", olen, out);
 				jabber_parser_process(js, out, olen);
 				if (js->reinit)
 					jabber_stream_init(js);
@@ -641,8 +645,8 @@ jabber_recv_cb(GObject *stream, gpointer data)
 			return G_SOURCE_CONTINUE;
 		}
 		buf[len] = '\0';
-		purple_debug_misc("jabber", "Recv (%" G_GSSIZE_FORMAT "): %s", len,
-		                  buf);
+		purple_debug_lazy(PURPLE_DEBUG_MISC, "jabber",
+		                  "Recv (%" G_GSSIZE_FORMAT "): %s", len, buf);
 		jabber_parser_process(js, buf, len);
 		if(js->reinit)
 			jabber_stream_init(js);
@@ -913,8 +917,7 @@ jabber_stream_new(PurpleAccount *account)
 
 	js->user_jb->subscription |= JABBER_SUB_BOTH;
 
-	js->iq_callbacks = g_hash_table_new_full(g_str_hash, g_str_equal,
-			g_free, (GDestroyNotify)jabber_iq_callbackdata_free);
+	jabber_iq_callbacks_init(js);
 	js->chats = g_hash_table_new_full(g_str_hash, g_str_equal,
 			g_free, (GDestroyNotify)jabber_chat_free);
 	js->next_id = g_random_int();
@@ -1563,8 +1566,7 @@ void jabber_close(PurpleConnection *gc)
 
 	jabber_parser_free(js);
 
-	if(js->iq_callbacks)
-		g_hash_table_destroy(js->iq_callbacks);
+	jabber_iq_callbacks_destroy(js);
 	if(js->buddies)
 		g_hash_table_destroy(js->buddies);
 	if(js->chats)
@@ -1641,9 +1643,34 @@ void jabber_stream_set_state(JabberStream *js, JabberStreamState state)
 	}
 }
 
+char *
+jabber_format_id(guint32 id, char *buf)
+{
+	static const char digits[] = "0123456789abcdef";
+	char *p = buf + strlen("purple");
+	gint shift = 28;
+
+	/* The same as "purple%x", without going through printf for every
+	 * stanza we send. */
+	memcpy(buf, "purple", strlen("purple"));
+
+	while(shift > 0 && (id >> shift) == 0) {
+		shift -= 4;
+	}
+
+	for(; shift >= 0; shift -= 4) {
+		*p++ = digits[(id >> shift) & 0xf];
+	}
+	*p = '\0';
+
+	return buf;
+}
+
 char *jabber_get_next_id(JabberStream *js)
 {
-	return g_strdup_printf("purple%x", js->next_id++);
+	char buf[JABBER_ID_SIZE];
+
+	return g_strdup(jabber_format_id(js->next_id++, buf));
 }
 
 
@@ -3792,6 +3819,15 @@ static void jabber_init_protocol(PurpleProtocol *protocol)
 			G_TYPE_STRING, /* from */
 			PURPLE_TYPE_XMLNODE); /* child */
 
+	purple_signal_register(protocol, "jabber-iq-completed",
+			purple_marshal_VOID__POINTER_POINTER_POINTER_UINT_UINT,
+			G_TYPE_NONE, 5,
+			PURPLE_TYPE_CONNECTION,
+			G_TYPE_STRING, /* namespace */
+			G_TYPE_STRING, /* outcome: result, error or timeout */
+			G_TYPE_UINT, /* round trip time in milliseconds */
+			G_TYPE_UINT); /* requests still in flight for namespace */
+
 	purple_signal_register(protocol, "jabber-receiving-presence",
 			purple_marshal_BOOLEAN__POINTER_POINTER_POINTER_POINTER,
 			G_TYPE_BOOLEAN, 4,
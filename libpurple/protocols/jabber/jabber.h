@@ -161,7 +161,9 @@ struct _JabberStream
 	GList *user_directories;
 
 	GHashTable *iq_callbacks;
-	int next_id;
+	GHashTable *iq_named_callbacks;
+	JabberIqTracker *iq_tracker;
+	guint32 next_id;
 
 	GList *bs_proxies;
 	GList *oob_file_transfers;
@@ -183,7 +185,6 @@ struct _JabberStream
 
 	char *initial_avatar_hash;
 	char *avatar_hash;
-	GSList *pending_avatar_requests;
 
 	GSList *pending_buddy_info_requests;
 
@@ -304,6 +305,11 @@ void jabber_register_parse(JabberStream *js, const char *from,
                            JabberIqType type, const char *id, PurpleXmlNode *query);
 void jabber_register_start(JabberStream *js);
 
+/**
+ * Writes the id for the number id into buf, which must have room for
+ * JABBER_ID_SIZE bytes, and returns buf.
+ */
+char *jabber_format_id(guint32 id, char *buf);
 char *jabber_get_next_id(JabberStream *js);
 
 /** Parse an error into a human-readable string and optionally a disconnect
@@ -28,6 +28,7 @@
 #include "buddy.h"
 #include "chat.h"
 #include "data.h"
+#include "ibb.h"
 #include "message.h"
 #include "pep.h"
 #include "iq.h"
@@ -478,6 +479,14 @@ void jabber_message_parse(JabberStream *js, PurpleXmlNode *packet)
 	if (signal_return)
 		return;
 
+	/* In-band bytestream blocks sent with stanza='message' (XEP-0047) */
+	child = purple_xmlnode_get_child_with_namespace(packet, "data", NS_IBB);
+	if(child != NULL && !is_forwarded) {
+		jabber_ibb_parse_message(js, from, child);
+		g_date_time_unref(timestamp);
+		return;
+	}
+
 	jm = g_new0(JabberMessage, 1);
 	jm->js = js;
 	jm->sent = timestamp;
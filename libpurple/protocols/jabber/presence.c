@@ -376,21 +376,36 @@ deny_add_cb(G_GNUC_UNUSED PurpleAuthorizationRequest *request,
 	g_free(jap);
 }
 
+/* Owned by the vCard IQ, so that the fetch still fails when the IQ goes away
+ * without a reply, like when we disconnect. */
+typedef struct {
+	PurpleAvatarFetch *fetch;
+} JabberAvatarFetch;
+
+static void
+jabber_avatar_fetch_free(JabberAvatarFetch *jaf)
+{
+	if(jaf->fetch != NULL) {
+		purple_avatar_fetch_failed(jaf->fetch);
+	}
+
+	g_free(jaf);
+}
+
 static void
 jabber_vcard_parse_avatar(JabberStream *js, const char *from,
                           JabberIqType type, const char *id,
-                          PurpleXmlNode *packet, gpointer blah)
+                          PurpleXmlNode *packet, gpointer data)
 {
-	JabberBuddy *jb = NULL;
+	JabberAvatarFetch *jaf = data;
+	PurpleAvatarFetch *fetch = g_steal_pointer(&jaf->fetch);
 	PurpleXmlNode *vcard, *photo, *binval, *fn, *nick;
 	char *text;
 
-	if(!from)
+	if(!from) {
+		purple_avatar_fetch_failed(fetch);
 		return;
-
-	jb = jabber_buddy_find(js, from, TRUE);
-
-	js->pending_avatar_requests = g_slist_remove(js->pending_avatar_requests, jb);
+	}
 
 	if((vcard = purple_xmlnode_get_child(packet, "vCard")) ||
 			(vcard = purple_xmlnode_get_child_with_namespace(packet, "query", "vcard-temp"))) {
@@ -418,26 +433,45 @@ jabber_vcard_parse_avatar(JabberStream *js, const char *from,
 		}
 
 		if ((photo = purple_xmlnode_get_child(vcard, "PHOTO"))) {
-			guchar *data = NULL;
-			gchar *hash = NULL;
+			guchar *icon = NULL;
 			gsize size = 0;
 
 			if ((binval = purple_xmlnode_get_child(photo, "BINVAL")) &&
 					(text = purple_xmlnode_get_data(binval))) {
-				data = g_base64_decode(text, &size);
+				icon = g_base64_decode(text, &size);
 				g_free(text);
-
-				if (data) {
-					hash = g_compute_checksum_for_data(G_CHECKSUM_SHA1, data,
-					                                   size);
-				}
 			}
 
-			purple_buddy_icons_set_for_user(purple_connection_get_account(js->gc), from, data, size, hash);
-
-			g_free(hash);
+			/* This stores the icon under the hash from the presence,
+			 * which is the SHA-1 of the photo. */
+			purple_avatar_fetch_complete(fetch, icon, size);
+			return;
 		}
 	}
+
+	purple_avatar_fetch_failed(fetch);
+}
+
+static void
+jabber_vcard_fetch_avatar(PurpleAvatarFetch *fetch, gpointer data)
+{
+	JabberStream *js = data;
+	JabberAvatarFetch *jaf;
+	JabberIq *iq;
+	PurpleXmlNode *vcard;
+
+	iq = jabber_iq_new(js, JABBER_IQ_GET);
+	purple_xmlnode_set_attrib(iq->node, "to",
+	                          purple_avatar_fetch_get_username(fetch));
+	vcard = purple_xmlnode_new_child(iq->node, "vCard");
+	purple_xmlnode_set_namespace(vcard, "vcard-temp");
+
+	jaf = g_new0(JabberAvatarFetch, 1);
+	jaf->fetch = fetch;
+
+	jabber_iq_set_callback_full(iq, jabber_vcard_parse_avatar, jaf,
+	                            (GDestroyNotify)jabber_avatar_fetch_free);
+	jabber_iq_send(iq);
 }
 
 typedef struct {
@@ -822,26 +856,13 @@ handle_presence_contact(JabberStream *js, JabberPresence *presence)
 				presence->vcard_avatar_hash : NULL;
 		const char *ah2 = purple_buddy_icons_get_checksum_for_user(b);
 		if (!purple_strequal(ah, ah2)) {
-			/* XXX this is a crappy way of trying to prevent
-			 * someone from spamming us with presence packets
-			 * and causing us to DoS ourselves...what we really
-			 * need is a queue system that can throttle itself,
-			 * but i'm too tired to write that right now */
-			if(!g_slist_find(js->pending_avatar_requests, presence->jb)) {
-				JabberIq *iq;
-				PurpleXmlNode *vcard;
-
-				js->pending_avatar_requests =
-					g_slist_prepend(js->pending_avatar_requests, presence->jb);
-
-				iq = jabber_iq_new(js, JABBER_IQ_GET);
-				purple_xmlnode_set_attrib(iq->node, "to", buddy_name);
-				vcard = purple_xmlnode_new_child(iq->node, "vCard");
-				purple_xmlnode_set_namespace(vcard, "vcard-temp");
-
-				jabber_iq_set_callback(iq, jabber_vcard_parse_avatar, NULL);
-				jabber_iq_send(iq);
-			}
+			/* The fetcher throttles these and drops repeats, so a
+			 * flood of presence packets can't make us DoS ourselves. */
+			purple_avatar_fetcher_submit(purple_avatar_fetcher_get_default(),
+			                             account, buddy_name, ah,
+			                             PURPLE_AVATAR_FETCH_FLAGS_NONE,
+			                             jabber_vcard_fetch_avatar, js,
+			                             NULL);
 		}
 	}
 
@@ -1202,6 +1202,13 @@ jabber_si_xfer_ibb_sent_cb(JabberIBBSession *sess)
 	goffset remaining = purple_xfer_get_bytes_remaining(xfer);
 
 	if (remaining == 0) {
+		if (jabber_ibb_session_get_outstanding(sess) > 0) {
+			/* wait for the peer to confirm the rest, message stanza blocks
+			   only get confirmed by a sync */
+			jabber_ibb_session_flush(sess);
+			return;
+		}
+
 		/* close the session */
 		jabber_ibb_session_close(sess);
 		purple_xfer_set_completed(xfer, TRUE);
@@ -1235,6 +1242,16 @@ jabber_si_xfer_ibb_send_init(JabberStream *js, PurpleXfer *xfer)
 		purple_xfer_get_remote_user(xfer), xfer);
 
 	if (jsx->ibb_session) {
+		PurpleAccount *account = purple_connection_get_account(js->gc);
+
+		jabber_ibb_session_set_window(jsx->ibb_session,
+			purple_account_get_int(account, "ibb_window",
+				jabber_ibb_session_get_window(jsx->ibb_session)));
+		if (purple_account_get_bool(account, "ibb_message_stanzas", FALSE)) {
+			jabber_ibb_session_set_stanza_type(jsx->ibb_session,
+				JABBER_IBB_STANZA_MESSAGE);
+		}
+
 		/* should set callbacks here... */
 		jabber_ibb_session_set_opened_callback(jsx->ibb_session,
 			jabber_si_xfer_ibb_opened_cb);
@@ -1377,6 +1394,8 @@ static void jabber_si_xfer_send_request(PurpleXfer *xfer)
 	purple_xmlnode_insert_data(value, NS_IBB, -1);
 
 	jabber_iq_set_callback(iq, jabber_si_xfer_send_method_cb, xfer);
+	/* The reply waits on the remote user accepting the transfer. */
+	jabber_iq_set_timeout(iq, 0);
 
 	/* Store the IQ id so that we can cancel the callback */
 	g_free(jsx->iq_id);
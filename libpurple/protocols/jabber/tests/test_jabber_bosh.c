@@ -0,0 +1,401 @@
+#include <glib.h>
+
+#include <libsoup/soup.h>
+
+#include <purple.h>
+
+#include "tests/test_ui.h"
+
+#include "protocols/jabber/bosh.h"
+#include "protocols/jabber/jabber.h"
+
+#define TEST_BOSH_STANZAS 64
+#define TEST_BOSH_REQUESTS 3
+
+/******************************************************************************
+ * Stand-in connection manager
+ *
+ * Just enough of a BOSH connection manager to drive a connection over
+ * loopback: it creates a session, holds on to one empty request at a time,
+ * and answers requests that carry stanzas by echoing the stanzas back.
+ *****************************************************************************/
+typedef struct {
+	SoupServer *server;
+	gchar *url;
+
+	guint requests;
+	guint open;
+	guint max_open;
+
+	/* Empty requests held for the client. */
+	GQueue held;
+
+	/* When set, every other request with stanzas is answered only after
+	 * the one that follows it, so responses come back out of order. */
+	gboolean reorder;
+	SoupMessage *deferred;
+	gchar *deferred_body;
+} TestBoshServer;
+
+static void
+test_bosh_server_respond(TestBoshServer *stand_in, SoupMessage *msg,
+                         const gchar *payload, gboolean paused)
+{
+	gchar *body = g_strdup_printf("<body xmlns='" NS_BOSH "'>%s</body>",
+	                              payload ? payload : "");
+
+	soup_message_set_status(msg, SOUP_STATUS_OK);
+	soup_message_set_response(msg, "text/xml; charset=utf-8",
+	                          SOUP_MEMORY_TAKE, body, strlen(body));
+
+	if (paused)
+		soup_server_unpause_message(stand_in->server, msg);
+
+	stand_in->open--;
+}
+
+static void
+test_bosh_server_cb(SoupServer *server, SoupMessage *msg, const char *path,
+                    GHashTable *query, SoupClientContext *client,
+                    gpointer data)
+{
+	TestBoshServer *stand_in = data;
+	PurpleXmlNode *body, *child;
+	GString *payload;
+
+	body = purple_xmlnode_from_str(msg->request_body->data,
+	                               msg->request_body->length);
+	g_assert_nonnull(body);
+
+	if (purple_xmlnode_get_attrib(body, "sid") == NULL) {
+		gchar *created = g_strdup_printf(
+			"<body xmlns='" NS_BOSH "' sid='stand-in' wait='10' hold='1' "
+			"inactivity='60' ver='1.10' requests='%u'>"
+			"<stream:features xmlns:stream='" NS_XMPP_STREAMS "'>"
+			"<ver xmlns='" NS_ROSTER_VERSIONING "'/>"
+			"</stream:features></body>", stand_in->requests);
+
+		soup_message_set_status(msg, SOUP_STATUS_OK);
+		soup_message_set_response(msg, "text/xml; charset=utf-8",
+		                          SOUP_MEMORY_TAKE, created, strlen(created));
+		purple_xmlnode_free(body);
+		return;
+	}
+
+	stand_in->open++;
+	stand_in->max_open = MAX(stand_in->max_open, stand_in->open);
+
+	if (purple_strequal(purple_xmlnode_get_attrib(body, "type"), "terminate")) {
+		while (!g_queue_is_empty(&stand_in->held)) {
+			test_bosh_server_respond(stand_in,
+			                         g_queue_pop_head(&stand_in->held), NULL,
+			                         TRUE);
+		}
+		test_bosh_server_respond(stand_in, msg, NULL, FALSE);
+		purple_xmlnode_free(body);
+		return;
+	}
+
+	payload = g_string_new(NULL);
+	for (child = body->child; child != NULL; child = child->next) {
+		if (child->type == PURPLE_XMLNODE_TYPE_TAG) {
+			gchar *str = purple_xmlnode_to_str(child, NULL);
+			g_string_append(payload, str);
+			g_free(str);
+		}
+	}
+	purple_xmlnode_free(body);
+
+	if (payload->len == 0) {
+		/* Hold on to one empty request, like a real connection manager. */
+		soup_server_pause_message(server, msg);
+		g_queue_push_tail(&stand_in->held, msg);
+
+		if (stand_in->held.length > 1) {
+			test_bosh_server_respond(stand_in,
+			                         g_queue_pop_head(&stand_in->held), NULL,
+			                         TRUE);
+		}
+
+		g_string_free(payload, TRUE);
+		return;
+	}
+
+	/* A request with stanzas releases the one being held. */
+	while (!g_queue_is_empty(&stand_in->held)) {
+		test_bosh_server_respond(stand_in, g_queue_pop_head(&stand_in->held),
+		                         NULL, TRUE);
+	}
+
+	if (stand_in->reorder && stand_in->deferred == NULL) {
+		soup_server_pause_message(server, msg);
+		stand_in->deferred = msg;
+		stand_in->deferred_body = g_string_free(payload, FALSE);
+		return;
+	}
+
+	test_bosh_server_respond(stand_in, msg, payload->str, FALSE);
+	g_string_free(payload, TRUE);
+
+	if (stand_in->deferred != NULL) {
+		test_bosh_server_respond(stand_in, stand_in->deferred,
+		                         stand_in->deferred_body, TRUE);
+		g_clear_pointer(&stand_in->deferred_body, g_free);
+		stand_in->deferred = NULL;
+	}
+}
+
+static TestBoshServer *
+test_bosh_server_new(guint requests, gboolean reorder)
+{
+	TestBoshServer *stand_in = g_new0(TestBoshServer, 1);
+	GError *error = NULL;
+	GSList *uris;
+	gchar *base;
+
+	stand_in->requests = requests;
+	stand_in->reorder = reorder;
+	g_queue_init(&stand_in->held);
+
+	stand_in->server = soup_server_new(NULL, NULL);
+	soup_server_add_handler(stand_in->server, "/http-bind",
+	                        test_bosh_server_cb, stand_in, NULL);
+	soup_server_listen_local(stand_in->server, 0,
+	                         SOUP_SERVER_LISTEN_IPV4_ONLY, &error);
+	g_assert_no_error(error);
+
+	uris = soup_server_get_uris(stand_in->server);
+	g_assert_nonnull(uris);
+	base = soup_uri_to_string(uris->data, FALSE);
+	stand_in->url = g_strconcat(base, "http-bind", NULL);
+	g_free(base);
+	g_slist_free_full(uris, (GDestroyNotify)soup_uri_free);
+
+	return stand_in;
+}
+
+static void
+test_bosh_server_free(TestBoshServer *stand_in)
+{
+	soup_server_disconnect(stand_in->server);
+	g_object_unref(stand_in->server);
+	g_queue_clear(&stand_in->held);
+	g_free(stand_in->deferred_body);
+	g_free(stand_in->url);
+	g_free(stand_in);
+}
+
+/******************************************************************************
+ * Client
+ *****************************************************************************/
+typedef struct {
+	PurpleProtocol parent;
+} TestBoshProtocol;
+
+typedef struct {
+	PurpleProtocolClass parent;
+} TestBoshProtocolClass;
+
+static GType test_bosh_protocol_get_type(void);
+
+G_DEFINE_TYPE(TestBoshProtocol, test_bosh_protocol, PURPLE_TYPE_PROTOCOL)
+
+static void
+test_bosh_protocol_init(TestBoshProtocol *protocol) {
+}
+
+static void
+test_bosh_protocol_class_init(TestBoshProtocolClass *klass) {
+}
+
+typedef struct {
+	PurpleProtocol *protocol;
+	PurpleAccount *account;
+	PurpleConnection *gc;
+	JabberStream *js;
+	PurpleJabberBOSHConnection *conn;
+
+	gint64 sent[TEST_BOSH_STANZAS];
+	gint64 latency_total;
+	gint64 latency_max;
+	guint received;
+	guint max_in_flight;
+	gboolean in_order;
+} TestBoshClient;
+
+static void
+test_bosh_receiving_cb(PurpleConnection *gc, PurpleXmlNode **packet,
+                       gpointer data)
+{
+	TestBoshClient *client = data;
+	const gchar *id = purple_xmlnode_get_attrib(*packet, "id");
+	guint64 n = 0;
+
+	g_assert_nonnull(id);
+	g_ascii_string_to_unsigned(id, 10, 0, TEST_BOSH_STANZAS - 1, &n, NULL);
+
+	if (n != client->received) {
+		client->in_order = FALSE;
+	} else {
+		gint64 latency = g_get_monotonic_time() - client->sent[n];
+
+		client->latency_total += latency;
+		client->latency_max = MAX(client->latency_max, latency);
+	}
+	client->received++;
+
+	/* Nothing else needs to see it. */
+	*packet = NULL;
+}
+
+static gboolean
+test_bosh_timeout_cb(gpointer data) {
+	g_assert_not_reached();
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+test_bosh_run(guint requests, gboolean reorder, gboolean burst)
+{
+	TestBoshServer *stand_in = test_bosh_server_new(requests, reorder);
+	TestBoshClient client = { .in_order = TRUE };
+	gint64 start, elapsed;
+	guint timeout, i;
+
+	client.protocol = g_object_new(test_bosh_protocol_get_type(),
+	                               "id", "prpl-test-bosh", NULL);
+	purple_signal_register(client.protocol, "jabber-receiving-xmlnode",
+	                       purple_marshal_VOID__POINTER_POINTER, G_TYPE_NONE,
+	                       2, PURPLE_TYPE_CONNECTION, G_TYPE_POINTER);
+	purple_signal_connect(client.protocol, "jabber-receiving-xmlnode",
+	                      &client, PURPLE_CALLBACK(test_bosh_receiving_cb),
+	                      &client);
+
+	client.account = purple_account_new("test@localhost/bosh",
+	                                    "prpl-test-bosh");
+	purple_account_set_string(client.account, "connection_security",
+	                          "opportunistic_tls");
+	client.gc = g_object_new(PURPLE_TYPE_CONNECTION, "account",
+	                         client.account, "protocol", client.protocol,
+	                         NULL);
+
+	client.js = g_new0(JabberStream, 1);
+	client.js->gc = client.gc;
+	client.js->user = jabber_id_new("test@localhost/bosh");
+	client.js->max_inactivity = 600;
+
+	timeout = g_timeout_add_seconds(30, test_bosh_timeout_cb, NULL);
+
+	client.conn = jabber_bosh_connection_new(client.js, stand_in->url);
+	g_assert_nonnull(client.conn);
+
+	while (client.js->state != JABBER_STREAM_AUTHENTICATING)
+		g_main_context_iteration(NULL, TRUE);
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < TEST_BOSH_STANZAS; i++) {
+		gchar *stanza = g_strdup_printf("<message xmlns='jabber:client' "
+		                                "id='%u'/>", i);
+
+		client.sent[i] = g_get_monotonic_time();
+		jabber_bosh_connection_send(client.conn, stanza);
+		g_free(stanza);
+
+		/* Without a burst, every stanza gets a main loop iteration of its
+		 * own and so a request of its own when a slot is free. */
+		if (!burst || i % 8 == 7) {
+			while (g_main_context_iteration(NULL, FALSE));
+		}
+
+		client.max_in_flight = MAX(client.max_in_flight,
+			jabber_bosh_connection_get_requests_in_flight(client.conn));
+	}
+
+	while (client.received < TEST_BOSH_STANZAS) {
+		g_main_context_iteration(NULL, TRUE);
+		client.max_in_flight = MAX(client.max_in_flight,
+			jabber_bosh_connection_get_requests_in_flight(client.conn));
+	}
+	elapsed = g_get_monotonic_time() - start;
+
+	g_test_message("%u stanzas in %" G_GINT64_FORMAT " us (%.0f stanzas/s), "
+	               "latency mean %" G_GINT64_FORMAT " us max %" G_GINT64_FORMAT
+	               " us, %u requests in flight at most",
+	               TEST_BOSH_STANZAS, elapsed,
+	               TEST_BOSH_STANZAS * (G_USEC_PER_SEC / (gdouble)MAX(elapsed, 1)),
+	               client.latency_total / TEST_BOSH_STANZAS,
+	               client.latency_max, client.max_in_flight);
+
+	g_assert_true(client.in_order);
+	g_assert_cmpuint(client.received, ==, TEST_BOSH_STANZAS);
+	g_assert_cmpuint(client.max_in_flight, <=, requests);
+	g_assert_cmpuint(stand_in->max_open, <=, requests);
+	if (requests > 1) {
+		g_assert_cmpuint(client.max_in_flight, >, 1);
+	}
+
+	jabber_bosh_connection_destroy(client.conn);
+	g_source_remove(timeout);
+	g_clear_handle_id(&client.js->inactivity_timer, g_source_remove);
+
+	jabber_id_free(client.js->user);
+	g_free(client.js);
+	g_object_unref(client.gc);
+	g_object_unref(client.account);
+	purple_signals_disconnect_by_handle(&client);
+	purple_signals_unregister_by_instance(client.protocol);
+	g_object_unref(client.protocol);
+
+	test_bosh_server_free(stand_in);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_jabber_bosh_single_request(void) {
+	test_bosh_run(1, FALSE, FALSE);
+}
+
+static void
+test_jabber_bosh_window(void) {
+	test_bosh_run(TEST_BOSH_REQUESTS, FALSE, FALSE);
+}
+
+static void
+test_jabber_bosh_window_burst(void) {
+	test_bosh_run(TEST_BOSH_REQUESTS, FALSE, TRUE);
+}
+
+static void
+test_jabber_bosh_out_of_order(void) {
+	test_bosh_run(TEST_BOSH_REQUESTS, TRUE, FALSE);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	gint res = 0;
+
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+	jabber_bosh_init();
+
+	g_test_add_func("/jabber/bosh/single request",
+	                test_jabber_bosh_single_request);
+	g_test_add_func("/jabber/bosh/window", test_jabber_bosh_window);
+	g_test_add_func("/jabber/bosh/window burst",
+	                test_jabber_bosh_window_burst);
+	g_test_add_func("/jabber/bosh/out of order",
+	                test_jabber_bosh_out_of_order);
+
+	res = g_test_run();
+
+	jabber_bosh_uninit();
+
+	return res;
+}
@@ -0,0 +1,349 @@
+#include <glib.h>
+
+#include <purple.h>
+
+#include "tests/test_ui.h"
+
+#include "protocols/jabber/ibb.h"
+#include "protocols/jabber/iq.h"
+#include "protocols/jabber/jabber.h"
+
+#define TEST_IBB_PEER "peer@localhost/ibb"
+#define TEST_IBB_WINDOW 4
+
+/******************************************************************************
+ * Stand-in stream
+ *
+ * Stanzas the session sends are kept instead of going anywhere, and the
+ * tests answer them by feeding replies to jabber_iq_parse().
+ *****************************************************************************/
+typedef struct {
+	PurpleProtocol parent;
+} TestIbbProtocol;
+
+typedef struct {
+	PurpleProtocolClass parent;
+} TestIbbProtocolClass;
+
+static GType test_ibb_protocol_get_type(void);
+
+G_DEFINE_TYPE(TestIbbProtocol, test_ibb_protocol, PURPLE_TYPE_PROTOCOL)
+
+static void
+test_ibb_protocol_init(TestIbbProtocol *protocol) {
+}
+
+static void
+test_ibb_protocol_class_init(TestIbbProtocolClass *klass) {
+}
+
+typedef struct {
+	PurpleProtocol *protocol;
+	PurpleAccount *account;
+	PurpleConnection *gc;
+	JabberStream *js;
+	JabberIBBSession *sess;
+
+	/* copies of everything that was sent, oldest first */
+	GQueue sent;
+
+	/* blocks the data sent callback still has to write */
+	guint to_send;
+	guint errors;
+} TestIbb;
+
+static void
+test_ibb_sending_cb(PurpleConnection *gc, PurpleXmlNode **packet,
+                    gpointer data)
+{
+	TestIbb *test = data;
+
+	g_queue_push_tail(&test->sent, purple_xmlnode_copy(*packet));
+}
+
+static void
+test_ibb_data_sent_cb(JabberIBBSession *sess)
+{
+	TestIbb *test = jabber_ibb_session_get_user_data(sess);
+
+	if (test->to_send > 0) {
+		test->to_send--;
+		jabber_ibb_session_send_data(sess, "block", 5);
+	}
+}
+
+static void
+test_ibb_error_cb(JabberIBBSession *sess)
+{
+	TestIbb *test = jabber_ibb_session_get_user_data(sess);
+
+	test->errors++;
+}
+
+static void
+test_ibb_iterate(void)
+{
+	while (g_main_context_iteration(NULL, FALSE));
+}
+
+/* Answers the sent stanza at position with an IQ of the given type. */
+static void
+test_ibb_reply(TestIbb *test, guint position, const gchar *type)
+{
+	PurpleXmlNode *request = g_queue_peek_nth(&test->sent, position);
+	PurpleXmlNode *reply;
+
+	g_assert_nonnull(request);
+	g_assert_cmpstr(request->name, ==, "iq");
+
+	reply = purple_xmlnode_new("iq");
+	purple_xmlnode_set_attrib(reply, "type", type);
+	purple_xmlnode_set_attrib(reply, "id",
+	                          purple_xmlnode_get_attrib(request, "id"));
+	purple_xmlnode_set_attrib(reply, "from", TEST_IBB_PEER);
+
+	if (purple_strequal(type, "error")) {
+		PurpleXmlNode *error = purple_xmlnode_new_child(reply, "error");
+		PurpleXmlNode *condition = NULL;
+
+		purple_xmlnode_set_attrib(error, "type", "wait");
+		condition = purple_xmlnode_new_child(error, "remote-server-timeout");
+		purple_xmlnode_set_namespace(condition, NS_XMPP_STANZAS);
+	}
+
+	jabber_iq_parse(test->js, reply);
+	purple_xmlnode_free(reply);
+
+	test_ibb_iterate();
+}
+
+/* Counts the sent stanzas from position on that are named name and, when
+ * child isn't NULL, have a child of that name. */
+static guint
+test_ibb_count(TestIbb *test, guint position, const gchar *name,
+               const gchar *child)
+{
+	guint count = 0;
+
+	for (GList *l = g_queue_peek_nth_link(&test->sent, position); l != NULL;
+	     l = l->next)
+	{
+		PurpleXmlNode *node = l->data;
+
+		if (!purple_strequal(node->name, name)) {
+			continue;
+		}
+
+		if (child == NULL || purple_xmlnode_get_child(node, child) != NULL) {
+			count++;
+		}
+	}
+
+	return count;
+}
+
+static void
+test_ibb_setup(TestIbb *test, JabberIBBStanzaType stanza)
+{
+	test->protocol = g_object_new(test_ibb_protocol_get_type(),
+	                              "id", "prpl-test-ibb", NULL);
+	purple_signal_register(test->protocol, "jabber-sending-xmlnode",
+	                       purple_marshal_VOID__POINTER_POINTER, G_TYPE_NONE,
+	                       2, PURPLE_TYPE_CONNECTION, G_TYPE_POINTER);
+	purple_signal_register(test->protocol, "jabber-receiving-iq",
+	                       purple_marshal_BOOLEAN__POINTER_POINTER_POINTER_POINTER_POINTER,
+	                       G_TYPE_BOOLEAN, 5, PURPLE_TYPE_CONNECTION,
+	                       G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
+	                       PURPLE_TYPE_XMLNODE);
+	purple_signal_register(test->protocol, "jabber-iq-completed",
+	                       purple_marshal_VOID__POINTER_POINTER_POINTER_UINT_UINT,
+	                       G_TYPE_NONE, 5, PURPLE_TYPE_CONNECTION,
+	                       G_TYPE_STRING, G_TYPE_STRING, G_TYPE_UINT,
+	                       G_TYPE_UINT);
+	purple_signal_connect(test->protocol, "jabber-sending-xmlnode", test,
+	                      PURPLE_CALLBACK(test_ibb_sending_cb), test);
+
+	test->account = purple_account_new("test@localhost/ibb",
+	                                   "prpl-test-ibb");
+	test->gc = g_object_new(PURPLE_TYPE_CONNECTION, "account", test->account,
+	                        "protocol", test->protocol, NULL);
+
+	test->js = g_new0(JabberStream, 1);
+	test->js->gc = test->gc;
+	test->js->user = jabber_id_new("test@localhost/ibb");
+	jabber_iq_callbacks_init(test->js);
+
+	g_queue_init(&test->sent);
+
+	test->sess = jabber_ibb_session_create(test->js, "test-sid",
+	                                       TEST_IBB_PEER, test);
+	jabber_ibb_session_set_data_sent_callback(test->sess,
+	                                          test_ibb_data_sent_cb);
+	jabber_ibb_session_set_error_callback(test->sess, test_ibb_error_cb);
+	jabber_ibb_session_set_window(test->sess, TEST_IBB_WINDOW);
+	jabber_ibb_session_set_stanza_type(test->sess, stanza);
+
+	jabber_ibb_session_open(test->sess);
+	g_assert_cmpuint(test_ibb_count(test, 0, "iq", "open"), ==, 1);
+	test_ibb_reply(test, 0, "result");
+	g_assert_cmpint(jabber_ibb_session_get_state(test->sess), ==,
+	                JABBER_IBB_SESSION_OPENED);
+}
+
+static void
+test_ibb_teardown(TestIbb *test)
+{
+	jabber_ibb_session_destroy(test->sess);
+
+	jabber_iq_callbacks_destroy(test->js);
+	jabber_id_free(test->js->user);
+	g_free(test->js);
+
+	g_queue_clear_full(&test->sent, (GDestroyNotify)purple_xmlnode_free);
+
+	g_object_unref(test->gc);
+	g_object_unref(test->account);
+	purple_signals_disconnect_by_handle(test);
+	purple_signals_unregister_by_instance(test->protocol);
+	g_object_unref(test->protocol);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_jabber_ibb_window(void) {
+	TestIbb test = { .to_send = 10 };
+	guint acked;
+
+	test_ibb_setup(&test, JABBER_IBB_STANZA_IQ);
+
+	/* The window fills up without waiting for any answers. */
+	test_ibb_data_sent_cb(test.sess);
+	test_ibb_iterate();
+	g_assert_cmpuint(test_ibb_count(&test, 0, "iq", "data"), ==,
+	                 TEST_IBB_WINDOW);
+	g_assert_cmpuint(jabber_ibb_session_get_outstanding(test.sess), ==,
+	                 TEST_IBB_WINDOW);
+	g_assert_cmpuint(test.to_send, ==, 10 - TEST_IBB_WINDOW);
+
+	/* Each answer makes room for exactly one more block. */
+	acked = test.sent.length;
+	test_ibb_reply(&test, 1, "result");
+	g_assert_cmpuint(test_ibb_count(&test, acked, "iq", "data"), ==, 1);
+	g_assert_cmpuint(jabber_ibb_session_get_outstanding(test.sess), ==,
+	                 TEST_IBB_WINDOW);
+	g_assert_cmpuint(jabber_ibb_session_get_send_seq(test.sess), ==,
+	                 TEST_IBB_WINDOW + 1);
+	g_assert_cmpuint(test.errors, ==, 0);
+
+	test_ibb_teardown(&test);
+}
+
+static void
+test_jabber_ibb_message_sync(void) {
+	TestIbb test = { .to_send = 3 };
+	guint first_ping, second_ping;
+
+	test_ibb_setup(&test, JABBER_IBB_STANZA_MESSAGE);
+
+	/* Two message blocks and then a ping to confirm them, since that's half
+	 * the window, then the last block. */
+	test_ibb_data_sent_cb(test.sess);
+	test_ibb_iterate();
+	g_assert_cmpuint(test_ibb_count(&test, 0, "message", "data"), ==, 3);
+	g_assert_cmpuint(test_ibb_count(&test, 0, "iq", "ping"), ==, 1);
+	g_assert_cmpuint(jabber_ibb_session_get_outstanding(test.sess), ==, 3);
+
+	first_ping = 3;
+	g_assert_nonnull(purple_xmlnode_get_child(
+		g_queue_peek_nth(&test.sent, first_ping), "ping"));
+
+	/* The last block is only confirmed once we ask for it. */
+	second_ping = test.sent.length;
+	jabber_ibb_session_flush(test.sess);
+	g_assert_cmpuint(test_ibb_count(&test, second_ping, "iq", "ping"), ==, 1);
+	g_assert_cmpuint(jabber_ibb_session_get_outstanding(test.sess), ==, 3);
+
+	/* Nothing is left to sync. */
+	jabber_ibb_session_flush(test.sess);
+	g_assert_cmpuint(test.sent.length, ==, second_ping + 1);
+
+	test_ibb_reply(&test, first_ping, "result");
+	g_assert_cmpuint(jabber_ibb_session_get_outstanding(test.sess), ==, 1);
+
+	test_ibb_reply(&test, second_ping, "result");
+	g_assert_cmpuint(jabber_ibb_session_get_outstanding(test.sess), ==, 0);
+	g_assert_cmpint(jabber_ibb_session_get_state(test.sess), ==,
+	                JABBER_IBB_SESSION_OPENED);
+	g_assert_cmpuint(test.errors, ==, 0);
+
+	test_ibb_teardown(&test);
+}
+
+static void
+test_jabber_ibb_block_error(void) {
+	TestIbb test = { .to_send = 2 };
+
+	test_ibb_setup(&test, JABBER_IBB_STANZA_IQ);
+
+	test_ibb_data_sent_cb(test.sess);
+	test_ibb_iterate();
+	g_assert_cmpuint(test.to_send, ==, 0);
+
+	test_ibb_reply(&test, 1, "error");
+	g_assert_cmpint(jabber_ibb_session_get_state(test.sess), ==,
+	                JABBER_IBB_SESSION_ERROR);
+	g_assert_cmpuint(test.errors, ==, 1);
+
+	test_ibb_teardown(&test);
+}
+
+static void
+test_jabber_ibb_sync_error(void) {
+	TestIbb test = { .to_send = 2 };
+	guint sent;
+
+	test_ibb_setup(&test, JABBER_IBB_STANZA_MESSAGE);
+
+	test_ibb_data_sent_cb(test.sess);
+	test_ibb_iterate();
+	g_assert_cmpuint(test_ibb_count(&test, 0, "iq", "ping"), ==, 1);
+
+	/* A ping that failed, like one that timed out, doesn't confirm the
+	 * blocks before it and doesn't free up the window. */
+	test.to_send = 1;
+	sent = test.sent.length;
+	test_ibb_reply(&test, 3, "error");
+	g_assert_cmpint(jabber_ibb_session_get_state(test.sess), ==,
+	                JABBER_IBB_SESSION_ERROR);
+	g_assert_cmpuint(test.errors, ==, 1);
+	g_assert_cmpuint(test_ibb_count(&test, sent, "message", "data"), ==, 0);
+
+	test_ibb_teardown(&test);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	gint res = 0;
+
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+	jabber_ibb_init();
+
+	g_test_add_func("/jabber/ibb/window", test_jabber_ibb_window);
+	g_test_add_func("/jabber/ibb/message sync",
+	                test_jabber_ibb_message_sync);
+	g_test_add_func("/jabber/ibb/error/block", test_jabber_ibb_block_error);
+	g_test_add_func("/jabber/ibb/error/sync", test_jabber_ibb_sync_error);
+
+	res = g_test_run();
+
+	jabber_ibb_uninit();
+
+	return res;
+}
@@ -0,0 +1,299 @@
+#include <glib.h>
+
+#include <purple.h>
+
+#include "tests/test_ui.h"
+
+#include "protocols/jabber/iq.h"
+#include "protocols/jabber/jabber.h"
+#include "protocols/jabber/namespaces.h"
+
+#define TEST_IQ_PEER "peer@localhost/iq"
+
+/******************************************************************************
+ * Stand-in stream
+ *
+ * IQs are sent nowhere, the tests answer them by feeding replies to
+ * jabber_iq_parse().
+ *****************************************************************************/
+typedef struct {
+	PurpleProtocol parent;
+} TestIqProtocol;
+
+typedef struct {
+	PurpleProtocolClass parent;
+} TestIqProtocolClass;
+
+static GType test_iq_protocol_get_type(void);
+
+G_DEFINE_TYPE(TestIqProtocol, test_iq_protocol, PURPLE_TYPE_PROTOCOL)
+
+static void
+test_iq_protocol_init(TestIqProtocol *protocol) {
+}
+
+static void
+test_iq_protocol_class_init(TestIqProtocolClass *klass) {
+}
+
+typedef struct {
+	PurpleProtocol *protocol;
+	PurpleAccount *account;
+	PurpleConnection *gc;
+	JabberStream *js;
+
+	/* what the callback was last called with */
+	guint called;
+	JabberIqType type;
+	gchar *id;
+	gchar *condition;
+
+	guint destroyed;
+} TestIq;
+
+static void
+test_iq_cb(JabberStream *js, const char *from, JabberIqType type,
+           const char *id, PurpleXmlNode *packet, gpointer data)
+{
+	TestIq *test = data;
+	PurpleXmlNode *error = NULL;
+
+	test->called++;
+	test->type = type;
+
+	g_free(test->id);
+	test->id = g_strdup(id);
+
+	g_clear_pointer(&test->condition, g_free);
+	error = purple_xmlnode_get_child(packet, "error");
+	if (error != NULL) {
+		for (PurpleXmlNode *child = error->child; child != NULL;
+		     child = child->next)
+		{
+			if (child->type == PURPLE_XMLNODE_TYPE_TAG) {
+				test->condition = g_strdup(child->name);
+				break;
+			}
+		}
+	}
+}
+
+static void
+test_iq_destroy_cb(gpointer data)
+{
+	TestIq *test = data;
+
+	test->destroyed++;
+}
+
+/* Sends a get with a callback and returns its id. */
+static gchar *
+test_iq_send(TestIq *test, guint timeout)
+{
+	JabberIq *iq = jabber_iq_new_query(test->js, JABBER_IQ_GET, NS_PING);
+	gchar *id = g_strdup(iq->id);
+
+	purple_xmlnode_set_attrib(iq->node, "to", TEST_IQ_PEER);
+	jabber_iq_set_callback_full(iq, test_iq_cb, test, test_iq_destroy_cb);
+	jabber_iq_set_timeout(iq, timeout);
+	jabber_iq_send(iq);
+
+	return id;
+}
+
+static void
+test_iq_reply(TestIq *test, const gchar *id, const gchar *type)
+{
+	PurpleXmlNode *reply = purple_xmlnode_new("iq");
+
+	purple_xmlnode_set_attrib(reply, "type", type);
+	purple_xmlnode_set_attrib(reply, "id", id);
+	purple_xmlnode_set_attrib(reply, "from", TEST_IQ_PEER);
+
+	jabber_iq_parse(test->js, reply);
+	purple_xmlnode_free(reply);
+}
+
+static gboolean
+test_iq_give_up_cb(gpointer data)
+{
+	g_assert_not_reached();
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+test_iq_setup(TestIq *test)
+{
+	test->protocol = g_object_new(test_iq_protocol_get_type(),
+	                              "id", "prpl-test-iq", NULL);
+	purple_signal_register(test->protocol, "jabber-sending-xmlnode",
+	                       purple_marshal_VOID__POINTER_POINTER, G_TYPE_NONE,
+	                       2, PURPLE_TYPE_CONNECTION, G_TYPE_POINTER);
+	purple_signal_register(test->protocol, "jabber-receiving-iq",
+	                       purple_marshal_BOOLEAN__POINTER_POINTER_POINTER_POINTER_POINTER,
+	                       G_TYPE_BOOLEAN, 5, PURPLE_TYPE_CONNECTION,
+	                       G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
+	                       PURPLE_TYPE_XMLNODE);
+	purple_signal_register(test->protocol, "jabber-iq-completed",
+	                       purple_marshal_VOID__POINTER_POINTER_POINTER_UINT_UINT,
+	                       G_TYPE_NONE, 5, PURPLE_TYPE_CONNECTION,
+	                       G_TYPE_STRING, G_TYPE_STRING, G_TYPE_UINT,
+	                       G_TYPE_UINT);
+
+	test->account = purple_account_new("test@localhost/iq", "prpl-test-iq");
+	test->gc = g_object_new(PURPLE_TYPE_CONNECTION, "account", test->account,
+	                        "protocol", test->protocol, NULL);
+
+	test->js = g_new0(JabberStream, 1);
+	test->js->gc = test->gc;
+	test->js->user = jabber_id_new("test@localhost/iq");
+	jabber_iq_callbacks_init(test->js);
+}
+
+static void
+test_iq_teardown(TestIq *test)
+{
+	jabber_iq_callbacks_destroy(test->js);
+	jabber_id_free(test->js->user);
+	g_free(test->js);
+
+	g_free(test->id);
+	g_free(test->condition);
+
+	g_object_unref(test->gc);
+	g_object_unref(test->account);
+	purple_signals_unregister_by_instance(test->protocol);
+	g_object_unref(test->protocol);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_jabber_iq_format_id(void) {
+	char buf[JABBER_ID_SIZE];
+
+	g_assert_cmpstr(jabber_format_id(0, buf), ==, "purple0");
+	g_assert_cmpstr(jabber_format_id(0x1a2b, buf), ==, "purple1a2b");
+	g_assert_cmpstr(jabber_format_id(0x10000000, buf), ==, "purple10000000");
+	g_assert_cmpstr(jabber_format_id(G_MAXUINT32, buf), ==,
+	                "purpleffffffff");
+}
+
+static void
+test_jabber_iq_callback(void) {
+	TestIq test = { 0 };
+	gchar *id = NULL;
+
+	test_iq_setup(&test);
+
+	test.js->next_id = 0xabc;
+	id = test_iq_send(&test, JABBER_IQ_DEFAULT_TIMEOUT);
+	g_assert_cmpstr(id, ==, "purpleabc");
+	g_assert_cmpuint(jabber_iq_get_in_flight(test.js, NS_PING), ==, 1);
+
+	/* Other spellings of the same number aren't our id. */
+	test_iq_reply(&test, "purpleABC", "result");
+	test_iq_reply(&test, "purple0abc", "result");
+	g_assert_cmpuint(test.called, ==, 0);
+
+	test_iq_reply(&test, id, "result");
+	g_assert_cmpuint(test.called, ==, 1);
+	g_assert_cmpint(test.type, ==, JABBER_IQ_RESULT);
+	g_assert_cmpstr(test.id, ==, id);
+	g_assert_cmpuint(test.destroyed, ==, 1);
+	g_assert_cmpuint(jabber_iq_get_in_flight(test.js, NULL), ==, 0);
+
+	/* The callback is gone after the first reply. */
+	test_iq_reply(&test, id, "result");
+	g_assert_cmpuint(test.called, ==, 1);
+	g_assert_cmpuint(test.destroyed, ==, 1);
+
+	g_free(id);
+	test_iq_teardown(&test);
+}
+
+static void
+test_jabber_iq_timeout(void) {
+	TestIq test = { 0 };
+	gchar *id = NULL;
+	guint give_up = 0;
+
+	test_iq_setup(&test);
+
+	id = test_iq_send(&test, 1);
+
+	give_up = g_timeout_add_seconds(10, test_iq_give_up_cb, NULL);
+	while (test.called == 0) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+	g_source_remove(give_up);
+
+	/* It looks like the server gave up on our behalf. */
+	g_assert_cmpuint(test.called, ==, 1);
+	g_assert_cmpint(test.type, ==, JABBER_IQ_ERROR);
+	g_assert_cmpstr(test.id, ==, id);
+	g_assert_cmpstr(test.condition, ==, "remote-server-timeout");
+	g_assert_cmpuint(test.destroyed, ==, 1);
+	g_assert_cmpuint(jabber_iq_get_in_flight(test.js, NULL), ==, 0);
+
+	/* A late reply is ignored. */
+	test_iq_reply(&test, id, "result");
+	g_assert_cmpuint(test.called, ==, 1);
+
+	g_free(id);
+	test_iq_teardown(&test);
+}
+
+static void
+test_jabber_iq_destroy(void) {
+	TestIq test = { 0 };
+	JabberIq *iq = NULL;
+	gchar *id = NULL;
+
+	test_iq_setup(&test);
+
+	/* An IQ that is never sent still lets go of its data. */
+	iq = jabber_iq_new_query(test.js, JABBER_IQ_GET, NS_PING);
+	jabber_iq_set_callback_full(iq, test_iq_cb, &test, test_iq_destroy_cb);
+	jabber_iq_free(iq);
+	g_assert_cmpuint(test.destroyed, ==, 1);
+
+	/* Neither does one that was replaced by another with the same id. */
+	id = test_iq_send(&test, JABBER_IQ_DEFAULT_TIMEOUT);
+	iq = jabber_iq_new_query(test.js, JABBER_IQ_GET, NS_PING);
+	jabber_iq_set_id(iq, id);
+	purple_xmlnode_set_attrib(iq->node, "to", TEST_IQ_PEER);
+	jabber_iq_set_callback_full(iq, test_iq_cb, &test, test_iq_destroy_cb);
+	jabber_iq_send(iq);
+	g_assert_cmpuint(test.destroyed, ==, 2);
+	g_assert_cmpuint(jabber_iq_get_in_flight(test.js, NULL), ==, 1);
+	g_free(id);
+
+	/* Tearing the stream down drops what is left without calling it. */
+	g_free(test_iq_send(&test, JABBER_IQ_DEFAULT_TIMEOUT));
+	g_assert_cmpuint(jabber_iq_get_in_flight(test.js, NULL), ==, 2);
+	jabber_iq_callbacks_destroy(test.js);
+	g_assert_cmpuint(test.destroyed, ==, 4);
+	g_assert_cmpuint(test.called, ==, 0);
+
+	test_iq_teardown(&test);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+
+	g_test_add_func("/jabber/iq/format-id", test_jabber_iq_format_id);
+	g_test_add_func("/jabber/iq/callback", test_jabber_iq_callback);
+	g_test_add_func("/jabber/iq/timeout", test_jabber_iq_timeout);
+	g_test_add_func("/jabber/iq/destroy", test_jabber_iq_destroy);
+
+	return g_test_run();
+}
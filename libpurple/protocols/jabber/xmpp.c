@@ -71,6 +71,15 @@ xmpp_protocol_get_account_options(PurpleProtocol *protocol) {
 	                                          "ft_proxies", NULL);
 	opts = g_list_append(opts, option);
 
+	option = purple_account_option_int_new(_("In-band transfer window"),
+	                                       "ibb_window", 8);
+	opts = g_list_append(opts, option);
+
+	option = purple_account_option_bool_new(_("Send in-band transfers as "
+	                                          "messages"),
+	                                        "ibb_message_stanzas", FALSE);
+	opts = g_list_append(opts, option);
+
 	option = purple_account_option_string_new(_("BOSH URL"), "bosh_url", NULL);
 	opts = g_list_append(opts, option);
 
@@ -0,0 +1,683 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "purpleavatarfetcher.h"
+
+#include "buddyicon.h"
+#include "buddylist.h"
+#include "connection.h"
+#include "debug.h"
+#include "purpleconversationmanager.h"
+#include "purpleimconversation.h"
+#include "purpleprivate.h"
+#include "signals.h"
+#include "util.h"
+
+/* The fetches of a single account. Every username that is waiting for an
+ * avatar maps to exactly one fetch in users, and fetches whose checksum
+ * identifies the image are also found by that checksum in shared. */
+typedef struct {
+	PurpleAccount *account;
+
+	GQueue high;
+	GQueue normal;
+	/* Every fetch that has been started and not finished, including ones
+	 * that nobody is waiting on anymore. */
+	GQueue running;
+	GHashTable *users;
+	GHashTable *shared;
+
+	guint active;
+	guint limit;
+	guint timeout;
+	gboolean pumping;
+} PurpleAvatarFetcherQueue;
+
+struct _PurpleAvatarFetch {
+	PurpleAvatarFetcherQueue *queue;
+	PurpleAccount *account;
+
+	gchar *checksum;
+	gboolean shared;
+	gboolean high;
+	gboolean active;
+	GList *link;
+	guint timeout_id;
+
+	/* The usernames that receive the result, first one first. */
+	GPtrArray *users;
+
+	PurpleAvatarFetchFunc func;
+	gpointer data;
+	GDestroyNotify destroy;
+};
+
+struct _PurpleAvatarFetcher {
+	GObject parent;
+
+	GHashTable *queues;
+};
+
+G_DEFINE_TYPE(PurpleAvatarFetcher, purple_avatar_fetcher, G_TYPE_OBJECT)
+
+static PurpleAvatarFetcher *default_fetcher = NULL;
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static PurpleAvatarFetch *
+purple_avatar_fetch_new(PurpleAvatarFetcherQueue *queue, const gchar *checksum,
+                        PurpleAvatarFetchFlags flags,
+                        PurpleAvatarFetchFunc func, gpointer data,
+                        GDestroyNotify destroy)
+{
+	PurpleAvatarFetch *fetch = g_new0(PurpleAvatarFetch, 1);
+
+	fetch->queue = queue;
+	fetch->account = g_object_ref(queue->account);
+	fetch->checksum = g_strdup(checksum);
+	fetch->shared = checksum != NULL &&
+	                (flags & PURPLE_AVATAR_FETCH_FLAGS_CONTENT_CHECKSUM) != 0;
+	fetch->high = (flags & PURPLE_AVATAR_FETCH_FLAGS_HIGH_PRIORITY) != 0;
+	fetch->users = g_ptr_array_new_with_free_func(g_free);
+	fetch->func = func;
+	fetch->data = data;
+	fetch->destroy = destroy;
+
+	return fetch;
+}
+
+static void
+purple_avatar_fetch_free(PurpleAvatarFetch *fetch) {
+	if(fetch->destroy != NULL) {
+		fetch->destroy(fetch->data);
+	}
+
+	g_ptr_array_free(fetch->users, TRUE);
+	g_free(fetch->checksum);
+	g_object_unref(fetch->account);
+	g_free(fetch);
+}
+
+static PurpleAvatarFetcherQueue *
+purple_avatar_fetcher_queue_new(PurpleAccount *account) {
+	PurpleAvatarFetcherQueue *queue = g_new0(PurpleAvatarFetcherQueue, 1);
+
+	queue->account = g_object_ref(account);
+	g_queue_init(&queue->high);
+	g_queue_init(&queue->normal);
+	g_queue_init(&queue->running);
+	queue->users = g_hash_table_new(g_str_hash, g_str_equal);
+	queue->shared = g_hash_table_new(g_str_hash, g_str_equal);
+	queue->limit = PURPLE_AVATAR_FETCHER_DEFAULT_LIMIT;
+	queue->timeout = PURPLE_AVATAR_FETCHER_DEFAULT_TIMEOUT;
+
+	return queue;
+}
+
+/* Frees the queue along with every fetch that has not been started. Active
+ * fetches are orphaned, and are freed when their protocol finishes them. */
+static void
+purple_avatar_fetcher_queue_free(PurpleAvatarFetcherQueue *queue) {
+	PurpleAvatarFetch *fetch = NULL;
+
+	/* Not every active fetch can be reached through users, since a user can
+	 * move on to a newer checksum while their old fetch is still running. */
+	while((fetch = g_queue_pop_head(&queue->running)) != NULL) {
+		g_clear_handle_id(&fetch->timeout_id, g_source_remove);
+		fetch->queue = NULL;
+		fetch->link = NULL;
+	}
+
+	g_queue_clear_full(&queue->high, (GDestroyNotify)purple_avatar_fetch_free);
+	g_queue_clear_full(&queue->normal,
+	                   (GDestroyNotify)purple_avatar_fetch_free);
+
+	g_hash_table_destroy(queue->users);
+	g_hash_table_destroy(queue->shared);
+	g_object_unref(queue->account);
+	g_free(queue);
+}
+
+static PurpleAvatarFetcherQueue *
+purple_avatar_fetcher_get_queue(PurpleAvatarFetcher *fetcher,
+                                PurpleAccount *account, gboolean create)
+{
+	PurpleAvatarFetcherQueue *queue = NULL;
+
+	queue = g_hash_table_lookup(fetcher->queues, account);
+	if(queue == NULL && create) {
+		queue = purple_avatar_fetcher_queue_new(account);
+		g_hash_table_insert(fetcher->queues, account, queue);
+	}
+
+	return queue;
+}
+
+static void
+purple_avatar_fetcher_queue_promote(PurpleAvatarFetcherQueue *queue,
+                                    PurpleAvatarFetch *fetch)
+{
+	if(fetch->active || fetch->high) {
+		return;
+	}
+
+	g_queue_remove(&queue->normal, fetch);
+	g_queue_push_tail(&queue->high, fetch);
+	fetch->high = TRUE;
+}
+
+/* Removes username from the fetch it is waiting on. A queued fetch that no
+ * longer has anyone waiting on it is dropped altogether. */
+static void
+purple_avatar_fetcher_queue_detach(PurpleAvatarFetcherQueue *queue,
+                                   PurpleAvatarFetch *fetch,
+                                   const gchar *username)
+{
+	guint i;
+
+	g_hash_table_remove(queue->users, username);
+
+	for(i = 0; i < fetch->users->len; i++) {
+		if(purple_strequal(g_ptr_array_index(fetch->users, i), username)) {
+			g_ptr_array_remove_index(fetch->users, i);
+			break;
+		}
+	}
+
+	if(fetch->users->len > 0 || fetch->active) {
+		return;
+	}
+
+	if(!g_queue_remove(&queue->high, fetch)) {
+		g_queue_remove(&queue->normal, fetch);
+	}
+
+	if(fetch->shared) {
+		g_hash_table_remove(queue->shared, fetch->checksum);
+	}
+
+	purple_avatar_fetch_free(fetch);
+}
+
+/* Forgets a fetch that is finishing, so that nothing new attaches to it. */
+static void
+purple_avatar_fetcher_queue_finish(PurpleAvatarFetcherQueue *queue,
+                                   PurpleAvatarFetch *fetch)
+{
+	guint i;
+
+	for(i = 0; i < fetch->users->len; i++) {
+		const gchar *username = g_ptr_array_index(fetch->users, i);
+
+		if(g_hash_table_lookup(queue->users, username) == fetch) {
+			g_hash_table_remove(queue->users, username);
+		}
+	}
+
+	if(fetch->shared &&
+	   g_hash_table_lookup(queue->shared, fetch->checksum) == fetch)
+	{
+		g_hash_table_remove(queue->shared, fetch->checksum);
+	}
+
+	g_queue_delete_link(&queue->running, fetch->link);
+	fetch->link = NULL;
+
+	g_clear_handle_id(&fetch->timeout_id, g_source_remove);
+
+	queue->active--;
+}
+
+static void purple_avatar_fetcher_queue_pump(PurpleAvatarFetcherQueue *queue);
+
+/* Gives up on a fetch that is taking too long, so that it stops holding one
+ * of the account's slots. The protocol still has to finish it, but the fetch
+ * is orphaned, so its result is discarded. */
+static gboolean
+purple_avatar_fetch_timeout_cb(gpointer data) {
+	PurpleAvatarFetch *fetch = data;
+	PurpleAvatarFetcherQueue *queue = fetch->queue;
+	const gchar *username = purple_avatar_fetch_get_username(fetch);
+
+	fetch->timeout_id = 0;
+
+	purple_debug_warning("avatar-fetcher",
+	                     "Fetching the avatar of %s on %s timed out",
+	                     username != NULL ? username : "(nobody)",
+	                     purple_account_get_username(fetch->account));
+
+	purple_avatar_fetcher_queue_finish(queue, fetch);
+	fetch->queue = NULL;
+
+	purple_avatar_fetcher_queue_pump(queue);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Starts queued fetches until the limit is reached. A fetch function may
+ * finish synchronously, which lands back here; the flag keeps that from
+ * recursing, and the outer loop simply picks up the freed slot. */
+static void
+purple_avatar_fetcher_queue_pump(PurpleAvatarFetcherQueue *queue) {
+	if(queue->pumping) {
+		return;
+	}
+
+	queue->pumping = TRUE;
+
+	while(queue->active < queue->limit) {
+		PurpleAvatarFetch *fetch = NULL;
+
+		fetch = g_queue_pop_head(&queue->high);
+		if(fetch == NULL) {
+			fetch = g_queue_pop_head(&queue->normal);
+		}
+		if(fetch == NULL) {
+			break;
+		}
+
+		fetch->active = TRUE;
+		queue->active++;
+
+		g_queue_push_tail(&queue->running, fetch);
+		fetch->link = queue->running.tail;
+
+		/* This has to be set up first, since the fetch may finish before
+		 * func returns. */
+		fetch->timeout_id = g_timeout_add_seconds(queue->timeout,
+		                                          purple_avatar_fetch_timeout_cb,
+		                                          fetch);
+
+		fetch->func(fetch, fetch->data);
+	}
+
+	queue->pumping = FALSE;
+}
+
+/******************************************************************************
+ * Callbacks
+ *****************************************************************************/
+static void
+purple_avatar_fetcher_signing_off_cb(PurpleConnection *gc, gpointer data) {
+	PurpleAvatarFetcher *fetcher = data;
+
+	purple_avatar_fetcher_cancel(fetcher, purple_connection_get_account(gc));
+}
+
+static void
+purple_avatar_fetcher_conversation_registered_cb(PurpleConversationManager *manager,
+                                                 PurpleConversation *conversation,
+                                                 gpointer data)
+{
+	PurpleAvatarFetcher *fetcher = data;
+
+	if(!PURPLE_IS_IM_CONVERSATION(conversation)) {
+		return;
+	}
+
+	purple_avatar_fetcher_prioritize(fetcher,
+	                                 purple_conversation_get_account(conversation),
+	                                 purple_conversation_get_name(conversation));
+}
+
+/******************************************************************************
+ * GObject Implementation
+ *****************************************************************************/
+static void
+purple_avatar_fetcher_dispose(GObject *obj) {
+	PurpleAvatarFetcher *fetcher = PURPLE_AVATAR_FETCHER(obj);
+
+	purple_signals_disconnect_by_handle(fetcher);
+
+	G_OBJECT_CLASS(purple_avatar_fetcher_parent_class)->dispose(obj);
+}
+
+static void
+purple_avatar_fetcher_finalize(GObject *obj) {
+	PurpleAvatarFetcher *fetcher = PURPLE_AVATAR_FETCHER(obj);
+
+	g_clear_pointer(&fetcher->queues, g_hash_table_destroy);
+
+	G_OBJECT_CLASS(purple_avatar_fetcher_parent_class)->finalize(obj);
+}
+
+static void
+purple_avatar_fetcher_init(PurpleAvatarFetcher *fetcher) {
+	fetcher->queues = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+	                                        NULL,
+	                                        (GDestroyNotify)purple_avatar_fetcher_queue_free);
+}
+
+static void
+purple_avatar_fetcher_class_init(PurpleAvatarFetcherClass *klass) {
+	GObjectClass *obj_class = G_OBJECT_CLASS(klass);
+
+	obj_class->dispose = purple_avatar_fetcher_dispose;
+	obj_class->finalize = purple_avatar_fetcher_finalize;
+}
+
+/******************************************************************************
+ * Private API
+ *****************************************************************************/
+void
+purple_avatar_fetcher_startup(void) {
+	PurpleConversationManager *manager = NULL;
+
+	if(default_fetcher != NULL) {
+		return;
+	}
+
+	default_fetcher = g_object_new(PURPLE_TYPE_AVATAR_FETCHER, NULL);
+
+	purple_signal_connect(purple_connections_get_handle(), "signing-off",
+	                      default_fetcher,
+	                      PURPLE_CALLBACK(purple_avatar_fetcher_signing_off_cb),
+	                      default_fetcher);
+
+	manager = purple_conversation_manager_get_default();
+	if(manager != NULL) {
+		g_signal_connect_object(manager, "registered",
+		                        G_CALLBACK(purple_avatar_fetcher_conversation_registered_cb),
+		                        default_fetcher, 0);
+	}
+}
+
+void
+purple_avatar_fetcher_shutdown(void) {
+	g_clear_object(&default_fetcher);
+}
+
+/******************************************************************************
+ * Public API
+ *****************************************************************************/
+PurpleAvatarFetcher *
+purple_avatar_fetcher_get_default(void) {
+	return default_fetcher;
+}
+
+void
+purple_avatar_fetcher_submit(PurpleAvatarFetcher *fetcher,
+                             PurpleAccount *account, const gchar *username,
+                             const gchar *checksum,
+                             PurpleAvatarFetchFlags flags,
+                             PurpleAvatarFetchFunc func, gpointer data,
+                             GDestroyNotify destroy)
+{
+	PurpleAvatarFetcherQueue *queue = NULL;
+	PurpleAvatarFetch *fetch = NULL;
+	PurpleBuddy *buddy = NULL;
+	gchar *key = NULL;
+
+	g_return_if_fail(PURPLE_IS_AVATAR_FETCHER(fetcher));
+	g_return_if_fail(PURPLE_IS_ACCOUNT(account));
+	g_return_if_fail(username != NULL);
+	g_return_if_fail(func != NULL);
+
+	/* The icon cache already has this avatar. */
+	buddy = purple_blist_find_buddy(account, username);
+	if(checksum != NULL && buddy != NULL &&
+	   purple_strequal(purple_buddy_icons_get_checksum_for_user(buddy),
+	                   checksum))
+	{
+		if(destroy != NULL) {
+			destroy(data);
+		}
+
+		return;
+	}
+
+	queue = purple_avatar_fetcher_get_queue(fetcher, account, TRUE);
+
+	fetch = g_hash_table_lookup(queue->users, username);
+	if(fetch != NULL) {
+		if(purple_strequal(fetch->checksum, checksum)) {
+			/* This avatar is already queued or on its way. */
+			if(flags & PURPLE_AVATAR_FETCH_FLAGS_HIGH_PRIORITY) {
+				purple_avatar_fetcher_queue_promote(queue, fetch);
+			}
+
+			if(destroy != NULL) {
+				destroy(data);
+			}
+
+			return;
+		}
+
+		purple_avatar_fetcher_queue_detach(queue, fetch, username);
+	}
+
+	key = g_strdup(username);
+
+	if(checksum != NULL && (flags & PURPLE_AVATAR_FETCH_FLAGS_CONTENT_CHECKSUM)) {
+		fetch = g_hash_table_lookup(queue->shared, checksum);
+		if(fetch != NULL) {
+			/* Someone else has the same image; wait on their fetch. */
+			g_ptr_array_add(fetch->users, key);
+			g_hash_table_insert(queue->users, key, fetch);
+
+			if(flags & PURPLE_AVATAR_FETCH_FLAGS_HIGH_PRIORITY) {
+				purple_avatar_fetcher_queue_promote(queue, fetch);
+			}
+
+			if(destroy != NULL) {
+				destroy(data);
+			}
+
+			return;
+		}
+	}
+
+	fetch = purple_avatar_fetch_new(queue, checksum, flags, func, data,
+	                                destroy);
+	g_ptr_array_add(fetch->users, key);
+	g_hash_table_insert(queue->users, key, fetch);
+
+	if(fetch->shared) {
+		g_hash_table_insert(queue->shared, fetch->checksum, fetch);
+	}
+
+	if(fetch->high) {
+		g_queue_push_tail(&queue->high, fetch);
+	} else {
+		g_queue_push_tail(&queue->normal, fetch);
+	}
+
+	purple_avatar_fetcher_queue_pump(queue);
+}
+
+void
+purple_avatar_fetcher_prioritize(PurpleAvatarFetcher *fetcher,
+                                 PurpleAccount *account,
+                                 const gchar *username)
+{
+	PurpleAvatarFetcherQueue *queue = NULL;
+	PurpleAvatarFetch *fetch = NULL;
+
+	g_return_if_fail(PURPLE_IS_AVATAR_FETCHER(fetcher));
+	g_return_if_fail(username != NULL);
+
+	queue = purple_avatar_fetcher_get_queue(fetcher, account, FALSE);
+	if(queue == NULL) {
+		return;
+	}
+
+	fetch = g_hash_table_lookup(queue->users, username);
+	if(fetch != NULL) {
+		purple_avatar_fetcher_queue_promote(queue, fetch);
+	}
+}
+
+void
+purple_avatar_fetcher_cancel(PurpleAvatarFetcher *fetcher,
+                             PurpleAccount *account)
+{
+	g_return_if_fail(PURPLE_IS_AVATAR_FETCHER(fetcher));
+
+	g_hash_table_remove(fetcher->queues, account);
+}
+
+void
+purple_avatar_fetcher_set_limit(PurpleAvatarFetcher *fetcher,
+                                PurpleAccount *account, guint limit)
+{
+	PurpleAvatarFetcherQueue *queue = NULL;
+
+	g_return_if_fail(PURPLE_IS_AVATAR_FETCHER(fetcher));
+	g_return_if_fail(PURPLE_IS_ACCOUNT(account));
+	g_return_if_fail(limit > 0);
+
+	queue = purple_avatar_fetcher_get_queue(fetcher, account, TRUE);
+	queue->limit = limit;
+
+	purple_avatar_fetcher_queue_pump(queue);
+}
+
+void
+purple_avatar_fetcher_set_timeout(PurpleAvatarFetcher *fetcher,
+                                  PurpleAccount *account, guint timeout)
+{
+	PurpleAvatarFetcherQueue *queue = NULL;
+
+	g_return_if_fail(PURPLE_IS_AVATAR_FETCHER(fetcher));
+	g_return_if_fail(PURPLE_IS_ACCOUNT(account));
+	g_return_if_fail(timeout > 0);
+
+	queue = purple_avatar_fetcher_get_queue(fetcher, account, TRUE);
+	queue->timeout = timeout;
+}
+
+guint
+purple_avatar_fetcher_get_queued(PurpleAvatarFetcher *fetcher,
+                                 PurpleAccount *account)
+{
+	PurpleAvatarFetcherQueue *queue = NULL;
+
+	g_return_val_if_fail(PURPLE_IS_AVATAR_FETCHER(fetcher), 0);
+
+	queue = purple_avatar_fetcher_get_queue(fetcher, account, FALSE);
+	if(queue == NULL) {
+		return 0;
+	}
+
+	return queue->high.length + queue->normal.length;
+}
+
+guint
+purple_avatar_fetcher_get_active(PurpleAvatarFetcher *fetcher,
+                                 PurpleAccount *account)
+{
+	PurpleAvatarFetcherQueue *queue = NULL;
+
+	g_return_val_if_fail(PURPLE_IS_AVATAR_FETCHER(fetcher), 0);
+
+	queue = purple_avatar_fetcher_get_queue(fetcher, account, FALSE);
+	if(queue == NULL) {
+		return 0;
+	}
+
+	return queue->active;
+}
+
+PurpleAccount *
+purple_avatar_fetch_get_account(PurpleAvatarFetch *fetch) {
+	g_return_val_if_fail(fetch != NULL, NULL);
+
+	return fetch->account;
+}
+
+const gchar *
+purple_avatar_fetch_get_username(PurpleAvatarFetch *fetch) {
+	g_return_val_if_fail(fetch != NULL, NULL);
+
+	if(fetch->users->len == 0) {
+		return NULL;
+	}
+
+	return g_ptr_array_index(fetch->users, 0);
+}
+
+const gchar *
+purple_avatar_fetch_get_checksum(PurpleAvatarFetch *fetch) {
+	g_return_val_if_fail(fetch != NULL, NULL);
+
+	return fetch->checksum;
+}
+
+void
+purple_avatar_fetch_complete(PurpleAvatarFetch *fetch, gpointer icon_data,
+                             gsize icon_len)
+{
+	PurpleAvatarFetcherQueue *queue = NULL;
+	guint i;
+
+	g_return_if_fail(fetch != NULL);
+	g_return_if_fail(fetch->active);
+
+	queue = fetch->queue;
+	if(queue == NULL) {
+		/* The account signed off while this was active. */
+		g_free(icon_data);
+		purple_avatar_fetch_free(fetch);
+
+		return;
+	}
+
+	purple_avatar_fetcher_queue_finish(queue, fetch);
+
+	for(i = 0; i < fetch->users->len; i++) {
+		const gchar *username = g_ptr_array_index(fetch->users, i);
+		gpointer copy = icon_data;
+
+		/* The buddy icon API takes ownership, so everyone but the last
+		 * user gets their own copy. */
+		if(icon_data != NULL && i + 1 < fetch->users->len) {
+			copy = g_memdup2(icon_data, icon_len);
+		}
+
+		purple_buddy_icons_set_for_user(fetch->account, username, copy,
+		                                icon_len, fetch->checksum);
+	}
+
+	if(fetch->users->len == 0) {
+		g_free(icon_data);
+	}
+
+	purple_avatar_fetch_free(fetch);
+
+	purple_avatar_fetcher_queue_pump(queue);
+}
+
+void
+purple_avatar_fetch_failed(PurpleAvatarFetch *fetch) {
+	PurpleAvatarFetcherQueue *queue = NULL;
+
+	g_return_if_fail(fetch != NULL);
+	g_return_if_fail(fetch->active);
+
+	queue = fetch->queue;
+	if(queue != NULL) {
+		purple_avatar_fetcher_queue_finish(queue, fetch);
+	}
+
+	purple_avatar_fetch_free(fetch);
+
+	if(queue != NULL) {
+		purple_avatar_fetcher_queue_pump(queue);
+	}
+}
@@ -0,0 +1,296 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#if !defined(PURPLE_GLOBAL_HEADER_INSIDE) && !defined(PURPLE_COMPILATION)
+# error "only <purple.h> may be included directly"
+#endif
+
+#ifndef PURPLE_AVATAR_FETCHER_H
+#define PURPLE_AVATAR_FETCHER_H
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include <libpurple/account.h>
+
+G_BEGIN_DECLS
+
+/**
+ * PURPLE_AVATAR_FETCHER_DEFAULT_LIMIT:
+ *
+ * The number of avatar fetches that may be active at once for an account,
+ * unless changed with purple_avatar_fetcher_set_limit().
+ *
+ * Since: 3.0.0
+ */
+#define PURPLE_AVATAR_FETCHER_DEFAULT_LIMIT (4)
+
+/**
+ * PURPLE_AVATAR_FETCHER_DEFAULT_TIMEOUT:
+ *
+ * The number of seconds an avatar fetch may be active before it is given
+ * up on, unless changed with purple_avatar_fetcher_set_timeout().
+ *
+ * Since: 3.0.0
+ */
+#define PURPLE_AVATAR_FETCHER_DEFAULT_TIMEOUT (60)
+
+#define PURPLE_TYPE_AVATAR_FETCHER (purple_avatar_fetcher_get_type())
+
+/**
+ * PurpleAvatarFetcher:
+ *
+ * #PurpleAvatarFetcher is a background queue of buddy icon downloads that
+ * protocols submit to instead of starting them directly. It limits how many
+ * fetches run at once for each account, lets fetches for contacts that the
+ * user is looking at jump ahead of the rest, and drops fetches whose result
+ * is already in the buddy icon cache or already on its way.
+ *
+ * Since: 3.0.0
+ */
+G_DECLARE_FINAL_TYPE(PurpleAvatarFetcher, purple_avatar_fetcher, PURPLE,
+                     AVATAR_FETCHER, GObject)
+
+/**
+ * PurpleAvatarFetch:
+ *
+ * An opaque handle for a single queued or active avatar fetch. It stays
+ * valid until it is passed to purple_avatar_fetch_complete() or
+ * purple_avatar_fetch_failed().
+ *
+ * Since: 3.0.0
+ */
+typedef struct _PurpleAvatarFetch PurpleAvatarFetch;
+
+/**
+ * PurpleAvatarFetchFlags:
+ * @PURPLE_AVATAR_FETCH_FLAGS_NONE: No flags.
+ * @PURPLE_AVATAR_FETCH_FLAGS_HIGH_PRIORITY: Run the fetch ahead of the ones
+ *                                           without this flag.
+ * @PURPLE_AVATAR_FETCH_FLAGS_CONTENT_CHECKSUM: The checksum identifies the
+ *                                              image itself, so users with
+ *                                              the same checksum can share a
+ *                                              single fetch.
+ *
+ * Flags for purple_avatar_fetcher_submit().
+ *
+ * Since: 3.0.0
+ */
+typedef enum {
+	PURPLE_AVATAR_FETCH_FLAGS_NONE = 0,
+	PURPLE_AVATAR_FETCH_FLAGS_HIGH_PRIORITY = 1 << 0,
+	PURPLE_AVATAR_FETCH_FLAGS_CONTENT_CHECKSUM = 1 << 1,
+} PurpleAvatarFetchFlags;
+
+/**
+ * PurpleAvatarFetchFunc:
+ * @fetch: The #PurpleAvatarFetch to start.
+ * @data: User supplied data.
+ *
+ * Starts downloading an avatar. The download must eventually call
+ * purple_avatar_fetch_complete() or purple_avatar_fetch_failed() with
+ * @fetch, even if the connection went away in the meantime. If that takes
+ * longer than the timeout set with purple_avatar_fetcher_set_timeout(), the
+ * next queued fetch is started in its place and its result is discarded,
+ * but it still has to be finished.
+ *
+ * Since: 3.0.0
+ */
+typedef void (*PurpleAvatarFetchFunc)(PurpleAvatarFetch *fetch, gpointer data);
+
+/**
+ * purple_avatar_fetcher_get_default:
+ *
+ * Gets the default #PurpleAvatarFetcher instance.
+ *
+ * Returns: (transfer none): The default #PurpleAvatarFetcher instance.
+ *
+ * Since: 3.0.0
+ */
+PurpleAvatarFetcher *purple_avatar_fetcher_get_default(void);
+
+/**
+ * purple_avatar_fetcher_submit:
+ * @fetcher: The #PurpleAvatarFetcher instance.
+ * @account: The #PurpleAccount that @username is on.
+ * @username: The username whose avatar should be fetched.
+ * @checksum: (nullable): The protocol checksum of the new avatar.
+ * @flags: The #PurpleAvatarFetchFlags.
+ * @func: (scope notified): The #PurpleAvatarFetchFunc that downloads it.
+ * @data: User data to pass to @func.
+ * @destroy: (nullable): A #GDestroyNotify for @data.
+ *
+ * Queues a fetch of the avatar of @username. When it is started, @func is
+ * called and the result is stored with purple_buddy_icons_set_for_user()
+ * under @checksum.
+ *
+ * Nothing is queued if the buddy icon cache already has @checksum for
+ * @username, or if the same avatar is already queued or being fetched. A
+ * queued fetch for an older checksum of @username is replaced. In every
+ * case where @func will not be called, @data is destroyed right away.
+ *
+ * Since: 3.0.0
+ */
+void purple_avatar_fetcher_submit(PurpleAvatarFetcher *fetcher, PurpleAccount *account, const gchar *username, const gchar *checksum, PurpleAvatarFetchFlags flags, PurpleAvatarFetchFunc func, gpointer data, GDestroyNotify destroy);
+
+/**
+ * purple_avatar_fetcher_prioritize:
+ * @fetcher: The #PurpleAvatarFetcher instance.
+ * @account: The #PurpleAccount that @username is on.
+ * @username: The username.
+ *
+ * Moves a queued fetch for @username ahead of the fetches that were not
+ * prioritized. User interfaces should call this when a contact becomes
+ * visible. Conversations that are opened are prioritized automatically.
+ *
+ * Since: 3.0.0
+ */
+void purple_avatar_fetcher_prioritize(PurpleAvatarFetcher *fetcher, PurpleAccount *account, const gchar *username);
+
+/**
+ * purple_avatar_fetcher_cancel:
+ * @fetcher: The #PurpleAvatarFetcher instance.
+ * @account: The #PurpleAccount.
+ *
+ * Drops every queued fetch for @account. Active fetches still have to be
+ * completed by their protocol, but their results are discarded. This is
+ * done automatically when an account signs off.
+ *
+ * Since: 3.0.0
+ */
+void purple_avatar_fetcher_cancel(PurpleAvatarFetcher *fetcher, PurpleAccount *account);
+
+/**
+ * purple_avatar_fetcher_set_limit:
+ * @fetcher: The #PurpleAvatarFetcher instance.
+ * @account: The #PurpleAccount.
+ * @limit: The number of fetches that may be active at once.
+ *
+ * Sets how many fetches may be active at once for @account. The default is
+ * %PURPLE_AVATAR_FETCHER_DEFAULT_LIMIT.
+ *
+ * Since: 3.0.0
+ */
+void purple_avatar_fetcher_set_limit(PurpleAvatarFetcher *fetcher, PurpleAccount *account, guint limit);
+
+/**
+ * purple_avatar_fetcher_set_timeout:
+ * @fetcher: The #PurpleAvatarFetcher instance.
+ * @account: The #PurpleAccount.
+ * @timeout: The number of seconds a fetch may be active.
+ *
+ * Sets how long a fetch for @account may be active before it is given up
+ * on. The default is %PURPLE_AVATAR_FETCHER_DEFAULT_TIMEOUT. Only fetches
+ * that are started afterwards are affected.
+ *
+ * Since: 3.0.0
+ */
+void purple_avatar_fetcher_set_timeout(PurpleAvatarFetcher *fetcher, PurpleAccount *account, guint timeout);
+
+/**
+ * purple_avatar_fetcher_get_queued:
+ * @fetcher: The #PurpleAvatarFetcher instance.
+ * @account: The #PurpleAccount.
+ *
+ * Gets the number of fetches for @account that are waiting to be started.
+ *
+ * Returns: The number of queued fetches.
+ *
+ * Since: 3.0.0
+ */
+guint purple_avatar_fetcher_get_queued(PurpleAvatarFetcher *fetcher, PurpleAccount *account);
+
+/**
+ * purple_avatar_fetcher_get_active:
+ * @fetcher: The #PurpleAvatarFetcher instance.
+ * @account: The #PurpleAccount.
+ *
+ * Gets the number of fetches for @account that have been started but not
+ * yet completed.
+ *
+ * Returns: The number of active fetches.
+ *
+ * Since: 3.0.0
+ */
+guint purple_avatar_fetcher_get_active(PurpleAvatarFetcher *fetcher, PurpleAccount *account);
+
+/**
+ * purple_avatar_fetch_get_account:
+ * @fetch: The #PurpleAvatarFetch.
+ *
+ * Gets the account that @fetch was submitted for.
+ *
+ * Returns: (transfer none): The #PurpleAccount.
+ *
+ * Since: 3.0.0
+ */
+PurpleAccount *purple_avatar_fetch_get_account(PurpleAvatarFetch *fetch);
+
+/**
+ * purple_avatar_fetch_get_username:
+ * @fetch: The #PurpleAvatarFetch.
+ *
+ * Gets the username that @fetch was submitted for. When several users
+ * share the fetch, this is the first of them.
+ *
+ * Returns: The username.
+ *
+ * Since: 3.0.0
+ */
+const gchar *purple_avatar_fetch_get_username(PurpleAvatarFetch *fetch);
+
+/**
+ * purple_avatar_fetch_get_checksum:
+ * @fetch: The #PurpleAvatarFetch.
+ *
+ * Gets the checksum that the result of @fetch will be stored under.
+ *
+ * Returns: (nullable): The checksum.
+ *
+ * Since: 3.0.0
+ */
+const gchar *purple_avatar_fetch_get_checksum(PurpleAvatarFetch *fetch);
+
+/**
+ * purple_avatar_fetch_complete:
+ * @fetch: (transfer full): The #PurpleAvatarFetch.
+ * @icon_data: (transfer full) (nullable): The avatar image data.
+ * @icon_len: The length of @icon_data.
+ *
+ * Finishes @fetch, setting @icon_data as the buddy icon of every user that
+ * is waiting for it, and starts the next queued fetch. A %NULL @icon_data
+ * removes the buddy icon. @fetch is freed.
+ *
+ * Since: 3.0.0
+ */
+void purple_avatar_fetch_complete(PurpleAvatarFetch *fetch, gpointer icon_data, gsize icon_len);
+
+/**
+ * purple_avatar_fetch_failed:
+ * @fetch: (transfer full): The #PurpleAvatarFetch.
+ *
+ * Finishes @fetch without changing any buddy icons and starts the next
+ * queued fetch. @fetch is freed.
+ *
+ * Since: 3.0.0
+ */
+void purple_avatar_fetch_failed(PurpleAvatarFetch *fetch);
+
+G_END_DECLS
+
+#endif /* PURPLE_AVATAR_FETCHER_H */
@@ -367,3 +367,52 @@ purple_contact_manager_find_with_id(PurpleContactManager *manager,
 
 	return NULL;
 }
+
+void
+purple_contact_manager_add_buddy(PurpleContactManager *manager,
+                                 PurpleBuddy *buddy)
+{
+	PurpleContact *contact = NULL;
+
+	g_return_if_fail(PURPLE_IS_CONTACT_MANAGER(manager));
+	g_return_if_fail(PURPLE_IS_BUDDY(buddy));
+
+	contact = purple_contact_new(purple_buddy_get_account(buddy),
+	                             purple_buddy_get_id(buddy));
+
+	/* The buddy list is still where these are set, so just follow it. */
+	g_object_bind_property(buddy, "name", contact, "username",
+	                       G_BINDING_SYNC_CREATE);
+	g_object_bind_property(buddy, "server-alias", contact, "display-name",
+	                       G_BINDING_SYNC_CREATE);
+	g_object_bind_property(buddy, "local-alias", contact, "alias",
+	                       G_BINDING_SYNC_CREATE);
+	g_object_bind_property(buddy, "presence", contact, "presence",
+	                       G_BINDING_SYNC_CREATE);
+
+	purple_contact_manager_add(manager, contact);
+
+	g_object_unref(contact);
+}
+
+gboolean
+purple_contact_manager_remove_buddy(PurpleContactManager *manager,
+                                    PurpleBuddy *buddy)
+{
+	PurpleContact *contact = NULL;
+	gboolean removed = FALSE;
+
+	g_return_val_if_fail(PURPLE_IS_CONTACT_MANAGER(manager), FALSE);
+	g_return_val_if_fail(PURPLE_IS_BUDDY(buddy), FALSE);
+
+	contact = purple_contact_manager_find_with_id(manager,
+	                                              purple_buddy_get_account(buddy),
+	                                              purple_buddy_get_id(buddy));
+	if(contact != NULL) {
+		removed = purple_contact_manager_remove(manager, contact);
+
+		g_object_unref(contact);
+	}
+
+	return removed;
+}
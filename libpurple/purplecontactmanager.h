@@ -27,6 +27,7 @@
 #include <glib-object.h>
 
 #include <libpurple/account.h>
+#include <libpurple/buddy.h>
 #include <libpurple/purplecontact.h>
 
 G_BEGIN_DECLS
@@ -141,6 +142,32 @@ PurpleContact *purple_contact_manager_find_with_username(PurpleContactManager *m
  */
 PurpleContact *purple_contact_manager_find_with_id(PurpleContactManager *manager, PurpleAccount *account, const gchar *id);
 
+/**
+ * purple_contact_manager_add_buddy:
+ * @manager: The instance.
+ * @buddy: The [class@Purple.Buddy] to add.
+ *
+ * Adds a [class@Purple.Contact] for @buddy to @manager. The contact has the
+ * same account and id as @buddy and follows its name, aliases, and presence.
+ *
+ * Since: 3.0.0
+ */
+void purple_contact_manager_add_buddy(PurpleContactManager *manager, PurpleBuddy *buddy);
+
+/**
+ * purple_contact_manager_remove_buddy:
+ * @manager: The instance.
+ * @buddy: The [class@Purple.Buddy] whose contact to remove.
+ *
+ * Removes the [class@Purple.Contact] that was added for @buddy with
+ * [method@Purple.ContactManager.add_buddy].
+ *
+ * Returns: %TRUE if the contact was found and removed, otherwise %FALSE.
+ *
+ * Since: 3.0.0
+ */
+gboolean purple_contact_manager_remove_buddy(PurpleContactManager *manager, PurpleBuddy *buddy);
+
 G_END_DECLS
 
 #endif /* PURPLE_CONTACT_MANAGER_H */
@@ -361,6 +361,25 @@ purple_history_manager_remove(PurpleHistoryManager *manager,
 	                                     error);
 }
 
+gchar *
+purple_history_query_quote(const gchar *value)
+{
+	GString *quoted = NULL;
+
+	g_return_val_if_fail(value != NULL, NULL);
+
+	quoted = g_string_new("\"");
+	for(; *value != '\0'; value++) {
+		if(*value == '"' || *value == '\\') {
+			g_string_append_c(quoted, '\\');
+		}
+		g_string_append_c(quoted, *value);
+	}
+	g_string_append_c(quoted, '"');
+
+	return g_string_free(quoted, FALSE);
+}
+
 gboolean
 purple_history_manager_write(PurpleHistoryManager *manager,
                              PurpleConversation *conversation,
@@ -190,6 +190,21 @@ GList *purple_history_manager_query(PurpleHistoryManager *manager, const gchar *
  */
 gboolean purple_history_manager_remove(PurpleHistoryManager *manager, const gchar *query, GError **error);
 
+/**
+ * purple_history_query_quote:
+ * @value: The value to quote.
+ *
+ * Quotes @value so it can be used as a single term, or as the value of a
+ * term like `in:`, in a query for purple_history_manager_query() or
+ * purple_history_manager_remove(), even if it contains spaces or quotes.
+ * A term that starts with a quote is always matched as a keyword.
+ *
+ * Returns: (transfer full): The quoted @value.
+ *
+ * Since: 3.0.0
+ */
+gchar *purple_history_query_quote(const gchar *value);
+
 /**
  * purple_history_manager_write:
  * @manager: The #PurpleHistoryManager instance.
@@ -22,8 +22,91 @@
 
 #include "purplemarkup.h"
 
+#if defined(__AVX2__)
+# include <immintrin.h>
+# define PURPLE_MARKUP_SCAN_WIDTH 32
+#elif defined(__SSE2__)
+# include <emmintrin.h>
+# define PURPLE_MARKUP_SCAN_WIDTH 16
+#endif
+
+/* The vectorized scanner reads whole aligned blocks, which can include bytes
+ * past the end of the string's allocation, so keep AddressSanitizer from
+ * complaining about it. */
+#if defined(PURPLE_MARKUP_SCAN_WIDTH) && defined(__GNUC__)
+# define PURPLE_MARKUP_SCAN_ATTRIBUTES __attribute__((no_sanitize_address))
+#else
+# define PURPLE_MARKUP_SCAN_ATTRIBUTES
+#endif
+
 #include "util.h"
 
+/*
+ * Returns a pointer to the first byte of str that is one of the (at most
+ * eight) bytes in accept, or to the terminating nul if there is none.
+ *
+ * This is what lets the markup functions below skip over plain text instead
+ * of looking at it one character at a time.  The vectorized versions only do
+ * aligned loads, so they never read across a page boundary past the end of
+ * the string.
+ */
+static const gchar * PURPLE_MARKUP_SCAN_ATTRIBUTES
+purple_markup_scan(const gchar *str, const gchar *accept)
+{
+#ifdef PURPLE_MARKUP_SCAN_WIDTH
+	guint misalign = GPOINTER_TO_UINT(str) & (PURPLE_MARKUP_SCAN_WIDTH - 1);
+	const gchar *p = str - misalign;
+	guint n_needles = 0, i;
+	guint32 mask;
+#endif
+
+#if defined(__AVX2__)
+	__m256i needles[8];
+	const __m256i zero = _mm256_setzero_si256();
+
+	for(; accept[n_needles] != '\0' && n_needles < 8; n_needles++) {
+		needles[n_needles] = _mm256_set1_epi8(accept[n_needles]);
+	}
+
+	for(;; p += PURPLE_MARKUP_SCAN_WIDTH, misalign = 0) {
+		__m256i chunk = _mm256_load_si256((const __m256i *)p);
+		__m256i hits = _mm256_cmpeq_epi8(chunk, zero);
+
+		for(i = 0; i < n_needles; i++) {
+			hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, needles[i]));
+		}
+
+		mask = ((guint32)_mm256_movemask_epi8(hits)) >> misalign;
+		if(mask != 0) {
+			return p + misalign + g_bit_nth_lsf(mask, -1);
+		}
+	}
+#elif defined(__SSE2__)
+	__m128i needles[8];
+	const __m128i zero = _mm_setzero_si128();
+
+	for(; accept[n_needles] != '\0' && n_needles < 8; n_needles++) {
+		needles[n_needles] = _mm_set1_epi8(accept[n_needles]);
+	}
+
+	for(;; p += PURPLE_MARKUP_SCAN_WIDTH, misalign = 0) {
+		__m128i chunk = _mm_load_si128((const __m128i *)p);
+		__m128i hits = _mm_cmpeq_epi8(chunk, zero);
+
+		for(i = 0; i < n_needles; i++) {
+			hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, needles[i]));
+		}
+
+		mask = ((guint32)_mm_movemask_epi8(hits)) >> misalign;
+		if(mask != 0) {
+			return p + misalign + g_bit_nth_lsf(mask, -1);
+		}
+	}
+#else
+	return str + strcspn(str, accept);
+#endif
+}
+
 /*
  * This function is stolen from glib's gmarkup.c and modified to not
  * replace ' with &apos;
@@ -878,6 +961,32 @@ purple_markup_strip_html(const char *str)
 
 	for (i = 0, j = 0; str2[i]; i++)
 	{
+		/* Skip or copy runs of text that can't change any state: anything
+		 * but a tag inside of CDATA, or visible text without tags, entities
+		 * or whitespace that needs to be normalized. */
+		if (cdata_close_tag || visible)
+		{
+			const gchar *run = str2 + i;
+			const gchar *run_end = NULL;
+
+			if (cdata_close_tag)
+				run_end = purple_markup_scan(run, "<");
+			else
+				run_end = purple_markup_scan(run, "<&\t\n\v\f\r");
+
+			if (run_end > run)
+			{
+				if (!cdata_close_tag)
+				{
+					memmove(str2 + j, run, run_end - run);
+					j += run_end - run;
+				}
+				i += run_end - run;
+				if (str2[i] == '\0')
+					break;
+			}
+		}
+
 		if (str2[i] == '<')
 		{
 			if (cdata_close_tag)
@@ -1039,6 +1148,9 @@ purple_markup_strip_html(const char *str)
 	return str2;
 }
 
+/* The furthest a link's ':' or '.' can be from its start, in "mailto:". */
+#define PURPLE_MARKUP_LINK_TRIGGER 6
+
 static gboolean
 badchar(char c)
 {
@@ -1120,10 +1232,30 @@ purple_markup_linkify(const char *text)
 	if (text == NULL)
 		return NULL;
 
-	ret = g_string_new("");
+	ret = g_string_sized_new(strlen(text));
 
 	c = text;
 	while (*c) {
+		/* Copy plain text in runs.  Every link we detect has a ':' or '.'
+		 * at most PURPLE_MARKUP_LINK_TRIGGER bytes after its start, so
+		 * anything further than that ahead of the next special character
+		 * can't start a link and is copied as is.  Inside of a tag only
+		 * quotes and the closing '>' matter. */
+		if(inside_html) {
+			t = purple_markup_scan(c, "\"'>");
+		} else {
+			t = purple_markup_scan(c, "()<@:.");
+			if(t - c > PURPLE_MARKUP_LINK_TRIGGER)
+				t -= PURPLE_MARKUP_LINK_TRIGGER;
+			else
+				t = c;
+		}
+		if(t > c) {
+			g_string_append_len(ret, c, t - c);
+			c = t;
+			if(*c == '\0')
+				break;
+		}
 
 		if(*c == '(' && !inside_html) {
 			inside_paren++;
@@ -1148,8 +1280,9 @@ purple_markup_linkify(const char *text)
 						inside_html = FALSE;
 						break;
 					}
-					ret = g_string_append_c(ret, *c);
-					c++;
+					t = purple_markup_scan(c + 1, "/");
+					g_string_append_len(ret, c, t - c);
+					c = t;
 					if (!(*c))
 						break;
 				}
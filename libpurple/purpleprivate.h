@@ -338,6 +338,25 @@ void purple_history_manager_startup(void);
  */
 void purple_history_manager_shutdown(void);
 
+/**
+ * purple_avatar_fetcher_startup:
+ *
+ * Starts up the avatar fetcher by creating the default instance.
+ *
+ * Since: 3.0.0
+ */
+void purple_avatar_fetcher_startup(void);
+
+/**
+ * purple_avatar_fetcher_shutdown:
+ *
+ * Shuts down the avatar fetcher by destroying the default instance. Queued
+ * fetches are dropped.
+ *
+ * Since: 3.0.0
+ */
+void purple_avatar_fetcher_shutdown(void);
+
 /**
  * purple_notification_manager_startup:
  *
@@ -69,8 +69,10 @@ struct _PurpleProtocolRoomlistInterface {
 
 	gchar *(*room_serialize)(PurpleProtocolRoomlist *protocol_roomlist, PurpleRoomlistRoom *room);
 
+	PurpleRoomlist *(*get_list_filtered)(PurpleProtocolRoomlist *protocol_roomlist, PurpleConnection *gc, const gchar *filter, guint min_users);
+
 	/*< private >*/
-	gpointer reserved[4];
+	gpointer reserved[3];
 };
 
 /**
@@ -86,6 +88,23 @@ struct _PurpleProtocolRoomlistInterface {
  */
 PurpleRoomlist *purple_protocol_roomlist_get_list(PurpleProtocolRoomlist *protocol_roomlist, PurpleConnection *gc);
 
+/**
+ * purple_protocol_roomlist_get_list_filtered:
+ * @protocol_roomlist: The #PurpleProtocolRoomlist instance.
+ * @gc: The #PurpleAccount to get the roomlist for.
+ * @filter: (nullable): A glob-style pattern for room names or %NULL.
+ * @min_users: The minimum number of users in a room or 0.
+ *
+ * Gets the list of rooms for @gc, asking the server to only send rooms that
+ * match @filter and have at least @min_users users.  Servers are free to
+ * ignore either filter.
+ *
+ * Returns: (transfer full): The roomlist for @gc.
+ *
+ * Since: 3.0.0
+ */
+PurpleRoomlist *purple_protocol_roomlist_get_list_filtered(PurpleProtocolRoomlist *protocol_roomlist, PurpleConnection *gc, const gchar *filter, guint min_users);
+
 /**
  * purple_protocol_roomlist_cancel:
  * @protocol_roomlist: The #PurpleProtocolRoomlist instance.
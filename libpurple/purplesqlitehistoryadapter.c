@@ -129,17 +129,107 @@ purple_sqlite_history_adapter_get_content_type_enum(const gchar *content_type)
 	return PURPLE_MESSAGE_CONTENT_TYPE_PLAIN;
 }
 
+/* Returns the next term of a query and moves query past it, or NULL at the
+ * end. Terms are separated by spaces, except inside double quotes, and a
+ * backslash takes the next character as is. literal is set for a term that
+ * starts with a quote, which is always a keyword.
+ */
+static gchar *
+purple_sqlite_history_adapter_next_term(const gchar **query,
+                                        gboolean *literal)
+{
+	const gchar *p = *query;
+	GString *term = NULL;
+	gboolean quoted = FALSE;
+
+	while(*p == ' ') {
+		p++;
+	}
+
+	if(*p == '\0') {
+		*query = p;
+
+		return NULL;
+	}
+
+	*literal = (*p == '"');
+	term = g_string_new(NULL);
+
+	for(; *p != '\0'; p++) {
+		if(*p == '\\' && p[1] != '\0') {
+			p++;
+			g_string_append_c(term, *p);
+		} else if(*p == '"') {
+			quoted = !quoted;
+		} else if(*p == ' ' && !quoted) {
+			break;
+		} else {
+			g_string_append_c(term, *p);
+		}
+	}
+
+	*query = p;
+
+	return g_string_free(term, FALSE);
+}
+
+static void
+purple_sqlite_history_adapter_append_in(GString *query, const gchar *column,
+                                        GList *values)
+{
+	gboolean first = TRUE;
+
+	if(values == NULL) {
+		return;
+	}
+
+	g_string_append_printf(query, "AND (%s IN (", column);
+	for(GList *iter = values; iter != NULL; iter = iter->next) {
+		if(!first) {
+			g_string_append(query, ", ");
+		}
+		first = FALSE;
+		g_string_append(query, "?");
+	}
+	g_string_append(query, "))");
+}
+
+static void
+purple_sqlite_history_adapter_bind_all(sqlite3_stmt *statement, gint *index,
+                                       GList *values)
+{
+	while(values != NULL) {
+		sqlite3_bind_text(statement, (*index)++, (const char *)values->data,
+		                  -1, g_free);
+		values = g_list_delete_link(values, values);
+	}
+}
+
+/* Queries are space separated terms, see next_term() for quoting. "in:" and
+ * "from:" match conversations and authors, "account:" and "protocol:" the
+ * account username and protocol name they were logged with, and anything
+ * else is a keyword in the content. "before:" takes an
+ * ISO 8601 timestamp and only matches older messages; with "before-id:" too,
+ * messages at exactly that time match if their id sorts first, which makes
+ * the pair a cursor that never skips a message. "limit:" returns only the
+ * newest that many matches, still oldest first.
+ */
 static sqlite3_stmt *
 purple_sqlite_history_adapter_build_query(PurpleSqliteHistoryAdapter *adapter,
                                           const gchar * search_query,
                                           gboolean remove,
                                           GError **error)
 {
-	gchar **split = NULL;
-	gint i = 0;
+	gchar *term = NULL;
+	gboolean literal = FALSE;
 	GList *ins = NULL;
 	GList *froms = NULL;
+	GList *accounts = NULL;
+	GList *protocols = NULL;
 	GList *keywords = NULL;
+	gchar *before = NULL;
+	gchar *before_id = NULL;
+	gint64 limit = 0;
 	GString *query = NULL;
 	GList *iter = NULL;
 	gboolean first = FALSE;
@@ -147,31 +237,56 @@ purple_sqlite_history_adapter_build_query(PurpleSqliteHistoryAdapter *adapter,
 	gint index = 1;
 	gint query_items = 0;
 
-	split = g_strsplit(search_query, " ", -1);
-	for(i = 0; split[i] != NULL; i++) {
-		if(g_str_has_prefix(split[i], "in:")) {
-			if(split[i][3] == '\0') {
-				continue;
+	while((term = purple_sqlite_history_adapter_next_term(&search_query,
+	                                                      &literal)) != NULL)
+	{
+		if(literal) {
+			if(term[0] != '\0') {
+				keywords = g_list_prepend(keywords,
+				                          g_strdup_printf("%%%s%%", term));
+				query_items++;
 			}
-			ins = g_list_prepend(ins, g_strdup(split[i]+3));
-			query_items++;
-		} else if(g_str_has_prefix(split[i], "from:")) {
-			if(split[i][5] == '\0') {
-				continue;
+		} else if(g_str_has_prefix(term, "in:")) {
+			if(term[3] != '\0') {
+				ins = g_list_prepend(ins, g_strdup(term+3));
+				query_items++;
 			}
-			froms = g_list_prepend(froms, g_strdup(split[i]+5));
-			query_items++;
-		} else {
-			if(split[i][0] == '\0') {
-				continue;
+		} else if(g_str_has_prefix(term, "from:")) {
+			if(term[5] != '\0') {
+				froms = g_list_prepend(froms, g_strdup(term+5));
+				query_items++;
+			}
+		} else if(g_str_has_prefix(term, "account:")) {
+			if(term[8] != '\0') {
+				accounts = g_list_prepend(accounts, g_strdup(term+8));
+				query_items++;
 			}
+		} else if(g_str_has_prefix(term, "protocol:")) {
+			if(term[9] != '\0') {
+				protocols = g_list_prepend(protocols, g_strdup(term+9));
+				query_items++;
+			}
+		} else if(g_str_has_prefix(term, "before:")) {
+			if(term[7] != '\0') {
+				g_free(before);
+				before = g_strdup(term+7);
+				query_items++;
+			}
+		} else if(g_str_has_prefix(term, "before-id:")) {
+			if(term[10] != '\0') {
+				g_free(before_id);
+				before_id = g_strdup(term+10);
+			}
+		} else if(g_str_has_prefix(term, "limit:")) {
+			limit = g_ascii_strtoll(term+6, NULL, 10);
+		} else {
 			keywords = g_list_prepend(keywords,
-			                          g_strdup_printf("%%%s%%", split[i]));
+			                          g_strdup_printf("%%%s%%", term));
 			query_items++;
 		}
-	}
 
-	g_clear_pointer(&split, g_strfreev);
+		g_free(term);
+	}
 
 	if(remove) {
 		if(query_items != 0) {
@@ -181,6 +296,9 @@ purple_sqlite_history_adapter_build_query(PurpleSqliteHistoryAdapter *adapter,
 			            "Attempting to remove messages without "
 			            "query parameters.");
 
+			g_free(before);
+			g_free(before_id);
+
 			return NULL;
 		}
 	} else {
@@ -191,31 +309,10 @@ purple_sqlite_history_adapter_build_query(PurpleSqliteHistoryAdapter *adapter,
 		                     "FROM message_log WHERE TRUE\n");
 	}
 
-	if(ins != NULL) {
-		first = TRUE;
-		g_string_append(query, "AND (conversation_id IN (");
-		for(iter = ins; iter != NULL; iter = iter->next) {
-			if(!first) {
-				g_string_append(query, ", ");
-			}
-			first = FALSE;
-			g_string_append(query, "?");
-		}
-		g_string_append(query, "))");
-	}
-
-	if(froms != NULL) {
-		first = TRUE;
-		g_string_append(query, "AND (author IN (");
-		for(iter = froms; iter != NULL; iter = iter->next) {
-			if(!first) {
-				g_string_append(query, ", ");
-			}
-			first = FALSE;
-			g_string_append(query, "?");
-		}
-		g_string_append(query, "))");
-	}
+	purple_sqlite_history_adapter_append_in(query, "conversation_id", ins);
+	purple_sqlite_history_adapter_append_in(query, "author", froms);
+	purple_sqlite_history_adapter_append_in(query, "account", accounts);
+	purple_sqlite_history_adapter_append_in(query, "protocol", protocols);
 
 	if(keywords != NULL) {
 		first = TRUE;
@@ -229,6 +326,29 @@ purple_sqlite_history_adapter_build_query(PurpleSqliteHistoryAdapter *adapter,
 		}
 		g_string_append(query, ")");
 	}
+
+	/* The timestamps carry their own offsets, so they can't be compared as
+	 * strings. */
+	if(before != NULL) {
+		if(before_id != NULL) {
+			g_string_append(query,
+			                "AND (julianday(client_timestamp) < julianday(?) "
+			                "OR (julianday(client_timestamp) = julianday(?) "
+			                "AND message_id < ?))");
+		} else {
+			g_string_append(query,
+			                "AND (julianday(client_timestamp) < julianday(?))");
+		}
+	}
+
+	/* Pick the newest matches, then put them back in order. */
+	if(!remove && limit > 0) {
+		g_string_prepend(query, "SELECT * FROM (");
+		g_string_append(query,
+		                "ORDER BY julianday(client_timestamp) DESC, "
+		                "message_id DESC LIMIT ?) "
+		                "ORDER BY julianday(client_timestamp), message_id");
+	}
 	g_string_append(query, ";");
 
 	sqlite3_prepare_v2(adapter->db, query->str, -1, &prepared_statement, NULL);
@@ -242,28 +362,43 @@ purple_sqlite_history_adapter_build_query(PurpleSqliteHistoryAdapter *adapter,
 
 		g_list_free_full(ins, g_free);
 		g_list_free_full(froms, g_free);
+		g_list_free_full(accounts, g_free);
+		g_list_free_full(protocols, g_free);
 		g_list_free_full(keywords, g_free);
+		g_free(before);
+		g_free(before_id);
 
 		return NULL;
 	}
 
-	while(ins != NULL) {
-		sqlite3_bind_text(prepared_statement, index++,
-		                  (const char *)ins->data, -1, g_free);
-		ins = g_list_delete_link(ins, ins);
+	/* Same order as the clauses above. */
+	purple_sqlite_history_adapter_bind_all(prepared_statement, &index, ins);
+	purple_sqlite_history_adapter_bind_all(prepared_statement, &index, froms);
+	purple_sqlite_history_adapter_bind_all(prepared_statement, &index,
+	                                       accounts);
+	purple_sqlite_history_adapter_bind_all(prepared_statement, &index,
+	                                       protocols);
+	purple_sqlite_history_adapter_bind_all(prepared_statement, &index,
+	                                       keywords);
+
+	if(before != NULL) {
+		sqlite3_bind_text(prepared_statement, index++, before, -1,
+		                  SQLITE_TRANSIENT);
+
+		if(before_id != NULL) {
+			sqlite3_bind_text(prepared_statement, index++, before, -1,
+			                  SQLITE_TRANSIENT);
+			sqlite3_bind_text(prepared_statement, index++, before_id, -1,
+			                  SQLITE_TRANSIENT);
+		}
 	}
 
-	while(froms != NULL) {
-		sqlite3_bind_text(prepared_statement, index++,
-		                  (const char *)froms->data, -1, g_free);
-		froms = g_list_delete_link(froms, froms);
+	if(!remove && limit > 0) {
+		sqlite3_bind_int64(prepared_statement, index++, limit);
 	}
 
-	while(keywords != NULL) {
-		sqlite3_bind_text(prepared_statement, index++,
-		                  (const char *)keywords->data, -1, g_free);
-		keywords = g_list_delete_link(keywords, keywords);
-	}
+	g_free(before);
+	g_free(before_id);
 
 	return prepared_statement;
 }
@@ -23,13 +23,26 @@
 
 #include "queuedoutputstream.h"
 
+/* The default number of bytes we'll hand to the base stream in one writev. */
+#define PURPLE_QUEUED_OUTPUT_STREAM_DEFAULT_BATCH_SIZE (64 * 1024)
+
 struct _PurpleQueuedOutputStream
 {
 	GFilterOutputStream parent;
 
-	GAsyncQueue *queue;
+	/* Tasks waiting to be written, each holding its GBytes as task data. */
+	GQueue *queue;
 	gboolean pending_queued;
-} PurpleQueuedOutputStreamPrivate;
+
+	/* The tasks being written right now and the vectors pointing into their
+	 * bytes.  The vectors have to stay valid until the write finishes.
+	 */
+	GPtrArray *in_flight;
+	GArray *vectors;
+
+	guint cork_count;
+	gsize max_batch_size;
+};
 
 G_DEFINE_TYPE(PurpleQueuedOutputStream, purple_queued_output_stream,
               G_TYPE_FILTER_OUTPUT_STREAM)
@@ -38,75 +51,133 @@ G_DEFINE_TYPE(PurpleQueuedOutputStream, purple_queued_output_stream,
  * Helpers
  *****************************************************************************/
 
-static void purple_queued_output_stream_start_push_bytes_async(GTask *task);
+static void purple_queued_output_stream_flush_queue(
+		PurpleQueuedOutputStream *stream);
 
 static void
-purple_queued_output_stream_push_bytes_async_cb(GObject *source,
-		GAsyncResult *res, gpointer user_data)
+purple_queued_output_stream_writev_cb(GObject *source, GAsyncResult *res,
+		gpointer user_data)
 {
-	GTask *task = G_TASK(user_data);
-	PurpleQueuedOutputStream *stream = g_task_get_source_object(task);
-	gssize written;
-	GBytes *bytes;
-	gsize size;
+	PurpleQueuedOutputStream *stream = PURPLE_QUEUED_OUTPUT_STREAM(user_data);
+	GPtrArray *batch;
+	gsize written = 0;
+	guint i;
 	GError *error = NULL;
 
-	written = g_output_stream_write_bytes_finish(G_OUTPUT_STREAM(source),
-			res, &error);
+	g_output_stream_writev_all_finish(G_OUTPUT_STREAM(source), res,
+			&written, &error);
 
-	bytes = g_task_get_task_data(task);
-	size = g_bytes_get_size(bytes);
+	/* Swap the batch out before returning anything, as the callbacks may
+	 * push more data or clear the queue.
+	 */
+	batch = stream->in_flight;
+	stream->in_flight = g_ptr_array_new_with_free_func(g_object_unref);
+	g_array_set_size(stream->vectors, 0);
 
-	if (written < 0) {
-		/* Error occurred, return error */
-		g_task_return_error(task, error);
-		g_clear_object(&task);
-	} else if (size > written) {
-		/* Partial write, prepare to send remaining data */
-		bytes = g_bytes_new_from_bytes(bytes, written, size - written);
-		g_task_set_task_data(task, bytes,
-				(GDestroyNotify)g_bytes_unref);
-	} else {
-		/* Full write, this task is finished */
-		g_task_return_boolean(task, TRUE);
-		g_clear_object(&task);
+	/* The callbacks may drop the last reference to the stream other than
+	 * the ones held by the tasks.
+	 */
+	g_object_ref(stream);
+
+	for (i = 0; i < batch->len; i++) {
+		GTask *task = g_ptr_array_index(batch, i);
+		gsize size = g_bytes_get_size(g_task_get_task_data(task));
+
+		if (written >= size) {
+			written -= size;
+			g_task_return_boolean(task, TRUE);
+		} else {
+			/* Everything from the first short write on failed with the
+			 * error, whether it was partially written or not at all.
+			 */
+			written = 0;
+			g_task_return_error(task, g_error_copy(error));
+		}
 	}
 
-	/* If g_task_return_* was called in this function, the callback
-	 * may have cleared the stream. If so, there will be no remaining
-	 * tasks to process here.
+	g_ptr_array_unref(batch);
+	g_clear_error(&error);
+
+	/* If we were corked while this batch was out, the rest has to wait for
+	 * the uncork, which will restart the flush.
 	 */
+	if (stream->cork_count == 0) {
+		purple_queued_output_stream_flush_queue(stream);
+	}
+
+	g_object_unref(stream);
+}
 
-	if (task == NULL) {
-		/* Any queued data left? */
-		task = g_async_queue_try_pop(stream->queue);
+/* Starts writing as much of the queue as fits in the batch budget, or clears
+ * the pending flag if there is nothing left to write.
+ */
+static void
+purple_queued_output_stream_flush_queue(PurpleQueuedOutputStream *stream)
+{
+	GOutputStream *base_stream;
+	GCancellable *cancellable = NULL;
+	GTask *task;
+	gsize batch_size = 0;
+	gint priority = G_PRIORITY_DEFAULT;
+
+	if (stream->in_flight->len > 0) {
+		return;
+	}
+
+	while ((task = g_queue_peek_head(stream->queue)) != NULL) {
+		GBytes *bytes = g_task_get_task_data(task);
+		GOutputVector vector;
+
+		/* Don't write anything that nobody wants anymore. */
+		if (g_task_return_error_if_cancelled(task)) {
+			g_queue_pop_head(stream->queue);
+			g_object_unref(task);
+			continue;
+		}
+
+		/* Always write at least one buffer, no matter how big it is. */
+		if (stream->in_flight->len > 0 &&
+		    batch_size + g_bytes_get_size(bytes) > stream->max_batch_size) {
+			break;
+		}
+
+		g_queue_pop_head(stream->queue);
+
+		vector.buffer = g_bytes_get_data(bytes, &vector.size);
+		g_array_append_val(stream->vectors, vector);
+		batch_size += vector.size;
+
+		if (stream->in_flight->len == 0) {
+			cancellable = g_task_get_cancellable(task);
+			priority = g_task_get_priority(task);
+		} else {
+			priority = MIN(priority, g_task_get_priority(task));
+		}
+
+		g_ptr_array_add(stream->in_flight, task);
 	}
 
-	if (task != NULL) {
-		/* More to process */
-		purple_queued_output_stream_start_push_bytes_async(task);
-	} else {
+	if (stream->in_flight->len == 0) {
 		/* All done */
 		stream->pending_queued = FALSE;
 		g_output_stream_clear_pending(G_OUTPUT_STREAM(stream));
+		return;
 	}
-}
 
-static void
-purple_queued_output_stream_start_push_bytes_async(GTask *task)
-{
-	PurpleQueuedOutputStream *stream = g_task_get_source_object(task);
-	GOutputStream *base_stream;
+	/* A batch only has one cancellable, so only honour it if it's the only
+	 * request in the batch.  The others were checked above.
+	 */
+	if (stream->in_flight->len > 1) {
+		cancellable = NULL;
+	}
 
 	base_stream = g_filter_output_stream_get_base_stream(
 			G_FILTER_OUTPUT_STREAM(stream));
 
-	g_output_stream_write_bytes_async(base_stream,
-			g_task_get_task_data(task),
-			g_task_get_priority(task),
-			g_task_get_cancellable(task),
-			purple_queued_output_stream_push_bytes_async_cb,
-			task);
+	g_output_stream_writev_all_async(base_stream,
+			(GOutputVector *)stream->vectors->data,
+			stream->vectors->len, priority, cancellable,
+			purple_queued_output_stream_writev_cb, stream);
 }
 
 /******************************************************************************
@@ -114,13 +185,15 @@ purple_queued_output_stream_start_push_bytes_async(GTask *task)
  *****************************************************************************/
 
 static void
-purple_queued_output_stream_dispose(GObject *object)
+purple_queued_output_stream_finalize(GObject *object)
 {
 	PurpleQueuedOutputStream *stream = PURPLE_QUEUED_OUTPUT_STREAM(object);
 
-	g_clear_pointer(&stream->queue, g_async_queue_unref);
+	g_queue_free_full(stream->queue, g_object_unref);
+	g_ptr_array_unref(stream->in_flight);
+	g_array_unref(stream->vectors);
 
-	G_OBJECT_CLASS(purple_queued_output_stream_parent_class)->dispose(object);
+	G_OBJECT_CLASS(purple_queued_output_stream_parent_class)->finalize(object);
 }
 
 static void
@@ -128,14 +201,18 @@ purple_queued_output_stream_class_init(PurpleQueuedOutputStreamClass *klass)
 {
 	GObjectClass *obj_class = G_OBJECT_CLASS(klass);
 
-	obj_class->dispose = purple_queued_output_stream_dispose;
+	obj_class->finalize = purple_queued_output_stream_finalize;
 }
 
 static void
 purple_queued_output_stream_init(PurpleQueuedOutputStream *stream)
 {
-	stream->queue = g_async_queue_new_full((GDestroyNotify)g_bytes_unref);
+	stream->queue = g_queue_new();
 	stream->pending_queued = FALSE;
+	stream->in_flight = g_ptr_array_new_with_free_func(g_object_unref);
+	stream->vectors = g_array_new(FALSE, FALSE, sizeof(GOutputVector));
+	stream->cork_count = 0;
+	stream->max_batch_size = PURPLE_QUEUED_OUTPUT_STREAM_DEFAULT_BATCH_SIZE;
 }
 
 /******************************************************************************
@@ -192,12 +269,13 @@ purple_queued_output_stream_push_bytes_async(PurpleQueuedOutputStream *stream,
 	g_clear_error(&error);
 	stream->pending_queued = TRUE;
 
-	if (set_pending) {
-		/* Start processing if there were no pending operations */
-		purple_queued_output_stream_start_push_bytes_async(task);
-	} else {
-		/* Otherwise queue the data */
-		g_async_queue_push(stream->queue, task);
+	g_queue_push_tail(stream->queue, task);
+
+	/* If a write is already in progress, this will go out with the next
+	 * batch once it finishes.
+	 */
+	if (stream->cork_count == 0) {
+		purple_queued_output_stream_flush_queue(stream);
 	}
 }
 
@@ -220,9 +298,60 @@ purple_queued_output_stream_clear_queue(PurpleQueuedOutputStream *stream)
 
 	g_return_if_fail(PURPLE_IS_QUEUED_OUTPUT_STREAM(stream));
 
-	while ((task = g_async_queue_try_pop(stream->queue)) != NULL) {
+	while ((task = g_queue_pop_head(stream->queue)) != NULL) {
 		g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_CANCELLED,
 				"PurpleQueuedOutputStream queue cleared");
 		g_object_unref(task);
 	}
+
+	/* Nothing is left to write, so if we were waiting on an uncork we're
+	 * not anymore.
+	 */
+	if (stream->pending_queued && stream->in_flight->len == 0) {
+		stream->pending_queued = FALSE;
+		g_output_stream_clear_pending(G_OUTPUT_STREAM(stream));
+	}
+}
+
+void
+purple_queued_output_stream_cork(PurpleQueuedOutputStream *stream)
+{
+	g_return_if_fail(PURPLE_IS_QUEUED_OUTPUT_STREAM(stream));
+
+	stream->cork_count++;
+}
+
+void
+purple_queued_output_stream_uncork(PurpleQueuedOutputStream *stream)
+{
+	g_return_if_fail(PURPLE_IS_QUEUED_OUTPUT_STREAM(stream));
+	g_return_if_fail(stream->cork_count > 0);
+
+	stream->cork_count--;
+
+	if (stream->cork_count == 0 && stream->pending_queued) {
+		purple_queued_output_stream_flush_queue(stream);
+	}
+}
+
+void
+purple_queued_output_stream_set_max_batch_size(
+		PurpleQueuedOutputStream *stream, gsize size)
+{
+	g_return_if_fail(PURPLE_IS_QUEUED_OUTPUT_STREAM(stream));
+
+	if (size == 0) {
+		size = PURPLE_QUEUED_OUTPUT_STREAM_DEFAULT_BATCH_SIZE;
+	}
+
+	stream->max_batch_size = size;
+}
+
+gsize
+purple_queued_output_stream_get_max_batch_size(
+		PurpleQueuedOutputStream *stream)
+{
+	g_return_val_if_fail(PURPLE_IS_QUEUED_OUTPUT_STREAM(stream), 0);
+
+	return stream->max_batch_size;
 }
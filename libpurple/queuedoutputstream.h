@@ -46,6 +46,12 @@ G_BEGIN_DECLS
  *
  * To queue data, use [method@QueuedOutputStream.push_bytes_async].
  *
+ * Data that is queued while a write is in progress is coalesced and handed
+ * to the base stream with a single vectored write, up to
+ * [method@QueuedOutputStream.set_max_batch_size] bytes at a time. To make
+ * sure a burst of small writes goes out together, wrap it in
+ * [method@QueuedOutputStream.cork] and [method@QueuedOutputStream.uncork].
+ *
  * If there's a fatal stream error, it's suggested to clear the remaining bytes
  * queued with [method@QueuedOutputStream.clear_queue] to avoid excessive
  * errors returned in [method@QueuedOutputStream.push_bytes_async]'s async
@@ -80,7 +86,8 @@ PurpleQueuedOutputStream *purple_queued_output_stream_new(
  * Be careful such that if there's a fatal stream error, all remaining queued
  * operations will likely return this error. Use
  * #purple_queued_output_stream_clear_queue() to clear the queue on such
- * an error to only report it a single time.
+ * an error to only report it a single time. When a coalesced write fails,
+ * each request in it that was not completely written gets the error.
  */
 void purple_queued_output_stream_push_bytes_async(
 		PurpleQueuedOutputStream *stream, GBytes *bytes,
@@ -115,6 +122,59 @@ gboolean purple_queued_output_stream_push_bytes_finish(
  */
 void purple_queued_output_stream_clear_queue(PurpleQueuedOutputStream *stream);
 
+/*
+ * purple_queued_output_stream_cork
+ * @stream: #PurpleQueuedOutputStream to cork
+ *
+ * Holds back any data pushed to @stream until
+ * #purple_queued_output_stream_uncork() is called, so that it can be written
+ * in as few writes as possible. Calls may be nested, in which case the data
+ * is written when the last cork is removed.
+ *
+ * A write that is already in progress is not affected.
+ *
+ * Since: 3.0.0
+ */
+void purple_queued_output_stream_cork(PurpleQueuedOutputStream *stream);
+
+/*
+ * purple_queued_output_stream_uncork
+ * @stream: #PurpleQueuedOutputStream to uncork
+ *
+ * Removes a cork added with #purple_queued_output_stream_cork(), and starts
+ * writing anything that was queued in the meantime if it was the last one.
+ *
+ * Since: 3.0.0
+ */
+void purple_queued_output_stream_uncork(PurpleQueuedOutputStream *stream);
+
+/*
+ * purple_queued_output_stream_set_max_batch_size
+ * @stream: #PurpleQueuedOutputStream to configure
+ * @size: The maximum number of bytes to write at once, or 0 for the default
+ *
+ * Sets how many bytes of queued data may be combined into a single write to
+ * the base stream. A single pushed buffer larger than @size is still written
+ * in one go. The default is 64 KiB.
+ *
+ * Since: 3.0.0
+ */
+void purple_queued_output_stream_set_max_batch_size(
+		PurpleQueuedOutputStream *stream, gsize size);
+
+/*
+ * purple_queued_output_stream_get_max_batch_size
+ * @stream: #PurpleQueuedOutputStream to query
+ *
+ * Gets the maximum number of bytes that will be combined into a single write.
+ *
+ * Returns: The maximum size of a single write in bytes.
+ *
+ * Since: 3.0.0
+ */
+gsize purple_queued_output_stream_get_max_batch_size(
+		PurpleQueuedOutputStream *stream);
+
 G_END_DECLS
 
 #endif /* PURPLE_QUEUED_OUTPUT_STREAM_H */
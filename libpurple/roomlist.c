@@ -24,17 +24,27 @@
 #include "debug.h"
 #include "roomlist.h"
 #include "server.h"
+#include "util.h"
 
 /* This must be after roomlist.h otherwise you'll get an include cycle. */
 #include "purpleprotocolroomlist.h"
 
+/* How long rooms are collected before the UI is told about them. */
+#define PURPLE_ROOMLIST_BATCH_INTERVAL 100
+
 /*
  * Private data for a room list.
  */
 typedef struct {
 	PurpleAccount *account;  /* The account this list belongs to. */
-	GList *rooms;            /* The list of rooms.                */
+	GPtrArray *rooms;        /* The list of rooms.                */
+	guint n_announced;       /* Rooms that items-changed covered. */
+	guint flush_id;          /* Source for the next batch.        */
 	gboolean in_progress;    /* The listing is in progress.       */
+
+	gchar *filter;           /* Name pattern rooms must match.    */
+	GPatternSpec *pattern;   /* Casefolded, compiled filter.      */
+	guint min_users;         /* Minimum user count of rooms.      */
 } PurpleRoomlistPrivate;
 
 /* Room list property enums */
@@ -43,13 +53,125 @@ enum
 	PROP_0,
 	PROP_ACCOUNT,
 	PROP_IN_PROGRESS,
+	PROP_FILTER,
+	PROP_MIN_USERS,
 	PROP_LAST
 };
 
 static GParamSpec *properties[PROP_LAST];
 static PurpleRoomlistUiOps *ops = NULL;
 
-G_DEFINE_TYPE_WITH_PRIVATE(PurpleRoomlist, purple_roomlist, G_TYPE_OBJECT);
+/**************************************************************************/
+/* Helpers                                                                */
+/**************************************************************************/
+
+static void
+purple_roomlist_flush(PurpleRoomlist *list) {
+	PurpleRoomlistPrivate *priv = purple_roomlist_get_instance_private(list);
+	guint position = priv->n_announced;
+	guint added = priv->rooms->len - priv->n_announced;
+
+	g_clear_handle_id(&priv->flush_id, g_source_remove);
+
+	if(added == 0) {
+		return;
+	}
+
+	priv->n_announced = priv->rooms->len;
+
+	if(ops && ops->add_room) {
+		guint i;
+
+		for(i = position; i < priv->rooms->len; i++) {
+			ops->add_room(list, g_ptr_array_index(priv->rooms, i));
+		}
+	}
+
+	g_list_model_items_changed(G_LIST_MODEL(list), position, 0, added);
+}
+
+static gboolean
+purple_roomlist_flush_cb(gpointer data) {
+	PurpleRoomlist *list = data;
+	PurpleRoomlistPrivate *priv = purple_roomlist_get_instance_private(list);
+
+	priv->flush_id = 0;
+	purple_roomlist_flush(list);
+
+	return G_SOURCE_REMOVE;
+}
+
+static gboolean
+purple_roomlist_room_matches(PurpleRoomlistPrivate *priv,
+                             PurpleRoomlistRoom *room)
+{
+	if(priv->min_users > 0 &&
+	   purple_roomlist_room_get_user_count(room) < priv->min_users)
+	{
+		return FALSE;
+	}
+
+	if(priv->pattern != NULL) {
+		const gchar *name = purple_roomlist_room_get_name(room);
+		gchar *folded = NULL;
+		gboolean matched = FALSE;
+
+		if(name == NULL) {
+			return FALSE;
+		}
+
+		folded = g_utf8_casefold(name, -1);
+		matched = g_pattern_spec_match_string(priv->pattern, folded);
+		g_free(folded);
+
+		return matched;
+	}
+
+	return TRUE;
+}
+
+/**************************************************************************/
+/* GListModel Implementation                                              */
+/**************************************************************************/
+
+static GType
+purple_roomlist_get_item_type(G_GNUC_UNUSED GListModel *model) {
+	return PURPLE_TYPE_ROOMLIST_ROOM;
+}
+
+static guint
+purple_roomlist_get_n_items(GListModel *model) {
+	PurpleRoomlistPrivate *priv = NULL;
+
+	priv = purple_roomlist_get_instance_private(PURPLE_ROOMLIST(model));
+
+	return priv->n_announced;
+}
+
+static gpointer
+purple_roomlist_get_item(GListModel *model, guint position) {
+	PurpleRoomlistPrivate *priv = NULL;
+
+	priv = purple_roomlist_get_instance_private(PURPLE_ROOMLIST(model));
+
+	if(position >= priv->n_announced) {
+		return NULL;
+	}
+
+	return g_object_ref(g_ptr_array_index(priv->rooms, position));
+}
+
+static void
+purple_roomlist_list_model_iface_init(GListModelInterface *iface) {
+	iface->get_item_type = purple_roomlist_get_item_type;
+	iface->get_n_items = purple_roomlist_get_n_items;
+	iface->get_item = purple_roomlist_get_item;
+}
+
+G_DEFINE_TYPE_WITH_CODE(PurpleRoomlist, purple_roomlist, G_TYPE_OBJECT,
+                        G_ADD_PRIVATE(PurpleRoomlist)
+                        G_IMPLEMENT_INTERFACE(G_TYPE_LIST_MODEL,
+                                              purple_roomlist_list_model_iface_init))
 
 /**************************************************************************/
 /* Room List API                                                          */
@@ -80,6 +202,11 @@ void purple_roomlist_set_in_progress(PurpleRoomlist *list, gboolean in_progress)
 	priv = purple_roomlist_get_instance_private(list);
 	priv->in_progress = in_progress;
 
+	/* Make sure the UI has every room before it's told we're done. */
+	if(!in_progress) {
+		purple_roomlist_flush(list);
+	}
+
 	g_object_notify_by_pspec(G_OBJECT(list), properties[PROP_IN_PROGRESS]);
 }
 
@@ -93,6 +220,69 @@ gboolean purple_roomlist_get_in_progress(PurpleRoomlist *list)
 	return priv->in_progress;
 }
 
+void
+purple_roomlist_set_filter(PurpleRoomlist *list, const gchar *filter) {
+	PurpleRoomlistPrivate *priv = NULL;
+
+	g_return_if_fail(PURPLE_IS_ROOMLIST(list));
+
+	priv = purple_roomlist_get_instance_private(list);
+
+	if(purple_strequal(priv->filter, filter)) {
+		return;
+	}
+
+	g_free(priv->filter);
+	priv->filter = g_strdup(filter);
+
+	g_clear_pointer(&priv->pattern, g_pattern_spec_free);
+	if(priv->filter != NULL && *priv->filter != '\0') {
+		gchar *folded = g_utf8_casefold(priv->filter, -1);
+
+		priv->pattern = g_pattern_spec_new(folded);
+		g_free(folded);
+	}
+
+	g_object_notify_by_pspec(G_OBJECT(list), properties[PROP_FILTER]);
+}
+
+const gchar *
+purple_roomlist_get_filter(PurpleRoomlist *list) {
+	PurpleRoomlistPrivate *priv = NULL;
+
+	g_return_val_if_fail(PURPLE_IS_ROOMLIST(list), NULL);
+
+	priv = purple_roomlist_get_instance_private(list);
+
+	return priv->filter;
+}
+
+void
+purple_roomlist_set_min_users(PurpleRoomlist *list, guint min_users) {
+	PurpleRoomlistPrivate *priv = NULL;
+
+	g_return_if_fail(PURPLE_IS_ROOMLIST(list));
+
+	priv = purple_roomlist_get_instance_private(list);
+
+	if(priv->min_users != min_users) {
+		priv->min_users = min_users;
+
+		g_object_notify_by_pspec(G_OBJECT(list), properties[PROP_MIN_USERS]);
+	}
+}
+
+guint
+purple_roomlist_get_min_users(PurpleRoomlist *list) {
+	PurpleRoomlistPrivate *priv = NULL;
+
+	g_return_val_if_fail(PURPLE_IS_ROOMLIST(list), 0);
+
+	priv = purple_roomlist_get_instance_private(list);
+
+	return priv->min_users;
+}
+
 void purple_roomlist_room_add(PurpleRoomlist *list, PurpleRoomlistRoom *room)
 {
 	PurpleRoomlistPrivate *priv = NULL;
@@ -101,10 +291,19 @@ void purple_roomlist_room_add(PurpleRoomlist *list, PurpleRoomlistRoom *room)
 	g_return_if_fail(room != NULL);
 
 	priv = purple_roomlist_get_instance_private(list);
-	priv->rooms = g_list_append(priv->rooms, room);
 
-	if (ops && ops->add_room)
-		ops->add_room(list, room);
+	/* Protocols that can't filter on the server still send us everything,
+	 * so drop whatever doesn't match here. */
+	if(!purple_roomlist_room_matches(priv, room)) {
+		return;
+	}
+
+	g_ptr_array_add(priv->rooms, g_object_ref(room));
+
+	if(priv->flush_id == 0) {
+		priv->flush_id = g_timeout_add(PURPLE_ROOMLIST_BATCH_INTERVAL,
+		                               purple_roomlist_flush_cb, list);
+	}
 }
 
 PurpleRoomlist *purple_roomlist_get_list(PurpleConnection *gc)
@@ -124,6 +323,42 @@ PurpleRoomlist *purple_roomlist_get_list(PurpleConnection *gc)
 	return NULL;
 }
 
+PurpleRoomlist *
+purple_roomlist_get_list_filtered(PurpleConnection *gc, const gchar *filter,
+                                  guint min_users)
+{
+	PurpleProtocol *protocol = NULL;
+	PurpleProtocolRoomlist *protocol_roomlist = NULL;
+	PurpleRoomlist *list = NULL;
+
+	g_return_val_if_fail(PURPLE_IS_CONNECTION(gc), NULL);
+	g_return_val_if_fail(PURPLE_CONNECTION_IS_CONNECTED(gc), NULL);
+
+	protocol = purple_connection_get_protocol(gc);
+	if(!PURPLE_IS_PROTOCOL_ROOMLIST(protocol)) {
+		return NULL;
+	}
+
+	protocol_roomlist = PURPLE_PROTOCOL_ROOMLIST(protocol);
+
+	if(PURPLE_PROTOCOL_IMPLEMENTS(protocol, ROOMLIST, get_list_filtered)) {
+		list = purple_protocol_roomlist_get_list_filtered(protocol_roomlist,
+		                                                  gc, filter,
+		                                                  min_users);
+	} else {
+		list = purple_protocol_roomlist_get_list(protocol_roomlist, gc);
+	}
+
+	/* Servers don't all support every filter the protocol asked for, so we
+	 * always filter locally as well. */
+	if(PURPLE_IS_ROOMLIST(list)) {
+		purple_roomlist_set_filter(list, filter);
+		purple_roomlist_set_min_users(list, min_users);
+	}
+
+	return list;
+}
+
 void purple_roomlist_cancel_get_list(PurpleRoomlist *list)
 {
 	PurpleRoomlistPrivate *priv = NULL;
@@ -201,6 +436,12 @@ purple_roomlist_set_property(GObject *obj, guint param_id, const GValue *value,
 		case PROP_IN_PROGRESS:
 			purple_roomlist_set_in_progress(list, g_value_get_boolean(value));
 			break;
+		case PROP_FILTER:
+			purple_roomlist_set_filter(list, g_value_get_string(value));
+			break;
+		case PROP_MIN_USERS:
+			purple_roomlist_set_min_users(list, g_value_get_uint(value));
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
 			break;
@@ -221,6 +462,12 @@ purple_roomlist_get_property(GObject *obj, guint param_id, GValue *value,
 		case PROP_IN_PROGRESS:
 			g_value_set_boolean(value, purple_roomlist_get_in_progress(list));
 			break;
+		case PROP_FILTER:
+			g_value_set_string(value, purple_roomlist_get_filter(list));
+			break;
+		case PROP_MIN_USERS:
+			g_value_set_uint(value, purple_roomlist_get_min_users(list));
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
 			break;
@@ -230,6 +477,9 @@ purple_roomlist_get_property(GObject *obj, guint param_id, GValue *value,
 static void
 purple_roomlist_init(PurpleRoomlist *list)
 {
+	PurpleRoomlistPrivate *priv = purple_roomlist_get_instance_private(list);
+
+	priv->rooms = g_ptr_array_new_full(0, (GDestroyNotify)g_object_unref);
 }
 
 /* Called when done constructing */
@@ -254,7 +504,10 @@ purple_roomlist_finalize(GObject *object)
 
 	purple_debug_misc("roomlist", "destroying list %p\n", list);
 
-	g_list_free_full(priv->rooms, g_object_unref);
+	g_clear_handle_id(&priv->flush_id, g_source_remove);
+	g_ptr_array_free(priv->rooms, TRUE);
+	g_clear_pointer(&priv->pattern, g_pattern_spec_free);
+	g_free(priv->filter);
 
 	G_OBJECT_CLASS(purple_roomlist_parent_class)->finalize(object);
 }
@@ -283,6 +536,32 @@ purple_roomlist_class_init(PurpleRoomlistClass *klass)
 				"Whether the room list is being fetched.", FALSE,
 				G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+	/**
+	 * PurpleRoomlist:filter:
+	 *
+	 * A glob-style pattern, matched case insensitively, that room names must
+	 * match to be added to the list.
+	 *
+	 * Since: 3.0.0
+	 */
+	properties[PROP_FILTER] = g_param_spec_string("filter", "filter",
+				"The pattern that room names must match.", NULL,
+				G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY |
+				G_PARAM_STATIC_STRINGS);
+
+	/**
+	 * PurpleRoomlist:min-users:
+	 *
+	 * The minimum number of users a room must have to be added to the list.
+	 *
+	 * Since: 3.0.0
+	 */
+	properties[PROP_MIN_USERS] = g_param_spec_uint("min-users", "min-users",
+				"The minimum number of users in a room.",
+				0, G_MAXUINT, 0,
+				G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY |
+				G_PARAM_STATIC_STRINGS);
+
 	g_object_class_install_properties(obj_class, PROP_LAST, properties);
 }
 
@@ -66,7 +66,9 @@ typedef enum
  * @show_with_account: Force the ui to pop up a dialog and get the list.
  * @create:            A new list was created.
  * @set_fields:        Sets the columns.
- * @add_room:          Add a room to the list.
+ * @add_room:          Add a room to the list.  Rooms are handed to the UI in
+ *                     batches, right before #GListModel::items-changed is
+ *                     emitted for them, so UIs can use either.
  *
  * The room list ops to be filled out by the UI.
  */
@@ -87,6 +89,11 @@ struct _PurpleRoomlistUiOps {
  * PurpleRoomlist:
  *
  * Represents a list of rooms for a given connection on a given protocol.
+ *
+ * This implements #GListModel with an item type of #PurpleRoomlistRoom.  Rooms
+ * are collected as the protocol adds them and #GListModel::items-changed is
+ * emitted for them in batches, so that large lists don't cause a separate
+ * update for every room.
  */
 struct _PurpleRoomlist {
 	GObject gparent;
@@ -177,13 +184,69 @@ void purple_roomlist_set_in_progress(PurpleRoomlist *list, gboolean in_progress)
  */
 gboolean purple_roomlist_get_in_progress(PurpleRoomlist *list);
 
+/**
+ * purple_roomlist_set_filter:
+ * @list: The room list.
+ * @filter: (nullable): A glob-style pattern for room names or %NULL.
+ *
+ * Sets the pattern that room names have to match to be added to @list.  The
+ * pattern is matched case insensitively and supports `*` and `?` wildcards.
+ *
+ * Protocols that can filter on the server should still set this so that
+ * results from servers which ignore the request are filtered locally.
+ *
+ * Since: 3.0.0
+ */
+void purple_roomlist_set_filter(PurpleRoomlist *list, const gchar *filter);
+
+/**
+ * purple_roomlist_get_filter:
+ * @list: The room list.
+ *
+ * Gets the pattern that room names have to match to be added to @list.
+ *
+ * Returns: (nullable): The filter pattern.
+ *
+ * Since: 3.0.0
+ */
+const gchar *purple_roomlist_get_filter(PurpleRoomlist *list);
+
+/**
+ * purple_roomlist_set_min_users:
+ * @list: The room list.
+ * @min_users: The minimum number of users or 0 for no limit.
+ *
+ * Sets the minimum user count rooms need to be added to @list.  Rooms whose
+ * protocol doesn't report a user count are treated as having no users.
+ *
+ * Since: 3.0.0
+ */
+void purple_roomlist_set_min_users(PurpleRoomlist *list, guint min_users);
+
+/**
+ * purple_roomlist_get_min_users:
+ * @list: The room list.
+ *
+ * Gets the minimum user count rooms need to be added to @list.
+ *
+ * Returns: The minimum number of users.
+ *
+ * Since: 3.0.0
+ */
+guint purple_roomlist_get_min_users(PurpleRoomlist *list);
+
 /**
  * purple_roomlist_room_add:
  * @list: The room list.
- * @room: The room to add to the list. The GList of fields must be in the same
-               order as was given in purple_roomlist_set_fields().
+ * @room: (transfer none): The room to add to the list. The GList of fields
+ *        must be in the same order as was given in
+ *        purple_roomlist_set_fields().
+ *
+ * Adds a room to the list of them.  Rooms that don't match the filters of
+ * @list are ignored.
  *
- * Adds a room to the list of them.
+ * The room is appended in constant time, but #GListModel::items-changed is
+ * only emitted once per batch or when the listing is no longer in progress.
 */
 void purple_roomlist_room_add(PurpleRoomlist *list, PurpleRoomlistRoom *room);
 
@@ -199,6 +262,24 @@ void purple_roomlist_room_add(PurpleRoomlist *list, PurpleRoomlistRoom *room);
  */
 PurpleRoomlist *purple_roomlist_get_list(PurpleConnection *gc);
 
+/**
+ * purple_roomlist_get_list_filtered:
+ * @gc: The PurpleConnection to have get a list.
+ * @filter: (nullable): A glob-style pattern for room names or %NULL.
+ * @min_users: The minimum number of users in a room or 0.
+ *
+ * Like purple_roomlist_get_list(), but only lists rooms matching @filter
+ * with at least @min_users users.  If the protocol supports it, the filters
+ * are sent to the server so that fewer rooms are transferred; otherwise the
+ * list is filtered as the rooms arrive.
+ *
+ * Returns: (transfer full): A PurpleRoomlist* or %NULL if the protocol doesn't
+ *          support that.
+ *
+ * Since: 3.0.0
+ */
+PurpleRoomlist *purple_roomlist_get_list_filtered(PurpleConnection *gc, const gchar *filter, guint min_users);
+
 /**
  * purple_roomlist_cancel_get_list:
  * @list: The room list to cancel a get_list on.
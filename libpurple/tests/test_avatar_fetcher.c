@@ -0,0 +1,312 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <purple.h>
+
+#include "test_ui.h"
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+typedef struct {
+	GPtrArray *started;
+	guint destroyed;
+} TestAvatarFetcherData;
+
+static void
+test_purple_avatar_fetcher_fetch_cb(PurpleAvatarFetch *fetch, gpointer data) {
+	TestAvatarFetcherData *tdata = data;
+
+	g_ptr_array_add(tdata->started, fetch);
+}
+
+static void
+test_purple_avatar_fetcher_destroy_cb(gpointer data) {
+	TestAvatarFetcherData *tdata = data;
+
+	tdata->destroyed++;
+}
+
+static void
+test_purple_avatar_fetcher_submit(PurpleAvatarFetcher *fetcher,
+                                  PurpleAccount *account,
+                                  const gchar *username, const gchar *checksum,
+                                  PurpleAvatarFetchFlags flags,
+                                  TestAvatarFetcherData *data)
+{
+	purple_avatar_fetcher_submit(fetcher, account, username, checksum, flags,
+	                             test_purple_avatar_fetcher_fetch_cb, data,
+	                             test_purple_avatar_fetcher_destroy_cb);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_purple_avatar_fetcher_get_default(void) {
+	PurpleAvatarFetcher *fetcher1 = NULL, *fetcher2 = NULL;
+
+	fetcher1 = purple_avatar_fetcher_get_default();
+	g_assert_true(PURPLE_IS_AVATAR_FETCHER(fetcher1));
+
+	fetcher2 = purple_avatar_fetcher_get_default();
+	g_assert_true(PURPLE_IS_AVATAR_FETCHER(fetcher2));
+
+	g_assert_true(fetcher1 == fetcher2);
+}
+
+static void
+test_purple_avatar_fetcher_limit(void) {
+	PurpleAvatarFetcher *fetcher = purple_avatar_fetcher_get_default();
+	PurpleAccount *account = NULL;
+	TestAvatarFetcherData data = {NULL, 0};
+	gchar *username = NULL;
+	gint i;
+
+	data.started = g_ptr_array_new();
+	account = purple_account_new("test", "test");
+	purple_avatar_fetcher_set_limit(fetcher, account, 2);
+
+	for(i = 0; i < 5; i++) {
+		username = g_strdup_printf("user%d", i);
+		test_purple_avatar_fetcher_submit(fetcher, account, username, "1",
+		                                  PURPLE_AVATAR_FETCH_FLAGS_NONE,
+		                                  &data);
+		g_free(username);
+	}
+
+	g_assert_cmpuint(data.started->len, ==, 2);
+	g_assert_cmpuint(purple_avatar_fetcher_get_active(fetcher, account), ==, 2);
+	g_assert_cmpuint(purple_avatar_fetcher_get_queued(fetcher, account), ==, 3);
+
+	/* Finishing one starts the next one in line. */
+	purple_avatar_fetch_failed(g_ptr_array_index(data.started, 0));
+	g_assert_cmpuint(data.started->len, ==, 3);
+	g_assert_cmpstr(purple_avatar_fetch_get_username(g_ptr_array_index(data.started, 2)),
+	                ==, "user2");
+
+	/* Cancelling drops the queued fetches, but the active ones still have
+	 * to be finished. */
+	purple_avatar_fetcher_cancel(fetcher, account);
+	g_assert_cmpuint(data.destroyed, ==, 3);
+	g_assert_cmpuint(purple_avatar_fetcher_get_queued(fetcher, account), ==, 0);
+
+	purple_avatar_fetch_complete(g_ptr_array_index(data.started, 1), NULL, 0);
+	purple_avatar_fetch_failed(g_ptr_array_index(data.started, 2));
+	g_assert_cmpuint(data.started->len, ==, 3);
+	g_assert_cmpuint(data.destroyed, ==, 5);
+
+	g_ptr_array_free(data.started, TRUE);
+	g_clear_object(&account);
+}
+
+static void
+test_purple_avatar_fetcher_dedupe(void) {
+	PurpleAvatarFetcher *fetcher = purple_avatar_fetcher_get_default();
+	PurpleAccount *account = NULL;
+	TestAvatarFetcherData data = {NULL, 0};
+
+	data.started = g_ptr_array_new();
+	account = purple_account_new("test", "test");
+	purple_avatar_fetcher_set_limit(fetcher, account, 1);
+
+	/* The same avatar for the same user is only fetched once. */
+	test_purple_avatar_fetcher_submit(fetcher, account, "alice", "a",
+	                                  PURPLE_AVATAR_FETCH_FLAGS_NONE, &data);
+	test_purple_avatar_fetcher_submit(fetcher, account, "alice", "a",
+	                                  PURPLE_AVATAR_FETCH_FLAGS_NONE, &data);
+	g_assert_cmpuint(data.started->len, ==, 1);
+	g_assert_cmpuint(data.destroyed, ==, 1);
+
+	/* Users with the same image share a fetch when the checksum says so. */
+	test_purple_avatar_fetcher_submit(fetcher, account, "bob", "b",
+	                                  PURPLE_AVATAR_FETCH_FLAGS_CONTENT_CHECKSUM,
+	                                  &data);
+	test_purple_avatar_fetcher_submit(fetcher, account, "carol", "b",
+	                                  PURPLE_AVATAR_FETCH_FLAGS_CONTENT_CHECKSUM,
+	                                  &data);
+	g_assert_cmpuint(purple_avatar_fetcher_get_queued(fetcher, account), ==, 1);
+	g_assert_cmpuint(data.destroyed, ==, 2);
+
+	/* But not when it doesn't. */
+	test_purple_avatar_fetcher_submit(fetcher, account, "dave", "b",
+	                                  PURPLE_AVATAR_FETCH_FLAGS_NONE, &data);
+	g_assert_cmpuint(purple_avatar_fetcher_get_queued(fetcher, account), ==, 2);
+
+	/* A newer checksum replaces the queued fetch. */
+	test_purple_avatar_fetcher_submit(fetcher, account, "dave", "d",
+	                                  PURPLE_AVATAR_FETCH_FLAGS_NONE, &data);
+	g_assert_cmpuint(purple_avatar_fetcher_get_queued(fetcher, account), ==, 2);
+	g_assert_cmpuint(data.destroyed, ==, 3);
+
+	purple_avatar_fetch_complete(g_ptr_array_index(data.started, 0), NULL, 0);
+	g_assert_cmpuint(data.started->len, ==, 2);
+	g_assert_cmpstr(purple_avatar_fetch_get_username(g_ptr_array_index(data.started, 1)),
+	                ==, "bob");
+
+	purple_avatar_fetch_complete(g_ptr_array_index(data.started, 1), NULL, 0);
+	g_assert_cmpuint(data.started->len, ==, 3);
+	g_assert_cmpstr(purple_avatar_fetch_get_checksum(g_ptr_array_index(data.started, 2)),
+	                ==, "d");
+
+	purple_avatar_fetch_complete(g_ptr_array_index(data.started, 2), NULL, 0);
+	g_assert_cmpuint(purple_avatar_fetcher_get_active(fetcher, account), ==, 0);
+	g_assert_cmpuint(data.destroyed, ==, 6);
+
+	g_ptr_array_free(data.started, TRUE);
+	purple_avatar_fetcher_cancel(fetcher, account);
+	g_clear_object(&account);
+}
+
+static void
+test_purple_avatar_fetcher_priority(void) {
+	PurpleAvatarFetcher *fetcher = purple_avatar_fetcher_get_default();
+	PurpleAccount *account = NULL;
+	TestAvatarFetcherData data = {NULL, 0};
+
+	data.started = g_ptr_array_new();
+	account = purple_account_new("test", "test");
+	purple_avatar_fetcher_set_limit(fetcher, account, 1);
+
+	test_purple_avatar_fetcher_submit(fetcher, account, "alice", "a",
+	                                  PURPLE_AVATAR_FETCH_FLAGS_NONE, &data);
+	test_purple_avatar_fetcher_submit(fetcher, account, "bob", "b",
+	                                  PURPLE_AVATAR_FETCH_FLAGS_NONE, &data);
+	test_purple_avatar_fetcher_submit(fetcher, account, "carol", "c",
+	                                  PURPLE_AVATAR_FETCH_FLAGS_NONE, &data);
+	test_purple_avatar_fetcher_submit(fetcher, account, "dave", "d",
+	                                  PURPLE_AVATAR_FETCH_FLAGS_HIGH_PRIORITY,
+	                                  &data);
+	purple_avatar_fetcher_prioritize(fetcher, account, "carol");
+
+	purple_avatar_fetch_failed(g_ptr_array_index(data.started, 0));
+	g_assert_cmpstr(purple_avatar_fetch_get_username(g_ptr_array_index(data.started, 1)),
+	                ==, "dave");
+	purple_avatar_fetch_failed(g_ptr_array_index(data.started, 1));
+	g_assert_cmpstr(purple_avatar_fetch_get_username(g_ptr_array_index(data.started, 2)),
+	                ==, "carol");
+	purple_avatar_fetch_failed(g_ptr_array_index(data.started, 2));
+	g_assert_cmpstr(purple_avatar_fetch_get_username(g_ptr_array_index(data.started, 3)),
+	                ==, "bob");
+	purple_avatar_fetch_failed(g_ptr_array_index(data.started, 3));
+
+	g_assert_cmpuint(data.destroyed, ==, 4);
+
+	g_ptr_array_free(data.started, TRUE);
+	purple_avatar_fetcher_cancel(fetcher, account);
+	g_clear_object(&account);
+}
+
+static void
+test_purple_avatar_fetcher_detach_active(void) {
+	PurpleAvatarFetcher *fetcher = purple_avatar_fetcher_get_default();
+	PurpleAccount *account = NULL;
+	TestAvatarFetcherData data = {NULL, 0};
+
+	data.started = g_ptr_array_new();
+	account = purple_account_new("test", "test");
+	purple_avatar_fetcher_set_limit(fetcher, account, 2);
+
+	/* A newer checksum arrives while the old one is being fetched, so the
+	 * first fetch is no longer tied to any user. */
+	test_purple_avatar_fetcher_submit(fetcher, account, "alice", "a",
+	                                  PURPLE_AVATAR_FETCH_FLAGS_NONE, &data);
+	test_purple_avatar_fetcher_submit(fetcher, account, "alice", "b",
+	                                  PURPLE_AVATAR_FETCH_FLAGS_NONE, &data);
+	g_assert_cmpuint(data.started->len, ==, 2);
+	g_assert_cmpuint(purple_avatar_fetcher_get_active(fetcher, account), ==, 2);
+
+	/* Freeing the queue must orphan both, or finishing them afterwards
+	 * would touch the freed queue. */
+	purple_avatar_fetcher_cancel(fetcher, account);
+
+	purple_avatar_fetch_failed(g_ptr_array_index(data.started, 0));
+	purple_avatar_fetch_complete(g_ptr_array_index(data.started, 1), NULL, 0);
+	g_assert_cmpuint(data.destroyed, ==, 2);
+	g_assert_cmpuint(purple_avatar_fetcher_get_active(fetcher, account), ==, 0);
+
+	g_ptr_array_free(data.started, TRUE);
+	g_clear_object(&account);
+}
+
+static void
+test_purple_avatar_fetcher_timeout(void) {
+	PurpleAvatarFetcher *fetcher = purple_avatar_fetcher_get_default();
+	PurpleAccount *account = NULL;
+	TestAvatarFetcherData data = {NULL, 0};
+
+	data.started = g_ptr_array_new();
+	account = purple_account_new("test", "test");
+	purple_avatar_fetcher_set_limit(fetcher, account, 1);
+	purple_avatar_fetcher_set_timeout(fetcher, account, 1);
+
+	test_purple_avatar_fetcher_submit(fetcher, account, "alice", "a",
+	                                  PURPLE_AVATAR_FETCH_FLAGS_NONE, &data);
+	test_purple_avatar_fetcher_submit(fetcher, account, "bob", "b",
+	                                  PURPLE_AVATAR_FETCH_FLAGS_NONE, &data);
+	g_assert_cmpuint(data.started->len, ==, 1);
+
+	/* The first fetch never finishes, so it has to give up its slot. */
+	while(data.started->len < 2) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+
+	g_assert_cmpuint(purple_avatar_fetcher_get_active(fetcher, account), ==, 1);
+	g_assert_cmpuint(purple_avatar_fetcher_get_queued(fetcher, account), ==, 0);
+
+	/* Finishing it late is still allowed, but doesn't touch the queue. */
+	purple_avatar_fetch_complete(g_ptr_array_index(data.started, 0), NULL, 0);
+	g_assert_cmpuint(data.destroyed, ==, 1);
+	g_assert_cmpuint(purple_avatar_fetcher_get_active(fetcher, account), ==, 1);
+
+	purple_avatar_fetch_failed(g_ptr_array_index(data.started, 1));
+	g_assert_cmpuint(data.destroyed, ==, 2);
+	g_assert_cmpuint(purple_avatar_fetcher_get_active(fetcher, account), ==, 0);
+
+	purple_avatar_fetcher_cancel(fetcher, account);
+
+	g_ptr_array_free(data.started, TRUE);
+	g_clear_object(&account);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar *argv[]) {
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+
+	g_test_add_func("/avatar-fetcher/get-default",
+	                test_purple_avatar_fetcher_get_default);
+	g_test_add_func("/avatar-fetcher/limit",
+	                test_purple_avatar_fetcher_limit);
+	g_test_add_func("/avatar-fetcher/dedupe",
+	                test_purple_avatar_fetcher_dedupe);
+	g_test_add_func("/avatar-fetcher/priority",
+	                test_purple_avatar_fetcher_priority);
+	g_test_add_func("/avatar-fetcher/detach-active",
+	                test_purple_avatar_fetcher_detach_active);
+	g_test_add_func("/avatar-fetcher/timeout",
+	                test_purple_avatar_fetcher_timeout);
+
+	return g_test_run();
+}
@@ -260,6 +260,51 @@ test_purple_contact_manager_find_with_id(void) {
 	g_clear_object(&manager);
 }
 
+static void
+test_purple_contact_manager_buddy(void) {
+	PurpleAccount *account = NULL;
+	PurpleBuddy *buddy = NULL;
+	PurpleContact *contact = NULL;
+	PurpleContactManager *manager = NULL;
+	gint added_called = 0, removed_called = 0;
+
+	manager = g_object_new(PURPLE_TYPE_CONTACT_MANAGER, NULL);
+	g_signal_connect(manager, "added",
+	                 G_CALLBACK(test_purple_contact_manager_increment_cb),
+	                 &added_called);
+	g_signal_connect(manager, "removed",
+	                 G_CALLBACK(test_purple_contact_manager_increment_cb),
+	                 &removed_called);
+
+	account = purple_account_new("test", "test");
+	buddy = purple_buddy_new(account, "buddy", "alias");
+
+	purple_contact_manager_add_buddy(manager, buddy);
+	g_assert_cmpint(added_called, ==, 1);
+
+	contact = purple_contact_manager_find_with_id(manager, account,
+	                                              purple_buddy_get_id(buddy));
+	g_assert_nonnull(contact);
+	g_assert_cmpstr(purple_contact_get_username(contact), ==, "buddy");
+	g_assert_cmpstr(purple_contact_get_alias(contact), ==, "alias");
+	g_assert_true(purple_contact_get_presence(contact) ==
+	              purple_buddy_get_presence(buddy));
+
+	/* The contact follows the buddy. */
+	purple_buddy_set_local_alias(buddy, "new alias");
+	g_assert_cmpstr(purple_contact_get_alias(contact), ==, "new alias");
+
+	g_assert_true(purple_contact_manager_remove_buddy(manager, buddy));
+	g_assert_cmpint(removed_called, ==, 1);
+	g_assert_false(purple_contact_manager_remove_buddy(manager, buddy));
+
+	/* Cleanup. */
+	g_clear_object(&contact);
+	g_clear_object(&buddy);
+	g_clear_object(&account);
+	g_clear_object(&manager);
+}
+
 /******************************************************************************
  * Main
  *****************************************************************************/
@@ -286,5 +331,8 @@ main(gint argc, gchar *argv[]) {
 	g_test_add_func("/contact-manager/find/with-id",
 	                test_purple_contact_manager_find_with_id);
 
+	g_test_add_func("/contact-manager/buddy",
+	                test_purple_contact_manager_buddy);
+
 	return g_test_run();
 }
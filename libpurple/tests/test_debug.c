@@ -0,0 +1,439 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <purple.h>
+
+#define TEST_DEBUG_CATEGORY "test-debug"
+
+static guint test_debug_logged = 0;
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static GLogWriterOutput
+test_debug_writer(G_GNUC_UNUSED GLogLevelFlags log_level,
+                  const GLogField *fields, gsize n_fields,
+                  G_GNUC_UNUSED gpointer data)
+{
+	for(gsize i = 0; i < n_fields; i++) {
+		if(purple_strequal(fields[i].key, "GLIB_DOMAIN") &&
+		   purple_strequal(fields[i].value, TEST_DEBUG_CATEGORY))
+		{
+			test_debug_logged++;
+
+			return G_LOG_WRITER_HANDLED;
+		}
+	}
+
+	return G_LOG_WRITER_UNHANDLED;
+}
+
+static void
+test_debug_reset(void) {
+	purple_debug_set_level(PURPLE_DEBUG_ALL);
+	purple_debug_clear_category_levels();
+	purple_debug_set_ring_size(0);
+	purple_debug_set_ring_level(PURPLE_DEBUG_WARNING);
+	purple_debug_set_sink(NULL, NULL, NULL);
+
+	test_debug_logged = 0;
+}
+
+static gint
+test_debug_side_effect(gint *counter) {
+	(*counter)++;
+
+	return *counter;
+}
+
+static void
+test_debug_collect_cb(G_GNUC_UNUSED gint64 timestamp, PurpleDebugLevel level,
+                      const gchar *category, const gchar *message,
+                      gpointer data)
+{
+	GPtrArray *messages = data;
+
+	g_assert_cmpint(level, ==, PURPLE_DEBUG_MISC);
+	g_assert_cmpstr(category, ==, TEST_DEBUG_CATEGORY);
+
+	g_ptr_array_add(messages, g_strdup(message));
+}
+
+static void
+test_debug_sink_cb(GPtrArray *records, gpointer data) {
+	GPtrArray *collected = data;
+
+	for(guint i = 0; i < records->len; i++) {
+		PurpleDebugRecord *record = g_ptr_array_index(records, i);
+		PurpleDebugRecord *copy = g_new(PurpleDebugRecord, 1);
+
+		/* The strings in the copy are interned so the test doesn't have to
+		 * free them. */
+		*copy = *record;
+		copy->category = g_intern_string(record->category);
+		copy->message = g_intern_string(record->message);
+
+		g_ptr_array_add(collected, copy);
+	}
+}
+
+static gpointer
+test_debug_sink_thread(gpointer data) {
+	for(gint i = 0; i < 100; i++) {
+		purple_debug_misc(TEST_DEBUG_CATEGORY, "thread %d\n", i);
+	}
+
+	return NULL;
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_debug_level(void) {
+	test_debug_reset();
+
+	purple_debug_misc(TEST_DEBUG_CATEGORY, "logged\n");
+	g_assert_cmpuint(test_debug_logged, ==, 1);
+
+	purple_debug_set_level(PURPLE_DEBUG_WARNING);
+	g_assert_false(purple_debug_is_enabled(PURPLE_DEBUG_INFO,
+	                                       TEST_DEBUG_CATEGORY));
+	g_assert_true(purple_debug_is_enabled(PURPLE_DEBUG_WARNING,
+	                                      TEST_DEBUG_CATEGORY));
+
+	purple_debug_info(TEST_DEBUG_CATEGORY, "dropped\n");
+	g_assert_cmpuint(test_debug_logged, ==, 1);
+
+	purple_debug_warning(TEST_DEBUG_CATEGORY, "logged\n");
+	g_assert_cmpuint(test_debug_logged, ==, 2);
+}
+
+static void
+test_debug_category_level(void) {
+	test_debug_reset();
+
+	purple_debug_set_level(PURPLE_DEBUG_ERROR);
+	purple_debug_set_category_level(TEST_DEBUG_CATEGORY, PURPLE_DEBUG_MISC);
+
+	g_assert_true(purple_debug_is_enabled(PURPLE_DEBUG_MISC,
+	                                      TEST_DEBUG_CATEGORY));
+	g_assert_false(purple_debug_is_enabled(PURPLE_DEBUG_MISC, "other"));
+
+	purple_debug_misc(TEST_DEBUG_CATEGORY, "logged\n");
+	g_assert_cmpuint(test_debug_logged, ==, 1);
+
+	purple_debug_clear_category_levels();
+	g_assert_false(purple_debug_is_enabled(PURPLE_DEBUG_MISC,
+	                                       TEST_DEBUG_CATEGORY));
+
+	purple_debug_misc(TEST_DEBUG_CATEGORY, "dropped\n");
+	g_assert_cmpuint(test_debug_logged, ==, 1);
+}
+
+static void
+test_debug_lazy(void) {
+	gint counter = 0;
+
+	test_debug_reset();
+
+	purple_debug_set_level(PURPLE_DEBUG_ERROR);
+	purple_debug_lazy(PURPLE_DEBUG_MISC, TEST_DEBUG_CATEGORY, "%d\n",
+	                  test_debug_side_effect(&counter));
+	g_assert_cmpint(counter, ==, 0);
+	g_assert_cmpuint(test_debug_logged, ==, 0);
+
+	purple_debug_set_level(PURPLE_DEBUG_ALL);
+	purple_debug_lazy(PURPLE_DEBUG_MISC, TEST_DEBUG_CATEGORY, "%d\n",
+	                  test_debug_side_effect(&counter));
+	g_assert_cmpint(counter, ==, 1);
+	g_assert_cmpuint(test_debug_logged, ==, 1);
+}
+
+static void
+test_debug_ring(void) {
+	GPtrArray *messages = g_ptr_array_new_with_free_func(g_free);
+	gchar *dump = NULL;
+
+	test_debug_reset();
+
+	/* Nothing is logged, but the ring still records. */
+	purple_debug_set_level(PURPLE_DEBUG_ERROR);
+	purple_debug_set_ring_size(4096);
+	purple_debug_set_ring_level(PURPLE_DEBUG_MISC);
+	g_assert_true(purple_debug_is_enabled(PURPLE_DEBUG_MISC,
+	                                      TEST_DEBUG_CATEGORY));
+
+	purple_debug_misc(TEST_DEBUG_CATEGORY, "one\n");
+	purple_debug_misc(TEST_DEBUG_CATEGORY, "%s\n", "two");
+	g_assert_cmpuint(test_debug_logged, ==, 0);
+
+	purple_debug_ring_foreach(test_debug_collect_cb, messages);
+	g_assert_cmpuint(messages->len, ==, 2);
+	g_assert_cmpstr(g_ptr_array_index(messages, 0), ==, "one");
+	g_assert_cmpstr(g_ptr_array_index(messages, 1), ==, "two");
+
+	dump = purple_debug_ring_dump();
+	g_assert_nonnull(g_strstr_len(dump, -1, "misc " TEST_DEBUG_CATEGORY ": one\n"));
+	g_assert_nonnull(g_strstr_len(dump, -1, "misc " TEST_DEBUG_CATEGORY ": two\n"));
+	g_free(dump);
+
+	/* Resizing discards the old records. */
+	purple_debug_set_ring_size(2048);
+	g_ptr_array_set_size(messages, 0);
+	purple_debug_ring_foreach(test_debug_collect_cb, messages);
+	g_assert_cmpuint(messages->len, ==, 0);
+
+	g_ptr_array_free(messages, TRUE);
+}
+
+static void
+test_debug_ring_wrap(void) {
+	GPtrArray *messages = g_ptr_array_new_with_free_func(g_free);
+
+	test_debug_reset();
+
+	purple_debug_set_level(PURPLE_DEBUG_ERROR);
+	purple_debug_set_ring_size(200);
+	purple_debug_set_ring_level(PURPLE_DEBUG_MISC);
+
+	for(gint i = 0; i < 100; i++) {
+		purple_debug_misc(TEST_DEBUG_CATEGORY, "message %d\n", i);
+	}
+
+	purple_debug_ring_foreach(test_debug_collect_cb, messages);
+	g_assert_cmpuint(messages->len, >, 0);
+	g_assert_cmpuint(messages->len, <, 100);
+
+	/* The newest records survive, in order. */
+	for(guint i = 0; i < messages->len; i++) {
+		gchar *expected = g_strdup_printf("message %u",
+		                                  100 - messages->len + i);
+
+		g_assert_cmpstr(g_ptr_array_index(messages, i), ==, expected);
+
+		g_free(expected);
+	}
+
+	g_ptr_array_free(messages, TRUE);
+}
+
+static void
+test_debug_sink(void) {
+	GPtrArray *records = g_ptr_array_new_with_free_func(g_free);
+	PurpleDebugRecord *first = NULL, *second = NULL;
+
+	test_debug_reset();
+
+	purple_debug_set_sink(test_debug_sink_cb, records, NULL);
+
+	purple_debug_misc(TEST_DEBUG_CATEGORY, "one\n");
+	purple_debug_misc(TEST_DEBUG_CATEGORY, "%s\n", "two");
+
+	/* Nothing goes to the log writer or the sink until the main loop gets
+	 * around to it. */
+	g_assert_cmpuint(test_debug_logged, ==, 0);
+	g_assert_cmpuint(records->len, ==, 0);
+
+	while(g_main_context_iteration(NULL, FALSE));
+	g_assert_cmpuint(records->len, ==, 2);
+
+	first = g_ptr_array_index(records, 0);
+	second = g_ptr_array_index(records, 1);
+	g_assert_cmpstr(first->message, ==, "one");
+	g_assert_cmpstr(first->category, ==, TEST_DEBUG_CATEGORY);
+	g_assert_cmpint(first->level, ==, PURPLE_DEBUG_MISC);
+	g_assert_cmpstr(second->message, ==, "two");
+	g_assert_cmpint(first->timestamp, <=, second->timestamp);
+	g_assert_cmpuint(first->thread_id, ==, second->thread_id);
+	g_assert_cmpuint(first->thread_id, >, 0);
+
+	/* Removing the sink goes back to the log writer. */
+	purple_debug_set_sink(NULL, NULL, NULL);
+	purple_debug_misc(TEST_DEBUG_CATEGORY, "three\n");
+	g_assert_cmpuint(test_debug_logged, ==, 1);
+	g_assert_cmpuint(records->len, ==, 2);
+
+	g_ptr_array_free(records, TRUE);
+}
+
+static void
+test_debug_sink_threads(void) {
+	GPtrArray *records = g_ptr_array_new_with_free_func(g_free);
+	GHashTable *thread_ids = g_hash_table_new(NULL, NULL);
+	GThread *threads[4];
+
+	test_debug_reset();
+
+	purple_debug_set_sink(test_debug_sink_cb, records, NULL);
+
+	for(guint i = 0; i < G_N_ELEMENTS(threads); i++) {
+		threads[i] = g_thread_new("test-debug", test_debug_sink_thread, NULL);
+	}
+	for(guint i = 0; i < G_N_ELEMENTS(threads); i++) {
+		g_thread_join(threads[i]);
+	}
+
+	purple_debug_sink_flush();
+	g_assert_cmpuint(records->len, ==, 100 * G_N_ELEMENTS(threads));
+
+	for(guint i = 0; i < records->len; i++) {
+		PurpleDebugRecord *record = g_ptr_array_index(records, i);
+
+		g_hash_table_add(thread_ids, GUINT_TO_POINTER(record->thread_id));
+
+		if(i > 0) {
+			PurpleDebugRecord *previous = g_ptr_array_index(records, i - 1);
+
+			g_assert_cmpint(previous->timestamp, <=, record->timestamp);
+		}
+	}
+	g_assert_cmpuint(g_hash_table_size(thread_ids), ==,
+	                 G_N_ELEMENTS(threads));
+
+	purple_debug_set_sink(NULL, NULL, NULL);
+
+	g_hash_table_destroy(thread_ids);
+	g_ptr_array_free(records, TRUE);
+}
+
+static void
+test_debug_sink_overflow(void) {
+	GPtrArray *records = g_ptr_array_new_with_free_func(g_free);
+	PurpleDebugRecord *last = NULL;
+
+	test_debug_reset();
+
+	purple_debug_set_sink(test_debug_sink_cb, records, NULL);
+
+	for(gint i = 0; i < 5000; i++) {
+		purple_debug_misc(TEST_DEBUG_CATEGORY, "message %d\n", i);
+	}
+
+	/* The queue keeps the oldest records and reports how many it lost. */
+	purple_debug_sink_flush();
+	g_assert_cmpuint(records->len, >, 1);
+	g_assert_cmpuint(records->len, <, 5000);
+
+	last = g_ptr_array_index(records, records->len - 1);
+	g_assert_cmpint(last->level, ==, PURPLE_DEBUG_WARNING);
+	g_assert_true(g_str_has_suffix(last->message, "messages were dropped"));
+	g_assert_cmpstr(((PurpleDebugRecord *)g_ptr_array_index(records, 0))->message,
+	                ==, "message 0");
+
+	purple_debug_set_sink(NULL, NULL, NULL);
+
+	g_ptr_array_free(records, TRUE);
+}
+
+static void
+test_debug_print_sink_cb(GPtrArray *records, G_GNUC_UNUSED gpointer data) {
+	for(guint i = 0; i < records->len; i++) {
+		PurpleDebugRecord *record = g_ptr_array_index(records, i);
+
+		g_print("%s\n", record->message);
+	}
+}
+
+static void
+test_debug_sink_fatal(void) {
+	if(g_test_subprocess()) {
+		test_debug_reset();
+
+		purple_debug_set_sink(test_debug_print_sink_cb, NULL, NULL);
+
+		/* Act like we're running in the main loop. */
+		g_main_context_acquire(NULL);
+
+		purple_debug_misc(TEST_DEBUG_CATEGORY, "queued\n");
+		purple_debug_fatal(TEST_DEBUG_CATEGORY, "fatal\n");
+
+		/* Not reached, the fatal message aborts right away. */
+		return;
+	}
+
+	/* Whatever was queued is delivered before the process goes down. */
+	g_test_trap_subprocess(NULL, 0, 0);
+	g_test_trap_assert_failed();
+	g_test_trap_assert_stdout("queued\n");
+}
+
+static gpointer
+test_debug_sink_fatal_thread_func(G_GNUC_UNUSED gpointer data) {
+	purple_debug_misc(TEST_DEBUG_CATEGORY, "queued\n");
+	purple_debug_fatal(TEST_DEBUG_CATEGORY, "fatal\n");
+
+	return NULL;
+}
+
+static void
+test_debug_sink_fatal_thread(void) {
+	if(g_test_subprocess()) {
+		GThread *thread = NULL;
+
+		test_debug_reset();
+
+		purple_debug_set_sink(test_debug_print_sink_cb, NULL, NULL);
+
+		g_main_context_acquire(NULL);
+
+		thread = g_thread_new("fatal", test_debug_sink_fatal_thread_func,
+		                      NULL);
+		g_thread_join(thread);
+
+		/* Not reached, the fatal message aborts right away. */
+		return;
+	}
+
+	/* The sink may only run in the main loop, so the queued message goes to
+	 * stderr instead. */
+	g_test_trap_subprocess(NULL, 0, 0);
+	g_test_trap_assert_failed();
+	g_test_trap_assert_stdout_unmatched("*queued*");
+	g_test_trap_assert_stderr("*" TEST_DEBUG_CATEGORY ": queued*");
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	g_log_set_writer_func(test_debug_writer, NULL, NULL);
+
+	g_test_add_func("/debug/level", test_debug_level);
+	g_test_add_func("/debug/category-level", test_debug_category_level);
+	g_test_add_func("/debug/lazy", test_debug_lazy);
+	g_test_add_func("/debug/ring", test_debug_ring);
+	g_test_add_func("/debug/ring/wrap", test_debug_ring_wrap);
+	g_test_add_func("/debug/sink", test_debug_sink);
+	g_test_add_func("/debug/sink/threads", test_debug_sink_threads);
+	g_test_add_func("/debug/sink/overflow", test_debug_sink_overflow);
+	g_test_add_func("/debug/sink/fatal", test_debug_sink_fatal);
+	g_test_add_func("/debug/sink/fatal/thread",
+	                test_debug_sink_fatal_thread);
+
+	return g_test_run();
+}
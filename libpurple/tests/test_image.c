@@ -156,6 +156,122 @@ test_image_new_from_file(void) {
 	g_free(path);
 }
 
+static void
+test_image_new_from_file_async_cb(GObject *source, GAsyncResult *result,
+                                  gpointer data)
+{
+	PurpleImage *image = NULL;
+	GMainLoop *loop = data;
+	GError *error = NULL;
+	gchar *path = NULL;
+
+	image = purple_image_new_from_file_finish(result, &error);
+	g_assert_no_error(error);
+
+	path = g_build_filename(TEST_DATA_DIR, "test-image.png", NULL);
+
+	_test_image(
+		image,
+		test_image_data,
+		test_image_data_len,
+		path,
+		"png",
+		"image/png"
+	);
+
+	g_free(path);
+
+	g_main_loop_quit(loop);
+}
+
+static void
+test_image_new_from_file_async(void) {
+	GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+	gchar *path = NULL;
+
+	path = g_build_filename(TEST_DATA_DIR, "test-image.png", NULL);
+	purple_image_new_from_file_async(path, NULL,
+	                                 test_image_new_from_file_async_cb, loop);
+	g_free(path);
+
+	g_main_loop_run(loop);
+	g_main_loop_unref(loop);
+}
+
+static void
+test_image_new_from_file_async_cancelled_cb(GObject *source,
+                                            GAsyncResult *result,
+                                            gpointer data)
+{
+	PurpleImage *image = NULL;
+	GMainLoop *loop = data;
+	GError *error = NULL;
+
+	image = purple_image_new_from_file_finish(result, &error);
+	g_assert_error(error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+	g_assert_null(image);
+	g_clear_error(&error);
+
+	g_main_loop_quit(loop);
+}
+
+static void
+test_image_new_from_file_async_cancelled(void) {
+	GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+	GCancellable *cancellable = g_cancellable_new();
+	gchar *path = NULL;
+
+	g_cancellable_cancel(cancellable);
+
+	path = g_build_filename(TEST_DATA_DIR, "test-image.png", NULL);
+	purple_image_new_from_file_async(path, cancellable,
+	                                 test_image_new_from_file_async_cancelled_cb,
+	                                 loop);
+	g_free(path);
+
+	g_main_loop_run(loop);
+	g_main_loop_unref(loop);
+	g_object_unref(cancellable);
+}
+
+static void
+test_image_new_from_stream(void) {
+	PurpleImage *image = NULL;
+	GInputStream *stream = NULL;
+	GError *error = NULL;
+
+	stream = g_memory_input_stream_new_from_data(test_image_data,
+	                                             test_image_data_len, NULL);
+	image = purple_image_new_from_stream(stream, NULL, &error);
+	g_assert_no_error(error);
+	g_object_unref(stream);
+
+	_test_image(
+		image,
+		test_image_data,
+		test_image_data_len,
+		NULL,
+		"png",
+		"image/png"
+	);
+}
+
+static void
+test_image_unknown_format(void) {
+	PurpleImage *image = NULL;
+	const guint8 data[] = { 'n', 'o', 'p', 'e', '!' };
+
+	image = purple_image_new_from_data(data, sizeof(data));
+
+	/* Ask twice to make sure the negative result is cached too. */
+	g_assert_null(purple_image_get_extension(image));
+	g_assert_null(purple_image_get_mimetype(image));
+	g_assert_null(purple_image_get_extension(image));
+	g_assert_null(purple_image_get_mimetype(image));
+
+	g_object_unref(image);
+}
+
 /******************************************************************************
  * Main
  *****************************************************************************/
@@ -168,6 +284,12 @@ main(gint argc, gchar **argv) {
 	g_test_add_func("/image/new-from-bytes", test_image_new_from_bytes);
 	g_test_add_func("/image/new-from-data", test_image_new_from_data);
 	g_test_add_func("/image/new-from-file", test_image_new_from_file);
+	g_test_add_func("/image/new-from-file-async",
+	                test_image_new_from_file_async);
+	g_test_add_func("/image/new-from-file-async/cancelled",
+	                test_image_new_from_file_async_cancelled);
+	g_test_add_func("/image/new-from-stream", test_image_new_from_stream);
+	g_test_add_func("/image/unknown-format", test_image_unknown_format);
 
 	return g_test_run();
 }
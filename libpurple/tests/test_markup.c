@@ -220,6 +220,125 @@ test_util_markup_html_to_xhtml(void) {
 	}
 }
 
+static void
+test_util_markup_linkify(void) {
+	gint i;
+	const gchar *data[][2] = {
+		{
+			"plain text without links",
+			"plain text without links",
+		}, {
+			"see https://pidgin.im/ for details",
+			"see <A HREF=\"https://pidgin.im/\">https://pidgin.im/</A> for details",
+		}, {
+			"visit www.pidgin.im.",
+			"visit <A HREF=\"http://www.pidgin.im\">www.pidgin.im</A>.",
+		}, {
+			"(http://pidgin.im/)",
+			"(<A HREF=\"http://pidgin.im/\">http://pidgin.im/</A>)",
+		}, {
+			"mail me at user@pidgin.im",
+			"mail me at <A HREF=\"mailto:user@pidgin.im\">user@pidgin.im</A>",
+		}, {
+			"<a href=\"http://pidgin.im/\">http://pidgin.im/</a>",
+			"<a href=\"http://pidgin.im/\">http://pidgin.im/</a>",
+		}, {
+			"<b title=\"www.pidgin.im\">bold</b>",
+			"<b title=\"www.pidgin.im\">bold</b>",
+		},
+	};
+
+	for(i = 0; i < (gint)G_N_ELEMENTS(data); i++) {
+		gchar *linked = purple_markup_linkify(data[i][0]);
+
+		g_assert_cmpstr(linked, ==, data[i][1]);
+		g_free(linked);
+	}
+}
+
+static void
+test_util_markup_strip_html(void) {
+	gint i;
+	const gchar *data[][2] = {
+		{
+			"plain text",
+			"plain text",
+		}, {
+			"<b>bold</b> &amp; <i>italic</i>",
+			"bold & italic",
+		}, {
+			"one<br>two\nthree",
+			"one\ntwo three",
+		}, {
+			"before<script>alert('hi');</script>after",
+			"beforeafter",
+		}, {
+			"<a href=\"http://pidgin.im/\">Pidgin</a>",
+			"Pidgin (http://pidgin.im/)",
+		}, {
+			"<table><tr><td>a</td> <td>b</td></tr></table>",
+			"a\tb\n",
+		},
+	};
+
+	for(i = 0; i < (gint)G_N_ELEMENTS(data); i++) {
+		gchar *stripped = purple_markup_strip_html(data[i][0]);
+
+		g_assert_cmpstr(stripped, ==, data[i][1]);
+		g_free(stripped);
+	}
+}
+
+/******************************************************************************
+ * Benchmarks
+ *****************************************************************************/
+static gchar **
+test_util_markup_load_corpus(void) {
+	GError *error = NULL;
+	gchar *contents = NULL;
+	gchar **lines = NULL;
+
+	g_file_get_contents(TEST_DATA_DIR "/markup-corpus.txt", &contents, NULL,
+	                    &error);
+	g_assert_no_error(error);
+
+	lines = g_strsplit(contents, "\n", -1);
+	g_free(contents);
+
+	return lines;
+}
+
+static void
+test_util_markup_benchmark(gchar *(*func)(const gchar *)) {
+	gchar **corpus = test_util_markup_load_corpus();
+	gsize bytes = 0;
+	gdouble throughput = 0.0;
+	gint round, i;
+
+	g_test_timer_start();
+	for(round = 0; round < 2000; round++) {
+		for(i = 0; corpus[i] != NULL; i++) {
+			g_free(func(corpus[i]));
+			bytes += strlen(corpus[i]);
+		}
+	}
+	throughput = bytes / g_test_timer_elapsed() / 1e6;
+
+	g_test_maximized_result(throughput, "%.1f MB/s", throughput);
+
+	g_strfreev(corpus);
+}
+
+static void
+test_util_markup_benchmark_linkify(void) {
+	test_util_markup_benchmark(purple_markup_linkify);
+}
+
+static void
+test_util_markup_benchmark_strip_html(void) {
+	test_util_markup_benchmark(purple_markup_strip_html);
+}
+
 /******************************************************************************
  * Main
  *****************************************************************************/
@@ -229,6 +348,15 @@ main(gint argc, gchar **argv) {
 
 	g_test_add_func("/util/markup/html to xhtml",
 	                test_util_markup_html_to_xhtml);
+	g_test_add_func("/util/markup/linkify", test_util_markup_linkify);
+	g_test_add_func("/util/markup/strip html", test_util_markup_strip_html);
+
+	if(g_test_perf()) {
+		g_test_add_func("/util/markup/benchmark/linkify",
+		                test_util_markup_benchmark_linkify);
+		g_test_add_func("/util/markup/benchmark/strip html",
+		                test_util_markup_benchmark_strip_html);
+	}
 
 	return g_test_run();
 }
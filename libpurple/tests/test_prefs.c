@@ -0,0 +1,341 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <glib.h>
+
+#include <purple.h>
+
+#include "test_ui.h"
+
+#define TEST_PREFS_ROOT "/purple/test_prefs"
+
+static gint callback_handle = 0;
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+typedef struct {
+	gint called;
+	gchar *name;
+	gconstpointer value;
+} TestPrefsCallbackData;
+
+static void
+test_prefs_callback_cb(const char *name, G_GNUC_UNUSED PurplePrefType type,
+                       gconstpointer val, gpointer data)
+{
+	TestPrefsCallbackData *cb_data = data;
+
+	cb_data->called++;
+	g_free(cb_data->name);
+	cb_data->name = g_strdup(name);
+	cb_data->value = val;
+}
+
+static void
+test_prefs_setup(void) {
+	purple_prefs_add_none(TEST_PREFS_ROOT);
+	purple_prefs_add_bool(TEST_PREFS_ROOT "/bool", FALSE);
+	purple_prefs_add_int(TEST_PREFS_ROOT "/int", 0);
+	purple_prefs_add_string(TEST_PREFS_ROOT "/string", "");
+	purple_prefs_add_none(TEST_PREFS_ROOT "/nested");
+	purple_prefs_add_bool(TEST_PREFS_ROOT "/nested/bool", FALSE);
+}
+
+static void
+test_prefs_teardown(void) {
+	purple_prefs_disconnect_by_handle(&callback_handle);
+	purple_prefs_remove(TEST_PREFS_ROOT);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_prefs_lookup(void) {
+	PurplePref *pref = NULL;
+
+	test_prefs_setup();
+
+	pref = purple_prefs_lookup(TEST_PREFS_ROOT "/nested/bool");
+	g_assert_nonnull(pref);
+	g_assert_cmpstr(purple_pref_get_name(pref), ==,
+	                TEST_PREFS_ROOT "/nested/bool");
+	g_assert_cmpint(purple_pref_get_pref_type(pref), ==, PURPLE_PREF_BOOLEAN);
+
+	pref = purple_prefs_lookup("/");
+	g_assert_nonnull(pref);
+	g_assert_cmpstr(purple_pref_get_name(pref), ==, "/");
+
+	g_assert_null(purple_prefs_lookup(TEST_PREFS_ROOT "/missing"));
+	g_assert_null(purple_prefs_lookup(TEST_PREFS_ROOT "/bool/missing"));
+	g_assert_null(purple_prefs_lookup(TEST_PREFS_ROOT "/nested/"));
+	g_assert_null(purple_prefs_lookup("/purple//test_prefs"));
+
+	purple_prefs_remove(TEST_PREFS_ROOT "/nested");
+	g_assert_null(purple_prefs_lookup(TEST_PREFS_ROOT "/nested/bool"));
+	g_assert_null(purple_prefs_lookup(TEST_PREFS_ROOT "/nested"));
+	g_assert_nonnull(purple_prefs_lookup(TEST_PREFS_ROOT "/bool"));
+
+	/* Adding it again must work now that the old one is gone. */
+	purple_prefs_add_none(TEST_PREFS_ROOT "/nested");
+	g_assert_nonnull(purple_prefs_lookup(TEST_PREFS_ROOT "/nested"));
+
+	test_prefs_teardown();
+}
+
+static void
+test_prefs_handle(void) {
+	TestPrefsCallbackData data = { 0, };
+	PurplePref *bool_pref = NULL, *int_pref = NULL, *string_pref = NULL;
+
+	test_prefs_setup();
+
+	bool_pref = purple_prefs_lookup(TEST_PREFS_ROOT "/bool");
+	int_pref = purple_prefs_lookup(TEST_PREFS_ROOT "/int");
+	string_pref = purple_prefs_lookup(TEST_PREFS_ROOT "/string");
+
+	purple_prefs_connect_callback(&callback_handle,
+	                              TEST_PREFS_ROOT "/bool",
+	                              test_prefs_callback_cb, &data);
+
+	purple_pref_set_bool(bool_pref, TRUE);
+	g_assert_true(purple_prefs_get_bool(TEST_PREFS_ROOT "/bool"));
+	g_assert_cmpint(data.called, ==, 1);
+	g_assert_cmpstr(data.name, ==, TEST_PREFS_ROOT "/bool");
+	g_assert_true(GPOINTER_TO_INT(data.value));
+
+	/* Setting the same value again doesn't notify. */
+	purple_pref_set_bool(bool_pref, TRUE);
+	g_assert_cmpint(data.called, ==, 1);
+
+	purple_prefs_set_bool(TEST_PREFS_ROOT "/bool", FALSE);
+	g_assert_false(purple_pref_get_bool(bool_pref));
+	g_assert_cmpint(data.called, ==, 2);
+
+	purple_pref_set_int(int_pref, 42);
+	g_assert_cmpint(purple_prefs_get_int(TEST_PREFS_ROOT "/int"), ==, 42);
+
+	purple_pref_set_string(string_pref, "potato");
+	g_assert_cmpstr(purple_prefs_get_string(TEST_PREFS_ROOT "/string"), ==,
+	                "potato");
+	g_assert_cmpstr(purple_pref_get_string(string_pref), ==, "potato");
+
+	test_prefs_teardown();
+	g_free(data.name);
+}
+
+static void
+test_prefs_batch(void) {
+	TestPrefsCallbackData leaf = { 0, }, parent = { 0, };
+
+	test_prefs_setup();
+
+	purple_prefs_connect_callback(&callback_handle,
+	                              TEST_PREFS_ROOT "/bool",
+	                              test_prefs_callback_cb, &leaf);
+	purple_prefs_connect_callback(&callback_handle, TEST_PREFS_ROOT,
+	                              test_prefs_callback_cb, &parent);
+
+	purple_prefs_begin_batch();
+	purple_prefs_set_bool(TEST_PREFS_ROOT "/bool", TRUE);
+	purple_prefs_set_bool(TEST_PREFS_ROOT "/bool", FALSE);
+	purple_prefs_set_bool(TEST_PREFS_ROOT "/bool", TRUE);
+	purple_prefs_set_int(TEST_PREFS_ROOT "/int", 1);
+	purple_prefs_set_int(TEST_PREFS_ROOT "/int", 2);
+
+	g_assert_cmpint(leaf.called, ==, 0);
+	g_assert_cmpint(parent.called, ==, 0);
+
+	purple_prefs_end_batch();
+
+	/* Each pref notifies once with its final value, in the order they were
+	 * first changed. */
+	g_assert_cmpint(leaf.called, ==, 1);
+	g_assert_true(GPOINTER_TO_INT(leaf.value));
+	g_assert_cmpint(parent.called, ==, 2);
+	g_assert_cmpstr(parent.name, ==, TEST_PREFS_ROOT "/int");
+	g_assert_cmpint(GPOINTER_TO_INT(parent.value), ==, 2);
+
+	test_prefs_teardown();
+	g_free(leaf.name);
+	g_free(parent.name);
+}
+
+static void
+test_prefs_batch_nested(void) {
+	TestPrefsCallbackData data = { 0, };
+
+	test_prefs_setup();
+
+	purple_prefs_connect_callback(&callback_handle,
+	                              TEST_PREFS_ROOT "/bool",
+	                              test_prefs_callback_cb, &data);
+
+	purple_prefs_begin_batch();
+	purple_prefs_begin_batch();
+	purple_prefs_set_bool(TEST_PREFS_ROOT "/bool", TRUE);
+	purple_prefs_end_batch();
+
+	g_assert_cmpint(data.called, ==, 0);
+
+	purple_prefs_set_bool(TEST_PREFS_ROOT "/bool", FALSE);
+	purple_prefs_end_batch();
+
+	g_assert_cmpint(data.called, ==, 1);
+	g_assert_false(GPOINTER_TO_INT(data.value));
+
+	test_prefs_teardown();
+	g_free(data.name);
+}
+
+static void
+test_prefs_batch_remove(void) {
+	TestPrefsCallbackData data = { 0, };
+
+	test_prefs_setup();
+
+	purple_prefs_connect_callback(&callback_handle, TEST_PREFS_ROOT,
+	                              test_prefs_callback_cb, &data);
+
+	purple_prefs_begin_batch();
+	purple_prefs_set_bool(TEST_PREFS_ROOT "/nested/bool", TRUE);
+	purple_prefs_set_int(TEST_PREFS_ROOT "/int", 7);
+	purple_prefs_remove(TEST_PREFS_ROOT "/nested");
+	purple_prefs_end_batch();
+
+	/* Only the pref that still exists notifies. */
+	g_assert_cmpint(data.called, ==, 1);
+	g_assert_cmpstr(data.name, ==, TEST_PREFS_ROOT "/int");
+
+	test_prefs_teardown();
+	g_free(data.name);
+}
+
+/******************************************************************************
+ * Benchmarks
+ *****************************************************************************/
+#define TEST_PREFS_ROUNDS (1000000)
+
+static void
+test_prefs_benchmark_counter_cb(G_GNUC_UNUSED const char *name,
+                                G_GNUC_UNUSED PurplePrefType type,
+                                G_GNUC_UNUSED gconstpointer val,
+                                gpointer data)
+{
+	guint *counter = data;
+
+	(*counter)++;
+}
+
+static void
+test_prefs_benchmark_report(const gchar *what, gdouble elapsed) {
+	gdouble ns = elapsed * 1e9 / TEST_PREFS_ROUNDS;
+
+	g_test_minimized_result(ns, "%s: %.1f ns/op", what, ns);
+}
+
+static void
+test_prefs_benchmark_get(void) {
+	PurplePref *pref = NULL;
+	gint sum = 0;
+
+	test_prefs_setup();
+	pref = purple_prefs_lookup(TEST_PREFS_ROOT "/nested/bool");
+
+	g_test_timer_start();
+	for(gint i = 0; i < TEST_PREFS_ROUNDS; i++) {
+		sum += purple_prefs_get_bool(TEST_PREFS_ROOT "/nested/bool");
+	}
+	test_prefs_benchmark_report("get by name", g_test_timer_elapsed());
+
+	g_test_timer_start();
+	for(gint i = 0; i < TEST_PREFS_ROUNDS; i++) {
+		sum += purple_pref_get_bool(pref);
+	}
+	test_prefs_benchmark_report("get by handle", g_test_timer_elapsed());
+
+	g_assert_cmpint(sum, ==, 0);
+
+	test_prefs_teardown();
+}
+
+static void
+test_prefs_benchmark_set(void) {
+	PurplePref *pref = NULL;
+	guint called = 0;
+
+	test_prefs_setup();
+	pref = purple_prefs_lookup(TEST_PREFS_ROOT "/int");
+
+	purple_prefs_connect_callback(&callback_handle,
+	                              TEST_PREFS_ROOT "/int",
+	                              test_prefs_benchmark_counter_cb, &called);
+
+	g_test_timer_start();
+	for(gint i = 1; i <= TEST_PREFS_ROUNDS; i++) {
+		purple_prefs_set_int(TEST_PREFS_ROOT "/int", i);
+	}
+	test_prefs_benchmark_report("set by name with callback",
+	                            g_test_timer_elapsed());
+	g_assert_cmpuint(called, ==, TEST_PREFS_ROUNDS);
+
+	g_test_timer_start();
+	for(gint i = 1; i <= TEST_PREFS_ROUNDS; i++) {
+		purple_pref_set_int(pref, -i);
+	}
+	test_prefs_benchmark_report("set by handle with callback",
+	                            g_test_timer_elapsed());
+	g_assert_cmpuint(called, ==, 2 * TEST_PREFS_ROUNDS);
+
+	g_test_timer_start();
+	purple_prefs_begin_batch();
+	for(gint i = 1; i <= TEST_PREFS_ROUNDS; i++) {
+		purple_pref_set_int(pref, i);
+	}
+	purple_prefs_end_batch();
+	test_prefs_benchmark_report("set by handle in a batch",
+	                            g_test_timer_elapsed());
+	g_assert_cmpuint(called, ==, 2 * TEST_PREFS_ROUNDS + 1);
+
+	test_prefs_teardown();
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar *argv[]) {
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+
+	g_test_add_func("/prefs/lookup", test_prefs_lookup);
+	g_test_add_func("/prefs/handle", test_prefs_handle);
+	g_test_add_func("/prefs/batch", test_prefs_batch);
+	g_test_add_func("/prefs/batch/nested", test_prefs_batch_nested);
+	g_test_add_func("/prefs/batch/remove", test_prefs_batch_remove);
+
+	if(g_test_perf()) {
+		g_test_add_func("/prefs/benchmark/get", test_prefs_benchmark_get);
+		g_test_add_func("/prefs/benchmark/set", test_prefs_benchmark_set);
+	}
+
+	return g_test_run();
+}
@@ -34,6 +34,104 @@ static const guint8 test_bytes_data2[] = "6789";
 static const gsize test_bytes_data_len3 = 12;
 static const guint8 test_bytes_data3[] = "101112131415";
 
+/******************************************************************************
+ * TestCountingOutputStream
+ *****************************************************************************/
+
+/* An output stream that records how many bytes each call into it wrote, so
+ * we can tell how the queued stream split up its writes.
+ */
+#define TEST_TYPE_COUNTING_OUTPUT_STREAM (test_counting_output_stream_get_type())
+G_DECLARE_FINAL_TYPE(TestCountingOutputStream, test_counting_output_stream,
+		TEST, COUNTING_OUTPUT_STREAM, GOutputStream)
+
+struct _TestCountingOutputStream {
+	GOutputStream parent;
+
+	GByteArray *data;
+	GArray *writes;
+};
+
+G_DEFINE_TYPE(TestCountingOutputStream, test_counting_output_stream,
+		G_TYPE_OUTPUT_STREAM)
+
+static gssize
+test_counting_output_stream_write(GOutputStream *stream, const void *buffer,
+		gsize count, GCancellable *cancellable, GError **error)
+{
+	TestCountingOutputStream *counting = TEST_COUNTING_OUTPUT_STREAM(stream);
+
+	g_byte_array_append(counting->data, buffer, count);
+	g_array_append_val(counting->writes, count);
+
+	return count;
+}
+
+static gboolean
+test_counting_output_stream_writev(GOutputStream *stream,
+		const GOutputVector *vectors, gsize n_vectors, gsize *bytes_written,
+		GCancellable *cancellable, GError **error)
+{
+	TestCountingOutputStream *counting = TEST_COUNTING_OUTPUT_STREAM(stream);
+	gsize total = 0;
+	gsize i;
+
+	for (i = 0; i < n_vectors; i++) {
+		g_byte_array_append(counting->data, vectors[i].buffer,
+				vectors[i].size);
+		total += vectors[i].size;
+	}
+
+	g_array_append_val(counting->writes, total);
+
+	if (bytes_written != NULL) {
+		*bytes_written = total;
+	}
+
+	return TRUE;
+}
+
+static void
+test_counting_output_stream_finalize(GObject *obj) {
+	TestCountingOutputStream *counting = TEST_COUNTING_OUTPUT_STREAM(obj);
+
+	g_byte_array_unref(counting->data);
+	g_array_unref(counting->writes);
+
+	G_OBJECT_CLASS(test_counting_output_stream_parent_class)->finalize(obj);
+}
+
+static void
+test_counting_output_stream_init(TestCountingOutputStream *counting) {
+	counting->data = g_byte_array_new();
+	counting->writes = g_array_new(FALSE, FALSE, sizeof(gsize));
+}
+
+static void
+test_counting_output_stream_class_init(TestCountingOutputStreamClass *klass) {
+	GObjectClass *obj_class = G_OBJECT_CLASS(klass);
+	GOutputStreamClass *stream_class = G_OUTPUT_STREAM_CLASS(klass);
+
+	obj_class->finalize = test_counting_output_stream_finalize;
+
+	stream_class->write_fn = test_counting_output_stream_write;
+	stream_class->writev_fn = test_counting_output_stream_writev;
+}
+
+static void
+test_counting_output_stream_assert_writes(TestCountingOutputStream *counting,
+		const gsize *expected, guint n_expected)
+{
+	guint i;
+
+	g_assert_cmpuint(counting->writes->len, ==, n_expected);
+
+	for (i = 0; i < MIN(counting->writes->len, n_expected); i++) {
+		g_assert_cmpuint(g_array_index(counting->writes, gsize, i), ==,
+				expected[i]);
+	}
+}
+
 static void
 test_queued_output_stream_new(void) {
 	GOutputStream *output;
@@ -259,6 +357,203 @@ test_queued_output_stream_push_bytes_async_error(void) {
 	g_clear_object(&output);
 }
 
+static void
+test_queued_output_stream_push_bytes(PurpleQueuedOutputStream *queued,
+		const guint8 *data, gsize len, gint *done)
+{
+	GBytes *bytes = g_bytes_new_static(data, len);
+
+	purple_queued_output_stream_push_bytes_async(queued, bytes,
+			G_PRIORITY_DEFAULT, NULL,
+			test_queued_output_stream_push_bytes_async_multiple_cb,
+			done);
+	g_bytes_unref(bytes);
+}
+
+static void
+test_queued_output_stream_coalesce(void) {
+	TestCountingOutputStream *output;
+	PurpleQueuedOutputStream *queued;
+	GError *err = NULL;
+	gint done = 3;
+	const gsize expected[] = {
+		test_bytes_data_len,
+		test_bytes_data_len2 + test_bytes_data_len3,
+	};
+
+	output = g_object_new(TEST_TYPE_COUNTING_OUTPUT_STREAM, NULL);
+	queued = purple_queued_output_stream_new(G_OUTPUT_STREAM(output));
+
+	/* The first push starts writing right away, the other two are queued
+	 * behind it and should go out together.
+	 */
+	test_queued_output_stream_push_bytes(queued, test_bytes_data,
+			test_bytes_data_len, &done);
+	test_queued_output_stream_push_bytes(queued, test_bytes_data2,
+			test_bytes_data_len2, &done);
+	test_queued_output_stream_push_bytes(queued, test_bytes_data3,
+			test_bytes_data_len3, &done);
+
+	while (done > 0) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+
+	test_counting_output_stream_assert_writes(output, expected,
+			G_N_ELEMENTS(expected));
+
+	g_output_stream_close(G_OUTPUT_STREAM(queued), NULL, &err);
+	g_assert_no_error(err);
+
+	g_clear_object(&queued);
+	g_clear_object(&output);
+}
+
+static void
+test_queued_output_stream_cork(void) {
+	TestCountingOutputStream *output;
+	PurpleQueuedOutputStream *queued;
+	GString *expected_data;
+	GError *err = NULL;
+	const gchar *stanza = "PING :irc.example.com\r\n";
+	gsize stanza_len = strlen(stanza);
+	gsize expected[1];
+	gint done = 200;
+	gint i;
+
+	output = g_object_new(TEST_TYPE_COUNTING_OUTPUT_STREAM, NULL);
+	queued = purple_queued_output_stream_new(G_OUTPUT_STREAM(output));
+
+	expected_data = g_string_new(NULL);
+
+	purple_queued_output_stream_cork(queued);
+	for (i = 0; i < 200; i++) {
+		test_queued_output_stream_push_bytes(queued,
+				(const guint8 *)stanza, stanza_len, &done);
+		g_string_append(expected_data, stanza);
+	}
+
+	/* Nothing may be written while we're corked. */
+	while (g_main_context_iteration(NULL, FALSE));
+	g_assert_cmpint(done, ==, 200);
+	g_assert_cmpuint(output->writes->len, ==, 0);
+
+	purple_queued_output_stream_uncork(queued);
+
+	while (done > 0) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+
+	expected[0] = expected_data->len;
+	test_counting_output_stream_assert_writes(output, expected,
+			G_N_ELEMENTS(expected));
+	g_assert_cmpmem(output->data->data, output->data->len,
+			expected_data->str, expected_data->len);
+
+	g_string_free(expected_data, TRUE);
+
+	g_output_stream_close(G_OUTPUT_STREAM(queued), NULL, &err);
+	g_assert_no_error(err);
+
+	g_clear_object(&queued);
+	g_clear_object(&output);
+}
+
+static void
+test_queued_output_stream_cork_in_flight(void) {
+	TestCountingOutputStream *output;
+	PurpleQueuedOutputStream *queued;
+	GError *err = NULL;
+	gint done = 3;
+	const gsize expected[] = {
+		test_bytes_data_len,
+		test_bytes_data_len2 + test_bytes_data_len3,
+	};
+
+	output = g_object_new(TEST_TYPE_COUNTING_OUTPUT_STREAM, NULL);
+	queued = purple_queued_output_stream_new(G_OUTPUT_STREAM(output));
+
+	/* The first push starts writing right away, and we cork before it
+	 * finishes with the other two still queued.
+	 */
+	test_queued_output_stream_push_bytes(queued, test_bytes_data,
+			test_bytes_data_len, &done);
+	test_queued_output_stream_push_bytes(queued, test_bytes_data2,
+			test_bytes_data_len2, &done);
+	test_queued_output_stream_push_bytes(queued, test_bytes_data3,
+			test_bytes_data_len3, &done);
+	purple_queued_output_stream_cork(queued);
+
+	while (done > 2) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+
+	/* The write that was already out finishes, but nothing else may go out
+	 * until we uncork.
+	 */
+	while (g_main_context_iteration(NULL, FALSE));
+	g_assert_cmpint(done, ==, 2);
+	g_assert_cmpuint(output->writes->len, ==, 1);
+
+	purple_queued_output_stream_uncork(queued);
+
+	while (done > 0) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+
+	test_counting_output_stream_assert_writes(output, expected,
+			G_N_ELEMENTS(expected));
+
+	g_output_stream_close(G_OUTPUT_STREAM(queued), NULL, &err);
+	g_assert_no_error(err);
+
+	g_clear_object(&queued);
+	g_clear_object(&output);
+}
+
+static void
+test_queued_output_stream_max_batch_size(void) {
+	TestCountingOutputStream *output;
+	PurpleQueuedOutputStream *queued;
+	GError *err = NULL;
+	gint done = 3;
+	const gsize expected[] = {
+		test_bytes_data_len + test_bytes_data_len2,
+		test_bytes_data_len3,
+	};
+
+	output = g_object_new(TEST_TYPE_COUNTING_OUTPUT_STREAM, NULL);
+	queued = purple_queued_output_stream_new(G_OUTPUT_STREAM(output));
+
+	/* The third buffer doesn't fit with the first two, and is bigger than
+	 * the budget on its own, but still has to be written.
+	 */
+	purple_queued_output_stream_set_max_batch_size(queued, 10);
+	g_assert_cmpuint(purple_queued_output_stream_get_max_batch_size(queued),
+			==, 10);
+
+	purple_queued_output_stream_cork(queued);
+	test_queued_output_stream_push_bytes(queued, test_bytes_data,
+			test_bytes_data_len, &done);
+	test_queued_output_stream_push_bytes(queued, test_bytes_data2,
+			test_bytes_data_len2, &done);
+	test_queued_output_stream_push_bytes(queued, test_bytes_data3,
+			test_bytes_data_len3, &done);
+	purple_queued_output_stream_uncork(queued);
+
+	while (done > 0) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+
+	test_counting_output_stream_assert_writes(output, expected,
+			G_N_ELEMENTS(expected));
+
+	g_output_stream_close(G_OUTPUT_STREAM(queued), NULL, &err);
+	g_assert_no_error(err);
+
+	g_clear_object(&queued);
+	g_clear_object(&output);
+}
+
 /******************************************************************************
  * Main
  *****************************************************************************/
@@ -276,6 +571,14 @@ main(gint argc, gchar **argv) {
 			test_queued_output_stream_push_bytes_async_multiple);
 	g_test_add_func("/queued-output-stream/push-bytes-async-error",
 			test_queued_output_stream_push_bytes_async_error);
+	g_test_add_func("/queued-output-stream/coalesce",
+			test_queued_output_stream_coalesce);
+	g_test_add_func("/queued-output-stream/cork",
+			test_queued_output_stream_cork);
+	g_test_add_func("/queued-output-stream/cork-in-flight",
+			test_queued_output_stream_cork_in_flight);
+	g_test_add_func("/queued-output-stream/max-batch-size",
+			test_queued_output_stream_max_batch_size);
 
 	return g_test_run();
 }
@@ -0,0 +1,141 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <purple.h>
+
+#include "test_ui.h"
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static void
+test_purple_roomlist_items_changed_cb(G_GNUC_UNUSED GListModel *model,
+                                      G_GNUC_UNUSED guint position,
+                                      guint removed,
+                                      G_GNUC_UNUSED guint added,
+                                      gpointer data)
+{
+	guint *counter = data;
+
+	g_assert_cmpuint(removed, ==, 0);
+
+	*counter = *counter + 1;
+}
+
+static void
+test_purple_roomlist_add(PurpleRoomlist *list, const gchar *name,
+                         guint user_count)
+{
+	PurpleRoomlistRoom *room = purple_roomlist_room_new(name, NULL);
+
+	purple_roomlist_room_set_user_count(room, user_count);
+	purple_roomlist_room_add(list, room);
+	g_object_unref(room);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_purple_roomlist_batched(void) {
+	PurpleRoomlist *list = NULL;
+	PurpleRoomlistRoom *room = NULL;
+	guint counter = 0;
+	guint i;
+
+	list = purple_roomlist_new(NULL);
+	g_assert_true(G_IS_LIST_MODEL(list));
+	g_assert_true(g_list_model_get_item_type(G_LIST_MODEL(list)) ==
+	              PURPLE_TYPE_ROOMLIST_ROOM);
+
+	g_signal_connect(list, "items-changed",
+	                 G_CALLBACK(test_purple_roomlist_items_changed_cb),
+	                 &counter);
+
+	purple_roomlist_set_in_progress(list, TRUE);
+	for(i = 0; i < 1000; i++) {
+		gchar *name = g_strdup_printf("#room%u", i);
+
+		test_purple_roomlist_add(list, name, i);
+		g_free(name);
+	}
+
+	/* Nothing is announced until the batch is flushed. */
+	g_assert_cmpuint(counter, ==, 0);
+	g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(list)), ==, 0);
+
+	purple_roomlist_set_in_progress(list, FALSE);
+
+	g_assert_cmpuint(counter, ==, 1);
+	g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(list)), ==, 1000);
+
+	room = g_list_model_get_item(G_LIST_MODEL(list), 999);
+	g_assert_cmpstr(purple_roomlist_room_get_name(room), ==, "#room999");
+	g_clear_object(&room);
+
+	g_assert_null(g_list_model_get_item(G_LIST_MODEL(list), 1000));
+
+	g_clear_object(&list);
+}
+
+static void
+test_purple_roomlist_filter(void) {
+	PurpleRoomlist *list = NULL;
+	PurpleRoomlistRoom *room = NULL;
+
+	list = purple_roomlist_new(NULL);
+	purple_roomlist_set_filter(list, "#pidgin*");
+	purple_roomlist_set_min_users(list, 10);
+
+	purple_roomlist_set_in_progress(list, TRUE);
+	test_purple_roomlist_add(list, "#Pidgin", 20);
+	test_purple_roomlist_add(list, "#pidgin-dev", 5);
+	test_purple_roomlist_add(list, "#finch", 50);
+	test_purple_roomlist_add(list, "#pidgin-offtopic", 10);
+	purple_roomlist_set_in_progress(list, FALSE);
+
+	g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(list)), ==, 2);
+
+	room = g_list_model_get_item(G_LIST_MODEL(list), 0);
+	g_assert_cmpstr(purple_roomlist_room_get_name(room), ==, "#Pidgin");
+	g_clear_object(&room);
+
+	room = g_list_model_get_item(G_LIST_MODEL(list), 1);
+	g_assert_cmpstr(purple_roomlist_room_get_name(room), ==,
+	                "#pidgin-offtopic");
+	g_clear_object(&room);
+
+	g_clear_object(&list);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar *argv[]) {
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+
+	g_test_add_func("/roomlist/batched", test_purple_roomlist_batched);
+	g_test_add_func("/roomlist/filter", test_purple_roomlist_filter);
+
+	return g_test_run();
+}
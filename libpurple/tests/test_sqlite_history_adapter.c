@@ -0,0 +1,308 @@
+/*
+ * Purple - Internet Messaging Library
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <purple.h>
+
+#include "test_ui.h"
+
+#define PURPLE_GLOBAL_HEADER_INSIDE
+#include "../purpleprivate.h"
+#undef PURPLE_GLOBAL_HEADER_INSIDE
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static PurpleHistoryAdapter *
+test_sqlite_history_adapter_new(void) {
+	PurpleHistoryAdapter *adapter = NULL;
+	GError *error = NULL;
+	gboolean result = FALSE;
+
+	adapter = purple_sqlite_history_adapter_new(":memory:");
+	result = purple_history_adapter_activate(adapter, &error);
+	g_assert_no_error(error);
+	g_assert_true(result);
+
+	return adapter;
+}
+
+static void
+test_sqlite_history_adapter_free(PurpleHistoryAdapter *adapter) {
+	GError *error = NULL;
+	gboolean result = FALSE;
+
+	result = purple_history_adapter_deactivate(adapter, &error);
+	g_assert_no_error(error);
+	g_assert_true(result);
+
+	g_clear_object(&adapter);
+}
+
+static gchar *
+test_sqlite_history_adapter_timestamp(gint64 seconds) {
+	GDateTime *timestamp = g_date_time_new_from_unix_utc(seconds);
+	gchar *ret = g_date_time_format_iso8601(timestamp);
+
+	g_date_time_unref(timestamp);
+
+	return ret;
+}
+
+static void
+test_sqlite_history_adapter_write(PurpleHistoryAdapter *adapter,
+                                  PurpleConversation *conversation,
+                                  const gchar *id, const gchar *contents,
+                                  gint64 seconds)
+{
+	PurpleMessage *message = NULL;
+	GDateTime *timestamp = NULL;
+	GError *error = NULL;
+	gboolean result = FALSE;
+
+	timestamp = g_date_time_new_from_unix_utc(seconds);
+	message = g_object_new(PURPLE_TYPE_MESSAGE,
+	                       "id", id,
+	                       "author", "author",
+	                       "contents", contents,
+	                       "timestamp", timestamp,
+	                       NULL);
+	g_date_time_unref(timestamp);
+
+	result = purple_history_adapter_write(adapter, conversation, message,
+	                                      &error);
+	g_assert_no_error(error);
+	g_assert_true(result);
+
+	g_clear_object(&message);
+}
+
+/* Checks that query returns exactly the messages with the expected ids, in
+ * order. */
+static void
+test_sqlite_history_adapter_assert_query(PurpleHistoryAdapter *adapter,
+                                         const gchar *query,
+                                         const gchar * const *expected)
+{
+	GList *results = NULL;
+	GList *iter = NULL;
+	GError *error = NULL;
+	guint i = 0;
+
+	results = purple_history_adapter_query(adapter, query, &error);
+	g_assert_no_error(error);
+
+	for(iter = results; iter != NULL; iter = iter->next, i++) {
+		g_assert_nonnull(expected[i]);
+		g_assert_cmpstr(purple_message_get_id(iter->data), ==, expected[i]);
+	}
+	g_assert_null(expected[i]);
+
+	g_list_free_full(results, g_object_unref);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_sqlite_history_adapter_quote(void) {
+	gchar *quoted = NULL;
+
+	quoted = purple_history_query_quote("plain");
+	g_assert_cmpstr(quoted, ==, "\"plain\"");
+	g_free(quoted);
+
+	quoted = purple_history_query_quote("say \"hi\" \\o/");
+	g_assert_cmpstr(quoted, ==, "\"say \\\"hi\\\" \\\\o/\"");
+	g_free(quoted);
+}
+
+static void
+test_sqlite_history_adapter_query_quoted(void) {
+	PurpleHistoryAdapter *adapter = test_sqlite_history_adapter_new();
+	PurpleAccount *account = NULL;
+	PurpleConversation *spaced = NULL;
+	PurpleConversation *plain = NULL;
+	gchar *name = NULL;
+	gchar *query = NULL;
+
+	account = purple_account_new("test", "test");
+	spaced = purple_im_conversation_new(account, "Alice \"Al\" Smith");
+	plain = purple_im_conversation_new(account, "Alice");
+
+	test_sqlite_history_adapter_write(adapter, spaced, "1", "hello world", 100);
+	test_sqlite_history_adapter_write(adapter, spaced, "2",
+	                                  "hello there world", 200);
+	test_sqlite_history_adapter_write(adapter, plain, "3", "hi", 300);
+	test_sqlite_history_adapter_write(adapter, spaced, "4", "see in:Alice",
+	                                  400);
+
+	/* A quoted name with spaces and quotes matches only that
+	 * conversation. */
+	name = purple_history_query_quote("Alice \"Al\" Smith");
+	query = g_strdup_printf("in:%s", name);
+	test_sqlite_history_adapter_assert_query(adapter, query,
+	                                         (const gchar *[]){"1", "2", "4",
+	                                                           NULL});
+	g_free(query);
+
+	/* A quoted keyword is matched as a whole. */
+	query = g_strdup_printf("in:%s \"hello world\"", name);
+	test_sqlite_history_adapter_assert_query(adapter, query,
+	                                         (const gchar *[]){"1", NULL});
+	g_free(query);
+	g_free(name);
+
+	/* A term that looks like a filter is only a keyword when quoted. */
+	test_sqlite_history_adapter_assert_query(adapter, "in:Alice",
+	                                         (const gchar *[]){"3", NULL});
+	test_sqlite_history_adapter_assert_query(adapter, "\"in:Alice\"",
+	                                         (const gchar *[]){"4", NULL});
+
+	g_clear_object(&spaced);
+	g_clear_object(&plain);
+	g_clear_object(&account);
+	test_sqlite_history_adapter_free(adapter);
+}
+
+static void
+test_sqlite_history_adapter_query_account(void) {
+	PurpleHistoryAdapter *adapter = test_sqlite_history_adapter_new();
+	PurpleAccount *account1 = NULL;
+	PurpleAccount *account2 = NULL;
+	PurpleConversation *conversation1 = NULL;
+	PurpleConversation *conversation2 = NULL;
+	gchar *protocol = NULL;
+	gchar *query = NULL;
+
+	account1 = purple_account_new("test1", "test");
+	account2 = purple_account_new("test2", "test");
+	conversation1 = purple_im_conversation_new(account1, "bob");
+	conversation2 = purple_im_conversation_new(account2, "bob");
+
+	test_sqlite_history_adapter_write(adapter, conversation1, "1", "one", 100);
+	test_sqlite_history_adapter_write(adapter, conversation2, "2", "two", 200);
+
+	test_sqlite_history_adapter_assert_query(adapter, "in:bob",
+	                                         (const gchar *[]){"1", "2", NULL});
+	test_sqlite_history_adapter_assert_query(adapter, "in:bob account:test1",
+	                                         (const gchar *[]){"1", NULL});
+	test_sqlite_history_adapter_assert_query(adapter,
+	                                         "in:bob account:\"test2\"",
+	                                         (const gchar *[]){"2", NULL});
+
+	protocol = purple_history_query_quote(
+		purple_account_get_protocol_name(account1));
+	query = g_strdup_printf("in:bob protocol:%s", protocol);
+	test_sqlite_history_adapter_assert_query(adapter, query,
+	                                         (const gchar *[]){"1", "2", NULL});
+	g_free(query);
+	g_free(protocol);
+
+	test_sqlite_history_adapter_assert_query(adapter,
+	                                         "in:bob protocol:nothing",
+	                                         (const gchar *[]){NULL});
+
+	g_clear_object(&conversation1);
+	g_clear_object(&conversation2);
+	g_clear_object(&account1);
+	g_clear_object(&account2);
+	test_sqlite_history_adapter_free(adapter);
+}
+
+static void
+test_sqlite_history_adapter_query_paging(void) {
+	PurpleHistoryAdapter *adapter = test_sqlite_history_adapter_new();
+	PurpleAccount *account = NULL;
+	PurpleConversation *conversation = NULL;
+	gchar *before = NULL;
+	gchar *query = NULL;
+
+	account = purple_account_new("test", "test");
+	conversation = purple_im_conversation_new(account, "carol");
+
+	/* Written out of order, with two messages in the same second. */
+	test_sqlite_history_adapter_write(adapter, conversation, "m5", "5", 400);
+	test_sqlite_history_adapter_write(adapter, conversation, "m3", "3", 200);
+	test_sqlite_history_adapter_write(adapter, conversation, "m1", "1", 100);
+	test_sqlite_history_adapter_write(adapter, conversation, "m4", "4", 300);
+	test_sqlite_history_adapter_write(adapter, conversation, "m2", "2", 200);
+
+	/* limit: keeps the newest matches, still oldest first. */
+	test_sqlite_history_adapter_assert_query(adapter, "in:carol limit:2",
+	                                         (const gchar *[]){"m4", "m5",
+	                                                           NULL});
+
+	/* before: and before-id: page on from the oldest message of the last
+	 * page without skipping the one that shares its second. */
+	before = test_sqlite_history_adapter_timestamp(300);
+	query = g_strdup_printf("in:carol before:%s before-id:m4 limit:2",
+	                        before);
+	test_sqlite_history_adapter_assert_query(adapter, query,
+	                                         (const gchar *[]){"m2", "m3",
+	                                                           NULL});
+	g_free(query);
+	g_free(before);
+
+	before = test_sqlite_history_adapter_timestamp(200);
+	query = g_strdup_printf("in:carol before:%s before-id:m3 limit:2",
+	                        before);
+	test_sqlite_history_adapter_assert_query(adapter, query,
+	                                         (const gchar *[]){"m1", "m2",
+	                                                           NULL});
+	g_free(query);
+
+	query = g_strdup_printf("in:carol before:%s before-id:m2 limit:2",
+	                        before);
+	test_sqlite_history_adapter_assert_query(adapter, query,
+	                                         (const gchar *[]){"m1", NULL});
+	g_free(query);
+
+	/* before: alone is strict. */
+	query = g_strdup_printf("in:carol before:%s", before);
+	test_sqlite_history_adapter_assert_query(adapter, query,
+	                                         (const gchar *[]){"m1", NULL});
+	g_free(query);
+	g_free(before);
+
+	g_clear_object(&conversation);
+	g_clear_object(&account);
+	test_sqlite_history_adapter_free(adapter);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar *argv[]) {
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+
+	g_test_add_func("/sqlite-history-adapter/quote",
+	                test_sqlite_history_adapter_quote);
+	g_test_add_func("/sqlite-history-adapter/query/quoted",
+	                test_sqlite_history_adapter_query_quoted);
+	g_test_add_func("/sqlite-history-adapter/query/account",
+	                test_sqlite_history_adapter_query_account);
+	g_test_add_func("/sqlite-history-adapter/query/paging",
+	                test_sqlite_history_adapter_query_paging);
+
+	return g_test_run();
+}
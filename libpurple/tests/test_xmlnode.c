@@ -134,6 +134,28 @@ test_strip_prefixes(void) {
 	purple_xmlnode_free(xml);
 }
 
+static void
+test_xmlnode_insert_data_take(void) {
+	PurpleXmlNode *node;
+	char *data, *str;
+
+	node = purple_xmlnode_new("data");
+	data = g_strdup("aGVsbG8=");
+	purple_xmlnode_insert_data_take(node, data, strlen(data));
+
+	g_assert_true(node->child->data == data);
+
+	str = purple_xmlnode_get_data(node);
+	g_assert_cmpstr(str, ==, "aGVsbG8=");
+	g_free(str);
+
+	str = purple_xmlnode_to_str(node, NULL);
+	g_assert_cmpstr(str, ==, "<data>aGVsbG8=</data>");
+	g_free(str);
+
+	purple_xmlnode_free(node);
+}
+
 gint
 main(gint argc, gchar **argv) {
 	g_test_init(&argc, &argv, NULL);
@@ -144,6 +166,8 @@ main(gint argc, gchar **argv) {
 	                test_xmlnode_prefixes);
 	g_test_add_func("/xmlnode/strip_prefixes",
 	                test_strip_prefixes);
+	g_test_add_func("/xmlnode/insert_data_take",
+	                test_xmlnode_insert_data_take);
 
 	return g_test_run();
 }
@@ -114,6 +114,23 @@ purple_xmlnode_insert_data(PurpleXmlNode *node, const char *data, gssize size)
 	purple_xmlnode_insert_child(node, child);
 }
 
+void
+purple_xmlnode_insert_data_take(PurpleXmlNode *node, char *data, gsize size)
+{
+	PurpleXmlNode *child;
+
+	g_return_if_fail(node != NULL);
+	g_return_if_fail(data != NULL);
+	g_return_if_fail(size != 0);
+
+	child = new_node(NULL, PURPLE_XMLNODE_TYPE_DATA);
+
+	child->data = data;
+	child->data_sz = size;
+
+	purple_xmlnode_insert_child(node, child);
+}
+
 void
 purple_xmlnode_remove_attrib(PurpleXmlNode *node, const char *attr)
 {
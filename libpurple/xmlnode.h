@@ -166,6 +166,20 @@ PurpleXmlNode *purple_xmlnode_get_next_twin(PurpleXmlNode *node);
  */
 void purple_xmlnode_insert_data(PurpleXmlNode *node, const char *data, gssize size);
 
+/**
+ * purple_xmlnode_insert_data_take:
+ * @node: The node to insert data into.
+ * @data: (transfer full): The data to insert.
+ * @size: The size of @data.
+ *
+ * Inserts data into a node like purple_xmlnode_insert_data(), but takes
+ * ownership of @data instead of copying it.  This lets callers build large
+ * text content, like base64 payloads, in place.
+ *
+ * Since: 3.0.0
+ */
+void purple_xmlnode_insert_data_take(PurpleXmlNode *node, char *data, gsize size);
+
 /**
  * purple_xmlnode_get_data:
  * @node: The node to get data from.
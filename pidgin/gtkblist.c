@@ -41,6 +41,7 @@
 #include "pidgin/pidginactiongroup.h"
 #include "pidgin/pidginaddbuddydialog.h"
 #include "pidgin/pidginaddchatdialog.h"
+#include "pidgin/pidginavatarcache.h"
 #include "pidgin/pidgincontactlistwindow.h"
 #include "pidgin/pidgincore.h"
 #include "pidgin/pidgindebug.h"
@@ -1671,51 +1672,45 @@ gtk_blist_button_press_cb(GtkGestureClick *click, gint n_press, gdouble x,
 	return handled;
 }
 
-/* Altered from do_colorshift in gnome-panel */
+/* A tooltip that is up was built with the placeholder, or without an avatar
+ * at all for the unscaled ones, so it is queried again along with the row. */
 static void
-do_alphashift(GdkPixbuf *pixbuf, int shift)
+pidgin_blist_buddy_icon_ready_cb(gpointer data)
 {
-	gint i, j;
-	gint width, height, padding;
-	guchar *pixels;
-	int val;
-
-	if (!gdk_pixbuf_get_has_alpha(pixbuf))
-	  return;
-
-	width = gdk_pixbuf_get_width(pixbuf);
-	height = gdk_pixbuf_get_height(pixbuf);
-	padding = gdk_pixbuf_get_rowstride(pixbuf) - width * 4;
-	pixels = gdk_pixbuf_get_pixels(pixbuf);
-
-	for (i = 0; i < height; i++) {
-		for (j = 0; j < width; j++) {
-			pixels++;
-			pixels++;
-			pixels++;
-			val = *pixels - shift;
-			*(pixels++) = CLAMP(val, 0, 255);
-		}
-		pixels += padding;
+	PurpleBlistNode *node = g_weak_ref_get(data);
+
+	if (node != NULL) {
+		pidgin_blist_update(purple_blist_get_default(), node);
+		if (gtkblist != NULL && gtkblist->treeview != NULL)
+			gtk_widget_trigger_tooltip_query(gtkblist->treeview);
+		g_object_unref(node);
 	}
 }
 
+static void
+pidgin_blist_buddy_icon_ref_free(gpointer data)
+{
+	g_weak_ref_clear(data);
+	g_free(data);
+}
 
+/* Returns a placeholder while the icon is decoded and scaled in the
+ * background, the row is updated again once it is ready. Unscaled icons
+ * get NULL instead. */
 static GdkPixbuf *pidgin_blist_get_buddy_icon(PurpleBlistNode *node,
                                               gboolean scaled, gboolean greyed)
 {
-	gsize len;
 	PurpleBuddy *buddy = NULL;
 	PurpleGroup *group = NULL;
-	const guchar *data = NULL;
-	GdkPixbuf *buf, *ret = NULL;
+	GdkPixbuf *ret = NULL;
 	PurpleBuddyIcon *icon = NULL;
 	PurpleAccount *account = NULL;
 	PurpleMetaContact *contact = NULL;
-	PurpleImage *custom_img;
+	PurpleImage *custom_img, *img;
 	PurpleProtocol *protocol = NULL;
 	PurpleBuddyIconSpec *icon_spec = NULL;
-	gint orig_width, orig_height, scale_width, scale_height;
+	PidginAvatarCacheFlags flags = PIDGIN_AVATAR_CACHE_FLAGS_NONE;
+	GWeakRef *ref = NULL;
 
 	if (PURPLE_IS_META_CONTACT(node)) {
 		buddy = purple_meta_contact_get_priority_buddy((PurpleMetaContact*)node);
@@ -1750,39 +1745,22 @@ static GdkPixbuf *pidgin_blist_get_buddy_icon(PurpleBlistNode *node,
 		custom_img = purple_buddy_icons_node_find_custom_icon(node);
 	}
 
-	if (custom_img) {
-		data = purple_image_get_data(custom_img);
-		len = purple_image_get_data_size(custom_img);
-	}
+	img = custom_img;
 
-	if (data == NULL) {
+	if (img == NULL) {
 		if (buddy) {
 			/* Not sure I like this...*/
 			if (!(icon = purple_buddy_icons_find(purple_buddy_get_account(buddy), purple_buddy_get_name(buddy))))
 				return NULL;
-			data = purple_buddy_icon_get_data(icon, &len);
+			img = purple_buddy_icon_get_image(icon);
 		}
 
-		if(data == NULL)
+		if (img == NULL) {
+			purple_buddy_icon_unref(icon);
 			return NULL;
+		}
 	}
 
-	buf = purple_gdk_pixbuf_from_data(data, len);
-	purple_buddy_icon_unref(icon);
-	if (!buf) {
-		purple_debug_warning("gtkblist", "Couldn't load buddy icon on "
-			"account %s (%s); buddyname=%s; custom_img_size=%" G_GSIZE_FORMAT,
-			account ? purple_account_get_username(account) : "(no account)",
-			account ? purple_account_get_protocol_id(account) : "(no account)",
-			buddy ? purple_buddy_get_name(buddy) : "(no buddy)",
-			custom_img ? purple_image_get_data_size(custom_img) : 0);
-		if (custom_img)
-			g_object_unref(custom_img);
-		return NULL;
-	}
-	if (custom_img)
-		g_object_unref(custom_img);
-
 	if (greyed) {
 		gboolean offline = FALSE, idle = FALSE;
 
@@ -1792,58 +1770,39 @@ static GdkPixbuf *pidgin_blist_get_buddy_icon(PurpleBlistNode *node,
 				offline = TRUE;
 			if (purple_presence_is_idle(presence))
 				idle = TRUE;
+
+			/* Buddies are faded out as well as greyed. */
+			if (offline || idle)
+				flags |= PIDGIN_AVATAR_CACHE_FLAGS_FADED;
 		} else if (group) {
 			if (purple_counting_node_get_online_count(PURPLE_COUNTING_NODE(group)) == 0)
 				offline = TRUE;
 		}
 
 		if (offline)
-			gdk_pixbuf_saturate_and_pixelate(buf, buf, 0.0, FALSE);
+			flags |= PIDGIN_AVATAR_CACHE_FLAGS_OFFLINE;
 
 		if (idle)
-			gdk_pixbuf_saturate_and_pixelate(buf, buf, 0.25, FALSE);
+			flags |= PIDGIN_AVATAR_CACHE_FLAGS_IDLE;
 	}
 
-	/* I'd use the pidgin_buddy_icon_get_scale_size() thing, but it won't
-	 * tell me the original size, which I need for scaling purposes. */
-	scale_width = orig_width = gdk_pixbuf_get_width(buf);
-	scale_height = orig_height = gdk_pixbuf_get_height(buf);
+	/* Unscaled icons are only shrunk if they are bigger than 200px. */
+	if (!scaled)
+		flags |= PIDGIN_AVATAR_CACHE_FLAGS_SHRINK_ONLY;
 
 	if (protocol)
 		icon_spec = purple_protocol_get_icon_spec(protocol);
 
-	if (icon_spec && (icon_spec->scale_rules & PURPLE_ICON_SCALE_DISPLAY)) {
-		purple_buddy_icon_spec_get_scaled_size(icon_spec, &scale_width,
-		                                       &scale_height);
-	}
+	ref = g_new(GWeakRef, 1);
+	g_weak_ref_init(ref, node);
 
-	purple_buddy_icon_spec_free(icon_spec);
+	ret = pidgin_avatar_cache_lookup(img, scaled ? 32 : 200, icon_spec, flags,
+	                                 pidgin_blist_buddy_icon_ready_cb, ref,
+	                                 pidgin_blist_buddy_icon_ref_free);
 
-	if (scaled || scale_height > 200 || scale_width > 200) {
-		GdkPixbuf *tmpbuf;
-		float scale_size = scaled ? 32.0 : 200.0;
-		if(scale_height > scale_width) {
-			scale_width = scale_size * (double)scale_width / (double)scale_height;
-			scale_height = scale_size;
-		} else {
-			scale_height = scale_size * (double)scale_height / (double)scale_width;
-			scale_width = scale_size;
-		}
-		/* Scale & round before making square, so rectangular (but
-		 * non-square) images get rounded corners too. */
-		tmpbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, scale_width, scale_height);
-		gdk_pixbuf_fill(tmpbuf, 0x00000000);
-		gdk_pixbuf_scale(buf, tmpbuf, 0, 0, scale_width, scale_height, 0, 0, (double)scale_width/(double)orig_width, (double)scale_height/(double)orig_height, GDK_INTERP_BILINEAR);
-		if (purple_gdk_pixbuf_is_opaque(tmpbuf))
-			purple_gdk_pixbuf_make_round(tmpbuf);
-		ret = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, scale_size, scale_size);
-		gdk_pixbuf_fill(ret, 0x00000000);
-		gdk_pixbuf_copy_area(tmpbuf, 0, 0, scale_width, scale_height, ret, (scale_size-scale_width)/2, (scale_size-scale_height)/2);
-		g_object_unref(G_OBJECT(tmpbuf));
-	} else {
-		ret = gdk_pixbuf_scale_simple(buf,scale_width,scale_height, GDK_INTERP_BILINEAR);
-	}
-	g_object_unref(G_OBJECT(buf));
+	purple_buddy_icon_spec_free(icon_spec);
+	purple_buddy_icon_unref(icon);
+	g_clear_object(&custom_img);
 
 	return ret;
 }
@@ -3435,7 +3394,6 @@ static char *pidgin_get_group_title(PurpleBlistNode *gnode, gboolean expanded)
 
 static void buddy_node(PurpleBuddy *buddy, GtkTreeIter *iter, PurpleBlistNode *node)
 {
-	PurplePresence *presence = purple_buddy_get_presence(buddy);
 	PurpleProtocol *protocol = NULL;
 	GdkPixbuf *avatar, *emblem;
 	char *mark;
@@ -3450,12 +3408,6 @@ static void buddy_node(PurpleBuddy *buddy, GtkTreeIter *iter, PurpleBlistNode *n
 	status_icon_name = pidgin_blist_get_status_icon_name(PURPLE_BLIST_NODE(buddy));
 	avatar = pidgin_blist_get_buddy_icon(PURPLE_BLIST_NODE(buddy), TRUE, TRUE);
 
-	if(avatar != NULL) {
-		if(!PURPLE_BUDDY_IS_ONLINE(buddy) || purple_presence_is_idle(presence)) {
-			do_alphashift(avatar, 77);
-		}
-	}
-
 	emblem = pidgin_blist_get_emblem(PURPLE_BLIST_NODE(buddy));
 	mark = pidgin_blist_get_name_markup(buddy, selected, TRUE);
 
@@ -3852,6 +3804,9 @@ void
 pidgin_blist_uninit(void) {
 	g_hash_table_destroy(cached_emblems);
 
+	/* We're the only user of the avatar cache, so let its pixbufs go. */
+	pidgin_avatar_cache_clear();
+
 	purple_signals_unregister_by_instance(pidgin_blist_get_handle());
 	purple_signals_disconnect_by_handle(pidgin_blist_get_handle());
 
@@ -73,6 +73,9 @@ typedef enum
 /* Prototypes. <-- because Paco-Paco hates this comment. */
 static void got_typing_keypress(PidginConversation *gtkconv, gboolean first);
 static void add_chat_user_common(PurpleChatConversation *chat, PurpleChatUser *cb, const char *old_name);
+static void pidgin_conv_scrollback_value_changed_cb(GtkAdjustment *adjustment, gpointer data);
+static PidginConvScrollback *pidgin_conv_scrollback_new(void);
+static void pidgin_conv_scrollback_free(PidginConvScrollback *scrollback);
 static void pidgin_conv_updated(PurpleConversation *conv, PurpleConversationUpdateType type);
 static void update_typing_icon(PidginConversation *gtkconv);
 gboolean pidgin_conv_has_focus(PurpleConversation *conv);
@@ -320,6 +323,7 @@ chat_do_im(PidginConversation *gtkconv, const char *who)
 }
 
 static void pidgin_conv_chat_update_user(PurpleChatUser *chatuser);
+static void pidgin_conv_cancel_updates(PurpleConversation *conv);
 
 static gchar *
 menu_chat_get_selected_username(PidginConversation *gtkconv) {
@@ -1543,6 +1547,11 @@ setup_common_pane(PidginConversation *gtkconv)
 	gtkconv->history = talkatu_history_new();
 	gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(sw), gtkconv->history);
 
+	gtkconv->scrollback = pidgin_conv_scrollback_new();
+	g_signal_connect(gtkconv->vadjustment, "value-changed",
+	                 G_CALLBACK(pidgin_conv_scrollback_value_changed_cb),
+	                 gtkconv);
+
 	/* Add the topic */
 	setup_chat_topic(gtkconv, vbox);
 
@@ -1733,6 +1742,8 @@ pidgin_conv_destroy(PurpleConversation *conv)
 	PidginConversation *gtkconv = PIDGIN_CONVERSATION(conv);
 	GtkRoot *win = NULL;
 
+	pidgin_conv_cancel_updates(conv);
+
 	gtkconv->convs = g_list_remove(gtkconv->convs, conv);
 	/* Don't destroy ourselves until all our convos are gone */
 	if (gtkconv->convs) {
@@ -1760,7 +1771,9 @@ pidgin_conv_destroy(PurpleConversation *conv)
 		purple_signals_disconnect_by_handle(gtkconv);
 	}
 
+	g_signal_handlers_disconnect_by_data(gtkconv->vadjustment, gtkconv);
 	g_clear_object(&gtkconv->vadjustment);
+	g_clear_pointer(&gtkconv->scrollback, pidgin_conv_scrollback_free);
 
 	gtkconv->send_history = g_list_first(gtkconv->send_history);
 	g_list_free_full(gtkconv->send_history, g_free);
@@ -1796,10 +1809,351 @@ writing_msg(PurpleConversation *conv, PurpleMessage *msg, gpointer _unused)
 	return TRUE;
 }
 
+/**************************************************************************
+ * Scrollback
+ **************************************************************************/
+/* Compare two PurpleMessages, according to time in ascending order. */
+static int
+message_compare(PurpleMessage *m1, PurpleMessage *m2)
+{
+	GDateTime *dt1 = purple_message_get_timestamp(m1);
+	GDateTime *dt2 = purple_message_get_timestamp(m2);
+
+	return g_date_time_compare(dt1, dt2);
+}
+
+/* Rough per-message cost of the text, tags and marks in the history buffer on
+ * top of the message's own strings. */
+#define SCROLLBACK_MESSAGE_OVERHEAD 256
+
+/* How many older messages to page in from the history adapter at once. */
+#define SCROLLBACK_PAGE_SIZE 50
+
+typedef struct {
+	PurpleMessage *message;
+	/* Where the message starts in the history buffer. */
+	GtkTextMark *mark;
+	gsize size;
+} PidginConvScrollbackEntry;
+
+/* A ring of the messages shown in a conversation's history, oldest first.
+ * New messages evict the oldest ones once the window holds more than
+ * max_messages or max_bytes. Scrolling to the top pages older messages back
+ * in from the history adapter until the ring is full, which is twice the
+ * window, so the memory used stays bounded either way. */
+struct _PidginConvScrollback {
+	PidginConvScrollbackEntry *entries;
+	guint capacity;
+	guint head;
+	guint length;
+
+	guint max_messages;
+	gsize max_bytes;
+	gsize bytes;
+
+	/* The history adapter has nothing older than the oldest entry. */
+	gboolean exhausted;
+	gboolean paging;
+};
+
+static PidginConvScrollback *
+pidgin_conv_scrollback_new(void)
+{
+	PidginConvScrollback *scrollback = g_new0(PidginConvScrollback, 1);
+	gint lines = purple_prefs_get_int(PIDGIN_PREFS_ROOT "/conversations/scrollback_lines");
+	gint kbytes = purple_prefs_get_int(PIDGIN_PREFS_ROOT "/conversations/scrollback_kbytes");
+
+	scrollback->max_messages = lines > 0 ? (guint)lines : 4000;
+	scrollback->max_bytes = kbytes > 0 ? (gsize)kbytes * 1024 : 4 * 1024 * 1024;
+	scrollback->capacity = scrollback->max_messages * 2;
+	scrollback->entries = g_new0(PidginConvScrollbackEntry, scrollback->capacity);
+
+	return scrollback;
+}
+
+static PidginConvScrollbackEntry *
+pidgin_conv_scrollback_nth(PidginConvScrollback *scrollback, guint n)
+{
+	return &scrollback->entries[(scrollback->head + n) % scrollback->capacity];
+}
+
 static void
-pidgin_conv_write_conv(PurpleConversation *conv, PurpleMessage *pmsg)
+pidgin_conv_scrollback_clear_entry(PidginConvScrollback *scrollback,
+                                   PidginConvScrollbackEntry *entry)
+{
+	if(entry->mark != NULL) {
+		gtk_text_buffer_delete_mark(gtk_text_mark_get_buffer(entry->mark),
+		                            entry->mark);
+		entry->mark = NULL;
+	}
+
+	scrollback->bytes -= entry->size;
+	g_clear_object(&entry->message);
+	entry->size = 0;
+}
+
+static void
+pidgin_conv_scrollback_free(PidginConvScrollback *scrollback)
+{
+	while(scrollback->length > 0) {
+		pidgin_conv_scrollback_clear_entry(scrollback,
+			pidgin_conv_scrollback_nth(scrollback, --scrollback->length));
+	}
+
+	g_free(scrollback->entries);
+	g_free(scrollback);
+}
+
+static gsize
+pidgin_conv_scrollback_message_size(PurpleMessage *message)
 {
+	const gchar *contents = purple_message_get_contents(message);
+	const gchar *author = purple_message_get_author(message);
+	const gchar *alias = purple_message_get_author_alias(message);
+
+	/* The history buffer holds a rendered copy of the contents too. */
+	return SCROLLBACK_MESSAGE_OVERHEAD + 2 * (contents ? strlen(contents) : 0) +
+	       (author ? strlen(author) : 0) + (alias ? strlen(alias) : 0);
+}
+
+/* Writes a message at the end of the history and remembers where it starts. */
+static void
+pidgin_conv_scrollback_write(PidginConversation *gtkconv,
+                             PidginConvScrollbackEntry *entry)
+{
+	GtkTextBuffer *buffer = NULL;
+	GtkTextIter end;
 	PidginMessage *pidgin_msg = NULL;
+
+	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(gtkconv->history));
+	gtk_text_buffer_get_end_iter(buffer, &end);
+	entry->mark = gtk_text_buffer_create_mark(buffer, NULL, &end, TRUE);
+
+	pidgin_msg = pidgin_message_new(entry->message);
+	talkatu_history_write_message(TALKATU_HISTORY(gtkconv->history),
+	                              TALKATU_MESSAGE(pidgin_msg));
+}
+
+/* Drops the oldest message from the ring and from the history buffer. */
+static void
+pidgin_conv_scrollback_evict(PidginConversation *gtkconv)
+{
+	PidginConvScrollback *scrollback = gtkconv->scrollback;
+	PidginConvScrollbackEntry *oldest = NULL;
+	GtkTextBuffer *buffer = NULL;
+	GtkTextIter start, end;
+
+	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(gtkconv->history));
+	gtk_text_buffer_get_start_iter(buffer, &start);
+	if(scrollback->length > 1) {
+		PidginConvScrollbackEntry *next = pidgin_conv_scrollback_nth(scrollback, 1);
+
+		gtk_text_buffer_get_iter_at_mark(buffer, &end, next->mark);
+	} else {
+		gtk_text_buffer_get_end_iter(buffer, &end);
+	}
+	gtk_text_buffer_delete(buffer, &start, &end);
+
+	oldest = pidgin_conv_scrollback_nth(scrollback, 0);
+	pidgin_conv_scrollback_clear_entry(scrollback, oldest);
+	scrollback->head = (scrollback->head + 1) % scrollback->capacity;
+	scrollback->length--;
+
+	/* Whatever was just dropped can be paged back in. */
+	scrollback->exhausted = FALSE;
+}
+
+static void
+pidgin_conv_scrollback_append(PidginConversation *gtkconv,
+                              PurpleMessage *message)
+{
+	PidginConvScrollback *scrollback = gtkconv->scrollback;
+	PidginConvScrollbackEntry *entry = NULL;
+
+	if(scrollback->length == scrollback->capacity) {
+		pidgin_conv_scrollback_evict(gtkconv);
+	}
+
+	entry = pidgin_conv_scrollback_nth(scrollback, scrollback->length++);
+	entry->message = g_object_ref(message);
+	entry->size = pidgin_conv_scrollback_message_size(message);
+	scrollback->bytes += entry->size;
+
+	pidgin_conv_scrollback_write(gtkconv, entry);
+
+	while(scrollback->length > 1 &&
+	      (scrollback->length > scrollback->max_messages ||
+	       scrollback->bytes > scrollback->max_bytes))
+	{
+		pidgin_conv_scrollback_evict(gtkconv);
+	}
+}
+
+/* Loads the page of at most max messages that come right before the oldest
+ * one we have from the history adapter, oldest first. */
+static GList *
+pidgin_conv_scrollback_query_older(PidginConversation *gtkconv, guint max)
+{
+	PidginConvScrollback *scrollback = gtkconv->scrollback;
+	PurpleConversation *conv = gtkconv->active_conv;
+	PurpleAccount *account = purple_conversation_get_account(conv);
+	PurpleHistoryManager *manager = NULL;
+	PurpleMessage *oldest = NULL;
+	GList *results = NULL;
+	GError *error = NULL;
+	GString *query = NULL;
+	const gchar *id = NULL;
+	gchar *before = NULL;
+	gchar *quoted = NULL;
+
+	oldest = pidgin_conv_scrollback_nth(scrollback, 0)->message;
+	before = g_date_time_format_iso8601(purple_message_get_timestamp(oldest));
+	id = purple_message_get_id(oldest);
+
+	/* The name is quoted as it may have spaces, and the account and
+	 * protocol keep other accounts' conversations with the same name out.
+	 */
+	query = g_string_new(NULL);
+	quoted = purple_history_query_quote(purple_conversation_get_name(conv));
+	g_string_append_printf(query, "in:%s", quoted);
+	g_free(quoted);
+	quoted = purple_history_query_quote(purple_account_get_username(account));
+	g_string_append_printf(query, " account:%s", quoted);
+	g_free(quoted);
+	quoted = purple_history_query_quote(
+		purple_account_get_protocol_name(account));
+	g_string_append_printf(query, " protocol:%s", quoted);
+	g_free(quoted);
+	g_string_append_printf(query, " before:%s limit:%u", before, max);
+	g_free(before);
+
+	/* The id breaks ties, so messages sharing the oldest one's timestamp
+	 * aren't skipped. Without one, all we can do is page strictly before
+	 * it. */
+	if(id != NULL) {
+		quoted = purple_history_query_quote(id);
+		g_string_append_printf(query, " before-id:%s", quoted);
+		g_free(quoted);
+	}
+
+	manager = purple_history_manager_get_default();
+	results = purple_history_manager_query(manager, query->str, &error);
+	g_string_free(query, TRUE);
+
+	if(error != NULL) {
+		purple_debug_warning("gtkconv", "failed to page in history: %s",
+		                     error->message);
+		g_clear_error(&error);
+	}
+
+	/* Never hand back more than fits in the ring, even if the adapter
+	 * ignored the limit. */
+	for(guint length = g_list_length(results); length > max; length--) {
+		g_object_unref(results->data);
+		results = g_list_delete_link(results, results);
+	}
+
+	return results;
+}
+
+/* Rebuilds the history with a page of older messages in front of what is
+ * already shown, keeping the previously oldest message in view. */
+static void
+pidgin_conv_scrollback_page_in(PidginConversation *gtkconv)
+{
+	PidginConvScrollback *scrollback = gtkconv->scrollback;
+	GtkTextBuffer *buffer = NULL;
+	GList *older = NULL;
+	guint room = 0, count = 0, i = 0;
+
+	if(scrollback->length == 0 || scrollback->exhausted || scrollback->paging) {
+		return;
+	}
+
+	room = MIN(scrollback->capacity - scrollback->length, SCROLLBACK_PAGE_SIZE);
+	if(room == 0 || scrollback->bytes >= 2 * scrollback->max_bytes) {
+		return;
+	}
+
+	older = pidgin_conv_scrollback_query_older(gtkconv, room);
+	if(older == NULL) {
+		scrollback->exhausted = TRUE;
+		return;
+	}
+
+	scrollback->paging = TRUE;
+
+	buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(gtkconv->history));
+	for(i = 0; i < scrollback->length; i++) {
+		PidginConvScrollbackEntry *entry = pidgin_conv_scrollback_nth(scrollback, i);
+
+		gtk_text_buffer_delete_mark(buffer, entry->mark);
+		entry->mark = NULL;
+	}
+	talkatu_buffer_clear(TALKATU_BUFFER(buffer));
+
+	count = g_list_length(older);
+	scrollback->head = (scrollback->head + scrollback->capacity - count) %
+	                   scrollback->capacity;
+	scrollback->length += count;
+
+	for(i = 0; older != NULL; i++, older = g_list_delete_link(older, older)) {
+		PidginConvScrollbackEntry *entry = pidgin_conv_scrollback_nth(scrollback, i);
+
+		entry->message = older->data;
+		entry->size = pidgin_conv_scrollback_message_size(entry->message);
+		scrollback->bytes += entry->size;
+	}
+
+	for(i = 0; i < scrollback->length; i++) {
+		pidgin_conv_scrollback_write(gtkconv,
+			pidgin_conv_scrollback_nth(scrollback, i));
+	}
+
+	gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(gtkconv->history),
+		pidgin_conv_scrollback_nth(scrollback, count)->mark, 0.0, TRUE,
+		0.0, 0.0);
+
+	scrollback->paging = FALSE;
+}
+
+static void
+pidgin_conv_scrollback_value_changed_cb(GtkAdjustment *adjustment,
+                                        gpointer data)
+{
+	PidginConversation *gtkconv = data;
+
+	/* Only page in when the user actually scrolled to the top. */
+	if(gtk_adjustment_get_upper(adjustment) <=
+	   gtk_adjustment_get_page_size(adjustment))
+	{
+		return;
+	}
+
+	if(gtk_adjustment_get_value(adjustment) <= gtk_adjustment_get_lower(adjustment)) {
+		pidgin_conv_scrollback_page_in(gtkconv);
+	}
+}
+
+guint
+pidgin_conv_get_scrollback_length(PidginConversation *gtkconv)
+{
+	g_return_val_if_fail(gtkconv != NULL, 0);
+
+	return gtkconv->scrollback->length;
+}
+
+gsize
+pidgin_conv_get_scrollback_size(PidginConversation *gtkconv)
+{
+	g_return_val_if_fail(gtkconv != NULL, 0);
+
+	return gtkconv->scrollback->bytes;
+}
+
+static void
+pidgin_conv_write_conv(PurpleConversation *conv, PurpleMessage *pmsg)
+{
 	PurpleMessageFlags flags;
 	PidginConversation *gtkconv;
 	PurpleConnection *gc;
@@ -1825,11 +2179,7 @@ pidgin_conv_write_conv(PurpleConversation *conv, PurpleMessage *pmsg)
 		return;
 	}
 
-	pidgin_msg = pidgin_message_new(pmsg);
-	talkatu_history_write_message(
-		TALKATU_HISTORY(gtkconv->history),
-		TALKATU_MESSAGE(pidgin_msg)
-	);
+	pidgin_conv_scrollback_append(gtkconv, pmsg);
 
 	purple_signal_emit(pidgin_conversations_get_handle(),
 		(PURPLE_IS_IM_CONVERSATION(conv) ? "displayed-im-msg" : "displayed-chat-msg"),
@@ -2123,6 +2473,201 @@ pidgin_conv_update_fields(PurpleConversation *conv, PidginConvFields fields)
 	}
 }
 
+/**************************************************************************
+ * Update coalescing
+ **************************************************************************/
+/* Presence, typing and chat user changes tend to come in storms, after a
+ * network blip for example. Rather than redoing the widgets for every signal
+ * we collect what is dirty and apply it once per frame. */
+static GHashTable *pending_conv_updates = NULL; /* PurpleConversation -> fields */
+static GHashTable *pending_user_updates = NULL; /* PurpleChatUser set */
+static GHashTable *update_ticks = NULL; /* GtkWidget -> tick callback id */
+static guint update_idle_id = 0;
+static guint64 merged_updates = 0;
+
+static void pidgin_conv_schedule_updates(GtkWidget *widget);
+
+static void
+pidgin_conv_flush_updates(void)
+{
+	GHashTable *convs = pending_conv_updates;
+	GHashTable *users = pending_user_updates;
+	GHashTableIter iter;
+	gpointer key, value;
+
+	/* Anything queued while flushing goes into the next frame. */
+	pending_conv_updates = NULL;
+	pending_user_updates = NULL;
+
+	if(convs != NULL) {
+		g_hash_table_iter_init(&iter, convs);
+		while(g_hash_table_iter_next(&iter, &key, &value)) {
+			pidgin_conv_update_fields(key, GPOINTER_TO_UINT(value));
+		}
+		g_hash_table_destroy(convs);
+	}
+
+	if(users != NULL) {
+		g_hash_table_iter_init(&iter, users);
+		while(g_hash_table_iter_next(&iter, &key, NULL)) {
+			PurpleChatUser *chatuser = key;
+			PurpleChatConversation *chat = purple_chat_user_get_chat(chatuser);
+
+			/* Skip users that left while the update was pending. */
+			if(chat == NULL ||
+			   purple_chat_conversation_find_user(chat,
+			        purple_chat_user_get_name(chatuser)) != chatuser)
+			{
+				continue;
+			}
+
+			pidgin_conv_chat_update_user(chatuser);
+		}
+		g_hash_table_destroy(users);
+	}
+}
+
+static gboolean
+pidgin_conv_updates_tick_cb(GtkWidget *widget, GdkFrameClock *clock,
+                            gpointer data)
+{
+	pidgin_conv_flush_updates();
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+pidgin_conv_updates_tick_destroyed(gpointer data)
+{
+	if(update_ticks != NULL) {
+		g_hash_table_remove(update_ticks, data);
+	}
+
+	/* The widget went away before its next frame, don't lose the updates. */
+	if(pending_conv_updates != NULL || pending_user_updates != NULL) {
+		pidgin_conv_schedule_updates(NULL);
+	}
+}
+
+static gboolean
+pidgin_conv_updates_idle_cb(gpointer data)
+{
+	update_idle_id = 0;
+	pidgin_conv_flush_updates();
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+pidgin_conv_schedule_updates(GtkWidget *widget)
+{
+	guint id = 0;
+
+	/* Line up with the frame clock of the window that changed when it is
+	 * drawing, otherwise nothing is on screen and an idle is just as good.
+	 * Every window gets its own tick, so one that isn't drawing can't hold
+	 * up the others; whichever runs first flushes everything. */
+	if(widget == NULL || !gtk_widget_get_mapped(widget)) {
+		if(update_idle_id == 0) {
+			update_idle_id = g_idle_add(pidgin_conv_updates_idle_cb, NULL);
+		}
+
+		return;
+	}
+
+	if(update_ticks == NULL) {
+		update_ticks = g_hash_table_new(g_direct_hash, g_direct_equal);
+	} else if(g_hash_table_contains(update_ticks, widget)) {
+		return;
+	}
+
+	id = gtk_widget_add_tick_callback(widget, pidgin_conv_updates_tick_cb,
+	                                  widget,
+	                                  pidgin_conv_updates_tick_destroyed);
+	g_hash_table_insert(update_ticks, widget, GUINT_TO_POINTER(id));
+}
+
+static void
+pidgin_conv_queue_update(PurpleConversation *conv, PidginConvFields fields)
+{
+	PidginConversation *gtkconv = PIDGIN_CONVERSATION(conv);
+	gpointer value = NULL;
+
+	if(gtkconv == NULL || fields == 0) {
+		return;
+	}
+
+	if(pending_conv_updates == NULL) {
+		pending_conv_updates = g_hash_table_new(g_direct_hash, g_direct_equal);
+	}
+
+	if(g_hash_table_lookup_extended(pending_conv_updates, conv, NULL, &value)) {
+		fields |= GPOINTER_TO_UINT(value);
+		merged_updates++;
+	}
+	g_hash_table_insert(pending_conv_updates, conv, GUINT_TO_POINTER(fields));
+
+	pidgin_conv_schedule_updates(GTK_WIDGET(gtk_widget_get_root(gtkconv->tab_cont)));
+}
+
+static void
+pidgin_conv_chat_queue_update_user(PurpleChatUser *chatuser)
+{
+	PurpleConversation *conv = NULL;
+	PidginConversation *gtkconv = NULL;
+
+	if(chatuser == NULL) {
+		return;
+	}
+
+	conv = PURPLE_CONVERSATION(purple_chat_user_get_chat(chatuser));
+	gtkconv = PIDGIN_CONVERSATION(conv);
+	if(gtkconv == NULL) {
+		return;
+	}
+
+	if(pending_user_updates == NULL) {
+		pending_user_updates = g_hash_table_new_full(g_direct_hash,
+		                                             g_direct_equal,
+		                                             g_object_unref, NULL);
+	}
+
+	if(g_hash_table_contains(pending_user_updates, chatuser)) {
+		merged_updates++;
+	} else {
+		g_hash_table_add(pending_user_updates, g_object_ref(chatuser));
+	}
+
+	pidgin_conv_schedule_updates(GTK_WIDGET(gtk_widget_get_root(gtkconv->tab_cont)));
+}
+
+/* Drops whatever is still pending for a conversation that is going away. */
+static void
+pidgin_conv_cancel_updates(PurpleConversation *conv)
+{
+	if(pending_conv_updates != NULL) {
+		g_hash_table_remove(pending_conv_updates, conv);
+	}
+
+	if(pending_user_updates != NULL && PURPLE_IS_CHAT_CONVERSATION(conv)) {
+		GHashTableIter iter;
+		gpointer key;
+
+		g_hash_table_iter_init(&iter, pending_user_updates);
+		while(g_hash_table_iter_next(&iter, &key, NULL)) {
+			if(PURPLE_CONVERSATION(purple_chat_user_get_chat(key)) == conv) {
+				g_hash_table_iter_remove(&iter);
+			}
+		}
+	}
+}
+
+guint64
+pidgin_conversations_get_merged_updates(void)
+{
+	return merged_updates;
+}
+
 static void
 pidgin_conv_updated(PurpleConversation *conv, PurpleConversationUpdateType type)
 {
@@ -2168,7 +2713,7 @@ pidgin_conv_updated(PurpleConversation *conv, PurpleConversationUpdateType type)
 		flags = PIDGIN_CONV_MENU;
 	}
 
-	pidgin_conv_update_fields(conv, flags);
+	pidgin_conv_queue_update(conv, flags);
 }
 
 static PurpleConversationUiOps conversation_ui_ops =
@@ -2179,7 +2724,7 @@ static PurpleConversationUiOps conversation_ui_ops =
 	.chat_add_users = pidgin_conv_chat_add_users,
 	.chat_rename_user = pidgin_conv_chat_rename_user,
 	.chat_remove_users = pidgin_conv_chat_remove_users,
-	.chat_update_user = pidgin_conv_chat_update_user,
+	.chat_update_user = pidgin_conv_chat_queue_update_user,
 	.has_focus = pidgin_conv_has_focus,
 };
 
@@ -2335,11 +2880,11 @@ update_buddy_status_changed(PurpleBuddy *buddy, PurpleStatus *old, PurpleStatus
 	if (gtkconv)
 	{
 		conv = gtkconv->active_conv;
-		pidgin_conv_update_fields(conv, PIDGIN_CONV_TAB_ICON
-		                              | PIDGIN_CONV_COLORIZE_TITLE
-		                              | PIDGIN_CONV_BUDDY_ICON);
+		pidgin_conv_queue_update(conv, PIDGIN_CONV_TAB_ICON
+		                             | PIDGIN_CONV_COLORIZE_TITLE
+		                             | PIDGIN_CONV_BUDDY_ICON);
 		if ((purple_status_is_online(old) ^ purple_status_is_online(newstatus)) != 0)
-			pidgin_conv_update_fields(conv, PIDGIN_CONV_MENU);
+			pidgin_conv_queue_update(conv, PIDGIN_CONV_MENU);
 	}
 }
 
@@ -2352,7 +2897,7 @@ update_buddy_privacy_changed(PurpleBuddy *buddy)
 	gtkconv = get_gtkconv_with_contact(purple_buddy_get_contact(buddy));
 	if (gtkconv) {
 		conv = gtkconv->active_conv;
-		pidgin_conv_update_fields(conv, PIDGIN_CONV_TAB_ICON | PIDGIN_CONV_MENU);
+		pidgin_conv_queue_update(conv, PIDGIN_CONV_TAB_ICON | PIDGIN_CONV_MENU);
 	}
 }
 
@@ -2367,7 +2912,7 @@ update_buddy_idle_changed(PurpleBuddy *buddy, gboolean old, gboolean newidle)
 	                                         purple_buddy_get_account(buddy),
 	                                         purple_buddy_get_name(buddy));
 	if(PURPLE_IS_IM_CONVERSATION(im)) {
-		pidgin_conv_update_fields(im, PIDGIN_CONV_TAB_ICON);
+		pidgin_conv_queue_update(im, PIDGIN_CONV_TAB_ICON);
 	}
 }
 
@@ -2383,7 +2928,7 @@ update_buddy_icon(PurpleBuddy *buddy)
 	                                         purple_buddy_get_name(buddy));
 
 	if(PURPLE_IS_IM_CONVERSATION(im)) {
-		pidgin_conv_update_fields(im, PIDGIN_CONV_BUDDY_ICON);
+		pidgin_conv_queue_update(im, PIDGIN_CONV_BUDDY_ICON);
 	}
 }
 
@@ -2428,7 +2973,7 @@ update_buddy_typing(PurpleAccount *account, const char *who)
 
 	gtkconv = PIDGIN_CONVERSATION(conv);
 	if(gtkconv && gtkconv->active_conv == conv) {
-		pidgin_conv_update_fields(conv, PIDGIN_CONV_COLORIZE_TITLE);
+		pidgin_conv_queue_update(conv, PIDGIN_CONV_COLORIZE_TITLE);
 	}
 }
 
@@ -2447,16 +2992,6 @@ update_chat_topic(PurpleChatConversation *chat, const char *old, const char *new
 
 /* Message history stuff */
 
-/* Compare two PurpleMessages, according to time in ascending order. */
-static int
-message_compare(PurpleMessage *m1, PurpleMessage *m2)
-{
-	GDateTime *dt1 = purple_message_get_timestamp(m1);
-	GDateTime *dt2 = purple_message_get_timestamp(m2);
-
-	return g_date_time_compare(dt1, dt2);
-}
-
 /* Adds some message history to the gtkconv. This happens in a idle-callback. */
 static gboolean
 add_message_history_to_gtkconv(gpointer data)
@@ -2625,6 +3160,7 @@ pidgin_conversations_init(void)
 	purple_prefs_add_string(PIDGIN_PREFS_ROOT "/conversations/font_face", "");
 	purple_prefs_add_int(PIDGIN_PREFS_ROOT "/conversations/font_size", 3);
 	purple_prefs_add_int(PIDGIN_PREFS_ROOT "/conversations/scrollback_lines", 4000);
+	purple_prefs_add_int(PIDGIN_PREFS_ROOT "/conversations/scrollback_kbytes", 4096);
 
 	/* Conversations -> Chat */
 	purple_prefs_remove(PIDGIN_PREFS_ROOT "/conversations/chat");
@@ -2735,6 +3271,24 @@ pidgin_conversations_uninit(void)
 	purple_prefs_disconnect_by_handle(pidgin_conversations_get_handle());
 	purple_signals_disconnect_by_handle(pidgin_conversations_get_handle());
 	purple_signals_unregister_by_instance(pidgin_conversations_get_handle());
+
+	/* Drop the pending updates first, so that removing the ticks doesn't
+	 * schedule an idle for them. */
+	g_clear_pointer(&pending_conv_updates, g_hash_table_destroy);
+	g_clear_pointer(&pending_user_updates, g_hash_table_destroy);
+
+	if(update_ticks != NULL) {
+		GHashTable *ticks = g_steal_pointer(&update_ticks);
+		GHashTableIter iter;
+		gpointer key, value;
+
+		g_hash_table_iter_init(&iter, ticks);
+		while(g_hash_table_iter_next(&iter, &key, &value)) {
+			gtk_widget_remove_tick_callback(key, GPOINTER_TO_UINT(value));
+		}
+		g_hash_table_destroy(ticks);
+	}
+	g_clear_handle_id(&update_idle_id, g_source_remove);
 }
 
 /**************************************************************************
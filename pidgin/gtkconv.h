@@ -27,6 +27,7 @@
 #define _PIDGIN_CONVERSATION_H_
 
 typedef struct _PidginConversation PidginConversation;
+typedef struct _PidginConvScrollback PidginConvScrollback;
 
 enum {
 	CHAT_USERS_ICON_COLUMN,
@@ -85,6 +86,9 @@ struct _PidginConversation
 	 * with message history */
 	int attach_timer;
 	GList *attach_current;
+
+	/* The bounded window of messages shown in the history */
+	PidginConvScrollback *scrollback;
 };
 
 G_BEGIN_DECLS
@@ -110,6 +114,44 @@ PurpleConversationUiOps *pidgin_conversations_get_conv_ui_ops(void);
  */
 void pidgin_conv_switch_active_conversation(PurpleConversation *conv);
 
+/**
+ * pidgin_conv_get_scrollback_length:
+ * @gtkconv: The conversation pane.
+ *
+ * Gets how many messages @gtkconv is holding in its history.
+ *
+ * Returns: The number of messages in the history.
+ *
+ * Since: 3.0.0
+ */
+guint pidgin_conv_get_scrollback_length(PidginConversation *gtkconv);
+
+/**
+ * pidgin_conv_get_scrollback_size:
+ * @gtkconv: The conversation pane.
+ *
+ * Gets an estimate of the memory used by the messages @gtkconv is holding in
+ * its history. New messages evict the oldest ones once this goes over the
+ * "/pidgin/conversations/scrollback_kbytes" preference.
+ *
+ * Returns: The estimated size in bytes.
+ *
+ * Since: 3.0.0
+ */
+gsize pidgin_conv_get_scrollback_size(PidginConversation *gtkconv);
+
+/**
+ * pidgin_conversations_get_merged_updates:
+ *
+ * Conversation and chat user updates are applied once per frame. This counts
+ * the updates that were folded into one that was already pending.
+ *
+ * Returns: The number of updates merged so far.
+ *
+ * Since: 3.0.0
+ */
+guint64 pidgin_conversations_get_merged_updates(void);
+
 /**
  * pidgin_conv_attach_to_conversation:
  * @conv:  The conversation.
@@ -588,12 +588,13 @@ static gboolean pidgin_progress_bar_pulse(gpointer data)
 }
 
 static void
-pidgin_roomlist_add_room(PurpleRoomlist *list, PurpleRoomlistRoom *room) {
-	PidginRoomlist *rl = NULL;
-	GtkTreePath *path;
-	GtkTreeIter iter;
-
-	rl = g_object_get_data(G_OBJECT(list), PIDGIN_ROOMLIST_UI_DATA);
+pidgin_roomlist_items_changed(GListModel *model, guint position,
+                              G_GNUC_UNUSED guint removed, guint added,
+                              gpointer data)
+{
+	PurpleRoomlist *list = PURPLE_ROOMLIST(model);
+	PidginRoomlist *rl = data;
+	guint i;
 
 	if (rl->dialog) {
 		if (rl->dialog->pg_update_to == 0) {
@@ -604,18 +605,21 @@ pidgin_roomlist_add_room(PurpleRoomlist *list, PurpleRoomlistRoom *room) {
 			rl->dialog->pg_needs_pulse = TRUE;
 	}
 
-	gtk_tree_store_append(rl->model, &iter, NULL);
+	/* The room list only ever appends rooms, in batches. */
+	for (i = position; i < position + added; i++) {
+		PurpleRoomlistRoom *room = g_list_model_get_item(model, i);
+		GtkTreeIter iter;
 
-	path = gtk_tree_model_get_path(GTK_TREE_MODEL(rl->model), &iter);
+		gtk_tree_store_append(rl->model, &iter, NULL);
+		gtk_tree_store_set(
+			rl->model, &iter,
+			ROOM_COLUMN, room,
+			NAME_COLUMN, purple_roomlist_room_get_name(room),
+			DESCRIPTION_COLUMN, purple_roomlist_room_get_description(room),
+			-1);
 
-	gtk_tree_path_free(path);
-
-	gtk_tree_store_set(
-		rl->model, &iter,
-		ROOM_COLUMN, room,
-		NAME_COLUMN, purple_roomlist_room_get_name(room),
-		DESCRIPTION_COLUMN, purple_roomlist_room_get_description(room),
-		-1);
+		g_object_unref(room);
+	}
 }
 
 static void
@@ -655,12 +659,13 @@ pidgin_roomlist_new(PurpleRoomlist *list)
 
 	g_signal_connect(list, "notify::in-progress",
 	                 G_CALLBACK(pidgin_roomlist_in_progress), rl);
+	g_signal_connect(list, "items-changed",
+	                 G_CALLBACK(pidgin_roomlist_items_changed), rl);
 }
 
 static PurpleRoomlistUiOps ops = {
 	.show_with_account = pidgin_roomlist_dialog_show_with_account,
 	.create = pidgin_roomlist_new,
-	.add_room = pidgin_roomlist_add_room,
 };
 
 
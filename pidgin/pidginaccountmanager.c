@@ -38,6 +38,8 @@ struct _PidginAccountManager {
 
 	GtkWidget *modify_button;
 	GtkWidget *remove_button;
+
+	GCancellable *cancellable;
 };
 
 enum {
@@ -110,27 +112,63 @@ pidgin_account_manager_get_selected_account(PidginAccountManager *manager) {
 }
 
 static void
-pidgin_account_manager_refresh_account(PidginAccountManager *manager,
-                                       PurpleAccount *account,
-                                       GtkTreeIter *iter)
+pidgin_account_manager_avatar_cb(GObject *obj, GAsyncResult *result,
+                                 gpointer data)
 {
+	PidginAccountManager *manager = NULL;
+	PurpleAccount *account = PURPLE_ACCOUNT(obj);
 	PurpleImage *image = NULL;
-	PurpleProtocol *protocol = NULL;
 	GdkPixbuf *avatar = NULL;
-	const gchar *protocol_icon = NULL, *protocol_name = NULL;
+	GError *error = NULL;
+	GtkTreeIter iter;
+
+	image = purple_buddy_icons_find_account_icon_finish(account, result,
+	                                                    &error);
+	if(error != NULL) {
+		/* If we were cancelled the manager is gone. */
+		if(!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			purple_debug_warning("account-manager",
+			                     "failed to load the avatar for %s: %s",
+			                     purple_account_get_username(account),
+			                     error->message);
+		}
+		g_error_free(error);
+
+		return;
+	}
+
+	manager = PIDGIN_ACCOUNT_MANAGER(data);
 
-	/* Try to find the avatar for the account. */
-	image = purple_buddy_icons_find_account_icon(account);
 	if(image != NULL) {
 		GdkPixbuf *raw = NULL;
 
 		raw = purple_gdk_pixbuf_from_image(image);
 		g_object_unref(image);
 
-		avatar = gdk_pixbuf_scale_simple(raw, 22, 22, GDK_INTERP_HYPER);
-		g_clear_object(&raw);
+		if(raw != NULL) {
+			avatar = gdk_pixbuf_scale_simple(raw, 22, 22, GDK_INTERP_HYPER);
+			g_clear_object(&raw);
+		}
 	}
 
+	/* The account may have been removed while we were loading. */
+	if(pidgin_account_manager_find_account(manager, account, &iter)) {
+		gtk_list_store_set(manager->model, &iter,
+		                   COLUMN_AVATAR, avatar,
+		                   -1);
+	}
+
+	g_clear_object(&avatar);
+}
+
+static void
+pidgin_account_manager_refresh_account(PidginAccountManager *manager,
+                                       PurpleAccount *account,
+                                       GtkTreeIter *iter)
+{
+	PurpleProtocol *protocol = NULL;
+	const gchar *protocol_icon = NULL, *protocol_name = NULL;
+
 	/* Get the protocol fields. */
 	protocol = purple_account_get_protocol(account);
 	if(PURPLE_IS_PROTOCOL(protocol)) {
@@ -142,14 +180,16 @@ pidgin_account_manager_refresh_account(PidginAccountManager *manager,
 
 	gtk_list_store_set(manager->model, iter,
 	                   COLUMN_ENABLED, purple_account_get_enabled(account),
-	                   COLUMN_AVATAR, avatar,
 	                   COLUMN_USERNAME, purple_account_get_username(account),
 	                   COLUMN_PROTOCOL_ICON, protocol_icon,
 	                   COLUMN_PROTOCOL_NAME, protocol_name,
 	                   COLUMN_ACCOUNT, account,
 	                   -1);
 
-	g_clear_object(&avatar);
+	/* Reading the avatar may hit the disk, so fill it in when it's ready. */
+	purple_buddy_icons_find_account_icon_async(account, manager->cancellable,
+	                                           pidgin_account_manager_avatar_cb,
+	                                           manager);
 }
 
 static void
@@ -352,6 +392,8 @@ pidgin_account_manager_init(PidginAccountManager *manager) {
 
 	gtk_widget_init_template(GTK_WIDGET(manager));
 
+	manager->cancellable = g_cancellable_new();
+
 	pidgin_account_manager_populate(manager);
 
 	purple_manager = purple_account_manager_get_default();
@@ -363,10 +405,25 @@ pidgin_account_manager_init(PidginAccountManager *manager) {
 	                        manager, 0);
 }
 
+static void
+pidgin_account_manager_dispose(GObject *obj) {
+	PidginAccountManager *manager = PIDGIN_ACCOUNT_MANAGER(obj);
+
+	if(manager->cancellable != NULL) {
+		g_cancellable_cancel(manager->cancellable);
+		g_clear_object(&manager->cancellable);
+	}
+
+	G_OBJECT_CLASS(pidgin_account_manager_parent_class)->dispose(obj);
+}
+
 static void
 pidgin_account_manager_class_init(PidginAccountManagerClass *klass) {
+	GObjectClass *obj_class = G_OBJECT_CLASS(klass);
 	GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
 
+	obj_class->dispose = pidgin_account_manager_dispose;
+
 	gtk_widget_class_set_template_from_resource(
 		widget_class,
 		"/im/pidgin/Pidgin3/Accounts/manager.ui"
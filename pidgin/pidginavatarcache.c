@@ -0,0 +1,432 @@
+/*
+ * Pidgin - Internet Messenger
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * Pidgin is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "pidginavatarcache.h"
+
+/* The most pixel data we keep around before evicting the least recently used
+ * avatars. */
+#define PIDGIN_AVATAR_CACHE_BUDGET (16 * 1024 * 1024)
+
+typedef struct {
+	gchar *key;
+	GdkPixbuf *pixbuf;
+	gsize size;
+	GList link;
+} PidginAvatarCacheEntry;
+
+typedef struct {
+	PidginAvatarCacheReadyFunc func;
+	gpointer data;
+	GDestroyNotify destroy;
+} PidginAvatarCacheWaiter;
+
+typedef struct {
+	gchar *key;
+	GBytes *contents;
+	gint size;
+	PidginAvatarCacheFlags flags;
+
+	/* Only set if the protocol wants icons scaled for display. */
+	gboolean scale_display;
+	gint min_width;
+	gint min_height;
+	gint max_width;
+	gint max_height;
+} PidginAvatarCacheJob;
+
+/* key -> PidginAvatarCacheEntry, entries are also in lru, most recent first.
+ * Entries with a NULL pixbuf remember images that failed to decode. */
+static GHashTable *entries = NULL;
+static GQueue lru = G_QUEUE_INIT;
+static gsize cached_bytes = 0;
+
+/* key -> GPtrArray of PidginAvatarCacheWaiter for renders in progress. */
+static GHashTable *pending = NULL;
+
+/* size -> transparent GdkPixbuf */
+static GHashTable *placeholders = NULL;
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static void
+pidgin_avatar_cache_entry_free(gpointer data) {
+	PidginAvatarCacheEntry *entry = data;
+
+	g_free(entry->key);
+	g_clear_object(&entry->pixbuf);
+	g_free(entry);
+}
+
+static void
+pidgin_avatar_cache_waiter_free(gpointer data) {
+	PidginAvatarCacheWaiter *waiter = data;
+
+	if(waiter->destroy != NULL) {
+		waiter->destroy(waiter->data);
+	}
+
+	g_free(waiter);
+}
+
+static void
+pidgin_avatar_cache_job_free(gpointer data) {
+	PidginAvatarCacheJob *job = data;
+
+	g_free(job->key);
+	g_bytes_unref(job->contents);
+	g_free(job);
+}
+
+static void
+pidgin_avatar_cache_ensure(void) {
+	if(entries != NULL) {
+		return;
+	}
+
+	/* The entries own their keys. */
+	entries = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+	                                pidgin_avatar_cache_entry_free);
+	pending = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+	                                (GDestroyNotify)g_ptr_array_unref);
+	placeholders = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+	                                     g_object_unref);
+}
+
+static GdkPixbuf *
+pidgin_avatar_cache_get_placeholder(gint size) {
+	GdkPixbuf *placeholder = NULL;
+
+	placeholder = g_hash_table_lookup(placeholders, GINT_TO_POINTER(size));
+	if(placeholder == NULL) {
+		placeholder = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, size, size);
+		gdk_pixbuf_fill(placeholder, 0x00000000);
+		g_hash_table_insert(placeholders, GINT_TO_POINTER(size), placeholder);
+	}
+
+	return g_object_ref(placeholder);
+}
+
+static void
+pidgin_avatar_cache_insert(gchar *key, GdkPixbuf *pixbuf) {
+	PidginAvatarCacheEntry *entry = NULL;
+
+	/* Renders can only race each other if the cache was cleared while one
+	 * was in progress, but don't leave a stale entry in the lru if so. */
+	entry = g_hash_table_lookup(entries, key);
+	if(entry != NULL) {
+		g_queue_unlink(&lru, &entry->link);
+		cached_bytes -= entry->size;
+		g_hash_table_remove(entries, key);
+	}
+
+	entry = g_new0(PidginAvatarCacheEntry, 1);
+	entry->key = key;
+	entry->pixbuf = pixbuf;
+	if(pixbuf != NULL) {
+		entry->size = gdk_pixbuf_get_byte_length(pixbuf);
+	}
+	entry->link.data = entry;
+
+	g_hash_table_insert(entries, entry->key, entry);
+	g_queue_push_head_link(&lru, &entry->link);
+	cached_bytes += entry->size;
+
+	/* Always keep the newest entry, even if it's over budget by itself. */
+	while(cached_bytes > PIDGIN_AVATAR_CACHE_BUDGET && lru.length > 1) {
+		PidginAvatarCacheEntry *oldest = g_queue_peek_tail(&lru);
+
+		g_queue_unlink(&lru, &oldest->link);
+		cached_bytes -= oldest->size;
+		g_hash_table_remove(entries, oldest->key);
+	}
+}
+
+/* Altered from do_colorshift in gnome-panel */
+static void
+pidgin_avatar_cache_alphashift(GdkPixbuf *pixbuf, int shift) {
+	gint i, j;
+	gint width, height, padding;
+	guchar *pixels;
+	int val;
+
+	if(!gdk_pixbuf_get_has_alpha(pixbuf)) {
+		return;
+	}
+
+	width = gdk_pixbuf_get_width(pixbuf);
+	height = gdk_pixbuf_get_height(pixbuf);
+	padding = gdk_pixbuf_get_rowstride(pixbuf) - width * 4;
+	pixels = gdk_pixbuf_get_pixels(pixbuf);
+
+	for(i = 0; i < height; i++) {
+		for(j = 0; j < width; j++) {
+			pixels += 3;
+			val = *pixels - shift;
+			*(pixels++) = CLAMP(val, 0, 255);
+		}
+		pixels += padding;
+	}
+}
+
+/* This runs on a worker thread, so it must only touch the job. */
+static GdkPixbuf *
+pidgin_avatar_cache_render(PidginAvatarCacheJob *job) {
+	GdkPixbuf *buf = NULL, *ret = NULL;
+	gconstpointer data = NULL;
+	gsize len = 0;
+	gint orig_width, orig_height, scale_width, scale_height;
+	gint size = job->size;
+
+	data = g_bytes_get_data(job->contents, &len);
+	buf = purple_gdk_pixbuf_from_data(data, len);
+	if(buf == NULL) {
+		return NULL;
+	}
+
+	if(job->flags & PIDGIN_AVATAR_CACHE_FLAGS_OFFLINE) {
+		gdk_pixbuf_saturate_and_pixelate(buf, buf, 0.0, FALSE);
+	}
+
+	if(job->flags & PIDGIN_AVATAR_CACHE_FLAGS_IDLE) {
+		gdk_pixbuf_saturate_and_pixelate(buf, buf, 0.25, FALSE);
+	}
+
+	scale_width = orig_width = gdk_pixbuf_get_width(buf);
+	scale_height = orig_height = gdk_pixbuf_get_height(buf);
+
+	if(job->scale_display) {
+		PurpleBuddyIconSpec spec = {
+			.min_width = job->min_width,
+			.min_height = job->min_height,
+			.max_width = job->max_width,
+			.max_height = job->max_height,
+			.scale_rules = PURPLE_ICON_SCALE_DISPLAY,
+		};
+
+		purple_buddy_icon_spec_get_scaled_size(&spec, &scale_width,
+		                                       &scale_height);
+	}
+
+	if(!(job->flags & PIDGIN_AVATAR_CACHE_FLAGS_SHRINK_ONLY) ||
+	   scale_height > size || scale_width > size)
+	{
+		GdkPixbuf *tmpbuf;
+
+		if(scale_height > scale_width) {
+			scale_width = (gdouble)size * scale_width / scale_height;
+			scale_height = size;
+		} else {
+			scale_height = (gdouble)size * scale_height / scale_width;
+			scale_width = size;
+		}
+
+		/* Scale & round before making square, so rectangular (but
+		 * non-square) images get rounded corners too. */
+		tmpbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, scale_width,
+		                        scale_height);
+		gdk_pixbuf_fill(tmpbuf, 0x00000000);
+		gdk_pixbuf_scale(buf, tmpbuf, 0, 0, scale_width, scale_height, 0, 0,
+		                 (gdouble)scale_width / orig_width,
+		                 (gdouble)scale_height / orig_height,
+		                 GDK_INTERP_BILINEAR);
+		if(purple_gdk_pixbuf_is_opaque(tmpbuf)) {
+			purple_gdk_pixbuf_make_round(tmpbuf);
+		}
+
+		ret = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, size, size);
+		gdk_pixbuf_fill(ret, 0x00000000);
+		gdk_pixbuf_copy_area(tmpbuf, 0, 0, scale_width, scale_height, ret,
+		                     (size - scale_width) / 2,
+		                     (size - scale_height) / 2);
+		g_object_unref(tmpbuf);
+	} else {
+		ret = gdk_pixbuf_scale_simple(buf, scale_width, scale_height,
+		                              GDK_INTERP_BILINEAR);
+	}
+
+	g_object_unref(buf);
+
+	if(job->flags & PIDGIN_AVATAR_CACHE_FLAGS_FADED) {
+		pidgin_avatar_cache_alphashift(ret, 77);
+	}
+
+	return ret;
+}
+
+/******************************************************************************
+ * Callbacks
+ *****************************************************************************/
+static void
+pidgin_avatar_cache_render_thread(GTask *task,
+                                  G_GNUC_UNUSED gpointer source_object,
+                                  gpointer task_data,
+                                  G_GNUC_UNUSED GCancellable *cancellable)
+{
+	GdkPixbuf *pixbuf = pidgin_avatar_cache_render(task_data);
+
+	g_task_return_pointer(task, pixbuf, pixbuf ? g_object_unref : NULL);
+}
+
+static void
+pidgin_avatar_cache_render_cb(G_GNUC_UNUSED GObject *source,
+                              GAsyncResult *result,
+                              G_GNUC_UNUSED gpointer data)
+{
+	PidginAvatarCacheJob *job = g_task_get_task_data(G_TASK(result));
+	GdkPixbuf *pixbuf = g_task_propagate_pointer(G_TASK(result), NULL);
+	GPtrArray *waiters = NULL;
+	gchar *key = NULL;
+
+	if(pixbuf == NULL) {
+		purple_debug_warning("avatar-cache", "Couldn't decode avatar %s",
+		                     job->key);
+	}
+
+	pidgin_avatar_cache_insert(g_strdup(job->key), pixbuf);
+
+	if(g_hash_table_steal_extended(pending, job->key, (gpointer *)&key,
+	                               (gpointer *)&waiters))
+	{
+		for(guint i = 0; i < waiters->len; i++) {
+			PidginAvatarCacheWaiter *waiter = g_ptr_array_index(waiters, i);
+
+			if(waiter->func != NULL) {
+				waiter->func(waiter->data);
+			}
+		}
+
+		g_ptr_array_unref(waiters);
+		g_free(key);
+	}
+}
+
+/******************************************************************************
+ * Public API
+ *****************************************************************************/
+GdkPixbuf *
+pidgin_avatar_cache_lookup(PurpleImage *image, gint size,
+                           PurpleBuddyIconSpec *spec,
+                           PidginAvatarCacheFlags flags,
+                           PidginAvatarCacheReadyFunc func, gpointer data,
+                           GDestroyNotify destroy)
+{
+	PidginAvatarCacheEntry *entry = NULL;
+	PidginAvatarCacheWaiter *waiter = NULL;
+	GPtrArray *waiters = NULL;
+	GdkPixbuf *placeholder = NULL;
+	gboolean scale_display = FALSE;
+	gchar *key = NULL;
+
+	g_return_val_if_fail(PURPLE_IS_IMAGE(image), NULL);
+	g_return_val_if_fail(size > 0, NULL);
+
+	if(purple_image_get_data_size(image) == 0) {
+		if(destroy != NULL) {
+			destroy(data);
+		}
+
+		return NULL;
+	}
+
+	pidgin_avatar_cache_ensure();
+
+	scale_display = spec != NULL &&
+	                (spec->scale_rules & PURPLE_ICON_SCALE_DISPLAY);
+
+	/* The generated filename is the checksum of the image's contents and is
+	 * remembered by the image, so this doesn't hash anything twice. */
+	key = g_strdup_printf("%s:%d:%u:%d:%d:%d:%d",
+	                      purple_image_generate_filename(image), size, flags,
+	                      scale_display ? spec->min_width : 0,
+	                      scale_display ? spec->min_height : 0,
+	                      scale_display ? spec->max_width : 0,
+	                      scale_display ? spec->max_height : 0);
+
+	entry = g_hash_table_lookup(entries, key);
+	if(entry != NULL) {
+		g_queue_unlink(&lru, &entry->link);
+		g_queue_push_head_link(&lru, &entry->link);
+
+		g_free(key);
+		if(destroy != NULL) {
+			destroy(data);
+		}
+
+		return entry->pixbuf ? g_object_ref(entry->pixbuf) : NULL;
+	}
+
+	waiter = g_new0(PidginAvatarCacheWaiter, 1);
+	waiter->func = func;
+	waiter->data = data;
+	waiter->destroy = destroy;
+
+	waiters = g_hash_table_lookup(pending, key);
+	if(waiters == NULL) {
+		PidginAvatarCacheJob *job = g_new0(PidginAvatarCacheJob, 1);
+		GTask *task = NULL;
+
+		job->key = g_strdup(key);
+		job->contents = purple_image_get_contents(image);
+		job->size = size;
+		job->flags = flags;
+		if(scale_display) {
+			job->scale_display = TRUE;
+			job->min_width = spec->min_width;
+			job->min_height = spec->min_height;
+			job->max_width = spec->max_width;
+			job->max_height = spec->max_height;
+		}
+
+		waiters = g_ptr_array_new_with_free_func(
+			pidgin_avatar_cache_waiter_free);
+		g_hash_table_insert(pending, key, waiters);
+		key = NULL;
+
+		task = g_task_new(NULL, NULL, pidgin_avatar_cache_render_cb, NULL);
+		g_task_set_source_tag(task, pidgin_avatar_cache_lookup);
+		g_task_set_task_data(task, job, pidgin_avatar_cache_job_free);
+		g_task_run_in_thread(task, pidgin_avatar_cache_render_thread);
+		g_object_unref(task);
+	}
+
+	g_ptr_array_add(waiters, waiter);
+	g_free(key);
+
+	if(!(flags & PIDGIN_AVATAR_CACHE_FLAGS_SHRINK_ONLY)) {
+		placeholder = pidgin_avatar_cache_get_placeholder(size);
+	}
+
+	return placeholder;
+}
+
+void
+pidgin_avatar_cache_clear(void) {
+	if(entries == NULL) {
+		return;
+	}
+
+	/* The links are embedded in the entries, so just forget about them. */
+	g_queue_init(&lru);
+	cached_bytes = 0;
+	g_hash_table_remove_all(entries);
+}
@@ -0,0 +1,116 @@
+/*
+ * Pidgin - Internet Messenger
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * Pidgin is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#if !defined(PIDGIN_GLOBAL_HEADER_INSIDE) && !defined(PIDGIN_COMPILATION)
+# error "only <pidgin.h> may be included directly"
+#endif
+
+#ifndef PIDGIN_AVATAR_CACHE_H
+#define PIDGIN_AVATAR_CACHE_H
+
+#include <glib.h>
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include <purple.h>
+
+G_BEGIN_DECLS
+
+/**
+ * PidginAvatarCacheFlags:
+ * @PIDGIN_AVATAR_CACHE_FLAGS_NONE: Render the avatar as is.
+ * @PIDGIN_AVATAR_CACHE_FLAGS_OFFLINE: Fully desaturate the avatar.
+ * @PIDGIN_AVATAR_CACHE_FLAGS_IDLE: Partially desaturate the avatar.
+ * @PIDGIN_AVATAR_CACHE_FLAGS_FADED: Make the avatar partially transparent.
+ * @PIDGIN_AVATAR_CACHE_FLAGS_SHRINK_ONLY: Only scale down avatars that are
+ *                                         larger than the requested size and
+ *                                         leave smaller ones at their natural
+ *                                         size.
+ *
+ * Flags that control how an avatar is rendered.  They are part of the cache
+ * key, so each combination is rendered and cached separately.
+ *
+ * Since: 3.0.0
+ */
+typedef enum /*< flags >*/ {
+	PIDGIN_AVATAR_CACHE_FLAGS_NONE = 0,
+	PIDGIN_AVATAR_CACHE_FLAGS_OFFLINE = 1 << 0,
+	PIDGIN_AVATAR_CACHE_FLAGS_IDLE = 1 << 1,
+	PIDGIN_AVATAR_CACHE_FLAGS_FADED = 1 << 2,
+	PIDGIN_AVATAR_CACHE_FLAGS_SHRINK_ONLY = 1 << 3,
+} PidginAvatarCacheFlags;
+
+/**
+ * PidginAvatarCacheReadyFunc:
+ * @data: The user data passed to pidgin_avatar_cache_lookup().
+ *
+ * Called on the main thread when an avatar that was not in the cache has
+ * been rendered.  Calling pidgin_avatar_cache_lookup() again will return it.
+ *
+ * Since: 3.0.0
+ */
+typedef void (*PidginAvatarCacheReadyFunc)(gpointer data);
+
+/**
+ * pidgin_avatar_cache_lookup:
+ * @image: The #PurpleImage with the encoded avatar.
+ * @size: The size in pixels of the square to fit the avatar into.
+ * @spec: (nullable): The icon spec of the protocol the avatar came from.
+ * @flags: The #PidginAvatarCacheFlags to render with.
+ * @func: (nullable) (scope notified): The function to call when the avatar
+ *        is ready.
+ * @data: User data to pass to @func.
+ * @destroy: (nullable): The function to free @data with.
+ *
+ * Looks up the rendered version of @image.  Avatars are keyed by the checksum
+ * of their contents, so buddies that share an avatar share the cache entry as
+ * well.
+ *
+ * If the avatar has not been rendered yet, it is decoded and scaled on a
+ * worker thread, @func is called once it is ready, and a transparent
+ * placeholder of the right size is returned in the meantime.  With
+ * %PIDGIN_AVATAR_CACHE_FLAGS_SHRINK_ONLY the final size isn't known up front,
+ * so %NULL is returned instead of a placeholder.
+ *
+ * If the @spec asks for icons to be scaled for display, the avatar is scaled
+ * to fit it first.
+ *
+ * Returns: (transfer full) (nullable): The avatar, a placeholder, or %NULL if
+ *          @image could not be decoded.
+ *
+ * Since: 3.0.0
+ */
+GdkPixbuf *pidgin_avatar_cache_lookup(PurpleImage *image, gint size, PurpleBuddyIconSpec *spec, PidginAvatarCacheFlags flags, PidginAvatarCacheReadyFunc func, gpointer data, GDestroyNotify destroy);
+
+/**
+ * pidgin_avatar_cache_clear:
+ *
+ * Drops every rendered avatar from the cache.  Renders that are still in
+ * progress will be added when they finish.
+ *
+ * Since: 3.0.0
+ */
+void pidgin_avatar_cache_clear(void);
+
+G_END_DECLS
+
+#endif /* PIDGIN_AVATAR_CACHE_H */
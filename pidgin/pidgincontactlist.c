@@ -0,0 +1,395 @@
+/*
+ * Pidgin - Internet Messenger
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * Pidgin is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "pidgin/pidgincontactlist.h"
+
+#include <purple.h>
+
+#include "pidgin/gtkdialogs.h"
+#include "pidgin/pidgincore.h"
+#include "pidgin/pidginpresenceicon.h"
+
+struct _PidginContactList {
+	GtkBox parent;
+
+	GtkWidget *search_entry;
+	GtkWidget *view;
+
+	PidginContactStore *store;
+	GtkFilterListModel *filter_model;
+	GtkSortListModel *sort_model;
+
+	GtkStringFilter *filter;
+	GtkMultiSorter *sorter;
+	GtkCustomSorter *status_sorter;
+};
+
+G_DEFINE_TYPE(PidginContactList, pidgin_contact_list, GTK_TYPE_BOX)
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static const gchar *
+pidgin_contact_list_get_name(PurpleContact *contact) {
+	const gchar *name = purple_contact_get_alias(contact);
+
+	if(name == NULL || *name == '\0') {
+		name = purple_contact_get_display_name(contact);
+	}
+
+	if(name == NULL || *name == '\0') {
+		name = purple_contact_get_username(contact);
+	}
+
+	return name;
+}
+
+static gchar *
+pidgin_contact_list_name_closure(PurpleContact *contact, gpointer data) {
+	if(!PURPLE_IS_CONTACT(contact)) {
+		return NULL;
+	}
+
+	return g_strdup(pidgin_contact_list_get_name(contact));
+}
+
+static gint
+pidgin_contact_list_status_rank(PurpleContact *contact) {
+	PurplePresence *presence = purple_contact_get_presence(contact);
+	PurpleStatus *status = NULL;
+
+	if(!PURPLE_IS_PRESENCE(presence) || !purple_presence_is_online(presence)) {
+		return G_MAXINT;
+	}
+
+	status = purple_presence_get_active_status(presence);
+	if(status == NULL) {
+		return G_MAXINT - 1;
+	}
+
+	return purple_status_type_get_primitive(purple_status_get_status_type(status));
+}
+
+static gint
+pidgin_contact_list_compare_status(gconstpointer a, gconstpointer b,
+                                   gpointer data)
+{
+	gint rank_a = pidgin_contact_list_status_rank((PurpleContact *)a);
+	gint rank_b = pidgin_contact_list_status_rank((PurpleContact *)b);
+
+	if(rank_a < rank_b) {
+		return GTK_ORDERING_SMALLER;
+	} else if(rank_a > rank_b) {
+		return GTK_ORDERING_LARGER;
+	}
+
+	return GTK_ORDERING_EQUAL;
+}
+
+/* Maps the buddy list's sort preference onto the sorters. The name sorter
+ * keeps collation keys for every contact, so switching orders only resorts. */
+static void
+pidgin_contact_list_update_sort(PidginContactList *list) {
+	const gchar *sort_type = NULL;
+
+	sort_type = purple_prefs_get_string(PIDGIN_PREFS_ROOT "/blist/sort_type");
+
+	if(purple_strequal(sort_type, "none")) {
+		gtk_sort_list_model_set_sorter(list->sort_model, NULL);
+
+		return;
+	}
+
+	if(purple_strequal(sort_type, "status")) {
+		gtk_custom_sorter_set_sort_func(list->status_sorter,
+		                                pidgin_contact_list_compare_status,
+		                                NULL, NULL);
+	} else {
+		gtk_custom_sorter_set_sort_func(list->status_sorter, NULL, NULL,
+		                                NULL);
+	}
+
+	gtk_sort_list_model_set_sorter(list->sort_model,
+	                               GTK_SORTER(list->sorter));
+}
+
+static void
+pidgin_contact_list_update_row(GtkListItem *item) {
+	PurpleContact *contact = gtk_list_item_get_item(item);
+	PurplePresence *presence = purple_contact_get_presence(contact);
+	GtkWidget *box = gtk_list_item_get_child(item);
+	GtkWidget *icon = NULL, *name = NULL, *status = NULL;
+	gchar *message = NULL;
+
+	icon = gtk_widget_get_first_child(box);
+	name = gtk_widget_get_next_sibling(icon);
+	status = gtk_widget_get_next_sibling(name);
+
+	pidgin_presence_icon_set_presence(PIDGIN_PRESENCE_ICON(icon), presence);
+	gtk_label_set_text(GTK_LABEL(name), pidgin_contact_list_get_name(contact));
+
+	if(PURPLE_IS_PRESENCE(presence)) {
+		PurpleStatus *active = purple_presence_get_active_status(presence);
+
+		if(active != NULL) {
+			const gchar *text = purple_status_get_attr_string(active,
+			                                                  "message");
+
+			if(text != NULL && *text != '\0') {
+				message = purple_markup_strip_html(text);
+			}
+		}
+	}
+
+	gtk_label_set_text(GTK_LABEL(status), message ? message : "");
+	gtk_widget_set_visible(status, message != NULL);
+	g_free(message);
+}
+
+/******************************************************************************
+ * Callbacks
+ *****************************************************************************/
+static void
+pidgin_contact_list_setup_cb(GtkSignalListItemFactory *factory,
+                             GtkListItem *item, gpointer data)
+{
+	GtkWidget *box = NULL, *icon = NULL, *name = NULL, *status = NULL;
+
+	/* Rows are recycled as the list scrolls, so build the widgets once here
+	 * and only fill them in when binding. */
+	box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+
+	icon = pidgin_presence_icon_new(NULL, "person", GTK_ICON_SIZE_NORMAL);
+	gtk_box_append(GTK_BOX(box), icon);
+
+	name = gtk_label_new(NULL);
+	gtk_label_set_xalign(GTK_LABEL(name), 0.0f);
+	gtk_label_set_ellipsize(GTK_LABEL(name), PANGO_ELLIPSIZE_END);
+	gtk_box_append(GTK_BOX(box), name);
+
+	status = gtk_label_new(NULL);
+	gtk_label_set_xalign(GTK_LABEL(status), 0.0f);
+	gtk_label_set_ellipsize(GTK_LABEL(status), PANGO_ELLIPSIZE_END);
+	gtk_widget_set_hexpand(status, TRUE);
+	gtk_widget_add_css_class(status, "dim-label");
+	gtk_box_append(GTK_BOX(box), status);
+
+	gtk_list_item_set_child(item, box);
+}
+
+/* The store reports a change to a contact or its presence as that item being
+ * replaced, which rebinds its row, so there's nothing to watch here. Only
+ * rows that are about to be shown are bound, so this is also where their
+ * avatars are moved to the front of the fetch queue. */
+static void
+pidgin_contact_list_bind_cb(GtkSignalListItemFactory *factory,
+                            GtkListItem *item, gpointer data)
+{
+	PurpleContact *contact = gtk_list_item_get_item(item);
+	const gchar *username = purple_contact_get_username(contact);
+
+	pidgin_contact_list_update_row(item);
+
+	if(username != NULL) {
+		purple_avatar_fetcher_prioritize(purple_avatar_fetcher_get_default(),
+		                                 purple_contact_get_account(contact),
+		                                 username);
+	}
+}
+
+static void
+pidgin_contact_list_unbind_cb(GtkSignalListItemFactory *factory,
+                              GtkListItem *item, gpointer data)
+{
+	GtkWidget *icon = NULL;
+
+	icon = gtk_widget_get_first_child(gtk_list_item_get_child(item));
+	pidgin_presence_icon_set_presence(PIDGIN_PRESENCE_ICON(icon), NULL);
+}
+
+static void
+pidgin_contact_list_activate_cb(GtkListView *view, guint position,
+                                gpointer data)
+{
+	PidginContactList *list = data;
+	PurpleContact *contact = NULL;
+
+	contact = g_list_model_get_item(G_LIST_MODEL(list->sort_model), position);
+	if(contact == NULL) {
+		return;
+	}
+
+	pidgin_dialogs_im_with_user(purple_contact_get_account(contact),
+	                            purple_contact_get_username(contact));
+
+	g_object_unref(contact);
+}
+
+static void
+pidgin_contact_list_search_changed_cb(GtkSearchEntry *entry, gpointer data) {
+	PidginContactList *list = data;
+
+	/* The filter works out on its own whether the new search is stricter or
+	 * looser than the last one and only rechecks the items it has to. */
+	gtk_string_filter_set_search(list->filter,
+	                             gtk_editable_get_text(GTK_EDITABLE(entry)));
+}
+
+static void
+pidgin_contact_list_store_changed_cb(GListModel *model, guint position,
+                                     guint removed, guint added, gpointer data)
+{
+	gtk_widget_set_visible(GTK_WIDGET(data),
+	                       g_list_model_get_n_items(model) > 0);
+}
+
+static void
+pidgin_contact_list_sort_type_cb(const gchar *name, PurplePrefType type,
+                                 gconstpointer value, gpointer data)
+{
+	pidgin_contact_list_update_sort(data);
+}
+
+/******************************************************************************
+ * GObject Implementation
+ *****************************************************************************/
+static void
+pidgin_contact_list_dispose(GObject *obj) {
+	PidginContactList *list = PIDGIN_CONTACT_LIST(obj);
+
+	purple_prefs_disconnect_by_handle(list);
+
+	if(list->store != NULL) {
+		g_signal_handlers_disconnect_by_data(list->store, list);
+	}
+
+	if(list->view != NULL) {
+		gtk_list_view_set_model(GTK_LIST_VIEW(list->view), NULL);
+	}
+
+	g_clear_object(&list->sort_model);
+	g_clear_object(&list->filter_model);
+	g_clear_object(&list->store);
+	g_clear_object(&list->filter);
+	g_clear_object(&list->sorter);
+	g_clear_object(&list->status_sorter);
+
+	G_OBJECT_CLASS(pidgin_contact_list_parent_class)->dispose(obj);
+}
+
+static void
+pidgin_contact_list_init(PidginContactList *list) {
+	GtkExpression *name = NULL;
+	GtkStringSorter *name_sorter = NULL;
+	GtkListItemFactory *factory = NULL;
+	GtkSelectionModel *selection = NULL;
+
+	gtk_widget_init_template(GTK_WIDGET(list));
+
+	list->store = pidgin_contact_store_new(purple_contact_manager_get_default());
+	g_signal_connect(list->store, "items-changed",
+	                 G_CALLBACK(pidgin_contact_list_store_changed_cb), list);
+	gtk_widget_set_visible(GTK_WIDGET(list),
+	                       g_list_model_get_n_items(G_LIST_MODEL(list->store)) > 0);
+
+	name = gtk_cclosure_expression_new(G_TYPE_STRING, NULL, 0, NULL,
+	                                   G_CALLBACK(pidgin_contact_list_name_closure),
+	                                   NULL, NULL);
+
+	/* Filter before sorting so the sorter only sees what will be shown. */
+	list->filter = gtk_string_filter_new(gtk_expression_ref(name));
+	gtk_string_filter_set_match_mode(list->filter,
+	                                 GTK_STRING_FILTER_MATCH_MODE_SUBSTRING);
+	gtk_string_filter_set_ignore_case(list->filter, TRUE);
+	list->filter_model = gtk_filter_list_model_new(
+		G_LIST_MODEL(g_object_ref(list->store)),
+		GTK_FILTER(g_object_ref(list->filter)));
+	gtk_filter_list_model_set_incremental(list->filter_model, TRUE);
+
+	list->status_sorter = gtk_custom_sorter_new(NULL, NULL, NULL);
+	name_sorter = gtk_string_sorter_new(name);
+	list->sorter = gtk_multi_sorter_new();
+	gtk_multi_sorter_append(list->sorter,
+	                        GTK_SORTER(g_object_ref(list->status_sorter)));
+	gtk_multi_sorter_append(list->sorter, GTK_SORTER(name_sorter));
+
+	list->sort_model = gtk_sort_list_model_new(
+		G_LIST_MODEL(g_object_ref(list->filter_model)), NULL);
+	gtk_sort_list_model_set_incremental(list->sort_model, TRUE);
+	pidgin_contact_list_update_sort(list);
+
+	factory = gtk_signal_list_item_factory_new();
+	g_signal_connect(factory, "setup",
+	                 G_CALLBACK(pidgin_contact_list_setup_cb), list);
+	g_signal_connect(factory, "bind",
+	                 G_CALLBACK(pidgin_contact_list_bind_cb), list);
+	g_signal_connect(factory, "unbind",
+	                 G_CALLBACK(pidgin_contact_list_unbind_cb), list);
+
+	selection = GTK_SELECTION_MODEL(gtk_single_selection_new(
+		G_LIST_MODEL(g_object_ref(list->sort_model))));
+	gtk_list_view_set_factory(GTK_LIST_VIEW(list->view), factory);
+	gtk_list_view_set_model(GTK_LIST_VIEW(list->view), selection);
+	g_object_unref(factory);
+	g_object_unref(selection);
+
+	purple_prefs_connect_callback(list, PIDGIN_PREFS_ROOT "/blist/sort_type",
+	                              pidgin_contact_list_sort_type_cb, list);
+}
+
+static void
+pidgin_contact_list_class_init(PidginContactListClass *klass) {
+	GObjectClass *obj_class = G_OBJECT_CLASS(klass);
+	GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(klass);
+
+	obj_class->dispose = pidgin_contact_list_dispose;
+
+	gtk_widget_class_set_template_from_resource(
+	    widget_class,
+	    "/im/pidgin/Pidgin3/BuddyList/contactlist.ui"
+	);
+
+	gtk_widget_class_bind_template_child(widget_class, PidginContactList,
+	                                     search_entry);
+	gtk_widget_class_bind_template_child(widget_class, PidginContactList,
+	                                     view);
+
+	gtk_widget_class_bind_template_callback(widget_class,
+	                                        pidgin_contact_list_activate_cb);
+	gtk_widget_class_bind_template_callback(widget_class,
+	                                        pidgin_contact_list_search_changed_cb);
+}
+
+/******************************************************************************
+ * Public API
+ *****************************************************************************/
+GtkWidget *
+pidgin_contact_list_new(void) {
+	return g_object_new(PIDGIN_TYPE_CONTACT_LIST, NULL);
+}
+
+PidginContactStore *
+pidgin_contact_list_get_store(PidginContactList *list) {
+	g_return_val_if_fail(PIDGIN_IS_CONTACT_LIST(list), NULL);
+
+	return list->store;
+}
@@ -0,0 +1,81 @@
+/*
+ * Pidgin - Internet Messenger
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * Pidgin is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#if !defined(PIDGIN_GLOBAL_HEADER_INSIDE) && !defined(PIDGIN_COMPILATION)
+# error "only <pidgin.h> may be included directly"
+#endif
+
+#ifndef PIDGIN_CONTACT_LIST_H
+#define PIDGIN_CONTACT_LIST_H
+
+#include <glib.h>
+
+#include <gtk/gtk.h>
+
+#include "pidgincontactstore.h"
+
+G_BEGIN_DECLS
+
+/**
+ * PidginContactList:
+ *
+ * A searchable list of every [class@Purple.Contact] in the default
+ * [class@Purple.ContactManager].
+ *
+ * Rows are only created for the contacts that are on screen and are reused as
+ * the list scrolls. Sorting and searching are done incrementally by the
+ * models on top of a [class@Pidgin.ContactStore], so changing the sort order
+ * or a single contact never rebuilds the list.
+ *
+ * Since: 3.0.0
+ */
+
+#define PIDGIN_TYPE_CONTACT_LIST (pidgin_contact_list_get_type())
+G_DECLARE_FINAL_TYPE(PidginContactList, pidgin_contact_list, PIDGIN,
+                     CONTACT_LIST, GtkBox)
+
+/**
+ * pidgin_contact_list_new:
+ *
+ * Creates a new contact list.
+ *
+ * Returns: (transfer full): The new instance.
+ *
+ * Since: 3.0.0
+ */
+GtkWidget *pidgin_contact_list_new(void);
+
+/**
+ * pidgin_contact_list_get_store:
+ * @list: The instance.
+ *
+ * Gets the unsorted, unfiltered store under @list.
+ *
+ * Returns: (transfer none): The store.
+ *
+ * Since: 3.0.0
+ */
+PidginContactStore *pidgin_contact_list_get_store(PidginContactList *list);
+
+G_END_DECLS
+
+#endif /* PIDGIN_CONTACT_LIST_H */
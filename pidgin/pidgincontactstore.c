@@ -0,0 +1,390 @@
+/*
+ * Pidgin - Internet Messenger
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * Pidgin is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "pidgin/pidgincontactstore.h"
+
+enum {
+	PROP_0,
+	PROP_MANAGER,
+	N_PROPERTIES,
+};
+static GParamSpec *properties[N_PROPERTIES] = {NULL, };
+
+typedef struct {
+	PidginContactStore *store;
+	PurpleContact *contact;
+	PurplePresence *presence;
+	guint position;
+} PidginContactStoreEntry;
+
+struct _PidginContactStore {
+	GObject parent;
+
+	PurpleContactManager *manager;
+
+	/* The entries in model order, and the contacts pointing back at them so
+	 * lookups never have to walk the array. */
+	GPtrArray *entries;
+	GHashTable *index;
+};
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static void
+pidgin_contact_store_entry_changed(PidginContactStoreEntry *entry) {
+	g_list_model_items_changed(G_LIST_MODEL(entry->store), entry->position, 1,
+	                           1);
+}
+
+static void
+pidgin_contact_store_presence_notify_cb(GObject *obj, GParamSpec *pspec,
+                                        gpointer data)
+{
+	pidgin_contact_store_entry_changed(data);
+}
+
+static void
+pidgin_contact_store_entry_set_presence(PidginContactStoreEntry *entry,
+                                        PurplePresence *presence)
+{
+	if(entry->presence == presence) {
+		return;
+	}
+
+	if(entry->presence != NULL) {
+		g_signal_handlers_disconnect_by_data(entry->presence, entry);
+		g_clear_object(&entry->presence);
+	}
+
+	if(presence != NULL) {
+		entry->presence = g_object_ref(presence);
+		g_signal_connect(presence, "notify",
+		                 G_CALLBACK(pidgin_contact_store_presence_notify_cb),
+		                 entry);
+	}
+}
+
+static void
+pidgin_contact_store_contact_notify_cb(GObject *obj, GParamSpec *pspec,
+                                       gpointer data)
+{
+	PidginContactStoreEntry *entry = data;
+
+	pidgin_contact_store_entry_set_presence(entry,
+		purple_contact_get_presence(entry->contact));
+
+	pidgin_contact_store_entry_changed(entry);
+}
+
+static void
+pidgin_contact_store_entry_free(PidginContactStoreEntry *entry) {
+	pidgin_contact_store_entry_set_presence(entry, NULL);
+
+	g_signal_handlers_disconnect_by_data(entry->contact, entry);
+	g_clear_object(&entry->contact);
+
+	g_free(entry);
+}
+
+static gboolean
+pidgin_contact_store_insert(PidginContactStore *store,
+                            PurpleContact *contact)
+{
+	PidginContactStoreEntry *entry = NULL;
+
+	if(g_hash_table_contains(store->index, contact)) {
+		return FALSE;
+	}
+
+	entry = g_new0(PidginContactStoreEntry, 1);
+	entry->store = store;
+	entry->contact = g_object_ref(contact);
+	entry->position = store->entries->len;
+
+	g_signal_connect(contact, "notify",
+	                 G_CALLBACK(pidgin_contact_store_contact_notify_cb),
+	                 entry);
+	pidgin_contact_store_entry_set_presence(entry,
+		purple_contact_get_presence(contact));
+
+	g_ptr_array_add(store->entries, entry);
+	g_hash_table_insert(store->index, contact, entry);
+
+	return TRUE;
+}
+
+static void
+pidgin_contact_store_add_account(PurpleAccount *account, gpointer data) {
+	PidginContactStore *store = data;
+	GListModel *contacts = NULL;
+	guint n_items = 0;
+
+	contacts = purple_contact_manager_get_all(store->manager, account);
+	if(contacts == NULL) {
+		return;
+	}
+
+	n_items = g_list_model_get_n_items(contacts);
+	for(guint i = 0; i < n_items; i++) {
+		PurpleContact *contact = g_list_model_get_item(contacts, i);
+
+		pidgin_contact_store_insert(store, contact);
+
+		g_object_unref(contact);
+	}
+}
+
+/******************************************************************************
+ * Callbacks
+ *****************************************************************************/
+static void
+pidgin_contact_store_added_cb(PurpleContactManager *manager,
+                              PurpleContact *contact, gpointer data)
+{
+	PidginContactStore *store = data;
+
+	if(pidgin_contact_store_insert(store, contact)) {
+		g_list_model_items_changed(G_LIST_MODEL(store),
+		                           store->entries->len - 1, 0, 1);
+	}
+}
+
+static void
+pidgin_contact_store_removed_cb(PurpleContactManager *manager,
+                                PurpleContact *contact, gpointer data)
+{
+	PidginContactStore *store = data;
+	PidginContactStoreEntry *entry = NULL;
+	guint position = 0;
+
+	entry = g_hash_table_lookup(store->index, contact);
+	if(entry == NULL) {
+		return;
+	}
+
+	position = entry->position;
+
+	/* Keep the order, so that this is a single removal to the views. The
+	 * entries after the hole only need their positions fixed up. This frees
+	 * entry. */
+	g_hash_table_remove(store->index, contact);
+	g_ptr_array_remove_index(store->entries, position);
+
+	for(guint i = position; i < store->entries->len; i++) {
+		PidginContactStoreEntry *moved = g_ptr_array_index(store->entries, i);
+
+		moved->position = i;
+	}
+
+	g_list_model_items_changed(G_LIST_MODEL(store), position, 1, 0);
+}
+
+/******************************************************************************
+ * GListModel Implementation
+ *****************************************************************************/
+static GType
+pidgin_contact_store_get_item_type(GListModel *model) {
+	return PURPLE_TYPE_CONTACT;
+}
+
+static guint
+pidgin_contact_store_get_n_items(GListModel *model) {
+	PidginContactStore *store = PIDGIN_CONTACT_STORE(model);
+
+	return store->entries->len;
+}
+
+static gpointer
+pidgin_contact_store_get_item(GListModel *model, guint position) {
+	PidginContactStore *store = PIDGIN_CONTACT_STORE(model);
+	PidginContactStoreEntry *entry = NULL;
+
+	if(position >= store->entries->len) {
+		return NULL;
+	}
+
+	entry = g_ptr_array_index(store->entries, position);
+
+	return g_object_ref(entry->contact);
+}
+
+static void
+pidgin_contact_store_list_model_init(GListModelInterface *iface) {
+	iface->get_item_type = pidgin_contact_store_get_item_type;
+	iface->get_n_items = pidgin_contact_store_get_n_items;
+	iface->get_item = pidgin_contact_store_get_item;
+}
+
+/******************************************************************************
+ * GObject Implementation
+ *****************************************************************************/
+G_DEFINE_TYPE_WITH_CODE(PidginContactStore, pidgin_contact_store,
+                        G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(G_TYPE_LIST_MODEL,
+                                              pidgin_contact_store_list_model_init))
+
+static void
+pidgin_contact_store_set_manager(PidginContactStore *store,
+                                 PurpleContactManager *manager)
+{
+	PurpleAccountManager *account_manager = NULL;
+
+	if(!g_set_object(&store->manager, manager) || manager == NULL) {
+		return;
+	}
+
+	g_signal_connect_object(manager, "added",
+	                        G_CALLBACK(pidgin_contact_store_added_cb), store,
+	                        0);
+	g_signal_connect_object(manager, "removed",
+	                        G_CALLBACK(pidgin_contact_store_removed_cb), store,
+	                        0);
+
+	account_manager = purple_account_manager_get_default();
+	purple_account_manager_foreach(account_manager,
+	                               pidgin_contact_store_add_account, store);
+}
+
+static void
+pidgin_contact_store_get_property(GObject *obj, guint param_id, GValue *value,
+                                  GParamSpec *pspec)
+{
+	PidginContactStore *store = PIDGIN_CONTACT_STORE(obj);
+
+	switch(param_id) {
+		case PROP_MANAGER:
+			g_value_set_object(value, pidgin_contact_store_get_manager(store));
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
+			break;
+	}
+}
+
+static void
+pidgin_contact_store_set_property(GObject *obj, guint param_id,
+                                  const GValue *value, GParamSpec *pspec)
+{
+	PidginContactStore *store = PIDGIN_CONTACT_STORE(obj);
+
+	switch(param_id) {
+		case PROP_MANAGER:
+			pidgin_contact_store_set_manager(store, g_value_get_object(value));
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
+			break;
+	}
+}
+
+static void
+pidgin_contact_store_dispose(GObject *obj) {
+	PidginContactStore *store = PIDGIN_CONTACT_STORE(obj);
+
+	g_hash_table_remove_all(store->index);
+	g_ptr_array_set_size(store->entries, 0);
+
+	g_clear_object(&store->manager);
+
+	G_OBJECT_CLASS(pidgin_contact_store_parent_class)->dispose(obj);
+}
+
+static void
+pidgin_contact_store_finalize(GObject *obj) {
+	PidginContactStore *store = PIDGIN_CONTACT_STORE(obj);
+
+	g_clear_pointer(&store->index, g_hash_table_destroy);
+	g_clear_pointer(&store->entries, g_ptr_array_unref);
+
+	G_OBJECT_CLASS(pidgin_contact_store_parent_class)->finalize(obj);
+}
+
+static void
+pidgin_contact_store_init(PidginContactStore *store) {
+	store->entries = g_ptr_array_new_with_free_func(
+		(GDestroyNotify)pidgin_contact_store_entry_free);
+	store->index = g_hash_table_new(g_direct_hash, g_direct_equal);
+}
+
+static void
+pidgin_contact_store_class_init(PidginContactStoreClass *klass) {
+	GObjectClass *obj_class = G_OBJECT_CLASS(klass);
+
+	obj_class->get_property = pidgin_contact_store_get_property;
+	obj_class->set_property = pidgin_contact_store_set_property;
+	obj_class->dispose = pidgin_contact_store_dispose;
+	obj_class->finalize = pidgin_contact_store_finalize;
+
+	/**
+	 * PidginContactStore:manager:
+	 *
+	 * The contact manager whose contacts are in the store.
+	 *
+	 * Since: 3.0.0
+	 */
+	properties[PROP_MANAGER] = g_param_spec_object(
+		"manager", "manager",
+		"The contact manager whose contacts are in the store.",
+		PURPLE_TYPE_CONTACT_MANAGER,
+		G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+	g_object_class_install_properties(obj_class, N_PROPERTIES, properties);
+}
+
+/******************************************************************************
+ * Public API
+ *****************************************************************************/
+PidginContactStore *
+pidgin_contact_store_new(PurpleContactManager *manager) {
+	g_return_val_if_fail(PURPLE_IS_CONTACT_MANAGER(manager), NULL);
+
+	return g_object_new(PIDGIN_TYPE_CONTACT_STORE, "manager", manager, NULL);
+}
+
+PurpleContactManager *
+pidgin_contact_store_get_manager(PidginContactStore *store) {
+	g_return_val_if_fail(PIDGIN_IS_CONTACT_STORE(store), NULL);
+
+	return store->manager;
+}
+
+gboolean
+pidgin_contact_store_find(PidginContactStore *store, PurpleContact *contact,
+                          guint *position)
+{
+	PidginContactStoreEntry *entry = NULL;
+
+	g_return_val_if_fail(PIDGIN_IS_CONTACT_STORE(store), FALSE);
+	g_return_val_if_fail(PURPLE_IS_CONTACT(contact), FALSE);
+
+	entry = g_hash_table_lookup(store->index, contact);
+	if(entry == NULL) {
+		return FALSE;
+	}
+
+	if(position != NULL) {
+		*position = entry->position;
+	}
+
+	return TRUE;
+}
@@ -0,0 +1,97 @@
+/*
+ * Pidgin - Internet Messenger
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * Pidgin is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#if !defined(PIDGIN_GLOBAL_HEADER_INSIDE) && !defined(PIDGIN_COMPILATION)
+# error "only <pidgin.h> may be included directly"
+#endif
+
+#ifndef PIDGIN_CONTACT_STORE_H
+#define PIDGIN_CONTACT_STORE_H
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <purple.h>
+
+G_BEGIN_DECLS
+
+/**
+ * PidginContactStore:
+ *
+ * A flat [iface@Gio.ListModel] of every [class@Purple.Contact] known to a
+ * [class@Purple.ContactManager], across all accounts.
+ *
+ * The store keeps contacts in the order they were added; it's meant to sit
+ * under a [class@Gtk.FilterListModel] and a [class@Gtk.SortListModel].
+ * Adding a contact and looking up its position take constant time, removing
+ * one is reported as a single removal, and a contact whose properties or
+ * presence change is reported as changed in place so the models above only
+ * have to look at that one item again.
+ *
+ * Since: 3.0.0
+ */
+
+#define PIDGIN_TYPE_CONTACT_STORE (pidgin_contact_store_get_type())
+G_DECLARE_FINAL_TYPE(PidginContactStore, pidgin_contact_store, PIDGIN,
+                     CONTACT_STORE, GObject)
+
+/**
+ * pidgin_contact_store_new:
+ * @manager: The contact manager to track.
+ *
+ * Creates a new store that follows the contacts in @manager.
+ *
+ * Returns: (transfer full): The new instance.
+ *
+ * Since: 3.0.0
+ */
+PidginContactStore *pidgin_contact_store_new(PurpleContactManager *manager);
+
+/**
+ * pidgin_contact_store_get_manager:
+ * @store: The instance.
+ *
+ * Gets the contact manager that @store is following.
+ *
+ * Returns: (transfer none): The contact manager.
+ *
+ * Since: 3.0.0
+ */
+PurpleContactManager *pidgin_contact_store_get_manager(PidginContactStore *store);
+
+/**
+ * pidgin_contact_store_find:
+ * @store: The instance.
+ * @contact: The contact to look for.
+ * @position: (out) (optional): The position of @contact.
+ *
+ * Looks up where @contact is in @store without walking the model.
+ *
+ * Returns: %TRUE if @contact is in @store, %FALSE otherwise.
+ *
+ * Since: 3.0.0
+ */
+gboolean pidgin_contact_store_find(PidginContactStore *store, PurpleContact *contact, guint *position);
+
+G_END_DECLS
+
+#endif /* PIDGIN_CONTACT_STORE_H */
@@ -35,6 +35,7 @@
 #include "pidginapplication.h"
 #include "pidgincore.h"
 #include "pidgindebug.h"
+#include "pidgindebugstore.h"
 
 #include <gdk/gdkkeysyms.h>
 
@@ -42,23 +43,27 @@
 struct _PidginDebugWindow {
 	GtkWindow parent;
 
-	GtkWidget *textview;
-	GtkTextBuffer *buffer;
-	GtkTextMark *start_mark;
-	GtkTextMark *end_mark;
-	struct {
-		GtkTextTag *level[PURPLE_DEBUG_FATAL + 1];
-		GtkTextTag *category;
-		GtkTextTag *filtered_invisible;
-		GtkTextTag *filtered_visible;
-		GtkTextTag *match;
-		GtkTextTag *paused;
-	} tags;
+	GtkWidget *listview;
+	PidginDebugStore *store;
+	GtkFilterListModel *filter_model;
+	GtkFilter *message_filter;
+	/* The rows that are currently bound, so they can be redrawn when the
+	 * highlighting changes. */
+	GHashTable *bound_items;
+	gboolean scroll_to_end;
+
 	GtkWidget *filter;
 	GtkWidget *expression;
 	GtkWidget *filterlevel;
+	GtkWidget *category;
+	GtkStringList *categories;
+	GHashTable *category_names;
+
+	PurpleDebugLevel filter_level;
+	gchar *filter_category;
 
 	gboolean paused;
+	guint64 paused_after;
 
 	GtkWidget *popover;
 	GtkWidget *popover_invert;
@@ -68,13 +73,6 @@ struct _PidginDebugWindow {
 	GRegex *regex;
 };
 
-typedef struct {
-	GDateTime *timestamp;
-	PurpleDebugLevel level;
-	gchar *domain;
-	gchar *message;
-} PidginDebugMessage;
-
 static gboolean debug_print_enabled = FALSE;
 static PidginDebugWindow *debug_win = NULL;
 static guint debug_enabled_timer = 0;
@@ -96,15 +94,222 @@ save_default_size_cb(GObject *gobject, G_GNUC_UNUSED GParamSpec *pspec,
 }
 
 static gboolean
-view_near_bottom(PidginDebugWindow *win)
+view_near_bottom(GtkAdjustment *adj)
 {
-	GtkAdjustment *adj = gtk_scrollable_get_vadjustment(
-			GTK_SCROLLABLE(win->textview));
 	return (gtk_adjustment_get_value(adj) >=
 			(gtk_adjustment_get_upper(adj) -
 			 gtk_adjustment_get_page_size(adj) * 1.5));
 }
 
+/* The list only knows how tall it is after it has been laid out, so instead
+ * of scrolling when messages are added, the view sticks to the bottom for as
+ * long as the user hasn't scrolled away from it. */
+static void
+view_value_changed_cb(GtkAdjustment *adj, PidginDebugWindow *win)
+{
+	win->scroll_to_end = view_near_bottom(adj);
+}
+
+static void
+view_changed_cb(GtkAdjustment *adj, PidginDebugWindow *win)
+{
+	if (win->scroll_to_end) {
+		gtk_adjustment_set_value(adj, gtk_adjustment_get_upper(adj) -
+		                              gtk_adjustment_get_page_size(adj));
+	}
+}
+
+static void
+scroll_to_end(PidginDebugWindow *win)
+{
+	GtkAdjustment *adj = gtk_scrollable_get_vadjustment(
+			GTK_SCROLLABLE(win->listview));
+
+	win->scroll_to_end = TRUE;
+	view_changed_cb(adj, win);
+}
+
+/******************************************************************************
+ * Filtering
+ *****************************************************************************/
+static gboolean
+regex_is_active(PidginDebugWindow *win)
+{
+	return win->regex != NULL &&
+	       gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(win->filter));
+}
+
+/* Only looks at the fields of the message, so the filter model can check new
+ * messages as they arrive and recheck old ones in chunks when the filter
+ * changes. */
+static gboolean
+message_filter_func(gpointer item, gpointer data)
+{
+	PidginDebugWindow *win = data;
+	PidginDebugMessage *message = item;
+	const gchar *category = NULL;
+
+	if (win->paused &&
+	    pidgin_debug_message_get_sequence(message) > win->paused_after) {
+		return FALSE;
+	}
+
+	if (pidgin_debug_message_get_level(message) < win->filter_level) {
+		return FALSE;
+	}
+
+	category = pidgin_debug_message_get_category(message);
+	if (win->filter_category != NULL &&
+	    !purple_strequal(category, win->filter_category)) {
+		return FALSE;
+	}
+
+	if (regex_is_active(win)) {
+		gboolean matched;
+
+		matched = g_regex_match(win->regex, category, 0, NULL) ||
+		          g_regex_match(win->regex,
+		                        pidgin_debug_message_get_text(message), 0,
+		                        NULL);
+
+		if (matched == win->invert) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static void
+message_filter_changed(PidginDebugWindow *win, GtkFilterChange change)
+{
+	/* The template sets up the toolbar before the filter exists. */
+	if (win->message_filter != NULL) {
+		gtk_filter_changed(win->message_filter, change);
+	}
+}
+
+/******************************************************************************
+ * Rows
+ *****************************************************************************/
+static void
+message_setup_cb(G_GNUC_UNUSED GtkSignalListItemFactory *factory,
+                 GtkListItem *item, G_GNUC_UNUSED gpointer data)
+{
+	GtkWidget *label = gtk_label_new(NULL);
+
+	gtk_label_set_xalign(GTK_LABEL(label), 0.0f);
+	gtk_label_set_wrap(GTK_LABEL(label), TRUE);
+	gtk_label_set_wrap_mode(GTK_LABEL(label), PANGO_WRAP_WORD_CHAR);
+	gtk_list_item_set_child(item, label);
+}
+
+static void
+message_update_row(PidginDebugWindow *win, GtkListItem *item)
+{
+	static const gchar *level_classes[PURPLE_DEBUG_FATAL + 1][3] = {
+		{ "debug-message", NULL },
+		{ "debug-message", "dim-label", NULL },
+		{ "debug-message", NULL },
+		{ "debug-message", "warning", NULL },
+		{ "debug-message", "error", NULL },
+		{ "debug-message", "error", NULL },
+	};
+	PidginDebugMessage *message = gtk_list_item_get_item(item);
+	GtkWidget *label = gtk_list_item_get_child(item);
+	PurpleDebugLevel level = pidgin_debug_message_get_level(message);
+	PangoAttrList *attrs = NULL;
+	PangoAttribute *attr = NULL;
+	const gchar *category = pidgin_debug_message_get_category(message);
+	gchar *line = NULL;
+	gsize text_start = 0;
+
+	line = pidgin_debug_message_format(message);
+
+	attrs = pango_attr_list_new();
+
+	/* Matches the "(HH:MM:SS) " prefix from pidgin_debug_message_format(). */
+	text_start = strlen(line) - strlen(pidgin_debug_message_get_text(message));
+	if (*category != '\0') {
+		attr = pango_attr_weight_new(PANGO_WEIGHT_BOLD);
+		attr->start_index = text_start - strlen(category) - 2;
+		attr->end_index = text_start;
+		pango_attr_list_insert(attrs, attr);
+	}
+
+	if (level == PURPLE_DEBUG_FATAL) {
+		attr = pango_attr_weight_new(PANGO_WEIGHT_BOLD);
+		pango_attr_list_insert(attrs, attr);
+	}
+
+	if (win->highlight && !win->invert && regex_is_active(win)) {
+		GMatchInfo *match = NULL;
+
+		g_regex_match(win->regex, line + text_start, 0, &match);
+		while (g_match_info_matches(match)) {
+			gint start_pos, end_pos;
+
+			g_match_info_fetch_pos(match, 0, &start_pos, &end_pos);
+
+			attr = pango_attr_background_new(0xffff, 0xafaf, 0xafaf);
+			attr->start_index = text_start + start_pos;
+			attr->end_index = text_start + end_pos;
+			pango_attr_list_insert(attrs, attr);
+
+			attr = pango_attr_weight_new(PANGO_WEIGHT_BOLD);
+			attr->start_index = text_start + start_pos;
+			attr->end_index = text_start + end_pos;
+			pango_attr_list_insert(attrs, attr);
+
+			g_match_info_next(match, NULL);
+		}
+		g_match_info_free(match);
+	}
+
+	gtk_widget_set_css_classes(label, level_classes[level]);
+	gtk_label_set_text(GTK_LABEL(label), line);
+	gtk_label_set_attributes(GTK_LABEL(label), attrs);
+
+	pango_attr_list_unref(attrs);
+	g_free(line);
+}
+
+static void
+message_bind_cb(G_GNUC_UNUSED GtkSignalListItemFactory *factory,
+                GtkListItem *item, gpointer data)
+{
+	PidginDebugWindow *win = data;
+
+	g_hash_table_add(win->bound_items, item);
+	message_update_row(win, item);
+}
+
+static void
+message_unbind_cb(G_GNUC_UNUSED GtkSignalListItemFactory *factory,
+                  GtkListItem *item, gpointer data)
+{
+	PidginDebugWindow *win = data;
+
+	g_hash_table_remove(win->bound_items, item);
+}
+
+/* Messages never change, so this is only needed when the highlighting does,
+ * and only touches the handful of rows that are on screen. */
+static void
+message_refresh_rows(PidginDebugWindow *win)
+{
+	GHashTableIter iter;
+	gpointer item;
+
+	g_hash_table_iter_init(&iter, win->bound_items);
+	while (g_hash_table_iter_next(&iter, &item, NULL)) {
+		message_update_row(win, item);
+	}
+}
+
+/******************************************************************************
+ * Toolbar
+ *****************************************************************************/
 static void
 save_response_cb(GtkNativeDialog *self, gint response_id, gpointer data)
 {
@@ -113,8 +318,9 @@ save_response_cb(GtkNativeDialog *self, gint response_id, gpointer data)
 	if(response_id == GTK_RESPONSE_ACCEPT) {
 		GFile *file = NULL;
 		GFileOutputStream *output = NULL;
-		GtkTextIter start, end;
-		gchar *tmp = NULL;
+		GListModel *model = G_LIST_MODEL(win->filter_model);
+		GString *text = NULL;
+		guint n_items;
 		GError *error = NULL;
 
 		file = gtk_file_chooser_get_file(GTK_FILE_CHOOSER(self));
@@ -131,25 +337,26 @@ save_response_cb(GtkNativeDialog *self, gint response_id, gpointer data)
 			return;
 		}
 
-		tmp = g_strdup_printf("Pidgin Debug Log : %s\n", purple_date_format_full(NULL));
-		g_output_stream_write_all(G_OUTPUT_STREAM(output), tmp, strlen(tmp),
-		                          NULL, NULL, &error);
-		g_free(tmp);
+		/* Save what is being shown, the same way the text view used to. */
+		text = g_string_new(NULL);
+		g_string_append_printf(text, "Pidgin Debug Log : %s\n",
+		                       purple_date_format_full(NULL));
 
-		if(error != NULL) {
-			purple_debug_error("debug", "Unable to save debug log: %s",
-			                   error->message);
-			g_error_free(error);
-			g_object_unref(output);
-			g_object_unref(self);
-			return;
+		n_items = g_list_model_get_n_items(model);
+		for(guint i = 0; i < n_items; i++) {
+			PidginDebugMessage *message = g_list_model_get_item(model, i);
+			gchar *line = pidgin_debug_message_format(message);
+
+			g_string_append(text, line);
+			g_string_append_c(text, '\n');
+
+			g_free(line);
+			g_object_unref(message);
 		}
 
-		gtk_text_buffer_get_bounds(win->buffer, &start, &end);
-		tmp = gtk_text_buffer_get_text(win->buffer, &start, &end, TRUE);
-		g_output_stream_write_all(G_OUTPUT_STREAM(output), tmp, strlen(tmp),
-		                          NULL, NULL, &error);
-		g_free(tmp);
+		g_output_stream_write_all(G_OUTPUT_STREAM(output), text->str,
+		                          text->len, NULL, NULL, &error);
+		g_string_free(text, TRUE);
 
 		if(error != NULL) {
 			purple_debug_error("debug", "Unable to save debug log: %s",
@@ -187,7 +394,7 @@ save_cb(GtkWidget *w, PidginDebugWindow *win)
 static void
 clear_cb(GtkWidget *w, PidginDebugWindow *win)
 {
-	gtk_text_buffer_set_text(win->buffer, "", 0);
+	pidgin_debug_store_clear(win->store);
 }
 
 static void
@@ -195,13 +402,13 @@ pause_cb(GtkWidget *w, PidginDebugWindow *win)
 {
 	win->paused = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(w));
 
-	if (!win->paused) {
-		GtkTextIter start, end;
-		gtk_text_buffer_get_bounds(win->buffer, &start, &end);
-		gtk_text_buffer_remove_tag(win->buffer, win->tags.paused,
-				&start, &end);
-		gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(win->textview),
-				win->end_mark, 0, TRUE, 0, 1);
+	if (win->paused) {
+		/* Nothing that is already shown changes, the filter just hides
+		 * whatever comes in from now on. */
+		win->paused_after = pidgin_debug_store_get_last_sequence(win->store);
+	} else {
+		message_filter_changed(win, GTK_FILTER_CHANGE_LESS_STRICT);
+		scroll_to_end(win);
 	}
 }
 
@@ -225,94 +432,6 @@ regex_change_color(GtkWidget *w, gboolean success) {
 	}
 }
 
-static void
-do_regex(PidginDebugWindow *win, GtkTextIter *start, GtkTextIter *end)
-{
-	GError *error = NULL;
-	GMatchInfo *match;
-	gint initial_position;
-	gint start_pos, end_pos;
-	GtkTextIter match_start, match_end;
-	gchar *text;
-
-	if (!win->regex) {
-		return;
-	}
-
-	initial_position = gtk_text_iter_get_offset(start);
-
-	if (!win->invert) {
-		/* First hide everything. */
-		gtk_text_buffer_apply_tag(win->buffer,
-				win->tags.filtered_invisible, start, end);
-	}
-
-	text = gtk_text_buffer_get_text(win->buffer, start, end, TRUE);
-	g_regex_match(win->regex, text, 0, &match);
-	while (g_match_info_matches(match)) {
-		g_match_info_fetch_pos(match, 0, &start_pos, &end_pos);
-		start_pos += initial_position;
-		end_pos += initial_position;
-
-		/* Expand match to full line of message. */
-		gtk_text_buffer_get_iter_at_offset(win->buffer,
-				&match_start, start_pos);
-		gtk_text_iter_set_line_index(&match_start, 0);
-		gtk_text_buffer_get_iter_at_offset(win->buffer,
-				&match_end, end_pos);
-		gtk_text_iter_forward_line(&match_end);
-
-		if (win->invert) {
-			/* Make invisible. */
-			gtk_text_buffer_apply_tag(win->buffer,
-					win->tags.filtered_invisible,
-					&match_start, &match_end);
-		} else {
-			/* Make visible again (with higher priority.) */
-			gtk_text_buffer_apply_tag(win->buffer,
-					win->tags.filtered_visible,
-					&match_start, &match_end);
-
-			if (win->highlight) {
-				gtk_text_buffer_get_iter_at_offset(
-						win->buffer,
-						&match_start,
-						start_pos);
-				gtk_text_buffer_get_iter_at_offset(
-						win->buffer,
-						&match_end,
-						end_pos);
-				gtk_text_buffer_apply_tag(win->buffer,
-						win->tags.match,
-						&match_start,
-						&match_end);
-			}
-		}
-
-		g_match_info_next(match, &error);
-	}
-
-	g_match_info_free(match);
-	g_free(text);
-}
-
-static void
-regex_toggle_filter(PidginDebugWindow *win, gboolean filter)
-{
-	GtkTextIter start, end;
-
-	gtk_text_buffer_get_bounds(win->buffer, &start, &end);
-	gtk_text_buffer_remove_tag(win->buffer, win->tags.match, &start, &end);
-	gtk_text_buffer_remove_tag(win->buffer, win->tags.filtered_invisible,
-			&start, &end);
-	gtk_text_buffer_remove_tag(win->buffer, win->tags.filtered_visible,
-			&start, &end);
-
-	if (filter) {
-		do_regex(win, &start, &end);
-	}
-}
-
 static void
 regex_pref_filter_cb(const gchar *name, PurplePrefType type,
 					 gconstpointer val, gpointer data)
@@ -337,10 +456,15 @@ regex_pref_invert_cb(const gchar *name, PurplePrefType type,
 	PidginDebugWindow *win = (PidginDebugWindow *)data;
 	gboolean active = GPOINTER_TO_INT(val);
 
+	if (win->invert == active) {
+		return;
+	}
+
 	win->invert = active;
 
-	if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(win->filter))) {
-		regex_toggle_filter(win, TRUE);
+	if (regex_is_active(win)) {
+		message_filter_changed(win, GTK_FILTER_CHANGE_DIFFERENT);
+		message_refresh_rows(win);
 	}
 }
 
@@ -353,8 +477,8 @@ regex_pref_highlight_cb(const gchar *name, PurplePrefType type,
 
 	win->highlight = active;
 
-	if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(win->filter))) {
-		regex_toggle_filter(win, TRUE);
+	if (regex_is_active(win)) {
+		message_refresh_rows(win);
 	}
 }
 
@@ -369,15 +493,20 @@ regex_changed_cb(GtkWidget *w, PidginDebugWindow *win) {
 	text = gtk_editable_get_text(GTK_EDITABLE(win->expression));
 	purple_prefs_set_string(PIDGIN_PREFS_ROOT "/debug/regex", text);
 
+	g_clear_pointer(&win->regex, g_regex_unref);
+
 	if (text == NULL || *text == '\0') {
 		regex_clear_color(win->expression);
 		gtk_widget_set_sensitive(win->filter, FALSE);
 		return;
 	}
 
-	g_clear_pointer(&win->regex, g_regex_unref);
-
-	win->regex = g_regex_new(text, G_REGEX_CASELESS|G_REGEX_JAVASCRIPT_COMPAT, 0, NULL);
+	/* Messages are matched over and over as the filter changes, so it is
+	 * worth having the regex optimized. */
+	win->regex = g_regex_new(text,
+	                         G_REGEX_CASELESS | G_REGEX_JAVASCRIPT_COMPAT |
+	                         G_REGEX_OPTIMIZE,
+	                         0, NULL);
 
 	if (win->regex == NULL) {
 		/* failed to compile */
@@ -444,28 +573,31 @@ regex_filter_toggled_cb(GtkToggleButton *button, PidginDebugWindow *win)
 
 	purple_prefs_set_bool(PIDGIN_PREFS_ROOT "/debug/filter", active);
 
-	regex_toggle_filter(win, active);
+	if (win->regex != NULL) {
+		message_filter_changed(win, active ? GTK_FILTER_CHANGE_MORE_STRICT
+		                                   : GTK_FILTER_CHANGE_LESS_STRICT);
+		message_refresh_rows(win);
+	}
 }
 
+/******************************************************************************
+ * Level and category
+ *****************************************************************************/
 static void
 debug_window_set_filter_level(PidginDebugWindow *win, int level)
 {
-	gboolean scroll;
-	int i;
+	PurpleDebugLevel old_level = win->filter_level;
 
 	if (level != gtk_drop_down_get_selected(GTK_DROP_DOWN(win->filterlevel))) {
 		gtk_drop_down_set_selected(GTK_DROP_DOWN(win->filterlevel), level);
 	}
 
-	scroll = view_near_bottom(win);
-	for (i = 0; i <= PURPLE_DEBUG_FATAL; i++) {
-		g_object_set(G_OBJECT(win->tags.level[i]),
-				"invisible", i < level,
-				NULL);
-	}
-	if (scroll) {
-		gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(win->textview),
-				win->end_mark, 0, TRUE, 0, 1);
+	win->filter_level = CLAMP(level, PURPLE_DEBUG_ALL, PURPLE_DEBUG_FATAL);
+
+	if (win->filter_level > old_level) {
+		message_filter_changed(win, GTK_FILTER_CHANGE_MORE_STRICT);
+	} else if (win->filter_level < old_level) {
+		message_filter_changed(win, GTK_FILTER_CHANGE_LESS_STRICT);
 	}
 }
 
@@ -487,6 +619,65 @@ filter_level_changed_cb(GObject *obj, G_GNUC_UNUSED GParamSpec *pspec)
 	                     gtk_drop_down_get_selected(dropdown));
 }
 
+/* The first entry of the category list means every category, the rest are
+ * added as messages with new categories come in. */
+static void
+category_changed_cb(GObject *obj, G_GNUC_UNUSED GParamSpec *pspec,
+                    gpointer data)
+{
+	PidginDebugWindow *win = data;
+	gchar *old_category = NULL;
+	guint selected;
+
+	selected = gtk_drop_down_get_selected(GTK_DROP_DOWN(obj));
+
+	old_category = g_steal_pointer(&win->filter_category);
+	if (selected != 0 && selected != GTK_INVALID_LIST_POSITION) {
+		win->filter_category = g_strdup(gtk_string_list_get_string(
+				win->categories, selected));
+	}
+
+	if (old_category == NULL && win->filter_category != NULL) {
+		message_filter_changed(win, GTK_FILTER_CHANGE_MORE_STRICT);
+	} else if (old_category != NULL && win->filter_category == NULL) {
+		message_filter_changed(win, GTK_FILTER_CHANGE_LESS_STRICT);
+	} else if (!purple_strequal(old_category, win->filter_category)) {
+		message_filter_changed(win, GTK_FILTER_CHANGE_DIFFERENT);
+	}
+
+	g_free(old_category);
+}
+
+static void
+debug_window_add_categories(PidginDebugWindow *win, GPtrArray *records)
+{
+	for (guint i = 0; i < records->len; i++) {
+		const PurpleDebugRecord *record = g_ptr_array_index(records, i);
+
+		if (*record->category == '\0' ||
+		    g_hash_table_contains(win->category_names, record->category)) {
+			continue;
+		}
+
+		g_hash_table_add(win->category_names, g_strdup(record->category));
+		gtk_string_list_append(win->categories, record->category);
+	}
+}
+
+/* When there's no window and we're not printing, the log writer drops
+ * everything, so tell libpurple not to bother formatting it. */
+static void
+pidgin_debug_update_level(void) {
+	if(debug_win != NULL || debug_print_enabled) {
+		purple_debug_set_level(PURPLE_DEBUG_ALL);
+	} else {
+		purple_debug_set_level(PURPLE_DEBUG_FATAL);
+	}
+}
+
+/******************************************************************************
+ * GObject Implementation
+ *****************************************************************************/
 static void
 pidgin_debug_window_dispose(GObject *object)
 {
@@ -494,6 +685,14 @@ pidgin_debug_window_dispose(GObject *object)
 
 	gtk_widget_unparent(win->popover);
 
+	if (win->listview != NULL) {
+		gtk_list_view_set_model(GTK_LIST_VIEW(win->listview), NULL);
+	}
+
+	g_clear_object(&win->filter_model);
+	g_clear_object(&win->message_filter);
+	g_clear_object(&win->store);
+
 	G_OBJECT_CLASS(pidgin_debug_window_parent_class)->dispose(object);
 }
 
@@ -505,8 +704,12 @@ pidgin_debug_window_finalize(GObject *object)
 	purple_prefs_disconnect_by_handle(pidgin_debug_get_handle());
 
 	g_clear_pointer(&win->regex, g_regex_unref);
+	g_clear_pointer(&win->filter_category, g_free);
+	g_clear_pointer(&win->category_names, g_hash_table_destroy);
+	g_clear_pointer(&win->bound_items, g_hash_table_destroy);
 
 	debug_win = NULL;
+	pidgin_debug_update_level();
 	purple_prefs_set_bool(PIDGIN_PREFS_ROOT "/debug/enabled", FALSE);
 
 	G_OBJECT_CLASS(pidgin_debug_window_parent_class)->finalize(object);
@@ -526,37 +729,17 @@ pidgin_debug_window_class_init(PidginDebugWindowClass *klass) {
 	);
 
 	gtk_widget_class_bind_template_child(
-			widget_class, PidginDebugWindow, textview);
-	gtk_widget_class_bind_template_child(
-			widget_class, PidginDebugWindow, buffer);
-	gtk_widget_class_bind_template_child(
-			widget_class, PidginDebugWindow, tags.category);
-	gtk_widget_class_bind_template_child(
-			widget_class, PidginDebugWindow, tags.filtered_invisible);
-	gtk_widget_class_bind_template_child(
-			widget_class, PidginDebugWindow, tags.filtered_visible);
-	gtk_widget_class_bind_template_child(
-			widget_class, PidginDebugWindow, tags.level[0]);
-	gtk_widget_class_bind_template_child(
-			widget_class, PidginDebugWindow, tags.level[1]);
-	gtk_widget_class_bind_template_child(
-			widget_class, PidginDebugWindow, tags.level[2]);
-	gtk_widget_class_bind_template_child(
-			widget_class, PidginDebugWindow, tags.level[3]);
-	gtk_widget_class_bind_template_child(
-			widget_class, PidginDebugWindow, tags.level[4]);
-	gtk_widget_class_bind_template_child(
-			widget_class, PidginDebugWindow, tags.level[5]);
-	gtk_widget_class_bind_template_child(
-			widget_class, PidginDebugWindow, tags.paused);
+			widget_class, PidginDebugWindow, listview);
 	gtk_widget_class_bind_template_child(
 			widget_class, PidginDebugWindow, filter);
 	gtk_widget_class_bind_template_child(
 			widget_class, PidginDebugWindow, filterlevel);
 	gtk_widget_class_bind_template_child(
-			widget_class, PidginDebugWindow, expression);
+			widget_class, PidginDebugWindow, category);
 	gtk_widget_class_bind_template_child(
-			widget_class, PidginDebugWindow, tags.match);
+			widget_class, PidginDebugWindow, categories);
+	gtk_widget_class_bind_template_child(
+			widget_class, PidginDebugWindow, expression);
 	gtk_widget_class_bind_template_child(
 			widget_class, PidginDebugWindow, popover);
 	gtk_widget_class_bind_template_child(
@@ -576,6 +759,8 @@ pidgin_debug_window_class_init(PidginDebugWindowClass *klass) {
 			regex_key_released_cb);
 	gtk_widget_class_bind_template_callback(widget_class,
 			filter_level_changed_cb);
+	gtk_widget_class_bind_template_callback(widget_class,
+			category_changed_cb);
 }
 
 static void
@@ -583,12 +768,47 @@ pidgin_debug_window_init(PidginDebugWindow *win)
 {
 	gint width, height;
 	void *handle;
-	GtkTextIter end;
+	GtkListItemFactory *factory = NULL;
+	GtkSelectionModel *selection = NULL;
+	GtkAdjustment *adj = NULL;
 
 	gtk_widget_init_template(GTK_WIDGET(win));
 
 	gtk_widget_set_parent(win->popover, win->filter);
 
+	win->bound_items = g_hash_table_new(g_direct_hash, g_direct_equal);
+	win->category_names = g_hash_table_new_full(g_str_hash, g_str_equal,
+	                                            g_free, NULL);
+	win->filter_level = PURPLE_DEBUG_ALL;
+	win->scroll_to_end = TRUE;
+
+	/* The messages are kept as records, and only the rows on screen are
+	 * ever turned into text. */
+	win->store = pidgin_debug_store_new(PIDGIN_DEBUG_STORE_DEFAULT_CAPACITY);
+	win->message_filter = GTK_FILTER(gtk_custom_filter_new(message_filter_func,
+	                                                       win, NULL));
+	win->filter_model = gtk_filter_list_model_new(
+		G_LIST_MODEL(g_object_ref(win->store)),
+		g_object_ref(win->message_filter));
+	gtk_filter_list_model_set_incremental(win->filter_model, TRUE);
+
+	factory = gtk_signal_list_item_factory_new();
+	g_signal_connect(factory, "setup", G_CALLBACK(message_setup_cb), win);
+	g_signal_connect(factory, "bind", G_CALLBACK(message_bind_cb), win);
+	g_signal_connect(factory, "unbind", G_CALLBACK(message_unbind_cb), win);
+
+	selection = GTK_SELECTION_MODEL(gtk_no_selection_new(
+		G_LIST_MODEL(g_object_ref(win->filter_model))));
+	gtk_list_view_set_factory(GTK_LIST_VIEW(win->listview), factory);
+	gtk_list_view_set_model(GTK_LIST_VIEW(win->listview), selection);
+	g_object_unref(factory);
+	g_object_unref(selection);
+
+	adj = gtk_scrollable_get_vadjustment(GTK_SCROLLABLE(win->listview));
+	g_signal_connect(adj, "value-changed", G_CALLBACK(view_value_changed_cb),
+	                 win);
+	g_signal_connect(adj, "changed", G_CALLBACK(view_changed_cb), win);
+
 	width  = purple_prefs_get_int(PIDGIN_PREFS_ROOT "/debug/width");
 	height = purple_prefs_get_int(PIDGIN_PREFS_ROOT "/debug/height");
 
@@ -639,20 +859,9 @@ pidgin_debug_window_init(PidginDebugWindow *win)
 	gtk_check_button_set_active(GTK_CHECK_BUTTON(win->popover_highlight),
 	                            win->highlight);
 
-	/* The *start* and *end* marks bound the beginning and end of an
-	   insertion, used for filtering. The *end* mark is also used for
-	   auto-scrolling. */
-	gtk_text_buffer_get_end_iter(win->buffer, &end);
-	win->start_mark = gtk_text_buffer_create_mark(win->buffer,
-			"start", &end, TRUE);
-	win->end_mark = gtk_text_buffer_create_mark(win->buffer,
-			"end", &end, FALSE);
-
-	/* Set active filter level in textview */
+	/* Set active filter level in the list */
 	debug_window_set_filter_level(win,
 			purple_prefs_get_int(PIDGIN_PREFS_ROOT "/debug/filterlevel"));
-
-	clear_cb(NULL, win);
 }
 
 static gboolean
@@ -681,157 +890,96 @@ debug_enabled_cb(G_GNUC_UNUSED const gchar *name,
 	                                    (gpointer)value);
 }
 
-static gboolean
-pidgin_debug_g_log_handler_cb(gpointer data)
+static void
+pidgin_debug_print(const PurpleDebugRecord *record)
 {
-	PidginDebugMessage *message = data;
-	GtkTextTag *level_tag = NULL;
+	GDateTime *timestamp = NULL;
 	gchar *local_time = NULL;
-	GtkTextIter end;
-	gboolean scroll;
 
-	if (debug_win == NULL ||
-			!purple_prefs_get_bool(PIDGIN_PREFS_ROOT "/debug/enabled")) {
-		/* The Debug Window may have been closed/disabled after the thread that
-		 * sent this message. */
-		g_date_time_unref(message->timestamp);
-		g_free(message->domain);
-		g_free(message->message);
-		g_free(message);
-		return FALSE;
-	}
+	timestamp = g_date_time_new_from_unix_local(
+			purple_debug_record_get_real_time(record) / G_USEC_PER_SEC);
+	local_time = g_date_time_format(timestamp, "%H:%M:%S");
+	g_date_time_unref(timestamp);
 
-	scroll = view_near_bottom(debug_win);
-	gtk_text_buffer_get_end_iter(debug_win->buffer, &end);
-	gtk_text_buffer_move_mark(debug_win->buffer, debug_win->start_mark, &end);
-
-	level_tag = debug_win->tags.level[message->level];
-	local_time = g_date_time_format(message->timestamp, "(%H:%M:%S) ");
-
-	gtk_text_buffer_insert_with_tags(
-			debug_win->buffer,
-			&end,
-			local_time,
-			-1,
-			level_tag,
-			debug_win->paused ? debug_win->tags.paused : NULL,
-			NULL);
-
-	if (message->domain != NULL && *message->domain != '\0') {
-		gtk_text_buffer_insert_with_tags(
-				debug_win->buffer,
-				&end,
-				message->domain,
-				-1,
-				level_tag,
-				debug_win->tags.category,
-				debug_win->paused ? debug_win->tags.paused : NULL,
-				NULL);
-		gtk_text_buffer_insert_with_tags(
-				debug_win->buffer,
-				&end,
-				": ",
-				2,
-				level_tag,
-				debug_win->tags.category,
-				debug_win->paused ? debug_win->tags.paused : NULL,
-				NULL);
-	}
-
-	gtk_text_buffer_insert_with_tags(
-			debug_win->buffer,
-			&end,
-			message->message,
-			-1,
-			level_tag,
-			debug_win->paused ? debug_win->tags.paused : NULL,
-			NULL);
-	gtk_text_buffer_insert_with_tags(
-			debug_win->buffer,
-			&end,
-			"\n",
-			1,
-			level_tag,
-			debug_win->paused ? debug_win->tags.paused : NULL,
-			NULL);
-
-	if (purple_prefs_get_bool(PIDGIN_PREFS_ROOT "/debug/filter") &&
-			debug_win->regex) {
-		/* Filter out any new messages. */
-		GtkTextIter start;
-
-		gtk_text_buffer_get_iter_at_mark(debug_win->buffer, &start,
-		                                 debug_win->start_mark);
-		gtk_text_buffer_get_iter_at_mark(debug_win->buffer, &end,
-		                                 debug_win->end_mark);
-
-		do_regex(debug_win, &start, &end);
-	}
-
-	if (scroll) {
-		gtk_text_view_scroll_to_mark(
-				GTK_TEXT_VIEW(debug_win->textview),
-				debug_win->end_mark, 0, TRUE, 0, 1);
-	}
+	g_printerr("(%s) %s%s%s\n", local_time, record->category,
+	           *record->category != '\0' ? ": " : "", record->message);
 
 	g_free(local_time);
-	g_date_time_unref(message->timestamp);
-	g_free(message->domain);
-	g_free(message->message);
-	g_free(message);
+}
 
-	return FALSE;
+/* Called on the main loop with everything that was logged since the last
+ * time. The whole batch goes into the store at once, so the filter model only
+ * checks the new messages and the list view only lays out the rows that end
+ * up on screen. */
+static void
+pidgin_debug_sink_cb(GPtrArray *records, G_GNUC_UNUSED gpointer data)
+{
+	guint i;
+
+	if (debug_print_enabled) {
+		for (i = 0; i < records->len; i++) {
+			pidgin_debug_print(g_ptr_array_index(records, i));
+		}
+	}
+
+	if (debug_win == NULL ||
+			!purple_prefs_get_bool(PIDGIN_PREFS_ROOT "/debug/enabled")) {
+		return;
+	}
+
+	debug_window_add_categories(debug_win, records);
+	pidgin_debug_store_append(debug_win->store, records);
 }
 
+/* libpurple sends its own messages straight to the sink, so this only sees
+ * messages from GLib, GTK, and other libraries, which are forwarded to the
+ * same queue. */
 static GLogWriterOutput
 pidgin_debug_g_log_handler(GLogLevelFlags log_level, const GLogField *fields,
                            gsize n_fields, G_GNUC_UNUSED gpointer user_data)
 {
-	PidginDebugMessage *message = NULL;
+	PurpleDebugLevel level;
+	const gchar *domain = NULL;
+	const gchar *message = NULL;
 	gsize i;
 
-	if (debug_win == NULL) {
-		if (debug_print_enabled) {
-			return g_log_writer_default(log_level, fields, n_fields, user_data);
-		} else {
-			return G_LOG_WRITER_UNHANDLED;
-		}
+	/* The process is about to abort, so this can't wait for the main
+	 * loop. */
+	if ((log_level & G_LOG_FLAG_FATAL) != 0) {
+		return g_log_writer_default(log_level, fields, n_fields, user_data);
 	}
 
-	message = g_new0(PidginDebugMessage, 1);
-	message->timestamp = g_date_time_new_now_local();
-
 	for (i = 0; i < n_fields; i++) {
 		if (purple_strequal(fields[i].key, "GLIB_DOMAIN")) {
-			message->domain = g_strdup(fields[i].value);
+			domain = fields[i].value;
 		} else if (purple_strequal(fields[i].key, "MESSAGE")) {
-			message->message = g_strdup(fields[i].value);
+			message = fields[i].value;
 		}
 	}
 
+	if (message == NULL) {
+		return G_LOG_WRITER_UNHANDLED;
+	}
+
 	if((log_level & G_LOG_LEVEL_ERROR) != 0) {
-		message->level = PURPLE_DEBUG_ERROR;
+		level = PURPLE_DEBUG_ERROR;
 	} else if((log_level & G_LOG_LEVEL_CRITICAL) != 0) {
-		message->level = PURPLE_DEBUG_FATAL;
+		/* Not fatal, as purple_debug_fatal() aborts while a critical only
+		 * does when it's been made fatal, which was handled above. */
+		level = PURPLE_DEBUG_ERROR;
 	} else if((log_level & G_LOG_LEVEL_WARNING) != 0) {
-		message->level = PURPLE_DEBUG_WARNING;
+		level = PURPLE_DEBUG_WARNING;
 	} else if((log_level & G_LOG_LEVEL_MESSAGE) != 0) {
-		message->level = PURPLE_DEBUG_INFO;
+		level = PURPLE_DEBUG_INFO;
 	} else if((log_level & G_LOG_LEVEL_INFO) != 0) {
-		message->level = PURPLE_DEBUG_INFO;
-	} else if((log_level & G_LOG_LEVEL_DEBUG) != 0) {
-		message->level = PURPLE_DEBUG_MISC;
+		level = PURPLE_DEBUG_INFO;
 	} else {
-		message->level = PURPLE_DEBUG_MISC;
+		level = PURPLE_DEBUG_MISC;
 	}
 
-	g_timeout_add(0, pidgin_debug_g_log_handler_cb, message);
+	purple_debug(level, domain, "%s", message);
 
-	if (debug_print_enabled) {
-		return g_log_writer_default(log_level, fields, n_fields, user_data);
-	} else {
-		return G_LOG_WRITER_HANDLED;
-	}
+	return G_LOG_WRITER_HANDLED;
 }
 
 void
@@ -850,6 +998,8 @@ pidgin_debug_window_show(void)
 				g_object_new(PIDGIN_TYPE_DEBUG_WINDOW, NULL));
 
 		gtk_window_set_transient_for(GTK_WINDOW(debug_win), parent);
+
+		pidgin_debug_update_level();
 	}
 
 	gtk_window_present_with_time(GTK_WINDOW(debug_win), GDK_CURRENT_TIME);
@@ -868,6 +1018,7 @@ pidgin_debug_window_hide(void)
 void
 pidgin_debug_init_handler(void)
 {
+	purple_debug_set_sink(pidgin_debug_sink_cb, NULL, NULL);
 	g_log_set_writer_func(pidgin_debug_g_log_handler, NULL, NULL);
 }
 
@@ -875,6 +1026,7 @@ void
 pidgin_debug_set_print_enabled(gboolean enable)
 {
 	debug_print_enabled = enable;
+	pidgin_debug_update_level();
 }
 
 void
@@ -915,6 +1067,9 @@ pidgin_debug_uninit(void)
 		g_source_remove(debug_enabled_timer);
 	}
 	debug_enabled_timer = 0;
+
+	/* Print whatever is still queued, the main loop won't get to it. */
+	purple_debug_sink_flush();
 }
 
 void *
@@ -0,0 +1,144 @@
+/*
+ * Pidgin - Internet Messenger
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * Pidgin is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "pidgin/pidgindebugmessage.h"
+
+struct _PidginDebugMessage {
+	GObject parent;
+
+	guint64 sequence;
+	gint64 time;
+	guint thread_id;
+	PurpleDebugLevel level;
+	gchar *category;
+	gchar *text;
+};
+
+/******************************************************************************
+ * GObject Implementation
+ *****************************************************************************/
+G_DEFINE_TYPE(PidginDebugMessage, pidgin_debug_message, G_TYPE_OBJECT)
+
+static void
+pidgin_debug_message_finalize(GObject *obj) {
+	PidginDebugMessage *message = PIDGIN_DEBUG_MESSAGE(obj);
+
+	g_clear_pointer(&message->category, g_free);
+	g_clear_pointer(&message->text, g_free);
+
+	G_OBJECT_CLASS(pidgin_debug_message_parent_class)->finalize(obj);
+}
+
+static void
+pidgin_debug_message_init(PidginDebugMessage *message) {
+}
+
+static void
+pidgin_debug_message_class_init(PidginDebugMessageClass *klass) {
+	GObjectClass *obj_class = G_OBJECT_CLASS(klass);
+
+	obj_class->finalize = pidgin_debug_message_finalize;
+}
+
+/******************************************************************************
+ * Public API
+ *****************************************************************************/
+PidginDebugMessage *
+pidgin_debug_message_new(const PurpleDebugRecord *record, guint64 sequence) {
+	PidginDebugMessage *message = NULL;
+
+	g_return_val_if_fail(record != NULL, NULL);
+
+	message = g_object_new(PIDGIN_TYPE_DEBUG_MESSAGE, NULL);
+	message->sequence = sequence;
+	message->time = purple_debug_record_get_real_time(record);
+	message->thread_id = record->thread_id;
+	message->level = record->level;
+	message->category = g_strdup(record->category);
+	message->text = g_strdup(record->message);
+
+	return message;
+}
+
+guint64
+pidgin_debug_message_get_sequence(PidginDebugMessage *message) {
+	g_return_val_if_fail(PIDGIN_IS_DEBUG_MESSAGE(message), 0);
+
+	return message->sequence;
+}
+
+gint64
+pidgin_debug_message_get_time(PidginDebugMessage *message) {
+	g_return_val_if_fail(PIDGIN_IS_DEBUG_MESSAGE(message), 0);
+
+	return message->time;
+}
+
+guint
+pidgin_debug_message_get_thread_id(PidginDebugMessage *message) {
+	g_return_val_if_fail(PIDGIN_IS_DEBUG_MESSAGE(message), 0);
+
+	return message->thread_id;
+}
+
+PurpleDebugLevel
+pidgin_debug_message_get_level(PidginDebugMessage *message) {
+	g_return_val_if_fail(PIDGIN_IS_DEBUG_MESSAGE(message), PURPLE_DEBUG_ALL);
+
+	return message->level;
+}
+
+const gchar *
+pidgin_debug_message_get_category(PidginDebugMessage *message) {
+	g_return_val_if_fail(PIDGIN_IS_DEBUG_MESSAGE(message), NULL);
+
+	return message->category;
+}
+
+const gchar *
+pidgin_debug_message_get_text(PidginDebugMessage *message) {
+	g_return_val_if_fail(PIDGIN_IS_DEBUG_MESSAGE(message), NULL);
+
+	return message->text;
+}
+
+gchar *
+pidgin_debug_message_format(PidginDebugMessage *message) {
+	GDateTime *timestamp = NULL;
+	gchar *local_time = NULL;
+	gchar *ret = NULL;
+
+	g_return_val_if_fail(PIDGIN_IS_DEBUG_MESSAGE(message), NULL);
+
+	timestamp = g_date_time_new_from_unix_local(message->time /
+	                                            G_USEC_PER_SEC);
+	local_time = g_date_time_format(timestamp, "%H:%M:%S");
+	g_date_time_unref(timestamp);
+
+	ret = g_strdup_printf("(%s) %s%s%s", local_time, message->category,
+	                      *message->category != '\0' ? ": " : "",
+	                      message->text);
+
+	g_free(local_time);
+
+	return ret;
+}
@@ -0,0 +1,153 @@
+/*
+ * Pidgin - Internet Messenger
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * Pidgin is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#if !defined(PIDGIN_GLOBAL_HEADER_INSIDE) && !defined(PIDGIN_COMPILATION)
+# error "only <pidgin.h> may be included directly"
+#endif
+
+#ifndef PIDGIN_DEBUG_MESSAGE_H
+#define PIDGIN_DEBUG_MESSAGE_H
+
+#include <glib.h>
+#include <glib-object.h>
+
+#include <purple.h>
+
+G_BEGIN_DECLS
+
+/**
+ * PidginDebugMessage:
+ *
+ * A single debug message as shown in the debug window. It is a copy of a
+ * [struct@Purple.DebugRecord] that outlives the batch it was delivered in,
+ * and it never changes once it has been created.
+ *
+ * Since: 3.0.0
+ */
+
+#define PIDGIN_TYPE_DEBUG_MESSAGE (pidgin_debug_message_get_type())
+G_DECLARE_FINAL_TYPE(PidginDebugMessage, pidgin_debug_message, PIDGIN,
+                     DEBUG_MESSAGE, GObject)
+
+/**
+ * pidgin_debug_message_new:
+ * @record: The record to copy.
+ * @sequence: The position of @record in the stream of all messages.
+ *
+ * Creates a new message from @record.
+ *
+ * Returns: (transfer full): The new instance.
+ *
+ * Since: 3.0.0
+ */
+PidginDebugMessage *pidgin_debug_message_new(const PurpleDebugRecord *record, guint64 sequence);
+
+/**
+ * pidgin_debug_message_get_sequence:
+ * @message: The instance.
+ *
+ * Gets the sequence number of @message. Messages are numbered in the order
+ * they were received, so a later message always has a higher number, even
+ * after older ones have been dropped.
+ *
+ * Returns: The sequence number.
+ *
+ * Since: 3.0.0
+ */
+guint64 pidgin_debug_message_get_sequence(PidginDebugMessage *message);
+
+/**
+ * pidgin_debug_message_get_time:
+ * @message: The instance.
+ *
+ * Gets the wall clock time that @message was logged at.
+ *
+ * Returns: The time in microseconds since the epoch.
+ *
+ * Since: 3.0.0
+ */
+gint64 pidgin_debug_message_get_time(PidginDebugMessage *message);
+
+/**
+ * pidgin_debug_message_get_thread_id:
+ * @message: The instance.
+ *
+ * Gets the number of the thread that logged @message.
+ *
+ * Returns: The thread number.
+ *
+ * Since: 3.0.0
+ */
+guint pidgin_debug_message_get_thread_id(PidginDebugMessage *message);
+
+/**
+ * pidgin_debug_message_get_level:
+ * @message: The instance.
+ *
+ * Gets the level of @message.
+ *
+ * Returns: The level.
+ *
+ * Since: 3.0.0
+ */
+PurpleDebugLevel pidgin_debug_message_get_level(PidginDebugMessage *message);
+
+/**
+ * pidgin_debug_message_get_category:
+ * @message: The instance.
+ *
+ * Gets the category of @message.
+ *
+ * Returns: The category, or an empty string if it had none.
+ *
+ * Since: 3.0.0
+ */
+const gchar *pidgin_debug_message_get_category(PidginDebugMessage *message);
+
+/**
+ * pidgin_debug_message_get_text:
+ * @message: The instance.
+ *
+ * Gets the text of @message.
+ *
+ * Returns: The text.
+ *
+ * Since: 3.0.0
+ */
+const gchar *pidgin_debug_message_get_text(PidginDebugMessage *message);
+
+/**
+ * pidgin_debug_message_format:
+ * @message: The instance.
+ *
+ * Formats @message as a single line the way it is written to a saved debug
+ * log, without a trailing newline.
+ *
+ * Returns: (transfer full): The formatted line.
+ *
+ * Since: 3.0.0
+ */
+gchar *pidgin_debug_message_format(PidginDebugMessage *message);
+
+G_END_DECLS
+
+#endif /* PIDGIN_DEBUG_MESSAGE_H */
@@ -0,0 +1,262 @@
+/*
+ * Pidgin - Internet Messenger
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * Pidgin is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "pidgin/pidgindebugstore.h"
+
+enum {
+	PROP_0,
+	PROP_CAPACITY,
+	N_PROPERTIES,
+};
+static GParamSpec *properties[N_PROPERTIES] = {NULL, };
+
+struct _PidginDebugStore {
+	GObject parent;
+
+	/* A ring of capacity slots; the model's first item is at head. */
+	PidginDebugMessage **messages;
+	guint capacity;
+	guint head;
+	guint n_messages;
+
+	guint64 sequence;
+};
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static inline guint
+pidgin_debug_store_slot(PidginDebugStore *store, guint position) {
+	return (store->head + position) % store->capacity;
+}
+
+/* Drops the oldest n messages without notifying anyone. */
+static void
+pidgin_debug_store_drop(PidginDebugStore *store, guint n) {
+	for(guint i = 0; i < n; i++) {
+		g_clear_object(&store->messages[store->head]);
+		store->head = (store->head + 1) % store->capacity;
+	}
+
+	store->n_messages -= n;
+	if(store->n_messages == 0) {
+		store->head = 0;
+	}
+}
+
+/******************************************************************************
+ * GListModel Implementation
+ *****************************************************************************/
+static GType
+pidgin_debug_store_get_item_type(GListModel *model) {
+	return PIDGIN_TYPE_DEBUG_MESSAGE;
+}
+
+static guint
+pidgin_debug_store_get_n_items(GListModel *model) {
+	PidginDebugStore *store = PIDGIN_DEBUG_STORE(model);
+
+	return store->n_messages;
+}
+
+static gpointer
+pidgin_debug_store_get_item(GListModel *model, guint position) {
+	PidginDebugStore *store = PIDGIN_DEBUG_STORE(model);
+
+	if(position >= store->n_messages) {
+		return NULL;
+	}
+
+	return g_object_ref(
+		store->messages[pidgin_debug_store_slot(store, position)]);
+}
+
+static void
+pidgin_debug_store_list_model_init(GListModelInterface *iface) {
+	iface->get_item_type = pidgin_debug_store_get_item_type;
+	iface->get_n_items = pidgin_debug_store_get_n_items;
+	iface->get_item = pidgin_debug_store_get_item;
+}
+
+/******************************************************************************
+ * GObject Implementation
+ *****************************************************************************/
+G_DEFINE_TYPE_WITH_CODE(PidginDebugStore, pidgin_debug_store, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(G_TYPE_LIST_MODEL,
+                                              pidgin_debug_store_list_model_init))
+
+static void
+pidgin_debug_store_get_property(GObject *obj, guint param_id, GValue *value,
+                                GParamSpec *pspec)
+{
+	PidginDebugStore *store = PIDGIN_DEBUG_STORE(obj);
+
+	switch(param_id) {
+		case PROP_CAPACITY:
+			g_value_set_uint(value, pidgin_debug_store_get_capacity(store));
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
+			break;
+	}
+}
+
+static void
+pidgin_debug_store_set_property(GObject *obj, guint param_id,
+                                const GValue *value, GParamSpec *pspec)
+{
+	PidginDebugStore *store = PIDGIN_DEBUG_STORE(obj);
+
+	switch(param_id) {
+		case PROP_CAPACITY:
+			store->capacity = g_value_get_uint(value);
+			break;
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
+			break;
+	}
+}
+
+static void
+pidgin_debug_store_constructed(GObject *obj) {
+	PidginDebugStore *store = PIDGIN_DEBUG_STORE(obj);
+
+	G_OBJECT_CLASS(pidgin_debug_store_parent_class)->constructed(obj);
+
+	store->messages = g_new0(PidginDebugMessage *, store->capacity);
+}
+
+static void
+pidgin_debug_store_finalize(GObject *obj) {
+	PidginDebugStore *store = PIDGIN_DEBUG_STORE(obj);
+
+	pidgin_debug_store_drop(store, store->n_messages);
+	g_clear_pointer(&store->messages, g_free);
+
+	G_OBJECT_CLASS(pidgin_debug_store_parent_class)->finalize(obj);
+}
+
+static void
+pidgin_debug_store_init(PidginDebugStore *store) {
+}
+
+static void
+pidgin_debug_store_class_init(PidginDebugStoreClass *klass) {
+	GObjectClass *obj_class = G_OBJECT_CLASS(klass);
+
+	obj_class->get_property = pidgin_debug_store_get_property;
+	obj_class->set_property = pidgin_debug_store_set_property;
+	obj_class->constructed = pidgin_debug_store_constructed;
+	obj_class->finalize = pidgin_debug_store_finalize;
+
+	/**
+	 * PidginDebugStore:capacity:
+	 *
+	 * The maximum number of messages the store keeps.
+	 *
+	 * Since: 3.0.0
+	 */
+	properties[PROP_CAPACITY] = g_param_spec_uint(
+		"capacity", "capacity",
+		"The maximum number of messages the store keeps.",
+		1, G_MAXUINT, PIDGIN_DEBUG_STORE_DEFAULT_CAPACITY,
+		G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+	g_object_class_install_properties(obj_class, N_PROPERTIES, properties);
+}
+
+/******************************************************************************
+ * Public API
+ *****************************************************************************/
+PidginDebugStore *
+pidgin_debug_store_new(guint capacity) {
+	g_return_val_if_fail(capacity > 0, NULL);
+
+	return g_object_new(PIDGIN_TYPE_DEBUG_STORE, "capacity", capacity, NULL);
+}
+
+guint
+pidgin_debug_store_get_capacity(PidginDebugStore *store) {
+	g_return_val_if_fail(PIDGIN_IS_DEBUG_STORE(store), 0);
+
+	return store->capacity;
+}
+
+void
+pidgin_debug_store_append(PidginDebugStore *store, GPtrArray *records) {
+	guint first = 0, added = 0, removed = 0, position = 0;
+
+	g_return_if_fail(PIDGIN_IS_DEBUG_STORE(store));
+	g_return_if_fail(records != NULL);
+
+	if(records->len == 0) {
+		return;
+	}
+
+	/* Records that would be pushed out again by the end of this batch are
+	 * never turned into messages, but they still use up a sequence number. */
+	if(records->len > store->capacity) {
+		first = records->len - store->capacity;
+		store->sequence += first;
+	}
+	added = records->len - first;
+
+	if(store->n_messages + added > store->capacity) {
+		removed = store->n_messages + added - store->capacity;
+		pidgin_debug_store_drop(store, removed);
+		g_list_model_items_changed(G_LIST_MODEL(store), 0, removed, 0);
+	}
+
+	position = store->n_messages;
+	for(guint i = first; i < records->len; i++) {
+		const PurpleDebugRecord *record = g_ptr_array_index(records, i);
+		guint slot = pidgin_debug_store_slot(store, store->n_messages);
+
+		store->messages[slot] = pidgin_debug_message_new(record,
+		                                                 ++store->sequence);
+		store->n_messages++;
+	}
+
+	g_list_model_items_changed(G_LIST_MODEL(store), position, 0, added);
+}
+
+void
+pidgin_debug_store_clear(PidginDebugStore *store) {
+	guint removed = 0;
+
+	g_return_if_fail(PIDGIN_IS_DEBUG_STORE(store));
+
+	removed = store->n_messages;
+	if(removed == 0) {
+		return;
+	}
+
+	pidgin_debug_store_drop(store, removed);
+	g_list_model_items_changed(G_LIST_MODEL(store), 0, removed, 0);
+}
+
+guint64
+pidgin_debug_store_get_last_sequence(PidginDebugStore *store) {
+	g_return_val_if_fail(PIDGIN_IS_DEBUG_STORE(store), 0);
+
+	return store->sequence;
+}
@@ -0,0 +1,130 @@
+/*
+ * Pidgin - Internet Messenger
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * Pidgin is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#if !defined(PIDGIN_GLOBAL_HEADER_INSIDE) && !defined(PIDGIN_COMPILATION)
+# error "only <pidgin.h> may be included directly"
+#endif
+
+#ifndef PIDGIN_DEBUG_STORE_H
+#define PIDGIN_DEBUG_STORE_H
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include <purple.h>
+
+#include "pidgindebugmessage.h"
+
+G_BEGIN_DECLS
+
+/**
+ * PIDGIN_DEBUG_STORE_DEFAULT_CAPACITY:
+ *
+ * The number of messages a [class@Pidgin.DebugStore] keeps by default.
+ *
+ * Since: 3.0.0
+ */
+#define PIDGIN_DEBUG_STORE_DEFAULT_CAPACITY (20000)
+
+/**
+ * PidginDebugStore:
+ *
+ * A [iface@Gio.ListModel] of [class@Pidgin.DebugMessage]s, oldest first,
+ * that holds at most a fixed number of messages.
+ *
+ * The messages are kept in a ring, so once the store is full, appending
+ * drops the oldest messages without moving the rest. Each batch that is
+ * appended is reported with at most one removal at the start of the model
+ * and one addition at the end, which lets a [class@Gtk.FilterListModel] on
+ * top of it only look at the new messages.
+ *
+ * Since: 3.0.0
+ */
+
+#define PIDGIN_TYPE_DEBUG_STORE (pidgin_debug_store_get_type())
+G_DECLARE_FINAL_TYPE(PidginDebugStore, pidgin_debug_store, PIDGIN,
+                     DEBUG_STORE, GObject)
+
+/**
+ * pidgin_debug_store_new:
+ * @capacity: The maximum number of messages to keep.
+ *
+ * Creates a new, empty store.
+ *
+ * Returns: (transfer full): The new instance.
+ *
+ * Since: 3.0.0
+ */
+PidginDebugStore *pidgin_debug_store_new(guint capacity);
+
+/**
+ * pidgin_debug_store_get_capacity:
+ * @store: The instance.
+ *
+ * Gets the maximum number of messages that @store keeps.
+ *
+ * Returns: The capacity.
+ *
+ * Since: 3.0.0
+ */
+guint pidgin_debug_store_get_capacity(PidginDebugStore *store);
+
+/**
+ * pidgin_debug_store_append:
+ * @store: The instance.
+ * @records: (element-type PurpleDebugRecord) (transfer none): The records to
+ *           add, oldest first.
+ *
+ * Adds a message for each of @records to the end of @store, dropping the
+ * oldest messages if @store would go over its capacity.
+ *
+ * Since: 3.0.0
+ */
+void pidgin_debug_store_append(PidginDebugStore *store, GPtrArray *records);
+
+/**
+ * pidgin_debug_store_clear:
+ * @store: The instance.
+ *
+ * Removes every message from @store. Sequence numbers keep counting from
+ * where they were.
+ *
+ * Since: 3.0.0
+ */
+void pidgin_debug_store_clear(PidginDebugStore *store);
+
+/**
+ * pidgin_debug_store_get_last_sequence:
+ * @store: The instance.
+ *
+ * Gets the sequence number that was given to the last message appended to
+ * @store, whether or not it is still in @store.
+ *
+ * Returns: The sequence number, or 0 if nothing was ever appended.
+ *
+ * Since: 3.0.0
+ */
+guint64 pidgin_debug_store_get_last_sequence(PidginDebugStore *store);
+
+G_END_DECLS
+
+#endif /* PIDGIN_DEBUG_STORE_H */
@@ -127,76 +127,331 @@ make_word_proper(const gchar *word)
 	return ret;
 }
 
+/* The replacement rules are compiled into an index the first time they are
+ * needed after the list has been edited, so that checking a word doesn't
+ * have to walk the whole list store on every keystroke.
+ *
+ * Whole word rules are looked up by hashing the typed word, while the other
+ * rules are matched against the buffer in a single pass by an Aho-Corasick
+ * automaton.  In both cases, when more than one rule matches, the one that
+ * comes first in the list wins, just as when the list was walked in order.
+ */
+typedef struct {
+	guint order;
+
+	gchar *bad;
+	gchar *good;
+	gsize bad_len;
+
+	gboolean case_sensitive;
+	gboolean bad_lowercase;
+	gboolean good_lowercase;
+} SpellchkRule;
+
+typedef struct {
+	guint fail;
+	guint dict;
+	gint output;
+} SpellchkNode;
+
+typedef struct {
+	GPtrArray *rules;
+
+	/* Whole word rules. */
+	GHashTable *exact;
+	GHashTable *lower;
+	GHashTable *folded;
+
+	/* The automaton for the other rules.  Edges are keyed by the parent
+	 * node index shifted left by eight bits or'd with the byte. */
+	GArray *nodes;
+	GHashTable *edges;
+} SpellchkIndex;
+
+static SpellchkIndex *replacement_index = NULL;
+
+static void
+spellchk_rule_free(SpellchkRule *rule)
+{
+	g_free(rule->bad);
+	g_free(rule->good);
+	g_free(rule);
+}
+
+static void
+spellchk_index_free(SpellchkIndex *idx)
+{
+	if (idx == NULL)
+		return;
+
+	g_hash_table_destroy(idx->exact);
+	g_hash_table_destroy(idx->lower);
+	g_hash_table_destroy(idx->folded);
+	g_hash_table_destroy(idx->edges);
+	g_array_free(idx->nodes, TRUE);
+	g_ptr_array_free(idx->rules, TRUE);
+	g_free(idx);
+}
+
+static void
+spellchk_index_invalidate(void)
+{
+	g_clear_pointer(&replacement_index, spellchk_index_free);
+}
+
+static guint
+spellchk_index_get_edge(SpellchkIndex *idx, guint node, guchar c)
+{
+	return GPOINTER_TO_UINT(g_hash_table_lookup(idx->edges,
+	                                            GUINT_TO_POINTER((node << 8) | c)));
+}
+
+static void
+spellchk_index_add_pattern(SpellchkIndex *idx, SpellchkRule *rule)
+{
+	const guchar *p;
+	guint node = 0;
+	SpellchkNode *n;
+
+	for (p = (const guchar *)rule->bad; *p != '\0'; p++) {
+		guint next = spellchk_index_get_edge(idx, node, *p);
+
+		if (next == 0) {
+			SpellchkNode child = { 0, 0, -1 };
+
+			next = idx->nodes->len;
+			g_array_append_val(idx->nodes, child);
+			g_hash_table_insert(idx->edges,
+			                    GUINT_TO_POINTER((node << 8) | *p),
+			                    GUINT_TO_POINTER(next));
+		}
+
+		node = next;
+	}
+
+	/* Duplicates keep the rule that comes first in the list. */
+	n = &g_array_index(idx->nodes, SpellchkNode, node);
+	if (n->output == -1)
+		n->output = rule->order;
+}
+
+static void
+spellchk_index_link_nodes(SpellchkIndex *idx)
+{
+	GQueue queue = G_QUEUE_INIT;
+	GHashTableIter iter;
+	gpointer key, value;
+	GPtrArray *children;
+	guint i;
+
+	/* Collect the children of each node so we can walk the trie breadth
+	 * first while computing the failure links. */
+	children = g_ptr_array_new_full(idx->nodes->len,
+	                                (GDestroyNotify)g_array_unref);
+	for (i = 0; i < idx->nodes->len; i++)
+		g_ptr_array_add(children, g_array_new(FALSE, FALSE, sizeof(guint)));
+
+	g_hash_table_iter_init(&iter, idx->edges);
+	while (g_hash_table_iter_next(&iter, &key, &value)) {
+		guint edge = GPOINTER_TO_UINT(key);
+
+		g_array_append_val(g_ptr_array_index(children, edge >> 8), edge);
+	}
+
+	g_queue_push_tail(&queue, GUINT_TO_POINTER(0));
+	while (!g_queue_is_empty(&queue)) {
+		guint parent = GPOINTER_TO_UINT(g_queue_pop_head(&queue));
+		GArray *edges = g_ptr_array_index(children, parent);
+
+		for (i = 0; i < edges->len; i++) {
+			guint edge = g_array_index(edges, guint, i);
+			guchar c = edge & 0xff;
+			guint child = spellchk_index_get_edge(idx, parent, c);
+			SpellchkNode *node = &g_array_index(idx->nodes, SpellchkNode, child);
+			SpellchkNode *fail = NULL;
+
+			if (parent != 0) {
+				guint f = g_array_index(idx->nodes, SpellchkNode, parent).fail;
+
+				while (f != 0 && spellchk_index_get_edge(idx, f, c) == 0)
+					f = g_array_index(idx->nodes, SpellchkNode, f).fail;
+
+				node->fail = spellchk_index_get_edge(idx, f, c);
+			}
+
+			fail = &g_array_index(idx->nodes, SpellchkNode, node->fail);
+			node->dict = (fail->output != -1) ? node->fail : fail->dict;
+
+			g_queue_push_tail(&queue, GUINT_TO_POINTER(child));
+		}
+	}
+
+	g_ptr_array_free(children, TRUE);
+}
+
+static SpellchkIndex *
+spellchk_index_get(void)
+{
+	SpellchkIndex *idx;
+	SpellchkNode root = { 0, 0, -1 };
+	GtkTreeIter iter;
+
+	if (replacement_index != NULL)
+		return replacement_index;
+
+	idx = g_new0(SpellchkIndex, 1);
+	idx->rules = g_ptr_array_new_with_free_func((GDestroyNotify)spellchk_rule_free);
+	idx->exact = g_hash_table_new(g_str_hash, g_str_equal);
+	idx->lower = g_hash_table_new(g_str_hash, g_str_equal);
+	idx->folded = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	idx->nodes = g_array_new(FALSE, FALSE, sizeof(SpellchkNode));
+	idx->edges = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	g_array_append_val(idx->nodes, root);
+
+	if (gtk_tree_model_get_iter_first(GTK_TREE_MODEL(model), &iter)) {
+		do {
+			SpellchkRule *rule = g_new0(SpellchkRule, 1);
+			gboolean word_only;
+
+			gtk_tree_model_get(GTK_TREE_MODEL(model), &iter,
+			                   BAD_COLUMN, &rule->bad,
+			                   GOOD_COLUMN, &rule->good,
+			                   WORD_ONLY_COLUMN, &word_only,
+			                   CASE_SENSITIVE_COLUMN, &rule->case_sensitive,
+			                   -1);
+
+			if (rule->bad == NULL || *rule->bad == '\0' || rule->good == NULL) {
+				spellchk_rule_free(rule);
+				continue;
+			}
+
+			rule->order = idx->rules->len;
+			rule->bad_len = strlen(rule->bad);
+			rule->bad_lowercase = is_word_lowercase(rule->bad);
+			rule->good_lowercase = is_word_lowercase(rule->good);
+			g_ptr_array_add(idx->rules, rule);
+
+			if (!word_only) {
+				spellchk_index_add_pattern(idx, rule);
+			} else if (rule->case_sensitive) {
+				if (!g_hash_table_contains(idx->exact, rule->bad))
+					g_hash_table_insert(idx->exact, rule->bad, rule);
+			} else {
+				if (!g_hash_table_contains(idx->lower, rule->bad))
+					g_hash_table_insert(idx->lower, rule->bad, rule);
+
+				if (!rule->bad_lowercase) {
+					gchar *folded = g_utf8_casefold(rule->bad, -1);
+
+					if (!g_hash_table_contains(idx->folded, folded))
+						g_hash_table_insert(idx->folded, folded, rule);
+					else
+						g_free(folded);
+				}
+			}
+		} while (gtk_tree_model_iter_next(GTK_TREE_MODEL(model), &iter));
+	}
+
+	spellchk_index_link_nodes(idx);
+
+	replacement_index = idx;
+
+	return idx;
+}
+
+static SpellchkRule *
+spellchk_rule_pick(SpellchkRule *a, SpellchkRule *b)
+{
+	if (a == NULL)
+		return b;
+	if (b == NULL)
+		return a;
+
+	return (a->order <= b->order) ? a : b;
+}
+
+static void
+spellchk_model_changed_cb(void)
+{
+	spellchk_index_invalidate();
+}
+
 static gboolean
 substitute_simple_buffer(GtkTextBuffer *buffer)
 {
+	SpellchkIndex *idx;
+	SpellchkRule *rule = NULL;
 	GtkTextIter start;
 	GtkTextIter end;
-	GtkTreeIter treeiter;
 	gchar *text = NULL;
+	const guchar *p;
+	gsize match_end = 0;
+	guint node = 0;
+	glong char_pos;
+
+	idx = spellchk_index_get();
+	if (idx->nodes->len == 1)
+		return FALSE;
 
 	gtk_text_buffer_get_iter_at_offset(buffer, &start, 0);
 	gtk_text_buffer_get_iter_at_offset(buffer, &end, 0);
 	gtk_text_iter_forward_to_end(&end);
 
 	text = gtk_text_buffer_get_text(buffer, &start, &end, FALSE);
+	if (text == NULL)
+		return FALSE;
 
-	if (gtk_tree_model_get_iter_first(GTK_TREE_MODEL(model), &treeiter) && text) {
-		do {
-			GValue val1;
-			const gchar *bad;
-			gchar *cursor;
-			glong char_pos;
-
-			val1.g_type = 0;
-			gtk_tree_model_get_value(GTK_TREE_MODEL(model), &treeiter, WORD_ONLY_COLUMN, &val1);
-			if (g_value_get_boolean(&val1))
-			{
-				g_value_unset(&val1);
-				continue;
-			}
-			g_value_unset(&val1);
-
-			gtk_tree_model_get_value(GTK_TREE_MODEL(model), &treeiter, BAD_COLUMN, &val1);
-			bad = g_value_get_string(&val1);
-
-			/* using g_utf8_* to get /character/ offsets instead of byte offsets for buffer */
-			if ((cursor = g_strrstr(text, bad)))
-			{
-				GValue val2;
-				const gchar *good;
-
-				val2.g_type = 0;
-				gtk_tree_model_get_value(GTK_TREE_MODEL(model), &treeiter, GOOD_COLUMN, &val2);
-				good = g_value_get_string(&val2);
+	/* Find the first rule in the list that occurs anywhere in the text, and
+	 * the last place it occurs. */
+	for (p = (const guchar *)text; *p != '\0'; p++) {
+		guint next;
+		guint out;
 
-				char_pos = g_utf8_pointer_to_offset(text, cursor);
-				gtk_text_buffer_get_iter_at_offset(buffer, &start, char_pos);
-				gtk_text_buffer_get_iter_at_offset(buffer, &end, char_pos + g_utf8_strlen(bad, -1));
-				gtk_text_buffer_delete(buffer, &start, &end);
+		while ((next = spellchk_index_get_edge(idx, node, *p)) == 0 && node != 0)
+			node = g_array_index(idx->nodes, SpellchkNode, node).fail;
+		node = next;
 
-				gtk_text_buffer_get_iter_at_offset(buffer, &start, char_pos);
-				gtk_text_buffer_insert(buffer, &start, good, -1);
+		for (out = node; out != 0;
+		     out = g_array_index(idx->nodes, SpellchkNode, out).dict)
+		{
+			gint output = g_array_index(idx->nodes, SpellchkNode, out).output;
+			SpellchkRule *matched;
 
-				g_value_unset(&val2);
-				g_free(text);
+			if (output == -1)
+				continue;
 
-				g_value_unset(&val1);
-				return TRUE;
+			matched = g_ptr_array_index(idx->rules, output);
+			if (spellchk_rule_pick(rule, matched) == matched) {
+				rule = matched;
+				match_end = (p - (const guchar *)text) + 1;
 			}
+		}
+	}
 
-			g_value_unset(&val1);
-		} while (gtk_tree_model_iter_next(GTK_TREE_MODEL(model), &treeiter));
+	if (rule == NULL) {
+		g_free(text);
+		return FALSE;
 	}
 
+	/* using g_utf8_* to get /character/ offsets instead of byte offsets for buffer */
+	char_pos = g_utf8_pointer_to_offset(text, text + match_end - rule->bad_len);
+	gtk_text_buffer_get_iter_at_offset(buffer, &start, char_pos);
+	gtk_text_buffer_get_iter_at_offset(buffer, &end, char_pos + g_utf8_strlen(rule->bad, -1));
+	gtk_text_buffer_delete(buffer, &start, &end);
+
+	gtk_text_buffer_get_iter_at_offset(buffer, &start, char_pos);
+	gtk_text_buffer_insert(buffer, &start, rule->good, -1);
+
 	g_free(text);
-	return FALSE;
+	return TRUE;
 }
 
 static gchar *
 substitute_word(gchar *word)
 {
-	GtkTreeIter iter;
+	SpellchkIndex *idx;
+	SpellchkRule *rule;
 	gchar *outword;
 	gchar *lowerword;
 	gchar *foldedword;
@@ -204,74 +459,34 @@ substitute_word(gchar *word)
 	if (word == NULL)
 		return NULL;
 
+	idx = spellchk_index_get();
+
 	lowerword = g_utf8_strdown(word, -1);
 	foldedword = g_utf8_casefold(word, -1);
 
-	if (gtk_tree_model_get_iter_first(GTK_TREE_MODEL(model), &iter)) {
-		do {
-			GValue val1;
-			gboolean case_sensitive;
-			const char *bad;
-			gchar *tmpbad = NULL;
-
-			val1.g_type = 0;
-			gtk_tree_model_get_value(GTK_TREE_MODEL(model), &iter, WORD_ONLY_COLUMN, &val1);
-			if (!g_value_get_boolean(&val1)) {
-				g_value_unset(&val1);
-				continue;
-			}
-			g_value_unset(&val1);
-
-			gtk_tree_model_get_value(GTK_TREE_MODEL(model), &iter, CASE_SENSITIVE_COLUMN, &val1);
-			case_sensitive = g_value_get_boolean(&val1);
-			g_value_unset(&val1);
-
-			gtk_tree_model_get_value(GTK_TREE_MODEL(model), &iter, BAD_COLUMN, &val1);
-			bad = g_value_get_string(&val1);
-
-			if ((case_sensitive && purple_strequal(bad, word)) ||
-			    (!case_sensitive && (purple_strequal(bad, lowerword) ||
-			                        (!is_word_lowercase(bad) &&
-			                         purple_strequal((tmpbad = g_utf8_casefold(bad, -1)), foldedword)))))
-			{
-				GValue val2;
-				const char *good;
-
-				g_free(tmpbad);
-
-				val2.g_type = 0;
-				gtk_tree_model_get_value(GTK_TREE_MODEL(model), &iter, GOOD_COLUMN, &val2);
-				good = g_value_get_string(&val2);
+	rule = g_hash_table_lookup(idx->exact, word);
+	rule = spellchk_rule_pick(rule, g_hash_table_lookup(idx->lower, lowerword));
+	rule = spellchk_rule_pick(rule, g_hash_table_lookup(idx->folded, foldedword));
 
-				if (!case_sensitive && is_word_lowercase(bad) && is_word_lowercase(good))
-				{
-					if (is_word_uppercase(word))
-						outword = g_utf8_strup(good, -1);
-					else if (is_word_proper(word))
-						outword = make_word_proper(good);
-					else
-						outword = g_strdup(good);
-				}
-				else
-					outword = g_strdup(good);
-
-				g_value_unset(&val1);
-				g_value_unset(&val2);
-
-				g_free(lowerword);
-				g_free(foldedword);
-				return outword;
-			}
+	g_free(lowerword);
+	g_free(foldedword);
 
-			g_value_unset(&val1);
-			g_free(tmpbad);
+	if (rule == NULL)
+		return NULL;
 
-		} while (gtk_tree_model_iter_next(GTK_TREE_MODEL(model), &iter));
+	if (!rule->case_sensitive && rule->bad_lowercase && rule->good_lowercase)
+	{
+		if (is_word_uppercase(word))
+			outword = g_utf8_strup(rule->good, -1);
+		else if (is_word_proper(word))
+			outword = make_word_proper(rule->good);
+		else
+			outword = g_strdup(rule->good);
 	}
-	g_free(lowerword);
-	g_free(foldedword);
+	else
+		outword = g_strdup(rule->good);
 
-	return NULL;
+	return outword;
 }
 
 static void
@@ -1835,6 +2050,18 @@ static void load_conf(void)
 
 	gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(model),
 	                                     0, GTK_SORT_ASCENDING);
+
+	/* Any edit to the list throws away the compiled index; it is rebuilt
+	 * the next time a word is checked. */
+	spellchk_index_invalidate();
+	g_signal_connect(model, "row-changed",
+	                 G_CALLBACK(spellchk_model_changed_cb), NULL);
+	g_signal_connect(model, "row-inserted",
+	                 G_CALLBACK(spellchk_model_changed_cb), NULL);
+	g_signal_connect(model, "row-deleted",
+	                 G_CALLBACK(spellchk_model_changed_cb), NULL);
+	g_signal_connect(model, "rows-reordered",
+	                 G_CALLBACK(spellchk_model_changed_cb), NULL);
 }
 
 static GtkWidget *tree;
@@ -2335,6 +2562,8 @@ spell_check_unload(GPluginPlugin *plugin, gboolean shutdown, GError **error)
 		g_object_set_data(G_OBJECT(gtkconv->entry), SPELLCHK_OBJECT_KEY, NULL);
 	}
 
+	spellchk_index_invalidate();
+
 	return TRUE;
 }
 
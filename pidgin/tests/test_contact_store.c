@@ -0,0 +1,197 @@
+/*
+ * Pidgin - Internet Messenger
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * Pidgin is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <pidgin.h>
+
+#include "tests/test_ui.h"
+
+typedef struct {
+	guint called;
+	guint position;
+	guint removed;
+	guint added;
+} TestPidginContactStoreChange;
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static void
+test_pidgin_contact_store_items_changed_cb(G_GNUC_UNUSED GListModel *model,
+                                           guint position, guint removed,
+                                           guint added, gpointer data)
+{
+	TestPidginContactStoreChange *change = data;
+
+	change->called++;
+	change->position = position;
+	change->removed = removed;
+	change->added = added;
+}
+
+static PurpleContact *
+test_pidgin_contact_store_add(PurpleContactManager *manager,
+                              PurpleAccount *account, const gchar *id)
+{
+	PurpleContact *contact = purple_contact_new(account, id);
+
+	purple_contact_manager_add(manager, contact);
+
+	return contact;
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_pidgin_contact_store_add_remove(void) {
+	PurpleAccount *account = NULL;
+	PurpleContact *contacts[3];
+	PurpleContactManager *manager = NULL;
+	PidginContactStore *store = NULL;
+	TestPidginContactStoreChange change = {0, };
+	guint position = 0;
+
+	manager = g_object_new(PURPLE_TYPE_CONTACT_MANAGER, NULL);
+	store = pidgin_contact_store_new(manager);
+	g_signal_connect(store, "items-changed",
+	                 G_CALLBACK(test_pidgin_contact_store_items_changed_cb),
+	                 &change);
+
+	account = purple_account_new("test", "test");
+
+	/* Contacts are appended in the order they're added. */
+	contacts[0] = test_pidgin_contact_store_add(manager, account, "id-0");
+	g_assert_cmpuint(change.called, ==, 1);
+	g_assert_cmpuint(change.position, ==, 0);
+	g_assert_cmpuint(change.removed, ==, 0);
+	g_assert_cmpuint(change.added, ==, 1);
+
+	contacts[1] = test_pidgin_contact_store_add(manager, account, "id-1");
+	contacts[2] = test_pidgin_contact_store_add(manager, account, "id-2");
+	g_assert_cmpuint(change.called, ==, 3);
+	g_assert_cmpuint(change.position, ==, 2);
+	g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(store)), ==, 3);
+
+	g_assert_true(pidgin_contact_store_find(store, contacts[2], &position));
+	g_assert_cmpuint(position, ==, 2);
+
+	/* Removing one from the middle is a single removal, and everything after
+	 * it moves up. */
+	purple_contact_manager_remove(manager, contacts[1]);
+	g_assert_cmpuint(change.called, ==, 4);
+	g_assert_cmpuint(change.position, ==, 1);
+	g_assert_cmpuint(change.removed, ==, 1);
+	g_assert_cmpuint(change.added, ==, 0);
+	g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(store)), ==, 2);
+
+	g_assert_false(pidgin_contact_store_find(store, contacts[1], NULL));
+	g_assert_true(pidgin_contact_store_find(store, contacts[2], &position));
+	g_assert_cmpuint(position, ==, 1);
+
+	/* Cleanup. */
+	for(guint i = 0; i < G_N_ELEMENTS(contacts); i++) {
+		g_clear_object(&contacts[i]);
+	}
+	g_clear_object(&store);
+	g_clear_object(&account);
+	g_clear_object(&manager);
+}
+
+static void
+test_pidgin_contact_store_changed(void) {
+	PurpleAccount *account = NULL;
+	PurpleContact *first = NULL, *second = NULL;
+	PurpleContactManager *manager = NULL;
+	PurplePresence *presence = NULL, *replacement = NULL;
+	PidginContactStore *store = NULL;
+	TestPidginContactStoreChange change = {0, };
+
+	manager = g_object_new(PURPLE_TYPE_CONTACT_MANAGER, NULL);
+	account = purple_account_new("test", "test");
+
+	first = test_pidgin_contact_store_add(manager, account, "id-0");
+	second = test_pidgin_contact_store_add(manager, account, "id-1");
+
+	presence = g_object_new(PURPLE_TYPE_PRESENCE, NULL);
+	purple_contact_set_presence(second, presence);
+
+	/* Contacts that were there before the store are picked up too. */
+	store = pidgin_contact_store_new(manager);
+	g_assert_cmpuint(g_list_model_get_n_items(G_LIST_MODEL(store)), ==, 2);
+	g_signal_connect(store, "items-changed",
+	                 G_CALLBACK(test_pidgin_contact_store_items_changed_cb),
+	                 &change);
+
+	/* A property change is that one item being replaced in place. */
+	purple_contact_set_alias(second, "alias");
+	g_assert_cmpuint(change.called, ==, 1);
+	g_assert_cmpuint(change.position, ==, 1);
+	g_assert_cmpuint(change.removed, ==, 1);
+	g_assert_cmpuint(change.added, ==, 1);
+
+	/* So is a change to its presence. */
+	purple_presence_set_login_time(presence, 1234);
+	g_assert_cmpuint(change.called, ==, 2);
+	g_assert_cmpuint(change.position, ==, 1);
+	g_assert_cmpuint(change.removed, ==, 1);
+	g_assert_cmpuint(change.added, ==, 1);
+
+	/* Once the presence is replaced, the old one is no longer watched. */
+	replacement = g_object_new(PURPLE_TYPE_PRESENCE, NULL);
+	purple_contact_set_presence(second, replacement);
+	change.called = 0;
+
+	purple_presence_set_login_time(presence, 5678);
+	g_assert_cmpuint(change.called, ==, 0);
+
+	purple_presence_set_login_time(replacement, 5678);
+	g_assert_cmpuint(change.called, ==, 1);
+	g_assert_cmpuint(change.position, ==, 1);
+
+	/* Cleanup. */
+	g_clear_object(&store);
+	g_clear_object(&first);
+	g_clear_object(&second);
+	g_clear_object(&presence);
+	g_clear_object(&replacement);
+	g_clear_object(&account);
+	g_clear_object(&manager);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar *argv[]) {
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+
+	g_test_add_func("/contact-store/add-remove",
+	                test_pidgin_contact_store_add_remove);
+	g_test_add_func("/contact-store/changed",
+	                test_pidgin_contact_store_changed);
+
+	return g_test_run();
+}
@@ -0,0 +1,80 @@
+/*
+ * Pidgin - Internet Messenger
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * Pidgin is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <pidgin.h>
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_pidgin_debug_critical(void) {
+	if(g_test_subprocess()) {
+		/* g_test_init() makes criticals fatal, which they aren't in
+		 * Pidgin. */
+		g_log_set_always_fatal(G_LOG_FATAL_MASK);
+
+		pidgin_debug_init_handler();
+
+		g_critical("forwarded critical");
+		purple_debug_sink_flush();
+
+		g_print("still running\n");
+
+		return;
+	}
+
+	/* A critical from GTK or GLib goes to the debug window, it must not
+	 * take Pidgin down. */
+	g_test_trap_subprocess(NULL, 0, 0);
+	g_test_trap_assert_passed();
+	g_test_trap_assert_stdout("*still running*");
+}
+
+static void
+test_pidgin_debug_error(void) {
+	if(g_test_subprocess()) {
+		pidgin_debug_init_handler();
+
+		g_error("forwarded error");
+
+		return;
+	}
+
+	/* Errors still abort, like they do everywhere else. */
+	g_test_trap_subprocess(NULL, 0, 0);
+	g_test_trap_assert_failed();
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar *argv[]) {
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/debug/critical", test_pidgin_debug_critical);
+	g_test_add_func("/debug/error", test_pidgin_debug_error);
+
+	return g_test_run();
+}